@@ -0,0 +1,155 @@
+import argparse
+import struct
+import zlib
+
+# Formato descrito em main/fota_delta.h
+MAGIC = 0x5044324D
+VERSION = 1
+
+OP_END = 0x00
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+KEY_SIZE = 8
+INDEX_STEP = 4
+# quantos bytes sem melhorar o resultado antes de parar uma copia aproximada
+EXTEND_SLACK = 256
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+class delta_writer():
+    def __init__(self):
+        self.body = bytearray()
+        self.old_pos = 0
+
+    def insert(self, data):
+        if data:
+            self.body.append(OP_INSERT)
+            self.body += varint(len(data))
+            self.body += data
+
+    def copy(self, old, old_start, new, new_start, length):
+        self.body.append(OP_COPY)
+        self.body += varint(zigzag(old_start - self.old_pos))
+        self.body += varint(length)
+
+        diff = bytes((new[new_start + i] - old[old_start + i]) & 0xFF for i in range(length))
+        i = 0
+        while i < length:
+            zeros = i
+            while i < length and diff[i] == 0:
+                i += 1
+            zeros = i - zeros
+            lits = i
+            # corta os literais em zeros que compensem uma nova corrida
+            while i < length and diff[i:i + 3] != b"\0\0\0":
+                i += 1
+            self.body += varint(zeros)
+            self.body += varint(i - lits)
+            self.body += diff[lits:i]
+
+        self.old_pos = old_start + length
+
+    def end(self):
+        self.body.append(OP_END)
+
+
+def build_index(old):
+    index = {}
+    for i in range(0, len(old) - KEY_SIZE + 1, INDEX_STEP):
+        index.setdefault(old[i:i + KEY_SIZE], i)
+    return index
+
+
+def extend(old, old_start, new, new_start):
+    # como no bsdiff: fica com o comprimento que maximiza iguais - diferentes
+    best = 0
+    best_value = 0
+    score = 0
+    i = 0
+    while old_start + i < len(old) and new_start + i < len(new) and i - best < EXTEND_SLACK:
+        if old[old_start + i] == new[new_start + i]:
+            score += 1
+        i += 1
+        if score * 2 - i > best_value:
+            best_value = score * 2 - i
+            best = i
+    return best
+
+
+def diff(old, new):
+    writer = delta_writer()
+    index = build_index(old)
+    pos = 0
+    lit_start = 0
+
+    while pos <= len(new) - KEY_SIZE:
+        key = new[pos:pos + KEY_SIZE]
+        expected = writer.old_pos + (pos - lit_start)
+
+        if old[expected:expected + KEY_SIZE] == key:
+            old_start = expected
+        else:
+            old_start = index.get(key)
+
+        if old_start is None:
+            pos += 1
+            continue
+
+        back = 0
+        while pos - back > lit_start and old_start - back > 0 and new[pos - back - 1] == old[old_start - back - 1]:
+            back += 1
+
+        length = back + extend(old, old_start, new, pos)
+
+        writer.insert(new[lit_start:pos - back])
+        writer.copy(old, old_start - back, new, pos - back, length)
+
+        pos = pos - back + length
+        lit_start = pos
+
+    writer.insert(new[lit_start:])
+    writer.end()
+
+    header = struct.pack("<IB3xIIII", MAGIC, VERSION, len(old), zlib.crc32(old), len(new), zlib.crc32(new))
+
+    return header + bytes(writer.body)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Gera o patch FOTA por diferencas entre duas imagens m200.bin")
+    parser.add_argument("old", help="imagem em execucao no equipamento")
+    parser.add_argument("new", help="imagem nova")
+    parser.add_argument("patch", help="ficheiro de saida")
+    args = parser.parse_args()
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+
+    patch = diff(old, new)
+
+    with open(args.patch, "wb") as f:
+        f.write(patch)
+
+    print("%s: %d bytes (%.1f%% de %d)" % (args.patch, len(patch), 100.0 * len(patch) / len(new), len(new)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,34 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _HOST_TEST_H_
+#define _HOST_TEST_H_
+
+#include <stdio.h>
+
+/* testes dos modulos puros de main/, compilados no PC (sem ESP-IDF) */
+
+static int host_test_failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("%s:%d: FAIL %s\n", __FILE__, __LINE__, #cond);                   \
+      host_test_failures++;                                                    \
+    }                                                                          \
+  } while (0)
+
+#define HOST_TEST_END()                                                        \
+  do {                                                                         \
+    printf("%s\n", host_test_failures ? "FAILED" : "OK");                      \
+    return host_test_failures ? 1 : 0;                                         \
+  } while (0)
+
+#endif
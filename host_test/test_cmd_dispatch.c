@@ -0,0 +1,270 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "UDP_Codes.h"
+#include "cmd_dispatch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Tabela de comandos do core.c: ordem das chaves, codebook do UDP_Codes.c
+ * inteiro, pesquisa aleatoria contra uma procura linear, formato dos
+ * argumentos e tempo por pesquisa.
+ */
+
+#define FUZZ_LOOKUPS 200000
+#define FUZZ_PAYLOADS 20000
+#define TIMED_ROUNDS 20000
+
+/* elementos do codebook sem handler (so aparecem em respostas) */
+static const char *codebook_Elements_Without_Handler[] = {
+    "AL", "F1", "F2", "F3", "F4", "F5", "F6", "FX",
+};
+
+/* codigos do codebook de elementos com handler mas que nenhum handler
+   aceita; o core.c responde ERROR_PARAMETER */
+static const char *codebook_Without_Entry[] = {
+    "ME.G.B",
+    "ME.R.S",
+    "ME.S.O",
+};
+
+static const cmd_dispatch_entry *linear_Find(const char *element, char cmd,
+                                             char parameter) {
+  if (strlen(element) != 2) {
+    return NULL;
+  }
+
+  for (uint16_t i = 0; i < cmd_dispatch_table_size; i++) {
+    const cmd_dispatch_entry *entry = &cmd_dispatch_table[i];
+
+    if (!strcmp(entry->element, element) && entry->cmd == cmd &&
+        entry->parameter == parameter) {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+static uint8_t linear_Has_Element(const char *element) {
+  if (strlen(element) != 2) {
+    return 0;
+  }
+
+  for (uint16_t i = 0; i < cmd_dispatch_table_size; i++) {
+    if (!strcmp(cmd_dispatch_table[i].element, element)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static uint8_t in_List(const char *code, const char **list, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (!strcmp(code, list[i])) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static uint8_t reference_Check_Arg(const cmd_dispatch_entry *entry,
+                                   const char *payload) {
+  size_t len = payload == NULL ? 0 : strlen(payload);
+  char *end = NULL;
+  unsigned long value;
+
+  if (entry->arg.type == CMD_ARG_NONE) {
+    return 1;
+  } else if (entry->arg.type == CMD_ARG_TEXT) {
+    return len >= entry->arg.min &&
+           (entry->arg.max == 0 || len <= entry->arg.max);
+  }
+
+  if (len == 0 || len > CMD_ARG_UINT_DIGITS || payload[0] < '0' ||
+      payload[0] > '9') {
+    return 0;
+  }
+
+  value = strtoul(payload, &end, 10);
+  return *end == 0 && value >= entry->arg.min && value <= entry->arg.max;
+}
+
+static char random_Char(void) {
+  static const char chars[] = "GRSXBDHIMNPTUWZ*019 .;+-aR1IMEUTWF";
+
+  return rand() % 4 == 0 ? (char)(rand() % 256)
+                         : chars[rand() % (sizeof(chars) - 1)];
+}
+
+static double now_Us(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+int main(void) {
+  const cmd_dispatch_entry *entry;
+  volatile uintptr_t sink = 0;
+  double begin;
+  char element[4];
+  char payload[16];
+  long lookups = 0;
+  int missing = 0;
+
+  /* chaves estritamente crescentes, senao a pesquisa binaria falha */
+  for (uint16_t i = 0; i < cmd_dispatch_table_size; i++) {
+    entry = &cmd_dispatch_table[i];
+
+    CHECK(strlen(entry->element) == 2);
+    CHECK(entry->cmd == 'G' || entry->cmd == 'R' || entry->cmd == 'S');
+    CHECK(entry->handler < CMD_HANDLER_COUNT);
+    CHECK(entry->channels != 0 && !(entry->channels & ~CMD_CHANNEL_ALL));
+    CHECK(entry->min_permition >= '0' && entry->min_permition <= '2');
+    CHECK(entry->arg.type != CMD_ARG_UINT || entry->arg.min <= entry->arg.max);
+    if (i > 0) {
+      uint32_t previous =
+          CMD_DISPATCH_KEY(cmd_dispatch_table[i - 1].element,
+                           cmd_dispatch_table[i - 1].cmd,
+                           cmd_dispatch_table[i - 1].parameter);
+
+      CHECK(previous < CMD_DISPATCH_KEY(entry->element, entry->cmd,
+                                        entry->parameter));
+      if (previous >= CMD_DISPATCH_KEY(entry->element, entry->cmd,
+                                       entry->parameter)) {
+        printf("  fora de ordem: %s.%c.%c\n", entry->element, entry->cmd,
+               entry->parameter);
+      }
+    }
+    CHECK(cmd_Dispatch_Find(entry->element, entry->cmd, entry->parameter) ==
+          entry);
+  }
+
+  /* todo o codebook */
+  for (int i = 0; i < UDP_CODES_NUMBER; i++) {
+    const char *code = list_Codes_Codec[i];
+
+    memcpy(element, code, 2);
+    element[2] = 0;
+    entry = cmd_Dispatch_Find(element, code[3], code[5]);
+
+    CHECK(entry == linear_Find(element, code[3], code[5]));
+    CHECK(cmd_Dispatch_Has_Element(element) == linear_Has_Element(element));
+
+    if (in_List(element, codebook_Elements_Without_Handler,
+                sizeof(codebook_Elements_Without_Handler) /
+                    sizeof(codebook_Elements_Without_Handler[0]))) {
+      CHECK(entry == NULL);
+      CHECK(!cmd_Dispatch_Has_Element(element));
+    } else if (entry == NULL &&
+               !in_List(code, codebook_Without_Entry,
+                        sizeof(codebook_Without_Entry) /
+                            sizeof(codebook_Without_Entry[0]))) {
+      printf("  %s sem entrada\n", code);
+      missing++;
+    }
+  }
+  CHECK(missing == 0);
+
+  /* pesquisas aleatorias contra a procura linear */
+  srand(42);
+  for (int i = 0; i < FUZZ_LOOKUPS; i++) {
+    int len = rand() % 8 == 0 ? rand() % 4 : 2;
+    char cmd = random_Char();
+    char parameter = random_Char();
+
+    if (len == 2 && rand() % 2 == 0) {
+      entry = &cmd_dispatch_table[rand() % cmd_dispatch_table_size];
+      memcpy(element, entry->element, 3);
+    } else {
+      for (int k = 0; k < len; k++) {
+        element[k] = random_Char();
+        if (element[k] == 0) {
+          element[k] = 'X';
+        }
+      }
+      element[len] = 0;
+    }
+
+    CHECK(cmd_Dispatch_Find(element, cmd, parameter) ==
+          linear_Find(element, cmd, parameter));
+    CHECK(cmd_Dispatch_Has_Element(element) == linear_Has_Element(element));
+  }
+  CHECK(cmd_Dispatch_Find(NULL, 'G', 'I') == NULL);
+  CHECK(!cmd_Dispatch_Has_Element(NULL));
+
+  /* formato dos argumentos */
+  for (int i = 0; i < FUZZ_PAYLOADS; i++) {
+    int len = rand() % 8;
+
+    entry = &cmd_dispatch_table[rand() % cmd_dispatch_table_size];
+    for (int k = 0; k < len; k++) {
+      payload[k] = rand() % 3 ? '0' + rand() % 10 : random_Char();
+      if (payload[k] == 0) {
+        payload[k] = '?';
+      }
+    }
+    payload[len] = 0;
+
+    CHECK(cmd_Dispatch_Check_Arg(entry, payload) ==
+          reference_Check_Arg(entry, payload));
+  }
+
+  entry = cmd_Dispatch_Find("R1", 'S', 'T');
+  CHECK(entry != NULL && entry->arg.type == CMD_ARG_UINT);
+  if (entry != NULL) {
+    CHECK(cmd_Dispatch_Check_Arg(entry, "18000"));
+    CHECK(cmd_Dispatch_Check_Arg(entry, "0"));
+    CHECK(!cmd_Dispatch_Check_Arg(entry, ""));
+    CHECK(!cmd_Dispatch_Check_Arg(entry, NULL));
+    CHECK(!cmd_Dispatch_Check_Arg(entry, "12a"));
+    CHECK(!cmd_Dispatch_Check_Arg(entry, "-1"));
+    CHECK(!cmd_Dispatch_Check_Arg(entry, "123456"));
+  }
+
+  entry = cmd_Dispatch_Find("ME", 'S', 'X');
+  CHECK(entry != NULL && entry->arg.type == CMD_ARG_UINT);
+  if (entry != NULL) {
+    CHECK(cmd_Dispatch_Check_Arg(entry, "3"));
+    CHECK(!cmd_Dispatch_Check_Arg(entry, "4"));
+  }
+
+  entry = cmd_Dispatch_Find("ME", 'G', 'Z');
+  CHECK(entry != NULL && entry->handler == CMD_HANDLER_HEALTH);
+  CHECK(entry != NULL && cmd_Dispatch_Check_Arg(entry, NULL));
+  entry = cmd_Dispatch_Find("UR", 'G', '*');
+  CHECK(entry != NULL && entry->handler == CMD_HANDLER_READ_ALL_USERS);
+  CHECK(cmd_Dispatch_Find("R1", 'X', 'R') == NULL);
+  CHECK(cmd_Dispatch_Has_Element("R1"));
+  CHECK(!cmd_Dispatch_Has_Element("R3"));
+
+  /* tempo por pesquisa sobre o codebook inteiro */
+  begin = now_Us();
+  for (int round = 0; round < TIMED_ROUNDS; round++) {
+    for (int i = 0; i < UDP_CODES_NUMBER; i++) {
+      const char *code = list_Codes_Codec[i];
+
+      memcpy(element, code, 2);
+      element[2] = 0;
+      sink += (uintptr_t)cmd_Dispatch_Find(element, code[3], code[5]);
+      lookups++;
+    }
+  }
+  printf("%u entradas, %.1f ns por pesquisa\n", cmd_dispatch_table_size,
+         (now_Us() - begin) * 1000 / lookups);
+
+  HOST_TEST_END();
+}
@@ -0,0 +1,256 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "ccronexpr.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * cron_next contra uma procura direta segundo a segundo (sem bit masks) e
+ * tempo medio por chamada. Expressoes aleatorias com semente fixa, em UTC
+ * e em dois fusos com hora de verao. O firmware compila o ccronexpr com
+ * CRON_USE_LOCAL_TIME, os campos sao na hora local do TZ.
+ *
+ *   test_cron_next [expressoes]
+ */
+
+#define CRON_TEST_FIRES 4
+#define CRON_TEST_HORIZON (5L * 366 * 86400)
+
+static const char *time_Zones[] = {
+    "UTC0",
+    "WET0WEST,M3.5.0/1,M10.5.0",
+    "EST5EDT,M3.2.0,M11.1.0",
+};
+
+static int get_Bit(const uint8_t *bits, int i) {
+  return (bits[i / 8] >> (i % 8)) & 1;
+}
+
+/* segunda passagem numa hora repetida quando o relogio recua */
+static int is_Second_Pass(time_t t) {
+  time_t before = t - 3600;
+  struct tm now, then;
+
+  localtime_r(&t, &now);
+  localtime_r(&before, &then);
+
+  return now.tm_mday == then.tm_mday && now.tm_hour == then.tm_hour &&
+         now.tm_min == then.tm_min;
+}
+
+/*
+ * Primeiro instante depois de date cujos campos batem certo. Uma hora
+ * repetida so dispara na segunda passagem se date ja estiver nela.
+ */
+static time_t reference_Next(const cron_expr *expr, time_t date) {
+  time_t t = date + 1;
+
+  while (t < date + CRON_TEST_HORIZON) {
+    struct tm c;
+
+    localtime_r(&t, &c);
+
+    if (!get_Bit(expr->months, c.tm_mon) ||
+        !get_Bit(expr->days_of_month, c.tm_mday) ||
+        !get_Bit(expr->days_of_week, c.tm_wday)) {
+      c.tm_mday++;
+      c.tm_hour = c.tm_min = c.tm_sec = 0;
+      c.tm_isdst = -1;
+      t = mktime(&c);
+      continue;
+    }
+
+    if (!get_Bit(expr->hours, c.tm_hour)) {
+      t += 3600 - c.tm_min * 60 - c.tm_sec;
+      continue;
+    }
+
+    if (!get_Bit(expr->minutes, c.tm_min)) {
+      t += 60 - c.tm_sec;
+      continue;
+    }
+
+    if (!get_Bit(expr->seconds, c.tm_sec) ||
+        (is_Second_Pass(t) && !is_Second_Pass(date))) {
+      t++;
+      continue;
+    }
+
+    return t;
+  }
+
+  return (time_t)-1;
+}
+
+static void random_Field(char *out, int min, int max) {
+  int a = min + rand() % (max - min + 1);
+  int b = min + rand() % (max - min + 1);
+
+  if (a > b) {
+    int swap = a;
+    a = b;
+    b = swap;
+  }
+
+  switch (rand() % 6) {
+  case 0:
+    strcpy(out, "*");
+    break;
+  case 1:
+    sprintf(out, "%d", a);
+    break;
+  case 2:
+    sprintf(out, "%d-%d", a, b);
+    break;
+  case 3:
+    sprintf(out, "%d,%d", a, b);
+    break;
+  case 4:
+    sprintf(out, "*/%d", 1 + rand() % ((max - min) / 2 + 1));
+    break;
+  default:
+    sprintf(out, "%d-%d/%d", a, b, 1 + rand() % 3);
+    break;
+  }
+}
+
+/* metade com segundos fixos e um quarto ao estilo das rotinas "0 M H * * D" */
+static void random_Expression(char *out) {
+  char f[6][32];
+
+  random_Field(f[0], 0, 59);
+  random_Field(f[1], 0, 59);
+  random_Field(f[2], 0, 23);
+  random_Field(f[3], 1, 31);
+  random_Field(f[4], 1, 12);
+  random_Field(f[5], 0, 6);
+
+  if (rand() % 2 == 0) {
+    strcpy(f[0], "0");
+  }
+
+  if (rand() % 4 == 0) {
+    sprintf(f[1], "%d", rand() % 60);
+    sprintf(f[2], "%d", rand() % 24);
+    strcpy(f[3], "*");
+    strcpy(f[4], "*");
+  }
+
+  sprintf(out, "%s %s %s %s %s %s", f[0], f[1], f[2], f[3], f[4], f[5]);
+}
+
+static double now_Us(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 2000;
+  cron_expr *exprs = calloc(count, sizeof(cron_expr));
+  char (*texts)[128] = calloc(count, sizeof(*texts));
+  time_t *starts = calloc(count, sizeof(time_t));
+  cron_expr daily;
+  const char *error = NULL;
+  time_t out[8];
+  long calls = 0;
+
+  CHECK(exprs != NULL && texts != NULL && starts != NULL);
+
+  srand(42);
+  for (int i = 0; i < count;) {
+    random_Expression(texts[i]);
+    error = NULL;
+    cron_parse_expr(texts[i], &exprs[i], &error);
+    if (error != NULL) {
+      continue;
+    }
+    /* 2023 a 2027, inclui as mudancas de hora */
+    starts[i] = 1700000000 + (time_t)(rand() % (4 * 365)) * 86400 +
+                rand() % 86400;
+    i++;
+  }
+
+  for (size_t z = 0; z < sizeof(time_Zones) / sizeof(time_Zones[0]); z++) {
+    int wrong = 0;
+    double elapsed = 0;
+
+    setenv("TZ", time_Zones[z], 1);
+    tzset();
+
+    for (int i = 0; i < count; i++) {
+      time_t date = starts[i];
+
+      for (int k = 0; k < CRON_TEST_FIRES; k++) {
+        double begin = now_Us();
+        time_t next = cron_next(&exprs[i], date);
+        time_t expected;
+
+        elapsed += now_Us() - begin;
+        calls++;
+
+        expected = reference_Next(&exprs[i], date);
+        if (expected == (time_t)-1) {
+          break;
+        }
+
+        if (next != expected) {
+          if (wrong++ < 5) {
+            printf("  %s [%s] de %ld: %ld, esperado %ld\n", time_Zones[z],
+                   texts[i], (long)date, (long)next, (long)expected);
+          }
+          break;
+        }
+
+        date = next;
+      }
+    }
+
+    CHECK(wrong == 0);
+    printf("%-28s %d expressoes, %.2f us por cron_next\n", time_Zones[z],
+           count, elapsed / (count * CRON_TEST_FIRES));
+  }
+
+  /* cron_next_n devolve o mesmo que chamadas repetidas a cron_next */
+  for (int i = 0; i < count; i++) {
+    int n = cron_next_n(&exprs[i], starts[i], 8, out);
+    time_t date = starts[i];
+
+    for (int k = 0; k < n; k++) {
+      CHECK(out[k] == (date = cron_next(&exprs[i], date)));
+    }
+  }
+
+  /* hora de Lisboa: 01:30 nao existe a 29/3/2026 e repete-se a 25/10/2026 */
+  setenv("TZ", time_Zones[1], 1);
+  tzset();
+  memset(&daily, 0, sizeof(daily));
+  error = NULL;
+  cron_parse_expr("0 30 1 * * *", &daily, &error);
+  CHECK(error == NULL);
+  /* 28/3 01:30 WET, 30/3 01:30 WEST */
+  CHECK(cron_next(&daily, 1774661400) == 1774830600);
+  /* 24/10 01:30 WEST, 25/10 01:30 WEST (primeira passagem), 26/10 WET */
+  CHECK(cron_next(&daily, 1792801800) == 1792888200);
+  CHECK(cron_next(&daily, 1792888200) == 1792978200);
+  /* ja dentro da segunda passagem ainda dispara nela */
+  CHECK(cron_next(&daily, 1792888200 + 1800) == 1792888200 + 3600);
+
+  printf("%ld chamadas\n", calls);
+  free(exprs);
+  free(texts);
+  free(starts);
+
+  HOST_TEST_END();
+}
@@ -0,0 +1,209 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "fota_delta.h"
+#include "host_test.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Aplica um patch gerado por fota_delta.py a imagem antiga e compara com a
+ * imagem nova:
+ *   test_fota_delta <antiga> <nova> <patch>
+ * Os vetores em vectors/ sao imagens pequenas com o aspeto de um m200.bin
+ * (codigo, tabelas de enderecos e strings) com bytes trocados, enderecos
+ * deslocados, um bloco inserido e outro removido.
+ */
+
+typedef struct
+{
+  const uint8_t *old;
+  size_t old_len;
+  uint8_t *out;
+  size_t out_len;
+  size_t out_size;
+  uint8_t fail_Write;
+
+} image_ctx;
+
+/* o mesmo que o esp_rom_crc32_le (zlib) */
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len) {
+  crc = ~crc;
+
+  while (len--) {
+    crc ^= *buf++;
+
+    for (uint8_t k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+  }
+
+  return ~crc;
+}
+
+static int read_Old(void *ctx, uint32_t offset, void *buf, size_t len) {
+  image_ctx *image = ctx;
+
+  if (offset + len > image->old_len) {
+    return -1;
+  }
+
+  memcpy(buf, image->old + offset, len);
+  return 0;
+}
+
+static int write_New(void *ctx, const void *buf, size_t len) {
+  image_ctx *image = ctx;
+
+  if (image->fail_Write || image->out_len + len > image->out_size) {
+    return -1;
+  }
+
+  memcpy(image->out + image->out_len, buf, len);
+  image->out_len += len;
+  return 0;
+}
+
+static uint8_t *load_File(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  uint8_t *data = NULL;
+  long size = 0;
+
+  if (f == NULL) {
+    printf("nao abre %s\n", path);
+    exit(2);
+  }
+
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  data = malloc(size > 0 ? size : 1);
+
+  if (data == NULL || fread(data, 1, size, f) != (size_t)size) {
+    printf("nao le %s\n", path);
+    exit(2);
+  }
+
+  fclose(f);
+  *len = size;
+
+  return data;
+}
+
+/* aplica o patch em pedacos de tamanho aleatorio ate max_Chunk (0 = tudo) */
+static uint8_t apply_Patch(image_ctx *image, const uint8_t *patch,
+                           size_t patch_len, size_t max_Chunk,
+                           unsigned seed) {
+  static fota_delta delta;
+  size_t pos = 0;
+
+  image->out_len = 0;
+  srand(seed);
+  fota_Delta_Init(&delta, read_Old, write_New, image);
+
+  while (pos < patch_len) {
+    size_t n = max_Chunk ? 1 + rand() % max_Chunk : patch_len;
+
+    if (n > patch_len - pos) {
+      n = patch_len - pos;
+    }
+
+    if (!fota_Delta_Feed(&delta, patch + pos, n)) {
+      return 0;
+    }
+    pos += n;
+  }
+
+  return fota_Delta_Finish(&delta);
+}
+
+int main(int argc, char **argv) {
+  image_ctx image;
+  uint8_t *old = NULL;
+  uint8_t *new_Image = NULL;
+  uint8_t *patch = NULL;
+  uint8_t *bad = NULL;
+  size_t old_len = 0;
+  size_t new_len = 0;
+  size_t patch_len = 0;
+  const size_t chunks[] = {0, 1, 7, 64, 1500, 6144};
+
+  if (argc != 4) {
+    printf("uso: %s <antiga> <nova> <patch>\n", argv[0]);
+    return 2;
+  }
+
+  old = load_File(argv[1], &old_len);
+  new_Image = load_File(argv[2], &new_len);
+  patch = load_File(argv[3], &patch_len);
+
+  memset(&image, 0, sizeof(image));
+  image.old = old;
+  image.old_len = old_len;
+  image.out_size = new_len + FOTA_DELTA_OUT_BUFFER;
+  image.out = malloc(image.out_size);
+
+  CHECK(fota_Delta_Is_Patch(patch, patch_len));
+  CHECK(!fota_Delta_Is_Patch(new_Image, new_len));
+  CHECK(!fota_Delta_Is_Patch(patch, 3));
+
+  /* a mesma imagem seja qual for o tamanho dos blocos recebidos */
+  for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+    CHECK(apply_Patch(&image, patch, patch_len, chunks[c], 1 + c));
+    CHECK(image.out_len == new_len &&
+          !memcmp(image.out, new_Image, new_len));
+  }
+
+  /* imagem em execucao diferente da usada para gerar o patch */
+  old[old_len / 2] ^= 0x01;
+  CHECK(!apply_Patch(&image, patch, patch_len, 0, 1));
+  old[old_len / 2] ^= 0x01;
+
+  /* patch cortado: nunca chega ao fim */
+  CHECK(!apply_Patch(&image, patch, patch_len - 1, 0, 1));
+  CHECK(!apply_Patch(&image, patch, sizeof(fota_delta_header) + 5, 0, 1));
+
+  /* qualquer byte alterado depois do cabecalho e detetado */
+  bad = malloc(patch_len);
+  for (size_t i = sizeof(fota_delta_header); i < patch_len; i++) {
+    memcpy(bad, patch, patch_len);
+    bad[i] ^= 0x5A;
+
+    if (apply_Patch(&image, bad, patch_len, 64, 3)) {
+      printf("patch alterado no byte %zu foi aceite\n", i);
+      CHECK(0);
+      break;
+    }
+  }
+
+  /* versao desconhecida */
+  memcpy(bad, patch, patch_len);
+  ((fota_delta_header *)bad)->version++;
+  CHECK(!apply_Patch(&image, bad, patch_len, 0, 1));
+
+  /* dados a seguir ao FOTA_DELTA_OP_END */
+  bad = realloc(bad, patch_len + 1);
+  memcpy(bad, patch, patch_len);
+  bad[patch_len] = FOTA_DELTA_OP_INSERT;
+  CHECK(!apply_Patch(&image, bad, patch_len + 1, 0, 1));
+
+  /* erro ao escrever na particao */
+  image.fail_Write = 1;
+  CHECK(!apply_Patch(&image, patch, patch_len, 0, 1));
+
+  free(old);
+  free(new_Image);
+  free(patch);
+  free(bad);
+  free(image.out);
+
+  HOST_TEST_END();
+}
@@ -0,0 +1,316 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "health_monitor.h"
+#include <string.h>
+
+/*
+ * Monitor de saude: transicoes da maquina de recuperacao passo a passo e
+ * um modem simulado que so regista a rede a terceira tentativa, perde a
+ * rede e tem o MQTT em erro, ate o equipamento voltar ao estado normal.
+ * Tambem os alarmes e a linha do relatorio.
+ */
+
+static void healthy(health_metrics *metrics) {
+  memset(metrics, 0, sizeof(health_metrics));
+  metrics->sim_present = 1;
+  metrics->modem_on = 1;
+  metrics->sim_ready = 1;
+  metrics->network_ok = 1;
+}
+
+static void test_Transitions(void) {
+  health_recovery recovery;
+  health_metrics metrics;
+
+  health_Recovery_Init(&recovery);
+  healthy(&metrics);
+  CHECK(health_Recovery_Step(&recovery, &metrics) ==
+        HEALTH_ACTION_PROBE_NETWORK);
+
+  /* durante uma transferencia grande nao se mexe em nada */
+  metrics.busy = 1;
+  metrics.modem_on = 0;
+  CHECK(health_Recovery_Step(&recovery, &metrics) == HEALTH_ACTION_NONE);
+  CHECK(recovery.state == HEALTH_STATE_IDLE);
+  metrics.busy = 0;
+
+  /* modem desligado: liga e depois regista na rede */
+  CHECK(health_Recovery_Step(&recovery, &metrics) ==
+        HEALTH_ACTION_MODEM_POWER_ON);
+  CHECK(recovery.state == HEALTH_STATE_MODEM_POWER_ON);
+  metrics.modem_on = 1;
+  CHECK(health_Recovery_Step(&recovery, &metrics) ==
+        HEALTH_ACTION_MODEM_INIT_NETWORK);
+  CHECK(recovery.state == HEALTH_STATE_MODEM_INIT_NETWORK);
+
+  /* ate HEALTH_INIT_NETWORK_ATTEMPTS falhas continua a tentar */
+  for (int i = 1; i < HEALTH_INIT_NETWORK_ATTEMPTS; i++) {
+    health_Recovery_Result(&recovery, HEALTH_ACTION_MODEM_INIT_NETWORK, 0);
+    CHECK(health_Recovery_Step(&recovery, &metrics) ==
+          HEALTH_ACTION_MODEM_INIT_NETWORK);
+  }
+  health_Recovery_Result(&recovery, HEALTH_ACTION_MODEM_INIT_NETWORK, 0);
+  CHECK(recovery.state == HEALTH_STATE_IDLE && recovery.recoveries == 0);
+
+  /* e com sucesso conta uma recuperacao */
+  recovery.state = HEALTH_STATE_MODEM_POWER_ON;
+  CHECK(health_Recovery_Step(&recovery, &metrics) ==
+        HEALTH_ACTION_MODEM_INIT_NETWORK);
+  CHECK(recovery.attempts == 0);
+  health_Recovery_Result(&recovery, HEALTH_ACTION_MODEM_INIT_NETWORK, 1);
+  CHECK(recovery.state == HEALTH_STATE_IDLE && recovery.recoveries == 1);
+
+  /* SIM ainda nao pronto */
+  metrics.sim_ready = 0;
+  CHECK(health_Recovery_Step(&recovery, &metrics) == HEALTH_ACTION_PROBE_SIM);
+  metrics.sim_ready = 1;
+
+  /* rede em falha: sinal fraco ate HEALTH_NETWORK_FAILS, depois reinicia */
+  for (int i = 1; i <= HEALTH_NETWORK_FAILS; i++) {
+    CHECK(health_Recovery_Step(&recovery, &metrics) ==
+          HEALTH_ACTION_PROBE_NETWORK);
+    health_Recovery_Result(&recovery, HEALTH_ACTION_PROBE_NETWORK, 0);
+    CHECK(recovery.state == HEALTH_STATE_NETWORK_FAILED);
+    CHECK(health_Recovery_Step(&recovery, &metrics) ==
+          HEALTH_ACTION_SIGNAL_WEAK);
+    CHECK(recovery.network_fails == i);
+  }
+  CHECK(health_Recovery_Step(&recovery, &metrics) ==
+        HEALTH_ACTION_PROBE_NETWORK);
+  health_Recovery_Result(&recovery, HEALTH_ACTION_PROBE_NETWORK, 0);
+  CHECK(health_Recovery_Step(&recovery, &metrics) ==
+        HEALTH_ACTION_MODEM_RESET);
+  health_Recovery_Result(&recovery, HEALTH_ACTION_MODEM_RESET, 1);
+  CHECK(recovery.network_fails == 0 && recovery.recoveries == 2);
+
+  /* uma verificacao boa apaga as falhas anteriores */
+  health_Recovery_Result(&recovery, HEALTH_ACTION_PROBE_NETWORK, 0);
+  health_Recovery_Step(&recovery, &metrics);
+  CHECK(recovery.network_fails == 1);
+  health_Recovery_Result(&recovery, HEALTH_ACTION_PROBE_NETWORK, 1);
+  CHECK(recovery.network_fails == 0);
+
+  /* sem SIM nao ha recuperacao e o estado volta ao inicio */
+  recovery.state = HEALTH_STATE_NETWORK_FAILED;
+  metrics.sim_present = 0;
+  CHECK(health_Recovery_Step(&recovery, &metrics) == HEALTH_ACTION_NO_SIM);
+  CHECK(recovery.state == HEALTH_STATE_IDLE && recovery.recoveries == 0);
+}
+
+static void test_MQTT(void) {
+  static const struct
+  {
+    uint8_t qmtstat;
+    health_action action;
+
+  } codes[] = {
+      {1, HEALTH_ACTION_MQTT_OPEN},     {2, HEALTH_ACTION_MODEM_RESET},
+      {3, HEALTH_ACTION_PROBE_NETWORK}, {4, HEALTH_ACTION_MQTT_REOPEN},
+      {5, HEALTH_ACTION_PROBE_NETWORK}, {6, HEALTH_ACTION_MQTT_OPEN},
+      {7, HEALTH_ACTION_PROBE_NETWORK}, {8, HEALTH_ACTION_MQTT_OPEN},
+  };
+  health_recovery recovery;
+  health_metrics metrics;
+
+  healthy(&metrics);
+
+  /* so ao fim de HEALTH_MQTT_TICKS ticks em erro, depois recomeca */
+  for (unsigned c = 0; c < sizeof(codes) / sizeof(codes[0]); c++) {
+    health_Recovery_Init(&recovery);
+    metrics.qmtstat = codes[c].qmtstat;
+
+    for (int round = 0; round < 2; round++) {
+      for (int i = 0; i < HEALTH_MQTT_TICKS; i++) {
+        CHECK(health_Recovery_Step(&recovery, &metrics) ==
+              HEALTH_ACTION_PROBE_NETWORK);
+      }
+      CHECK(health_Recovery_Step(&recovery, &metrics) == codes[c].action);
+    }
+  }
+
+  /* o MQTT a voltar a meio repoe a contagem */
+  health_Recovery_Init(&recovery);
+  metrics.qmtstat = 1;
+  health_Recovery_Step(&recovery, &metrics);
+  health_Recovery_Step(&recovery, &metrics);
+  metrics.qmtstat = 0;
+  health_Recovery_Step(&recovery, &metrics);
+  metrics.qmtstat = 1;
+  for (int i = 0; i < HEALTH_MQTT_TICKS; i++) {
+    CHECK(health_Recovery_Step(&recovery, &metrics) ==
+          HEALTH_ACTION_PROBE_NETWORK);
+  }
+  CHECK(health_Recovery_Step(&recovery, &metrics) == HEALTH_ACTION_MQTT_OPEN);
+  health_Recovery_Result(&recovery, HEALTH_ACTION_MQTT_OPEN, 1);
+  CHECK(recovery.recoveries == 1);
+}
+
+/* modem simulado: executa a acao e devolve o resultado */
+typedef struct
+{
+  health_metrics metrics;
+  int register_Tries;
+  int network_Down_Probes;
+  int resets;
+  int mqtt_Opens;
+
+} sim_modem;
+
+static uint8_t sim_Run(sim_modem *modem, health_action action) {
+  health_metrics *metrics = &modem->metrics;
+
+  switch (action) {
+  case HEALTH_ACTION_MODEM_POWER_ON:
+    metrics->modem_on = 1;
+    return 1;
+
+  case HEALTH_ACTION_MODEM_INIT_NETWORK:
+    /* regista a terceira */
+    metrics->network_ok = ++modem->register_Tries >= 3;
+    metrics->sim_ready = metrics->network_ok;
+    return metrics->network_ok;
+
+  case HEALTH_ACTION_PROBE_NETWORK:
+    if (modem->network_Down_Probes > 0) {
+      modem->network_Down_Probes--;
+      metrics->network_ok = 0;
+      return 0;
+    }
+    metrics->network_ok = 1;
+    return 1;
+
+  case HEALTH_ACTION_MODEM_RESET:
+    /* o reinicio limpa a rede e o MQTT */
+    modem->resets++;
+    modem->network_Down_Probes = 0;
+    metrics->network_ok = 1;
+    metrics->qmtstat = 0;
+    return 1;
+
+  case HEALTH_ACTION_MQTT_OPEN:
+  case HEALTH_ACTION_MQTT_REOPEN:
+    modem->mqtt_Opens++;
+    metrics->qmtstat = 0;
+    metrics->mqtt_connected = 1;
+    return 1;
+
+  default:
+    return 1;
+  }
+}
+
+static void test_Recovery_Path(void) {
+  health_recovery recovery;
+  sim_modem modem;
+  int tick = 0;
+  int steady = 0;
+
+  memset(&modem, 0, sizeof(modem));
+  modem.metrics.sim_present = 1;
+  modem.metrics.qmtstat = 1;
+  health_Recovery_Init(&recovery);
+
+  /* desligado, regista a terceira, a rede cai durante 5 verificacoes
+     (mais do que HEALTH_NETWORK_FAILS) e o MQTT so abre no fim */
+  for (tick = 0; tick < 100 && steady < 10; tick++) {
+    health_action action = health_Recovery_Step(&recovery, &modem.metrics);
+
+    if (tick == 10) {
+      modem.network_Down_Probes = 5;
+      modem.metrics.qmtstat = 4;
+    }
+
+    health_Recovery_Result(&recovery, action, sim_Run(&modem, action));
+
+    steady = action == HEALTH_ACTION_PROBE_NETWORK &&
+                     modem.metrics.network_ok && !modem.metrics.qmtstat
+                 ? steady + 1
+                 : 0;
+  }
+
+  CHECK(steady == 10);
+  CHECK(modem.register_Tries == 3);
+  CHECK(modem.resets == 1);
+  CHECK(modem.mqtt_Opens >= 1);
+  CHECK(recovery.state == HEALTH_STATE_IDLE);
+  CHECK(recovery.network_fails == 0 && recovery.mqtt_ticks == 0);
+  /* registo na rede, reinicio do modem e o MQTT */
+  CHECK(recovery.recoveries == 2 + (uint32_t)modem.mqtt_Opens);
+}
+
+static void test_Check_Format(void) {
+  health_thresholds thresholds = {20000, 8000, 512};
+  health_metrics metrics;
+  char line[200];
+
+  healthy(&metrics);
+  metrics.uptime_s = 3600;
+  metrics.heap_free = 50000;
+  metrics.heap_min = 42000;
+  metrics.heap_largest = 30000;
+  metrics.tasks = 3;
+  metrics.stack_free[0] = 900;
+  metrics.stack_free[1] = 600;
+  metrics.stack_free[2] = 1200;
+  metrics.queues = 2;
+  metrics.queue_depth[0] = 1;
+  metrics.queue_space[0] = 9;
+  metrics.queue_depth[1] = 0;
+  metrics.queue_space[1] = 5;
+  metrics.rssi = -71;
+  metrics.mqtt_connected = 1;
+  metrics.nvs_writes = 12;
+  metrics.journal_writes_hour = 3;
+
+  CHECK(health_Check(&metrics, &thresholds) == 0);
+  CHECK(health_Worst_Stack(&metrics) == 1);
+  CHECK(health_Format(&metrics, 0, HEALTH_STATE_IDLE, line, sizeof(line)) ==
+        (int)strlen(line));
+  CHECK(!strcmp(line, "3600.50000.42000.30000.600@1.1:9/0:5.1111.-71.0.1.12."
+                      "3.00.0"));
+
+  metrics.heap_free = 10000;
+  metrics.heap_largest = 4000;
+  metrics.stack_free[2] = 100;
+  metrics.queue_depth[1] = 5;
+  metrics.queue_space[1] = 0;
+  metrics.network_ok = 0;
+  metrics.qmtstat = 2;
+  CHECK(health_Check(&metrics, &thresholds) ==
+        (HEALTH_BREACH_HEAP | HEALTH_BREACH_HEAP_BLOCK | HEALTH_BREACH_STACK |
+         HEALTH_BREACH_QUEUE | HEALTH_BREACH_MODEM | HEALTH_BREACH_MQTT));
+  CHECK(health_Worst_Stack(&metrics) == 2);
+
+  /* em transferencia o MQTT nao conta, sem SIM o modem tambem nao */
+  metrics.busy = 1;
+  CHECK(!(health_Check(&metrics, &thresholds) & HEALTH_BREACH_MQTT));
+  metrics.sim_present = 0;
+  CHECK(!(health_Check(&metrics, &thresholds) &
+          (HEALTH_BREACH_MODEM | HEALTH_BREACH_MQTT)));
+
+  /* linha cortada devolve o tamanho que teria */
+  CHECK(health_Format(&metrics, 0x3F, HEALTH_STATE_NETWORK_FAILED, line, 10) >
+        9);
+  CHECK(strlen(line) == 9);
+
+  metrics.tasks = 0;
+  CHECK(health_Worst_Stack(&metrics) == 0xFF);
+}
+
+int main(void) {
+  test_Transitions();
+  test_MQTT();
+  test_Recovery_Path();
+  test_Check_Format();
+
+  HOST_TEST_END();
+}
@@ -0,0 +1,263 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "holiday_calendar.h"
+#include <string.h>
+
+/*
+ * Pascoa e feriados PT, ES, FR e US de 2000 a 2099. As datas da Pascoa vem
+ * de uma tabela (MMDD) feita com outro algoritmo (Gauss/Knuth) e conferida
+ * com datas publicadas; o dia da semana vem da contagem de dias desde
+ * 1/1/2000 (sabado), sem passar pelo holiday_calendar.c.
+ */
+
+#define FIRST_YEAR 2000
+#define YEARS 100
+
+static const uint16_t easter_Dates[YEARS] = {
+    423, 415, 331, 420, 411, 327, 416, 408, 323, 412, /* 2000 */
+    404, 424, 408, 331, 420, 405, 327, 416, 401, 421, /* 2010 */
+    412, 404, 417, 409, 331, 420, 405, 328, 416, 401, /* 2020 */
+    421, 413, 328, 417, 409, 325, 413, 405, 425, 410, /* 2030 */
+    401, 421, 406, 329, 417, 409, 325, 414, 405, 418, /* 2040 */
+    410, 402, 421, 406, 329, 418, 402, 422, 414, 330, /* 2050 */
+    418, 410, 326, 415, 406, 329, 411, 403, 422, 414, /* 2060 */
+    330, 419, 410, 326, 415, 407, 419, 411, 403, 423, /* 2070 */
+    407, 330, 419, 404, 326, 415, 331, 420, 411, 403, /* 2080 */
+    416, 408, 330, 412, 404, 424, 415, 331, 420, 412, /* 2090 */
+};
+
+/* regras esperadas pela ordem de cada tabela do holiday_calendar.c */
+typedef struct
+{
+  char kind;   /* 'E' Pascoa, 'F' fixo, 'N' n-esimo dia da semana */
+  int value;   /* E: dias a contar da Pascoa, F: MMDD, N: mes */
+  int nth;     /* N: 1 a 5 ou -1 = ultimo */
+  int weekday; /* N: 0 = domingo */
+
+} ref_rule;
+
+#define E(offset) {'E', offset, 0, 0}
+#define F(mmdd) {'F', mmdd, 0, 0}
+#define N(month, nth, weekday) {'N', month, nth, weekday}
+
+static const ref_rule ref_PT[] = {
+    E(-47),  E(-2),   E(0),    E(60),   E(1),    F(101),  F(425),  F(501),
+    F(610),  F(815),  F(1005), F(1101), F(1201), F(1208), F(1225),
+};
+
+static const ref_rule ref_ES[] = {
+    E(-2),   E(1),    E(-3),   F(101),  F(106),  F(501),
+    F(815),  F(1012), F(1101), F(1206), F(1208), F(1225),
+};
+
+static const ref_rule ref_FR[] = {
+    E(1),    E(39),   E(50),   F(101),  F(501),  F(508),
+    F(714),  F(815),  F(1101), F(1111), F(1225),
+};
+
+/* segundas (1) e a quinta (4) do Thanksgiving */
+static const ref_rule ref_US[] = {
+    N(1, 3, 1),  N(2, 3, 1), N(5, -1, 1), N(9, 1, 1), N(10, 2, 1), N(11, 4, 4),
+    F(101),      F(619),     F(704),      F(1111),    F(1225),
+};
+
+#define REF(country, rules) {country, rules, sizeof(rules) / sizeof(rules[0])}
+
+static const struct
+{
+  const char *country;
+  const ref_rule *rules;
+  int count;
+
+} ref_Packs[] = {
+    REF("PT", ref_PT),
+    REF("ES", ref_ES),
+    REF("FR", ref_FR),
+    REF("US", ref_US),
+};
+
+#define REF_PACKS (sizeof(ref_Packs) / sizeof(ref_Packs[0]))
+
+/* datas publicadas dos feriados US de n-esimo dia da semana */
+static const struct
+{
+  int year;
+  int rule;
+  int mmdd;
+
+} us_Dates[] = {
+    {2000, 0, 117},  /* MLK */
+    {2021, 2, 531},  /* Memorial Day num maio com cinco segundas */
+    {2026, 2, 525},  /* Memorial Day */
+    {2024, 4, 1014}, /* Columbus Day */
+    {2025, 3, 901},  /* Labor Day a 1 do mes */
+    {2026, 5, 1126}, /* Thanksgiving */
+};
+
+static int is_Leap(int year) {
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static int month_Days(int year, int month) {
+  static const int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+  return days[month - 1] + (month == 2 && is_Leap(year));
+}
+
+static int year_Day(int year, int mmdd) {
+  int day = mmdd % 100 - 1;
+
+  for (int month = 1; month < mmdd / 100; month++) {
+    day += month_Days(year, month);
+  }
+
+  return day;
+}
+
+/* 0 = domingo; 1/1/2000 foi sabado */
+static int week_Day(int year, int day) {
+  int days = day;
+
+  for (int y = FIRST_YEAR; y < year; y++) {
+    days += 365 + is_Leap(y);
+  }
+
+  return (6 + days) % 7;
+}
+
+static int nth_Day(int year, const ref_rule *rule) {
+  int first = year_Day(year, rule->value * 100 + 1);
+  int found = -1;
+  int seen = 0;
+
+  for (int d = 0; d < month_Days(year, rule->value); d++) {
+    if (week_Day(year, first + d) == rule->weekday) {
+      found = first + d;
+      if (++seen == rule->nth) {
+        break;
+      }
+    }
+  }
+
+  return found;
+}
+
+/* dia do ano da regra */
+static int expected_Day(int year, const ref_rule *rule) {
+  switch (rule->kind) {
+  case 'E':
+    return year_Day(year, easter_Dates[year - FIRST_YEAR]) + rule->value;
+  case 'F':
+    return year_Day(year, rule->value);
+  default:
+    return nth_Day(year, rule);
+  }
+}
+
+static int get_Day(const holiday_year *holidays, int day) {
+  return (holidays->days[day / 8] >> (day % 8)) & 1;
+}
+
+static void check_Year(const holiday_pack *pack, const ref_rule *rules,
+                       int year) {
+  holiday_year holidays;
+  holiday_year expected;
+  int day = 0;
+
+  /* cada regra sozinha liga so o seu dia */
+  memset(&expected, 0, sizeof(expected));
+  for (uint8_t rule = 0; rule < pack->count; rule++) {
+    int want = expected_Day(year, &rules[rule]);
+    int bits = 0;
+
+    CHECK(holiday_Rule_Day(&pack->rules[rule], year) == want);
+    if (holiday_Rule_Day(&pack->rules[rule], year) != want) {
+      printf("  %s %d regra %u: %d, esperado %d\n", pack->country, year, rule,
+             holiday_Rule_Day(&pack->rules[rule], year), want);
+    }
+
+    holiday_Compile_Year(&holidays, pack, 1UL << rule, year);
+    for (int i = 0; i < HOLIDAY_YEAR_BYTES; i++) {
+      bits += __builtin_popcount(holidays.days[i]);
+    }
+    CHECK(bits == 1 && get_Day(&holidays, want));
+
+    expected.days[want / 8] |= 1 << (want % 8);
+  }
+
+  /* todas ligadas: o mapa e a uniao (o Corpo de Deus pode calhar a 10/6) */
+  holiday_Compile_Year(&holidays, pack, 0xFFFFFFFF, year);
+  CHECK(holidays.year == year);
+  CHECK(!memcmp(holidays.days, expected.days, sizeof(expected.days)));
+
+  holiday_Compile_Year(&holidays, pack, 0, year);
+  for (int i = 0; i < HOLIDAY_YEAR_BYTES; i++) {
+    CHECK(holidays.days[i] == 0);
+  }
+
+  /* holiday_Is_Holiday em todos os dias do ano */
+  holiday_Compile_Year(&holidays, pack, 0xFFFFFFFF, year);
+  for (int m = 1; m <= 12; m++) {
+    for (int d = 1; d <= month_Days(year, m); d++, day++) {
+      struct tm t = {0};
+
+      t.tm_year = year - 1900;
+      t.tm_mon = m - 1;
+      t.tm_mday = d;
+
+      CHECK(holiday_Day_Of_Year(year, m, d) == day);
+      CHECK(holiday_Is_Holiday(&holidays, &t) == get_Day(&expected, day));
+
+      /* um mapa de outro ano nunca responde */
+      t.tm_year++;
+      CHECK(!holiday_Is_Holiday(&holidays, &t));
+    }
+  }
+  CHECK(day == 365 + is_Leap(year));
+}
+
+int main(void) {
+  const holiday_pack *us = holiday_Find_Pack("US");
+
+  CHECK(holiday_Find_Pack("XX") == NULL);
+  CHECK(us != NULL);
+
+  for (int year = FIRST_YEAR; year < FIRST_YEAR + YEARS; year++) {
+    int month = 0, mday = 0;
+
+    holiday_Easter(year, &month, &mday);
+    CHECK(month * 100 + mday == easter_Dates[year - FIRST_YEAR]);
+    if (month * 100 + mday != easter_Dates[year - FIRST_YEAR]) {
+      printf("  Pascoa %d: %d/%d\n", year, mday, month);
+    }
+
+    for (unsigned i = 0; i < REF_PACKS; i++) {
+      const holiday_pack *pack = holiday_Find_Pack(ref_Packs[i].country);
+
+      CHECK(pack != NULL && pack->count == ref_Packs[i].count);
+      if (pack != NULL && pack->count == ref_Packs[i].count) {
+        check_Year(pack, ref_Packs[i].rules, year);
+      }
+    }
+  }
+
+  /* a referencia tambem tem de bater com as datas publicadas */
+  for (unsigned i = 0; i < sizeof(us_Dates) / sizeof(us_Dates[0]); i++) {
+    int want = year_Day(us_Dates[i].year, us_Dates[i].mmdd);
+
+    CHECK(expected_Day(us_Dates[i].year, &ref_US[us_Dates[i].rule]) == want);
+    CHECK(holiday_Rule_Day(&us->rules[us_Dates[i].rule], us_Dates[i].year) ==
+          want);
+  }
+
+  HOST_TEST_END();
+}
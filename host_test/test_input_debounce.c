@@ -0,0 +1,204 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "input_debounce.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Filtro das entradas como o task_Inputs o usa: flancos da interrupcao,
+ * acordar quando input_Debounce_Wait manda e ler a linha. Rajadas de
+ * ressaltos, linha presa no nivel ativo e flancos com a hora perto das
+ * voltas dos contadores de 32 bits (us ao fim de ~71 min, ticks de 1 ms ao
+ * fim de ~49 dias); as horas sao int64 e o resultado tem de ser igual com
+ * qualquer origem.
+ */
+
+#define DEBOUNCE_US 20000
+#define TEST_EDGES 20000
+#define MAX_EDGES 64
+
+static const int64_t bases[] = {
+    0,
+    (1LL << 32) - 7000,          /* contador de us de 32 bits */
+    (1LL << 32) * 1000 - 7000,   /* tick de 1 ms de 32 bits */
+    (1LL << 62),
+};
+
+#define BASES (sizeof(bases) / sizeof(bases[0]))
+
+typedef struct
+{
+  int count;
+  int64_t time_us[MAX_EDGES];
+  uint8_t level[MAX_EDGES];
+
+} change_log;
+
+/*
+ * Corre os flancos (horas relativas a base, cada um troca o nivel da
+ * linha) como o task_Inputs: acorda em cada flanco ou quando o filtro diz
+ * que a linha ja pode ser lida.
+ */
+static void run(input_debounce *input, int64_t base, const int64_t *edges,
+                int count, uint8_t level, int64_t end, change_log *log) {
+  int next = 0;
+  int64_t now = base;
+
+  memset(log, 0, sizeof(change_log));
+
+  for (;;) {
+    int64_t wait = input_Debounce_Wait(input, now);
+    int64_t wake = wait < 0 ? base + end : now + wait;
+
+    if (next < count && base + edges[next] < wake) {
+      now = base + edges[next++];
+      level = !level;
+      input_Debounce_Edge(input, now);
+      continue;
+    }
+
+    if (wait < 0) {
+      return;
+    }
+
+    now = wake;
+    if (input_Debounce_Settle(input, level, now) && log->count < MAX_EDGES) {
+      log->time_us[log->count] = input->changed_us - base;
+      log->level[log->count] = input->level;
+      log->count++;
+    }
+  }
+}
+
+static void test_Bounce(int64_t base) {
+  /* carregar com 5 flancos em 2,2 ms e largar com 3 em 0,7 ms */
+  static const int64_t edges[] = {
+      1000, 1400, 1900, 2500, 3200, 90000, 90300, 90700,
+  };
+  input_debounce input;
+  change_log log;
+
+  input_Debounce_Init(&input, 0, DEBOUNCE_US);
+  CHECK(input_Debounce_Wait(&input, base) == -1);
+
+  input_Debounce_Edge(&input, base + 1000);
+  CHECK(input_Debounce_Wait(&input, base + 1000) == DEBOUNCE_US);
+  input_Debounce_Edge(&input, base + 4000);
+  CHECK(input_Debounce_Wait(&input, base + 5000) == DEBOUNCE_US - 1000);
+
+  /* cedo demais: nada muda */
+  CHECK(!input_Debounce_Settle(&input, 1, base + 4000 + DEBOUNCE_US - 1));
+  CHECK(input.level == 0 && input.state == INPUT_DEBOUNCE_SETTLING);
+
+  input_Debounce_Init(&input, 0, DEBOUNCE_US);
+  run(&input, base, edges, 8, 0, 200000, &log);
+  CHECK(log.count == 2);
+  /* hora do primeiro flanco de cada rajada */
+  CHECK(log.time_us[0] == 1000 && log.level[0] == 1);
+  CHECK(log.time_us[1] == 90000 && log.level[1] == 0);
+  CHECK(input.glitches == 0);
+  CHECK(input_Debounce_Wait(&input, base + 200000) == -1);
+}
+
+static void test_Glitch(int64_t base) {
+  /* pico curto que volta ao mesmo nivel */
+  static const int64_t edges[] = {5000, 5200, 30000, 30100, 30200, 30300};
+  input_debounce input;
+  change_log log;
+
+  input_Debounce_Init(&input, 1, DEBOUNCE_US);
+  run(&input, base, edges, 6, 1, 100000, &log);
+  CHECK(log.count == 0);
+  CHECK(input.glitches == 2 && input.level == 1);
+}
+
+static void test_Stuck_Low(int64_t base) {
+  static int64_t edges[MAX_EDGES];
+  input_debounce input;
+  change_log log;
+  int count = 0;
+
+  /* entrada ativa a baixo presa: um flanco e depois nada durante horas */
+  edges[count++] = 1000;
+  input_Debounce_Init(&input, 0, DEBOUNCE_US);
+  run(&input, base, edges, count, 0, 3600LL * 1000000, &log);
+  CHECK(log.count == 1 && log.level[0] == 1 && log.time_us[0] == 1000);
+  /* sem flancos o task dorme, nao ha leituras a repetir o estado */
+  CHECK(input_Debounce_Wait(&input, base + 3600LL * 1000000) == -1);
+
+  /* ruido continuo a menos de DEBOUNCE_US: so le quando para */
+  count = 0;
+  for (int64_t t = 1000; count < 41; t += DEBOUNCE_US / 2) {
+    edges[count++] = t;
+  }
+  input_Debounce_Init(&input, 0, DEBOUNCE_US);
+  run(&input, base, edges, count, 0, 10000000, &log);
+  CHECK(log.count == 1 && log.level[0] == 1 && log.time_us[0] == 1000);
+  CHECK(input.glitches == 0);
+}
+
+/* flancos aleatorios contra um modelo: rajadas separadas por mais de
+   DEBOUNCE_US mudam o estado se acabam noutro nivel */
+static void test_Random(int64_t base, unsigned seed) {
+  static int64_t edges[TEST_EDGES];
+  static change_log log;
+  input_debounce input;
+  int64_t t = 0;
+  int expected = 0;
+  int64_t expected_Time[MAX_EDGES];
+  uint8_t level = 0;
+  uint8_t stable = 0;
+  int64_t burst = 0;
+
+  srand(seed);
+  for (int i = 0; i < MAX_EDGES * 2; i++) {
+    /* mais de metade das vezes ressalto, senao linha parada */
+    t += rand() % 3 ? 1 + rand() % (DEBOUNCE_US - 1)
+                    : DEBOUNCE_US + 1 + rand() % 200000;
+    edges[i] = t;
+  }
+
+  for (int i = 0; i < MAX_EDGES * 2; i++) {
+    if (i == 0 || edges[i] - edges[i - 1] > DEBOUNCE_US) {
+      burst = edges[i];
+    }
+    level = !level;
+    if (i == MAX_EDGES * 2 - 1 || edges[i + 1] - edges[i] > DEBOUNCE_US) {
+      if (level != stable && expected < MAX_EDGES) {
+        expected_Time[expected++] = burst;
+      }
+      stable = level;
+    }
+  }
+
+  input_Debounce_Init(&input, 0, DEBOUNCE_US);
+  run(&input, base, edges, MAX_EDGES * 2, 0, t + 1000000, &log);
+  CHECK(log.count == expected);
+  for (int i = 0; i < expected && i < log.count; i++) {
+    CHECK(log.time_us[i] == expected_Time[i]);
+    CHECK(log.level[i] == !(i % 2));
+  }
+  CHECK(input.level == stable);
+}
+
+int main(void) {
+  for (unsigned b = 0; b < BASES; b++) {
+    test_Bounce(bases[b]);
+    test_Glitch(bases[b]);
+    test_Stuck_Low(bases[b]);
+    for (unsigned seed = 1; seed <= TEST_EDGES / (MAX_EDGES * 2); seed++) {
+      test_Random(bases[b], seed);
+    }
+  }
+
+  HOST_TEST_END();
+}
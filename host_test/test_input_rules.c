@@ -0,0 +1,205 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "input_rules.h"
+#include <string.h>
+
+/*
+ * Regras das entradas: lugares reservados ao REX, texto do SMS pelo
+ * flanco e regras sobrepostas (mesma entrada, janelas que passam a
+ * meia-noite, dias da semana e condicoes) contra uma avaliacao direta de
+ * todas as regras em todos os minutos da semana.
+ */
+
+static const char *rules_Text[] = {
+    "1.R.0800.1800.0111110.*.P1:3000",
+    "1.A.*.*.*.*.S13+M",
+    "1.F.2200.0600.*.*.S2",
+    "1.R.2200.0600.1000001.I21.B",
+    "1.R.0000.2359.*.R10.X2",
+    "2.F.*.*.*.*.S6",
+    "2.A.1200.1200.0010000.I11.M+B",
+    "2.R.1800.0800.*.R21.P2:500",
+};
+
+#define RULES (sizeof(rules_Text) / sizeof(rules_Text[0]))
+
+/* avaliacao direta, sem os indices por entrada e flanco */
+static uint16_t reference_Match(const input_rules *rules,
+                                const input_rules_event *event) {
+  uint16_t matched = 0;
+
+  for (uint8_t i = 0; i < rules->count; i++) {
+    const input_rule *rule = &rules->rules[i];
+    uint8_t edge = event->level ? INPUT_RULE_EDGE_RISE : INPUT_RULE_EDGE_FALL;
+    uint8_t window = rule->from_min <= rule->to_min
+                         ? event->minute >= rule->from_min &&
+                               event->minute <= rule->to_min
+                         : event->minute >= rule->from_min ||
+                               event->minute <= rule->to_min;
+    uint8_t levels = rule->cond_type == INPUT_RULE_COND_INPUT ? event->inputs
+                                                              : event->relays;
+
+    if (rule->input == event->input && (rule->edges & edge) && window &&
+        ((rule->week >> event->wday) & 1) &&
+        (rule->cond_type == INPUT_RULE_COND_NONE ||
+         ((levels >> rule->cond_index) & 1) == rule->cond_level)) {
+      matched |= 1 << i;
+    }
+  }
+
+  return matched;
+}
+
+static void join(char *text, size_t size, int count) {
+  text[0] = 0;
+  for (int i = 0; i < count; i++) {
+    strncat(text, rules_Text[i % RULES], size - strlen(text) - 2);
+    strcat(text, ";");
+  }
+}
+
+static void test_Rex_Slots(void) {
+  input_rules rules;
+  input_rules before;
+  char text[1024];
+  input_rules_event event = {.input = 1, .level = 1, .minute = 600, .wday = 1};
+  uint16_t mask = 0;
+
+  /* sem REX (255 = chave nao existe) nada e acrescentado */
+  join(text, sizeof(text), 3);
+  CHECK(input_Rules_Compile_Rex(&rules, text, 255) == 3);
+  CHECK(input_Rules_Compile_Rex(&rules, text, 0) == 3);
+
+  /* com as regras todas o REX ainda cabe no fim */
+  join(text, sizeof(text), INPUT_RULES_USER_MAX);
+  CHECK(input_Rules_Compile_Rex(&rules, text, 3) == INPUT_RULES_MAX);
+  CHECK(rules.rules[INPUT_RULES_MAX - 2].input == 1);
+  CHECK(rules.rules[INPUT_RULES_MAX - 2].actions == INPUT_RULE_ACTION_REX);
+  CHECK(rules.rules[INPUT_RULES_MAX - 2].rex_relay == 1);
+  CHECK(rules.rules[INPUT_RULES_MAX - 2].edges == INPUT_RULE_EDGE_RISE);
+  CHECK(rules.rules[INPUT_RULES_MAX - 1].input == 2);
+  CHECK(rules.rules[INPUT_RULES_MAX - 1].rex_relay == 2);
+
+  /* o REX da entrada 1 dispara so na ativacao da entrada 1 */
+  mask = input_Rules_Match(&rules, &event);
+  CHECK((mask >> (INPUT_RULES_MAX - 2)) & 1);
+  CHECK(!((mask >> (INPUT_RULES_MAX - 1)) & 1));
+  event.level = 0;
+  CHECK(!((input_Rules_Match(&rules, &event) >> (INPUT_RULES_MAX - 2)) & 1));
+
+  CHECK(input_Rules_Compile_Rex(&rules, text, 2) == INPUT_RULES_USER_MAX + 1);
+  CHECK(rules.rules[INPUT_RULES_USER_MAX].rex_relay == 2);
+
+  /* uma regra a mais ocupava o lugar do REX: recusada e nada muda */
+  memcpy(&before, &rules, sizeof(rules));
+  join(text, sizeof(text), INPUT_RULES_USER_MAX + 1);
+  CHECK(input_Rules_Compile_Rex(&rules, text, 3) == -1);
+  CHECK(input_Rules_Compile_Rex(&rules, text, 0) == -1);
+  CHECK(!memcmp(&before, &rules, sizeof(rules)));
+
+  /* sem REX a tabela aceita as INPUT_RULES_MAX */
+  join(text, sizeof(text), INPUT_RULES_MAX);
+  CHECK(input_Rules_Compile(&rules, text) == INPUT_RULES_MAX);
+  join(text, sizeof(text), INPUT_RULES_MAX + 1);
+  CHECK(input_Rules_Compile(&rules, text) == -1);
+
+  /* texto com erros tambem nao muda nada */
+  memcpy(&before, &rules, sizeof(rules));
+  CHECK(input_Rules_Compile_Rex(&rules, "1.R.*.*.*.*.X3", 3) == -1);
+  CHECK(input_Rules_Compile_Rex(&rules, "3.R.*.*.*.*.M", 0) == -1);
+  CHECK(input_Rules_Compile_Rex(&rules, "1.R.2400.*.*.*.M", 0) == -1);
+  CHECK(input_Rules_Compile_Rex(&rules, "1.R.*.*.*.*.S7", 0) == -1);
+  CHECK(!memcmp(&before, &rules, sizeof(rules)));
+}
+
+static void test_SMS_Edge(void) {
+  input_rules rules;
+  input_rules_event event = {.minute = 0, .wday = 0};
+
+  CHECK(!strcmp(input_Rules_SMS_Message(1, 1), "INPUT_HAS_BEEN_ACTIVATED1"));
+  CHECK(!strcmp(input_Rules_SMS_Message(1, 0), "INPUT_HAS_BEEN_DEACTIVATED1"));
+  CHECK(!strcmp(input_Rules_SMS_Message(2, 1), "INPUT_HAS_BEEN_ACTIVATED2"));
+  CHECK(!strcmp(input_Rules_SMS_Message(2, 0), "INPUT_HAS_BEEN_DEACTIVATED2"));
+
+  /* a regra de ambos os flancos manda SMS nos dois, cada um com o seu
+     texto; a de desativacao so no segundo */
+  CHECK(input_Rules_Compile(&rules, "1.A.*.*.*.*.S13;1.F.*.*.*.*.S2") == 2);
+  CHECK(rules.rules[0].sms_slots == 0x05);
+  CHECK(rules.rules[1].sms_slots == 0x02);
+
+  event.input = 1;
+  event.level = 1;
+  CHECK(input_Rules_Match(&rules, &event) == 0x01);
+  event.level = 0;
+  CHECK(input_Rules_Match(&rules, &event) == 0x03);
+  event.input = 2;
+  CHECK(input_Rules_Match(&rules, &event) == 0);
+}
+
+static void test_Overlapping(void) {
+  input_rules rules;
+  char text[1024];
+  int checked = 0;
+  int multiple = 0;
+
+  join(text, sizeof(text), RULES);
+  CHECK(input_Rules_Compile(&rules, text) == (int)RULES);
+
+  for (uint8_t input = 0; input <= 3; input++) {
+    for (uint8_t level = 0; level < 2; level++) {
+      for (uint8_t wday = 0; wday < 7; wday++) {
+        for (uint16_t minute = 0; minute < 1440; minute++) {
+          for (uint8_t levels = 0; levels < 16; levels++) {
+            input_rules_event event = {
+                .input = input,
+                .level = level,
+                .minute = minute,
+                .wday = wday,
+                .inputs = levels & 3,
+                .relays = levels >> 2,
+            };
+            uint16_t mask = input_Rules_Match(&rules, &event);
+
+            CHECK(mask == reference_Match(&rules, &event));
+            if (mask != reference_Match(&rules, &event)) {
+              printf("  I%d %d dia %d %02d:%02d niveis %x: %x\n", input,
+                     level, wday, minute / 60, minute % 60, levels, mask);
+              return;
+            }
+            checked++;
+            multiple += __builtin_popcount(mask) > 1;
+          }
+        }
+      }
+    }
+  }
+
+  /* janelas de meia-noite: 1.F das 22h as 6h */
+  input_rules_event night = {.input = 1, .level = 0, .minute = 23 * 60};
+  CHECK(input_Rules_Match(&rules, &night) & 0x04);
+  night.minute = 6 * 60;
+  CHECK(input_Rules_Match(&rules, &night) & 0x04);
+  night.minute = 6 * 60 + 1;
+  CHECK(!(input_Rules_Match(&rules, &night) & 0x04));
+
+  /* ha de facto eventos com varias regras ao mesmo tempo */
+  CHECK(multiple > 0);
+  CHECK(checked == 4 * 2 * 7 * 1440 * 16);
+}
+
+int main(void) {
+  test_Rex_Slots();
+  test_SMS_Edge();
+  test_Overlapping();
+
+  HOST_TEST_END();
+}
@@ -0,0 +1,151 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "log_lzss.h"
+#include "log_record.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * LZSS do log_upload.c ida e volta sobre blocos de registos como os que
+ * o task_SDCard_Log_Writer escreve (poucos utilizadores, epochs
+ * crescentes), mais os casos limite e fluxos truncados ou corrompidos.
+ */
+
+#define CHUNK_RECORDS 32
+#define CHUNK_RAW (CHUNK_RECORDS * sizeof(sdCard_Log_Record))
+/* pior caso: todos literais, 9 bits por byte */
+#define CHUNK_MAX (CHUNK_RAW + CHUNK_RAW / 8 + 1)
+#define TEST_CHUNKS 400
+
+static const char *users[][2] = {
+    {"+351912345678", "Joao Silva"},   {"+351934567890", "Maria Costa"},
+    {"+351965432109", "Portaria"},     {"+34612345678", "Luis Garcia"},
+    {"+351911111111", "Armazem"},      {"4A3F00C1", "Cartao 17"},
+    {"4A3F00C2", "Cartao 18"},         {"RF:00A1B2C3", "Comando 3"},
+    {"+351926000001", "Administrador"}, {"", ""},
+};
+
+static const uint8_t sources[] = {
+    SDCARD_LOG_SOURCE_BLE,     SDCARD_LOG_SOURCE_SMS,
+    SDCARD_LOG_SOURCE_CALL,    SDCARD_LOG_SOURCE_WEB,
+    SDCARD_LOG_SOURCE_RF,      SDCARD_LOG_SOURCE_REX1,
+    SDCARD_LOG_SOURCE_READER1,
+};
+
+static uint32_t fnv1a(const char *text) {
+  uint32_t hash = 2166136261u;
+
+  while (*text) {
+    hash = (hash ^ (uint8_t)*text++) * 16777619u;
+  }
+
+  return hash;
+}
+
+static void make_Chunk(sdCard_Log_Record *records, uint32_t *epoch) {
+  memset(records, 0, CHUNK_RAW);
+
+  for (int i = 0; i < CHUNK_RECORDS; i++) {
+    int user = rand() % (sizeof(users) / sizeof(users[0]));
+    sdCard_Log_Record *record = &records[i];
+
+    *epoch += 5 + rand() % 600;
+    record->epoch = *epoch;
+    record->source = sources[rand() % sizeof(sources)];
+    record->relay = 1 + rand() % 2;
+    record->state = rand() % 2;
+    record->name_kind = user < 5 ? 1 : 2;
+    record->result = rand() % 10 == 0 ? 1 << (rand() % 6) : 0;
+    record->month = 1 + (*epoch / 2629800) % 12;
+    strncpy(record->credential, users[user][0], sizeof(record->credential));
+    strncpy(record->name, users[user][1], sizeof(record->name));
+    record->cred_hash = fnv1a(users[user][0]);
+  }
+}
+
+static size_t round_Trip(const uint8_t *raw, size_t raw_len) {
+  static uint8_t packed[CHUNK_MAX];
+  static uint8_t unpacked[CHUNK_RAW];
+  size_t n = log_Upload_Compress(raw, raw_len, packed, sizeof(packed));
+
+  CHECK(raw_len == 0 || n > 0);
+  CHECK(n <= raw_len + raw_len / 8 + 1);
+  CHECK(log_Upload_Decompress(packed, n, unpacked, raw_len) == raw_len);
+  CHECK(!memcmp(unpacked, raw, raw_len));
+
+  /* qualquer fluxo cortado antes do fim falha em vez de inventar bytes */
+  if (n > 1) {
+    size_t cut = rand() % (n - 1);
+
+    if (log_Upload_Decompress(packed, cut, unpacked, raw_len) != 0) {
+      /* so pode ser aceite se os bits que faltam eram enchimento */
+      CHECK(cut == n - 1 && !memcmp(unpacked, raw, raw_len));
+    }
+  }
+
+  return n;
+}
+
+int main(void) {
+  static sdCard_Log_Record records[CHUNK_RECORDS];
+  static uint8_t raw[CHUNK_RAW];
+  static uint8_t packed[CHUNK_MAX];
+  static uint8_t unpacked[CHUNK_RAW];
+  uint32_t epoch = 1735689600;
+  size_t raw_Bytes = 0;
+  size_t packed_Bytes = 0;
+  size_t n;
+
+  CHECK(sizeof(sdCard_Log_Record) == 64);
+
+  srand(36);
+  for (int chunk = 0; chunk < TEST_CHUNKS; chunk++) {
+    make_Chunk(records, &epoch);
+    raw_Bytes += CHUNK_RAW;
+    packed_Bytes += round_Trip((const uint8_t *)records, CHUNK_RAW);
+  }
+
+  /* registos reais comprimem bem mais do que 2:1 */
+  CHECK(raw_Bytes >= 2 * packed_Bytes);
+  printf("%d blocos de %d registos, %zu -> %zu bytes (%.2f:1)\n", TEST_CHUNKS,
+         CHUNK_RECORDS, raw_Bytes, packed_Bytes,
+         (double)raw_Bytes / packed_Bytes);
+
+  /* vazio, um byte, tudo igual (copias sobrepostas) e aleatorio */
+  round_Trip(raw, 0);
+  raw[0] = 'x';
+  round_Trip(raw, 1);
+  memset(raw, 0xAA, sizeof(raw));
+  CHECK(round_Trip(raw, sizeof(raw)) < sizeof(raw) / 8);
+  for (size_t i = 0; i < sizeof(raw); i++) {
+    raw[i] = rand();
+  }
+  round_Trip(raw, sizeof(raw));
+  for (size_t len = 1; len < 300; len += 7) {
+    round_Trip(raw, len);
+  }
+
+  /* sem espaco de saida a compressao devolve 0 */
+  CHECK(log_Upload_Compress(raw, sizeof(raw), packed, 16) == 0);
+
+  /* copia logo no inicio: distancia antes do primeiro byte */
+  memset(packed, 0, sizeof(packed));
+  CHECK(log_Upload_Decompress(packed, 4, unpacked, 8) == 0);
+
+  /* 'a' seguido de uma copia de 33 bytes nao cabe em raw_len 20 */
+  memset(raw, 'a', 34);
+  n = log_Upload_Compress(raw, 34, packed, sizeof(packed));
+  CHECK(n > 0);
+  CHECK(log_Upload_Decompress(packed, n, unpacked, 20) == 0);
+
+  HOST_TEST_END();
+}
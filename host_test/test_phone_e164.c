@@ -0,0 +1,127 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "phone_e164.h"
+#include <string.h>
+
+typedef struct
+{
+  const char *input;
+  const char *country;
+  const char *e164; /* NULL = rejeitado */
+
+} phone_case;
+
+/* corpus de normalizacao: formatos que chegam por SMS, BLE, UDP e CLIP */
+static const phone_case phone_Corpus[] = {
+    /* ja internacionais */
+    {"+351912345678", "351", "+351912345678"},
+    {"00351912345678", "351", "+351912345678"},
+    {"+44 20 7946 0958", "351", "+442079460958"},
+    {"0044 (20) 7946-0958", "351", "+442079460958"},
+    {"+1-868-555-0142", "351", "+18685550142"},
+    {"+351 912 345 678", "34", "+351912345678"},
+    /* CLIP sem '+' */
+    {"351912345678", "351", "+351912345678"},
+    {"34612345678", "34", "+34612345678"},
+    /* nacionais, com e sem '0' de tronco */
+    {"912345678", "351", "+351912345678"},
+    {"912 345 678", "351", "+351912345678"},
+    {"912.345.678", "351", "+351912345678"},
+    {"0612345678", "33", "+33612345678"},
+    {"612345678", "33", "+33612345678"},
+    {"07700 900123", "44", "+447700900123"},
+    {"(868) 555-0142", "1-868", "+18688685550142"},
+    {"5550142", "1-868", "+18685550142"},
+    /* comeca pelo indicativo mas e curto: continua nacional */
+    {"35123456", "351", "+35135123456"},
+    /* rejeitados */
+    {"$12345678", "351", NULL},
+    {"&A1B2C3", "351", NULL},
+    {"91234+5678", "351", NULL},
+    {"12345", "", NULL},
+    {"", "351", NULL},
+    {"+12345", "351", NULL},
+    {"+3519123456789012", "351", NULL},
+    {"00351912345678901234567", "351", NULL},
+    {"9123456789012345678901234", "351", NULL},
+};
+
+static void test_Corpus() {
+  char e164[PHONE_E164_SIZE];
+
+  for (size_t i = 0; i < sizeof(phone_Corpus) / sizeof(phone_Corpus[0]); i++) {
+    const phone_case *c = &phone_Corpus[i];
+    uint8_t ok;
+
+    memset(e164, 0, sizeof(e164));
+    ok = phone_Normalize_E164(c->input, c->country, e164);
+
+    if (c->e164 == NULL) {
+      if (ok) {
+        printf("\"%s\" (%s) devia ser rejeitado, deu %s\n", c->input,
+               c->country, e164);
+      }
+      CHECK(!ok);
+    } else {
+      if (!ok || strcmp(e164, c->e164)) {
+        printf("\"%s\" (%s) -> \"%s\", esperado \"%s\"\n", c->input,
+               c->country, ok ? e164 : "(rejeitado)", c->e164);
+      }
+      CHECK(ok && !strcmp(e164, c->e164));
+    }
+  }
+}
+
+/* o mesmo numero em todas as formas tem de dar a mesma chave */
+static void test_Same_Number() {
+  const char *forms[] = {"+351 912 345 678", "00351912345678", "351912345678",
+                         "912345678", "0912345678"};
+  char first[PHONE_E164_SIZE];
+  char e164[PHONE_E164_SIZE];
+
+  CHECK(phone_Normalize_E164(forms[0], "351", first));
+
+  for (size_t i = 1; i < sizeof(forms) / sizeof(forms[0]); i++) {
+    CHECK(phone_Normalize_E164(forms[i], "351", e164) && !strcmp(e164, first));
+  }
+}
+
+static void test_BCD() {
+  uint8_t bcd[PHONE_BCD_SIZE];
+  const uint8_t odd[PHONE_BCD_SIZE] = {0x35, 0x19, 0x12, 0x34, 0x56,
+                                       0x78, 0xFF, 0xFF};
+  const uint8_t even[PHONE_BCD_SIZE] = {0x44, 0x20, 0x79, 0x46, 0x09,
+                                        0x58, 0xFF, 0xFF};
+  uint8_t other[PHONE_BCD_SIZE];
+
+  CHECK(phone_E164_To_BCD("+351912345678", bcd) && !memcmp(bcd, odd, sizeof(bcd)));
+  CHECK(phone_E164_To_BCD("+442079460958", bcd) && !memcmp(bcd, even, sizeof(bcd)));
+
+  /* 15 digitos e o maximo E.164, cabem nos 8 octetos */
+  CHECK(phone_E164_To_BCD("+123456789012345", bcd) && bcd[7] == 0x5F);
+  CHECK(!phone_E164_To_BCD("+1234567890123456789", bcd));
+  CHECK(!phone_E164_To_BCD("+35191234567A", bcd));
+  CHECK(!phone_E164_To_BCD("+", bcd));
+
+  /* numeros que so diferem no comprimento nao colidem */
+  CHECK(phone_E164_To_BCD("+35191234567", bcd));
+  CHECK(phone_E164_To_BCD("+351912345670", other));
+  CHECK(memcmp(bcd, other, sizeof(bcd)));
+}
+
+int main() {
+  test_Corpus();
+  test_Same_Number();
+  test_BCD();
+
+  HOST_TEST_END();
+}
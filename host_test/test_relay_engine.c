@@ -0,0 +1,264 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "relay_engine.h"
+#include <string.h>
+
+/*
+ * Motor dos reles tick a tick: redisparo de impulsos, trens de impulsos,
+ * encravamento entre dois canais, acoes agendadas e escrita diferida da
+ * ultima posicao. A saida de cada canal e registada com o tick em que
+ * mudou.
+ */
+
+#define PERSIST_DELAY 1000
+#define LOG_MAX 64
+
+typedef struct
+{
+  uint32_t tick;
+  uint8_t channel;
+  uint8_t level;
+
+} output_change;
+
+typedef struct
+{
+  relay_engine *engine;
+  uint8_t levels[RELAY_ENGINE_CHANNELS];
+  output_change log[LOG_MAX];
+  int count;
+  int both_on;
+
+} output_log;
+
+static void output(uint8_t channel, uint8_t level, void *ctx) {
+  output_log *log = (output_log *)ctx;
+
+  log->levels[channel] = level;
+  if (log->count < LOG_MAX) {
+    log->log[log->count].tick = log->engine->wheel.now;
+    log->log[log->count].channel = channel;
+    log->log[log->count].level = level;
+    log->count++;
+  }
+
+  /* canais 0 e 1 encravados */
+  if (log->levels[0] && log->levels[1]) {
+    log->both_on++;
+  }
+}
+
+static void setup(relay_engine *engine, output_log *log, uint32_t now) {
+  memset(log, 0, sizeof(output_log));
+  log->engine = engine;
+  relay_Engine_Init(engine, now, PERSIST_DELAY, output, log);
+}
+
+/* avanca tick a tick ate now */
+static void run(relay_engine *engine, uint32_t now) {
+  while ((int32_t)(now - engine->wheel.now) > 0) {
+    relay_Engine_Advance(engine, engine->wheel.now + 1);
+  }
+}
+
+static int pop(relay_engine *engine, uint8_t channel, uint8_t type,
+               uint8_t level) {
+  relay_engine_event event;
+
+  if (!relay_Engine_Pop_Event(engine, &event)) {
+    return 0;
+  }
+
+  return event.channel == channel && event.type == type && event.level == level;
+}
+
+static void drain(relay_engine *engine) {
+  relay_engine_event event;
+
+  while (relay_Engine_Pop_Event(engine, &event)) {
+  }
+}
+
+static void test_Pulse_Retrigger(void) {
+  relay_engine engine;
+  output_log log;
+
+  setup(&engine, &log, 0xFFFFFF00);
+
+  relay_Engine_Pulse(&engine, 0, 100);
+  CHECK(log.levels[0] == 1 && relay_Engine_Is_Pulsing(&engine, 0));
+  CHECK(pop(&engine, 0, RELAY_EVENT_PULSE_START, 1));
+  CHECK(relay_Engine_Next(&engine) == 100);
+
+  /* a meio do impulso o tempo volta a contar do inicio */
+  run(&engine, 0xFFFFFF00 + 60);
+  relay_Engine_Pulse(&engine, 0, 100);
+  CHECK(pop(&engine, 0, RELAY_EVENT_PULSE_RENEWED, 1));
+  run(&engine, 0xFFFFFF00 + 159);
+  CHECK(log.levels[0] == 1 && log.count == 1);
+  run(&engine, 0xFFFFFF00 + 160);
+  CHECK(log.levels[0] == 0 && !relay_Engine_Is_Pulsing(&engine, 0));
+  CHECK(log.count == 2 && log.log[1].tick == 0xFFFFFF00 + 160);
+  CHECK(pop(&engine, 0, RELAY_EVENT_PULSE_END, 0));
+
+  /* acabado o impulso um novo comeca de novo */
+  relay_Engine_Pulse(&engine, 0, 10);
+  CHECK(pop(&engine, 0, RELAY_EVENT_PULSE_START, 1));
+
+  /* Set a meio do impulso para-o */
+  relay_Engine_Set(&engine, 0, 0);
+  CHECK(!relay_Engine_Is_Pulsing(&engine, 0) && log.levels[0] == 0);
+  run(&engine, engine.wheel.now + 20);
+  CHECK(log.count == 4);
+  CHECK(!pop(&engine, 0, RELAY_EVENT_PULSE_END, 0));
+}
+
+static void test_Train(void) {
+  relay_engine engine;
+  output_log log;
+  /* 3 impulsos de 20 ticks com 30 desligado entre eles */
+  static const output_change expected[] = {
+      {0, 1, 1}, {20, 1, 0}, {50, 1, 1}, {70, 1, 0}, {100, 1, 1}, {120, 1, 0},
+  };
+
+  setup(&engine, &log, 0);
+  relay_Engine_Train(&engine, 1, 3, 20, 30);
+  run(&engine, 500);
+
+  CHECK(log.count == 6);
+  for (int i = 0; i < 6 && i < log.count; i++) {
+    CHECK(log.log[i].tick == expected[i].tick);
+    CHECK(log.log[i].level == expected[i].level);
+  }
+  CHECK(pop(&engine, 1, RELAY_EVENT_PULSE_START, 1));
+  CHECK(pop(&engine, 1, RELAY_EVENT_PULSE_END, 0));
+
+  /* redisparo na fase desligada so repoe o numero de impulsos */
+  setup(&engine, &log, 0);
+  relay_Engine_Train(&engine, 1, 2, 20, 30);
+  run(&engine, 30);
+  relay_Engine_Train(&engine, 1, 2, 20, 30);
+  CHECK(pop(&engine, 1, RELAY_EVENT_PULSE_START, 1));
+  CHECK(pop(&engine, 1, RELAY_EVENT_PULSE_RENEWED, 0));
+  run(&engine, 500);
+  /* 0..20, 50..70, 100..120: tres impulsos em vez de dois */
+  CHECK(log.count == 6);
+  CHECK(log.count == 6 && log.log[5].tick == 120);
+}
+
+static void test_Interlock(void) {
+  relay_engine engine;
+  output_log log;
+
+  setup(&engine, &log, 1000);
+  relay_Engine_Interlock(&engine, 0, 1);
+
+  relay_Engine_Set(&engine, 0, 1);
+  CHECK(log.levels[0] == 1);
+
+  /* ligar o 1 desliga primeiro o 0 */
+  relay_Engine_Pulse(&engine, 1, 50);
+  CHECK(log.levels[0] == 0 && log.levels[1] == 1);
+  CHECK(pop(&engine, 0, RELAY_EVENT_INTERLOCK, 0));
+  CHECK(pop(&engine, 1, RELAY_EVENT_PULSE_START, 1));
+
+  /* e o 0 a meio do impulso do 1 para o impulso */
+  run(&engine, 1020);
+  relay_Engine_Set(&engine, 0, 1);
+  CHECK(log.levels[1] == 0 && !relay_Engine_Is_Pulsing(&engine, 1));
+  CHECK(pop(&engine, 1, RELAY_EVENT_INTERLOCK, 0));
+  run(&engine, 1100);
+  CHECK(log.levels[0] == 1);
+
+  /* um trem desliga o outro canal e ligar o outro na fase desligada do
+     trem tambem o para */
+  relay_Engine_Train(&engine, 1, 3, 10, 10);
+  CHECK(log.levels[0] == 0);
+  run(&engine, 1115);
+  CHECK(log.levels[1] == 0 && relay_Engine_Is_Pulsing(&engine, 1));
+  relay_Engine_Set(&engine, 0, 1);
+  CHECK(!relay_Engine_Is_Pulsing(&engine, 1));
+  run(&engine, 1150);
+  CHECK(log.levels[0] == 1 && log.levels[1] == 0);
+  CHECK(log.both_on == 0);
+
+  /* desfeito o encravamento os dois podem estar ligados */
+  run(&engine, 1200);
+  relay_Engine_Interlock(&engine, 0, RELAY_ENGINE_NONE);
+  CHECK(engine.channels[1].interlock == RELAY_ENGINE_NONE);
+  relay_Engine_Set(&engine, 0, 1);
+  relay_Engine_Set(&engine, 1, 1);
+  CHECK(log.both_on == 1);
+
+  /* encravar com outro canal solta o par antigo */
+  relay_Engine_Interlock(&engine, 0, 1);
+  relay_Engine_Interlock(&engine, 1, 2);
+  CHECK(engine.channels[0].interlock == RELAY_ENGINE_NONE);
+  CHECK(engine.channels[2].interlock == 1);
+}
+
+static void test_Schedule_Persist(void) {
+  relay_engine engine;
+  output_log log;
+
+  setup(&engine, &log, 0);
+  relay_Engine_Restore(&engine, 2, 0, 0);
+
+  /* rajada que volta ao valor guardado nao escreve nada */
+  relay_Engine_Set(&engine, 2, 1);
+  run(&engine, 500);
+  relay_Engine_Set(&engine, 2, 0);
+  run(&engine, 3000);
+  drain(&engine);
+  CHECK(relay_Engine_Next(&engine) == TIMER_WHEEL_NONE);
+
+  /* so o ultimo valor, PERSIST_DELAY depois da ultima mudanca */
+  relay_Engine_Set(&engine, 2, 1);
+  run(&engine, 3500);
+  relay_Engine_Set(&engine, 2, 1);
+  drain(&engine);
+  run(&engine, 3500 + PERSIST_DELAY - 1);
+  CHECK(!pop(&engine, 2, RELAY_EVENT_PERSIST, 1));
+  run(&engine, 3500 + PERSIST_DELAY);
+  CHECK(pop(&engine, 2, RELAY_EVENT_PERSIST, 1));
+  CHECK(engine.channels[2].persisted == 1);
+
+  /* acao agendada cancelada nao dispara, a seguinte sim */
+  relay_Engine_Schedule(&engine, 3, 1, 200);
+  relay_Engine_Cancel_Schedule(&engine, 3);
+  run(&engine, 5000);
+  CHECK(log.levels[3] == 0);
+  drain(&engine);
+  relay_Engine_Schedule(&engine, 3, 1, 200);
+  relay_Engine_Schedule(&engine, 3, 1, 300);
+  run(&engine, 5299);
+  CHECK(log.levels[3] == 0);
+  run(&engine, 5300);
+  CHECK(log.levels[3] == 1);
+  CHECK(pop(&engine, 3, RELAY_EVENT_SCHEDULED, 1));
+
+  /* fila cheia conta os eventos perdidos */
+  for (int i = 0; i < RELAY_ENGINE_EVENTS + 4; i++) {
+    relay_Engine_Pulse(&engine, 0, 10);
+  }
+  CHECK(engine.event_count == RELAY_ENGINE_EVENTS);
+  CHECK(engine.events_lost > 0);
+}
+
+int main(void) {
+  test_Pulse_Retrigger();
+  test_Train();
+  test_Interlock();
+  test_Schedule_Persist();
+
+  HOST_TEST_END();
+}
@@ -0,0 +1,88 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "routine_blob.h"
+#include <string.h>
+
+/* formato das rotinas e paginas do blob (sem NVS) */
+
+int main(void) {
+  static routine_blob blob;
+  static routine_blob copy;
+  char schedule[ROUTINE_BLOB_SCHEDULE_SIZE];
+  char data[ROUTINE_BLOB_DATA_SIZE];
+  char payload[64];
+
+  CHECK(routine_Blob_Split("0 30 7 * * 1-5;11", schedule, data));
+  CHECK(!strcmp(schedule, "0 30 7 * * 1-5") && !strcmp(data, "11"));
+  /* ';' a mais no fim e aceite, no meio nao */
+  CHECK(routine_Blob_Split("0 30 7 * * 1-5;11;", schedule, data));
+  CHECK(!strcmp(schedule, "0 30 7 * * 1-5") && !strcmp(data, "11"));
+  CHECK(routine_Blob_Split("0 0 7 * * *;;", schedule, data) && data[0] == 0);
+  CHECK(!routine_Blob_Split("0 30 7 * * 1-5;11;x", schedule, data));
+  CHECK(!routine_Blob_Split("0 30 7 * * 1-5;11;;", schedule, data));
+  CHECK(!routine_Blob_Split("0 30 7 * * 1-5", schedule, data));
+  CHECK(!routine_Blob_Split("0 30 7 * * 1-5;1111", schedule, data));
+
+  routine_Blob_Init(&blob);
+  CHECK(routine_Blob_Pages(&blob) == 0);
+  CHECK(routine_Blob_Insert(&blob, 0, "0 0 7 * * *;11") == 0);
+  CHECK(routine_Blob_Insert(&blob, 5, "0 0 8 * * *;10;") == 5);
+  CHECK(routine_Blob_Insert(&blob, 6, "x y z;10") < 0);
+  CHECK(blob.count == 2 && blob.next_id == 6);
+
+  for (int i = 0; i < ROUTINE_BLOB_MAX; i++) {
+    snprintf(payload, sizeof(payload), "0 %d %d * * *;2%d", i % 60, i % 24,
+             i % 2);
+    CHECK(routine_Blob_Add(&blob, payload) ==
+          (i < ROUTINE_BLOB_MAX - 2 ? 6 + i : -1));
+  }
+
+  CHECK(blob.count == ROUTINE_BLOB_MAX);
+  CHECK(routine_Blob_Pages(&blob) == ROUTINE_BLOB_PAGES);
+  CHECK(routine_Blob_Page_Of(ROUTINE_BLOB_PAGE_RECORDS) == 1);
+  CHECK(routine_Blob_Page_Size(&blob, 0) ==
+        ROUTINE_BLOB_PAGE_RECORDS * sizeof(routine_blob_record));
+  CHECK(routine_Blob_Page_Size(&blob, ROUTINE_BLOB_PAGES - 1) ==
+        (ROUTINE_BLOB_MAX - (ROUTINE_BLOB_PAGES - 1) * ROUTINE_BLOB_PAGE_RECORDS) *
+            sizeof(routine_blob_record));
+  CHECK(routine_Blob_Page_Size(&blob, ROUTINE_BLOB_PAGES) == 0);
+
+  routine_Blob_Seal(&blob, 0);
+  CHECK(routine_Blob_Is_Valid(&blob, routine_Blob_Header_Size()));
+  CHECK(!routine_Blob_Is_Valid(&blob, routine_Blob_Header_Size() + 1));
+  for (uint16_t page = 0; page < routine_Blob_Pages(&blob); page++) {
+    CHECK(routine_Blob_Page_Is_Valid(&blob, page,
+                                     routine_Blob_Page_Size(&blob, page)));
+  }
+  CHECK(!routine_Blob_Page_Is_Valid(&blob, ROUTINE_BLOB_PAGES, 0));
+
+  /* pagina alterada sem selar falha so nessa pagina */
+  memcpy(&copy, &blob, sizeof(blob));
+  copy.records[ROUTINE_BLOB_PAGE_RECORDS + 3].data[0] ^= 1;
+  CHECK(routine_Blob_Page_Is_Valid(&copy, 0, routine_Blob_Page_Size(&copy, 0)));
+  CHECK(!routine_Blob_Page_Is_Valid(&copy, 1, routine_Blob_Page_Size(&copy, 1)));
+
+  /* selar a partir da pagina 1 muda o CRC do cabecalho, a pagina 0 nao */
+  routine_Blob_Seal(&copy, 1);
+  CHECK(copy.page_crc[0] == blob.page_crc[0]);
+  CHECK(copy.crc != blob.crc);
+  CHECK(routine_Blob_Page_Is_Valid(&copy, 1, routine_Blob_Page_Size(&copy, 1)));
+
+  /* cabecalho do formato anterior ou estragado */
+  copy.version = 1;
+  CHECK(!routine_Blob_Is_Valid(&copy, routine_Blob_Header_Size()));
+  copy.version = ROUTINE_BLOB_VERSION;
+  copy.count++;
+  CHECK(!routine_Blob_Is_Valid(&copy, routine_Blob_Header_Size()));
+
+  HOST_TEST_END();
+}
@@ -0,0 +1,214 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "routine_timeline.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Simula as rotinas dia a dia de 1/1/2026 a 31/1/2027 em hora de Lisboa
+ * (com as duas mudancas de hora) e compara a linha do tempo com uma
+ * referencia feita minuto a minuto, sem passar pelo ccronexpr.
+ */
+
+typedef struct
+{
+  const char *expression;
+  const char *data;
+  int hour;    /* -1 = qualquer */
+  int minute;  /* -1 = multiplos de 15 */
+  int weekend; /* 0 = segunda a sexta, 1 = sabado e domingo, 2 = todos */
+  cron_expr cron;
+
+} sim_rule;
+
+static sim_rule sim_Rules[] = {
+    {.expression = "0 30 7 * * 1-5", .data = "11", .hour = 7, .minute = 30,
+     .weekend = 0},
+    {.expression = "0 0 19 * * 1-5", .data = "10", .hour = 19, .minute = 0,
+     .weekend = 0},
+    {.expression = "0 */15 * * * 0,6", .data = "21", .hour = -1,
+     .minute = -1, .weekend = 1},
+    /* 01:30 nao existe no fim de marco e repete-se no fim de outubro */
+    {.expression = "0 30 1 * * *", .data = "31", .hour = 1, .minute = 30,
+     .weekend = 2},
+};
+
+#define SIM_RULES (sizeof(sim_Rules) / sizeof(sim_Rules[0]))
+
+typedef struct
+{
+  int year;
+  int mon; /* 0 a 11 */
+  int mday;
+
+} sim_day;
+
+/* feriados PT ligados em 2026 (sem Carnaval nem segunda de Pascoa) */
+static const sim_day sim_Holidays[] = {
+    {2026, 0, 1},  {2026, 3, 3},  {2026, 3, 5},   {2026, 3, 25},
+    {2026, 4, 1},  {2026, 5, 4},  {2026, 5, 10},  {2026, 7, 15},
+    {2026, 9, 5},  {2026, 10, 1}, {2026, 11, 1},  {2026, 11, 8},
+    {2026, 11, 25}, {2027, 0, 1},
+};
+
+static int sim_Rule_Match(const sim_rule *rule, const struct tm *t) {
+  int weekend = t->tm_wday == 0 || t->tm_wday == 6;
+
+  if (t->tm_sec != 0 || (rule->weekend != 2 && rule->weekend != weekend)) {
+    return 0;
+  }
+
+  if (rule->hour >= 0 && t->tm_hour != rule->hour) {
+    return 0;
+  }
+
+  return rule->minute < 0 ? t->tm_min % 15 == 0 : t->tm_min == rule->minute;
+}
+
+static int sim_Is_Active(const struct tm *t) {
+  int date = (t->tm_year - 100) * 10000 + t->tm_mon * 100 + t->tm_mday;
+
+  for (size_t i = 0; i < sizeof(sim_Holidays) / sizeof(sim_Holidays[0]); i++) {
+    if (sim_Holidays[i].year == t->tm_year + 1900 &&
+        sim_Holidays[i].mon == t->tm_mon && sim_Holidays[i].mday == t->tm_mday) {
+      return 0;
+    }
+  }
+
+  /* dia de excecao 24/12, intervalo 15/1/2026 a 10/1/2027, ferias 1 a 15/8 */
+  if (t->tm_mon == 11 && t->tm_mday == 24) {
+    return 0;
+  }
+
+  if (date < 260015 || date > 270010) {
+    return 0;
+  }
+
+  return date < 260701 || date > 260715;
+}
+
+static void sim_Calendar(routine_calendar *calendar) {
+  memset(calendar, 0, sizeof(*calendar));
+
+  calendar->has_range = 1;
+  calendar->range_from = 260015;
+  calendar->range_to = 270010;
+  calendar->has_holidays = 1;
+  calendar->holidays_from = 260701;
+  calendar->holidays_to = 260715;
+  CHECK(routine_Calendar_Parse_Day("2411", calendar->exception_days));
+  CHECK(!routine_Calendar_Parse_Day("24-1", calendar->exception_days));
+
+  /* tudo menos Carnaval (bit 0) e segunda de Pascoa (bit 4) */
+  calendar->holiday_pack = holiday_Find_Pack("PT");
+  calendar->holiday_mask = 0x7FFF & ~0x11;
+  /* 2027 fica compilado na hora */
+  holiday_Compile_Year(&calendar->holidays, calendar->holiday_pack,
+                       calendar->holiday_mask, 2026);
+}
+
+int main(void) {
+  static routine_timeline timeline;
+  routine_calendar calendar;
+  struct tm start = {0};
+  const char *error = NULL;
+  int days = 0, active_days = 0, short_day = 0, long_day = 0;
+  long fires = 0;
+
+  setenv("TZ", "WET0WEST,M3.5.0/1,M10.5.0", 1);
+  tzset();
+
+  sim_Calendar(&calendar);
+
+  for (size_t i = 0; i < SIM_RULES; i++) {
+    memset(&sim_Rules[i].cron, 0, sizeof(cron_expr));
+    cron_parse_expr(sim_Rules[i].expression, &sim_Rules[i].cron, &error);
+    CHECK(error == NULL);
+  }
+
+  start.tm_year = 126;
+  start.tm_mday = 1;
+  start.tm_isdst = -1;
+
+  for (time_t day = mktime(&start);; days++) {
+    struct tm t;
+    int expected = 0;
+
+    localtime_r(&day, &t);
+    if (t.tm_year == 127 && t.tm_mon == 1) {
+      break;
+    }
+
+    /* o firmware refaz a linha do tempo pouco depois da meia-noite */
+    routine_Timeline_Begin(&timeline, &calendar, day + 5);
+    for (size_t i = 0; i < SIM_RULES; i++) {
+      routine_Timeline_Add_Rule(&timeline, &sim_Rules[i].cron,
+                                sim_Rules[i].data);
+    }
+    routine_Timeline_End(&timeline);
+
+    CHECK(timeline.day_start == day);
+    CHECK(timeline.active == sim_Is_Active(&t));
+    CHECK(!timeline.overflow);
+
+    short_day += timeline.day_end - timeline.day_start == 23 * 3600;
+    long_day += timeline.day_end - timeline.day_start == 25 * 3600;
+    active_days += timeline.active;
+
+    for (size_t i = 1; i < timeline.count; i++) {
+      CHECK(timeline.entries[i - 1].second <= timeline.entries[i].second);
+    }
+
+    /* referencia minuto a minuto */
+    for (time_t now = timeline.day_start; now < timeline.day_end; now += 60) {
+      time_t before = now - 3600;
+      struct tm m, b;
+      int repeated;
+
+      localtime_r(&now, &m);
+      localtime_r(&before, &b);
+      /* na hora repetida de outubro o cron so dispara na primeira vez */
+      repeated = b.tm_hour == m.tm_hour && b.tm_min == m.tm_min;
+
+      for (size_t i = 0; i < SIM_RULES; i++) {
+        uint8_t hit = routine_Timeline_Lookup(&timeline, now + 3,
+                                              sim_Rules[i].data);
+
+        if (!repeated && sim_Rule_Match(&sim_Rules[i], &m)) {
+          expected++;
+          fires += timeline.active;
+          CHECK(hit == timeline.active);
+          /* fora da folga ja nao conta */
+          CHECK(!routine_Timeline_Lookup(
+              &timeline, now + ROUTINE_TIMELINE_SLACK_S + 1, sim_Rules[i].data));
+        } else {
+          CHECK(!hit);
+        }
+      }
+    }
+
+    CHECK(timeline.count == (timeline.active ? expected : 0));
+
+    day = timeline.day_end;
+  }
+
+  CHECK(days == 396);
+  CHECK(short_day == 1);
+  CHECK(long_day == 1);
+  printf("%d dias, %d ativos, %ld disparos\n", days, active_days, fires);
+
+  /* fora do dia da linha do tempo nada dispara */
+  CHECK(!routine_Timeline_Lookup(&timeline, timeline.day_start - 1, "31"));
+  CHECK(!routine_Timeline_Lookup(&timeline, timeline.day_end, "31"));
+
+  HOST_TEST_END();
+}
@@ -0,0 +1,229 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "sms_pdu.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * PDUs do sms_pdu.c contra vetores conhecidos: empacotamento GSM-7,
+ * tabela de extensao, UCS2 com surrogates, UDH de concatenacao e corte
+ * dos segmentos sem partir caracteres.
+ */
+
+static char pdu_Hex[SMS_PDU_HEX_SIZE];
+
+static size_t build(const sms_pdu_message *msg, const char *phone,
+                    uint8_t ref, uint8_t segment, uint8_t *tpdu_len) {
+  memset(pdu_Hex, 0, sizeof(pdu_Hex));
+  return sms_PDU_Build(msg, phone, ref, segment, pdu_Hex, sizeof(pdu_Hex),
+                       tpdu_len);
+}
+
+static void check_PDU(const char *text, const char *phone,
+                      const char *expected) {
+  sms_pdu_message msg;
+  uint8_t tpdu_len = 0;
+
+  CHECK(sms_PDU_Prepare(text, &msg) == 1);
+  CHECK(build(&msg, phone, 0, 0, &tpdu_len) == strlen(expected));
+  CHECK(!strcmp(pdu_Hex, expected));
+  CHECK((size_t)tpdu_len * 2 + 2 == strlen(expected));
+  if (strcmp(pdu_Hex, expected)) {
+    printf("  [%s]\n  %s\n  %s\n", text, pdu_Hex, expected);
+  }
+}
+
+static uint8_t hex_Byte(const char *hex) {
+  uint8_t value = 0;
+
+  for (int k = 0; k < 2; k++) {
+    char c = hex[k];
+
+    value = value << 4 | (c <= '9' ? c - '0' : c - 'A' + 10);
+  }
+
+  return value;
+}
+
+/* octetos do TPDU (sem o 00 do SMSC) */
+static size_t tpdu_Bytes(uint8_t *out) {
+  size_t n = (strlen(pdu_Hex) - 2) / 2;
+
+  for (size_t k = 0; k < n; k++) {
+    out[k] = hex_Byte(pdu_Hex + 2 + 2 * k);
+  }
+
+  return n;
+}
+
+static uint8_t get_Septet(const uint8_t *ud, uint16_t index) {
+  uint16_t bit = index * 7;
+  uint16_t value = ud[bit / 8] >> (bit % 8);
+
+  if (bit % 8 > 1) {
+    value |= ud[bit / 8 + 1] << (8 - bit % 8);
+  }
+
+  return value & 0x7F;
+}
+
+/* septetos de um segmento GSM-7 depois do UDH, devolve quantos */
+static uint16_t unpack_Segment(uint8_t *septets, uint8_t *udh) {
+  uint8_t tpdu[200];
+  size_t pos = 2;
+  uint16_t udl;
+  uint16_t first = 0;
+
+  tpdu_Bytes(tpdu);
+  pos += 2 + (tpdu[pos] + 1) / 2;
+  pos += 3;
+  udl = tpdu[pos++];
+  *udh = (tpdu[0] & 0x40) != 0;
+
+  if (*udh) {
+    first = 7;
+  }
+
+  for (uint16_t k = first; k < udl; k++) {
+    septets[k - first] = get_Septet(tpdu + pos, k);
+  }
+
+  return udl - first;
+}
+
+static void check_Gsm7_Round_Trip(const char *text) {
+  sms_pdu_message msg;
+  uint8_t septets[200];
+  uint8_t tpdu_len = 0;
+  uint8_t udh = 0;
+  size_t total = 0;
+
+  CHECK(sms_PDU_Prepare(text, &msg) >= 1);
+  CHECK(msg.dcs == SMS_PDU_DCS_GSM7);
+
+  for (uint8_t s = 0; s < msg.segments; s++) {
+    uint16_t count;
+
+    CHECK(build(&msg, "+351912345678", 9, s, &tpdu_len) > 0);
+    count = unpack_Segment(septets, &udh);
+    CHECK(udh == (msg.segments > 1));
+    CHECK(count <= (msg.segments > 1 ? 153 : 160));
+
+    /* texto ASCII do alfabeto basico: cada septeto e o proprio caracter */
+    for (uint16_t k = 0; k < count; k++) {
+      CHECK(septets[k] == (uint8_t)text[total + k]);
+    }
+    total += count;
+  }
+
+  CHECK(total == strlen(text));
+}
+
+int main(void) {
+  sms_pdu_message msg;
+  uint8_t tpdu[200];
+  uint8_t tpdu_len = 0;
+  char text[1400];
+  size_t n;
+
+  /* vetor classico: "hellohello" empacotado em 9 octetos */
+  check_PDU("hellohello", "+46708251358",
+            "0011000B916407281553F80000A70AE8329BFD4697D9EC37");
+
+  /* numero nacional com numero impar de digitos */
+  check_PDU("A", "912345678", "001100098119325476F80000A70141");
+
+  /* tabela de extensao: ESC + 0x65 */
+  check_PDU("\xE2\x82\xAC", "+351912345678",
+            "0011000C915391214365870000A7029B32");
+
+  /* "Ol\xC3\xA1" nao existe em GSM-7: UCS2 */
+  check_PDU("Ol\xC3\xA1", "+351912345678",
+            "0011000C915391214365870008A706004F006C00E1");
+
+  /* U+1F600 em UCS2 e o par surrogate D83D DE00 */
+  check_PDU("\xF0\x9F\x98\x80", "+351912345678",
+            "0011000C915391214365870008A704D83DDE00");
+
+  /* 160 septetos cabem num SMS, 161 ja vao em dois de 153 + 8 */
+  memset(text, 'a', 160);
+  text[160] = 0;
+  CHECK(sms_PDU_Prepare(text, &msg) == 1);
+  CHECK(build(&msg, "+351912345678", 0, 0, &tpdu_len) > 0);
+  CHECK(tpdu_len == 14 + 140);
+
+  text[160] = 'a';
+  text[161] = 0;
+  CHECK(sms_PDU_Prepare(text, &msg) == 2);
+  CHECK(msg.seg_start[1] == 153);
+  CHECK(build(&msg, "+351912345678", 0x2A, 0, &tpdu_len) > 0);
+  n = tpdu_Bytes(tpdu);
+  CHECK(tpdu[0] == 0x51);
+  CHECK(tpdu[13] == 7 + 153);
+  CHECK(!memcmp(tpdu + 14, "\x05\x00\x03\x2A\x02\x01", 6));
+  /* bit de enchimento depois do UDH: o primeiro 'a' comeca no bit 1 */
+  CHECK(tpdu[20] == 0xC2);
+  CHECK(n == 14 + (160 * 7 + 7) / 8);
+  CHECK(build(&msg, "+351912345678", 0x2A, 1, &tpdu_len) > 0);
+  tpdu_Bytes(tpdu);
+  CHECK(tpdu[13] == 7 + 8);
+  CHECK(!memcmp(tpdu + 14, "\x05\x00\x03\x2A\x02\x02", 6));
+  CHECK(build(&msg, "+351912345678", 0x2A, 2, &tpdu_len) == 0);
+
+  /* o ESC + septeto do euro nunca fica partido entre segmentos */
+  memset(text, 'a', 152);
+  strcpy(text + 152, "\xE2\x82\xAC" "bbbbbbbbbb");
+  CHECK(sms_PDU_Prepare(text, &msg) == 2);
+  CHECK(msg.seg_start[1] == 152);
+
+  /* nem o par surrogate em UCS2 (67 unidades por segmento) */
+  text[0] = 0;
+  for (int k = 0; k < 66; k++) {
+    strcat(text, "\xC3\xA1");
+  }
+  strcat(text, "\xF0\x9F\x98\x80" "bbb");
+  CHECK(sms_PDU_Prepare(text, &msg) == 2);
+  CHECK(msg.dcs == SMS_PDU_DCS_UCS2);
+  CHECK(msg.seg_start[1] == 66 * 2);
+  CHECK(build(&msg, "+351912345678", 1, 0, &tpdu_len) > 0);
+  tpdu_Bytes(tpdu);
+  CHECK(tpdu[13] == 6 + 66 * 2);
+  CHECK(build(&msg, "+351912345678", 1, 1, &tpdu_len) > 0);
+  tpdu_Bytes(tpdu);
+  CHECK(tpdu[13] == 6 + 5 * 2);
+  CHECK(!memcmp(tpdu + 20, "\xD8\x3D\xDE\x00\x00\x62", 6));
+
+  /* acima de SMS_PDU_MAX_SEGMENTS o texto e cortado */
+  memset(text, 'c', 153 * SMS_PDU_MAX_SEGMENTS + 5);
+  text[153 * SMS_PDU_MAX_SEGMENTS + 5] = 0;
+  CHECK(sms_PDU_Prepare(text, &msg) == SMS_PDU_MAX_SEGMENTS);
+  CHECK(msg.truncated);
+  CHECK(msg.seg_start[SMS_PDU_MAX_SEGMENTS] == 153 * SMS_PDU_MAX_SEGMENTS);
+
+  /* sem digitos no numero nao ha PDU */
+  CHECK(sms_PDU_Prepare("x", &msg) == 1);
+  CHECK(build(&msg, "+", 0, 0, &tpdu_len) == 0);
+
+  /* empacotamento GSM-7 ida e volta, 1 a 8 segmentos */
+  srand(7);
+  for (int round = 0; round < 200; round++) {
+    size_t len = 1 + rand() % (153 * SMS_PDU_MAX_SEGMENTS);
+
+    for (size_t k = 0; k < len; k++) {
+      text[k] = 'A' + rand() % 26 + (rand() % 2 ? 32 : 0);
+    }
+    text[len] = 0;
+    check_Gsm7_Round_Trip(text);
+  }
+
+  HOST_TEST_END();
+}
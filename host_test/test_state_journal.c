@@ -0,0 +1,332 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "state_journal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Diario do estado sobre uma flash NOR simulada: escrever so passa bits
+ * de 1 a 0, apagar e por setor inteiro. Falhas de escrita e de
+ * apagamento e cortes de energia em cada operacao (a escrita cortada fica
+ * a meio) e depois o diario e reaberto e comparado com um modelo.
+ */
+
+#define SECTORS 3
+#define FLASH_SIZE (SECTORS * STATE_JOURNAL_SECTOR_SIZE)
+#define TEST_SETS 3000
+#define CUT_SETS 600
+
+typedef struct
+{
+  uint8_t data[FLASH_SIZE];
+  /* operacoes ate a falha, -1 = sem falhas */
+  int fail_after;
+  /* 1: a operacao que falha e um corte de energia e nada mais corre */
+  uint8_t cut;
+  uint8_t dead;
+  uint32_t ops;
+  uint32_t bad_writes;
+
+} nor_flash;
+
+static int nor_Fail(nor_flash *nor) {
+  nor->ops++;
+  if (nor->fail_after >= 0 && nor->fail_after-- == 0) {
+    nor->dead = nor->cut;
+    return 1;
+  }
+  return 0;
+}
+
+static int nor_Read(void *ctx, uint32_t offset, void *data, uint32_t size) {
+  nor_flash *nor = (nor_flash *)ctx;
+
+  if (offset + size > FLASH_SIZE) {
+    return -1;
+  }
+  memcpy(data, &nor->data[offset], size);
+  return 0;
+}
+
+static int nor_Write(void *ctx, uint32_t offset, const void *data,
+                     uint32_t size) {
+  nor_flash *nor = (nor_flash *)ctx;
+  const uint8_t *bytes = (const uint8_t *)data;
+
+  if (offset + size > FLASH_SIZE || nor->dead) {
+    return -1;
+  }
+
+  if (nor_Fail(nor)) {
+    /* o corte deixa a escrita a meio */
+    for (uint32_t i = 0; nor->cut && i < size / 2; i++) {
+      nor->data[offset + i] &= bytes[i];
+    }
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < size; i++) {
+    /* o diario nunca escreve por cima do que ja esta escrito */
+    if (nor->data[offset + i] != 0xFF) {
+      nor->bad_writes++;
+    }
+    nor->data[offset + i] &= bytes[i];
+  }
+  return 0;
+}
+
+static int nor_Erase(void *ctx, uint32_t offset, uint32_t size) {
+  nor_flash *nor = (nor_flash *)ctx;
+
+  if (offset % STATE_JOURNAL_SECTOR_SIZE || size % STATE_JOURNAL_SECTOR_SIZE ||
+      offset + size > FLASH_SIZE || nor->dead) {
+    return -1;
+  }
+
+  if (nor_Fail(nor)) {
+    /* corte a meio do apagamento: metade do setor fica apagada */
+    if (nor->cut) {
+      memset(&nor->data[offset], 0xFF, size / 2);
+    }
+    return -1;
+  }
+
+  memset(&nor->data[offset], 0xFF, size);
+  return 0;
+}
+
+static nor_flash nor;
+static const state_journal_flash flash = {nor_Read, nor_Write, nor_Erase, &nor,
+                                          FLASH_SIZE};
+
+static void nor_Reset(void) {
+  memset(nor.data, 0xFF, sizeof(nor.data));
+  nor.fail_after = -1;
+  nor.cut = 0;
+  nor.dead = 0;
+  nor.bad_writes = 0;
+}
+
+static void nor_Arm(int fail_after, uint8_t cut) {
+  nor.fail_after = fail_after;
+  nor.cut = cut;
+  nor.dead = 0;
+  nor.ops = 0;
+}
+
+/* modelo: ultimo valor aceite de cada chave */
+typedef struct
+{
+  uint32_t present;
+  uint64_t values[STATE_JOURNAL_KEYS];
+
+} model;
+
+static void model_Set(model *m, uint8_t key, uint64_t value) {
+  m->values[key] = value;
+  m->present |= 1UL << key;
+}
+
+static int matches(const state_journal *journal, const model *m) {
+  for (uint8_t key = 0; key < STATE_JOURNAL_KEYS; key++) {
+    uint64_t value = 0;
+    uint8_t found = state_Journal_Get(journal, key, &value);
+
+    if (found != ((m->present >> key) & 1) ||
+        (found && value != m->values[key])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static uint64_t random_Value(void) {
+  /* poucos valores para haver repetidos que nao sao escritos */
+  if (rand() % 4 == 0) {
+    return ((uint64_t)rand() << 32) | rand();
+  }
+  return rand() % 3;
+}
+
+static void test_Basic(void) {
+  state_journal journal;
+  model m;
+  uint32_t writes = 0;
+  uint64_t value = 0;
+
+  nor_Reset();
+  memset(&m, 0, sizeof(m));
+  CHECK(state_Journal_Open(&journal, &flash) == 1);
+  CHECK(!state_Journal_Get(&journal, 0, &value));
+  CHECK(state_Journal_Set(&journal, STATE_JOURNAL_KEYS, 1) == -1);
+
+  /* varias voltas aos setores */
+  srand(46);
+  for (int i = 0; i < TEST_SETS; i++) {
+    uint8_t key = rand() % 6;
+    uint64_t v = random_Value();
+
+    writes = journal.writes;
+    CHECK(state_Journal_Set(&journal, key, v) == 0);
+    if (((m.present >> key) & 1) && m.values[key] == v) {
+      CHECK(journal.writes == writes);
+    }
+    model_Set(&m, key, v);
+  }
+  CHECK(matches(&journal, &m));
+  CHECK(journal.erases > 2 * SECTORS);
+  CHECK(nor.bad_writes == 0);
+
+  CHECK(state_Journal_Open(&journal, &flash) == 0);
+  CHECK(matches(&journal, &m));
+
+  /* registo estragado e ignorado, os outros continuam */
+  CHECK(state_Journal_Compact(&journal) == 0);
+  state_Journal_Set(&journal, 7, 1234);
+  state_Journal_Set(&journal, 8, 5678);
+  model_Set(&m, 8, 5678);
+  nor.data[journal.sector * STATE_JOURNAL_SECTOR_SIZE + journal.offset -
+           2 * STATE_JOURNAL_RECORD_SIZE] ^= 1;
+  CHECK(state_Journal_Open(&journal, &flash) == 0);
+  CHECK(matches(&journal, &m));
+  CHECK(state_Journal_Get(&journal, 8, &value) && value == 5678);
+  CHECK(!state_Journal_Get(&journal, 7, &value));
+}
+
+/* a flash recusa a operacao: Set devolve erro e nada muda em memoria */
+static void test_Errors(void) {
+  state_journal journal;
+  model m;
+
+  nor_Reset();
+  memset(&m, 0, sizeof(m));
+  state_Journal_Open(&journal, &flash);
+
+  for (int i = 0; i < TEST_SETS; i++) {
+    uint8_t key = rand() % STATE_JOURNAL_KEYS;
+    uint64_t v = random_Value();
+    uint8_t fail = rand() % 4 == 0;
+
+    /* na compactacao falha o apagamento ou uma das escritas */
+    nor_Arm(fail ? rand() % 3 : -1, 0);
+    if (state_Journal_Set(&journal, key, v) == 0) {
+      model_Set(&m, key, v);
+    } else {
+      CHECK(fail);
+    }
+    CHECK(matches(&journal, &m));
+  }
+  nor_Arm(-1, 0);
+
+  CHECK(state_Journal_Open(&journal, &flash) == 0);
+  CHECK(matches(&journal, &m));
+}
+
+/* corte de energia em cada operacao: reaberto, cada chave tem o valor
+   aceite ou o que estava a ser escrito */
+static void test_Power_Cut(void) {
+  state_journal journal;
+  model m;
+
+  nor_Reset();
+  memset(&m, 0, sizeof(m));
+  state_Journal_Open(&journal, &flash);
+
+  for (int i = 0; i < CUT_SETS; i++) {
+    for (int cut = 0;; cut++) {
+      uint8_t key = rand() % STATE_JOURNAL_KEYS;
+      uint64_t v = random_Value();
+      model next = m;
+      int result;
+
+      model_Set(&next, key, v);
+
+      /* forca compactacoes a meio */
+      if (rand() % 8 == 0) {
+        journal.offset = STATE_JOURNAL_SECTOR_SIZE;
+      }
+
+      nor_Arm(cut, 1);
+      result = state_Journal_Set(&journal, key, v);
+      nor_Arm(-1, 0);
+
+      CHECK(state_Journal_Open(&journal, &flash) >= 0);
+      CHECK(matches(&journal, &m) || matches(&journal, &next));
+      if (matches(&journal, &next)) {
+        m = next;
+      }
+      if (result == 0) {
+        CHECK(matches(&journal, &next));
+        break;
+      }
+    }
+  }
+}
+
+static void test_Clear(void) {
+  state_journal journal;
+  model m;
+  model empty;
+  uint64_t value = 0;
+
+  memset(&empty, 0, sizeof(empty));
+
+  for (int cut = 0;; cut++) {
+    nor_Reset();
+    memset(&m, 0, sizeof(m));
+    state_Journal_Open(&journal, &flash);
+    for (int i = 0; i < 500; i++) {
+      uint8_t key = rand() % STATE_JOURNAL_KEYS;
+      uint64_t v = random_Value();
+
+      state_Journal_Set(&journal, key, v);
+      model_Set(&m, key, v);
+    }
+
+    /* a meio fica tudo ou nada, nunca parte */
+    nor_Arm(cut, 1);
+    if (state_Journal_Clear(&journal) == 0) {
+      nor_Arm(-1, 0);
+      CHECK(matches(&journal, &empty));
+      break;
+    }
+    nor_Arm(-1, 0);
+    CHECK(state_Journal_Open(&journal, &flash) >= 0);
+    CHECK(matches(&journal, &m) || matches(&journal, &empty));
+  }
+
+  /* so fica o setor novo, os outros estao apagados */
+  for (uint32_t i = 0; i < FLASH_SIZE; i++) {
+    if (i / STATE_JOURNAL_SECTOR_SIZE != journal.sector &&
+        nor.data[i] != 0xFF) {
+      CHECK(0);
+      break;
+    }
+  }
+  CHECK(state_Journal_Open(&journal, &flash) == 0);
+  CHECK(matches(&journal, &empty));
+  CHECK(!state_Journal_Get(&journal, 0, &value));
+
+  /* e continua a funcionar */
+  CHECK(state_Journal_Set(&journal, 3, 42) == 0);
+  CHECK(state_Journal_Open(&journal, &flash) == 0);
+  CHECK(state_Journal_Get(&journal, 3, &value) && value == 42);
+}
+
+int main(void) {
+  test_Basic();
+  test_Errors();
+  test_Power_Cut();
+  test_Clear();
+
+  HOST_TEST_END();
+}
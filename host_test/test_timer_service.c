@@ -0,0 +1,203 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "timer_service.h"
+#include <string.h>
+
+/*
+ * Servico de temporizadores: suspender e retomar grupos (o tempo que falta
+ * fica guardado), ordem dos disparos quando o servico acorda atrasado,
+ * periodicos sem deriva e disparos perdidos contados.
+ */
+
+#define FIRES_MAX 256
+
+typedef struct
+{
+  const char *name;
+  uint32_t due;
+  uint32_t now;
+
+} fire_record;
+
+static fire_record fires[FIRES_MAX];
+static int fire_Count;
+
+static void on_Fire(timer_service_timer *timer, void *ctx) {
+  timer_service *service = (timer_service *)ctx;
+
+  if (fire_Count < FIRES_MAX) {
+    fires[fire_Count].name = timer->name;
+    fires[fire_Count].due = service->wheel.now;
+    fires[fire_Count].now = service->now;
+    fire_Count++;
+  }
+}
+
+static int count_Fires(const char *name) {
+  int count = 0;
+
+  for (int i = 0; i < fire_Count; i++) {
+    count += !strcmp(fires[i].name, name);
+  }
+
+  return count;
+}
+
+static void advance(timer_service *service, uint32_t now) {
+  /* como o task: acorda no proximo disparo ate chegar a now */
+  for (;;) {
+    uint32_t next = timer_Service_Next(service, service->now);
+
+    if (next == TIMER_WHEEL_NONE ||
+        (int32_t)(service->now + next - now) > 0) {
+      timer_Service_Advance(service, now);
+      return;
+    }
+    timer_Service_Advance(service, service->now + next);
+  }
+}
+
+static void test_Groups(uint32_t start) {
+  timer_service service;
+  timer_service_timer a, b, c, d, e;
+
+  fire_Count = 0;
+  timer_Service_Init(&service, start);
+  timer_Service_Register(&service, &a, "a", 1, on_Fire, &service);
+  timer_Service_Register(&service, &b, "b", 1, on_Fire, &service);
+  timer_Service_Register(&service, &c, "c", 2, on_Fire, &service);
+  timer_Service_Register(&service, &d, "d", TIMER_SERVICE_NO_GROUP, on_Fire,
+                         &service);
+  CHECK(timer_Service_Find(&service, "c") == &c);
+  CHECK(timer_Service_Find(&service, "x") == NULL);
+
+  timer_Service_Start(&service, &a, 1000, 0, start);
+  timer_Service_Start(&service, &b, 300, 300, start);
+  timer_Service_Start(&service, &c, 500, 500, start);
+  timer_Service_Start(&service, &d, 2000, 0, start);
+
+  advance(&service, start + 400);
+  CHECK(count_Fires("b") == 1);
+
+  /* a fica com 600, b com 200 ate ao disparo seguinte */
+  timer_Service_Suspend_Group(&service, 1, start + 400);
+  timer_Service_Suspend_Group(&service, 1, start + 450);
+  CHECK(a.suspended && a.remaining == 600);
+  CHECK(b.suspended && b.remaining == 200);
+  CHECK(timer_Service_Is_Active(&a) && timer_Service_Is_Active(&b));
+  CHECK(!c.suspended);
+
+  /* so os outros grupos correm */
+  advance(&service, start + 5000);
+  CHECK(count_Fires("a") == 0 && count_Fires("b") == 1);
+  CHECK(count_Fires("c") == 10 && count_Fires("d") == 1);
+
+  /* arrancar num grupo suspenso fica a espera */
+  fire_Count = 0;
+  timer_Service_Register(&service, &e, "e", 1, on_Fire, &service);
+  timer_Service_Start(&service, &e, 50, 0, start + 5000);
+  CHECK(e.suspended && e.remaining == 50 && timer_Service_Is_Active(&e));
+
+  /* parado enquanto suspenso nao volta com o grupo */
+  timer_Service_Stop(&service, &b);
+  CHECK(!timer_Service_Is_Active(&b));
+
+  timer_Service_Resume_Group(&service, 1, start + 5000);
+  timer_Service_Resume_Group(&service, 1, start + 5000);
+  CHECK(!a.suspended && !e.suspended);
+  CHECK(timer_Service_Next(&service, start + 5000) == 50);
+
+  advance(&service, start + 5600);
+  CHECK(count_Fires("e") == 1 && count_Fires("a") == 1 &&
+        count_Fires("b") == 0);
+  for (int i = 0; i < fire_Count; i++) {
+    if (!strcmp(fires[i].name, "a")) {
+      CHECK(fires[i].due == start + 5600);
+    }
+    if (!strcmp(fires[i].name, "e")) {
+      CHECK(fires[i].due == start + 5050);
+    }
+  }
+  CHECK(!timer_Service_Is_Active(&a));
+}
+
+static void test_Order(uint32_t start) {
+  static const uint32_t delays[] = {700, 30, 256, 257, 5000, 1, 16384, 90};
+  timer_service service;
+  timer_service_timer timers[8];
+  static const char *names[] = {"t0", "t1", "t2", "t3",
+                                "t4", "t5", "t6", "t7"};
+
+  fire_Count = 0;
+  timer_Service_Init(&service, start);
+  for (int i = 0; i < 8; i++) {
+    timer_Service_Register(&service, &timers[i], names[i], 0, on_Fire,
+                           &service);
+    timer_Service_Start(&service, &timers[i], delays[i], 0, start);
+  }
+
+  /* o task acorda muito atrasado: tudo dispara de uma vez, pela ordem das
+     horas devidas, e o atraso de cada um conta a partir da sua */
+  timer_Service_Advance(&service, start + 20000);
+  CHECK(fire_Count == 8);
+  for (int i = 1; i < fire_Count; i++) {
+    CHECK(fires[i].due - start > fires[i - 1].due - start);
+  }
+  for (int i = 0; i < 8; i++) {
+    CHECK(timers[i].fires == 1);
+    CHECK(timers[i].late_max == 20000 - delays[i]);
+  }
+  CHECK(fires[0].name == names[5] && fires[7].name == names[6]);
+}
+
+static void test_Periodic(uint32_t start) {
+  timer_service service;
+  timer_service_timer timer;
+  uint32_t now = start;
+
+  fire_Count = 0;
+  timer_Service_Init(&service, start);
+  timer_Service_Register(&service, &timer, "p", 3, on_Fire, &service);
+  timer_Service_Start(&service, &timer, 100, 100, start);
+
+  /* acorda ate 30 depois da hora: as horas devidas nao derivam */
+  for (int i = 1; i <= 50; i++) {
+    now = start + i * 100 + (i * 7) % 31;
+    timer_Service_Advance(&service, now);
+  }
+  CHECK(timer.fires == 50 && timer.missed == 0);
+  for (int i = 0; i < fire_Count; i++) {
+    CHECK(fires[i].due == start + (i + 1) * 100);
+  }
+  CHECK(timer.late_max == 30);
+  CHECK(timer.jitter_max <= 30);
+
+  /* 350 de atraso: um disparo e os tres perdidos contados */
+  timer_Service_Advance(&service, start + 5100 + 350);
+  CHECK(timer.fires == 51 && timer.missed == 3);
+  CHECK(timer_Service_Next(&service, start + 5450) == 50);
+  timer_Service_Advance(&service, start + 5500);
+  CHECK(timer.fires == 52);
+  CHECK(fires[fire_Count - 1].due == start + 5500);
+}
+
+int main(void) {
+  static const uint32_t starts[] = {0, 1000, UINT32_MAX - 2000};
+
+  for (unsigned i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+    test_Groups(starts[i]);
+    test_Order(starts[i]);
+    test_Periodic(starts[i]);
+  }
+
+  HOST_TEST_END();
+}
@@ -0,0 +1,312 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "host_test.h"
+#include "timer_wheel.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Roda de temporizadores contra um modelo que guarda so o tick de disparo
+ * de cada temporizador: volta do contador de ticks, descida entre niveis,
+ * cancelar e voltar a armar (tambem dentro dos callbacks) e
+ * timer_Wheel_Next exato em cada passo.
+ */
+
+#define TEST_TIMERS 64
+#define TEST_STEPS 50000
+#define TIMED_ROUNDS 200000
+
+typedef struct
+{
+  timer_wheel *wheel;
+  timer_wheel_timer timer;
+  uint8_t armed;
+  uint8_t periodic;
+  uint32_t expires;
+  uint32_t fired;
+  uint32_t fired_at;
+
+} test_timer;
+
+static test_timer timers[TEST_TIMERS];
+static uint32_t last_Fired;
+static uint32_t total_Fired;
+
+static uint32_t random_Delay(void) {
+  switch (rand() % 8) {
+  case 0:
+    return 0;
+  case 1:
+  case 2:
+  case 3:
+    return rand() % TIMER_WHEEL_L0_SIZE;
+  case 4:
+  case 5:
+    return rand() % (TIMER_WHEEL_L0_SIZE * TIMER_WHEEL_LN_SIZE);
+  case 6:
+    return rand() % (1UL << 20);
+  default:
+    /* acima de TIMER_WHEEL_MAX_DELAY fica no maximo */
+    return ((uint32_t)rand() << 4) % (1UL << 27);
+  }
+}
+
+static uint32_t clamp_Delay(uint32_t delay) {
+  if (delay == 0) {
+    return 1;
+  }
+  return delay > TIMER_WHEEL_MAX_DELAY ? TIMER_WHEEL_MAX_DELAY : delay;
+}
+
+static void arm(test_timer *t, uint32_t delay) {
+  timer_Wheel_Add(t->wheel, &t->timer, delay);
+  t->armed = 1;
+  t->expires = t->wheel->now + clamp_Delay(delay);
+}
+
+static void expired(timer_wheel_timer *timer, void *ctx) {
+  test_timer *t = (test_timer *)ctx;
+
+  CHECK(&t->timer == timer);
+  CHECK(t->armed && t->expires == t->wheel->now);
+  CHECK(!timer_Wheel_Is_Pending(timer));
+  /* nunca para tras */
+  CHECK((int32_t)(t->wheel->now - last_Fired) >= 0);
+
+  last_Fired = t->wheel->now;
+  t->armed = 0;
+  t->fired++;
+  t->fired_at = t->wheel->now;
+  total_Fired++;
+
+  if (t->periodic) {
+    arm(t, 1 + rand() % 1000);
+  }
+}
+
+static uint32_t model_Next(const timer_wheel *wheel) {
+  uint32_t next = TIMER_WHEEL_NONE;
+
+  for (int i = 0; i < TEST_TIMERS; i++) {
+    if (timers[i].armed && timers[i].expires - wheel->now < next) {
+      next = timers[i].expires - wheel->now;
+    }
+  }
+
+  return next;
+}
+
+static void init_Timers(timer_wheel *wheel, uint32_t now) {
+  timer_Wheel_Init(wheel, now);
+  memset(timers, 0, sizeof(timers));
+  for (int i = 0; i < TEST_TIMERS; i++) {
+    timers[i].wheel = wheel;
+    timer_Wheel_Timer_Init(&timers[i].timer, expired, &timers[i]);
+  }
+  last_Fired = now;
+}
+
+static void check_Model(const timer_wheel *wheel) {
+  for (int i = 0; i < TEST_TIMERS; i++) {
+    CHECK(timer_Wheel_Is_Pending(&timers[i].timer) == timers[i].armed);
+    if (timers[i].armed) {
+      CHECK(timer_Wheel_Remaining(wheel, &timers[i].timer) ==
+            timers[i].expires - wheel->now);
+    }
+  }
+  CHECK(timer_Wheel_Next(wheel) == model_Next(wheel));
+}
+
+static void test_Wraparound(void) {
+  timer_wheel wheel;
+
+  init_Timers(&wheel, UINT32_MAX - 100);
+  arm(&timers[0], 300);
+  arm(&timers[1], 100);
+  arm(&timers[2], 101);
+  CHECK(timer_Wheel_Next(&wheel) == 100);
+
+  timer_Wheel_Advance(&wheel, UINT32_MAX);
+  CHECK(timers[1].fired == 1 && timers[2].fired == 0);
+  timer_Wheel_Advance(&wheel, 0);
+  CHECK(timers[2].fired == 1 && timers[2].fired_at == 0);
+  CHECK(timer_Wheel_Next(&wheel) == 199);
+  timer_Wheel_Advance(&wheel, 198);
+  CHECK(timers[0].fired == 0);
+  timer_Wheel_Advance(&wheel, 199);
+  CHECK(timers[0].fired == 1 && timers[0].fired_at == 199);
+  CHECK(timer_Wheel_Next(&wheel) == TIMER_WHEEL_NONE);
+}
+
+static void test_Cascade(void) {
+  timer_wheel wheel;
+  uint32_t start = 0xFFFF0000;
+  uint32_t delay = TIMER_WHEEL_MAX_DELAY - 7;
+  uint8_t level = TIMER_WHEEL_LEVELS - 1;
+
+  init_Timers(&wheel, start);
+  arm(&timers[0], delay);
+  arm(&timers[1], TIMER_WHEEL_L0_SIZE * TIMER_WHEEL_LN_SIZE + 3);
+  arm(&timers[2], TIMER_WHEEL_L0_SIZE + 1);
+  CHECK(timers[0].timer.level == TIMER_WHEEL_LEVELS - 1);
+  CHECK(timers[1].timer.level == 2);
+  CHECK(timers[2].timer.level == 1);
+  check_Model(&wheel);
+
+  /* desce um nivel de cada vez ate ao 0 e dispara no tick certo */
+  for (uint32_t t = start; timers[0].fired == 0;) {
+    uint32_t next = timer_Wheel_Next(&wheel);
+
+    CHECK(next == model_Next(&wheel));
+    t += next;
+    timer_Wheel_Advance(&wheel, t - 1);
+    check_Model(&wheel);
+    CHECK(timers[0].timer.level <= level);
+    level = timers[0].timer.level;
+    timer_Wheel_Advance(&wheel, t);
+  }
+  CHECK(level == 0);
+  CHECK(timers[0].fired_at == start + delay);
+  CHECK(timers[1].fired == 1 && timers[2].fired == 1);
+  CHECK(timers[1].fired_at ==
+        start + TIMER_WHEEL_L0_SIZE * TIMER_WHEEL_LN_SIZE + 3);
+}
+
+static test_timer *cancel_Victim;
+
+static void cancel_Other(timer_wheel_timer *timer, void *ctx) {
+  test_timer *t = (test_timer *)ctx;
+
+  t->armed = 0;
+  t->fired++;
+  timer_Wheel_Cancel(t->wheel, &cancel_Victim->timer);
+  cancel_Victim->armed = 0;
+  (void)timer;
+}
+
+static void test_Cancel_Rearm(void) {
+  timer_wheel wheel;
+
+  init_Timers(&wheel, 1000);
+
+  /* voltar a armar troca o tick, o antigo ja nao dispara */
+  arm(&timers[0], 5000);
+  arm(&timers[0], 10);
+  CHECK(timer_Wheel_Next(&wheel) == 10);
+  timer_Wheel_Advance(&wheel, 1010);
+  CHECK(timers[0].fired == 1);
+  timer_Wheel_Advance(&wheel, 7000);
+  CHECK(timers[0].fired == 1);
+
+  /* cancelado fica fora do mapa */
+  arm(&timers[1], 300);
+  timer_Wheel_Cancel(&wheel, &timers[1].timer);
+  timers[1].armed = 0;
+  timer_Wheel_Cancel(&wheel, &timers[1].timer);
+  CHECK(timer_Wheel_Next(&wheel) == TIMER_WHEEL_NONE);
+  CHECK(timer_Wheel_Remaining(&wheel, &timers[1].timer) == 0);
+
+  /* um callback cancela outro da mesma ranhura antes de ele disparar */
+  timer_Wheel_Timer_Init(&timers[2].timer, cancel_Other, &timers[2]);
+  cancel_Victim = &timers[3];
+  arm(&timers[3], 50);
+  arm(&timers[2], 50);
+  timer_Wheel_Advance(&wheel, wheel.now + 50);
+  CHECK(timers[2].fired == 1 && timers[3].fired == 0);
+  CHECK(timer_Wheel_Next(&wheel) == TIMER_WHEEL_NONE);
+
+  /* volta a armar dentro do proprio callback */
+  timers[4].periodic = 1;
+  arm(&timers[4], 1);
+  timer_Wheel_Advance(&wheel, wheel.now + 100000);
+  CHECK(timers[4].fired > 100 && timers[4].armed);
+  check_Model(&wheel);
+}
+
+static void test_Random(void) {
+  timer_wheel wheel;
+  uint32_t now = UINT32_MAX - 50000;
+
+  init_Timers(&wheel, now);
+  srand(45);
+
+  for (int step = 0; step < TEST_STEPS; step++) {
+    test_timer *t = &timers[rand() % TEST_TIMERS];
+    int op = rand() % 10;
+
+    if (op < 4) {
+      t->periodic = rand() % 8 == 0;
+      arm(t, random_Delay());
+    } else if (op < 5) {
+      timer_Wheel_Cancel(&wheel, &t->timer);
+      t->armed = 0;
+    } else {
+      uint32_t next = timer_Wheel_Next(&wheel);
+
+      CHECK(next == model_Next(&wheel));
+      if (op < 7 && next != TIMER_WHEEL_NONE) {
+        uint32_t fired = total_Fired;
+
+        now += next;
+        timer_Wheel_Advance(&wheel, now);
+        CHECK(total_Fired > fired && last_Fired == now);
+      } else {
+        now += op < 9 ? 1 + rand() % 300 : rand() % (1 << 16);
+        timer_Wheel_Advance(&wheel, now);
+      }
+
+      /* nada armado ficou para tras */
+      for (int i = 0; i < TEST_TIMERS; i++) {
+        CHECK(!timers[i].armed || (int32_t)(timers[i].expires - now) > 0);
+      }
+    }
+
+    if (step % 64 == 0) {
+      check_Model(&wheel);
+    }
+  }
+
+  CHECK(total_Fired > 5000);
+}
+
+static uint64_t now_Us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int main(void) {
+  timer_wheel wheel;
+  volatile uint32_t sink = 0;
+  uint64_t start;
+
+  test_Wraparound();
+  test_Cascade();
+  test_Cancel_Rearm();
+  test_Random();
+
+  /* custo de timer_Wheel_Next com os temporizadores espalhados */
+  init_Timers(&wheel, 0);
+  for (int i = 0; i < TEST_TIMERS; i++) {
+    arm(&timers[i], random_Delay());
+  }
+  start = now_Us();
+  for (int i = 0; i < TIMED_ROUNDS; i++) {
+    sink += timer_Wheel_Next(&wheel);
+  }
+  printf("timer_Wheel_Next: %.1f ns\n",
+         (now_Us() - start) * 1000.0 / TIMED_ROUNDS);
+  (void)sink;
+
+  HOST_TEST_END();
+}
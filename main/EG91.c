@@ -24,17 +24,25 @@
 #include "crc32.h"
 #include "ble_spp_server_demo.h"
 #include "UDP_Codes.h"
+#include "cmd_frame.h"
+#include "sms_pdu.h"
+#include "fota_delta.h"
 #include "core.h"
 
 #include "esp_ota_ops.h"
 #include "esp_flash_partitions.h"
 #include "esp_partition.h"
+#include "esp_timer.h"
 #include "errno.h"
 #include <regex.h>
 
 // #include "semphr.h"
 int aux_label_inCall = 0;
 
+/* numero do URC +CLIP que acompanha o RING, evita o AT+CLCC */
+static char clip_Number[20] = {};
+static volatile uint8_t clip_Number_Ready = 0;
+
 TaskHandle_t handle_SMS_TASK;
 TaskHandle_t handle_INCOMING_CALL_TASK;
 TaskHandle_t handle_SEND_SMS_TASK;
@@ -46,6 +54,8 @@ uint8_t mqtt_connectLabel = 0;
 uint8_t call_Type;
 
 uint8_t send_ATCommand_Label;
+/* a FOTA esta a ler a UART diretamente, o uart_event_task ignora os dados */
+static volatile uint8_t raw_Read_Label = 0;
 uint8_t incomingCall_Label;
 uint8_t call_label;
 uint8_t label_Network_Activate;
@@ -315,6 +325,23 @@ uint8_t parse_NetworkStatus(char *payload)
 	return 0;
 }
 
+/* ocupacao das filas do modem para o monitor de saude, pela ordem AT,
+   SMS UART, MQTT recebido, UDP a enviar, SMS a enviar */
+uint8_t get_EG91_Queue_Levels(uint8_t *depth, uint8_t *space, uint8_t max)
+{
+	QueueHandle_t queues[] = {AT_Command_Feedback_queue, EG91_CALL_SMS_UART_queue, receive_mqtt_queue, UDP_Send_queue, queue_EG91_SendSMS};
+	uint8_t count = 0;
+
+	for (uint8_t i = 0; i < sizeof(queues) / sizeof(queues[0]) && count < max; i++)
+	{
+		depth[count] = queues[i] != NULL ? uxQueueMessagesWaiting(queues[i]) : 0;
+		space[count] = queues[i] != NULL ? uxQueueSpacesAvailable(queues[i]) : 0;
+		count++;
+	}
+
+	return count;
+}
+
 void send_Type_Call_queue(uint8_t state)
 {
 	xQueueSend(Type_Call_queue, (void *)&state, pdMS_TO_TICKS(500));
@@ -441,7 +468,7 @@ printf("\n\n label_network_portalRegister 111 %d - %s\n\n", label_network_portal
 			{
 				vTaskResume(handle_SEND_SMS_TASK);
 				// vTaskResume(handle_SMS_TASK);
-				timer_start(TIMER_GROUP_1, TIMER_0);
+				resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 			} */
 		}
 	}
@@ -525,7 +552,7 @@ void task_EG91_Send_UDP(void *pvParameter)
 		// //printf("\nsms mqtt00\n");
 		/* if (label_ResetSystem == 1)
 		{
-			timer_pause(TIMER_GROUP_1, TIMER_0);
+			suspend_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 			//////printf("\nsms mqtt\n");
 			disableAlarm();
 			vTaskSuspend(xHandle_Timer_VerSystem);
@@ -544,7 +571,7 @@ void task_EG91_Send_UDP(void *pvParameter)
 		{
 			vTaskResume(handle_SEND_SMS_TASK);
 			vTaskResume(xHandle_Timer_VerSystem);
-			timer_start(TIMER_GROUP_1, TIMER_0);
+			resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 			enableAlarm();
 		} */
 		// save_INT8_Data_In_Storage(NVS_QMT_LARGE_DATA_TIMER_LABEL, 0, nvs_System_handle);
@@ -562,12 +589,310 @@ void send_UDP_queue(mqtt_information *mqttInfo)
 esp_ota_handle_t updateHandle = 0;
 const esp_partition_t *updatePartition = NULL;
 
+typedef struct
+{
+	int idFile;
+	uint32_t fileSize;
+	char *data[EG91_FOTA_BUFFERS];
+	int len[EG91_FOTA_BUFFERS];
+	QueueHandle_t free_queue;
+	QueueHandle_t full_queue;
+	SemaphoreHandle_t done;
+	volatile uint8_t stop;
+
+} eg91_fota_pipeline;
+
+/* AT+QFREAD lido diretamente da UART: "CONNECT <n>\r\n", n bytes e
+   "\r\nOK". Devolve n ou -1 se a resposta vier incompleta */
+static int EG91_Read_File_Raw(int idFile, uint32_t size, char *out, uint32_t out_size)
+{
+	char AT_Command[40] = {};
+	char line[40] = {};
+	char trailer[8] = {};
+	char *connect = NULL;
+	uint8_t line_len = 0;
+	uint8_t failed = 0;
+	int len = -1;
+	char c = 0;
+
+	xSemaphoreTake(rdySem_Control_Send_AT_Command, pdMS_TO_TICKS(15000));
+	raw_Read_Label = 1;
+
+	sprintf(AT_Command, "AT+QFREAD=%d,%lu%c", idFile, (unsigned long)size, 13);
+	uart_write_bytes(UART_NUM_1, AT_Command, strlen(AT_Command));
+
+	// o eco e URCs pendentes sao ignorados linha a linha ate ao CONNECT
+	while (len < 0 && !failed && uart_read_bytes(UART_NUM_1, &c, 1, pdMS_TO_TICKS(EG91_FOTA_READ_TIMEOUT_MS)) == 1)
+	{
+		if (c != '\n')
+		{
+			if (line_len < sizeof(line) - 1)
+			{
+				line[line_len++] = c;
+			}
+			continue;
+		}
+
+		line[line_len] = 0;
+		line_len = 0;
+
+		if (strstr(line, "ERROR") != NULL)
+		{
+			failed = 1;
+		}
+		else if ((connect = strstr(line, "CONNECT")) != NULL)
+		{
+			if (sscanf(connect, "CONNECT %d", &len) != 1 || len < 0 || (uint32_t)len > out_size)
+			{
+				len = -1;
+				failed = 1;
+			}
+		}
+	}
+
+	if (len > 0 && uart_read_bytes(UART_NUM_1, out, len, pdMS_TO_TICKS(EG91_FOTA_READ_TIMEOUT_MS)) != len)
+	{
+		len = -1;
+	}
+
+	if (len >= 0)
+	{
+		uart_read_bytes(UART_NUM_1, trailer, 6, pdMS_TO_TICKS(1000));
+
+		if (strstr(trailer, "OK") == NULL)
+		{
+			len = -1;
+		}
+	}
+
+	raw_Read_Label = 0;
+	xSemaphoreGive(rdySem_Control_Send_AT_Command);
+
+	return len;
+}
+
+static uint8_t EG91_Seek_File(int idFile, uint32_t offset)
+{
+	char AT_Command[50] = {};
+
+	// deixa terminar a transferencia interrompida antes de limpar a UART
+	vTaskDelay(pdMS_TO_TICKS(EG91_FOTA_RETRY_MS));
+	uart_flush_input(UART_NUM_1);
+
+	sprintf(AT_Command, "AT+QFSEEK=%d,%lu,0", idFile, (unsigned long)offset);
+
+	return EG91_send_AT_Command(AT_Command, "OK", 3000);
+}
+
+/* produtor: pede o bloco seguinte ao modem enquanto o anterior e decifrado e
+   gravado. Uma leitura falhada volta ao ultimo offset completo */
+static void task_EG91_Fota_Reader(void *pvParameter)
+{
+	eg91_fota_pipeline *pipe = (eg91_fota_pipeline *)pvParameter;
+	uint32_t offset = 0;
+	uint32_t size = 0;
+	uint8_t index = 0;
+	int len = 0;
+
+	while (offset < pipe->fileSize && !pipe->stop)
+	{
+		if (xQueueReceive(pipe->free_queue, &index, pdMS_TO_TICKS(1000)) != pdTRUE)
+		{
+			continue;
+		}
+
+		size = pipe->fileSize - offset < EG91_FOTA_BLOCK_SIZE ? pipe->fileSize - offset : EG91_FOTA_BLOCK_SIZE;
+		len = -1;
+
+		for (uint8_t retry = 0; retry < EG91_FOTA_RETRIES && len < 0 && !pipe->stop; retry++)
+		{
+			if (retry > 0 && !EG91_Seek_File(pipe->idFile, offset))
+			{
+				continue;
+			}
+
+			len = EG91_Read_File_Raw(pipe->idFile, size, pipe->data[index], EG91_FOTA_BLOCK_SIZE);
+		}
+
+		pipe->len[index] = len;
+		xQueueSend(pipe->full_queue, &index, portMAX_DELAY);
+
+		if (len <= 0)
+		{
+			break;
+		}
+
+		offset += len;
+	}
+
+	xSemaphoreGive(pipe->done);
+	vTaskDelete(NULL);
+}
+
+static int EG91_Fota_Read_Old(void *ctx, uint32_t offset, void *buf, size_t len)
+{
+	return esp_partition_read((const esp_partition_t *)ctx, offset, buf, len);
+}
+
+static int EG91_Fota_Write_New(void *ctx, const void *buf, size_t len)
+{
+	return esp_ota_write(updateHandle, buf, len);
+}
+
+/* consumidor: base64 + AES-CTR em fluxo, CRC32 incremental e esp_ota_write,
+   ou o fota_delta.c se o portal enviar um patch contra a imagem atual */
+static esp_err_t EG91_Fota_Pipeline(int idFile, uint32_t fileSize, uint32_t *crc)
+{
+	eg91_fota_pipeline pipe;
+	fota_delta *delta = NULL;
+	unsigned char stream_Block[16] = {};
+	unsigned char *decoded = NULL;
+	size_t decoded_len = 0;
+	size_t nc_off = 0;
+	uint32_t offset = 0;
+	uint8_t index = 0;
+	uint8_t reader_Running = 0;
+	int len = 0;
+	esp_err_t err = ESP_OK;
+	int64_t start_time = esp_timer_get_time();
+
+	memset(&pipe, 0, sizeof(pipe));
+	pipe.idFile = idFile;
+	pipe.fileSize = fileSize;
+	pipe.free_queue = xQueueCreate(EG91_FOTA_BUFFERS, sizeof(uint8_t));
+	pipe.full_queue = xQueueCreate(EG91_FOTA_BUFFERS, sizeof(uint8_t));
+	pipe.done = xSemaphoreCreateBinary();
+	decoded = malloc(EG91_FOTA_BLOCK_SIZE / 4 * 3);
+
+	for (index = 0; index < EG91_FOTA_BUFFERS; index++)
+	{
+		pipe.data[index] = malloc(EG91_FOTA_BLOCK_SIZE);
+
+		if (pipe.data[index] == NULL)
+		{
+			err = ESP_ERR_NO_MEM;
+		}
+		else
+		{
+			xQueueSend(pipe.free_queue, &index, 0);
+		}
+	}
+
+	if (decoded == NULL || pipe.free_queue == NULL || pipe.full_queue == NULL || pipe.done == NULL)
+	{
+		err = ESP_ERR_NO_MEM;
+	}
+
+	if (err == ESP_OK)
+	{
+		if (xTaskCreate(task_EG91_Fota_Reader, "task_EG91_Fota_Reader", 4 * 1024, &pipe, 25, NULL) == pdPASS)
+		{
+			reader_Running = 1;
+		}
+		else
+		{
+			err = ESP_ERR_NO_MEM;
+		}
+	}
+
+	while (err == ESP_OK && offset < fileSize)
+	{
+		if (xQueueReceive(pipe.full_queue, &index, pdMS_TO_TICKS(EG91_FOTA_READ_TIMEOUT_MS * (EG91_FOTA_RETRIES + 1))) != pdTRUE)
+		{
+			err = ESP_ERR_TIMEOUT;
+			break;
+		}
+
+		len = pipe.len[index];
+
+		if (len <= 0)
+		{
+			err = ESP_FAIL;
+			break;
+		}
+
+		decoded_len = decrypt_aes_ctr_stream((unsigned char *)pipe.data[index], len, decoded, EG91_FOTA_BLOCK_SIZE / 4 * 3, iv, stream_Block, &nc_off);
+		xQueueSend(pipe.free_queue, &index, 0);
+		offset += len;
+
+		if (decoded_len == 0)
+		{
+			err = ESP_FAIL;
+			break;
+		}
+
+		*crc = esp_rom_crc32_le(*crc, decoded, decoded_len);
+
+		if (offset == (uint32_t)len && fota_Delta_Is_Patch(decoded, decoded_len))
+		{
+			delta = malloc(sizeof(fota_delta));
+
+			if (delta == NULL)
+			{
+				err = ESP_ERR_NO_MEM;
+				break;
+			}
+
+			fota_Delta_Init(delta, EG91_Fota_Read_Old, EG91_Fota_Write_New, (void *)esp_ota_get_running_partition());
+		}
+
+		if (delta != NULL)
+		{
+			err = fota_Delta_Feed(delta, decoded, decoded_len) ? ESP_OK : ESP_FAIL;
+		}
+		else
+		{
+			err = esp_ota_write(updateHandle, decoded, decoded_len);
+		}
+	}
+
+	if (err == ESP_OK && delta != NULL && !fota_Delta_Finish(delta))
+	{
+		err = ESP_ERR_OTA_VALIDATE_FAILED;
+	}
+
+	free(delta);
+	pipe.stop = 1;
+
+	if (reader_Running)
+	{
+		xSemaphoreTake(pipe.done, portMAX_DELAY);
+	}
+
+	ESP_LOGI("FOTA", "%lu/%lu bytes in %lld ms - %s", (unsigned long)offset, (unsigned long)fileSize,
+			 (long long)((esp_timer_get_time() - start_time) / 1000), esp_err_to_name(err));
+
+	for (index = 0; index < EG91_FOTA_BUFFERS; index++)
+	{
+		free(pipe.data[index]);
+	}
+
+	free(decoded);
+
+	if (pipe.free_queue != NULL)
+	{
+		vQueueDelete(pipe.free_queue);
+	}
+
+	if (pipe.full_queue != NULL)
+	{
+		vQueueDelete(pipe.full_queue);
+	}
+
+	if (pipe.done != NULL)
+	{
+		vSemaphoreDelete(pipe.done);
+	}
+
+	return err;
+}
+
 void EG915_fota(mqtt_information *mqttInfo)
 {
 	char atCommand[200] = {};
 	uint32_t CRC32_FOTA = 0;
 
-	timer_pause(TIMER_GROUP_1, TIMER_0);
+	suspend_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 	// // ////printf("\nsms\n");
 	// disableAlarm();
 	// vTaskSuspend(xHandle_Timer_VerSystem);
@@ -627,9 +952,8 @@ void EG915_fota(mqtt_information *mqttInfo)
 	ACK = EG91_send_AT_Command("AT+QFOPEN=\"UFS:3.txt\"", "+QFOPEN:", 20000);
 	// vTaskDelay(pdMS_TO_TICKS(5000));788206364
 
-	esp_err_t err;
+	esp_err_t err = ESP_FAIL;
 	int idFile = atoi(fileID);
-	int nowFileSize = 0;
 	//printf("\nfile id %d - %s", idFile, fileID);
 	sprintf((char *)iv, "%s", "cqfDXcNe167GMAT2");
 	if (ACK)
@@ -640,33 +964,9 @@ void EG915_fota(mqtt_information *mqttInfo)
 		assert(updatePartition != NULL);
 		err = esp_ota_begin(updatePartition, OTA_WITH_SEQUENTIAL_WRITES, &updateHandle);
 
-		sprintf(AT_Command, "AT+QFREAD=%d,1024", idFile);
-		int count = 0;
-		while (nowFileSize < EG915_readDataFile_struct.fileSize)
+		if (err == ESP_OK)
 		{
-			EG91_send_AT_Command(/* "AT+QFREAD=1027,1024" */ AT_Command, "+QFREAD", 3000);
-
-			nowFileSize += EG915_readDataFile_struct.nowFileSize;
-			err = esp_ota_write(updateHandle, (const void *)EG915_readDataFile_struct.receiveData, EG915_readDataFile_struct.decryptSize);
-
-			if (err != ESP_OK)
-			{
-				err = ESP_FAIL;
-				// 	esp_ota_abort(updateHandle);
-				// 	EG915_readDataFile_struct.mode = 0;
-				// 	sprintf(AT_Command, "AT+QFCLOSE=%d", idFile);
-				// EG91_send_AT_Command(/* "AT+QFREAD=1027,1024" */ AT_Command, "OK", 3000);
-
-				ESP_LOGI("GATTS_TABLE_TAG", "esp_ota_write error!");
-				break;
-			}
-
-			//printf("\n\nnowFileSize 11 - %d - %d \n\n", nowFileSize, EG915_readDataFile_struct.fileSize);
-
-			CRC32_FOTA = esp_rom_crc32_le(CRC32_FOTA, (uint8_t *)EG915_readDataFile_struct.receiveData, EG915_readDataFile_struct.packetFile_size);
-			//printf("CRC32: 0x%08X - 0x%08X\n", CRC32_FOTA, EG915_readDataFile_struct.ckm);
-
-			count++;
+			err = EG91_Fota_Pipeline(idFile, EG915_readDataFile_struct.fileSize, &CRC32_FOTA);
 		}
 
 		if (err != ESP_OK || CRC32_FOTA != EG915_readDataFile_struct.ckm)
@@ -692,6 +992,7 @@ void EG915_fota(mqtt_information *mqttInfo)
 			EG91_send_AT_Command(AT_Command, "OK", 1000);
 			EG91_send_AT_Command("AT+QFDEL=\"UFS:3.txt\"", "OK", 1000);
 
+			snapshot_Runtime_Status();
 			vTaskDelay(pdMS_TO_TICKS(1500));
 			esp_restart();
 		}
@@ -708,14 +1009,134 @@ void EG915_fota(mqtt_information *mqttInfo)
 	EG91_send_AT_Command("AT+QINDCFG=\"ring\", 1", "OK", 1000);
 	EG915_readDataFile_struct.ckm = 0;
 	EG91_send_AT_Command("AT+CNMI=2,1,0,0,0", "OK", 1000);
+	EG91_send_AT_Command("AT+CLIP=1", "OK", 1000);
 
 	// vTaskResume(xHandle_Timer_VerSystem);
 	// vTaskResume(handle_SEND_SMS_TASK);
-	timer_start(TIMER_GROUP_1, TIMER_0);
+	resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 	// enableAlarm();
 	EG915_readDataFile_struct.mode = EG91_FILE_NORMAL_MODE;
 }
 
+static uint8_t http_Post_Configured = 0;
+
+/* POST de um corpo binario pelo cliente HTTP(S) do modem (mesmo contexto SSL
+   da FOTA). Devolve 1 quando o modem responde +QHTTPPOST: 0, o codigo HTTP
+   fica em http_Status */
+uint8_t EG91_HTTP_Post(char *url, uint8_t *body, size_t size, uint16_t *http_Status)
+{
+	char atCommand[60] = {};
+	char dtmp1[BUF_SIZE] = {};
+	char *urc = NULL;
+	uint8_t connected = 0;
+	int err = -1;
+	int status = 0;
+	TickType_t start = 0;
+
+	*http_Status = 0;
+
+	if (!http_Post_Configured)
+	{
+		EG91_send_AT_Command("AT+QHTTPCFG=\"contextid\",1", "OK", 1000);
+		EG91_send_AT_Command("AT+QHTTPCFG=\"sslctxid\",1", "OK", 1000);
+		EG91_send_AT_Command("AT+QSSLCFG=\"sslversion\",1,3", "OK", 1000);
+		EG91_send_AT_Command("AT+QSSLCFG=\"ciphersuite\",1,0XC02F", "OK", 1000);
+		EG91_send_AT_Command("AT+QSSLCFG=\"seclevel\",1,0", "OK", 1000);
+		EG91_send_AT_Command("AT+QSSLCFG=\"sni\",1,1", "OK", 1000);
+		EG91_send_AT_Command("AT+QHTTPCFG=\"responseheader\",0", "OK", 1000);
+		http_Post_Configured = EG91_send_AT_Command("AT+QHTTPCFG=\"contenttype\",2", "OK", 1000);
+	}
+
+	sprintf(atCommand, "%s%d%s%c", "AT+QHTTPURL=", strlen(url), ",80", 13);
+
+	if (!EG91_send_AT_Command(atCommand, "CONNECT", 60000))
+	{
+		return 0;
+	}
+
+	vTaskDelay(pdMS_TO_TICKS(520));
+
+	if (!EG91_send_AT_Command(url, "OK", 60000))
+	{
+		return 0;
+	}
+
+	/* sem o semaforo outra tarefa esta a meio de um comando: o POST
+	   misturava-se com a resposta dela */
+	if (xSemaphoreTake(rdySem_Control_Send_AT_Command, pdMS_TO_TICKS(15000)) != pdTRUE)
+	{
+		ESP_LOGW("HTTP", "QHTTPPOST sem acesso ao modem");
+		return 0;
+	}
+
+	suspend_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
+	send_ATCommand_Label = 1;
+
+	sprintf(atCommand, "AT+QHTTPPOST=%d,60,80%c", (int)size, 13);
+	uart_write_bytes(UART_NUM_1, atCommand, strlen(atCommand));
+
+	// o corpo so segue depois do CONNECT, o modem le exatamente size bytes
+	start = xTaskGetTickCount();
+	while (!connected && xTaskGetTickCount() - start < pdMS_TO_TICKS(10000))
+	{
+		memset(dtmp1, 0, sizeof(dtmp1));
+
+		if (xQueueReceive(AT_Command_Feedback_queue, &dtmp1, pdMS_TO_TICKS(1000)) != pdTRUE)
+		{
+			continue;
+		}
+
+		if (strstr(dtmp1, "ERROR") != NULL)
+		{
+			break;
+		}
+
+		connected = strstr(dtmp1, "CONNECT") != NULL;
+	}
+
+	if (connected)
+	{
+		uart_write_bytes(UART_NUM_1, (const char *)body, size);
+
+		start = xTaskGetTickCount();
+		while (xTaskGetTickCount() - start < pdMS_TO_TICKS(80000))
+		{
+			memset(dtmp1, 0, sizeof(dtmp1));
+
+			if (xQueueReceive(AT_Command_Feedback_queue, &dtmp1, pdMS_TO_TICKS(1000)) != pdTRUE)
+			{
+				continue;
+			}
+
+			if ((urc = strstr(dtmp1, "+QHTTPPOST:")) != NULL)
+			{
+				sscanf(urc, "+QHTTPPOST: %d,%d", &err, &status);
+				break;
+			}
+
+			if (strstr(dtmp1, "ERROR") != NULL)
+			{
+				break;
+			}
+		}
+	}
+
+	send_ATCommand_Label = 0;
+	xSemaphoreGive(rdySem_Control_Send_AT_Command);
+	resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
+
+	if (err != 0)
+	{
+		// a configuracao e refeita no proximo pedido
+		http_Post_Configured = 0;
+		return 0;
+	}
+
+	*http_Status = status;
+
+	return 1;
+}
+
 void init_EG91(void)
 {
 	// xTaskCreate(uart_event_task, "uart_event_task", 8000, NULL, 4, NULL);
@@ -733,6 +1154,8 @@ void init_EG91(void)
 	rdySem_QPSND = xSemaphoreCreateBinary();
 	rdySem_UART_CTR = xSemaphoreCreateBinary();
 	rdySem_Lost_SMS = xSemaphoreCreateBinary();
+	/* o modo CMGF e do modem inteiro, quem o muda segura este lock ate repor o modo texto */
+	rdySem_SMS_Mode = xSemaphoreCreateRecursiveMutex();
 	rdySem_Control_SMS_Task = xSemaphoreCreateBinary();
 	rdySem_Control_SMS_UDP = xSemaphoreCreateBinary();
 	rdySem_Control_pubx = xSemaphoreCreateBinary();
@@ -1649,6 +2072,15 @@ void verify_SMS_List()
 	uart_write_bytes(UART_NUM_1, AT_Command, strlen (AT_Command));*/
 }
 
+/* modo de recolha do parse_SMS_List usado pelo process_SMS_Batch */
+static data_EG91_Receive_SMS sms_Batch[SMS_BATCH_MAX];
+static uint8_t sms_Batch_Count = 0;
+static uint8_t sms_Batch_Collect = 0;
+static uint8_t sms_Batch_Truncated = 0;
+static sms_batch_stats sms_Batch_Stats;
+/* o relatorio de saude le as estatisticas a partir de outra tarefa */
+static portMUX_TYPE sms_Batch_Stats_Lock = portMUX_INITIALIZER_UNLOCKED;
+
 uint8_t parse_SMS_List(char *payload)
 {
 
@@ -1673,6 +2105,11 @@ uint8_t parse_SMS_List(char *payload)
 		nvs_get_str(nvs_System_handle, NVS_KEY_OWN_NUMBER, aux_own_Number, &required_size);
 	}
 
+	if (sms_Batch_Collect && strstr(payload, "OK") == NULL)
+	{
+		sms_Batch_Truncated = 1;
+	}
+
 	// ////printf("\nENTER PARSE SMS LIST 1\n");
 	//   xSemaphoreGive(rdySem_Control_Send_AT_Command);
 	for (int i = 0; i < strlen(payload); i++)
@@ -1702,7 +2139,7 @@ uint8_t parse_SMS_List(char *payload)
 				if (plusCounter > 1)
 				{
 					dotCounter = 0;
-					for (int j = i; payload[j] != '\n'; j++)
+					for (int j = i; payload[j] != '\n' && payload[j] != 0; j++)
 					{
 						if (payload[j] == ',')
 						{
@@ -1893,7 +2330,19 @@ uint8_t parse_SMS_List(char *payload)
 
 						char atCommand[50] = {};
 						// ////printf("\n\n GMGL aaaaa2\n\n");
-						if (/* abs(atoi(receive_SMS_data.strHour) - nowTime.time) < 2 && (atoi(receive_SMS_data.strDate) == nowTime.date) &&  */ !strcmp(SMS_UNREAD, receive_SMS_data.SMS_Status))
+						if (sms_Batch_Collect)
+						{
+							/* sem o fim da linha de dados a mensagem veio cortada */
+							if (auxCount < 9 || sms_Batch_Count >= SMS_BATCH_MAX)
+							{
+								sms_Batch_Truncated = 1;
+							}
+							else
+							{
+								memcpy(&sms_Batch[sms_Batch_Count++], &receive_SMS_data, sizeof(data_EG91_Receive_SMS));
+							}
+						}
+						else if (/* abs(atoi(receive_SMS_data.strHour) - nowTime.time) < 2 && (atoi(receive_SMS_data.strDate) == nowTime.date) &&  */ !strcmp(SMS_UNREAD, receive_SMS_data.SMS_Status))
 						{
 							// ////printf("\nENTER PARSE LOST SMS\n");
 
@@ -2372,7 +2821,7 @@ char *activateUDP_network()
 	uint8_t InitNetworkCount = 0;
 	label_network_portalRegister = 1;
 	save_INT8_Data_In_Storage(NVS_NETWORK_PORTAL_REGISTER, label_network_portalRegister, nvs_System_handle);
-	timer_pause(TIMER_GROUP_1, TIMER_0);
+	suspend_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 
 	if (gpio_get_level(GPIO_INPUT_IO_SIMPRE))
 	{
@@ -2406,9 +2855,9 @@ char *activateUDP_network()
 			{
 				label_network_portalRegister = 0;
 				save_INT8_Data_In_Storage(NVS_NETWORK_PORTAL_REGISTER, label_network_portalRegister, nvs_System_handle);
-				save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 1, nvs_System_handle);
+				set_Runtime_QMTSTAT(1);
 				RSSI_LED_TOOGLE = MQTT_NOT_CONECT_LED_TIME;
-				timer_start(TIMER_GROUP_1, TIMER_0);
+				resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 				return "ERROR";
 			}
 		}
@@ -2454,7 +2903,7 @@ char *activateUDP_network()
 				{
 					label_network_portalRegister = 0;
 					save_INT8_Data_In_Storage(NVS_NETWORK_PORTAL_REGISTER, label_network_portalRegister, nvs_System_handle);
-					timer_start(TIMER_GROUP_1, TIMER_0);
+					resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 					return "ERROR";
 				}
 			}
@@ -2463,7 +2912,7 @@ char *activateUDP_network()
 
 	// ////printf("\n\n activate network 22\n\n");
 	//  sprintf(rsp, "ME S W %s", "OK");
-	timer_start(TIMER_GROUP_1, TIMER_0);
+	resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 	return "OK";
 }
 
@@ -2601,7 +3050,7 @@ int8_t parse_IncomingCall_Payload(char *payload)
 			memset(cpy_phNumber, 0, sizeof(cpy_phNumber));
 			strcpy(cpy_phNumber, phNumber);
 
-			save_STR_Data_In_Storage(NVS_LAST_CALL, phNumber, nvs_System_handle);
+			set_Runtime_Last_Call(phNumber);
 
 			 /* sprintf(phNumber, "%s", "34637239294");
 			printf("\n incoming call phnumber: %s\n", phNumber); */
@@ -2615,7 +3064,6 @@ int8_t parse_IncomingCall_Payload(char *payload)
 
 			get_RTC_System_Time();
 
-			vTaskDelay(pdMS_TO_TICKS((2000)));
 			// vTaskDelay(200);
 			esp_err_t search_User_err = ESP_FAIL;
 			char *phNumber1 = remove_non_printable(phNumber, strlen(phNumber));
@@ -2623,15 +3071,7 @@ int8_t parse_IncomingCall_Payload(char *payload)
 			// //printf("\n\n ph number aux 0000 %s - %d\n\n", phNumber, search_User_err);
 			// sprintf(phNumber, "%s", remove_non_printable(phNumber, strlen(phNumber)));
 			// //printf("\n\n ph number aux 1111 %s - %d\n\n", phNumber, search_User_err);
-			search_User_err = MyUser_Search_User(phNumber1, aabff);
-
-			
-			// //printf("\n\n ph number aux 2222 %s - %d\n\n", phNumber, search_User_err);
-			if (search_User_err != ESP_OK)
-			{
-				memset(aabff, 0, sizeof(aabff));
-				search_User_err = MyUser_Search_User_AUX_Call(phNumber1, aabff);
-			}
+			search_User_err = MyUser_Search_Caller(phNumber1, aabff);
 
 			free(phNumber1);
 			uint8_t sms_call_verifications = get_INT8_Data_From_Storage(NVS_SMS_CALL_VERIFICATION, nvs_System_handle);
@@ -2813,8 +3253,8 @@ int8_t parse_IncomingCall_Payload(char *payload)
 							// parseCHUP(awnser_QHUP);
 							resetRele1();
 							label_Routine1_ON = 0;
-							save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, 0, nvs_System_handle);
-							save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_TIME_ON, 0, nvs_System_handle);
+							save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, 0);
+							save_State_In_Journal(STATE_KEY_ROUTINE1_TIME_ON, 0);
 
 							/* if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD))
 							{ */
@@ -3180,14 +3620,14 @@ void task_EG91_SendSMS(void *pvParameter)
 			/* if (label_Reset_Password_OR_System != 1)
 			{
 				////printf("\nsend sms %s\n", cpy_message.payload);
-				timer_pause(TIMER_GROUP_1, TIMER_0);
+				suspend_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 				////printf("\nsend sms11 %s\n", cpy_message.payload);
 				////printf("\nsms\n");
 				//  disableAlarm();
 				vTaskSuspend(xHandle_Timer_VerSystem);
 				////printf("\nsend sms22 %s\n", cpy_message.payload);
 			} */
-			timer_pause(TIMER_GROUP_1, TIMER_0);
+			suspend_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 			// vTaskSuspend(handle_SEND_SMS_TASK);
 
 			// TODO: UNNCOMMENT IF NOT WORK
@@ -3233,7 +3673,7 @@ void task_EG91_SendSMS(void *pvParameter)
 			// xSemaphoreGive(rdySem_Control_Send_AT_Command);
 
 			// vTaskResume(xHandle_Timer_VerSystem);
-			timer_start(TIMER_GROUP_1, TIMER_0);
+			resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 			enableAlarm();
 
 			if (label_Semaphore_Reset_System == 1)
@@ -4259,18 +4699,23 @@ uint8_t parse_qmtconn(char *receiveData)
 	if (conn_verify == '3')
 	{
 		mqtt_connectLabel = 1;
-		save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 0, nvs_System_handle);
+		set_Runtime_QMTSTAT(0);
 	}
 	else
 	{
 		mqtt_connectLabel = 0;
-		save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 1, nvs_System_handle);
+		set_Runtime_QMTSTAT(1);
 	}
 
 	// ////printf("\n\nconn_verify2 %c \n\n", conn_verify);
 	return 1;
 }
 char output_mqtt_data[300];
+static uint8_t publish_UDP_Data(char *plaintext, size_t plaintext_len, char *imei, char *topic);
+
+// o portal ja enviou mensagens comprimidas (UDP_CODEC_MAGIC), responde no mesmo formato
+static uint8_t udp_Codec_Label = 0;
+
 uint8_t send_UDP_Package(char *data, int size, char *topic)
 {
 	char UDP_send_command[1024] = {};
@@ -4339,9 +4784,57 @@ uint8_t send_UDP_Package(char *data, int size, char *topic)
 	// system_stack_high_water_mark("SEND UDP4");
 	vTaskDelay(10);
 	// printf("\n\nUDP_send_commandçç - %s\n\n", UDP_send_command);
-	size_t plaintext_len = strlen(UDP_send_command);
 
-	char *base64_str = encrypt_and_base64_encode((unsigned char *)AES_KEY1, (unsigned char *)UDP_send_command, plaintext_len);
+	if (udp_Codec_Label)
+	{
+		uint8_t compressed[sizeof(UDP_send_command)];
+		size_t compressed_len;
+
+		set_UDP_Codec_IMEI(imei);
+		compressed_len = compress_UDP_Data(UDP_send_command, strlen(UDP_send_command), compressed, sizeof(compressed));
+
+		if (compressed_len > 0)
+		{
+			return publish_UDP_Data((char *)compressed, compressed_len, imei, topic);
+		}
+	}
+
+	return publish_UDP_Data(UDP_send_command, strlen(UDP_send_command), imei, topic);
+}
+
+uint8_t send_UDP_Frame_Package(uint8_t *frame, size_t size, char *topic)
+{
+	char UDP_send_command[CMD_FRAME_MAX_SIZE + 24] = {};
+	char imei[20] = {};
+	size_t required_size = sizeof(imei);
+	size_t prefix_len = 0;
+
+	if (nvs_get_str(nvs_System_handle, NVS_KEY_EG91_IMEI, imei, &required_size) != ESP_OK)
+	{
+		EG91_get_IMEI();
+		required_size = sizeof(imei);
+
+		if (nvs_get_str(nvs_System_handle, NVS_KEY_EG91_IMEI, imei, &required_size) != ESP_OK)
+		{
+			sprintf(imei, "%s", "ERROR");
+		}
+	}
+
+	prefix_len = sprintf(UDP_send_command, "%s ", imei);
+
+	if (size > sizeof(UDP_send_command) - prefix_len)
+	{
+		return 0;
+	}
+
+	memcpy(UDP_send_command + prefix_len, frame, size);
+
+	return publish_UDP_Data(UDP_send_command, prefix_len + size, imei, topic);
+}
+
+static uint8_t publish_UDP_Data(char *plaintext, size_t plaintext_len, char *imei, char *topic)
+{
+	char *base64_str = encrypt_and_base64_encode((unsigned char *)AES_KEY1, (unsigned char *)plaintext, plaintext_len);
 
 	// printf("\n\nbase64: %s\n\n", base64_str);
 
@@ -4371,20 +4864,20 @@ uint8_t send_UDP_Package(char *data, int size, char *topic)
 	// printf("\n\n send udp 66 %s - %d\n\n", output_mqtt_data, strlen(output_mqtt_data));
 	char fff[1000] = {}; //
 	// vTaskList(fff); vTaskGetRunTimeStats(fff); //printf("\n%s\n",fff);
-	timer_pause(TIMER_GROUP_1, TIMER_0);
+	suspend_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 	// printf("\n\n send udp 0101010 \n\n");
 	if (EG91_send_AT_Command(output_mqtt_data, "QMTPUBEX", 2000))
 	{
 		// free(output_mqtt_data);
 		free(base64_str);
-		timer_start(TIMER_GROUP_1, TIMER_0);
+		resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 		return 1;
 	}
 	else
 	{
 		// free(output_mqtt_data);
 		free(base64_str);
-		timer_start(TIMER_GROUP_1, TIMER_0);
+		resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 		return 0;
 	}
 }
@@ -4634,6 +5127,9 @@ uint8_t EG91_initNetwork()
 			ACK++;
 		}
 
+		/* identificacao do chamador no URC +CLIP a seguir a cada RING */
+		EG91_send_AT_Command("AT+CLIP=1", "OK", 1000);
+
 		// EG91_send_AT_Command("AT+QCFG=\"urc/ri/ring\"", "OK", 1000);
 		EG91_send_AT_Command("AT+CNUM", "OK", 10000);
 
@@ -4734,7 +5230,7 @@ uint8_t EG91_initNetwork()
 			{
 				ACK++;
 				// printf("\n\n finish sub99\n\n");
-				save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 0, nvs_System_handle);
+				set_Runtime_QMTSTAT(0);
 				// printf("\n\n finish sub443\n\n");
 				register_UDP_Device();
 				// printf("\n\n finish sub77\n\n");
@@ -4748,7 +5244,7 @@ uint8_t EG91_initNetwork()
 			{
 				mqtt_openLabel = 0;
 				mqtt_connectLabel = 0;
-				save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 1, nvs_System_handle);
+				set_Runtime_QMTSTAT(1);
 			}
 		}
 		else
@@ -5051,7 +5547,7 @@ void play_Feedback_Sound()
 
 				while (counterACK > 0)
 				{
-					timer_pause(TIMER_GROUP_1, TIMER_0);
+					suspend_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 					// ////printf("\nsms\n");
 					disableAlarm();
 					vTaskSuspend(xHandle_Timer_VerSystem);
@@ -5103,7 +5599,7 @@ void play_Feedback_Sound()
 				// ////printf("\nsms receive 123\n");
 				vTaskResume(handle_SEND_SMS_TASK);
 				vTaskResume(xHandle_Timer_VerSystem);
-				timer_start(TIMER_GROUP_1, TIMER_0);
+				resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 				EG91_send_AT_Command("ATS7=3", "OK", 1500);
 				EG91_send_AT_Command("ATH", "OK", 1000);
 				enableAlarm();
@@ -5163,7 +5659,7 @@ void task_EG91_Run_IncomingCall(void *pvParameter)
 	if (label_initSystem_CALL != 0)
 	{
 
-		timer_pause(TIMER_GROUP_1, TIMER_0);
+		suspend_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 		// ////printf("\nsms or call %s\n", atcmd);
 		vTaskSuspend(xHandle_Timer_VerSystem);
 		// ////printf("\nincoming call before suspend! 2\n");
@@ -5202,12 +5698,13 @@ void task_EG91_Run_IncomingCall(void *pvParameter)
 
 	aux_label_inCall = 0;
 	incomingCall_Label = 0;
+	clip_Number_Ready = 0;
 
 	if (label_initSystem_CALL != 0)
 	{
 		vTaskResume(xHandle_Timer_VerSystem);
 		vTaskResume(handle_SEND_SMS_TASK);
-		timer_start(TIMER_GROUP_1, TIMER_0);
+		resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 	}
 
 	xSemaphoreGive(rdySem_Control_Send_AT_Command);
@@ -5246,13 +5743,29 @@ void task_EG91_Run_SMS(void *pvParameter)
 			//    vTaskDelay(pdMS_TO_TICKS(2000));
 			//    xSemaphoreTake(rdySem_Control_SEND_SMS_Task, pdMS_TO_TICKS(10000));
 			// system_stack_high_water_mark("parse sms1");
-			parse_SMS(atcmd);
+			uint8_t list_Again = 1;
+
+			while (list_Again)
+			{
+				process_SMS_Batch();
+				list_Again = 0;
+
+				/* um +CMTI que chegou durante ou depois do CMGL pode nao estar na
+				   listagem: volta a listar em vez de o deitar fora */
+				while (xQueueReceive(EG91_CALL_SMS_UART_queue, &atcmd, 0) == pdTRUE)
+				{
+					if (strstr(atcmd, "CMTI") != NULL)
+					{
+						list_Again = 1;
+					}
+				}
+			}
 			// verify_SMS_List();
 			// ////printf("\nsms receive 123\n");
 			// ////printf("\n\nsms HELLOO 2\n\n");
 			/* vTaskResume(handle_SEND_SMS_TASK);
 			vTaskResume(xHandle_Timer_VerSystem);
-			timer_start(TIMER_GROUP_1, TIMER_0);
+			resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 			enableAlarm();*/
 			// xSemaphoreGive(rdySem_Control_Send_AT_Command);
 			memset(atcmd, 0, BUFF_SIZE);
@@ -5628,6 +6141,8 @@ uint8_t parse_SMS(char *payload)
 	// ////printf("parse_SMS number %d", atoi(str));
 
 	// EG91_send_AT_Command("ATE1", "OK", 1500);
+	xSemaphoreTakeRecursive(rdySem_SMS_Mode, portMAX_DELAY);
+
 	EG91_send_AT_Command("AT+CSCS=\"UCS2\"", "OK", 1000);
 
 	EG91_send_AT_Command("AT+CMGF=1", "OK", 1000);
@@ -5652,6 +6167,8 @@ uint8_t parse_SMS(char *payload)
 		EG91_send_AT_Command("AT+CMGD=1,4", "OK", 1000);
 		EG91_send_AT_Command("AT+CMGD=4", "OK", 1000);
 	}
+
+	xSemaphoreGiveRecursive(rdySem_SMS_Mode);
 	// ////printf("\nparse_SMS number 13\n");
 	//   verify_SMS_List();
 	//  free(str);
@@ -5659,6 +6176,185 @@ uint8_t parse_SMS(char *payload)
 	return 1;
 }
 
+uint8_t process_SMS_Batch()
+{
+	char atCommand[50];
+	char aux_own_Number[30] = {};
+	char aux_phNumber_Batch[30] = {};
+	char *filter = SMS_UNREAD;
+	uint16_t backlog = 0;
+	uint8_t rounds = 0;
+	uint8_t duplicate = 0;
+	uint32_t processed = 0;
+	uint32_t duplicates = 0;
+	uint32_t batch_ms = 0;
+	size_t required_size;
+	int64_t start_time = esp_timer_get_time();
+
+	memset(aux_own_Number, 0, sizeof(aux_own_Number));
+
+	if (nvs_get_str(nvs_System_handle, NVS_KEY_OWN_NUMBER, NULL, &required_size) == ESP_OK)
+	{
+		nvs_get_str(nvs_System_handle, NVS_KEY_OWN_NUMBER, aux_own_Number, &required_size);
+		sprintf(aux_own_Number, "%s", check_IF_haveCountryCode(aux_own_Number, 0));
+	}
+
+	get_RTC_System_Time();
+
+	/* o EG91_Send_SMS passa a PDU a meio de uma listagem se nao esperar por este lock */
+	xSemaphoreTakeRecursive(rdySem_SMS_Mode, portMAX_DELAY);
+
+	EG91_send_AT_Command("AT+CSCS=\"UCS2\"", "OK", 1000);
+	EG91_send_AT_Command("AT+CMGF=1", "OK", 1000);
+
+	while (rounds < SMS_BATCH_MAX_ROUNDS)
+	{
+		rounds++;
+
+		memset(sms_Batch, 0, sizeof(sms_Batch));
+		sms_Batch_Count = 0;
+		sms_Batch_Truncated = 0;
+
+		/* uma so listagem por ronda, o parse_SMS_List apenas recolhe as mensagens */
+		sms_Batch_Collect = 1;
+		sprintf(atCommand, "AT+CMGL=\"%s\"", filter);
+
+		if (!EG91_send_AT_Command(atCommand, "CMGL", 3000))
+		{
+			sms_Batch_Collect = 0;
+			break;
+		}
+		sms_Batch_Collect = 0;
+
+		if (sms_Batch_Count == 0 && !sms_Batch_Truncated)
+		{
+			/* a listagem de "REC READ" apanha o resto de uma ronda cortada */
+			if (!strcmp(filter, SMS_UNREAD))
+			{
+				break;
+			}
+
+			filter = SMS_UNREAD;
+			continue;
+		}
+
+		for (uint8_t i = 0; i < sms_Batch_Count; i++)
+		{
+			duplicate = 0;
+
+			for (uint8_t j = 0; j < i; j++)
+			{
+				if (!strcmp(sms_Batch[i].phNumber, sms_Batch[j].phNumber) && !strcmp(sms_Batch[i].receiveData, sms_Batch[j].receiveData))
+				{
+					duplicate = 1;
+					break;
+				}
+			}
+
+			if (duplicate)
+			{
+				duplicates++;
+				continue;
+			}
+
+			sprintf(aux_phNumber_Batch, "%s", check_IF_haveCountryCode(sms_Batch[i].phNumber, 0));
+
+			if (strlen(aux_own_Number) > 0 && !strcmp(aux_own_Number, aux_phNumber_Batch))
+			{
+				continue;
+			}
+
+			parse_SMS_data(&sms_Batch[i]);
+			processed++;
+		}
+
+		backlog += sms_Batch_Count;
+
+		if (sms_Batch_Truncated)
+		{
+			/* a resposta nao coube no buffer, apaga so o que foi executado e
+			   vai buscar as restantes (ja marcadas como lidas) na proxima ronda */
+			for (uint8_t i = 0; i < sms_Batch_Count; i++)
+			{
+				sprintf(atCommand, "%s%d,0", "AT+CMGD=", sms_Batch[i].SMS_ID);
+				EG91_send_AT_Command(atCommand, "OK", 1000);
+			}
+
+			filter = SMS_READ;
+		}
+		else
+		{
+			/* apaga de uma vez todas as mensagens lidas */
+			EG91_send_AT_Command("AT+CMGD=1,1", "OK", 1000);
+			filter = SMS_UNREAD;
+		}
+	}
+
+	xSemaphoreGiveRecursive(rdySem_SMS_Mode);
+
+	batch_ms = (esp_timer_get_time() - start_time) / 1000;
+
+	portENTER_CRITICAL(&sms_Batch_Stats_Lock);
+	sms_Batch_Stats.batches++;
+	sms_Batch_Stats.processed += processed;
+	sms_Batch_Stats.duplicates += duplicates;
+	sms_Batch_Stats.last_backlog = backlog;
+	sms_Batch_Stats.last_batch_ms = batch_ms;
+	sms_Batch_Stats.total_ms += batch_ms;
+
+	if (backlog > sms_Batch_Stats.max_backlog)
+	{
+		sms_Batch_Stats.max_backlog = backlog;
+	}
+
+	processed = sms_Batch_Stats.processed;
+	duplicates = sms_Batch_Stats.duplicates;
+	batch_ms = sms_Batch_Stats.total_ms;
+	portEXIT_CRITICAL(&sms_Batch_Stats_Lock);
+
+	ESP_LOGI("SMS", "batch: %d sms em %d rondas, %lu ms (total %lu sms, %lu dup, %lu sms/min, max backlog %d)",
+			 backlog, rounds, sms_Batch_Stats.last_batch_ms, processed, duplicates,
+			 batch_ms ? (uint32_t)(((uint64_t)processed * 60000) / batch_ms) : 0,
+			 sms_Batch_Stats.max_backlog);
+
+	xSemaphoreGive(rdySem_Control_Send_AT_Command);
+
+	return backlog;
+}
+
+void get_SMS_Batch_Stats(sms_batch_stats *stats)
+{
+	portENTER_CRITICAL(&sms_Batch_Stats_Lock);
+	*stats = sms_Batch_Stats;
+	portEXIT_CRITICAL(&sms_Batch_Stats_Lock);
+}
+
+static void parse_CLIP_URC(char *data)
+{
+	char *clip = strstr(data, "+CLIP: \"");
+	uint8_t strIndex = 0;
+
+	if (clip == NULL || clip_Number_Ready)
+	{
+		return;
+	}
+
+	clip += strlen("+CLIP: \"");
+
+	while (clip[strIndex] != '"' && clip[strIndex] != 0 && strIndex < sizeof(clip_Number) - 1)
+	{
+		clip_Number[strIndex] = clip[strIndex];
+		strIndex++;
+	}
+	clip_Number[strIndex] = 0;
+
+	/* numero privado: fica o caminho do AT+CLCC */
+	if (strIndex > 0 && clip[strIndex] == '"')
+	{
+		clip_Number_Ready = 1;
+	}
+}
+
 int8_t parse_Call(uint8_t state)
 {
 
@@ -5673,6 +6369,24 @@ int8_t parse_Call(uint8_t state)
 
 	if (state == INCOMING_CALL_STATE)
 	{
+		/* o +CLIP chega logo a seguir ao RING, espera no maximo 300 ms por ele */
+		for (uint8_t i = 0; i < 6 && !clip_Number_Ready; i++)
+		{
+			vTaskDelay(pdMS_TO_TICKS(50));
+		}
+
+		if (clip_Number_Ready)
+		{
+			memset(dtmp1, 0, sizeof(dtmp1));
+			sprintf(dtmp1, "+CLCC: 1,1,4,0,0,\"%s\",129", clip_Number);
+			ACK = parse_IncomingCall_Payload(&dtmp1);
+
+			if (ACK == 0 || ACK == 1)
+			{
+				return ACK;
+			}
+		}
+
 		// ////printf("\nAT COMMAND parse_Call = %s\n", AT_Command);
 		while (counterACK > 0)
 		{
@@ -5712,7 +6426,7 @@ int8_t parse_Call(uint8_t state)
 				counterACK--;
 			}
 			memset(dtmp1, 0, sizeof(dtmp1));
-			vTaskDelay(pdMS_TO_TICKS((1000)));
+			vTaskDelay(pdMS_TO_TICKS((300)));
 		}
 
 		// EG91_send_AT_Command("AT+CLCC", "CLCC", 5000);
@@ -5877,142 +6591,63 @@ out:
 
 uint8_t EG91_Send_SMS(char *phNumber, char *text)
 {
-	char SMS_text[BUFF_SIZE] = {};
-	char SMS_phoneNumber[100] = {};
-	uint8_t TimeOut = 5;
-
-	char buffer[4];
+	static uint8_t sms_Reference = 0;
+	sms_pdu_message pdu_Message;
+	char pdu_Hex[SMS_PDU_HEX_SIZE] = {};
+	char SMS_text[SMS_PDU_HEX_SIZE + 30] = {};
+	uint8_t tpdu_Length = 0;
+	uint8_t ACK = 1;
 
-	// ////printf("\n\n , hex = %0x\n\n", ',');
+	sms_PDU_Prepare(text, &pdu_Message);
 
-	utf8_encode(&buffer, (rune_t)'‚');
-
-	char *line, *u8s;
-	unsigned int *wcs;
-	int len;
-	char x[strlen(phNumber) * 4];
-	char y[strlen(text) * 4];
+	if (pdu_Message.truncated)
+	{
+		ESP_LOGW("SMS", "sms com mais de %d segmentos, texto cortado", SMS_PDU_MAX_SEGMENTS);
+	}
 
-	memset(x, 0, strlen(phNumber) * 4);
+	/* a referencia so interessa quando ha concatenacao */
+	sms_Reference++;
 
-	int length = 0;
-	int length_aux = utf8_string_length((utf8_string)phNumber);
-	utf16_string utf16_phNumber = utf8_to_utf16((utf16_string)phNumber);
+	/* modo PDU ate ao fim do envio, a tarefa de SMS nao pode listar entretanto */
+	xSemaphoreTakeRecursive(rdySem_SMS_Mode, portMAX_DELAY);
 
-	length = 0;
+	EG91_send_AT_Command("AT+CMGF=0", "OK", 1500);
 
-	int count = 0;
-	while (1)
+	for (uint8_t segment = 0; segment < pdu_Message.segments; segment++)
 	{
-
-		if (utf16_phNumber[count] == '\0')
+		if (!sms_PDU_Build(&pdu_Message, phNumber, sms_Reference, segment, pdu_Hex, sizeof(pdu_Hex), &tpdu_Length))
 		{
+			ACK = 0;
 			break;
 		}
 
-		length += sprintf(x + length, "%04X", (utf16_phNumber[count++]));
-	}
+		/* o EG91_send_AT_Command envia "AT+CMGS=<tamanho>" e depois o PDU */
+		sprintf(SMS_text, "%s$AT+CMGS=%d%c", pdu_Hex, tpdu_Length, 13);
 
-	for (size_t i = 0; i < length; ++i)
-	{
-		// ////printf("%04x", (int)x[i]);
-	}
-
-	sprintf(SMS_phoneNumber, "%s%s%c%c", "AT+CMGS=\"", x, '\"', 13);
-
-	length = 0;
-
-	len = strlen(text);
-
-	length_aux = utf8_string_length((utf8_string)text);
-	utf16_string utf16_text = utf8_to_utf16((utf16_string)text);
-	// ////printf("encode utf8 string codes: \n");
-	// ////printf("\n\nX send sms number:\n%s\n\n", x);
-	utf16_t x1[300];
-
-	length = 0;
-	// length_aux = utf8_string_length((utf8_string)utf16_text);
-
-	/* if ((u_int32_t)(text[i]) < 128)
-	{ */
-	count = 0;
-	while (1)
-	{
-
-		if (utf16_text[count] == '\0')
+		if (!EG91_send_AT_Command(SMS_text, "CMGS:" /* "+CMGS:" */, 10000))
 		{
+			// ////printf("\n SMS SEND FAIL\n");
+			ACK = 0;
 			break;
 		}
-
-		length += sprintf(y + length, "%04X", utf16_text[count++]);
 	}
 
-	// utf8_to_utf16((utf8_t)y, strlen(y), x1, 300);
-
-	sprintf(SMS_text, "%s", y);
-
-	// ////printf("\n\n strlen SIM BALANCE 33 - %d\n\n", (strlen(y) - (strlen("AT+CMGS=\"") * 4) - 4));
-	strcat(SMS_text, "$\0");
-
-	strcat(SMS_text, SMS_phoneNumber);
+	/* um unico Give depois do ultimo segmento, para o caso de uma resposta
+	   do modem ter deixado o semaforo preso; a meio da sequencia deixaria
+	   outra tarefa intercalar comandos entre os AT+CMGS */
+	xSemaphoreGive(rdySem_Control_Send_AT_Command);
 
+	/* a rececao de SMS continua em modo texto */
 	EG91_send_AT_Command("AT+CMGF=1", "OK", 1500);
-	// vTaskDelay(pdMS_TO_TICKS((1000)));
-
-	// vTaskDelay(pdMS_TO_TICKS((1000)));
-	// EG91_send_AT_Command("AT+CSCS=\"UCS2\"", "OK", 1000);
 
-	EG91_send_AT_Command("AT+CSMP=49,167,0,25", "OK", 1000);
+	xSemaphoreGiveRecursive(rdySem_SMS_Mode);
 
-	// timer_pause(TIMER_GROUP_1, TIMER_0);
-	// vTaskSuspend(xHandle_Timer_VerSystem);
-
-	// TODO: COMENTAR O GIVE EM BAIXO SE NAO FUNCIONAR!!
-
-	xSemaphoreGive(rdySem_Control_Send_AT_Command);
-	if (EG91_send_AT_Command(SMS_text, "CMGS:" /* "+CMGS:" */, 10000))
+	if (ACK)
 	{
-
-		// ////printf("\n\n rsp verify_SMS_List 22\n\n");
 		EG91_send_AT_Command("ATE1", "OK", 1000);
-		// ////printf("\n\n rsp verify_SMS_List 22\n\n");
-		//  xSemaphoreGive(rdySem_Control_Send_AT_Command);
-		// verify_SMS_List();
-		free(utf16_text);
-		free(utf16_phNumber);
-		/* vTaskResume(xHandle_Timer_VerSystem);
-		timer_start(TIMER_GROUP_1, TIMER_0); */
-		// EG91_send_AT_Command("ATS7=0", "OK", 1500);
-		//  EG91_send_AT_Command("ATS7=0", "OK", 10000);
-		//  xSemaphoreGive(rdySem_Lost_SMS);
-		return 1;
-	}
-	else
-	{
-		// ////printf("\n SMS SEND FAIL\n");
-		TimeOut--;
-		// vTaskDelay(pdMS_TO_TICKS(2000));
 	}
-	// xSemaphoreGive(rdySem_Control_Send_AT_Command);
-	free(utf16_phNumber);
-	free(utf16_text);
-	// verify_SMS_List();
-	//  EG91_send_AT_Command("ATS7=0", "OK", 1500);
-	// vTaskResume(xHandle_Timer_VerSystem);
-	// timer_start(TIMER_GROUP_1, TIMER_0);
-	/* }
-	else
-	{
-		TimeOut--;
-		vTaskDelay(pdMS_TO_TICKS(500));
-	} */
-	//}
-	//  vTaskDelay(pdMS_TO_TICKS((700)));
 
-	// uart_write_bytes(UART_NUM_1, SMS_text, strlen(SMS_text));
-	// EG91_send_AT_Command("ATE1", "OK", 1000);
-	// EG91_send_AT_Command("ATS7=0", "OK", 1000);
-	return 0;
+	return ACK;
 }
 
 void task_EG91_Verify_Unread_SMS(void *pvParameter)
@@ -6091,15 +6726,52 @@ uint8_t parse_Incoming_UDP_data(char *mqtt_data)
 
 		decrypt_aes_cbc_padding((unsigned char *)receive_UDP_data, strlen((char *)receive_UDP_data), &decrypted, (unsigned char *)AES_KEY1, (unsigned char *)AES_IV);
 
-		remove_padding(decrypted, strlen((char *)decrypted));
-
 		// ////printf("Dados descriptografados: %s - %d\n", decrypted, strlen((char *)decrypted));
 		mqtt_information mqttInfo;
 		memset(&mqttInfo, 0, sizeof(mqttInfo));
 		sprintf(mqttInfo.topic, "%s", mqtt_topic);
 
+		// trama binaria: o comprimento vem no cabecalho, o padding fica depois do CRC
+		if (is_Cmd_Frame(decrypted, sizeof(decrypted)))
+		{
+			uint8_t rsp_frame[CMD_FRAME_MAX_SIZE];
+			size_t rsp_len = parse_Cmd_Frame(decrypted, sizeof(decrypted), UDP_INDICATION, NULL, NULL, NULL, &mqttInfo, rsp_frame, sizeof(rsp_frame));
+
+			if (rsp_len > 0)
+			{
+				send_UDP_Frame_Package(rsp_frame, rsp_len, mqtt_topic);
+			}
+
+			return 1;
+		}
+
+		// texto comprimido: o descompressor para no ultimo token, ignora o padding
+		if (decrypted[0] == UDP_CODEC_MAGIC)
+		{
+			char imei[20] = {};
+			size_t required_size = sizeof(imei);
+			char text[sizeof(decrypted)] = {};
+
+			if (nvs_get_str(nvs_System_handle, NVS_KEY_EG91_IMEI, imei, &required_size) == ESP_OK)
+			{
+				set_UDP_Codec_IMEI(imei);
+			}
+
+			if (decompress_UDP_Data(decrypted, sizeof(decrypted), text, sizeof(text)) == 0)
+			{
+				return 1;
+			}
+
+			udp_Codec_Label = 1;
+			memset(decrypted, 0, sizeof(decrypted));
+			memcpy(decrypted, text, strlen(text));
+		}
+		else
+		{
+			udp_Codec_Label = 0;
+			remove_padding(decrypted, strlen((char *)decrypted));
+		}
 
-		
 
 		// printf("\n\n receive_UDP_data 9876 - %s -> %s\n\n", mqtt_topic, decrypted);
 		output_Data = parseInputData(decrypted, UDP_INDICATION, NULL, NULL, NULL, NULL, &mqttInfo);
@@ -6192,7 +6864,7 @@ void task_EG91_Receive_UDP(void *pvParameter)
 			/* timer_pause(TIMER_GROUP_1, TIMER_0);
 			 vTaskSuspend(xHandle_Timer_VerSystem);
 	xSemaphoreGive(rdySem_Control_Send_AT_Command); */
-			save_INT8_Data_In_Storage(NVS_QMT_LARGE_DATA_TIMER_LABEL, 1, nvs_System_handle);
+			runtime_Status.qmt_large_data = 1;
 			memset(connectID, 0, sizeof(connectID));
 			memset(mqttData, 0, sizeof(mqttData));
 
@@ -6204,7 +6876,7 @@ void task_EG91_Receive_UDP(void *pvParameter)
 					/* if (label_Reset_Password_OR_System == 2)
 					{ */
 					// ////printf("\n\n qmtstat -> %d\n\n", get_INT8_Data_From_Storage(NVS_QMTSTAT_LABEL, nvs_System_handle));
-					save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, parse_qmtstat(mqtt_receiveData), nvs_System_handle);
+					set_Runtime_QMTSTAT(parse_qmtstat(mqtt_receiveData));
 					/* } */
 				}
 			}
@@ -6228,10 +6900,10 @@ void task_EG91_Receive_UDP(void *pvParameter)
 					}
 				}
 			}
-			save_INT8_Data_In_Storage(NVS_QMT_LARGE_DATA_TIMER_LABEL, 0, nvs_System_handle);
+			runtime_Status.qmt_large_data = 0;
 			count = 0;
 			/* vTaskResume(xHandle_Timer_VerSystem);
-						timer_start(TIMER_GROUP_1, TIMER_0); */
+						resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM); */
 		}
 	}
 }
@@ -6326,6 +6998,11 @@ static void uart_event_task(void *pvParameters)
 		//   Waiting for UART event.
 		if (xQueueReceive(uart0_queue, (void *)&event, portMAX_DELAY))
 		{
+			if (raw_Read_Label)
+			{
+				continue;
+			}
+
 			// xSemaphoreTake(rdySem_UART_CTR, 500 / portTICK_RATE_MS);
 			// ////printf("\n!!!!!! read rsp bb !!!!!\n");
 
@@ -6341,6 +7018,12 @@ static void uart_event_task(void *pvParameters)
 				/* We have not woken a task at the start of the ISR. */
 
 				vTaskDelay(100 / portTICK_PERIOD_MS); // 10 msec sleep
+
+				if (raw_Read_Label)
+				{
+					break;
+				}
+
 				memset(dtmp, 0, sizeof(dtmp));
 				uart_get_buffered_data_len(UART_NUM_1, (size_t *)&ring_buff_len);
 				// ////printf("\nread rsp aa %d\n", ring_buff_len);
@@ -6360,6 +7043,8 @@ static void uart_event_task(void *pvParameters)
 
 						if (aux_label_inCall == 0)
 						{
+							clip_Number_Ready = 0;
+							parse_CLIP_URC(dtmp);
 							aux_label_inCall = 1;
 							//printf("\nBUFFER UART RING 22: %s\n", dtmp);
 							//   vTaskSuspend(handle_SMS_TASK);
@@ -6372,6 +7057,11 @@ static void uart_event_task(void *pvParameters)
 						break;
 						//}AT_CUSD_Command
 					}
+					else if (strstr(dtmp, "+CLIP:") != NULL && aux_label_inCall == 1)
+					{
+						parse_CLIP_URC(dtmp);
+						break;
+					}
 
 					else if (strstr(dtmp, "CLCC") || (strstr(dtmp, "CMTI")) || /* strstr(dtmp, "AT") || */ /* strstr(dtmp, "+CMGS:") */ /* || */ strstr(dtmp, "CUSD:") || strstr(dtmp, "CME ERROR") || strstr(dtmp, "+QMTRECV:") || send_ATCommand_Label == 1 || strstr(dtmp, "+QHTTPGET:"))
 					{
@@ -6893,7 +7583,7 @@ static void uart_event_task(void *pvParameters)
 
 				if (strstr(dtmp, "+QMTPING:") != NULL)
 				{
-					save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 1, nvs_System_handle);
+					set_Runtime_QMTSTAT(1);
 				}
 
 				// ////printf("\n\n ***QMT6*** - %s \n\n", dtmp);
@@ -7056,7 +7746,7 @@ uint8_t EG91_UDP_Ping()
 	{
 		//////printf("\n\ntask_refresh_SystemTime 06\n\n");
 		vTaskResume(xHandle_Timer_VerSystem);
-		timer_start(TIMER_GROUP_1, TIMER_0);
+		resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
 	} */
 
 	return 1;
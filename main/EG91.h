@@ -42,6 +42,10 @@
 #define EMERGENCY_CALL_STATE 3
 
 #define SMS_UNREAD "REC UNREAD"
+#define SMS_READ "REC READ"
+
+#define SMS_BATCH_MAX 6
+#define SMS_BATCH_MAX_ROUNDS 10
 
 #define AT_QUEUE_SIZE 2
 
@@ -103,6 +107,14 @@ typedef uint16_t utf16_t; // The type of a single UTF-16 character
 #define EG91_FILE_FOTA_MODE 1
 #define EG91_FILE_USERS_MODE 2
 
+/* leitura da imagem FOTA guardada na UFS do modem: blocos de base64
+   (multiplo de 64 caracteres) lidos em duplo buffer diretamente da UART */
+#define EG91_FOTA_BLOCK_SIZE 8192
+#define EG91_FOTA_BUFFERS 2
+#define EG91_FOTA_RETRIES 3
+#define EG91_FOTA_READ_TIMEOUT_MS 5000
+#define EG91_FOTA_RETRY_MS 500
+
 typedef struct
 {
     char phoneNumber[100];
@@ -123,6 +135,18 @@ typedef struct
 
 } data_EG91_Receive_SMS;
 
+typedef struct
+{
+    uint32_t batches;
+    uint32_t processed;
+    uint32_t duplicates;
+    uint16_t last_backlog;
+    uint16_t max_backlog;
+    uint32_t last_batch_ms;
+    uint32_t total_ms;
+
+} sms_batch_stats;
+
 typedef struct mqttINFORMATION 
 {
   char topic[70];
@@ -173,6 +197,7 @@ static SemaphoreHandle_t rdySem_UART_CTR;
 static SemaphoreHandle_t rdySem_Lost_SMS;
 static SemaphoreHandle_t rdySem_Control_SMS_UDP;
 static SemaphoreHandle_t rdySem_Control_pubx;
+static SemaphoreHandle_t rdySem_SMS_Mode;
 
 
 
@@ -207,6 +232,7 @@ char fileID[5];
 //char data_ReceiveAT_Serial[1024];
 
 void EG915_fota(mqtt_information *mqttInfo);
+uint8_t EG91_HTTP_Post(char *url, uint8_t *body, size_t size, uint16_t *http_Status);
 
 extern uint8_t SIM_CARD_PIN_status;
 
@@ -240,6 +266,8 @@ uint8_t EG91_parse_QFREAD(char * payload);
 
 uint8_t parse_SMS_data(data_EG91_Receive_SMS *receive_SMS_data);
 uint8_t parse_SMS(char *payload);
+uint8_t process_SMS_Batch();
+void get_SMS_Batch_Stats(sms_batch_stats *stats);
 uint8_t parse_SMS_Payload(char *payload);
 uint8_t parse_https_get(char *payload);
 
@@ -275,6 +303,7 @@ time_t epoch_Calculator(struct tm *tm);
 uint8_t init_UDP_socket();
 
 uint8_t send_UDP_Package(char* data, int size, char *topic);
+uint8_t send_UDP_Frame_Package(uint8_t *frame, size_t size, char *topic);
 uint8_t parse_Incoming_UDP_data(char *mqtt_data);
 
 uint8_t EG91_UDP_Ping();
@@ -312,6 +341,12 @@ uint8_t EG91_initNetwork();
 
 uint8_t check_NetworkState();
 
+extern TaskHandle_t handle_SMS_TASK;
+extern TaskHandle_t handle_SEND_SMS_TASK;
+extern TaskHandle_t handle_UDP_TASK;
+
+uint8_t get_EG91_Queue_Levels(uint8_t *depth, uint8_t *space, uint8_t max);
+
 int conv_utf8_to_ucs2(const char* src, size_t len);
 
 void convUTF16(const uint8_t *utf8_buff, uint16_t utf8_buff_len, uint16_t *utf16_buff);
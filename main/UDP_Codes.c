@@ -12,6 +12,112 @@
 #include "stdio.h"
 #include "string.h"
 
+const char list_Codes_Codec[UDP_CODES_NUMBER][UDP_CODE_SIZE] = {
+    "R1.G.B",
+    "R1.G.M",
+    "R1.G.R",
+    "R1.G.T",
+    "R1.S.B",
+    "R1.S.M",
+    "R1.S.R",
+    "R1.S.T",
+    "R1.R.B",
+    "R1.R.M",
+    "R1.R.R",
+    "R2.G.M",
+    "R2.G.R",
+    "R2.G.T",
+    "R2.S.M",
+    "R2.S.R",
+    "R2.S.T",
+    "R2.R.M",
+    "R2.R.R",
+    "I1.G.I",
+    "I2.G.I",
+    "UR.G.*",
+    "UR.G.D",
+    "UR.G.H",
+    "UR.G.L",
+    "UR.G.R",
+    "UR.G.U",
+    "UR.G.W",
+    "UR.S.A",
+    "UR.S.D",
+    "UR.S.H",
+    "UR.S.L",
+    "UR.S.N",
+    "UR.S.R",
+    "UR.S.U",
+    "UR.S.W",
+    "UR.R.*",
+    "UR.R.A",
+    "UR.R.B",
+    "UR.R.L",
+    "UR.R.U",
+    "ME.G.B",
+    "ME.G.C",
+    "ME.G.F",
+    "ME.G.H",
+    "ME.G.I",
+    "ME.G.L",
+    "ME.G.M",
+    "ME.G.Q",
+    "ME.G.P",
+    "ME.G.S",
+    "ME.S.A",
+    "ME.S.C",
+    "ME.S.D",
+    "ME.S.F",
+    "ME.S.N",
+    "ME.S.O",
+    "ME.S.S",
+    "ME.S.T",
+    "ME.S.U",
+    "ME.R.A",
+    "ME.R.F",
+    "ME.R.K",
+    "ME.R.M",
+    "ME.R.O",
+    "ME.R.P",
+    "ME.R.S",
+    "ME.R.U",
+    "AL.G.*",
+    "AL.S.A",
+    "AL.S.C",
+    "AL.S.I",
+    "AL.S.O",
+    "AL.S.T",
+    "AL.R.A",
+    "AL.R.C",
+    "AL.R.O",
+    "F1.S.P",
+    "F1.R.P",
+    "F2.S.P",
+    "F2.R.P",
+    "F3.S.P",
+    "F3.R.P",
+    "F4.S.P",
+    "F4.R.P",
+    "F5.S.P",
+    "F5.R.P",
+    "F6.S.P",
+    "F6.R.P",
+    "FX.S.M",
+    "FX.R.M",
+    "RT.G.D",
+    "RT.G.R",
+    "RT.G.T",
+    "RT.S.A",
+    "RT.S.D",
+    "RT.S.R",
+    "RT.S.T",
+    "RT.R.D",
+    "RT.R.R",
+    "RT.R.T",
+    "RT.G.N"
+
+};
+
 uint8_t *parse_INT_To_STR(char *data, uint8_t size, char *output)
 {
     uint64_t int_Data;
@@ -37,4 +143,392 @@ uint8_t *parse_INT_To_STR(char *data, uint8_t size, char *output)
       
     //////printf("\n%s\n", str_Data);
     return 1;
-}
\ No newline at end of file
+}
+
+static char udp_Codec_IMEI[UDP_CODEC_IMEI_SIZE];
+
+static const char *list_Words_Codec[UDP_CODEC_WORDS_NUMBER] = {
+    udp_Codec_IMEI,
+    "OK",
+    "ERROR",
+    "NTRSP",
+    "ON",
+    "OFF",
+    "PULSE",
+    "END",
+    "BLE",
+    "SMS",
+    "WEB",
+    "RF"};
+
+void set_UDP_Codec_IMEI(const char *imei)
+{
+    snprintf(udp_Codec_IMEI, sizeof(udp_Codec_IMEI), "%s", imei);
+}
+
+static uint8_t put_Byte(uint8_t *out, size_t *pos, size_t out_size, uint8_t value)
+{
+    if (*pos >= out_size)
+    {
+        return 0;
+    }
+    out[(*pos)++] = value;
+    return 1;
+}
+
+static uint8_t put_Varint(uint8_t *out, size_t *pos, size_t out_size, uint64_t value)
+{
+    do
+    {
+        if (!put_Byte(out, pos, out_size, (value & 0x7F) | (value > 0x7F ? 0x80 : 0)))
+        {
+            return 0;
+        }
+        value >>= 7;
+    } while (value);
+
+    return 1;
+}
+
+static uint8_t get_Varint(const uint8_t *data, size_t *pos, size_t len, uint64_t *value)
+{
+    uint8_t shift = 0;
+
+    *value = 0;
+    while (*pos < len && shift < 64)
+    {
+        *value |= (uint64_t)(data[*pos] & 0x7F) << shift;
+
+        if (!(data[(*pos)++] & 0x80))
+        {
+            return 1;
+        }
+        shift += 7;
+    }
+
+    return 0;
+}
+
+static uint8_t is_Separator(char c)
+{
+    return c != 0 && strchr(UDP_CODEC_SEPARATORS, c) != NULL;
+}
+
+static uint8_t is_Digits(const char *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (data[i] < '0' || data[i] > '9')
+        {
+            return 0;
+        }
+    }
+
+    return len > 0;
+}
+
+/* "XX C P" ou "XX.C.P" que exista na tabela, devolve o indice ou -1 */
+static int find_Code(const char *data, size_t len, size_t i)
+{
+    char code[UDP_CODE_SIZE];
+
+    if (i + 6 > len || (data[i + 2] != ' ' && data[i + 2] != '.') || data[i + 4] != data[i + 2] ||
+        (i + 6 < len && !is_Separator(data[i + 6])))
+    {
+        return -1;
+    }
+
+    if (is_Separator(data[i]) || is_Separator(data[i + 1]) || is_Separator(data[i + 3]) || is_Separator(data[i + 5]))
+    {
+        return -1;
+    }
+
+    sprintf(code, "%c%c.%c.%c", data[i], data[i + 1], data[i + 3], data[i + 5]);
+
+    for (int n = 0; n < UDP_CODES_NUMBER; n++)
+    {
+        if (!memcmp(code, list_Codes_Codec[n], UDP_CODE_SIZE - 1))
+        {
+            return n;
+        }
+    }
+
+    return -1;
+}
+
+size_t compress_UDP_Data(const char *data, size_t len, uint8_t *out, size_t out_size)
+{
+    size_t pos = 0;
+    size_t i = 0;
+    uint64_t last_Time = 0;
+    uint8_t has_Time = 0;
+
+    if (!put_Byte(out, &pos, out_size, UDP_CODEC_MAGIC))
+    {
+        return 0;
+    }
+
+    while (1)
+    {
+        size_t end = i;
+        size_t n = 0;
+        uint8_t sep = 0;
+        uint8_t ok = 1;
+        int code = find_Code(data, len, i);
+        int word = -1;
+
+        if (code >= 0)
+        {
+            end = i + 6;
+        }
+        else
+        {
+            while (end < len && !is_Separator(data[end]))
+            {
+                end++;
+            }
+        }
+
+        if (end < len)
+        {
+            sep = strchr(UDP_CODEC_SEPARATORS, data[end]) - UDP_CODEC_SEPARATORS + 1;
+        }
+
+        n = end - i;
+
+        for (int k = 0; code < 0 && n > 0 && k < UDP_CODEC_WORDS_NUMBER; k++)
+        {
+            if (strlen(list_Words_Codec[k]) == n && !memcmp(list_Words_Codec[k], data + i, n))
+            {
+                word = k;
+                break;
+            }
+        }
+
+        if (code >= 0)
+        {
+            ok = put_Byte(out, &pos, out_size, ((data[i + 2] == ' ' ? UDP_CODEC_CODE_SPACE : UDP_CODEC_CODE_DOT) << 4) | sep) &&
+                 put_Byte(out, &pos, out_size, code);
+        }
+        else if (word >= 0)
+        {
+            ok = put_Byte(out, &pos, out_size, (UDP_CODEC_WORD << 4) | sep) && put_Byte(out, &pos, out_size, word);
+        }
+        else if (n == 0)
+        {
+            ok = put_Byte(out, &pos, out_size, (UDP_CODEC_EMPTY << 4) | sep);
+        }
+        else if (n == 1 && data[i] >= '0' && data[i] < '0' + (16 - UDP_CODEC_SMALL))
+        {
+            ok = put_Byte(out, &pos, out_size, ((UDP_CODEC_SMALL + data[i] - '0') << 4) | sep);
+        }
+        else if (n <= 19 && is_Digits(data + i, n) && (data[i] != '0' || n == 1))
+        {
+            uint64_t value = strtoull(data + i, NULL, 10);
+
+            if (value >= UDP_CODEC_EPOCH_MIN && value <= 0xFFFFFFFFUL)
+            {
+                /* primeiro epoch relativo a UDP_CODEC_EPOCH_MIN, os outros ao anterior (zigzag) */
+                int64_t delta = has_Time ? (int64_t)(value - last_Time) : (int64_t)(value - UDP_CODEC_EPOCH_MIN);
+
+                ok = put_Byte(out, &pos, out_size, (UDP_CODEC_TIME << 4) | sep) &&
+                     put_Varint(out, &pos, out_size, has_Time ? ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63) : (uint64_t)delta);
+                last_Time = value;
+                has_Time = 1;
+            }
+            else
+            {
+                ok = put_Byte(out, &pos, out_size, (UDP_CODEC_UINT << 4) | sep) && put_Varint(out, &pos, out_size, value);
+            }
+        }
+        else if (n - (data[i] == '+') <= UDP_CODEC_MAX_DIGITS && (is_Digits(data + i, n) || (data[i] == '+' && is_Digits(data + i + 1, n - 1))))
+        {
+            uint8_t plus = data[i] == '+';
+            uint8_t digits = n - plus;
+
+            ok = put_Byte(out, &pos, out_size, (UDP_CODEC_DIGITS << 4) | sep) &&
+                 put_Byte(out, &pos, out_size, digits | (plus ? 0x80 : 0));
+
+            for (uint8_t k = 0; ok && k < digits; k += 2)
+            {
+                uint8_t lo = k + 1 < digits ? data[i + plus + k + 1] - '0' : 0x0F;
+                ok = put_Byte(out, &pos, out_size, ((data[i + plus + k] - '0') << 4) | lo);
+            }
+        }
+        else
+        {
+            ok = put_Byte(out, &pos, out_size, (UDP_CODEC_TEXT << 4) | sep) && put_Varint(out, &pos, out_size, n) &&
+                 pos + n <= out_size;
+
+            if (ok)
+            {
+                memcpy(out + pos, data + i, n);
+                pos += n;
+            }
+        }
+
+        if (!ok)
+        {
+            return 0;
+        }
+
+        if (sep == 0)
+        {
+            break;
+        }
+        i = end + 1;
+    }
+
+    return pos;
+}
+
+size_t decompress_UDP_Data(const uint8_t *data, size_t len, char *out, size_t out_size)
+{
+    size_t pos = 1;
+    size_t n = 0;
+    uint64_t last_Time = 0;
+    uint8_t has_Time = 0;
+
+    if (len < 2 || data[0] != UDP_CODEC_MAGIC || out_size == 0)
+    {
+        return 0;
+    }
+
+    while (pos < len)
+    {
+        uint8_t tag = data[pos++];
+        uint8_t sep = tag & 0x0F;
+        uint64_t value = 0;
+        char number[24];
+        int written = 0;
+
+        if (sep > strlen(UDP_CODEC_SEPARATORS))
+        {
+            return 0;
+        }
+
+        if ((tag >> 4) >= UDP_CODEC_SMALL)
+        {
+            if (n + 1 >= out_size)
+            {
+                return 0;
+            }
+            out[n++] = '0' + (tag >> 4) - UDP_CODEC_SMALL;
+        }
+        else switch (tag >> 4)
+        {
+        case UDP_CODEC_WORD:
+            if (pos >= len || data[pos] >= UDP_CODEC_WORDS_NUMBER || n + strlen(list_Words_Codec[data[pos]]) >= out_size)
+            {
+                return 0;
+            }
+            memcpy(out + n, list_Words_Codec[data[pos]], strlen(list_Words_Codec[data[pos]]));
+            n += strlen(list_Words_Codec[data[pos++]]);
+            break;
+
+        case UDP_CODEC_CODE_SPACE:
+        case UDP_CODEC_CODE_DOT:
+            if (pos >= len || data[pos] >= UDP_CODES_NUMBER || n + 6 >= out_size)
+            {
+                return 0;
+            }
+            memcpy(out + n, list_Codes_Codec[data[pos++]], 6);
+            if ((tag >> 4) == UDP_CODEC_CODE_SPACE)
+            {
+                out[n + 2] = ' ';
+                out[n + 4] = ' ';
+            }
+            n += 6;
+            break;
+
+        case UDP_CODEC_EMPTY:
+            break;
+
+        case UDP_CODEC_UINT:
+        case UDP_CODEC_TIME:
+            if (!get_Varint(data, &pos, len, &value))
+            {
+                return 0;
+            }
+            if ((tag >> 4) == UDP_CODEC_TIME)
+            {
+                if (has_Time)
+                {
+                    value = last_Time + (int64_t)((value >> 1) ^ (~(value & 1) + 1));
+                }
+                else
+                {
+                    value += UDP_CODEC_EPOCH_MIN;
+                }
+                last_Time = value;
+                has_Time = 1;
+            }
+            written = snprintf(number, sizeof(number), "%llu", (unsigned long long)value);
+            if (n + written >= out_size)
+            {
+                return 0;
+            }
+            memcpy(out + n, number, written);
+            n += written;
+            break;
+
+        case UDP_CODEC_DIGITS:
+        {
+            if (pos >= len)
+            {
+                return 0;
+            }
+            uint8_t digits = data[pos] & 0x7F;
+            uint8_t plus = data[pos++] >> 7;
+
+            if (n + plus + digits >= out_size || pos + (digits + 1) / 2 > len)
+            {
+                return 0;
+            }
+            if (plus)
+            {
+                out[n++] = '+';
+            }
+            for (uint8_t k = 0; k < digits; k++)
+            {
+                uint8_t nibble = k % 2 ? data[pos + k / 2] & 0x0F : data[pos + k / 2] >> 4;
+
+                if (nibble > 9)
+                {
+                    return 0;
+                }
+                out[n++] = '0' + nibble;
+            }
+            pos += (digits + 1) / 2;
+            break;
+        }
+
+        case UDP_CODEC_TEXT:
+            if (!get_Varint(data, &pos, len, &value) || value > len - pos || n + value >= out_size)
+            {
+                return 0;
+            }
+            memcpy(out + n, data + pos, value);
+            pos += value;
+            n += value;
+            break;
+
+        default:
+            return 0;
+        }
+
+        if (sep == 0)
+        {
+            out[n] = 0;
+            return n;
+        }
+
+        if (n + 1 >= out_size)
+        {
+            return 0;
+        }
+        out[n++] = UDP_CODEC_SEPARATORS[sep - 1];
+    }
+
+    return 0;
+}
@@ -45,6 +45,7 @@
 #include <stdio.h>
 
 #include "UDP_Codes.h"
+#include "cmd_frame.h"
 #include "crc32.h"
 #include "cron.h"
 #include "jobs.h"
@@ -1068,6 +1069,7 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
 
             // ESP_LOGI(GATTS_TABLE_TAG, "Prepare to restart system!");
 
+            snapshot_Runtime_Status();
             vTaskDelay(pdMS_TO_TICKS(1500));
             esp_restart();
             return;
@@ -1222,7 +1224,23 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
 
         char *output_Data;
 
-        if (strlen((char *)p_data->write.value) > 6) {
+        if (is_Cmd_Frame(p_data->write.value, p_data->write.len)) {
+          uint8_t rsp_frame[CMD_FRAME_MAX_SIZE];
+          size_t rsp_len = parse_Cmd_Frame(
+              p_data->write.value, p_data->write.len, BLE_INDICATION,
+              spp_gatts_if, p_data->write.conn_id,
+              spp_handle_table[SPP_IDX_SPP_DATA_NTY_VAL], NULL, rsp_frame,
+              sizeof(rsp_frame));
+
+          if (rsp_len > 0) {
+            esp_ble_gatts_send_indicate(
+                spp_gatts_if, p_data->write.conn_id,
+                spp_handle_table[SPP_IDX_SPP_DATA_NTY_VAL], rsp_len, rsp_frame,
+                false);
+          }
+
+          res = find_char_and_desr_index(p_data->write.handle);
+        } else if (strlen((char *)p_data->write.value) > 6) {
 
           printf("\n write len11 %s - %d\n", (char *)p_data->write.value,
           strlen((char *)p_data->write.value));
@@ -1414,6 +1432,7 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
     break;
   case ESP_GATTS_DISCONNECT_EVT:
     active_BLE_conn[p_data->disconnect.conn_id] = 0;
+    reset_Cmd_Frame_Channel(BLE_INDICATION);
     // ////printf("\n disconect conn id %d\n", p_data->disconnect.conn_id);
     is_connected = false;
     enable_data_ntf = false;
@@ -1825,6 +1844,8 @@ void BLE_Broadcast_Notify(char *data) {
   // free(data);
 }
 
+uint16_t get_BLE_MTU_Size() { return spp_mtu_size; }
+
 char *change_BLE_Name(char *payload, char *rsp_BLE_Name) {
 
   esp_err_t ret;
@@ -144,6 +144,8 @@ char *change_BLE_Name(char* payload,char* rsp_BLE_Name);
 
 void BLE_Broadcast_Notify(char *data);
 
+uint16_t get_BLE_MTU_Size();
+
 
 void disableBLE();
 void restartBLE();
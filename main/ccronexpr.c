@@ -199,19 +199,6 @@ static char* strdupl(const char* str, size_t len) {
     return res;
 }
 
-static unsigned int next_set_bit(uint8_t* bits, unsigned int max, unsigned int from_index, int* notfound) {
-    unsigned int i;
-    if (!bits) {
-        *notfound = 1;
-        return 0;
-    }
-    for (i = from_index; i < max; i++) {
-        if (cron_get_bit(bits, i)) return i;
-    }
-    *notfound = 1;
-    return 0;
-}
-
 static void push_to_fields_arr(int* arr, int fi) {
     int i;
     if (!arr || -1 == fi) {
@@ -262,60 +249,6 @@ static int add_to_field(struct tm* calendar, int field, int val) {
     return 0;
 }
 
-/**
- * Reset the calendar setting all the fields provided to zero.
- */
-static int reset_min(struct tm* calendar, int field) {
-    if (!calendar || -1 == field) {
-        return 1;
-    }
-    switch (field) {
-    case CRON_CF_SECOND:
-        calendar->tm_sec = 0;
-        break;
-    case CRON_CF_MINUTE:
-        calendar->tm_min = 0;
-        break;
-    case CRON_CF_HOUR_OF_DAY:
-        calendar->tm_hour = 0;
-        break;
-    case CRON_CF_DAY_OF_WEEK:
-        calendar->tm_wday = 0;
-        break;
-    case CRON_CF_DAY_OF_MONTH:
-        calendar->tm_mday = 1;
-        break;
-    case CRON_CF_MONTH:
-        calendar->tm_mon = 0;
-        break;
-    case CRON_CF_YEAR:
-        calendar->tm_year = 0;
-        break;
-    default:
-        return 1; /* unknown field */
-    }
-    time_t res = cron_mktime(calendar);
-    if (CRON_INVALID_INSTANT == res) {
-        return 1;
-    }
-    return 0;
-}
-
-static int reset_all_min(struct tm* calendar, int* fields) {
-    int i;
-    int res = 0;
-    if (!calendar || !fields) {
-        return 1;
-    }
-    for (i = 0; i < CRON_CF_ARR_LEN; i++) {
-        if (-1 != fields[i]) {
-            res = reset_min(calendar, fields[i]);
-            if (0 != res) return res;
-        }
-    }
-    return 0;
-}
-
 static int set_field(struct tm* calendar, int field, int val) {
     if (!calendar || -1 == field) {
         return 1;
@@ -352,157 +285,6 @@ static int set_field(struct tm* calendar, int field, int val) {
     return 0;
 }
 
-/**
- * Search the bits provided for the next set bit after the value provided,
- * and reset the calendar.
- */
-static unsigned int find_next(uint8_t* bits, unsigned int max, unsigned int value, struct tm* calendar, unsigned int field, unsigned int nextField, int* lower_orders, int* res_out) {
-    int notfound = 0;
-    int err = 0;
-    unsigned int next_value = next_set_bit(bits, max, value, &notfound);
-    /* roll over if needed */
-    if (notfound) {
-        err = add_to_field(calendar, nextField, 1);
-        if (err) goto return_error;
-        err = reset_min(calendar, field);
-        if (err) goto return_error;
-        notfound = 0;
-        next_value = next_set_bit(bits, max, 0, &notfound);
-    }
-    if (notfound || next_value != value) {
-        err = set_field(calendar, field, next_value);
-        if (err) goto return_error;
-        err = reset_all_min(calendar, lower_orders);
-        if (err) goto return_error;
-    }
-    return next_value;
-
-    return_error:
-    *res_out = 1;
-    return 0;
-}
-
-static unsigned int find_next_day(struct tm* calendar, uint8_t* days_of_month, unsigned int day_of_month, uint8_t* days_of_week, unsigned int day_of_week, int* resets, int* res_out) {
-    int err;
-    unsigned int count = 0;
-    unsigned int max = 366;
-    while ((!cron_get_bit(days_of_month, day_of_month) || !cron_get_bit(days_of_week, day_of_week)) && count++ < max) {
-        err = add_to_field(calendar, CRON_CF_DAY_OF_MONTH, 1);
-
-        if (err) goto return_error;
-        day_of_month = calendar->tm_mday;
-        day_of_week = calendar->tm_wday;
-        reset_all_min(calendar, resets);
-    }
-    return day_of_month;
-
-    return_error:
-    *res_out = 1;
-    return 0;
-}
-
-static int do_next(cron_expr* expr, struct tm* calendar, unsigned int dot) {
-    int i;
-    int res = 0;
-    int* resets = NULL;
-    int* empty_list = NULL;
-    unsigned int second = 0;
-    unsigned int update_second = 0;
-    unsigned int minute = 0;
-    unsigned int update_minute = 0;
-    unsigned int hour = 0;
-    unsigned int update_hour = 0;
-    unsigned int day_of_week = 0;
-    unsigned int day_of_month = 0;
-    unsigned int update_day_of_month = 0;
-    unsigned int month = 0;
-    unsigned int update_month = 0;
-
-
-    resets = (int*) cron_malloc(CRON_CF_ARR_LEN * sizeof(int));
-    if (!resets) goto return_result;
-    empty_list = (int*) cron_malloc(CRON_CF_ARR_LEN * sizeof(int));
-    if (!empty_list) goto return_result;
-    for (i = 0; i < CRON_CF_ARR_LEN; i++) {
-        resets[i] = -1;
-        empty_list[i] = -1;
-    }
-
-    second = calendar->tm_sec;
-    update_second = find_next(expr->seconds, CRON_MAX_SECONDS, second, calendar, CRON_CF_SECOND, CRON_CF_MINUTE, empty_list, &res);
-    if (0 != res) goto return_result;
-    if (second == update_second) {
-        push_to_fields_arr(resets, CRON_CF_SECOND);
-    }
-
-    minute = calendar->tm_min;
-    update_minute = find_next(expr->minutes, CRON_MAX_MINUTES, minute, calendar, CRON_CF_MINUTE,  CRON_CF_HOUR_OF_DAY, resets, &res);
-    
-     //////printf("\n minute - %d / update_minute - %d / res - %d\n",minute,update_minute,res);
-    
-    if (0 != res) goto return_result;
-    if (minute == update_minute) {
-        push_to_fields_arr(resets, CRON_CF_MINUTE);
-    } else {
-        res = do_next(expr, calendar, dot);
-        if (0 != res) goto return_result;
-    }
-
-    hour = calendar->tm_hour;
-    update_hour = find_next(expr->hours, CRON_MAX_HOURS, hour, calendar, CRON_CF_HOUR_OF_DAY, CRON_CF_DAY_OF_WEEK, resets, &res);
-    
-    //////printf("\n hour - %d / update_hour - %d / res - %d\n",hour,update_hour,res);
-    
-    if (0 != res) goto return_result;
-    if (hour == update_hour) {
-        push_to_fields_arr(resets, CRON_CF_HOUR_OF_DAY);
-    } else {
-        res = do_next(expr, calendar, dot);
-        if (0 != res) goto return_result;
-    }
-
-    day_of_week = calendar->tm_wday;
-    day_of_month = calendar->tm_mday;
-    update_day_of_month = find_next_day(calendar, expr->days_of_month, day_of_month, expr->days_of_week, day_of_week, resets, &res);
-
-    //////printf("\n day_of_month - %d / update_day_of_month - %d / res - %d\n",day_of_month,update_day_of_month,res);
-    
-    if (0 != res) goto return_result;
-    if (day_of_month == update_day_of_month) {
-        push_to_fields_arr(resets, CRON_CF_DAY_OF_MONTH);
-    } else {
-        res = do_next(expr, calendar, dot);
-        if (0 != res) goto return_result;
-    }
-
-    month = calendar->tm_mon; /*day already adds one if no day in same month is found*/
-    update_month = find_next(expr->months, CRON_MAX_MONTHS, month, calendar, CRON_CF_MONTH, CRON_CF_YEAR, resets, &res);
-    if (0 != res) goto return_result;
-    if (month != update_month) {
-        if (calendar->tm_year - dot > 4) {
-            res = -1;
-            goto return_result;
-        }
-        res = do_next(expr, calendar, dot);
-        if (0 != res) goto return_result;
-    }
-
-    goto return_result;
-
-    return_result:
-    if (!resets || !empty_list) {
-        res = -1;
-    }
-    if (resets) {
-        cron_free(resets);
-    }
-    if (empty_list) {
-        cron_free(empty_list);
-    }
-
-    return res;
-}
-
 static int to_upper(char* str) {
     if (!str) return 1;
     int i;
@@ -918,63 +700,197 @@ void cron_parse_expr(const char* expression, cron_expr* target, const char** err
     free_splitted(fields, len);
 }
 
-time_t cron_next(cron_expr* expr, time_t date) {
-    /*
-     The plan:
+/*
+ * Next firing over the parsed bit sets, without normalizing a struct tm
+ * field by field: each field jumps to its next set bit and the day of the
+ * month is chosen from one mask that already joins the days of the month
+ * with the days of the week of that month. Only the result goes through
+ * cron_mktime.
+ *
+ * The fields are UTC by default. The firmware builds with
+ * CRON_USE_LOCAL_TIME (root CMakeLists.txt), so they are in the local time
+ * of TZ: local times skipped by a DST change never fire, and a repeated
+ * hour fires on its first pass still ahead of 'date'. In UTC both cases
+ * cannot happen. Checked against a direct search in
+ * host_test/test_cron_next.c.
+ */
+
+typedef struct {
+    uint64_t seconds;
+    uint64_t minutes;
+    uint64_t hours;
+    uint64_t days_of_month;
+    uint64_t months;
+    uint8_t days_of_week;
+} cron_masks;
+
+static uint64_t load_mask(const uint8_t* bytes, size_t len) {
+    uint64_t mask = 0;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        mask |= (uint64_t) bytes[i] << (8 * i);
+    }
+    return mask;
+}
 
-     1 Round up to the next whole second
+static void compile_masks(const cron_expr* expr, cron_masks* masks) {
+    masks->seconds = load_mask(expr->seconds, sizeof(expr->seconds)) & ((1ULL << CRON_MAX_SECONDS) - 1);
+    masks->minutes = load_mask(expr->minutes, sizeof(expr->minutes)) & ((1ULL << CRON_MAX_MINUTES) - 1);
+    masks->hours = load_mask(expr->hours, sizeof(expr->hours)) & ((1ULL << CRON_MAX_HOURS) - 1);
+    masks->days_of_month = load_mask(expr->days_of_month, sizeof(expr->days_of_month)) & ((1ULL << CRON_MAX_DAYS_OF_MONTH) - 2);
+    masks->months = load_mask(expr->months, sizeof(expr->months)) & ((1ULL << CRON_MAX_MONTHS) - 1);
+    masks->days_of_week = expr->days_of_week[0] & 0x7F;
+}
 
-     2 If seconds match move on, otherwise find the next match:
-     2.1 If next match is in the next minute then roll forwards
+static int next_bit(uint64_t mask, int from) {
+    if (from >= 64) return -1;
+    mask &= ~0ULL << from;
+    return mask ? __builtin_ctzll(mask) : -1;
+}
 
-     3 If minute matches move on, otherwise find the next match
-     3.1 If next match is in the next hour then roll forwards
-     3.2 Reset the seconds and go to 2
+static int days_of_month_count(int year, int month) {
+    static const uint8_t days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (1 == month && (0 == year % 4 && (0 != year % 100 || 0 == year % 400))) {
+        return 29;
+    }
+    return days[month];
+}
 
-     4 If hour matches move on, otherwise find the next match
-     4.1 If next match is in the next day then roll forwards,
-     4.2 Reset the minutes and seconds and go to 2
+/* 0 = Sunday, year with the century, month 0..11 */
+static int first_week_day(int year, int month) {
+    static const uint8_t offset[12] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+    if (month < 2) year--;
+    return (year + year / 4 - year / 100 + year / 400 + offset[month] + 1) % 7;
+}
 
-     ...
-     */
- 
-    if (!expr) return CRON_INVALID_INSTANT;
+/* days (bit = day of the month) that match both day fields in that month */
+static uint64_t month_days_mask(const cron_masks* masks, int year, int month) {
+    int first = first_week_day(year, month);
+    uint64_t week = ((masks->days_of_week >> first) | (masks->days_of_week << (7 - first))) & 0x7F;
+    uint64_t days = week | (week << 7) | (week << 14) | (week << 21) | (week << 28);
+    return (days << 1) & masks->days_of_month & ((2ULL << days_of_month_count(year, month)) - 2);
+}
+
+static int find_next_fields(const cron_masks* masks, struct tm* calendar, int max_year) {
+    int next;
+    while (calendar->tm_year <= max_year) {
+        next = next_bit(masks->months, calendar->tm_mon);
+        if (-1 == next) {
+            calendar->tm_year++;
+            calendar->tm_mon = 0;
+            calendar->tm_mday = 1;
+            calendar->tm_hour = calendar->tm_min = calendar->tm_sec = 0;
+            continue;
+        }
+        if (next != calendar->tm_mon) {
+            calendar->tm_mon = next;
+            calendar->tm_mday = 1;
+            calendar->tm_hour = calendar->tm_min = calendar->tm_sec = 0;
+        }
+
+        next = next_bit(month_days_mask(masks, calendar->tm_year + 1900, calendar->tm_mon), calendar->tm_mday);
+        if (-1 == next) {
+            calendar->tm_mon++;
+            calendar->tm_mday = 1;
+            calendar->tm_hour = calendar->tm_min = calendar->tm_sec = 0;
+            continue;
+        }
+        if (next != calendar->tm_mday) {
+            calendar->tm_mday = next;
+            calendar->tm_hour = calendar->tm_min = calendar->tm_sec = 0;
+        }
+
+        next = next_bit(masks->hours, calendar->tm_hour);
+        if (-1 == next) {
+            calendar->tm_mday++;
+            calendar->tm_hour = calendar->tm_min = calendar->tm_sec = 0;
+            continue;
+        }
+        if (next != calendar->tm_hour) {
+            calendar->tm_hour = next;
+            calendar->tm_min = calendar->tm_sec = 0;
+        }
+
+        next = next_bit(masks->minutes, calendar->tm_min);
+        if (-1 == next) {
+            calendar->tm_hour++;
+            calendar->tm_min = calendar->tm_sec = 0;
+            continue;
+        }
+        if (next != calendar->tm_min) {
+            calendar->tm_min = next;
+            calendar->tm_sec = 0;
+        }
+
+        next = next_bit(masks->seconds, calendar->tm_sec);
+        if (-1 == next) {
+            calendar->tm_min++;
+            calendar->tm_sec = 0;
+            continue;
+        }
+        calendar->tm_sec = next;
+        return 0;
+    }
+    return 1;
+}
+
+static int same_fields(const struct tm* a, const struct tm* b) {
+    return a->tm_year == b->tm_year && a->tm_mon == b->tm_mon && a->tm_mday == b->tm_mday &&
+            a->tm_hour == b->tm_hour && a->tm_min == b->tm_min && a->tm_sec == b->tm_sec;
+}
+
+static time_t next_from_masks(const cron_masks* masks, time_t date) {
     struct tm calval;
-    memset(&calval, 0, sizeof(struct tm));
- 
-    struct tm* calendar = cron_time(&date, &calval);
-  
-    if (!calendar) return CRON_INVALID_INSTANT;
-   
-    time_t original = cron_mktime(calendar);
-    
-    if (CRON_INVALID_INSTANT == original) return CRON_INVALID_INSTANT;
-//////printf("\n\nCRON TAB 75 %d\n\n",calendar->tm_year);
-    int res = do_next(expr, calendar, calendar->tm_year);
+    struct tm result;
+    time_t start = date + 1;
+    time_t calculated;
+    time_t candidate;
+    int shift;
+    int max_year;
 
-    if (0 != res) return CRON_INVALID_INSTANT;
- 
+    memset(&calval, 0, sizeof(struct tm));
+    if (!cron_time(&start, &calval)) return CRON_INVALID_INSTANT;
+    max_year = calval.tm_year + CRON_MAX_YEARS_DIFF + 1;
+
+    while (0 == find_next_fields(masks, &calval, max_year)) {
+        result = calval;
+        result.tm_isdst = -1;
+        calculated = cron_mktime(&result);
+
+        /* an hour repeated when the clock goes back fires on its first pass still ahead */
+        for (shift = -3600; CRON_INVALID_INSTANT != calculated && shift <= 3600; shift += 3600) {
+            candidate = calculated + shift;
+            if (candidate > date && cron_time(&candidate, &result) && same_fields(&result, &calval)) {
+                return candidate;
+            }
+        }
 
-    time_t calculated = cron_mktime(calendar);
-    
-    if (CRON_INVALID_INSTANT == calculated) return CRON_INVALID_INSTANT;
-    
-    if (calculated == original) {
-        /* We arrived at the original timestamp - round up to the next whole second and try again... */
-        
-        res = add_to_field(calendar, CRON_CF_SECOND, 1);
-       
-        if (0 != res) return CRON_INVALID_INSTANT;
-        
-        res = do_next(expr, calendar, calendar->tm_year);
-        
-        if (0 != res) return CRON_INVALID_INSTANT;
-       
+        /* skipped by the clock going forward: try the next second */
+        calval.tm_sec++;
     }
-    
-    return cron_mktime(calendar);
+
+    return CRON_INVALID_INSTANT;
+}
+
+time_t cron_next(cron_expr* expr, time_t date) {
+    cron_masks masks;
+    if (!expr) return CRON_INVALID_INSTANT;
+    compile_masks(expr, &masks);
+    return next_from_masks(&masks, date);
 }
 
+int cron_next_n(cron_expr* expr, time_t date, int n, time_t* out) {
+    cron_masks masks;
+    int count = 0;
+    if (!expr || !out) return 0;
+    compile_masks(expr, &masks);
+    while (count < n) {
+        date = next_from_masks(&masks, date);
+        if (CRON_INVALID_INSTANT == date) break;
+        out[count++] = date;
+    }
+    return count;
+}
 
 /* https://github.com/staticlibs/ccronexpr/pull/8 */
 
@@ -73,6 +73,18 @@ void cron_parse_expr(const char* expression, cron_expr* target, const char** err
  */
 time_t cron_next(cron_expr* expr, time_t date);
 
+/**
+ * Fills 'out' with the next 'n' fire dates after the specified date, in
+ * order, as repeated calls to 'cron_next' would.
+ *
+ * @param expr parsed cron expression to use in next date calculation
+ * @param date start date to start calculation from
+ * @param n number of fire dates wanted
+ * @param out array with room for 'n' dates
+ * @return number of dates written, less than 'n' if the expression stops matching
+ */
+int cron_next_n(cron_expr* expr, time_t date, int n, time_t* out);
+
 /**
  * Uses the specified expression to calculate the previous 'fire' date after
  * the specified date. All dates are processed as UTC (GMT) dates 
@@ -0,0 +1,274 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "cmd_dispatch.h"
+#include "cmd_list.h"
+#include <string.h>
+
+#define ARG_NONE {CMD_ARG_NONE, 0, 0}
+#define ARG_TEXT {CMD_ARG_TEXT, 0, 0}
+#define ARG_UINT(min, max) {CMD_ARG_UINT, (min), (max)}
+
+#define BLE_UDP (CMD_CHANNEL_BLE | CMD_CHANNEL_UDP)
+
+#define INPUT(element, number, cmd, param)                                     \
+  {element, cmd, param, number, CMD_CHANNEL_ALL, '0', CMD_HANDLER_INPUT,        \
+   ARG_NONE}
+#define INPUT_RULES(cmd, arg)                                                  \
+  {INPUT_RULES_ELEMENT, cmd, INPUT_RULES_PARAMETER, 0, BLE_UDP, '2',           \
+   CMD_HANDLER_INPUT_RULES, arg}
+#define SYSTEM(cmd, param, arg)                                                \
+  {ADMIN_ELEMENT, cmd, param, 0, CMD_CHANNEL_ALL, '0', CMD_HANDLER_SYSTEM, arg}
+#define RELE(element, number, cmd, param, arg)                                 \
+  {element, cmd, param, number, CMD_CHANNEL_ALL, '0', CMD_HANDLER_RELE, arg}
+#define RF(cmd, param)                                                         \
+  {RF_ELEMENT, cmd, param, 0, BLE_UDP, '0', CMD_HANDLER_RF, ARG_TEXT}
+#define ROUTINE(cmd, param, arg)                                               \
+  {ROUTINE_ELEMENT, cmd, param, 0, BLE_UDP, '2', CMD_HANDLER_ROUTINES, arg}
+#define USER(cmd, param)                                                       \
+  {USER_ELEMENT, cmd, param, 0, CMD_CHANNEL_ALL, '0', CMD_HANDLER_USERS,       \
+   ARG_TEXT}
+#define WIEGAND(cmd, param)                                                    \
+  {WIEGAND_ELEMENT, cmd, param, 0, CMD_CHANNEL_ALL, '0', CMD_HANDLER_WIEGAND,  \
+   ARG_TEXT}
+
+#define RELE_COMMANDS(element, number)                                         \
+  RELE(element, number, GET_CMD, PAIRING_PARAMETER, ARG_NONE),                 \
+      RELE(element, number, GET_CMD, RELE_MODE_PARAMETER, ARG_NONE),           \
+      RELE(element, number, GET_CMD, RELE_PARAMETER, ARG_NONE),                \
+      RELE(element, number, GET_CMD, TIME_PARAMETER, ARG_NONE),                \
+      RELE(element, number, RESET_CMD, PAIRING_PARAMETER, ARG_TEXT),           \
+      RELE(element, number, RESET_CMD, RELE_MODE_PARAMETER, ARG_TEXT),         \
+      RELE(element, number, RESET_CMD, RELE_PARAMETER, ARG_TEXT),              \
+      RELE(element, number, RESET_CMD, TIME_PARAMETER, ARG_TEXT),              \
+      RELE(element, number, SET_CMD, PAIRING_PARAMETER, ARG_TEXT),             \
+      RELE(element, number, SET_CMD, RELE_MODE_PARAMETER, ARG_TEXT),           \
+      RELE(element, number, SET_CMD, RELE_PARAMETER, ARG_TEXT),                \
+      /* acima de RELE_BISTATE_MAX_TIME o rele.c responde RELAY TIME ERROR */  \
+      RELE(element, number, SET_CMD, TIME_PARAMETER, ARG_UINT(0, 99999))
+
+/* ordenada por CMD_DISPATCH_KEY: elemento, comando ('G' < 'R' < 'S') e
+   parametro por ordem ASCII; test_cmd_dispatch falha se a ordem se perder */
+const cmd_dispatch_entry cmd_dispatch_table[] = {
+    INPUT(INPUT1_ELEMENT, 1, GET_CMD, INPUT_PARAMETER),
+    INPUT(INPUT2_ELEMENT, 2, GET_CMD, INPUT_PARAMETER),
+
+    INPUT_RULES(GET_CMD, ARG_NONE),
+    INPUT_RULES(RESET_CMD, ARG_NONE),
+    INPUT_RULES(SET_CMD, ARG_TEXT),
+
+    SYSTEM(GET_CMD, CLOCK_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, GET_IMEI_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, BLOCK_FEEDBACK_SMS_PARAMETER, ARG_NONE),
+    {ADMIN_ELEMENT, GET_CMD, HOUR_PARAMETER, 0, BLE_UDP, '2',
+     CMD_HANDLER_LOG_FILES, ARG_TEXT},
+    SYSTEM(GET_CMD, SYSTEM_BLE_START_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, LAST_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, M200_FIRMWARE_HARDWARE_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, NAME_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, SIM_IMEI_ESPMAC_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, SIGNAL_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, REDITECT_SMS_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, SOUND_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, SMS_CALL_VERIFICATION_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, INPUT_REX_PARAMETER, ARG_NONE),
+    SYSTEM(GET_CMD, COUNTRY_CODE_PARAMETER, ARG_NONE),
+    {ADMIN_ELEMENT, GET_CMD, HEALTH_PARAMETER, 0, BLE_UDP, '2',
+     CMD_HANDLER_HEALTH, ARG_NONE},
+    SYSTEM(RESET_CMD, ADMIN_PARAMETER, ARG_TEXT),
+    SYSTEM(RESET_CMD, NETWORK_LOGS_LABEL_PARAMETER, ARG_NONE),
+    SYSTEM(RESET_CMD, BLOCK_FEEDBACK_SMS_PARAMETER, ARG_NONE),
+    SYSTEM(RESET_CMD, START_DOWNLOAD_FILE, ARG_TEXT),
+    SYSTEM(RESET_CMD, FORMAT_SDCARD_PARAMETER, ARG_NONE),
+    SYSTEM(RESET_CMD, NAME_PARAMETER, ARG_NONE),
+    SYSTEM(RESET_CMD, OWNER_PARAMETER, ARG_TEXT),
+    SYSTEM(RESET_CMD, SIM_IMEI_ESPMAC_PARAMETER, ARG_TEXT),
+    SYSTEM(RESET_CMD, REDITECT_SMS_PARAMETER, ARG_NONE),
+    SYSTEM(RESET_CMD, USER_PARAMETER, ARG_TEXT),
+    SYSTEM(RESET_CMD, NETWORK_LABEL_PARAMETER, ARG_NONE),
+    SYSTEM(SET_CMD, ADMIN_PARAMETER, ARG_TEXT),
+    SYSTEM(SET_CMD, CLOCK_PARAMETER, ARG_TEXT),
+    SYSTEM(SET_CMD, M200_RELAYS_CONFIGURATION_PARAMETER, ARG_TEXT),
+    SYSTEM(SET_CMD, NETWORK_LOGS_LABEL_PARAMETER, ARG_NONE),
+    SYSTEM(SET_CMD, BLOCK_FEEDBACK_SMS_PARAMETER, ARG_NONE),
+    SYSTEM(SET_CMD, SMS_TRANSLATE_PARAMETER, ARG_TEXT),
+    SYSTEM(SET_CMD, NAME_PARAMETER, ARG_TEXT),
+    SYSTEM(SET_CMD, EG91_FOTA_PARAMETER, ARG_TEXT),
+    SYSTEM(SET_CMD, REDITECT_SMS_PARAMETER, ARG_NONE),
+    SYSTEM(SET_CMD, SOUND_PARAMETER, ARG_TEXT),
+    SYSTEM(SET_CMD, LANGUAGE_FILE_PARAMETER, ARG_TEXT),
+    SYSTEM(SET_CMD, USER_PARAMETER, ARG_TEXT),
+    SYSTEM(SET_CMD, SMS_CALL_VERIFICATION_PARAMETER, ARG_UINT(0, 4)),
+    SYSTEM(SET_CMD, NETWORK_LABEL_PARAMETER, ARG_NONE),
+    SYSTEM(SET_CMD, INPUT_REX_PARAMETER, ARG_UINT(0, 3)),
+    SYSTEM(SET_CMD, COUNTRY_CODE_PARAMETER, ARG_TEXT),
+
+    RELE_COMMANDS(RELE1_ELEMENT, 1),
+    RELE_COMMANDS(RELE2_ELEMENT, 2),
+
+    RF(GET_CMD, RF_GET_PARAMETER),
+    RF(RESET_CMD, RF_SAVE_COMMAND_PARAMETER),
+    RF(RESET_CMD, RF_ROLLING_CODE_PARAMETER),
+    RF(RESET_CMD, RF_SAVE_AUTO_PARAMETER),
+    RF(SET_CMD, RF_SAVE_COMMAND_PARAMETER),
+    RF(SET_CMD, RF_CELL_PHONE_NUMBER_PARAMETER),
+    RF(SET_CMD, RF_ROLLING_CODE_PARAMETER),
+    RF(SET_CMD, RF_SAVE_AUTO_PARAMETER),
+
+    ROUTINE(GET_CMD, ROUTINE_DAY_EXCEPTION_PARAMETER, ARG_NONE),
+    ROUTINE(GET_CMD, ROUTINES_HOLIDAYS_RANGE_PARAMETER, ARG_NONE),
+    ROUTINE(GET_CMD, ROUTINE_HOLIDAYS_MOBILE_DAYS, ARG_NONE),
+    ROUTINE(GET_CMD, ROUTINE_PREVIEW_PARAMETER, ARG_TEXT),
+    ROUTINE(GET_CMD, ROUTINE_PARAMETER, ARG_NONE),
+    ROUTINE(GET_CMD, ROUTINE_RANGE_PARAMETER, ARG_NONE),
+    ROUTINE(RESET_CMD, ROUTINE_DAY_EXCEPTION_PARAMETER, ARG_NONE),
+    ROUTINE(RESET_CMD, ROUTINES_HOLIDAYS_RANGE_PARAMETER, ARG_NONE),
+    ROUTINE(RESET_CMD, ROUTINE_HOLIDAYS_MOBILE_DAYS, ARG_NONE),
+    ROUTINE(RESET_CMD, ROUTINE_PARAMETER, ARG_NONE),
+    ROUTINE(RESET_CMD, ROUTINE_RANGE_PARAMETER, ARG_NONE),
+    ROUTINE(SET_CMD, ROUTINE_ACTIVATE_PARAMETER, ARG_NONE),
+    ROUTINE(SET_CMD, ROUTINE_DAY_EXCEPTION_PARAMETER, ARG_TEXT),
+    ROUTINE(SET_CMD, ROUTINES_HOLIDAYS_RANGE_PARAMETER, ARG_TEXT),
+    ROUTINE(SET_CMD, ROUTINE_HOLIDAYS_MOBILE_DAYS, ARG_TEXT),
+    ROUTINE(SET_CMD, ROUTINE_PARAMETER, ARG_TEXT),
+    ROUTINE(SET_CMD, ROUTINE_RANGE_PARAMETER, ARG_TEXT),
+
+    {USER_ELEMENT, GET_CMD, ALL_PARAMETER, 0, BLE_UDP, '1',
+     CMD_HANDLER_READ_ALL_USERS, ARG_NONE},
+    USER(GET_CMD, DATE_PARAMETER),
+    USER(GET_CMD, HOUR_PARAMETER),
+    USER(GET_CMD, LAST_PARAMETER),
+    USER(GET_CMD, NAME_PARAMETER),
+    USER(GET_CMD, RELE_RESTRITION_PARAMETER),
+    USER(GET_CMD, USER_PARAMETER),
+    USER(GET_CMD, WEEK_PARAMETER),
+    USER(RESET_CMD, ALL_PARAMETER),
+    USER(RESET_CMD, USER_RESET_PASSWORD_PARAMETER),
+    USER(RESET_CMD, USER_RESET_BLE_SECURITY_PARAMETER),
+    USER(RESET_CMD, LAST_PARAMETER),
+    USER(RESET_CMD, USER_PARAMETER),
+    USER(SET_CMD, ADMIN_PARAMETER),
+    USER(SET_CMD, DATE_PARAMETER),
+    USER(SET_CMD, HOUR_PARAMETER),
+    USER(SET_CMD, IMPORT_USERS_HTTPS_PARAMETER),
+    USER(SET_CMD, LAST_PARAMETER),
+    USER(SET_CMD, MULTI_USERS_PARAMETER),
+    USER(SET_CMD, NAME_PARAMETER),
+    USER(SET_CMD, RELE_RESTRITION_PARAMETER),
+    USER(SET_CMD, USER_PARAMETER),
+    USER(SET_CMD, WEEK_PARAMETER),
+
+    WIEGAND(GET_CMD, WIEGANG_NUMBER_PARAMETER),
+    WIEGAND(RESET_CMD, ACTIVATE_ANTIPASSBACK_PARAMETER),
+    WIEGAND(RESET_CMD, WIEGANG_TURN_ON_OFF_PARAMETER),
+    WIEGAND(RESET_CMD, WIEGAND_START_AUTO_SAVE_PARAMETER),
+    WIEGAND(RESET_CMD, WIEGANG_NUMBER_PARAMETER),
+    WIEGAND(SET_CMD, ACTIVATE_ANTIPASSBACK_PARAMETER),
+    WIEGAND(SET_CMD, WIEGANG_TURN_ON_OFF_PARAMETER),
+    WIEGAND(SET_CMD, WIEGANG_PHONE_NUMBER_PARAMETER),
+    WIEGAND(SET_CMD, WIEGAND_CHANGE_RELAY_PARAMETER),
+    WIEGAND(SET_CMD, WIEGAND_START_AUTO_SAVE_PARAMETER),
+    WIEGAND(SET_CMD, WIEGANG_NUMBER_PARAMETER),
+};
+
+const uint16_t cmd_dispatch_table_size =
+    sizeof(cmd_dispatch_table) / sizeof(cmd_dispatch_table[0]);
+
+static uint32_t entry_Key(uint16_t index) {
+  return CMD_DISPATCH_KEY(cmd_dispatch_table[index].element,
+                          cmd_dispatch_table[index].cmd,
+                          cmd_dispatch_table[index].parameter);
+}
+
+/* primeira entrada com chave >= key */
+static uint16_t lower_Bound(uint32_t key) {
+  uint16_t low = 0;
+  uint16_t high = cmd_dispatch_table_size;
+
+  while (low < high) {
+    uint16_t mid = (low + high) / 2;
+
+    if (entry_Key(mid) < key) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  return low;
+}
+
+static uint8_t is_Element(const char *element) {
+  return element != NULL && element[0] != 0 && element[1] != 0 &&
+         element[2] == 0;
+}
+
+const cmd_dispatch_entry *cmd_Dispatch_Find(const char *element, char cmd,
+                                            char parameter) {
+  uint32_t key;
+  uint16_t index;
+
+  if (!is_Element(element)) {
+    return NULL;
+  }
+
+  key = CMD_DISPATCH_KEY(element, cmd, parameter);
+  index = lower_Bound(key);
+
+  if (index < cmd_dispatch_table_size && entry_Key(index) == key) {
+    return &cmd_dispatch_table[index];
+  }
+
+  return NULL;
+}
+
+uint8_t cmd_Dispatch_Has_Element(const char *element) {
+  uint16_t index;
+
+  if (!is_Element(element)) {
+    return 0;
+  }
+
+  index = lower_Bound(CMD_DISPATCH_KEY(element, 0, 0));
+
+  return index < cmd_dispatch_table_size &&
+         cmd_dispatch_table[index].element[0] == element[0] &&
+         cmd_dispatch_table[index].element[1] == element[1];
+}
+
+uint8_t cmd_Dispatch_Check_Arg(const cmd_dispatch_entry *entry,
+                               const char *payload) {
+  size_t len = payload == NULL ? 0 : strlen(payload);
+  uint32_t value = 0;
+
+  switch (entry->arg.type) {
+  case CMD_ARG_NONE:
+    return 1;
+  case CMD_ARG_TEXT:
+    return len >= entry->arg.min &&
+           (entry->arg.max == 0 || len <= entry->arg.max);
+  case CMD_ARG_UINT:
+    if (len == 0 || len > CMD_ARG_UINT_DIGITS) {
+      return 0;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+      if (payload[i] < '0' || payload[i] > '9') {
+        return 0;
+      }
+
+      value = value * 10 + (payload[i] - '0');
+    }
+
+    return value >= entry->arg.min && value <= entry->arg.max;
+  }
+
+  return 0;
+}
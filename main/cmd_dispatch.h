@@ -0,0 +1,88 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _CMD_DISPATCH_H_
+#define _CMD_DISPATCH_H_
+
+#include <stdint.h>
+
+/*
+ * Tabela de comandos "XX.C.P": uma entrada por elemento, comando e
+ * parametro, ordenada por CMD_DISPATCH_KEY para pesquisa binaria. Cada
+ * entrada indica o handler (core.c), os canais, a permissao minima e o
+ * formato do argumento, que e validado antes de chamar o handler.
+ * Sem dependencias do ESP-IDF: host_test/test_cmd_dispatch.c confirma a
+ * ordem da tabela e percorre o codebook do UDP_Codes.c.
+ */
+
+/* bits (1 << BLE_INDICATION), (1 << SMS_INDICATION), (1 << UDP_INDICATION) */
+#define CMD_CHANNEL_BLE (1 << 1)
+#define CMD_CHANNEL_SMS (1 << 2)
+#define CMD_CHANNEL_UDP (1 << 3)
+#define CMD_CHANNEL_ALL (CMD_CHANNEL_BLE | CMD_CHANNEL_SMS | CMD_CHANNEL_UDP)
+
+#define CMD_DISPATCH_KEY(element, cmd, parameter)                              \
+  (((uint32_t)(uint8_t)(element)[0] << 24) |                                  \
+   ((uint32_t)(uint8_t)(element)[1] << 16) | ((uint32_t)(uint8_t)(cmd) << 8) | \
+   (uint32_t)(uint8_t)(parameter))
+
+/* numero maximo de digitos de um CMD_ARG_UINT */
+#define CMD_ARG_UINT_DIGITS 5
+
+typedef enum {
+  CMD_HANDLER_INPUT,
+  CMD_HANDLER_INPUT_RULES,
+  CMD_HANDLER_SYSTEM,
+  CMD_HANDLER_LOG_FILES,
+  CMD_HANDLER_HEALTH,
+  CMD_HANDLER_RELE,
+  CMD_HANDLER_RF,
+  CMD_HANDLER_ROUTINES,
+  CMD_HANDLER_USERS,
+  CMD_HANDLER_READ_ALL_USERS,
+  CMD_HANDLER_WIEGAND,
+  CMD_HANDLER_COUNT
+} cmd_handler_id;
+
+typedef enum {
+  CMD_ARG_NONE, /* o handler nao le o argumento */
+  CMD_ARG_TEXT, /* texto com min..max caracteres, max 0 sem limite */
+  CMD_ARG_UINT, /* so digitos (ate CMD_ARG_UINT_DIGITS), valor em min..max */
+} cmd_arg_type;
+
+typedef struct {
+  uint8_t type;
+  uint32_t min;
+  uint32_t max;
+} cmd_arg_schema;
+
+typedef struct {
+  char element[3];
+  char cmd;
+  char parameter;
+  uint8_t number;
+  uint8_t channels;
+  char min_permition;
+  uint8_t handler;
+  cmd_arg_schema arg;
+} cmd_dispatch_entry;
+
+extern const cmd_dispatch_entry cmd_dispatch_table[];
+extern const uint16_t cmd_dispatch_table_size;
+
+const cmd_dispatch_entry *cmd_Dispatch_Find(const char *element, char cmd,
+                                            char parameter);
+
+uint8_t cmd_Dispatch_Has_Element(const char *element);
+
+uint8_t cmd_Dispatch_Check_Arg(const cmd_dispatch_entry *entry,
+                               const char *payload);
+
+#endif
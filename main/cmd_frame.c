@@ -0,0 +1,239 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "cmd_frame.h"
+#include "UDP_Codes.h"
+#include "core.h"
+#include "crc32.h"
+#include "nvs.h"
+#include <string.h>
+
+/* canais (BLE_INDICATION, SMS_INDICATION, UDP_INDICATION) que ja negociaram
+   a trama binaria */
+static uint8_t cmd_frame_channel[UDP_INDICATION + 1];
+
+static size_t put_varint(uint8_t *out, size_t value) {
+  size_t n = 0;
+
+  do {
+    out[n] = value & 0x7F;
+    value >>= 7;
+
+    if (value) {
+      out[n] |= 0x80;
+    }
+    n++;
+  } while (value);
+
+  return n;
+}
+
+static size_t get_varint(const uint8_t *in, size_t in_len, size_t *value) {
+  size_t n = 0;
+  uint8_t shift = 0;
+
+  *value = 0;
+
+  while (n < in_len && shift < 21) {
+    *value |= (size_t)(in[n] & 0x7F) << shift;
+
+    if (!(in[n++] & 0x80)) {
+      return n;
+    }
+    shift += 7;
+  }
+
+  return 0;
+}
+
+uint8_t is_Cmd_Frame(const uint8_t *data, size_t len) {
+  return len >= CMD_FRAME_HEADER_SIZE + CMD_FRAME_CRC_SIZE &&
+         data[0] == CMD_FRAME_MAGIC;
+}
+
+void reset_Cmd_Frame_Channel(uint8_t BLE_SMS_Indication) {
+  if (BLE_SMS_Indication <= UDP_INDICATION) {
+    cmd_frame_channel[BLE_SMS_Indication] = 0;
+  }
+}
+
+size_t build_Cmd_Frame(uint8_t opcode, uint8_t flags, uint8_t tag,
+                       const uint8_t *value, size_t value_len, uint8_t *out,
+                       size_t out_size) {
+  uint8_t varint[3];
+  size_t varint_len = 0;
+  size_t body_len = 2;
+  uint32_t crc = 0;
+
+  if (out_size < CMD_FRAME_HEADER_SIZE + CMD_FRAME_CRC_SIZE) {
+    return 0;
+  }
+
+  if (value != NULL) {
+    /* corta o valor se nao couber no buffer de saida */
+    if (value_len > out_size - CMD_FRAME_HEADER_SIZE - CMD_FRAME_CRC_SIZE -
+                        1 - sizeof(varint)) {
+      value_len = out_size - CMD_FRAME_HEADER_SIZE - CMD_FRAME_CRC_SIZE - 1 -
+                  sizeof(varint);
+    }
+
+    varint_len = put_varint(varint, value_len);
+    body_len += 1 + varint_len + value_len;
+  }
+
+  out[0] = CMD_FRAME_MAGIC;
+  out[1] = body_len & 0xFF;
+  out[2] = (body_len >> 8) & 0xFF;
+  out[3] = opcode;
+  out[4] = flags;
+
+  if (value != NULL) {
+    out[CMD_FRAME_HEADER_SIZE] = tag;
+    memcpy(out + CMD_FRAME_HEADER_SIZE + 1, varint, varint_len);
+    memcpy(out + CMD_FRAME_HEADER_SIZE + 1 + varint_len, value, value_len);
+  }
+
+  crc = crc32(out + 3, body_len);
+
+  for (size_t i = 0; i < CMD_FRAME_CRC_SIZE; i++) {
+    out[3 + body_len + i] = (crc >> (8 * i)) & 0xFF;
+  }
+
+  return 3 + body_len + CMD_FRAME_CRC_SIZE;
+}
+
+static size_t rsp_Cmd_Frame_Error(uint8_t opcode, const char *error,
+                                  uint8_t *rsp_frame, size_t rsp_size) {
+  return build_Cmd_Frame(opcode, CMD_FRAME_FLAG_RESPONSE | CMD_FRAME_FLAG_ERROR,
+                         CMD_FRAME_TAG_RESPONSE, (const uint8_t *)error,
+                         strlen(error), rsp_frame, rsp_size);
+}
+
+size_t parse_Cmd_Frame(const uint8_t *frame, size_t frame_len,
+                       uint8_t BLE_SMS_Indication, uint8_t gattsIF,
+                       uint16_t connID, uint16_t handle_table,
+                       mqtt_information *mqttInfo, uint8_t *rsp_frame,
+                       size_t rsp_size) {
+  char phNumber[18];
+  char phPassword[7];
+  char input_Payload[512];
+  char element[3];
+  char *output_Data = NULL;
+  size_t body_len = 0;
+  size_t rsp_len = 0;
+  size_t index = 0;
+  uint32_t crc = 0;
+  uint8_t opcode = 0;
+
+  if (!is_Cmd_Frame(frame, frame_len) || BLE_SMS_Indication == SMS_INDICATION ||
+      BLE_SMS_Indication > UDP_INDICATION) {
+    return 0;
+  }
+
+  body_len = frame[1] | (frame[2] << 8);
+
+  if (body_len < 2 || 3 + body_len + CMD_FRAME_CRC_SIZE > frame_len) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < CMD_FRAME_CRC_SIZE; i++) {
+    crc |= (uint32_t)frame[3 + body_len + i] << (8 * i);
+  }
+
+  if (crc != crc32((uint8_t *)frame + 3, body_len)) {
+    return 0;
+  }
+
+  opcode = frame[3];
+
+  if (opcode == CMD_FRAME_OPCODE_HELLO) {
+    uint8_t version[2] = {CMD_FRAME_VERSION, UDP_CODES_NUMBER};
+
+    cmd_frame_channel[BLE_SMS_Indication] = 1;
+    return build_Cmd_Frame(CMD_FRAME_OPCODE_HELLO, CMD_FRAME_FLAG_RESPONSE,
+                           CMD_FRAME_TAG_VERSION, version, sizeof(version),
+                           rsp_frame, rsp_size);
+  }
+
+  if (!cmd_frame_channel[BLE_SMS_Indication] || opcode > UDP_CODES_NUMBER) {
+    return rsp_Cmd_Frame_Error(opcode, return_Json_SMS_Data("ERROR_CMD"),
+                               rsp_frame, rsp_size);
+  }
+
+  if (get_INT8_Data_From_Storage(NVS_KEY_OWNER_LABEL, nvs_System_handle) !=
+      1) {
+    return rsp_Cmd_Frame_Error(opcode, "OWNER NOT EXIST", rsp_frame, rsp_size);
+  }
+
+  memset(phNumber, 0, sizeof(phNumber));
+  memset(phPassword, 0, sizeof(phPassword));
+  memset(input_Payload, 0, sizeof(input_Payload));
+  memset(element, 0, sizeof(element));
+
+  index = CMD_FRAME_HEADER_SIZE;
+
+  while (index < 3 + body_len) {
+    uint8_t tag = frame[index++];
+    size_t value_len = 0;
+    size_t n = get_varint(frame + index, 3 + body_len - index, &value_len);
+
+    if (n == 0 || index + n + value_len > 3 + body_len) {
+      return rsp_Cmd_Frame_Error(
+          opcode, return_Json_SMS_Data("ERROR_INPUT_DATA"), rsp_frame,
+          rsp_size);
+    }
+    index += n;
+
+    switch (tag) {
+    case CMD_FRAME_TAG_PHONE:
+      memcpy(phNumber, frame + index,
+             value_len < sizeof(phNumber) ? value_len : sizeof(phNumber) - 1);
+      break;
+
+    case CMD_FRAME_TAG_PASSWORD:
+      memcpy(phPassword, frame + index,
+             value_len < sizeof(phPassword) ? value_len
+                                            : sizeof(phPassword) - 1);
+      break;
+
+    case CMD_FRAME_TAG_PAYLOAD:
+      memcpy(input_Payload, frame + index,
+             value_len < sizeof(input_Payload) ? value_len
+                                               : sizeof(input_Payload) - 1);
+      break;
+
+    default:
+      break;
+    }
+
+    index += value_len;
+  }
+
+  memcpy(element, list_Codes_Codec[opcode - 1], 2);
+
+  output_Data = dispatch_InputCommand(
+      BLE_SMS_Indication, phNumber, phPassword, element,
+      list_Codes_Codec[opcode - 1][3], list_Codes_Codec[opcode - 1][5],
+      input_Payload, gattsIF, connID, handle_table, NULL, mqttInfo);
+
+  if (output_Data == NULL) {
+    return 0;
+  }
+
+  if (strstr(output_Data, "NTRSP") == NULL) {
+    rsp_len = build_Cmd_Frame(opcode, CMD_FRAME_FLAG_RESPONSE,
+                              CMD_FRAME_TAG_RESPONSE, (uint8_t *)output_Data,
+                              strlen(output_Data), rsp_frame, rsp_size);
+  }
+
+  free(output_Data);
+
+  return rsp_len;
+}
@@ -0,0 +1,64 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _CMD_FRAME_H_
+#define _CMD_FRAME_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "EG91.h"
+
+/*
+ * Trama binaria de comandos (BLE e MQTT), alternativa ao texto
+ * "<telefone> <password> XX.C.P <payload>":
+ *
+ *   [MAGIC][LEN lo][LEN hi][OPCODE][FLAGS][TLV ...][CRC32 x4]
+ *
+ * LEN conta os bytes de OPCODE ate ao fim dos TLV, o CRC32 (crc32.c) e
+ * calculado sobre esses mesmos bytes e enviado em little endian.
+ * Cada TLV e [TAG][LEN varint][VALOR]. O OPCODE N (1..UDP_CODES_NUMBER)
+ * corresponde a list_Codes_Codec[N - 1]; o OPCODE 0 negocia o canal.
+ * O SMS continua a usar apenas a sintaxe de texto.
+ */
+
+#define CMD_FRAME_MAGIC 0xA5
+#define CMD_FRAME_VERSION 1
+
+#define CMD_FRAME_HEADER_SIZE 5
+#define CMD_FRAME_CRC_SIZE 4
+#define CMD_FRAME_MAX_SIZE 600
+
+#define CMD_FRAME_OPCODE_HELLO 0x00
+
+#define CMD_FRAME_FLAG_RESPONSE 0x01
+#define CMD_FRAME_FLAG_ERROR 0x02
+
+#define CMD_FRAME_TAG_PHONE 0x01
+#define CMD_FRAME_TAG_PASSWORD 0x02
+#define CMD_FRAME_TAG_PAYLOAD 0x03
+#define CMD_FRAME_TAG_RESPONSE 0x04
+#define CMD_FRAME_TAG_VERSION 0x05
+
+uint8_t is_Cmd_Frame(const uint8_t *data, size_t len);
+
+size_t build_Cmd_Frame(uint8_t opcode, uint8_t flags, uint8_t tag,
+                       const uint8_t *value, size_t value_len, uint8_t *out,
+                       size_t out_size);
+
+size_t parse_Cmd_Frame(const uint8_t *frame, size_t frame_len,
+                       uint8_t BLE_SMS_Indication, uint8_t gattsIF,
+                       uint16_t connID, uint16_t handle_table,
+                       mqtt_information *mqttInfo, uint8_t *rsp_frame,
+                       size_t rsp_size);
+
+void reset_Cmd_Frame_Channel(uint8_t BLE_SMS_Indication);
+
+#endif
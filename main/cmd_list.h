@@ -31,6 +31,7 @@
 
 #define INPUT1_ELEMENT "I1"
 #define INPUT2_ELEMENT "I2"
+#define INPUT_RULES_ELEMENT "IR"
 
 #define FEEDBACK1_ELEMENT "F1"
 #define FEEDBACK2_ELEMENT "F2"
@@ -65,6 +66,7 @@
 #define PAIRING_PARAMETER 'B'
 #define INPUT_PARAMETER 'I'
 #define INPUT_REX_PARAMETER 'X'
+#define INPUT_RULES_PARAMETER 'R'
 #define PHONE_PARAMETER 'P'
 #define LAST_PARAMETER 'L'
 #define SIGNAL_PARAMETER 'Q'
@@ -104,6 +106,7 @@
 #define M200_ACTIVATE_NETWORK 'Q'
 #define ROUTINES_HOLIDAYS_RANGE_PARAMETER 'F'
 #define ROUTINE_HOLIDAYS_MOBILE_DAYS 'H'
+#define ROUTINE_PREVIEW_PARAMETER 'N'
 #define NETWORK_LABEL_PARAMETER 'W'
 #define NETWORK_LOGS_LABEL_PARAMETER 'E'
 #define GET_IMEI_PARAMETER 'E'
@@ -118,6 +121,8 @@
 #define EG91_FOTA_PARAMETER 'P'
 #define IMPORT_USERS_HTTPS_PARAMETER 'I'
 #define ACTIVATE_ANTIPASSBACK_PARAMETER 'A'
+#define HEALTH_PARAMETER 'Z'
+#define COUNTRY_CODE_PARAMETER 'Y'
 
 
 #define RF_CHANGE_RELAY_PARAMETER 'R'
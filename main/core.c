@@ -10,6 +10,7 @@
 
 #include "core.h"
 #include "ble_spp_server_demo.h"
+#include "cmd_dispatch.h"
 #include "cmd_list.h"
 #include "erro_list.h"
 #include "esp_gatts_api.h"
@@ -21,10 +22,14 @@
 #include "rele.h"
 #include "routines.h"
 #include "sdCard.h"
+#include "log_query.h"
+#include "log_upload.h"
 // #include "rele.h"
 #include "UDP_Codes.h"
 #include "crc32.h"
+#include "esp_partition.h"
 #include "mbedtls/aes.h"
+#include "state_journal.h"
 #include "system.h"
 #include "wiegand.h"
 #include <string.h>
@@ -51,6 +56,8 @@ QueueHandle_t queue_EG91_SendSMS;
 
 NOW_TIME nowTime;
 
+RUNTIME_STATUS runtime_Status;
+
 char jsonFile[] asm("_binary_pt_json_start");
 
 cJSON *sms_Rsp_Json;
@@ -361,6 +368,119 @@ char *check_IF_haveCountryCode(char *phoneNumber, uint8_t label_addUser) {
   return phoneNumber;
 }
 
+static char default_Country_Code[8] = {};
+
+/* "ME S Y <indicativo>", aceita "351" ou "+351" */
+uint8_t set_Default_Country_Code(char *countryCode) {
+  if (countryCode[0] == '+') {
+    countryCode++;
+  }
+
+  if (strlen(countryCode) >= sizeof(default_Country_Code) ||
+      !parse_CountryPhoneNumber(countryCode)) {
+    return 0;
+  }
+
+  if (nvs_set_str(nvs_System_handle, NVS_KEY_DEFAULT_COUNTRY, countryCode) !=
+      ESP_OK) {
+    return 0;
+  }
+
+  runtime_Status.nvs_write_counter++;
+  sprintf(default_Country_Code, "%s", countryCode);
+
+  return 1;
+}
+
+char *get_Default_Country_Code() {
+  size_t required_size = sizeof(default_Country_Code);
+
+  if (default_Country_Code[0] == 0) {
+    if (nvs_get_str(nvs_System_handle, NVS_KEY_DEFAULT_COUNTRY,
+                    default_Country_Code, &required_size) != ESP_OK ||
+        !parse_CountryPhoneNumber(default_Country_Code)) {
+      sprintf(default_Country_Code, "%s", PHONE_DEFAULT_COUNTRY);
+    }
+  }
+
+  return default_Country_Code;
+}
+
+/* as regras estao no phone_e164.c, aqui so entra o indicativo guardado */
+uint8_t phone_Canonicalize_E164(char *phoneNumber, char *e164) {
+  return phone_Normalize_E164(phoneNumber, get_Default_Country_Code(), e164);
+}
+
+/* indice E.164 -> chave NVS do utilizador. A chave guardada continua a ser a
+   gerada pelo check_IF_haveCountryCode, o indice so evita as tentativas */
+uint8_t save_Phone_Index(char *phoneNumber, char *key, nvs_handle_t handle) {
+  char e164[PHONE_E164_SIZE] = {};
+  char value[40] = {};
+  char ns = 0;
+
+  if (!phone_Canonicalize_E164(phoneNumber, e164)) {
+    return 0;
+  }
+
+  if (handle == nvs_Users_handle) {
+    ns = 'U';
+  } else if (handle == nvs_Admin_handle) {
+    ns = 'A';
+  } else if (handle == nvs_Owner_handle) {
+    ns = 'O';
+  } else {
+    return 0;
+  }
+
+  sprintf(value, "%c;%s", ns, key);
+
+  /* as chaves NVS tem no maximo 15 caracteres, fica sem o '+' */
+  return save_STR_Data_In_Storage(e164 + 1, value, nvs_Phone_Index_handle) ==
+         ESP_OK;
+}
+
+uint8_t get_Phone_Index(char *phoneNumber, char *key, nvs_handle_t *handle) {
+  char e164[PHONE_E164_SIZE] = {};
+  char value[40] = {};
+  size_t required_size = sizeof(value);
+
+  if (!phone_Canonicalize_E164(phoneNumber, e164) ||
+      nvs_get_str(nvs_Phone_Index_handle, e164 + 1, value, &required_size) !=
+          ESP_OK ||
+      value[1] != ';') {
+    return 0;
+  }
+
+  switch (value[0]) {
+  case 'U':
+    *handle = nvs_Users_handle;
+    break;
+
+  case 'A':
+    *handle = nvs_Admin_handle;
+    break;
+
+  case 'O':
+    *handle = nvs_Owner_handle;
+    break;
+
+  default:
+    return 0;
+  }
+
+  sprintf(key, "%s", value + 2);
+
+  return 1;
+}
+
+void erase_Phone_Index(char *phoneNumber) {
+  char e164[PHONE_E164_SIZE] = {};
+
+  if (phone_Canonicalize_E164(phoneNumber, e164)) {
+    nvs_erase_key(nvs_Phone_Index_handle, e164 + 1);
+  }
+}
+
 int add_time(int old_time, int addition) {
   /* Calculate minutes */
   int total_minutes = (old_time % 100) + (addition % 100);
@@ -372,30 +492,396 @@ int add_time(int old_time, int addition) {
   return new_hours * 100 + new_minutes;
 }
 
-char *compress_UDP_Data(uint8_t code, char *payload) {
-  switch (code) {
-  case IMEI_ICCID_CODE:
-    /* code */
-    break;
+/* contexto de um comando ja validado (utilizador e password) */
+typedef struct {
+  uint8_t BLE_SMS_Indication;
+  uint8_t number;
+  char cmd;
+  char parameter;
+  char *phPassword;
+  char *input_Payload;
+  MyUser *user;
+  uint8_t gattsIF;
+  uint16_t connID;
+  uint16_t handle_table;
+  data_EG91_Send_SMS *data_SMS;
+  mqtt_information *mqttInfo;
+} cmd_dispatch_context;
+
+typedef char *(*cmd_dispatch_handler)(cmd_dispatch_context *ctx);
+
+_Static_assert(CMD_CHANNEL_BLE == (1 << BLE_INDICATION) &&
+                   CMD_CHANNEL_SMS == (1 << SMS_INDICATION) &&
+                   CMD_CHANNEL_UDP == (1 << UDP_INDICATION),
+               "CMD_CHANNEL_* (cmd_dispatch.h) fora de sincronia com core.h");
+
+static char *dispatch_Rele(cmd_dispatch_context *ctx) {
+  return parse_ReleData(ctx->BLE_SMS_Indication, ctx->number, ctx->cmd,
+                        ctx->parameter, ctx->phPassword, ctx->input_Payload,
+                        ctx->user, ctx->gattsIF, ctx->connID,
+                        ctx->handle_table, ctx->data_SMS, ctx->mqttInfo);
+}
 
-  default:
-    break;
+static char *dispatch_Input(cmd_dispatch_context *ctx) {
+  return readInputs(ctx->BLE_SMS_Indication, ctx->number, ctx->cmd,
+                    ctx->parameter, ctx->phPassword, ctx->input_Payload);
+}
+
+static char *dispatch_Input_Rules(cmd_dispatch_context *ctx) {
+  return parse_Input_Rules(ctx->BLE_SMS_Indication, ctx->cmd, ctx->parameter,
+                           ctx->input_Payload);
+}
+
+static char *dispatch_System(cmd_dispatch_context *ctx) {
+  return parse_SystemData(ctx->BLE_SMS_Indication, ctx->cmd, ctx->parameter,
+                          ctx->phPassword, ctx->input_Payload, ctx->user,
+                          ctx->data_SMS, ctx->mqttInfo);
+}
+
+static char *dispatch_LogFiles(cmd_dispatch_context *ctx) {
+  char *output_Data = NULL;
+
+  if (gpio_get_level(GPIO_INPUT_IO_CD_SDCARD)) {
+    return return_ERROR_Codes(&output_Data, "ERROR CARD NOT INSERTED");
+  }
+
+  if (atoi(ctx->input_Payload) > 0 && atoi(ctx->input_Payload) <= 12) {
+    /* a exportacao do mes inteiro continua a ser so por BLE */
+    if (ctx->BLE_SMS_Indication != BLE_INDICATION) {
+      return return_ERROR_Codes(&output_Data,
+                                return_Json_SMS_Data("ONLY_BLE_FUNCTION"));
+    }
+
+    send_LogFile(ctx->gattsIF, ctx->connID, ctx->handle_table,
+                 ctx->user->permition, ctx->input_Payload);
+    return return_ERROR_Codes(&output_Data,
+                              return_Json_SMS_Data("ONLY_BLE_FUNCTION"));
+  } else if (ctx->input_Payload[0] == 'G') {
+    asprintf(&output_Data, "ME G H %s", get_LogFiles_profiles());
+    return output_Data;
+  } else if (ctx->input_Payload[0] == 'Q') {
+    log_query_filter filter;
+
+    if (!log_Query_Parse(ctx->input_Payload, &filter)) {
+      return return_ERROR_Codes(&output_Data,
+                                return_Json_SMS_Data("ERROR_INPUT_DATA"));
+    }
+
+    if (!log_Query_Submit(ctx->BLE_SMS_Indication, ctx->gattsIF, ctx->connID,
+                          ctx->handle_table, &filter, 0)) {
+      return return_ERROR_Codes(&output_Data, "ME G Q BUSY");
+    }
+
+    return return_ERROR_Codes(&output_Data, "NTRSP");
+  } else if (ctx->input_Payload[0] == 'U') {
+    uint32_t from_epoch = 0;
+    uint32_t to_epoch = 0;
+    char status[LOG_UPLOAD_STATUS_MAX];
+
+    if (ctx->input_Payload[1] == 0) {
+      log_Upload_Status(status, sizeof(status));
+      asprintf(&output_Data, "%s", status);
+      return output_Data;
+    }
+
+    if (ctx->input_Payload[1] != '.') {
+      return return_ERROR_Codes(&output_Data,
+                                return_Json_SMS_Data("ERROR_INPUT_DATA"));
+    }
+
+    from_epoch = strtoul(ctx->input_Payload + 2, NULL, 10);
+
+    if (strchr(ctx->input_Payload + 2, '.') != NULL) {
+      to_epoch = strtoul(strchr(ctx->input_Payload + 2, '.') + 1, NULL, 10);
+    }
+
+    if (!log_Upload_Submit(from_epoch, to_epoch)) {
+      return return_ERROR_Codes(&output_Data, "ME G U BUSY");
+    }
+
+    asprintf(&output_Data, "ME G U OK");
+    return output_Data;
+  } else if (ctx->input_Payload[0] == 'C') {
+    log_Query_Cancel();
+    asprintf(&output_Data, "ME G C OK");
+    return output_Data;
+  }
+
+  return return_ERROR_Codes(&output_Data,
+                            return_Json_SMS_Data("ERROR_INPUT_DATA"));
+}
+
+static char *dispatch_Health(cmd_dispatch_context *ctx) {
+  char *output_Data = NULL;
+  char report[HEALTH_REPORT_MAX];
+
+  get_Health_Report(report, sizeof(report));
+  asprintf(&output_Data, "ME G Z %s", report);
+  return output_Data;
+}
+
+static char *dispatch_Wiegand(cmd_dispatch_context *ctx) {
+  return parseWiegand_data(ctx->BLE_SMS_Indication, ctx->gattsIF, ctx->connID,
+                           ctx->handle_table, ctx->cmd, ctx->parameter,
+                           ctx->phPassword, ctx->input_Payload, ctx->user,
+                           ctx->mqttInfo);
+}
+
+static char *dispatch_ReadAllUsers(cmd_dispatch_context *ctx) {
+  char *output_Data = NULL;
+
+  if (readAllUser_Label == 0) {
+    readAllUser_Label = 1;
+    asprintf(&output_Data, "%s",
+             MyUser_ReadAllUsers(ctx->gattsIF, ctx->connID, ctx->handle_table,
+                                 ctx->user->permition,
+                                 ctx->BLE_SMS_Indication));
+  } else {
+    asprintf(&output_Data, "%s", "READ ALL USERS NOT POSSIBLE");
+  }
+
+  return output_Data;
+}
+
+static char *dispatch_Users(cmd_dispatch_context *ctx) {
+  return parse_UserData(ctx->BLE_SMS_Indication, 0, ctx->cmd, ctx->parameter,
+                        ctx->phPassword, ctx->input_Payload, ctx->user,
+                        ctx->gattsIF, ctx->connID, ctx->handle_table,
+                        ctx->mqttInfo);
+}
+
+static char *dispatch_RF(cmd_dispatch_context *ctx) {
+  return parseRF_data(ctx->BLE_SMS_Indication, ctx->gattsIF, ctx->connID,
+                      ctx->handle_table, ctx->cmd, ctx->parameter,
+                      ctx->input_Payload, ctx->user, ctx->mqttInfo);
+}
+
+static char *dispatch_Routines(cmd_dispatch_context *ctx) {
+  return parse_RoutineData(ctx->BLE_SMS_Indication, ctx->gattsIF, ctx->connID,
+                           ctx->handle_table, ctx->cmd, ctx->parameter,
+                           ctx->input_Payload);
+}
+
+static const cmd_dispatch_handler cmd_dispatch_handlers[CMD_HANDLER_COUNT] = {
+    [CMD_HANDLER_INPUT] = dispatch_Input,
+    [CMD_HANDLER_INPUT_RULES] = dispatch_Input_Rules,
+    [CMD_HANDLER_SYSTEM] = dispatch_System,
+    [CMD_HANDLER_LOG_FILES] = dispatch_LogFiles,
+    [CMD_HANDLER_HEALTH] = dispatch_Health,
+    [CMD_HANDLER_RELE] = dispatch_Rele,
+    [CMD_HANDLER_RF] = dispatch_RF,
+    [CMD_HANDLER_ROUTINES] = dispatch_Routines,
+    [CMD_HANDLER_USERS] = dispatch_Users,
+    [CMD_HANDLER_READ_ALL_USERS] = dispatch_ReadAllUsers,
+    [CMD_HANDLER_WIEGAND] = dispatch_Wiegand,
+};
+
+static char *dispatch_Command_Table(cmd_dispatch_context *ctx,
+                                    const char *element) {
+  char *output_Data = NULL;
+  const cmd_dispatch_entry *entry =
+      cmd_Dispatch_Find(element, ctx->cmd, ctx->parameter);
+
+  if (entry == NULL) {
+    if (!cmd_Dispatch_Has_Element(element)) {
+      return return_ERROR_Codes(&output_Data,
+                                return_Json_SMS_Data("ERROR_ELEMENT"));
+    } else if (ctx->cmd != SET_CMD && ctx->cmd != GET_CMD &&
+               ctx->cmd != RESET_CMD) {
+      return return_ERROR_Codes(&output_Data,
+                                return_Json_SMS_Data("ERROR_CMD"));
+    }
+
+    return return_ERROR_Codes(&output_Data,
+                              return_Json_SMS_Data("ERROR_PARAMETER"));
+  }
+
+  if (!(entry->channels & (1 << ctx->BLE_SMS_Indication))) {
+    return return_ERROR_Codes(&output_Data,
+                              return_Json_SMS_Data("ONLY_BLE_FUNCTION"));
+  }
+
+  if (entry->min_permition != '0' &&
+      ctx->user->permition < entry->min_permition) {
+    return return_ERROR_Codes(&output_Data, ERROR_USER_NOT_PERMITION);
   }
 
-  return "ok";
+  if (!cmd_Dispatch_Check_Arg(entry, ctx->input_Payload)) {
+    return return_ERROR_Codes(&output_Data,
+                              return_Json_SMS_Data("ERROR_INPUT_DATA"));
+  }
+
+  ctx->number = entry->number;
+
+  return cmd_dispatch_handlers[entry->handler](ctx);
+}
+
+char *dispatch_InputCommand(uint8_t BLE_SMS_Indication, char *phNumber,
+                             char *phPassword, char *element, char cmd,
+                             char parameter, char *input_Payload,
+                             uint8_t gattsIF, uint16_t connID,
+                             uint16_t handle_table,
+                             data_EG91_Send_SMS *data_SMS,
+                             mqtt_information *mqttInfo) {
+  MyUser validateData_user;
+  char aabff[200];
+  char aux_phNumber[50];
+  char *output_Data = NULL;
+
+  memset(aabff, 0, sizeof(aabff));
+  memset(&validateData_user, 0, sizeof(validateData_user));
+
+  if (cmd == 'G' && BLE_SMS_Indication == SMS_INDICATION) {
+    data_SMS->labelRsp = 1;
+  }
+
+  //////printf("phNumber %s ok\n", phNumber);
+  //////printf("phPassword %s ok\n", phPassword);
+  //////printf("Input_Command %s ok\n", Input_Command);
+  //////printf("input_Payload %s ok\n", input_Payload);
+
+  memset(aux_phNumber, 0, sizeof(aux_phNumber));
+
+  // ////printf("aux_phNumber1111 %s ok\n", aux_phNumber);
+
+  sprintf(aux_phNumber, "%s", check_IF_haveCountryCode(phNumber, 0));
+
+  if (MyUser_Search_User(aux_phNumber, aabff) == ESP_OK) {
+
+    // ESP_LOGI("TAG", "xPortGetFreeHeapSize1313 : %d",
+    // xPortGetFreeHeapSize()); ESP_LOGI("TAG",
+    // "esp_get_minimum_free_heap_size  : %d",
+    // esp_get_minimum_free_heap_size()); ESP_LOGI("TAG",
+    // "heap_caps_get_largest_free_block: %d",
+    // heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT)); ESP_LOGI("TAG",
+    // "free heap memory : %d", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    //  memset(&validateData_user,0,sizeof(validateData_user));
+    //  ////printf("\n\n SD CARD BI STATE 777- %s  /
+    //  %s\n\n",validateData_user.firstName,validateData_user.phone);
+    parse_ValidateData_User(aabff, &validateData_user);
+
+    if (get_Feedback_SMS() == 1 && validateData_user.permition != '2' &&
+        BLE_SMS_Indication == SMS_INDICATION) {
+      data_SMS->labelRsp = 0;
+    }
+
+    // ////printf("\nparse_ValidateData_User\n");
+    if (!strcmp(validateData_user.key, phPassword)) {
+      // ////printf("\nstrcmp\n");
+      cmd_dispatch_context ctx = {
+          .BLE_SMS_Indication = BLE_SMS_Indication,
+          .cmd = cmd,
+          .parameter = parameter,
+          .phPassword = phPassword,
+          .input_Payload = input_Payload,
+          .user = &validateData_user,
+          .gattsIF = gattsIF,
+          .connID = connID,
+          .handle_table = handle_table,
+          .data_SMS = data_SMS,
+          .mqttInfo = mqttInfo,
+      };
+
+      return dispatch_Command_Table(&ctx, element);
+    } else {
+
+      // ////printf("\n\n\n wrong password\n\n\n");
+      if ((!strcmp(element, RELE1_ELEMENT) ||
+           !strcmp(element, RELE2_ELEMENT)) &&
+          (cmd == 'S' || cmd == 'R') && parameter == 'R') {
+        if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD) ||
+            network_Activate_Flag == 1) {
+
+          sdCard_Logs_struct logs_struct;
+          memset(&logs_struct, 0, sizeof(logs_struct));
+
+          if (BLE_SMS_Indication == BLE_INDICATION) {
+            sprintf(logs_struct.type, "%s", "BLE");
+          } else if (BLE_SMS_Indication == SMS_INDICATION) {
+            sprintf(logs_struct.type, "%s", "SMS");
+          }
+
+          sprintf(logs_struct.name, "%s", validateData_user.firstName);
+          sprintf(logs_struct.phone, "%s", phNumber);
+          sprintf(logs_struct.relay, "%s", element);
+          sprintf(logs_struct.relay_state, "%s",
+                  return_Json_SMS_Data("NOT_CHANGE"));
+          sprintf(logs_struct.date, "%s",
+                  replace_Char_in_String(nowTime.strTime, ',', ';'));
+
+          sprintf(logs_struct.error, "%s",
+                  return_Json_SMS_Data("ERROR_LOGS_PASSWORD_WRONG"));
+          sdCard_Write_LOGS(&logs_struct);
+        }
+      }
+
+      if (get_Feedback_SMS() == 1 && validateData_user.permition != '2' &&
+          BLE_SMS_Indication == SMS_INDICATION) {
+        data_SMS->labelRsp = 0;
+      }
+
+      // ////printf("\n\n\n wrong password 222\n\n\n");
+
+      // return_ERROR_Codes(&output_Data,
+      // return_Json_SMS_Data("ERROR_PASSWORD_WRONG"));
+
+      // ////printf("\nERROR_PASSWORD_WRONG - %s\n", output_Data);
+      //   return return_Json_SMS_Data("ERROR_PASSWORD_WRONG");
+      return return_ERROR_Codes(&output_Data,
+                                return_Json_SMS_Data("ERROR_PASSWORD_WRONG"));
+    }
+  } else {
+    if (get_Feedback_SMS() == 1 && BLE_SMS_Indication == SMS_INDICATION) {
+      data_SMS->labelRsp = 0;
+    }
+
+    if ((!strcmp(element, RELE1_ELEMENT) ||
+         !strcmp(element, RELE2_ELEMENT)) &&
+        (cmd == 'S' || cmd == 'R') && parameter == 'R') {
+      if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD) ||
+          network_Activate_Flag == 1) {
+        sdCard_Logs_struct logs_struct;
+        memset(&logs_struct, 0, sizeof(logs_struct));
+
+        if (BLE_SMS_Indication == BLE_INDICATION) {
+          sprintf(logs_struct.type, "%s", "BLE");
+        } else if (BLE_SMS_Indication == SMS_INDICATION) {
+          sprintf(logs_struct.type, "%s", "SMS");
+        }
+
+        sprintf(logs_struct.name, "%s", return_Json_SMS_Data("NO_NAME"));
+        sprintf(logs_struct.phone, "%s", phNumber);
+        sprintf(logs_struct.relay, "%s", element);
+        sprintf(logs_struct.relay_state, "%s",
+                return_Json_SMS_Data("NOT_CHANGE"));
+        sprintf(logs_struct.date, "%s",
+                replace_Char_in_String(nowTime.strTime, ',', ';'));
+
+        sprintf(logs_struct.error, "%s",
+                return_Json_SMS_Data("ERROR_LOGS_USER_NOT_FOUND"));
+        sdCard_Write_LOGS(&logs_struct);
+      }
+    }
+
+    // ////printf("\n USER NOT FOUND ENTER 4");
+
+    // ////printf("\n USER NOT FOUND ENTER 5");
+    return return_ERROR_Codes(&output_Data,
+                              return_Json_SMS_Data("ERROR_USER_NOT_FOUND"));
+  }
+
+  return return_ERROR_Codes(&output_Data,
+                            return_Json_SMS_Data("ERROR_INPUT_DATA"));
 }
 
 char *parseInputData(uint8_t *int_inputData, uint8_t BLE_SMS_Indication,
                      uint8_t gattsIF, uint16_t connID, uint16_t handle_table,
                      data_EG91_Send_SMS *data_SMS, mqtt_information *mqttInfo) {
   // heap_trace_start(HEAP_TRACE_LEAKS);
-  MyUser validateData_user;
-  char aabff[200];
   char phPassword[7];
   char Input_Command[7];
   char input_Payload[512];
   char phNumber[18];
-  char aux_phNumber[50];
   char element[3];
   char cmd;
   char parameter;
@@ -410,15 +896,12 @@ char *parseInputData(uint8_t *int_inputData, uint8_t BLE_SMS_Indication,
   asprintf(&inputData, "%s", int_inputData);
   //////printf("\n\n rrrrrad  4n\n\n");
   memset(phPassword, 0, sizeof(phPassword));
-  memset(aabff, 0, sizeof(aabff));
   //////printf("\n\n rrrrrad  5n\n\n");
   memset(Input_Command, 0, sizeof(Input_Command));
   memset(input_Payload, 0, sizeof(input_Payload));
   //////printf("\n\n rrrrrad  6n\n\n");
   memset(phNumber, 0, sizeof(phNumber));
   memset(element, 0, sizeof(element));
-  //////printf("\n\n rrrrrad  7n\n\n");
-  memset(&validateData_user, 0, sizeof(validateData_user));
 
   char search[50];
 
@@ -557,337 +1040,12 @@ char *parseInputData(uint8_t *int_inputData, uint8_t BLE_SMS_Indication,
                                 return_Json_SMS_Data("ERROR_CMD"));
     }
 
-    if (cmd == 'G' && BLE_SMS_Indication == SMS_INDICATION) {
-      data_SMS->labelRsp = 1;
-    }
-
-    //////printf("phNumber %s ok\n", phNumber);
-    //////printf("phPassword %s ok\n", phPassword);
-    //////printf("Input_Command %s ok\n", Input_Command);
-    //////printf("input_Payload %s ok\n", input_Payload);
-
-    int line = 0;
-    memset(aux_phNumber, 0, sizeof(aux_phNumber));
-
-    // ////printf("aux_phNumber1111 %s ok\n", aux_phNumber);
-
-    sprintf(aux_phNumber, "%s", check_IF_haveCountryCode(phNumber, 0));
-
-    if (MyUser_Search_User(aux_phNumber, aabff) == ESP_OK) {
-
-      // ESP_LOGI("TAG", "xPortGetFreeHeapSize1313 : %d",
-      // xPortGetFreeHeapSize()); ESP_LOGI("TAG",
-      // "esp_get_minimum_free_heap_size  : %d",
-      // esp_get_minimum_free_heap_size()); ESP_LOGI("TAG",
-      // "heap_caps_get_largest_free_block: %d",
-      // heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT)); ESP_LOGI("TAG",
-      // "free heap memory : %d", heap_caps_get_free_size(MALLOC_CAP_8BIT));
-      //  memset(&validateData_user,0,sizeof(validateData_user));
-      //  ////printf("\n\n SD CARD BI STATE 777- %s  /
-      //  %s\n\n",validateData_user.firstName,validateData_user.phone);
-      parse_ValidateData_User(aabff, &validateData_user);
-
-      if (get_Feedback_SMS() == 1 && validateData_user.permition != '2' &&
-          BLE_SMS_Indication == SMS_INDICATION) {
-        data_SMS->labelRsp = 0;
-      }
-
-      // ////printf("\nparse_ValidateData_User\n");
-      if (!strcmp(validateData_user.key, phPassword)) {
-        // ////printf("\nstrcmp\n");
-        if (!strcmp(element, RELE1_ELEMENT)) {
-          // ////printf("\nstrcmp11\n");
-          //  heap_trace_start(HEAP_TRACE_ALL);
-
-          output_Data = parse_ReleData(
-              BLE_SMS_Indication, RELE1_NUMBER, Input_Command[3],
-              Input_Command[5], phPassword, input_Payload, &validateData_user,
-              gattsIF, connID, handle_table, data_SMS, mqttInfo);
-
-          free(inputData);
-
-          return output_Data;
-        } else if (!strcmp(element, RELE2_ELEMENT)) {
-          ////printf("\nstrcmp12\n");
-          output_Data = parse_ReleData(
-              BLE_SMS_Indication, RELE2_NUMBER, Input_Command[3],
-              Input_Command[5], phPassword, input_Payload, &validateData_user,
-              gattsIF, connID, handle_table, data_SMS, mqttInfo);
-          free(inputData);
-
-          return output_Data;
-        }
-        /* else if (label_Routine2_ON == 0)
-        {
-            sprintf(output_Data, "%s", parse_ReleData(BLE_SMS_Indication,
-        RELE2_NUMBER, Input_Command[3], Input_Command[5], phPassword,
-        input_Payload, &validateData_user, gattsIF, connID, handle_table,
-        data_SMS)); return output_Data;
-        } */
-
-        else if (!strcmp(element, INPUT1_ELEMENT)) {
-
-          output_Data =
-              readInputs(BLE_SMS_Indication, INPUT1_NUMBER, Input_Command[3],
-                         Input_Command[5], phPassword, input_Payload);
-          free(inputData);
-
-          return output_Data;
-        } else if (!strcmp(element, INPUT2_ELEMENT)) {
-          output_Data =
-              readInputs(BLE_SMS_Indication, INPUT2_NUMBER, Input_Command[3],
-                         Input_Command[5], phPassword, input_Payload);
-          free(inputData);
-
-          return output_Data;
-        } else if (!strcmp(element, ADMIN_ELEMENT)) {
-
-          if (Input_Command[3] == 'G' && Input_Command[5] == 'H') {
-
-            if (BLE_SMS_Indication == BLE_INDICATION) {
-              if (validateData_user.permition == '2') {
-
-                if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD)) {
-
-                  if (atoi(input_Payload) > 0 && atoi(input_Payload) <= 12) {
-                    send_LogFile(gattsIF, connID, handle_table,
-                                 validateData_user.permition, input_Payload);
-                    free(inputData);
-                    return return_ERROR_Codes(
-                        &output_Data,
-                        return_Json_SMS_Data("ONLY_BLE_FUNCTION"));
-                  } else if (input_Payload[0] == 'G') {
-                    // ////printf("\nget_LogFiles_profiles\n");
-                    asprintf(&output_Data, "ME G H %s",
-                             get_LogFiles_profiles());
-                    free(inputData);
-                    return output_Data;
-                  }
-                } else {
-                  free(inputData);
-                  return return_ERROR_Codes(&output_Data,
-                                            "ERROR CARD NOT INSERTED");
-                }
-              } else {
-                free(inputData);
-                return return_ERROR_Codes(&output_Data,
-                                          ERROR_USER_NOT_PERMITION);
-              }
-            } else {
-              free(inputData);
-              return return_ERROR_Codes(
-                  &output_Data, return_Json_SMS_Data("ONLY_BLE_FUNCTION"));
-            }
-          } else {
-            /* memset(&output_Data, 0, sizeof(output_Data)); */
-            output_Data =
-                parse_SystemData(BLE_SMS_Indication, Input_Command[3],
-                                 Input_Command[5], phPassword, input_Payload,
-                                 &validateData_user, data_SMS, mqttInfo);
-            free(inputData);
-            return output_Data;
-          }
-        } else if (!strcmp(element, WIEGAND_ELEMENT)) {
-          /*  if (BLE_SMS_Indication == SMS_INDICATION ||BLE_SMS_Indication ==
-           UDP_INDICATION || BLE_SMS_Indication == BLE_INDICATION)
-           { */
-          output_Data = parseWiegand_data(
-              BLE_SMS_Indication, gattsIF, connID, handle_table,
-              Input_Command[3], Input_Command[5], phPassword, input_Payload,
-              &validateData_user, mqttInfo);
-          free(inputData);
-          return output_Data;
-          /*  }
-           else
-           {
-               free(inputData);
-               return return_ERROR_Codes(&output_Data, "ONLY WEB FUNCTION");
-           } */
-        } else if (!strcmp(element, USER_ELEMENT)) {
-          // ////printf("\n\n ENTER USER PARSING DATA\n\n");
-          if (Input_Command[3] == 'G' && Input_Command[5] == '*') {
-            if (BLE_SMS_Indication == BLE_INDICATION ||
-                BLE_SMS_Indication == UDP_INDICATION) {
-              if (validateData_user.permition == '1' ||
-                  validateData_user.permition == '2') {
-
-                // MyUser_ReadAllUsers(gattsIF, connID, handle_table,
-                // validateData_user.permition);
-                free(inputData);
-
-                if (readAllUser_Label == 0) {
-                  readAllUser_Label = 1;
-                  asprintf(&output_Data, "%s",
-                           MyUser_ReadAllUsers(gattsIF, connID, handle_table,
-                                               validateData_user.permition,
-                                               BLE_SMS_Indication));
-                } else {
-                  asprintf(&output_Data, "%s", "READ ALL USERS NOT POSSIBLE");
-                }
-                // return_ERROR_Codes(&output_Data, MyUser_ReadAllUsers(gattsIF,
-                // connID, handle_table, validateData_user.permition));
-                return output_Data;
-              } else {
-                free(inputData);
-                return return_ERROR_Codes(&output_Data,
-                                          ERROR_USER_NOT_PERMITION);
-              }
-            } else {
-              free(inputData);
-              asprintf(&output_Data, "%s",
-                       return_Json_SMS_Data("ONLY_BLE_FUNCTION"));
-              // ////printf("outputData rsp - %s", output_Data);
-              return output_Data;
-            }
-          } else {
-            //////printf("\n enter users comm\n");
-            /* memset(&output_Data, 0, sizeof(output_Data)); */
-            output_Data = parse_UserData(
-                BLE_SMS_Indication, line, Input_Command[3], Input_Command[5],
-                phPassword, input_Payload, &validateData_user, gattsIF, connID,
-                handle_table, mqttInfo);
-
-            // ////printf("\n enter users comm 12\n");
-            free(inputData);
-            // ////printf("\n enter users comm 13\n");
-            return output_Data;
-          }
-        } else if (!strcmp(element, RF_ELEMENT)) {
-
-          if (BLE_SMS_Indication == BLE_INDICATION ||
-              BLE_SMS_Indication == UDP_INDICATION) {
-            output_Data =
-                parseRF_data(BLE_SMS_Indication, gattsIF, connID, handle_table,
-                             Input_Command[3], Input_Command[5], input_Payload,
-                             &validateData_user, mqttInfo);
-            free(inputData);
-            return output_Data;
-          } else {
-            free(inputData);
-            return return_ERROR_Codes(
-                &output_Data, return_Json_SMS_Data("ONLY_BLE_FUNCTION"));
-          }
-
-        } else if (!strcmp(element, ROUTINE_ELEMENT)) {
-
-          // ////printf("\n enter routines 1\n");
-          if (BLE_SMS_Indication == BLE_INDICATION ||
-              BLE_SMS_Indication == UDP_INDICATION) {
-            if (validateData_user.permition == '2') {
-
-              output_Data = parse_RoutineData(
-                  BLE_SMS_Indication, gattsIF, connID, handle_table,
-                  Input_Command[3], Input_Command[5], input_Payload);
-              // ////printf("\n erase routines 13\n");
-              free(inputData);
-              return output_Data;
-            } else {
-              free(inputData);
-              return return_ERROR_Codes(&output_Data, ERROR_USER_NOT_PERMITION);
-            }
-          } else {
-            free(inputData);
-            return return_ERROR_Codes(
-                &output_Data, return_Json_SMS_Data("ONLY_BLE_FUNCTION"));
-          }
-        } else {
-          free(inputData);
-          return return_ERROR_Codes(&output_Data,
-                                    return_Json_SMS_Data("ERROR_ELEMENT"));
-        }
-      } else {
-
-        // ////printf("\n\n\n wrong password\n\n\n");
-        if ((!strcmp(element, RELE1_ELEMENT) ||
-             !strcmp(element, RELE2_ELEMENT)) &&
-            (cmd == 'S' || cmd == 'R') && parameter == 'R') {
-          if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD) ||
-              network_Activate_Flag == 1) {
-
-            sdCard_Logs_struct logs_struct;
-            memset(&logs_struct, 0, sizeof(logs_struct));
-
-            if (BLE_SMS_Indication == BLE_INDICATION) {
-              sprintf(logs_struct.type, "%s", "BLE");
-            } else if (BLE_SMS_Indication == SMS_INDICATION) {
-              sprintf(logs_struct.type, "%s", "SMS");
-            }
-
-            sprintf(logs_struct.name, "%s", validateData_user.firstName);
-            sprintf(logs_struct.phone, "%s", phNumber);
-            sprintf(logs_struct.relay, "%s", element);
-            sprintf(logs_struct.relay_state, "%s",
-                    return_Json_SMS_Data("NOT_CHANGE"));
-            sprintf(logs_struct.date, "%s",
-                    replace_Char_in_String(nowTime.strTime, ',', ';'));
-
-            sprintf(logs_struct.error, "%s",
-                    return_Json_SMS_Data("ERROR_LOGS_PASSWORD_WRONG"));
-            sdCard_Write_LOGS(&logs_struct);
-          }
-        }
-
-        if (get_Feedback_SMS() == 1 && validateData_user.permition != '2' &&
-            BLE_SMS_Indication == SMS_INDICATION) {
-          data_SMS->labelRsp = 0;
-        }
-
-        // ////printf("\n\n\n wrong password 222\n\n\n");
-        free(inputData);
-
-        // return_ERROR_Codes(&output_Data,
-        // return_Json_SMS_Data("ERROR_PASSWORD_WRONG"));
-
-        // ////printf("\nERROR_PASSWORD_WRONG - %s\n", output_Data);
-        //   return return_Json_SMS_Data("ERROR_PASSWORD_WRONG");
-        return return_ERROR_Codes(&output_Data,
-                                  return_Json_SMS_Data("ERROR_PASSWORD_WRONG"));
-      }
-    } else {
-      if (get_Feedback_SMS() == 1 && BLE_SMS_Indication == SMS_INDICATION) {
-        data_SMS->labelRsp = 0;
-      }
-
-      if ((!strcmp(element, RELE1_ELEMENT) ||
-           !strcmp(element, RELE2_ELEMENT)) &&
-          (Input_Command[3] == 'S' || Input_Command[3] == 'R') &&
-          Input_Command[5] == 'R') {
-        if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD) ||
-            network_Activate_Flag == 1) {
-          sdCard_Logs_struct logs_struct;
-          memset(&logs_struct, 0, sizeof(logs_struct));
-
-          if (BLE_SMS_Indication == BLE_INDICATION) {
-            sprintf(logs_struct.type, "%s", "BLE");
-          } else if (BLE_SMS_Indication == SMS_INDICATION) {
-            sprintf(logs_struct.type, "%s", "SMS");
-          }
-
-          sprintf(logs_struct.name, "%s", return_Json_SMS_Data("NO_NAME"));
-          sprintf(logs_struct.phone, "%s", phNumber);
-          sprintf(logs_struct.relay, "%s", element);
-          sprintf(logs_struct.relay_state, "%s",
-                  return_Json_SMS_Data("NOT_CHANGE"));
-          sprintf(logs_struct.date, "%s",
-                  replace_Char_in_String(nowTime.strTime, ',', ';'));
-
-          sprintf(logs_struct.error, "%s",
-                  return_Json_SMS_Data("ERROR_LOGS_USER_NOT_FOUND"));
-          sdCard_Write_LOGS(&logs_struct);
-        }
-      }
-
-      // ////printf("\n USER NOT FOUND ENTER 4");
-
-      free(inputData);
-      // ////printf("\n USER NOT FOUND ENTER 5");
-      return return_ERROR_Codes(&output_Data,
-                                return_Json_SMS_Data("ERROR_USER_NOT_FOUND"));
-    }
-
+    output_Data = dispatch_InputCommand(
+        BLE_SMS_Indication, phNumber, phPassword, element, cmd, parameter,
+        input_Payload, gattsIF, connID, handle_table, data_SMS, mqttInfo);
     free(inputData);
-    return return_ERROR_Codes(&output_Data,
-                              return_Json_SMS_Data("ERROR_INPUT_DATA"));
+
+    return output_Data;
   }
   // ////printf("\n\n count search 464 = %d\n\n", count);
 
@@ -1050,6 +1208,9 @@ void init_Storage() {
                               err =
       nvs_open_from_partition("keys", NVS_WIEGAND_ANTIPASSBACK_NAMESPACE,
                               NVS_READWRITE, &nvs_wiegand_antipassback_OWNER_handle);
+
+  err = nvs_open_from_partition("keys", NVS_PHONE_INDEX_NAMESPACE,
+                                NVS_READWRITE, &nvs_Phone_Index_handle);
 }
 
 uint8_t save_STR_Data_In_Storage(char *key, char *payload,
@@ -1065,67 +1226,262 @@ uint8_t save_STR_Data_In_Storage(char *key, char *payload,
          strlen(payload));
   // int x =
   //////printf("\n\n str save x %d\n\n", x);
+  runtime_Status.nvs_write_counter++;
   return nvs_set_str(my_handle, key, (const char *)payload);
 }
 
 uint8_t save_INT8_Data_In_Storage(char *key, uint8_t value,
                                   nvs_handle_t my_handle) {
   // ////printf("\n\n int save value %d\n\n", value);
+  runtime_Status.nvs_write_counter++;
   return nvs_set_u8(my_handle, key, value);
 }
 
-int8_t get_Data_Users_From_Storage(char *key, char *output_Data) {
-  esp_err_t err = 0;
-  size_t required_size;
-  char aux_Get_Data_User_str[200];
-  memset(aux_Get_Data_User_str, 0, sizeof(aux_Get_Data_User_str));
+void set_Runtime_QMTSTAT(uint8_t value) { runtime_Status.qmtstat = value; }
+
+uint8_t get_Runtime_QMTSTAT() { return runtime_Status.qmtstat; }
+
+uint32_t get_NVS_Write_Counter() { return runtime_Status.nvs_write_counter; }
+
+/* diario do estado dos reles e das rotinas (state_journal.h); sem a regiao
+   na tabela de particoes (equipamentos atualizados por OTA) as chaves
+   continuam a ir para NVS */
+static state_journal state_Journal;
+static uint8_t state_Journal_Ready = 0;
+static SemaphoreHandle_t state_Journal_Mutex = NULL;
+static StaticSemaphore_t state_Journal_Mutex_Buffer;
+static TickType_t state_Journal_Hour_Start;
+static uint32_t state_Journal_Hour_Writes;
+static uint32_t state_Journal_Last_Hour_Writes;
+static uint8_t state_Journal_Hour_Done = 0;
+
+/* chave NVS usada antes do diario, na mesma ordem que STATE_KEY_* */
+static const struct {
+  char *key;
+  uint8_t wide;
+} state_Journal_NVS_Keys[STATE_KEY_COUNT] = {
+    {NVS_KEY_RELAY1_LAST_VALUE, 0}, {NVS_KEY_RELAY2_LAST_VALUE, 0},
+    {NVS_KEY_ROUTINE1_LABEL, 0},    {NVS_KEY_ROUTINE2_LABEL, 0},
+    {NVS_KEY_ROUTINE1_TIME_ON, 1},  {NVS_KEY_ROUTINE2_TIME_ON, 1},
+};
 
-  if (nvs_Users_handle == NULL) {
-    /* code */
+static int state_Journal_Read(void *ctx, uint32_t offset, void *data,
+                              uint32_t size) {
+  return esp_partition_read((const esp_partition_t *)ctx, offset, data, size);
+}
+
+static int state_Journal_Write(void *ctx, uint32_t offset, const void *data,
+                               uint32_t size) {
+  return esp_partition_write((const esp_partition_t *)ctx, offset, data, size);
+}
+
+static int state_Journal_Erase(void *ctx, uint32_t offset, uint32_t size) {
+  return esp_partition_erase_range((const esp_partition_t *)ctx, offset, size);
+}
+
+static uint8_t get_State_From_NVS(uint8_t key, uint64_t *value) {
+  uint8_t value8 = 0;
+
+  if (state_Journal_NVS_Keys[key].wide) {
+    return nvs_get_u64(nvs_System_handle, state_Journal_NVS_Keys[key].key,
+                       value) == ESP_OK;
   }
 
-  if (nvs_get_str(nvs_Users_handle, key, NULL, &required_size) == ESP_OK) {
+  value8 = get_INT8_Data_From_Storage(state_Journal_NVS_Keys[key].key,
+                                      nvs_System_handle);
+  *value = value8;
+  return value8 != 255;
+}
 
-    if (nvs_get_str(nvs_Users_handle, key, aux_Get_Data_User_str,
-                    &required_size) == ESP_OK) {
-      //
-      sprintf(output_Data, "%s", aux_Get_Data_User_str);
-      return ESP_OK;
+static void count_State_Journal_Hour() {
+  if (xTaskGetTickCount() - state_Journal_Hour_Start >=
+      pdMS_TO_TICKS(3600 * 1000)) {
+    state_Journal_Last_Hour_Writes =
+        state_Journal.writes - state_Journal_Hour_Writes;
+    state_Journal_Hour_Writes = state_Journal.writes;
+    state_Journal_Hour_Start = xTaskGetTickCount();
+    state_Journal_Hour_Done = 1;
+  }
+}
+
+void init_State_Journal() {
+  const esp_partition_t *partition = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+      STATE_JOURNAL_PARTITION);
+  state_journal_flash flash = {state_Journal_Read, state_Journal_Write,
+                               state_Journal_Erase, (void *)partition, 0};
+  uint64_t value = 0;
+  int result = 0;
+
+  state_Journal_Mutex =
+      xSemaphoreCreateMutexStatic(&state_Journal_Mutex_Buffer);
+
+  if (partition == NULL) {
+    ESP_LOGW("journal", "no %s partition, relay state kept in NVS",
+             STATE_JOURNAL_PARTITION);
+    return;
+  }
+
+  flash.size = partition->size;
+  result = state_Journal_Open(&state_Journal, &flash);
+
+  if (result < 0) {
+    ESP_LOGE("journal", "open failed, relay state kept in NVS");
+    return;
+  }
+
+  /* primeiro arranque com o diario: traz os valores que estavam em NVS */
+  if (result == 1) {
+    for (uint8_t key = 0; key < STATE_KEY_COUNT; key++) {
+      if (get_State_From_NVS(key, &value)) {
+        state_Journal_Set(&state_Journal, key, value);
+      }
     }
   }
 
-  memset(aux_Get_Data_User_str, 0, sizeof(aux_Get_Data_User_str));
-  required_size = 0;
+  state_Journal_Hour_Start = xTaskGetTickCount();
+  state_Journal_Hour_Writes = state_Journal.writes;
+  state_Journal_Ready = 1;
+}
 
-  if (nvs_get_str(nvs_Admin_handle, key, NULL, &required_size) == ESP_OK) {
-    // ////printf("\nrequire size %d\n", required_size);
-    // ////printf("\nGET ADMIN NAMESPACE\n");
-    //   txtEX = (char *)malloc(required_size * sizeof(char));
-    if (nvs_get_str(nvs_Admin_handle, key, aux_Get_Data_User_str,
-                    &required_size) == ESP_OK) {
-      // ////printf("\naux get str %s\n", aux_Get_Data_User_str);
-      sprintf(output_Data, "%s", aux_Get_Data_User_str);
-      return ESP_OK;
+void save_State_In_Journal(uint8_t key, uint64_t value) {
+  if (key >= STATE_KEY_COUNT) {
+    return;
+  }
+
+  xSemaphoreTake(state_Journal_Mutex, portMAX_DELAY);
+
+  if (state_Journal_Ready) {
+    if (state_Journal_Set(&state_Journal, key, value) != 0) {
+      ESP_LOGE("journal", "write failed, key %d", key);
     }
+    count_State_Journal_Hour();
+  } else if (state_Journal_NVS_Keys[key].wide) {
+    nvs_set_u64(nvs_System_handle, state_Journal_NVS_Keys[key].key, value);
+    runtime_Status.nvs_write_counter++;
+  } else {
+    save_INT8_Data_In_Storage(state_Journal_NVS_Keys[key].key, (uint8_t)value,
+                              nvs_System_handle);
   }
 
-  memset(aux_Get_Data_User_str, 0, sizeof(aux_Get_Data_User_str));
-  required_size = 0;
+  xSemaphoreGive(state_Journal_Mutex);
+}
 
-  if (nvs_get_str(nvs_Owner_handle, key, NULL, &required_size) == ESP_OK) {
-    // ////printf("\nrequire size %d\n", required_size);
-    // ////printf("\nGET OWNER NAMESPACE\n");
-    if (nvs_get_str(nvs_Owner_handle, key, aux_Get_Data_User_str,
-                    &required_size) == ESP_OK) {
-      // ////printf("\naux get str %s\n", aux_Get_Data_User_str);
+uint8_t get_State_From_Journal(uint8_t key, uint64_t *value) {
+  uint8_t found = 0;
+
+  if (key >= STATE_KEY_COUNT) {
+    return 0;
+  }
+
+  xSemaphoreTake(state_Journal_Mutex, portMAX_DELAY);
+
+  if (state_Journal_Ready) {
+    found = state_Journal_Get(&state_Journal, key, value);
+  } else {
+    found = get_State_From_NVS(key, value);
+  }
+
+  xSemaphoreGive(state_Journal_Mutex);
+  return found;
+}
+
+/* reposicao de fabrica; sem diario as chaves estao em NVS e saem com o
+   nvs_erase_all */
+void clear_State_Journal() {
+  xSemaphoreTake(state_Journal_Mutex, portMAX_DELAY);
+
+  if (state_Journal_Ready && state_Journal_Clear(&state_Journal) != 0) {
+    ESP_LOGE("journal", "clear failed");
+  }
+
+  xSemaphoreGive(state_Journal_Mutex);
+}
+
+/* 255 quando a chave nao existe, como get_INT8_Data_From_Storage */
+uint8_t get_INT8_State_From_Journal(uint8_t key) {
+  uint64_t value = 0;
+
+  return get_State_From_Journal(key, &value) ? (uint8_t)value : 255;
+}
+
+/* escritas na flash na ultima hora completa, na primeira hora as que ja
+   houve */
+uint32_t get_State_Journal_Writes_Per_Hour() {
+  uint32_t writes = 0;
+
+  xSemaphoreTake(state_Journal_Mutex, portMAX_DELAY);
+  count_State_Journal_Hour();
+  writes = state_Journal_Hour_Done
+               ? state_Journal_Last_Hour_Writes
+               : state_Journal.writes - state_Journal_Hour_Writes;
+  xSemaphoreGive(state_Journal_Mutex);
+
+  return writes;
+}
+
+/* grava o estado de execucao em NVS apenas se mudou desde o ultimo snapshot;
+   chamado periodicamente e antes de um restart intencional */
+void snapshot_Runtime_Status() {
+  if (runtime_Status.qmtstat != runtime_Status.qmtstat_snapshot) {
+    save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, runtime_Status.qmtstat,
+                              nvs_System_handle);
+    runtime_Status.qmtstat_snapshot = runtime_Status.qmtstat;
+  }
+
+  if (runtime_Status.last_call_dirty) {
+    save_STR_Data_In_Storage(NVS_LAST_CALL, runtime_Status.last_call,
+                             nvs_System_handle);
+    runtime_Status.last_call_dirty = 0;
+  }
+}
+
+/* ultima chamada recebida, gravada em NVS apenas no proximo snapshot */
+void set_Runtime_Last_Call(char *phNumber) {
+  if (strncmp(runtime_Status.last_call, phNumber,
+              sizeof(runtime_Status.last_call) - 1)) {
+    snprintf(runtime_Status.last_call, sizeof(runtime_Status.last_call), "%s",
+             phNumber);
+    runtime_Status.last_call_dirty = 1;
+  }
+}
+
+void tick_Runtime_Status_Snapshot() {
+  if (++runtime_Status.snapshot_tick >= RUNTIME_STATUS_SNAPSHOT_TICKS) {
+    runtime_Status.snapshot_tick = 0;
+    snapshot_Runtime_Status();
+  }
+}
+
+int8_t get_Data_Users_From_Storage(char *key, char *output_Data) {
+  return get_Data_Users_Handle_From_Storage(key, output_Data, NULL);
+}
+
+/* procura o utilizador nos namespaces users, admin e owner (por esta ordem) e
+   devolve em found_handle o namespace onde foi encontrado */
+int8_t get_Data_Users_Handle_From_Storage(char *key, char *output_Data,
+                                          nvs_handle_t *found_handle) {
+  nvs_handle_t handles[3] = {nvs_Users_handle, nvs_Admin_handle,
+                             nvs_Owner_handle};
+  size_t required_size;
+  char aux_Get_Data_User_str[200];
+
+  for (uint8_t i = 0; i < 3; i++) {
+    memset(aux_Get_Data_User_str, 0, sizeof(aux_Get_Data_User_str));
+    required_size = sizeof(aux_Get_Data_User_str);
+
+    if (nvs_get_str(handles[i], key, aux_Get_Data_User_str, &required_size) ==
+        ESP_OK) {
       sprintf(output_Data, "%s", aux_Get_Data_User_str);
+
+      if (found_handle != NULL) {
+        *found_handle = handles[i];
+      }
+
       return ESP_OK;
     }
   }
 
-  // err = nvs_get_str(&my_handle, "ex", &txtEX, strlen("motorline"));
-  // ////printf("\nerror 2 %d\n", err);
-  // ////printf("\nex nvs %s\n", output_Data);
   return ESP_FAIL;
 }
 
@@ -1203,6 +1559,11 @@ uint8_t get_Data_STR_LastCALL_From_Storage(char *output_Data) {
   // ////printf("\nENTER get_Data_STR_LastCALL_From_Storage\n");
   // ////printf("\nerror 1 %d\n", err);
 
+  if (runtime_Status.last_call[0] != 0) {
+    sprintf(output_Data, "%s", runtime_Status.last_call);
+    return ESP_OK;
+  }
+
   if (nvs_get_str(nvs_System_handle, NVS_LAST_CALL, NULL, &required_size) ==
       ESP_OK) {
     // ////printf("\nrequire size %d\n", required_size);
@@ -1415,6 +1776,10 @@ void get_NVS_Parameters() {
     qmtstat_label = 0;
   }
 
+  runtime_Status.qmtstat = qmtstat_label;
+  runtime_Status.qmtstat_snapshot = qmtstat_label;
+  runtime_Status.qmt_large_data = 0;
+
   if (nvs_get_u32(nvs_System_handle, NVS_KEY_RESTART_SYSTEM,
                   &restartSystem_time) != ESP_OK) {
     nvs_set_u32(nvs_System_handle, NVS_KEY_RESTART_SYSTEM, 303);
@@ -1450,6 +1815,7 @@ void get_NVS_Parameters() {
   }
 
   //////printf("\n\n routine clear 5454\n\n");
+  init_State_Journal();
   initNVS_relay2();
   initNVS_relay1();
 
@@ -1484,21 +1850,18 @@ void get_NVS_Parameters() {
 
 void initNVS_relay2() {
   uint8_t releValue = 0;
-  label_Routine2_ON = get_INT8_Data_From_Storage(
-      NVS_KEY_ROUTINE2_LABEL,
-      nvs_System_handle); // get a label da rotina 1 se estava ativa
+  label_Routine2_ON = get_INT8_State_From_Journal(
+      STATE_KEY_ROUTINE2_LABEL); // get a label da rotina 1 se estava ativa
   //////printf("\n\n routine clear 5555\n\n");
   if (label_Routine2_ON ==
       255) // verificação se ja existe, se não existe inicia com 0
   {
     label_Routine2_ON = 0;
-    save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, label_Routine2_ON,
-                              nvs_System_handle);
+    save_State_In_Journal(STATE_KEY_ROUTINE2_LABEL, label_Routine2_ON);
   }
   //////printf("\n\n routine clear 6666\n\n");
-  releValue = get_INT8_Data_From_Storage(
-      NVS_KEY_RELAY2_LAST_VALUE,
-      nvs_System_handle); // get ao ultimo estado do rele 1
+  releValue = get_INT8_State_From_Journal(
+      STATE_KEY_RELAY2_LAST_VALUE); // get ao ultimo estado do rele 1
   //////printf("\n\n routine clear 7777\n\n");
   if (releValue == 255) // verificação se ja se encontra inicializada, se não
                         // estiver inicia o valor do ultimo estado, a label da
@@ -1506,36 +1869,34 @@ void initNVS_relay2() {
   {
     //////printf("\n\n routine clear 8888\n\n");
     gpio_set_level(GPIO_OUTPUT_IO_1, 0);
-    save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, 0, nvs_System_handle);
+    save_State_In_Journal(STATE_KEY_RELAY2_LAST_VALUE, 0);
     label_Routine2_ON = 0;
-    save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, 0, nvs_System_handle);
-    nvs_set_u64(nvs_System_handle, NVS_KEY_ROUTINE2_TIME_ON, 0);
+    save_State_In_Journal(STATE_KEY_ROUTINE2_LABEL, 0);
+    save_State_In_Journal(STATE_KEY_ROUTINE2_TIME_ON, 0);
   } else // se ja estiver a label iniciada
   {
     //////printf("\n\n routine clear 9999\n\n");
-    label_Routine2_ON = get_INT8_Data_From_Storage(
-        NVS_KEY_ROUTINE2_LABEL,
-        nvs_System_handle); // get à label do ultimo estado da rotina
+    label_Routine2_ON = get_INT8_State_From_Journal(
+        STATE_KEY_ROUTINE2_LABEL); // get à label do ultimo estado da rotina
 
     if (label_Routine2_ON == 255) // verificação se esta inicializada
     {
       //////printf("\n\n routine clear 10000\n\n");
       // caso nao esteja inicializada inicia a label a 0
       label_Routine2_ON = 0;
-      save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, label_Routine2_ON,
-                                nvs_System_handle);
+      save_State_In_Journal(STATE_KEY_ROUTINE2_LABEL, label_Routine2_ON);
     }
     //////printf("\n\n routine clear 1001\n\n");
     if (label_Routine2_ON == 1) // check if rotine was activated
     {
       //////printf("\n\n routine clear 1003\n\n");
       uint64_t timeRoutine2 = 0;
-      if (nvs_get_u64(nvs_System_handle, NVS_KEY_ROUTINE2_TIME_ON,
-                      &timeRoutine2) != ESP_OK) // get time off of the rotine
+      if (!get_State_From_Journal(STATE_KEY_ROUTINE2_TIME_ON,
+                                  &timeRoutine2)) // get time off of the rotine
       {
         //////printf("\n\n routine clear 1002\n\n");
         timeRoutine2 = 0;
-        nvs_set_u64(nvs_System_handle, NVS_KEY_ROUTINE2_TIME_ON, 0);
+        save_State_In_Journal(STATE_KEY_ROUTINE2_TIME_ON, 0);
         //////printf("\n\n routine clear 1003\n\n");
       }
       // if time routine is 0 or now time is bigger than routine off time put 0
@@ -1546,104 +1907,91 @@ void initNVS_relay2() {
         // //printf("\n\n routine clear\n\n");
         gpio_set_level(GPIO_OUTPUT_IO_1, 0);
         label_Routine2_ON = 0;
-        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, 0, nvs_System_handle);
-        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_TIME_ON, 0,
-                                  nvs_System_handle);
+        save_State_In_Journal(STATE_KEY_ROUTINE2_LABEL, 0);
+        save_State_In_Journal(STATE_KEY_ROUTINE2_TIME_ON, 0);
       } else // put 1 in the variavels
       {
         // //printf("\n\n routine NOT clear\n\n");
         gpio_set_level(GPIO_OUTPUT_IO_1, 1);
         label_Routine2_ON = 1;
-        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, 1, nvs_System_handle);
-        save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, 1,
-                                  nvs_System_handle);
+        save_State_In_Journal(STATE_KEY_ROUTINE2_LABEL, 1);
+        save_State_In_Journal(STATE_KEY_RELAY2_LAST_VALUE, 1);
       }
     } else // else label routine is 0 put the relay last value
     {
       label_Routine2_ON = releValue;
-      save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, releValue,
-                                nvs_System_handle);
+      save_State_In_Journal(STATE_KEY_ROUTINE2_LABEL, releValue);
       gpio_set_level(GPIO_OUTPUT_IO_1, releValue);
-      save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, releValue,
-                                nvs_System_handle);
+      save_State_In_Journal(STATE_KEY_RELAY2_LAST_VALUE, releValue);
     }
   }
 }
 
 void initNVS_relay1() {
   uint8_t releValue = 0;
-  label_Routine1_ON = get_INT8_Data_From_Storage(
-      NVS_KEY_ROUTINE1_LABEL,
-      nvs_System_handle); // get a label da rotina 1 se estava ativa
+  label_Routine1_ON = get_INT8_State_From_Journal(
+      STATE_KEY_ROUTINE1_LABEL); // get a label da rotina 1 se estava ativa
 
   if (label_Routine1_ON ==
       255) // verificação se ja existe, se não existe inicia com 0
   {
     label_Routine1_ON = 0;
-    save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, label_Routine1_ON,
-                              nvs_System_handle);
+    save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, label_Routine1_ON);
   }
 
-  releValue = get_INT8_Data_From_Storage(
-      NVS_KEY_RELAY1_LAST_VALUE,
-      nvs_System_handle); // get ao ultimo estado do rele 1
+  releValue = get_INT8_State_From_Journal(
+      STATE_KEY_RELAY1_LAST_VALUE); // get ao ultimo estado do rele 1
 
   if (releValue == 255) // verificação se ja se encontra inicializada, se não
                         // estiver inicia o valor do ultimo estado, a label da
                         // rotina e do tempo da rotina a 0
   {
     gpio_set_level(GPIO_OUTPUT_IO_0, 0);
-    save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, 0, nvs_System_handle);
+    save_State_In_Journal(STATE_KEY_RELAY1_LAST_VALUE, 0);
     label_Routine1_ON = 0;
-    save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, 0, nvs_System_handle);
-    nvs_set_u64(nvs_System_handle, NVS_KEY_ROUTINE1_TIME_ON, 0);
+    save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, 0);
+    save_State_In_Journal(STATE_KEY_ROUTINE1_TIME_ON, 0);
   } else // se ja estiver a label iniciada
   {
-    label_Routine1_ON = get_INT8_Data_From_Storage(
-        NVS_KEY_ROUTINE1_LABEL,
-        nvs_System_handle); // get à label do ultimo estado da rotina
+    label_Routine1_ON = get_INT8_State_From_Journal(
+        STATE_KEY_ROUTINE1_LABEL); // get à label do ultimo estado da rotina
 
     if (label_Routine1_ON == 255) // verificação se esta inicializada
     {
       // caso nao esteja inicializada inicia a label a 0
       label_Routine1_ON = 0;
-      save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, label_Routine1_ON,
-                                nvs_System_handle);
+      save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, label_Routine1_ON);
     }
 
     if (label_Routine1_ON == 1) // check if rotine was activated
     {
       uint64_t timeRoutine1 = 0;
-      if (nvs_get_u64(nvs_System_handle, NVS_KEY_ROUTINE1_TIME_ON,
-                      &timeRoutine1) != ESP_OK) // get time off of the rotine
+      if (!get_State_From_Journal(STATE_KEY_ROUTINE1_TIME_ON,
+                                  &timeRoutine1)) // get time off of the rotine
       {
         timeRoutine1 = 0;
-        nvs_set_u64(nvs_System_handle, NVS_KEY_ROUTINE1_TIME_ON, 0);
+        save_State_In_Journal(STATE_KEY_ROUTINE1_TIME_ON, 0);
       }
       // if time routine is 0 or now time is bigger than routine off time put 0
       // in variavels
       if (timeRoutine1 == 0 || get_nowTime_in_seconds() > timeRoutine1) {
         gpio_set_level(GPIO_OUTPUT_IO_0, 0);
         label_Routine1_ON = 0;
-        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, 0, nvs_System_handle);
-        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_TIME_ON, 0,
-                                  nvs_System_handle);
+        save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, 0);
+        save_State_In_Journal(STATE_KEY_ROUTINE1_TIME_ON, 0);
       } else // put 1 in the variavels
       {
         gpio_set_level(GPIO_OUTPUT_IO_0, 1);
         label_Routine1_ON = 1;
-        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, 1, nvs_System_handle);
-        save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, 1,
-                                  nvs_System_handle);
+        save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, 1);
+        save_State_In_Journal(STATE_KEY_RELAY1_LAST_VALUE, 1);
       }
     } else // else label routine is 0 put the relay last value
     {
       label_Routine1_ON = releValue;
-      save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, releValue,
-                                nvs_System_handle);
+      save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, releValue);
       gpio_set_level(GPIO_OUTPUT_IO_0, releValue);
-      save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, releValue,
-                                nvs_System_handle);
+      save_State_In_Journal(STATE_KEY_RELAY1_LAST_VALUE, releValue);
     }
   }
 }
@@ -2010,6 +2358,8 @@ void take_LOG_Files_Semph() {
 void initSystem() {
   esp_err_t ret;
 
+  cron_job_list_init();
+
   readAllUser_Label = 0;
   readAllUser_ConnID = 0;
   label_Reset_Password_OR_System = 0;
@@ -2129,13 +2479,9 @@ void initSystem() {
   rdySem_Send_LOGS_Files = xSemaphoreCreateBinary();
   rdySem_Reset_System = xSemaphoreCreateBinary();
   rdySem_Send_Routines = xSemaphoreCreateBinary();
-  rdySem_Routine_BiState_Send_RelayState1 = xSemaphoreCreateBinary();
-  rdySem_Routine_BiState_Send_RelayState2 = xSemaphoreCreateBinary();
   init_rdySem_Control_SD_Card_Write();
 
   xSemaphoreTake(rdySem_Send_LOGS_Files, 1);
-  xSemaphoreTake(rdySem_Routine_BiState_Send_RelayState1, 0);
-  xSemaphoreTake(rdySem_Routine_BiState_Send_RelayState2, 0);
 
   FILE *f = fopen("/spiffs/language.json", "r");
 
@@ -2211,21 +2557,14 @@ void initSystem() {
   // ////printf("\n\n X10 1223 -- %d\n\n",
   // gpio_get_level(GPIO_INPUT_IO_SIMPRE));
   get_NVS_Parameters();
+  init_Timer_Service();
 
   // ////printf("\n\n akakak 221\n\n");
   //  xTaskCreate(task_sendFeedbackData, "task_sendFeedbackData", 2 * 2048,
   //  NULL, 20, NULL);
-  xTaskCreate(task_BiState_Send_RelayState1, "task_BiState_Send_RelayState1",
-              2 * 2048 + 1024, NULL, 15, &rele1_Bistate_Task_Handle);
-  xTaskCreate(task_BiState_Send_RelayState2, "task_BiState_Send_RelayState2",
-              2 * 2048 + 1024, NULL, 15, &rele2_Bistate_Task_Handle);
+  init_Relay_Engine();
+  init_Input_Rules();
   // ////printf("\n\n BEFORE ROUTINE RELAY\n\n");
-  xTaskCreate(task_Routine_BiState_Send_RelayState1,
-              "task_Routine_BiState_Send_RelayState1", 1024, NULL, 20,
-              &task_Routine_BiState_RelayState1);
-  xTaskCreate(task_Routine_BiState_Send_RelayState2,
-              "task_Routine_BiState_Send_RelayState2", 1024, NULL, 20,
-              &task_Routine_BiState_RelayState2);
 
   char fb_phoneff[30];
 
@@ -2238,18 +2577,16 @@ void initSystem() {
   // nvs_Feedback_handle));
   printf("\n\n akakak 333\n\n");
   xTaskCreate(task_Send_Routines, "task_Send_Routines", 1024 * 4, NULL, 18,
-              &task_Routine_BiState_RelayState2);
+              NULL);
 
   init_EG91();
-  xTaskCreate(taskMipot_rf, "taskMipot_rf", 6 * 2048, NULL, 15,
-              &rele1_Bistate_Task_Handle);
+  xTaskCreate(taskMipot_rf, "taskMipot_rf", 6 * 2048, NULL, 15, NULL);
   xTaskCreate(wiegand1_task, "TAG", 2048 * 4 + 1024, NULL, 5, NULL);
   xTaskCreate(wiegand2_task, "TAG", 2048 * 4 + 1024, NULL, 5, NULL);
   printf("\n\n akakak 444\n\n");
   label_initSystem_SIMPRE = 1;
   // save_INT8_Data_In_Storage(NVS_KEY_SDCARD_RESET, 0, nvs_System_handle);
 
-  example_tg_timer_init(TIMER_GROUP_0, TIMER_0, false, 30);
   xTimers = xTimerCreate("Timer", pdMS_TO_TICKS(2000), pdTRUE, (void *)0,
                          vTimerCallback);
   // ////printf("\n\n akakak 444\n\n");
@@ -2268,7 +2605,8 @@ void initSystem() {
   }
 
   // EG91_writeFile("char *fileName", "char *file", 12);
-  // init_SDCard();
+  init_SDCard();
+  init_Log_Upload();
   // ////printf("\n\n akakak 666\n\n");
 
   // ////printf("\n\n akakak 888\n\n");
@@ -2526,6 +2864,31 @@ void decrypt_aes_cfb_padding(const unsigned char *input, size_t input_len,
   // mbedtls_cipher_free(&ctx);
 }
 
+/* versao em fluxo para a FOTA: o estado CTR (nonce_counter, stream_block,
+   nc_off) fica com o chamador, por isso os blocos lidos do modem podem ter
+   qualquer tamanho multiplo de 4 caracteres base64 */
+size_t decrypt_aes_ctr_stream(const unsigned char *input, size_t input_len,
+                              unsigned char *output, size_t output_size,
+                              unsigned char *nonce_counter,
+                              unsigned char *stream_block, size_t *nc_off) {
+  const unsigned char key[] = "C55YOj8C1em3IAKm";
+  mbedtls_aes_context ctx;
+  size_t output_len = 0;
+
+  if (mbedtls_base64_decode(output, output_size, &output_len, input,
+                            input_len) != 0) {
+    return 0;
+  }
+
+  mbedtls_aes_init(&ctx);
+  mbedtls_aes_setkey_enc(&ctx, key, 128);
+  mbedtls_aes_crypt_ctr(&ctx, output_len, nc_off, nonce_counter, stream_block,
+                        output, output);
+  mbedtls_aes_free(&ctx);
+
+  return output_len;
+}
+
 void decrypt_aes_cbc_padding(const unsigned char *input, size_t input_len,
                              unsigned char *output, const unsigned char *key,
                              const unsigned char *iv) {
@@ -30,6 +30,7 @@
 #include "mbedtls/base64.h"
 #include "rele.h"
 #include "rf.h"
+#include "phone_e164.h"
 
 extern nvs_handle_t nvs_System_handle;
 extern nvs_handle_t nvs_Owner_handle;
@@ -96,6 +97,7 @@ nvs_handle_t nvs_rf_codes_owner_handle;
 nvs_handle_t nvs_wiegand_antipassback_USER_handle;
 nvs_handle_t nvs_wiegand_antipassback_ADMIN_handle;
 nvs_handle_t nvs_wiegand_antipassback_OWNER_handle;
+nvs_handle_t nvs_Phone_Index_handle;
 
 /* static */ SemaphoreHandle_t rdySem_RelayMonoStart;
 /* static  */SemaphoreHandle_t rdySem_RelayMonoInicial;
@@ -115,8 +117,6 @@ uint8_t label_network_portalRegister;
 extern uint8_t label_MonoStableRelay1;
 extern uint8_t label_MonoStableRelay2;
 
-/* static */ QueueHandle_t queue_BLE_Parameters1;
-/* static */ QueueHandle_t queue_BLE_Parameters2;
 extern QueueHandle_t queue_EG91_SendSMS;
 
 extern cJSON *sms_Rsp_Json;
@@ -151,6 +151,7 @@ inline uint64_t get_nowTime_in_seconds(void)
 #define NUM_RECORDS 100
 static heap_trace_record_t trace_record[NUM_RECORDS];
 void decrypt_aes_cfb_padding(const unsigned char *input, size_t input_len, unsigned char *output);
+size_t decrypt_aes_ctr_stream(const unsigned char *input, size_t input_len, unsigned char *output, size_t output_size, unsigned char *nonce_counter, unsigned char *stream_block, size_t *nc_off);
 
 typedef struct
 {
@@ -165,6 +166,23 @@ typedef struct
 
 extern NOW_TIME nowTime;
 
+/* estado de execucao mantido em RAM (antes gravado em NVS a cada mensagem MQTT) */
+typedef struct
+{
+    volatile uint8_t qmtstat;
+    volatile uint8_t qmt_large_data;
+    uint8_t qmtstat_snapshot;
+    uint16_t snapshot_tick;
+    uint32_t nvs_write_counter;
+    char last_call[20];
+    uint8_t last_call_dirty;
+
+} RUNTIME_STATUS;
+
+#define RUNTIME_STATUS_SNAPSHOT_TICKS 60
+
+extern RUNTIME_STATUS runtime_Status;
+
 extern uint32_t date_To_Send_Periodic_SMS;
 extern uint8_t label_To_Send_Periodic_SMS;
 
@@ -196,6 +214,9 @@ uint8_t refresh_ESP_RTC();
 /// @return
 char *parseInputData(uint8_t *inputData, uint8_t BLE_SMS_Indication, uint8_t gattsIF, uint16_t connID, uint16_t handle_table, data_EG91_Send_SMS *data_SMS, mqtt_information *mqttInfo);
 
+/// @brief valida o utilizador e encaminha um comando ja separado em elemento/comando/parametro
+char *dispatch_InputCommand(uint8_t BLE_SMS_Indication, char *phNumber, char *phPassword, char *element, char cmd, char parameter, char *input_Payload, uint8_t gattsIF, uint16_t connID, uint16_t handle_table, data_EG91_Send_SMS *data_SMS, mqtt_information *mqttInfo);
+
 uint8_t get_RTC_System_Time();
 int base64_decode(const char *input, size_t input_len, unsigned char **output);
 void add_padding_pkcs7(unsigned char *input, size_t input_len, size_t block_size);
@@ -212,9 +233,16 @@ uint8_t parse_CountryPhoneNumber(char *data);
 char *check_IF_haveCountryCode(char *phoneNumber, uint8_t label_addUser);
 char *check_IF_haveCountryCode_AUX_Call(char *phoneNumber);
 
-uint8_t cmd_process();
+#define PHONE_DEFAULT_COUNTRY "351"
 
-char *compress_UDP_Data(uint8_t code, char *payload);
+uint8_t set_Default_Country_Code(char *countryCode);
+char *get_Default_Country_Code();
+uint8_t phone_Canonicalize_E164(char *phoneNumber, char *e164);
+uint8_t save_Phone_Index(char *phoneNumber, char *key, nvs_handle_t handle);
+uint8_t get_Phone_Index(char *phoneNumber, char *key, nvs_handle_t *handle);
+void erase_Phone_Index(char *phoneNumber);
+
+uint8_t cmd_process();
 
 uint8_t restore_FileContacts();
 int calculate_weekDay(int year, int month, int day);
@@ -229,6 +257,7 @@ uint8_t save_STR_Data_In_Storage(char *key, char *payload, nvs_handle_t my_handl
 uint8_t get_STR_Data_In_Storage(char *key, nvs_handle_t my_handle, char *strRSP);
 
 int8_t get_Data_Users_From_Storage(char *key, char *rsp);
+int8_t get_Data_Users_Handle_From_Storage(char *key, char *rsp, nvs_handle_t *found_handle);
 
 uint8_t get_Data_STR_Feedback_From_Storage(char *key, char *rsp);
 
@@ -236,6 +265,20 @@ uint8_t save_INT8_Data_In_Storage(char *key, uint8_t value, nvs_handle_t my_hand
 
 uint8_t get_INT8_Data_From_Storage(char *key, nvs_handle_t my_handle);
 
+void set_Runtime_QMTSTAT(uint8_t value);
+uint8_t get_Runtime_QMTSTAT();
+void snapshot_Runtime_Status();
+void tick_Runtime_Status_Snapshot();
+uint32_t get_NVS_Write_Counter();
+
+void init_State_Journal();
+void save_State_In_Journal(uint8_t key, uint64_t value);
+uint8_t get_State_From_Journal(uint8_t key, uint64_t *value);
+uint8_t get_INT8_State_From_Journal(uint8_t key);
+void clear_State_Journal();
+uint32_t get_State_Journal_Writes_Per_Hour();
+void set_Runtime_Last_Call(char *phNumber);
+
 uint8_t save_User_Counter_In_Storage(uint32_t value);
 
 uint32_t get_User_Counter_From_Storage();
@@ -5,144 +5,146 @@
 #include "jobs.h"
 #include "stdio.h"
 
+static struct
+{
+  unsigned char running;
+  TaskHandle_t handle;
+  time_t seconds_until_next_execution;
+
+} state = {
+    .running = 0,
+    .handle = NULL,
+    .seconds_until_next_execution = -1};
 
+static void cron_wake_scheduler()
+{
+  if (state.handle != NULL)
+  {
+    xTaskNotifyGive(state.handle);
+  }
+}
 
 cron_job *cron_job_create(const char *schedule, cron_job_callback callback, void *data)
 {
-  cron_job_list_init(); // CALL THIS ON ANY CREATE
-  //////printf("\n\nCRON TAB 45\n\n");
-  cron_job *job = calloc(sizeof(cron_job), 1);
-  //////printf("\n\nCRON TAB 46\n\n");
+  cron_job *job = cron_job_list_alloc();
   if (job == NULL)
   {
     goto end;
   }
-  //////printf("\n\nCRON TAB 47\n\n");
   job->callback = callback;
-  asprintf(&job->data,"%s",(char*)data);
-  //*job->data = *data;
-  job->id = -1;
-  job->load = NULL;
-  //////printf("\n\nCRON TAB 48\n\n");
+  snprintf(job->data, sizeof(job->data), "%s", (char *)data);
   cron_job_load_expression(job, schedule);
-  //////printf("\n\nCRON TAB 49\n\n");
-  cron_job_schedule(job);
-  //////printf("\n\nCRON TAB 50\n\n");
+  if (cron_job_schedule(job) != 0)
+  {
+    cron_job_list_free(job);
+    job = NULL;
+  }
   goto end;
 
 end:
   return job;
 }
 
-int cron_job_destroy(cron_job *job)
+cron_job *cron_job_create_compiled(const cron_expr *expression, cron_job_callback callback, void *data)
 {
-  int ret = 0;
+  cron_job *job = cron_job_list_alloc();
   if (job == NULL)
   {
-    ret = -1;
-    goto end;
+    return NULL;
   }
-  ret = cron_job_unschedule(job);
-  free(job->data);
-  free(job);
-end:
-  return ret;
+  job->callback = callback;
+  snprintf(job->data, sizeof(job->data), "%s", (char *)data);
+  memcpy(&(job->expression), expression, sizeof(job->expression));
+  job->load = &(job->expression);
+  if (cron_job_schedule(job) != 0)
+  {
+    cron_job_list_free(job);
+    job = NULL;
+  }
+  return job;
 }
 
-int cron_job_clear_all()
+int cron_job_destroy(cron_job *job)
 {
-  // REFACTOR THIS!
-  while (cron_job_list_first())
+  if (job == NULL)
   {
-    cron_job_destroy(cron_job_list_first()->job);
+    return -1;
   }
-  cron_job_list_reset_id();
+  cron_job_list_free(job);
+  cron_wake_scheduler();
   return 0;
 }
 
-int cron_stop()
+int cron_job_clear_all()
 {
+  cron_job_list_clear();
+  cron_wake_scheduler();
+  return 0;
+}
 
+int cron_stop()
+{
   if (state.running == 0)
   {
-    //////printf("\ncron_stop 11\n");
     return -1;
   }
-  TaskHandle_t xHandle;
   state.running = 0;
-  ////////printf("\nstate.handle = %d")
-  //xHandle = state.handle;
-  //state.handle = NULL;
-  if (state.handle != NULL)
-  {
-    //////printf("\ncron_stop 22\n");
-    //vTaskSuspend(state.handle);
-    vTaskDelete(state.handle);
-    state.handle = NULL;
-  }
-  //////printf("\ncron_stop 33\n");
+  cron_wake_scheduler();
   return 0;
 }
 
 int cron_start()
 {
   BaseType_t xReturned;
-  if (state.running == 1 || state.handle != NULL)
+  if (state.running == 1)
   {
-    //////printf("\ncron_start\nrunning = %d\n",(int)state.running);
     return -1;
   }
-  //////printf("\ncron_start22\nrunning = %d\n",(int)state.running);
-  /* Create the task, storing the handle. */
-  xReturned = xTaskCreatePinnedToCore(
-      cron_schedule_task,   /* Function that implements the task. */
-      "cron_schedule_task", /* Text name for the task. */
-      4096,                 /* Stack size in words, not bytes. */
-      (void *)0,            /* Parameter passed into the task. */
-       tskIDLE_PRIORITY + 2, /* Priority at which the task is created. */
-      &state.handle,        /* NO NEED FOR THE HANDLE! I GOT IT IN STATE. */
-      tskNO_AFFINITY);      /* NO SPECIFIC CORE */
-  if (xReturned != pdPASS)
-  {
-    /* The task was created.  Use the task's handle to delete the task. */
+  if (state.handle == NULL)
+  {
+    /* Created once, cron_stop only puts it to sleep. */
+    xReturned = xTaskCreatePinnedToCore(
+        cron_schedule_task,   /* Function that implements the task. */
+        "cron_schedule_task", /* Text name for the task. */
+        4096 * 2,             /* Stack size in BYTES, the callbacks run here. */
+        (void *)0,            /* Parameter passed into the task. */
+        tskIDLE_PRIORITY + 2, /* Priority at which the task is created. */
+        &state.handle,        /* NO NEED FOR THE HANDLE! I GOT IT IN STATE. */
+        tskNO_AFFINITY);      /* NO SPECIFIC CORE */
+    if (xReturned != pdPASS)
+    {
+      state.handle = NULL;
+      return -1;
+    }
   }
   state.running = 1;
+  cron_wake_scheduler();
   return 0;
 }
 
 int cron_job_schedule(cron_job *job)
 {
-  
   if (job == NULL)
   {
-    
     return -1;
   }
   if (!cron_job_has_loaded(job))
   {
-    
     return -1;
   }
   time_t now;
-  
   time(&now);
- 
   job->next_execution = cron_next(&(job->expression), now);
-  
-  int id = cron_job_list_insert(job);
-
-  if (id < 0)
+  if (job->next_execution == (time_t)-1)
   {
- 
     return -1;
   }
-  else
+  if (cron_job_list_insert(job) < 0)
   {
-   
-    return 0;
+    return -1;
   }
- 
-  return 0; // WONT RUN
+  cron_wake_scheduler();
+  return 0;
 }
 
 int cron_job_unschedule(cron_job *job)
@@ -152,9 +154,10 @@ int cron_job_unschedule(cron_job *job)
   {
     ret = -1;
   }
-  else if (job->id >= 0)
+  else if (cron_job_list_remove(job->id) == 0)
   {
-    ret = cron_job_list_remove(job->id);
+    /* o heap_index so e lido com o semaforo da lista */
+    cron_wake_scheduler();
   }
   return ret;
 }
@@ -192,67 +195,42 @@ time_t cron_job_seconds_until_next_execution()
 
 // CRON TASKS
 
-void cron_schedule_job_launcher(void *args)
-{
-  if (args == NULL)
-  {
-    goto end;
-  }
-  cron_job *job = (cron_job *)args;
-  job->callback(job);
-  goto end;
-
-end:
-  vTaskDelete(NULL);
-  return;
-}
-
 void cron_schedule_task(void *args)
 {
-  time_t now;
-  cron_job *job = NULL;
-  int r1 = 0; // RUN ONCE!!
-              // IF ARGS ARE A STRING DEFINED AS R1
-  if (args != NULL)
-  {
-    if (strncmp(args, "R1", 2) == 0) // OK I ADMIT IT, ITS NOT THE MOST BEAUTIFUL CODE EVER, BUT I NEED IT TO BE TESTABLE... DON'T WANT TO GROW OLD WAITING FOR TIME TO PASS... :P
-      r1 = 1;
-  }
+  struct timeval now;
+  cron_job due;
+  time_t next_execution;
+  int64_t wait_ms;
+  TickType_t wait;
 
   while (true)
   {
-    state.running = 1;
-    time(&now);
-    job = cron_job_list_first()->job;
-    if (job == NULL)
-    {
-      break; // THIS IS IT!!! THIS WILL
-    }
-    if (now >= job->next_execution)
-    {
-      /* Create the task, IT WILL KILL ITSELF AFTER THE JOB IS DONE. */
-      xTaskCreatePinnedToCore(
-          cron_schedule_job_launcher,   /* Function that implements the task. */
-          "cron_schedule_job_launcher", /* Text name for the task. */
-          4096*2,                         /* Stack size in BYTES, not bytes. */
-          (void *)job,                  /* Job is passed into the task. */
-          tskIDLE_PRIORITY + 2,         /* Priority at which the task is created. */
-          (NULL),                       /* No need for the handle */
-          tskNO_AFFINITY);              /* No specific core */
-      cron_job_list_remove(job->id);    // There is mutex in there that can mess with our timing, but i am not sure if we should move this to the new task.
-      cron_job_schedule(job);           // There is mutex in there that can mess with our timing, but i am not sure if we should move this to the new task.
-    }
-    else
-    {
-
-      state.seconds_until_next_execution = job->next_execution - now;
-      vTaskDelay((state.seconds_until_next_execution * 1000) / portTICK_PERIOD_MS);
-    }
-    if (r1 != 0)
+    wait = portMAX_DELAY;
+    if (state.running)
     {
-      break;
+      gettimeofday(&now, NULL);
+      if (cron_job_list_take_due(now.tv_sec, &due, &next_execution))
+      {
+        // THE JOB IS ALREADY RESCHEDULED, RUN THE COPY SO A CONCURRENT CHANGE TO THE SLOT IS HARMLESS
+        due.callback(&due);
+        continue;
+      }
+      if (next_execution != (time_t)-1)
+      {
+        state.seconds_until_next_execution = next_execution - now.tv_sec;
+        wait_ms = (int64_t)state.seconds_until_next_execution * 1000 - now.tv_usec / 1000;
+        if (wait_ms > CRON_MAX_SLEEP_MS)
+        {
+          wait_ms = CRON_MAX_SLEEP_MS;
+        }
+        wait = pdMS_TO_TICKS(wait_ms) + 1;
+      }
+      else
+      {
+        state.seconds_until_next_execution = -1;
+      }
     }
+    // WOKEN EARLIER BY cron_wake_scheduler WHEN THE SCHEDULE CHANGES
+    ulTaskNotifyTake(pdTRUE, wait);
   }
-  cron_stop();
-  return;
 }
@@ -42,8 +42,9 @@
 *            | │ │ │ │ │
 *            | │ │ │ │ │
 *            * * * * * *  
-*  - data: pointer to arbitrary data needed by the cron_job
-*  - id: identifier in the module for this cron job, this allows to unschedule similar tasks
+*  - data: string needed by the cron_job (copied, up to CRON_JOB_DATA_SIZE - 1 chars)
+*  - id: slot of the job in the module pool, this allows to unschedule similar tasks
+*  - heap_index: position in the schedule heap, -1 when not scheduled
 *  - next execution: this information holds the time when it will run next, is managed by the cron module
 *  - see https://github.com/staticlibs/ccronexpr
 */
@@ -52,48 +53,54 @@
 struct cron_job_struct; 
 typedef struct cron_job_struct cron_job;
 
+// SIZE OF THE PRE-ALLOCATED JOB POOL AND OF THE DATA COPIED INTO EACH JOB
+#define CRON_JOB_MAX 300
+#define CRON_JOB_DATA_SIZE 4
+// THE SCHEDULER WAKES UP AT LEAST THIS OFTEN TO FOLLOW CLOCK ADJUSTMENTS
+#define CRON_MAX_SLEEP_MS 60000
+
 struct cron_job_struct 
 {
   void (* callback)(cron_job *);
   cron_expr expression;
-  /* void */ char * data;
+  char data[CRON_JOB_DATA_SIZE];
   int id;
+  int heap_index;
   void * load;
   time_t next_execution;
 };
 
-static struct
-{
-  unsigned char running;
-  TaskHandle_t handle;
-  time_t seconds_until_next_execution;
-
-} state = {
-    .running = 0,
-    .handle = NULL,
-    .seconds_until_next_execution = -1};
-
 
 // FUNCTION POINTER TO CALLBACKS
 typedef void (*cron_job_callback)(cron_job *);
 
 
 /*
-*  SUMARY: Allocates a cron job on the heap with supplied parameters
+*  SUMARY: Takes a cron job from the pool with supplied parameters and schedules it
 *  
-*  PARAMS: CRON SYNTAX SCHEDULE, CALLBACK (JOB), DATA FOR THE CALLBACK
+*  PARAMS: CRON SYNTAX SCHEDULE, CALLBACK (JOB), DATA FOR THE CALLBACK (STRING)
 *
-*  RETURNS: heap allocated cron_job
+*  RETURNS: pool allocated cron_job, NULL if the pool is full or the schedule is invalid
 */
 
 cron_job * cron_job_create(const char * schedule,cron_job_callback callback, void * data);
 
 /*
-*  SUMARY: Deallocates, and remove from scheduling 
+*  SUMARY: Same as cron_job_create with an expression already parsed by cron_parse_expr
+*
+*  PARAMS: PARSED EXPRESSION (COPIED), CALLBACK (JOB), DATA FOR THE CALLBACK (STRING)
+*
+*  RETURNS: pool allocated cron_job, NULL if the pool is full or the expression never fires
+*/
+
+cron_job * cron_job_create_compiled(const cron_expr * expression, cron_job_callback callback, void * data);
+
+/*
+*  SUMARY: Removes from scheduling and gives the slot back to the pool
 *  
 *  PARAMS: Cron job to deallocate
 *
-*  RETURNS: heap allocated cron_job
+*  RETURNS: 0 on success
 */
 
 int cron_job_destroy(cron_job * job);
@@ -102,7 +109,7 @@ int cron_job_destroy(cron_job * job);
 /*
 *  SUMMARY: Removes all cron_job from the module
 *
-*  PARAMS: removes all cron_jobs (no deallocation is performed by the call, memory must be handled out of this module)
+*  PARAMS: removes all cron_jobs and gives their slots back to the pool
 *
 *  RETURNS:  0 on success
 */
@@ -110,7 +117,7 @@ int cron_job_destroy(cron_job * job);
 int cron_job_clear_all();
 
 /*
-*  SUMMARY: Starts the schedule module (creates a new task on the operating system)
+*  SUMMARY: Starts the schedule module (the task is created on the first call and kept afterwards)
 *
 *  RETURNS:  0 on success
 */
@@ -118,7 +125,7 @@ int cron_job_clear_all();
 int cron_start();
 
 /*
-*  SUMMARY: Stops the schedule module (deletes the cron task on the operating system)
+*  SUMMARY: Stops the schedule module (the cron task stays asleep until the next cron_start)
 *
 *  RETURNS:  0 on success
 */
@@ -129,7 +136,7 @@ int cron_stop();
 /*
 *  SUMMARY: Schedule a new cron_job
 *
-*  PARAMS: cron_job to be scheduled (no allocation is performed by the call, memory must be handled out of this module)
+*  PARAMS: cron_job to be scheduled (taken from the pool by cron_job_create)
 *
 *  RETURNS:  0 on success
 */
@@ -158,9 +165,10 @@ int cron_job_unschedule(cron_job * job);
 time_t cron_job_seconds_until_next_execution();
 
 /*
-*  SUMARY: TASK SCHEDULER WITH DELAYS AND CALL TO CALLBACKS DO NOT RUN THIS TAST
+*  SUMARY: TASK SCHEDULER, SLEEPS UNTIL THE EARLIEST JOB AND RUNS THE CALLBACKS ITSELF, DO NOT RUN THIS TASK
+*  IT IS NOTIFIED ON EVERY SCHEDULE CHANGE SO A NEW EARLIER JOB IS NOT MISSED
 *  
-*  PARAMS: ARGS MUST BE NULL IN REGULAR USE, IF YOU WANT TO RUN JUST ONCE ARGS MUST BE A CHAR POINTER TO "R1" LITERAL
+*  PARAMS: ARGS MUST BE NULL
 *
 *  RETURNS: NO RETURN
 */
@@ -0,0 +1,274 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "fota_delta.h"
+#include "crc32.h"
+#include <string.h>
+
+enum
+{
+  DELTA_HEADER,
+  DELTA_OP,
+  DELTA_COPY_OFFSET,
+  DELTA_COPY_LEN,
+  DELTA_RUN_ZEROS,
+  DELTA_RUN_LITS,
+  DELTA_LITS,
+  DELTA_INSERT_LEN,
+  DELTA_INSERT,
+  DELTA_DONE,
+  DELTA_ERROR
+};
+
+uint8_t fota_Delta_Is_Patch(const uint8_t *data, size_t len) {
+  uint32_t magic = 0;
+
+  if (len < sizeof(magic)) {
+    return 0;
+  }
+
+  memcpy(&magic, data, sizeof(magic));
+
+  return magic == FOTA_DELTA_MAGIC;
+}
+
+void fota_Delta_Init(fota_delta *delta, fota_delta_read read_Old,
+                     fota_delta_write write_New, void *ctx) {
+  memset(delta, 0, sizeof(fota_delta));
+  delta->read_Old = read_Old;
+  delta->write_New = write_New;
+  delta->ctx = ctx;
+  delta->state = DELTA_HEADER;
+}
+
+static uint8_t flush_Out(fota_delta *delta) {
+  if (delta->out_len == 0) {
+    return 1;
+  }
+
+  if (delta->write_New(delta->ctx, delta->out, delta->out_len) != 0) {
+    return 0;
+  }
+
+  delta->new_crc = esp_rom_crc32_le(delta->new_crc, delta->out, delta->out_len);
+  delta->new_len += delta->out_len;
+  delta->out_len = 0;
+
+  return 1;
+}
+
+static uint8_t put_Out(fota_delta *delta, uint8_t value) {
+  if (delta->new_len + delta->out_len >= delta->header.new_size) {
+    return 0;
+  }
+
+  delta->out[delta->out_len++] = value;
+
+  return delta->out_len < sizeof(delta->out) || flush_Out(delta);
+}
+
+/* byte seguinte da imagem antiga, -1 fora da imagem ou erro de leitura */
+static int old_Byte(fota_delta *delta) {
+  if (delta->old_pos >= delta->header.old_size) {
+    return -1;
+  }
+
+  if (delta->old_pos < delta->old_buf_pos ||
+      delta->old_pos >= delta->old_buf_pos + delta->old_buf_len) {
+    delta->old_buf_pos = delta->old_pos;
+    delta->old_buf_len = delta->header.old_size - delta->old_pos;
+
+    if (delta->old_buf_len > sizeof(delta->old_buf)) {
+      delta->old_buf_len = sizeof(delta->old_buf);
+    }
+
+    if (delta->read_Old(delta->ctx, delta->old_buf_pos, delta->old_buf,
+                        delta->old_buf_len) != 0) {
+      delta->old_buf_len = 0;
+      return -1;
+    }
+  }
+
+  return delta->old_buf[delta->old_pos++ - delta->old_buf_pos];
+}
+
+/* o patch so se aplica a imagem contra a qual foi gerado */
+static uint8_t check_Old(fota_delta *delta) {
+  uint32_t crc = 0;
+  uint32_t offset = 0;
+  uint32_t n = 0;
+
+  while (offset < delta->header.old_size) {
+    n = delta->header.old_size - offset;
+
+    if (n > sizeof(delta->old_buf)) {
+      n = sizeof(delta->old_buf);
+    }
+
+    if (delta->read_Old(delta->ctx, offset, delta->old_buf, n) != 0) {
+      return 0;
+    }
+
+    crc = esp_rom_crc32_le(crc, delta->old_buf, n);
+    offset += n;
+  }
+
+  delta->old_buf_len = 0;
+
+  return crc == delta->header.old_crc;
+}
+
+/* 1 com o varint completo em delta->varint, 0 a meio, -1 invalido */
+static int8_t get_Varint(fota_delta *delta, uint8_t value) {
+  if (delta->shift > 28) {
+    return -1;
+  }
+
+  delta->varint |= (uint32_t)(value & 0x7F) << delta->shift;
+  delta->shift += 7;
+
+  if (value & 0x80) {
+    return 0;
+  }
+
+  delta->shift = 0;
+
+  return 1;
+}
+
+static uint8_t next_Run(fota_delta *delta) {
+  return delta->copy_left == 0 ? DELTA_OP : DELTA_RUN_ZEROS;
+}
+
+static uint8_t delta_Step(fota_delta *delta, uint8_t value) {
+  int8_t done = 0;
+  int old = 0;
+
+  if ((delta->state >= DELTA_COPY_OFFSET && delta->state <= DELTA_RUN_LITS) ||
+      delta->state == DELTA_INSERT_LEN) {
+    done = get_Varint(delta, value);
+
+    if (done < 0) {
+      return DELTA_ERROR;
+    } else if (done == 0) {
+      return delta->state;
+    }
+  }
+
+  switch (delta->state) {
+  case DELTA_OP:
+    delta->varint = 0;
+
+    if (value == FOTA_DELTA_OP_END) {
+      return flush_Out(delta) ? DELTA_DONE : DELTA_ERROR;
+    } else if (value == FOTA_DELTA_OP_COPY) {
+      return DELTA_COPY_OFFSET;
+    } else if (value == FOTA_DELTA_OP_INSERT) {
+      return DELTA_INSERT_LEN;
+    }
+    return DELTA_ERROR;
+
+  case DELTA_COPY_OFFSET:
+    /* zigzag: deslocamento relativo ao fim da copia anterior */
+    delta->old_pos += (delta->varint >> 1) ^ -(int32_t)(delta->varint & 1);
+    delta->varint = 0;
+    return DELTA_COPY_LEN;
+
+  case DELTA_COPY_LEN:
+    delta->copy_left = delta->varint;
+    delta->varint = 0;
+    return next_Run(delta);
+
+  case DELTA_RUN_ZEROS:
+    if (delta->varint > delta->copy_left) {
+      return DELTA_ERROR;
+    }
+
+    for (uint32_t i = 0; i < delta->varint; i++) {
+      if ((old = old_Byte(delta)) < 0 || !put_Out(delta, old)) {
+        return DELTA_ERROR;
+      }
+    }
+
+    delta->copy_left -= delta->varint;
+    delta->varint = 0;
+    return DELTA_RUN_LITS;
+
+  case DELTA_RUN_LITS:
+    if (delta->varint > delta->copy_left) {
+      return DELTA_ERROR;
+    }
+
+    delta->run_left = delta->varint;
+    delta->varint = 0;
+    return delta->run_left == 0 ? next_Run(delta) : DELTA_LITS;
+
+  case DELTA_LITS:
+    if ((old = old_Byte(delta)) < 0 || !put_Out(delta, old + value)) {
+      return DELTA_ERROR;
+    }
+
+    delta->copy_left--;
+    return --delta->run_left == 0 ? next_Run(delta) : DELTA_LITS;
+
+  case DELTA_INSERT_LEN:
+    delta->run_left = delta->varint;
+    delta->varint = 0;
+    return delta->run_left == 0 ? DELTA_OP : DELTA_INSERT;
+
+  case DELTA_INSERT:
+    if (!put_Out(delta, value)) {
+      return DELTA_ERROR;
+    }
+    return --delta->run_left == 0 ? DELTA_OP : DELTA_INSERT;
+
+  default:
+    return DELTA_ERROR;
+  }
+}
+
+uint8_t fota_Delta_Feed(fota_delta *delta, const uint8_t *data, size_t len) {
+  size_t i = 0;
+
+  if (delta->state == DELTA_HEADER) {
+    while (i < len && delta->header_len < sizeof(fota_delta_header)) {
+      ((uint8_t *)&delta->header)[delta->header_len++] = data[i++];
+    }
+
+    if (delta->header_len < sizeof(fota_delta_header)) {
+      return 1;
+    }
+
+    if (delta->header.magic != FOTA_DELTA_MAGIC ||
+        delta->header.version != FOTA_DELTA_VERSION || !check_Old(delta)) {
+      delta->state = DELTA_ERROR;
+      return 0;
+    }
+
+    delta->state = DELTA_OP;
+  }
+
+  for (; i < len; i++) {
+    if (delta->state == DELTA_DONE || delta->state == DELTA_ERROR) {
+      delta->state = DELTA_ERROR;
+      return 0;
+    }
+
+    delta->state = delta_Step(delta, data[i]);
+  }
+
+  return delta->state != DELTA_ERROR;
+}
+
+uint8_t fota_Delta_Finish(fota_delta *delta) {
+  return delta->state == DELTA_DONE &&
+         delta->new_len == delta->header.new_size &&
+         delta->new_crc == delta->header.new_crc;
+}
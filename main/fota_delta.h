@@ -0,0 +1,100 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _FOTA_DELTA_H_
+#define _FOTA_DELTA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Atualizacao por diferencas: em vez da imagem completa o portal envia um
+ * patch gerado por fota_delta.py contra a imagem em execucao. O patch chega
+ * pela mesma via da FOTA (base64 + AES-CTR, EG91_Fota_Pipeline) e e
+ * reconhecido pelo magic no inicio:
+ *
+ *   [fota_delta_header][comando ...][FOTA_DELTA_OP_END]
+ *
+ *   FOTA_DELTA_OP_COPY    varint zigzag deslocamento da origem, varint n,
+ *                         depois pares [varint zeros][varint k][k bytes]
+ *                         que somados a origem dao os n bytes novos
+ *   FOTA_DELTA_OP_INSERT  varint n e n bytes novos
+ *
+ * A origem e lida da particao em execucao e o resultado escrito na
+ * seguinte por callbacks, com RAM limitada aos dois buffers da estrutura.
+ * Inteiros em little endian, CRC32 como o esp_rom_crc32_le (zlib).
+ */
+
+#define FOTA_DELTA_MAGIC 0x5044324D
+#define FOTA_DELTA_VERSION 1
+
+#define FOTA_DELTA_OP_END 0x00
+#define FOTA_DELTA_OP_COPY 0x01
+#define FOTA_DELTA_OP_INSERT 0x02
+
+#define FOTA_DELTA_OLD_BUFFER 1024
+#define FOTA_DELTA_OUT_BUFFER 4096
+
+typedef struct __attribute__((packed))
+{
+  uint32_t magic;
+  uint8_t version;
+  uint8_t reserved[3];
+  uint32_t old_size;
+  uint32_t old_crc;
+  uint32_t new_size;
+  uint32_t new_crc;
+
+} fota_delta_header;
+
+/* 0 em sucesso, como esp_partition_read e esp_ota_write */
+typedef int (*fota_delta_read)(void *ctx, uint32_t offset, void *buf,
+                               size_t len);
+typedef int (*fota_delta_write)(void *ctx, const void *buf, size_t len);
+
+typedef struct
+{
+  fota_delta_read read_Old;
+  fota_delta_write write_New;
+  void *ctx;
+
+  fota_delta_header header;
+  uint32_t header_len;
+
+  uint8_t state;
+  uint32_t varint;
+  uint8_t shift;
+
+  uint32_t old_pos;
+  uint32_t copy_left;
+  uint32_t run_left;
+
+  uint32_t new_len;
+  uint32_t new_crc;
+
+  uint8_t old_buf[FOTA_DELTA_OLD_BUFFER];
+  uint32_t old_buf_pos;
+  uint32_t old_buf_len;
+
+  uint8_t out[FOTA_DELTA_OUT_BUFFER];
+  uint32_t out_len;
+
+} fota_delta;
+
+uint8_t fota_Delta_Is_Patch(const uint8_t *data, size_t len);
+
+void fota_Delta_Init(fota_delta *delta, fota_delta_read read_Old,
+                     fota_delta_write write_New, void *ctx);
+
+uint8_t fota_Delta_Feed(fota_delta *delta, const uint8_t *data, size_t len);
+
+uint8_t fota_Delta_Finish(fota_delta *delta);
+
+#endif
@@ -19,8 +19,10 @@
 #include "freertos/task.h"
 
 #include "core.h"
+#include "esp_idf_version.h"
 #include "esp_system.h"
 #include "esp_timer.h"
+#include "input_debounce.h"
 #include "pcf85063.h"
 #include "rele.h"
 #include "routines.h"
@@ -31,6 +33,13 @@
 #include <string.h>
 #include <time.h>
 
+#include "soc/soc_caps.h"
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER &&                                      \
+    ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+#include "driver/gpio_filter.h"
+#define INPUT_GLITCH_FILTER 1
+#endif
+
 int debounce_Time_Input0;
 int debounce_Time_Input1;
 int debounce_Time_Input2;
@@ -50,6 +59,35 @@ extern SemaphoreHandle_t rdySem_Feedback_Call;
 
 static QueueHandle_t gpio_evt_queue = NULL;
 
+/* I1 e I2: a interrupcao so guarda a hora do flanco e acorda a tarefa,
+   que filtra (input_debounce.h) e avisa os subscritores */
+#define INPUT_COUNT 2
+
+static const gpio_num_t input_Pins[INPUT_COUNT] = {CONFIG_GPIO_INPUT_0,
+                                                   CONFIG_GPIO_INPUT_1};
+static input_debounce input_State[INPUT_COUNT];
+static volatile int64_t input_Edge_Time[INPUT_COUNT];
+static portMUX_TYPE input_Edge_Lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t input_Task_Handle = NULL;
+
+static input_subscriber input_Subscribers[INPUT_SUBSCRIBERS_MAX];
+static void *input_Subscribers_Ctx[INPUT_SUBSCRIBERS_MAX];
+static uint8_t input_Subscribers_Count = 0;
+
+static void IRAM_ATTR input_isr_handler(void *arg) {
+  uint32_t index = (uint32_t)arg;
+  BaseType_t woken = pdFALSE;
+
+  portENTER_CRITICAL_ISR(&input_Edge_Lock);
+  input_Edge_Time[index] = esp_timer_get_time();
+  portEXIT_CRITICAL_ISR(&input_Edge_Lock);
+
+  xTaskNotifyFromISR(input_Task_Handle, 1 << index, eSetBits, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+static void init_Inputs();
+
 static void IRAM_ATTR gpio_isr_handler(void *arg) {
   uint32_t gpio_num = (uint32_t)arg;
   // ////printf("GPIO[%d]\n", gpio_num);
@@ -80,14 +118,6 @@ uint8_t Input_GPIO_Debounce(uint32_t io_num) {
 
   switch (io_num) {
     ////////printf("GPIO[%d] intr, val: %d\n", io_num, input_nowState);
-  case CONFIG_GPIO_INPUT_0:
-
-    break;
-
-  case CONFIG_GPIO_INPUT_1:
-
-    break;
-
   case GPIO_INPUT_IO_EG91_STATUS:
 
     // ////printf("GPIO[%d] intr, val: %d\n", io_num, gpio_get_level(io_num));
@@ -157,7 +187,7 @@ uint8_t Input_GPIO_Debounce(uint32_t io_num) {
 
           // ////printf("\n\n ENTER SIM CARD INSERT123\n\n");
           if (gpio_get_level(GPIO_INPUT_IO_SIMPRE)) {
-            timer_pause(TIMER_GROUP_1, TIMER_0);
+            suspend_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
             ////////printf("\nsms or call %s\n", atcmd);
             // vTaskSuspend(xHandle_Timer_VerSystem);
             give_rdySem_Control_Send_AT_Command();
@@ -185,11 +215,11 @@ uint8_t Input_GPIO_Debounce(uint32_t io_num) {
                                  1000);
 
             // vTaskResume(xHandle_Timer_VerSystem);
-            timer_start(TIMER_GROUP_1, TIMER_0);
+            resume_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
           } else {
             RSSI_LED_TOOGLE = RSSI_NOT_DETECT;
             update_ACT_TimerVAlue((double)RSSI_NOT_DETECT);
-            save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 0, nvs_System_handle);
+            set_Runtime_QMTSTAT(0);
             // ////printf("\n\n ENTER SIM CARD INSERT4444\n\n");
 
             last_Input_SIMPRE = gpio_get_level(GPIO_INPUT_IO_SIMPRE);
@@ -289,6 +319,7 @@ void task_refresh_SystemTime(void *pvParameter) {
           gpio_get_level(GPIO_OUTPUT_IO_1) == 0 &&
           !gpio_get_level(CONFIG_GPIO_INPUT_0) == 0 &&
           !gpio_get_level(CONFIG_GPIO_INPUT_1) == 0) {
+        snapshot_Runtime_Status();
         esp_restart();
       } else {
         restartSystem_time = restartSystem_time + 100;
@@ -303,6 +334,10 @@ void task_refresh_SystemTime(void *pvParameter) {
       }
     }
 
+    if (nowTime.time == 0) {
+      refresh_Routine_Timeline();
+    }
+
     if (nowTime.time == 201) {
       if (gpio_get_level(GPIO_INPUT_IO_SIMPRE)) {
         // ////printf("\n\ntask_refresh_SystemTime 2\n\n");
@@ -322,9 +357,6 @@ void task_refresh_SystemTime(void *pvParameter) {
 
       cron_stop();
       cron_job_clear_all();
-      routines_ID = 0;
-      save_INT8_Data_In_Storage(NVS_ROUTINES_ID, routines_ID,
-                                nvs_System_handle);
       initRoutines();
     }
 
@@ -469,7 +501,6 @@ void gpio_init() {
   gpio_evt_queue = xQueueCreate(4, sizeof(uint32_t));
   // start gpio task
   xTaskCreate(gpio_task_example, "gpio_task_example", 8000, NULL, 21, NULL);
-  xTaskCreate(task_readInputs, "task_readInputs", 8048, NULL, 32, NULL);
   xTaskCreate(task_refresh_SystemTime, "task_refresh_SystemTime", 9000, NULL,
               15, NULL);
 
@@ -482,6 +513,8 @@ void gpio_init() {
   // // gpio_isr_handler_add(GPIO_INPUT_IO_1, gpio_isr_handler, (void
   // *)GPIO_INPUT_IO_1);
 
+  init_Inputs();
+
   gpio_isr_handler_add(GPIO_INPUT_IO_EG91_STATUS, gpio_isr_handler,
                        (void *)GPIO_INPUT_IO_EG91_STATUS);
 
@@ -501,340 +534,110 @@ void gpio_init() {
   // esp_get_minimum_free_heap_size());
 }
 
-#define TAG "BUTTON"
-
-typedef struct {
-  uint8_t pin;
-  bool inverted;
-  uint16_t history;
-  uint32_t down_time;
-  uint32_t next_long_time;
-} debounce_t;
-
-int pin_count = -1;
-debounce_t *debounce;
-QueueHandle_t queue;
-
-static void update_button(debounce_t *d) {
-  d->history = (d->history << 1) | gpio_get_level(d->pin);
-}
-
-#define MASK 0b1111000000111111
-static bool button_rose(debounce_t *d) {
-  if ((d->history & MASK) == 0b0000000000111111) {
-    d->history = 0xffff;
-    return 1;
+uint8_t subscribe_Input_Events(input_subscriber callback, void *ctx) {
+  if (callback == NULL || input_Subscribers_Count >= INPUT_SUBSCRIBERS_MAX) {
+    return 0;
   }
-  return 0;
-}
-static bool button_fell(debounce_t *d) {
-  if ((d->history & MASK) == 0b1111000000000000) {
-    d->history = 0x0000;
-    return 1;
-  }
-  return 0;
-}
-static bool button_down(debounce_t *d) {
-  if (d->inverted)
-    return button_fell(d);
-  return button_rose(d);
-}
-static bool button_up(debounce_t *d) {
-  if (d->inverted)
-    return button_rose(d);
-  return button_fell(d);
-}
 
-static uint32_t millis() { return esp_timer_get_time() / 1000; }
+  input_Subscribers_Ctx[input_Subscribers_Count] = ctx;
+  input_Subscribers[input_Subscribers_Count++] = callback;
 
-static void send_event(debounce_t db, int ev) {
-  /* button_event_t event = {
-      .pin = db.pin,
-      .event = ev,
-  };
-  xQueueSend(queue, &event, portMAX_DELAY); */
+  return 1;
 }
 
-static void button_task(void *pvParameter) {
-  for (;;) {
-    for (int idx = 0; idx < pin_count; idx++) {
-
-      update_button(&debounce[idx]);
-      if (button_up(&debounce[idx])) {
-        debounce[idx].down_time = 0;
-        // ESP_LOGI(TAG, "%d UP", debounce[idx].pin);
-        //  send_event(debounce[idx], BUTTON_UP);
-      } /*else if (debounce[idx].down_time && millis() >=
-      debounce[idx].next_long_time) {
-          //ESP_LOGI(TAG, "%d LONG", debounce[idx].pin);
-          debounce[idx].next_long_time = debounce[idx].next_long_time +
-      CONFIG_ESP32_BUTTON_LONG_PRESS_REPEAT_MS; send_event(debounce[idx],
-      BUTTON_HELD);
-      }*/
-      else if (button_down(&debounce[idx]) && debounce[idx].down_time == 0) {
-        debounce[idx].down_time = millis();
-        // ESP_LOGI(TAG, "%d DOWN", debounce[idx].pin);
-        debounce[idx].next_long_time =
-            debounce[idx].down_time +
-            CONFIG_ESP32_BUTTON_LONG_PRESS_DURATION_MS;
-        // send_event(debounce[idx], BUTTON_DOWN);
-      }
-    }
-    // ////printf("gpio input\n");
-    vTaskDelay(10 / portTICK_PERIOD_MS);
+/* nivel estavel (ja filtrado), 1 = entrada ativa */
+uint8_t get_Input_Level(uint8_t input) {
+  if (input < INPUT1_NUMBER || input > INPUT_COUNT) {
+    return 0;
   }
-}
 
-QueueHandle_t button_init(unsigned long long pin_select) {
-  return pulled_button_init(pin_select, GPIO_FLOATING);
+  return input_State[input - 1].level;
 }
 
-QueueHandle_t pulled_button_init(unsigned long long pin_select,
-                                 gpio_pull_mode_t pull_mode) {
-  if (pin_count != -1) {
-    // ESP_LOGI(TAG, "Already initialized");
-    return NULL;
-  }
-
-  // Configure the pins
-  gpio_config_t io_conf;
-  io_conf.intr_type = GPIO_INTR_POSEDGE;
-  io_conf.mode = GPIO_MODE_INPUT;
-  io_conf.pull_up_en =
-      (pull_mode == GPIO_PULLUP_ONLY || pull_mode == GPIO_PULLUP_PULLDOWN);
-  io_conf.pull_down_en =
-      (pull_mode == GPIO_PULLDOWN_ONLY || pull_mode == GPIO_PULLUP_PULLDOWN);
-  ;
-  io_conf.pin_bit_mask = pin_select;
-  gpio_config(&io_conf);
-
-  // Scan the pin map to determine number of pins
-  pin_count = 0;
-  for (int pin = 0; pin <= 39; pin++) {
-    if ((1ULL << pin) & pin_select) {
-      pin_count++;
-    }
-  }
-
-  // Initialize global state and queue
-  debounce = calloc(pin_count, sizeof(debounce_t));
-  // queue = xQueueCreate(CONFIG_ESP32_BUTTON_QUEUE_SIZE, sizeof(int));
-
-  // Scan the pin map to determine each pin number, populate the state
-  uint32_t idx = 0;
-  for (int pin = 0; pin <= 39; pin++) {
-    if ((1ULL << pin) & pin_select) {
-      // ESP_LOGI(TAG, "Registering button input: %d", pin);
-      debounce[idx].pin = pin;
-      debounce[idx].down_time = 0;
-      debounce[idx].inverted = true;
-      if (debounce[idx].inverted)
-        debounce[idx].history = 0xffff;
-      idx++;
-    }
-  }
+static void input_Notify_BLE(const input_event *event, void *ctx) {
+  char input_Data_IO[50] = {};
 
-  // Spawn a task to monitor the pins
-  xTaskCreate(&button_task, "button_task", CONFIG_ESP32_BUTTON_TASK_STACK_SIZE,
-              NULL, 10, NULL);
+  sprintf(input_Data_IO, "%s %d", "I1 G I", get_Input_Level(INPUT1_NUMBER));
+  BLE_Broadcast_Notify(input_Data_IO);
 
-  return queue;
+  memset(input_Data_IO, 0, sizeof(input_Data_IO));
+  sprintf(input_Data_IO, "%s %d", "I2 G I", get_Input_Level(INPUT2_NUMBER));
+  BLE_Broadcast_Notify(input_Data_IO);
 }
 
-/*************  ✨ Codeium Command 🌟  *************/
-void task_readInputs(void *pvParameter) {
-
-  uint8_t Input1_value = 0;
-  uint8_t Input2_value = 0;
-  uint8_t aux_Input1_value = 0;
-  uint8_t aux_Input2_value = 0;
-  uint8_t last_Input1_value = 0;
-  uint8_t last_Input2_value = 0;
-  uint8_t count_I1 = 0;
-  uint8_t count_I2 = 0;
-  uint8_t debounceCount = 0;
-  data_EG91_Send_SMS sms_Data;
-  memset(&sms_Data, 0, sizeof(sms_Data));
-
-  MyUser rexMyUser;
-  memset(&rexMyUser, 0, sizeof(rexMyUser));
-  sprintf(rexMyUser.firstName, "%s", "S/N");
-  // sprintf(rexMyUser.phone, "%s", number);
-  sprintf(rexMyUser.start.date, "%s","220101");
-  sprintf(rexMyUser.start.hour, "%s", "0000");
-  sprintf(rexMyUser.end.days, "%c", '*');
-  sprintf(rexMyUser.end.hour, "%s", "2359");
-  sprintf(rexMyUser.key, "%s", "REX");
-  sprintf(rexMyUser.week, "%s", "1111111");
-  rexMyUser.permition = '1';
-  rexMyUser.relayPermition = '0';
-  rexMyUser.ble_security = '0';
-  rexMyUser.erase_User_After_Date = '0';
-  rexMyUser.wiegand_code[0] = ':';
-  rexMyUser.wiegand_code[1] = 0;
-  rexMyUser.wiegand_rele_permition = ':';
-  rexMyUser.rf_serial[0] = ':';
-  rexMyUser.rf1_relay = ':';
-  rexMyUser.rf2_relay = ':';
-  // dsgaga
-  for (;;) {
-
-    Input1_value = !gpio_get_level(CONFIG_GPIO_INPUT_0);
-    Input2_value = !gpio_get_level(CONFIG_GPIO_INPUT_1);
-    debounceCount = 0;
+void task_Inputs(void *pvParameter) {
+  uint32_t edges = 0;
+  TickType_t wait = portMAX_DELAY;
 
-    while (debounceCount < 5) {
-      vTaskDelay(pdMS_TO_TICKS(10));
-      aux_Input1_value = !gpio_get_level(CONFIG_GPIO_INPUT_0);
-      aux_Input2_value = !gpio_get_level(CONFIG_GPIO_INPUT_1);
+  for (;;) {
+    edges = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &edges, wait);
 
-      // printf("\n\n aux_input1 %d, input1 %d - aux_input2 %d, input2 %d\n\n",
-      // aux_Input1_value, Input1_value, aux_Input2_value, Input2_value);
+    for (uint8_t i = 0; i < INPUT_COUNT; i++) {
+      if ((edges >> i) & 1) {
+        portENTER_CRITICAL(&input_Edge_Lock);
+        int64_t edge_us = input_Edge_Time[i];
+        portEXIT_CRITICAL(&input_Edge_Lock);
 
-      if (aux_Input1_value == Input1_value) {
-        count_I1++;
+        input_Debounce_Edge(&input_State[i], edge_us);
       }
-
-      if (aux_Input2_value == Input2_value) {
-        count_I2++;
-      }
-
-      debounceCount++;
     }
 
-    if (count_I1 == 5) {
-      Input1_value = aux_Input1_value;
-    } else {
-      Input1_value = last_Input1_value;
-      count_I1 = 0;
-      aux_Input1_value = last_Input1_value;
-    }
+    int64_t now = esp_timer_get_time();
+    int64_t next_us = -1;
 
-    if (count_I2 == 5) {
-      Input2_value = aux_Input2_value;
-    } else {
-      aux_Input2_value = last_Input2_value;
-      Input2_value = last_Input2_value;
-      count_I2 = 0;
-    }
+    for (uint8_t i = 0; i < INPUT_COUNT; i++) {
+      int64_t wait_us = input_Debounce_Wait(&input_State[i], now);
 
-    // printf("\n\n last input1 %d, input 1 %d - last input2 %d, input 2
-    // %d\n\n", last_Input1_value, Input1_value, last_Input2_value,
-    // Input2_value);
-    //  ////printf("\n\n last input1 %d, input 1 %d - last input2 %d, input 2
-    //  %d\n\n", last_Input1_value, Input1_value, last_Input2_value,
-    //  Input2_value);
-    /*  Input1_value = !gpio_get_level(CONFIG_GPIO_INPUT_0);
-         Input2_value = !gpio_get_level(CONFIG_GPIO_INPUT_1); */
+      if (wait_us == 0) {
+        if (input_Debounce_Settle(&input_State[i],
+                                  !gpio_get_level(input_Pins[i]), now)) {
+          input_event event = {
+              .input = i + 1,
+              .level = input_State[i].level,
+              .time_us = input_State[i].changed_us,
+          };
 
-    if (Input1_value != last_Input1_value ||
-        Input2_value != last_Input2_value) {
-      debounceCount = 0;
-      char input_Data_IO[50] = {};
-      sprintf(input_Data_IO, "%s %d", "I1 G I", Input1_value);
-      BLE_Broadcast_Notify(input_Data_IO);
+          ESP_LOGD("INPUTS", "I%d = %d", event.input, event.level);
 
-      printf("\n\nSent BLE Notify: %s\n", input_Data_IO);
-
-      memset(input_Data_IO, 0, 50);
-      sprintf(input_Data_IO, "%s %d", "I2 G I", Input2_value);
-      BLE_Broadcast_Notify(input_Data_IO);
-
-      printf("\n\nSent BLE Notify: %s\n", input_Data_IO);
-
-      /*  if (label_ResetSystem == 0)
-       {
-           if (Input1_value != last_Input1_value && Input2_value !=
-       last_Input2_value)
-           {
-
-               if (Input1_value == 0 && Input2_value == 0)
-               {
-                   printf("\n\ncount_ResetSystem\n\n");
-                   // ////printf("\n\ncount_ResetSystem\n\n");
-                   count_ResetSystem++;
-               }
-
-               if (count_ResetSystem == 2)
-               {
-                   label_Reset_Password_OR_System = 1;
-                   label_ResetSystem = 1;
-                   printf("\n\ncount_ResetSystem11\n\n");
-                   // ////printf("\n\ncount_ResetSystem11\n\n");
-                   example_tg_timer_deinit(TIMER_GROUP_0, TIMER_0);
-                   printf("\n\ncount_ResetSystem22\n\n");
-                   // ////printf("\n\ncount_ResetSystem22\n\n");
-                   example_tg_timer_init(TIMER_GROUP_0, TIMER_0, false, 60);
-                   printf("\n\ncount_ResetSystem33\n\n");
-                   // ////printf("\n\ncount_ResetSystem33\n\n");
-                   xTimerChangePeriod(xTimers, pdMS_TO_TICKS(1000), 100);
-                   printf("\n\ncount_ResetSystem44\n\n");
-                   // ////printf("\n\ncount_ResetSystem44\n\n");
-               }
-           }
-
-           printf("\n\n input 1 - %d / input 2 - %d\n\n", Input1_value,
-       Input2_value);
-           // ////printf("\n\n input 1 - %d / input 2 - %d\n\n", Input1_value,
-       Input2_value);
-       }
-       else if (label_ResetSystem == 1 && label_Reset_Password_OR_System == 2)
-       { */
-      uint8_t rex =
-          get_INT8_Data_From_Storage(NVS_INPUT_REX_VALUE, nvs_System_handle);
-      printf("\n\n aux_input1 123 %d\n\n", rex);
-      if (Input1_value != last_Input1_value) {
-
-        printf("\n\n aux_input1 124\n\n");
-        if (Input1_value == 1 && (rex == 1 || rex == 3)) {
-          printf("\n\n aux_input1 125\n\n");
-
-          /* sprintf(rexMyUser.phone, "%s", "REX");
-          sprintf(rexMyUser.key, "%s", "REX"); */
-          parse_ReleData(REX_INDICATION, RELE1_NUMBER, 'S', 'R', "REX", NULL,
-                         &rexMyUser, NULL, NULL, NULL, NULL, NULL);
-          // setReles(1, BLE_INDICATION, NULL, NULL, NULL, NULL, NULL);
-        }
-
-        if (label_network_portalRegister == 1) {
-          printf("\n\n aux_input1 126\n\n");
-          char input_Data_IO[50] = {};
-          sprintf(input_Data_IO, "%s %d", "& I1", Input1_value);
-          // TODO: DESCOMENTAR LINHA A BAIXO
-          //  send_UDP_Send(input_Data_IO,"");
+          for (uint8_t s = 0; s < input_Subscribers_Count; s++) {
+            input_Subscribers[s](&event, input_Subscribers_Ctx[s]);
+          }
         }
+      } else if (wait_us > 0 && (next_us < 0 || wait_us < next_us)) {
+        next_us = wait_us;
       }
+    }
 
-      if (Input2_value != last_Input2_value) {
-        // uint8_t rex =
-        // get_INT8_Data_From_Storage(NVS_INPUT_REX_VALUE, nvs_System_handle);
-        printf("\n\n aux_input1 124 \n\n");
-        if (Input2_value == 1 && (rex == 2 || rex == 3)) {
-          printf("\n\n aux_input1 125\n\n");
-          parse_ReleData(REX_INDICATION, RELE2_NUMBER, 'S', 'R', "REX", NULL,
-                         &rexMyUser, NULL, NULL, NULL, NULL, NULL);
-          // setReles(2, BLE_INDICATION, NULL, NULL, NULL, NULL, NULL);
-        }
+    wait = next_us < 0 ? portMAX_DELAY
+                       : pdMS_TO_TICKS((next_us + 999) / 1000) + 1;
+  }
+}
 
-        if (label_network_portalRegister == 1) {
-          printf("\n\n aux_input1 126\n\n");
-          char input_Data_IO[50] = {};
-          sprintf(input_Data_IO, "%s %d", "& I2", Input2_value);
-          // send_UDP_Send(input_Data_IO,"");
-        }
-      }
+static void init_Inputs() {
+  subscribe_Input_Events(input_Notify_BLE, NULL);
 
-      printf("\n\n input 1 - %d / input 2 - %d\n\n", Input1_value,
-             Input2_value);
-      // ////printf("\n\n input 1 - %d / input 2 - %d\n\n", Input1_value,
-      // Input2_value);
-      // }
+  for (uint32_t i = 0; i < INPUT_COUNT; i++) {
+#ifdef INPUT_GLITCH_FILTER
+    /* corta picos de poucos ciclos antes de chegarem a interrupcao */
+    gpio_glitch_filter_handle_t filter = NULL;
+    gpio_pin_glitch_filter_config_t filter_config = {
+        .clk_src = GLITCH_FILTER_CLK_SRC_DEFAULT,
+        .gpio_num = input_Pins[i],
+    };
+
+    if (gpio_new_pin_glitch_filter(&filter_config, &filter) == ESP_OK) {
+      gpio_glitch_filter_enable(filter);
     }
+#endif
+
+    input_Debounce_Init(&input_State[i], !gpio_get_level(input_Pins[i]),
+                        INPUT_DEBOUNCE_MS * 1000);
+  }
 
-    last_Input2_value = Input2_value;
-    last_Input1_value = Input1_value;
+  xTaskCreate(task_Inputs, "task_Inputs", 8048, NULL, 21, &input_Task_Handle);
 
-    vTaskDelay(pdMS_TO_TICKS(10));
+  for (uint32_t i = 0; i < INPUT_COUNT; i++) {
+    gpio_isr_handler_add(input_Pins[i], input_isr_handler, (void *)i);
   }
 }
-/******  4afe1a66-2936-4aba-8bd1-f871c51979c8  *******/
\ No newline at end of file
@@ -83,21 +83,9 @@
 
 #define INPUT_GPIO_TIME_DEBOUNCE 100
 
-#ifndef CONFIG_ESP32_BUTTON_LONG_PRESS_DURATION_MS
-#define CONFIG_ESP32_BUTTON_LONG_PRESS_DURATION_MS (2000)
-#endif
-
-#ifndef CONFIG_ESP32_BUTTON_LONG_PRESS_REPEAT_MS
-#define CONFIG_ESP32_BUTTON_LONG_PRESS_REPEAT_MS (50)
-#endif
-
-#ifndef CONFIG_ESP32_BUTTON_QUEUE_SIZE
-#define CONFIG_ESP32_BUTTON_QUEUE_SIZE (4)
-#endif
-
-#ifndef CONFIG_ESP32_BUTTON_TASK_STACK_SIZE
-#define CONFIG_ESP32_BUTTON_TASK_STACK_SIZE 3072
-#endif
+/* I1 e I2: tempo sem flancos para aceitar um nivel (input_debounce.h) */
+#define INPUT_DEBOUNCE_MS 50
+#define INPUT_SUBSCRIBERS_MAX 4
 
 #ifdef __cplusplus
 extern "C"
@@ -106,10 +94,6 @@ extern "C"
 
 #define PIN_BIT(x) (1ULL << x)
 
-#define BUTTON_DOWN (1)
-#define BUTTON_UP (2)
-#define BUTTON_HELD (3)
-
 #define NBIT                65 // number of bit to receive -1
 #define NBIT_12BIT          13 // number of bit to receive -1
 #define TRFreset            0
@@ -149,14 +133,23 @@ extern "C"
 
 
 
-/*   typedef struct
+  /* mudanca de I1 ou I2 ja filtrada, time_us e a hora do primeiro flanco */
+  typedef struct
   {
-    uint8_t pin;
-    uint8_t event;
-  } button_event_t; */
+    uint8_t input;
+    uint8_t level;
+    int64_t time_us;
+
+  } input_event;
+
+  typedef void (*input_subscriber)(const input_event *event, void *ctx);
+
+  /* so no arranque, nao ha remocao; os callbacks correm na tarefa das
+     entradas */
+  uint8_t subscribe_Input_Events(input_subscriber callback, void *ctx);
+
+  uint8_t get_Input_Level(uint8_t input);
 
-  QueueHandle_t button_init(unsigned long long pin_select);
-  QueueHandle_t pulled_button_init(unsigned long long pin_select, gpio_pull_mode_t pull_mode);
   static SemaphoreHandle_t rdySem_Control_refreshSystemTime_task;
 
   uint8_t Input_GPIO_Debounce(uint32_t io_num);
@@ -167,7 +160,7 @@ extern "C"
 
   void task_refresh_SystemTime(void *pvParameter);
 
-   void task_readInputs(void *pvParameter);
+  void task_Inputs(void *pvParameter);
 
 
 void input1_Alarme_Feedbacks_processing(uint8_t inputLevel);
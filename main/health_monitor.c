@@ -0,0 +1,197 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "health_monitor.h"
+#include <stdio.h>
+#include <string.h>
+
+uint8_t health_Check(const health_metrics *metrics,
+                     const health_thresholds *thresholds) {
+  uint8_t breaches = 0;
+
+  if (metrics->heap_free < thresholds->heap_free_min) {
+    breaches |= HEALTH_BREACH_HEAP;
+  }
+
+  if (metrics->heap_largest < thresholds->heap_block_min) {
+    breaches |= HEALTH_BREACH_HEAP_BLOCK;
+  }
+
+  for (uint8_t i = 0; i < metrics->tasks && i < HEALTH_TASKS_MAX; i++) {
+    if (metrics->stack_free[i] < thresholds->stack_free_min) {
+      breaches |= HEALTH_BREACH_STACK;
+    }
+  }
+
+  /* fila cheia: quem escreve ja esta a bloquear ou a perder mensagens */
+  for (uint8_t i = 0; i < metrics->queues && i < HEALTH_QUEUES_MAX; i++) {
+    if (metrics->queue_space[i] == 0 && metrics->queue_depth[i] != 0) {
+      breaches |= HEALTH_BREACH_QUEUE;
+    }
+  }
+
+  if (metrics->sim_present && (!metrics->modem_on || !metrics->network_ok)) {
+    breaches |= HEALTH_BREACH_MODEM;
+  }
+
+  if (metrics->sim_present && metrics->qmtstat != 0 && !metrics->busy) {
+    breaches |= HEALTH_BREACH_MQTT;
+  }
+
+  return breaches;
+}
+
+uint8_t health_Worst_Stack(const health_metrics *metrics) {
+  uint8_t worst = 0xFF;
+
+  for (uint8_t i = 0; i < metrics->tasks && i < HEALTH_TASKS_MAX; i++) {
+    if (worst == 0xFF || metrics->stack_free[i] < metrics->stack_free[worst]) {
+      worst = i;
+    }
+  }
+
+  return worst;
+}
+
+int health_Format(const health_metrics *metrics, uint8_t breaches,
+                  health_state state, char *out, size_t size) {
+  char queues[HEALTH_QUEUES_MAX * 8 + 1] = {0};
+  size_t used = 0;
+  uint8_t worst = health_Worst_Stack(metrics);
+
+  for (uint8_t i = 0; i < metrics->queues && i < HEALTH_QUEUES_MAX; i++) {
+    used += snprintf(queues + used, sizeof(queues) - used, "%s%u:%u",
+                     i ? "/" : "", metrics->queue_depth[i],
+                     metrics->queue_space[i]);
+  }
+
+  return snprintf(
+      out, size, "%lu.%lu.%lu.%lu.%u@%u.%s.%u%u%u%u.%d.%u.%u.%lu.%lu.%02X.%u",
+      (unsigned long)metrics->uptime_s, (unsigned long)metrics->heap_free,
+      (unsigned long)metrics->heap_min, (unsigned long)metrics->heap_largest,
+      worst == 0xFF ? 0 : metrics->stack_free[worst],
+      worst == 0xFF ? 0 : worst, queues, metrics->sim_present != 0,
+      metrics->modem_on != 0, metrics->sim_ready != 0,
+      metrics->network_ok != 0, metrics->rssi, metrics->qmtstat,
+      metrics->mqtt_connected != 0, (unsigned long)metrics->nvs_writes,
+      (unsigned long)metrics->journal_writes_hour, breaches, state);
+}
+
+void health_Recovery_Init(health_recovery *recovery) {
+  memset(recovery, 0, sizeof(health_recovery));
+}
+
+static health_action mqtt_Action(uint8_t qmtstat) {
+  switch (qmtstat) {
+  case 1:
+  case 6:
+  case 8:
+    return HEALTH_ACTION_MQTT_OPEN;
+
+  case 2:
+    return HEALTH_ACTION_MODEM_RESET;
+
+  case 4:
+    return HEALTH_ACTION_MQTT_REOPEN;
+
+  default:
+    return HEALTH_ACTION_NONE;
+  }
+}
+
+health_action health_Recovery_Step(health_recovery *recovery,
+                                   const health_metrics *metrics) {
+  if (metrics->busy) {
+    return HEALTH_ACTION_NONE;
+  }
+
+  if (!metrics->sim_present) {
+    health_Recovery_Init(recovery);
+    return HEALTH_ACTION_NO_SIM;
+  }
+
+  if (!metrics->modem_on) {
+    recovery->state = HEALTH_STATE_MODEM_POWER_ON;
+    return HEALTH_ACTION_MODEM_POWER_ON;
+  }
+
+  switch (recovery->state) {
+  case HEALTH_STATE_MODEM_POWER_ON:
+    recovery->state = HEALTH_STATE_MODEM_INIT_NETWORK;
+    recovery->attempts = 0;
+    return HEALTH_ACTION_MODEM_INIT_NETWORK;
+
+  case HEALTH_STATE_MODEM_INIT_NETWORK:
+    return HEALTH_ACTION_MODEM_INIT_NETWORK;
+
+  case HEALTH_STATE_NETWORK_FAILED:
+    recovery->state = HEALTH_STATE_IDLE;
+
+    if (++recovery->network_fails > HEALTH_NETWORK_FAILS) {
+      recovery->network_fails = 0;
+      return HEALTH_ACTION_MODEM_RESET;
+    }
+    return HEALTH_ACTION_SIGNAL_WEAK;
+
+  default:
+    break;
+  }
+
+  if (!metrics->sim_ready) {
+    return HEALTH_ACTION_PROBE_SIM;
+  }
+
+  if (metrics->qmtstat == 0) {
+    recovery->mqtt_ticks = 0;
+  } else if (++recovery->mqtt_ticks > HEALTH_MQTT_TICKS) {
+    recovery->mqtt_ticks = 0;
+
+    if (mqtt_Action(metrics->qmtstat) != HEALTH_ACTION_NONE) {
+      return mqtt_Action(metrics->qmtstat);
+    }
+  }
+
+  return HEALTH_ACTION_PROBE_NETWORK;
+}
+
+void health_Recovery_Result(health_recovery *recovery, health_action action,
+                            uint8_t ok) {
+  switch (action) {
+  case HEALTH_ACTION_MODEM_INIT_NETWORK:
+    if (ok || ++recovery->attempts >= HEALTH_INIT_NETWORK_ATTEMPTS) {
+      recovery->state = HEALTH_STATE_IDLE;
+      recovery->recoveries += ok;
+    }
+    break;
+
+  case HEALTH_ACTION_PROBE_NETWORK:
+    if (ok) {
+      recovery->network_fails = 0;
+    } else {
+      recovery->state = HEALTH_STATE_NETWORK_FAILED;
+    }
+    break;
+
+  case HEALTH_ACTION_MODEM_RESET:
+    recovery->network_fails = 0;
+    recovery->mqtt_ticks = 0;
+    recovery->state = HEALTH_STATE_IDLE;
+    recovery->recoveries++;
+    break;
+
+  case HEALTH_ACTION_MQTT_OPEN:
+  case HEALTH_ACTION_MQTT_REOPEN:
+    recovery->recoveries += ok;
+    break;
+
+  default:
+    break;
+  }
+}
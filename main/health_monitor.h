@@ -0,0 +1,138 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _HEALTH_MONITOR_H_
+#define _HEALTH_MONITOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Estado do equipamento numa estrutura de tamanho fixo, preenchida a cada
+ * tick so com leituras de RAM (heap, marcas de pilha, niveis das filas,
+ * estado do modem e do MQTT ja guardados por quem os atualiza). Os limites
+ * dao uma mascara de alarmes; so se publica quando aparece um alarme novo
+ * ou a pedido.
+ *
+ * A recuperacao e uma maquina de estados: cada tick devolve no maximo uma
+ * acao (ligar o modem, abrir o MQTT, ...), o chamador executa-a e devolve
+ * o resultado. Nao ha ciclos nem esperas aqui; as tentativas seguintes
+ * ficam para os ticks seguintes.
+ *
+ * O modulo nao depende de ESP-IDF nem de FreeRTOS.
+ */
+
+#define HEALTH_TASKS_MAX 8
+#define HEALTH_QUEUES_MAX 6
+
+/* ticks seguidos com o MQTT em erro antes de tentar repor */
+#define HEALTH_MQTT_TICKS 3
+/* falhas de rede seguidas antes de reiniciar o modem */
+#define HEALTH_NETWORK_FAILS 3
+#define HEALTH_INIT_NETWORK_ATTEMPTS 3
+
+#define HEALTH_BREACH_HEAP (1 << 0)
+#define HEALTH_BREACH_HEAP_BLOCK (1 << 1)
+#define HEALTH_BREACH_STACK (1 << 2)
+#define HEALTH_BREACH_QUEUE (1 << 3)
+#define HEALTH_BREACH_MODEM (1 << 4)
+#define HEALTH_BREACH_MQTT (1 << 5)
+
+typedef struct
+{
+  uint32_t uptime_s;
+  uint32_t heap_free;
+  uint32_t heap_min;
+  uint32_t heap_largest;
+  /* bytes livres na pior altura de cada tarefa vigiada */
+  uint16_t stack_free[HEALTH_TASKS_MAX];
+  uint8_t tasks;
+  uint8_t queue_depth[HEALTH_QUEUES_MAX];
+  uint8_t queue_space[HEALTH_QUEUES_MAX];
+  uint8_t queues;
+  uint8_t sim_present;
+  uint8_t modem_on;
+  uint8_t sim_ready;
+  /* resultado da ultima verificacao de rede */
+  uint8_t network_ok;
+  int16_t rssi;
+  uint8_t qmtstat;
+  uint8_t mqtt_connected;
+  /* transferencia grande em curso, sem recuperacao */
+  uint8_t busy;
+  uint32_t nvs_writes;
+  uint32_t journal_writes_hour;
+
+} health_metrics;
+
+typedef struct
+{
+  uint32_t heap_free_min;
+  uint32_t heap_block_min;
+  uint16_t stack_free_min;
+
+} health_thresholds;
+
+typedef enum
+{
+  HEALTH_STATE_IDLE,
+  HEALTH_STATE_MODEM_POWER_ON,
+  HEALTH_STATE_MODEM_INIT_NETWORK,
+  HEALTH_STATE_NETWORK_FAILED,
+
+} health_state;
+
+typedef enum
+{
+  HEALTH_ACTION_NONE,
+  HEALTH_ACTION_NO_SIM,
+  HEALTH_ACTION_MODEM_POWER_ON,
+  HEALTH_ACTION_MODEM_INIT_NETWORK,
+  HEALTH_ACTION_MODEM_RESET,
+  HEALTH_ACTION_PROBE_SIM,
+  HEALTH_ACTION_PROBE_NETWORK,
+  HEALTH_ACTION_SIGNAL_WEAK,
+  HEALTH_ACTION_MQTT_OPEN,
+  HEALTH_ACTION_MQTT_REOPEN,
+
+} health_action;
+
+typedef struct
+{
+  health_state state;
+  uint8_t attempts;
+  uint8_t mqtt_ticks;
+  uint8_t network_fails;
+  uint32_t recoveries;
+
+} health_recovery;
+
+uint8_t health_Check(const health_metrics *metrics,
+                     const health_thresholds *thresholds);
+
+/* indice da tarefa com menos pilha livre, 0xFF se nao ha tarefas */
+uint8_t health_Worst_Stack(const health_metrics *metrics);
+
+/* linha "<uptime>.<heap>.<min>.<bloco>.<pilha>@<tarefa>.<filas>.<modem>.
+   <rssi>.<qmtstat>.<mqtt>.<nvs>.<diario>.<alarmes>.<estado>", as filas
+   como ocupadas:livres separadas por '/' e o modem como 4 digitos (SIM,
+   ligado, PIN, rede); devolve o tamanho como o snprintf */
+int health_Format(const health_metrics *metrics, uint8_t breaches,
+                  health_state state, char *out, size_t size);
+
+void health_Recovery_Init(health_recovery *recovery);
+
+health_action health_Recovery_Step(health_recovery *recovery,
+                                   const health_metrics *metrics);
+
+void health_Recovery_Result(health_recovery *recovery, health_action action,
+                            uint8_t ok);
+
+#endif
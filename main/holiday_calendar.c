@@ -0,0 +1,196 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "holiday_calendar.h"
+#include <string.h>
+
+#define FIXED(month, day) {HOLIDAY_RULE_FIXED, month, day, 0, 0}
+#define EASTER(offset) {HOLIDAY_RULE_EASTER, 0, 0, 0, offset}
+#define NTH(month, nth, weekday) {HOLIDAY_RULE_NTH_WEEKDAY, month, nth, weekday, 0}
+
+static const holiday_rule holiday_rules_PT[] = {
+    EASTER(-47), /* Carnaval */
+    EASTER(-2),  /* Sexta-feira Santa */
+    EASTER(0),   /* Pascoa */
+    EASTER(60),  /* Corpo de Deus */
+    EASTER(1),   /* Segunda-feira de Pascoa */
+    FIXED(1, 1),   FIXED(4, 25),  FIXED(5, 1),  FIXED(6, 10),
+    FIXED(8, 15),  FIXED(10, 5),  FIXED(11, 1), FIXED(12, 1),
+    FIXED(12, 8),  FIXED(12, 25),
+};
+
+static const holiday_rule holiday_rules_ES[] = {
+    EASTER(-2),   /* Viernes Santo */
+    EASTER(1),    /* Lunes de Pascua */
+    EASTER(-3),   /* Jueves Santo */
+    FIXED(1, 1),  FIXED(1, 6),   FIXED(5, 1),  FIXED(8, 15),
+    FIXED(10, 12), FIXED(11, 1), FIXED(12, 6), FIXED(12, 8),
+    FIXED(12, 25),
+};
+
+static const holiday_rule holiday_rules_FR[] = {
+    EASTER(1),    /* Lundi de Paques */
+    EASTER(39),   /* Ascension */
+    EASTER(50),   /* Lundi de Pentecote */
+    FIXED(1, 1),  FIXED(5, 1),   FIXED(5, 8),  FIXED(7, 14),
+    FIXED(8, 15), FIXED(11, 1),  FIXED(11, 11), FIXED(12, 25),
+};
+
+static const holiday_rule holiday_rules_US[] = {
+    NTH(1, 3, 1),            /* Martin Luther King Jr. Day */
+    NTH(2, 3, 1),            /* Presidents' Day */
+    NTH(5, HOLIDAY_LAST, 1), /* Memorial Day */
+    NTH(9, 1, 1),            /* Labor Day */
+    NTH(10, 2, 1),           /* Columbus Day */
+    NTH(11, 4, 4),           /* Thanksgiving */
+    FIXED(1, 1),  FIXED(6, 19),  FIXED(7, 4),  FIXED(11, 11),
+    FIXED(12, 25),
+};
+
+#define PACK(country, rules) {country, rules, sizeof(rules) / sizeof(rules[0])}
+
+static const holiday_pack holiday_packs[] = {
+    PACK("PT", holiday_rules_PT),
+    PACK("ES", holiday_rules_ES),
+    PACK("FR", holiday_rules_FR),
+    PACK("US", holiday_rules_US),
+};
+
+static const uint16_t days_before_month[12] = {0,   31,  59,  90,  120, 151,
+                                               181, 212, 243, 273, 304, 334};
+
+static uint8_t is_Leap(int year) {
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static int days_In_Month(int year, int month) {
+  if (month == 12) {
+    return 31;
+  }
+
+  return days_before_month[month] - days_before_month[month - 1] +
+         (month == 2 && is_Leap(year));
+}
+
+/* 0 = domingo */
+static int week_Day(int year, int month, int mday) {
+  static const uint8_t offset[12] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
+
+  if (month < 3) {
+    year--;
+  }
+
+  return (year + year / 4 - year / 100 + year / 400 + offset[month - 1] +
+          mday) %
+         7;
+}
+
+const holiday_pack *holiday_Find_Pack(const char *country) {
+  for (uint8_t i = 0; i < sizeof(holiday_packs) / sizeof(holiday_packs[0]);
+       i++) {
+    if (!strcmp(holiday_packs[i].country, country)) {
+      return &holiday_packs[i];
+    }
+  }
+
+  return NULL;
+}
+
+/* algoritmo de Meeus/Jones/Butcher, calendario gregoriano */
+void holiday_Easter(int year, int *month, int *mday) {
+  int a = year % 19;
+  int b = year / 100;
+  int c = year % 100;
+  int d = b / 4;
+  int e = b % 4;
+  int f = (b + 8) / 25;
+  int g = (b - f + 1) / 3;
+  int h = (19 * a + b - d - g + 15) % 30;
+  int i = c / 4;
+  int k = c % 4;
+  int l = (32 + 2 * e + 2 * i - h - k) % 7;
+  int m = (a + 11 * h + 22 * l) / 451;
+
+  *month = (h + l - 7 * m + 114) / 31;
+  *mday = (h + l - 7 * m + 114) % 31 + 1;
+}
+
+/* 0 = 1 de janeiro */
+int holiday_Day_Of_Year(int year, int month, int mday) {
+  return days_before_month[month - 1] + (month > 2 && is_Leap(year)) + mday -
+         1;
+}
+
+/* dia do ano da regra, -1 se nesse ano nao existe */
+int holiday_Rule_Day(const holiday_rule *rule, int year) {
+  int month = 0;
+  int mday = 0;
+  int day = 0;
+
+  switch (rule->type) {
+  case HOLIDAY_RULE_FIXED:
+    if (rule->month < 1 || rule->month > 12 || rule->day < 1 ||
+        rule->day > days_In_Month(year, rule->month)) {
+      return -1;
+    }
+    return holiday_Day_Of_Year(year, rule->month, rule->day);
+
+  case HOLIDAY_RULE_EASTER:
+    holiday_Easter(year, &month, &mday);
+    day = holiday_Day_Of_Year(year, month, mday) + rule->offset;
+    return day >= 0 && day < 365 + is_Leap(year) ? day : -1;
+
+  case HOLIDAY_RULE_NTH_WEEKDAY:
+    if (rule->month < 1 || rule->month > 12 || rule->weekday > 6) {
+      return -1;
+    }
+
+    if (rule->day == HOLIDAY_LAST) {
+      mday = days_In_Month(year, rule->month);
+      mday -= (week_Day(year, rule->month, mday) - rule->weekday + 7) % 7;
+    } else {
+      mday = 1 + (rule->weekday - week_Day(year, rule->month, 1) + 7) % 7 +
+             (rule->day - 1) * 7;
+
+      if (rule->day < 1 || mday > days_In_Month(year, rule->month)) {
+        return -1;
+      }
+    }
+    return holiday_Day_Of_Year(year, rule->month, mday);
+
+  default:
+    return -1;
+  }
+}
+
+void holiday_Compile_Year(holiday_year *holidays, const holiday_pack *pack,
+                          uint32_t mask, int year) {
+  memset(holidays, 0, sizeof(holiday_year));
+  holidays->year = year;
+
+  for (uint8_t i = 0; pack != NULL && i < pack->count && i < HOLIDAY_RULES_MAX;
+       i++) {
+    int day = (mask >> i) & 1 ? holiday_Rule_Day(&pack->rules[i], year) : -1;
+
+    if (day >= 0) {
+      holidays->days[day / 8] |= 1 << (day % 8);
+    }
+  }
+}
+
+uint8_t holiday_Is_Holiday(const holiday_year *holidays, const struct tm *day) {
+  if (day->tm_year + 1900 != holidays->year) {
+    return 0;
+  }
+
+  int yday = holiday_Day_Of_Year(holidays->year, day->tm_mon + 1, day->tm_mday);
+
+  return (holidays->days[yday / 8] >> (yday % 8)) & 1;
+}
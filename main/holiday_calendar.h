@@ -0,0 +1,85 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _HOLIDAY_CALENDAR_H_
+#define _HOLIDAY_CALENDAR_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Feriados por regras. Cada pais tem uma tabela de regras (data fixa,
+ * dias a contar da Pascoa ou n-esimo dia da semana de um mes) e a
+ * configuracao escolhe quais estao ligadas com uma mascara, bit N = regra
+ * N da tabela. Para cada ano as regras ligadas sao compiladas num mapa de
+ * bits com um bit por dia do ano, assim saber se um dia e feriado e testar
+ * um bit.
+ *
+ * Na tabela PT as cinco primeiras regras sao os feriados moveis do RT S H,
+ * pela mesma ordem dos bits CARNIVAL_HOLYDAY_DAY .. EASTER_MONDAY_HOLYDAY_DAY.
+ *
+ * O modulo nao depende de NVS nem de FreeRTOS.
+ */
+
+#define HOLIDAY_RULE_FIXED 0
+#define HOLIDAY_RULE_EASTER 1
+#define HOLIDAY_RULE_NTH_WEEKDAY 2
+
+/* n-esimo dia da semana: ultimo do mes */
+#define HOLIDAY_LAST -1
+
+#define HOLIDAY_RULES_MAX 32
+#define HOLIDAY_YEAR_BYTES ((366 + 7) / 8)
+#define HOLIDAY_COUNTRY_SIZE 3
+#define HOLIDAY_DEFAULT_COUNTRY "PT"
+
+typedef struct
+{
+  uint8_t type;
+  /* FIXED e NTH_WEEKDAY: mes de 1 a 12 */
+  uint8_t month;
+  /* FIXED: dia do mes, NTH_WEEKDAY: 1 a 5 ou HOLIDAY_LAST */
+  int8_t day;
+  /* NTH_WEEKDAY: 0 = domingo */
+  uint8_t weekday;
+  /* EASTER: dias depois (ou antes) do domingo de Pascoa */
+  int16_t offset;
+
+} holiday_rule;
+
+typedef struct
+{
+  const char *country;
+  const holiday_rule *rules;
+  uint8_t count;
+
+} holiday_pack;
+
+typedef struct
+{
+  uint16_t year;
+  uint8_t days[HOLIDAY_YEAR_BYTES];
+
+} holiday_year;
+
+const holiday_pack *holiday_Find_Pack(const char *country);
+
+void holiday_Easter(int year, int *month, int *mday);
+
+int holiday_Day_Of_Year(int year, int month, int mday);
+
+int holiday_Rule_Day(const holiday_rule *rule, int year);
+
+void holiday_Compile_Year(holiday_year *holidays, const holiday_pack *pack,
+                          uint32_t mask, int year);
+
+uint8_t holiday_Is_Holiday(const holiday_year *holidays, const struct tm *day);
+
+#endif
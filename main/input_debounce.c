@@ -0,0 +1,60 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "input_debounce.h"
+
+void input_Debounce_Init(input_debounce *input, uint8_t level,
+                         uint32_t debounce_us) {
+  input->level = level;
+  input->state = INPUT_DEBOUNCE_IDLE;
+  input->first_edge_us = 0;
+  input->last_edge_us = 0;
+  input->changed_us = 0;
+  input->debounce_us = debounce_us;
+  input->glitches = 0;
+}
+
+void input_Debounce_Edge(input_debounce *input, int64_t now_us) {
+  if (input->state == INPUT_DEBOUNCE_IDLE) {
+    input->state = INPUT_DEBOUNCE_SETTLING;
+    input->first_edge_us = now_us;
+  }
+
+  input->last_edge_us = now_us;
+}
+
+int64_t input_Debounce_Wait(const input_debounce *input, int64_t now_us) {
+  int64_t wait = 0;
+
+  if (input->state == INPUT_DEBOUNCE_IDLE) {
+    return -1;
+  }
+
+  wait = input->last_edge_us + input->debounce_us - now_us;
+  return wait > 0 ? wait : 0;
+}
+
+uint8_t input_Debounce_Settle(input_debounce *input, uint8_t level,
+                              int64_t now_us) {
+  if (input_Debounce_Wait(input, now_us) != 0) {
+    return 0;
+  }
+
+  input->state = INPUT_DEBOUNCE_IDLE;
+
+  if (level == input->level) {
+    input->glitches++;
+    return 0;
+  }
+
+  input->level = level;
+  input->changed_us = input->first_edge_us;
+  return 1;
+}
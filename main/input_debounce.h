@@ -0,0 +1,54 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _INPUT_DEBOUNCE_H_
+#define _INPUT_DEBOUNCE_H_
+
+#include <stdint.h>
+
+/*
+ * Filtro de uma entrada digital por tempo: cada flanco (visto na
+ * interrupcao) recomeca a contagem e o nivel so e lido quando a linha fica
+ * debounce_us sem mexer. Se for diferente do estado estavel ha mudanca,
+ * com a hora do primeiro flanco da rajada; se a linha voltou ao mesmo
+ * nivel conta como glitch. Sem flancos nao ha nada a fazer, o chamador
+ * dorme ate input_Debounce_Wait.
+ *
+ * O modulo nao depende de ESP-IDF nem de FreeRTOS.
+ */
+
+#define INPUT_DEBOUNCE_IDLE 0
+#define INPUT_DEBOUNCE_SETTLING 1
+
+typedef struct
+{
+  uint8_t level;
+  uint8_t state;
+  int64_t first_edge_us;
+  int64_t last_edge_us;
+  int64_t changed_us;
+  uint32_t debounce_us;
+  uint32_t glitches;
+
+} input_debounce;
+
+void input_Debounce_Init(input_debounce *input, uint8_t level,
+                         uint32_t debounce_us);
+
+void input_Debounce_Edge(input_debounce *input, int64_t now_us);
+
+/* us ate a linha poder ser lida, 0 se ja pode, -1 se nao ha flancos */
+int64_t input_Debounce_Wait(const input_debounce *input, int64_t now_us);
+
+/* le o nivel quando input_Debounce_Wait da 0, 1 se o estado mudou */
+uint8_t input_Debounce_Settle(input_debounce *input, uint8_t level,
+                              int64_t now_us);
+
+#endif
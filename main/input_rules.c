@@ -0,0 +1,344 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "input_rules.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MINUTES_PER_DAY 1440
+
+/* copia o campo ate '.', ';' ou fim; so avanca sobre o '.' */
+static uint8_t parse_Field(const char **cursor, char *field, size_t size) {
+  size_t length = 0;
+
+  while (**cursor != 0 && **cursor != '.' && **cursor != ';') {
+    if (length + 1 >= size) {
+      return 0;
+    }
+    field[length++] = *(*cursor)++;
+  }
+
+  field[length] = 0;
+
+  if (**cursor == '.') {
+    (*cursor)++;
+  }
+
+  return 1;
+}
+
+static uint8_t field_Is_Any(const char *field) {
+  return field[0] == 0 || !strcmp(field, "*");
+}
+
+static uint8_t parse_Digits(const char *text, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (text[i] < '0' || text[i] > '9') {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static uint8_t parse_Minute(const char *field, uint16_t *minute) {
+  if (strlen(field) != 4 || !parse_Digits(field, 4)) {
+    return 0;
+  }
+
+  int hour = (field[0] - '0') * 10 + field[1] - '0';
+  int min = (field[2] - '0') * 10 + field[3] - '0';
+
+  if (hour > 23 || min > 59) {
+    return 0;
+  }
+
+  *minute = hour * 60 + min;
+  return 1;
+}
+
+static uint8_t parse_Relay(char relay, uint8_t *number) {
+  if (relay != '1' && relay != '2') {
+    return 0;
+  }
+
+  *number = relay - '0';
+  return 1;
+}
+
+static uint8_t parse_Actions(char *field, input_rule *rule) {
+  char *token = field;
+
+  while (token != NULL) {
+    char *next = strchr(token, '+');
+
+    if (next != NULL) {
+      *next++ = 0;
+    }
+
+    switch (token[0]) {
+    case 'P': {
+      char *end = NULL;
+
+      if (!parse_Relay(token[1], &rule->pulse_relay) || token[2] != ':' ||
+          !parse_Digits(token + 3, 1)) {
+        return 0;
+      }
+
+      rule->pulse_ms = strtoul(token + 3, &end, 10);
+
+      if (*end != 0 || rule->pulse_ms == 0) {
+        return 0;
+      }
+      rule->actions |= INPUT_RULE_ACTION_PULSE;
+      break;
+    }
+
+    case 'X':
+      if (!parse_Relay(token[1], &rule->rex_relay) || token[2] != 0) {
+        return 0;
+      }
+      rule->actions |= INPUT_RULE_ACTION_REX;
+      break;
+
+    case 'S':
+      if (token[1] == 0) {
+        return 0;
+      }
+
+      for (char *slot = token + 1; *slot != 0; slot++) {
+        if (*slot < '1' || *slot > '0' + INPUT_RULES_SMS_SLOTS) {
+          return 0;
+        }
+        rule->sms_slots |= 1 << (*slot - '1');
+      }
+      rule->actions |= INPUT_RULE_ACTION_SMS;
+      break;
+
+    case 'M':
+    case 'B':
+      if (token[1] != 0) {
+        return 0;
+      }
+      rule->actions |=
+          token[0] == 'M' ? INPUT_RULE_ACTION_MQTT : INPUT_RULE_ACTION_SOUND;
+      break;
+
+    default:
+      return 0;
+    }
+
+    token = next;
+  }
+
+  return 1;
+}
+
+static uint8_t parse_Rule(const char **cursor, input_rule *rule) {
+  char field[48];
+
+  memset(rule, 0, sizeof(input_rule));
+
+  if (!parse_Field(cursor, field, sizeof(field)) || strlen(field) != 1 ||
+      field[0] < '1' || field[0] > '0' + INPUT_RULES_INPUTS) {
+    return 0;
+  }
+  rule->input = field[0] - '0';
+
+  if (!parse_Field(cursor, field, sizeof(field))) {
+    return 0;
+  }
+
+  if (field_Is_Any(field) || !strcmp(field, "A")) {
+    rule->edges = INPUT_RULE_EDGE_RISE | INPUT_RULE_EDGE_FALL;
+  } else if (!strcmp(field, "R")) {
+    rule->edges = INPUT_RULE_EDGE_RISE;
+  } else if (!strcmp(field, "F")) {
+    rule->edges = INPUT_RULE_EDGE_FALL;
+  } else {
+    return 0;
+  }
+
+  rule->to_min = MINUTES_PER_DAY - 1;
+
+  if (!parse_Field(cursor, field, sizeof(field)) ||
+      (!field_Is_Any(field) && !parse_Minute(field, &rule->from_min))) {
+    return 0;
+  }
+
+  if (!parse_Field(cursor, field, sizeof(field)) ||
+      (!field_Is_Any(field) && !parse_Minute(field, &rule->to_min))) {
+    return 0;
+  }
+
+  if (!parse_Field(cursor, field, sizeof(field))) {
+    return 0;
+  }
+
+  if (field_Is_Any(field)) {
+    rule->week = 0x7F;
+  } else {
+    if (strlen(field) != 7) {
+      return 0;
+    }
+
+    for (uint8_t i = 0; i < 7; i++) {
+      if (field[i] != '0' && field[i] != '1') {
+        return 0;
+      }
+      rule->week |= (field[i] == '1') << i;
+    }
+  }
+
+  if (!parse_Field(cursor, field, sizeof(field))) {
+    return 0;
+  }
+
+  if (!field_Is_Any(field)) {
+    if (strlen(field) != 3 || (field[0] != 'I' && field[0] != 'R') ||
+        field[1] < '1' || field[1] > '2' ||
+        (field[2] != '0' && field[2] != '1')) {
+      return 0;
+    }
+
+    rule->cond_type =
+        field[0] == 'I' ? INPUT_RULE_COND_INPUT : INPUT_RULE_COND_RELAY;
+    rule->cond_index = field[1] - '1';
+    rule->cond_level = field[2] - '0';
+  }
+
+  if (!parse_Field(cursor, field, sizeof(field)) || **cursor == '.') {
+    return 0;
+  }
+
+  return parse_Actions(field, rule);
+}
+
+/* acrescenta as regras do texto as que compiled ja tem */
+static uint8_t compile_Rules(input_rules *compiled, const char *text) {
+  const char *cursor = text;
+
+  while (cursor != NULL && *cursor != 0) {
+    if (*cursor == ';') {
+      cursor++;
+      continue;
+    }
+
+    if (compiled->count >= INPUT_RULES_MAX) {
+      return 0;
+    }
+
+    input_rule *rule = &compiled->rules[compiled->count];
+
+    if (!parse_Rule(&cursor, rule)) {
+      return 0;
+    }
+
+    for (uint8_t edge = 0; edge < 2; edge++) {
+      if ((rule->edges >> edge) & 1) {
+        compiled->index[rule->input - 1][edge] |= 1 << compiled->count;
+      }
+    }
+
+    compiled->count++;
+  }
+
+  return 1;
+}
+
+int input_Rules_Compile(input_rules *rules, const char *text) {
+  input_rules compiled;
+
+  memset(&compiled, 0, sizeof(compiled));
+
+  if (!compile_Rules(&compiled, text)) {
+    return -1;
+  }
+
+  memcpy(rules, &compiled, sizeof(compiled));
+  return compiled.count;
+}
+
+int input_Rules_Compile_Rex(input_rules *rules, const char *text,
+                            uint8_t rex) {
+  input_rules compiled;
+
+  memset(&compiled, 0, sizeof(compiled));
+
+  if (!compile_Rules(&compiled, text) ||
+      compiled.count > INPUT_RULES_USER_MAX) {
+    return -1;
+  }
+
+  if (rex == 1 || rex == 3) {
+    compile_Rules(&compiled, "1.R.*.*.*.*.X1");
+  }
+
+  if (rex == 2 || rex == 3) {
+    compile_Rules(&compiled, "2.R.*.*.*.*.X2");
+  }
+
+  memcpy(rules, &compiled, sizeof(compiled));
+  return compiled.count;
+}
+
+const char *input_Rules_SMS_Message(uint8_t input, uint8_t level) {
+  if (input == 1) {
+    return level ? "INPUT_HAS_BEEN_ACTIVATED1" : "INPUT_HAS_BEEN_DEACTIVATED1";
+  }
+
+  return level ? "INPUT_HAS_BEEN_ACTIVATED2" : "INPUT_HAS_BEEN_DEACTIVATED2";
+}
+
+static uint8_t rule_In_Window(const input_rule *rule, uint16_t minute) {
+  if (rule->from_min <= rule->to_min) {
+    return minute >= rule->from_min && minute <= rule->to_min;
+  }
+
+  return minute >= rule->from_min || minute <= rule->to_min;
+}
+
+uint16_t input_Rules_Match(const input_rules *rules,
+                           const input_rules_event *event) {
+  uint16_t matched = 0;
+
+  if (event->input < 1 || event->input > INPUT_RULES_INPUTS) {
+    return 0;
+  }
+
+  uint16_t candidates = rules->index[event->input - 1][event->level ? 0 : 1];
+
+  for (uint8_t i = 0; candidates != 0; i++, candidates >>= 1) {
+    if (!(candidates & 1)) {
+      continue;
+    }
+
+    const input_rule *rule = &rules->rules[i];
+
+    if (!((rule->week >> event->wday) & 1) ||
+        !rule_In_Window(rule, event->minute)) {
+      continue;
+    }
+
+    if (rule->cond_type == INPUT_RULE_COND_INPUT &&
+        ((event->inputs >> rule->cond_index) & 1) != rule->cond_level) {
+      continue;
+    }
+
+    if (rule->cond_type == INPUT_RULE_COND_RELAY &&
+        ((event->relays >> rule->cond_index) & 1) != rule->cond_level) {
+      continue;
+    }
+
+    matched |= 1 << i;
+  }
+
+  return matched;
+}
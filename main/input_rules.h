@@ -0,0 +1,111 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _INPUT_RULES_H_
+#define _INPUT_RULES_H_
+
+#include <stdint.h>
+
+/*
+ * Regras entrada -> acao compiladas para RAM. A configuracao e texto,
+ * regras separadas por ';' e campos por '.':
+ *
+ *   <entrada>.<flanco>.<desde>.<ate>.<semana>.<condicao>.<acoes>
+ *
+ *   entrada   1 ou 2
+ *   flanco    R (ativa), F (desativa) ou A (ambos)
+ *   desde/ate HHMM, '*' = todo o dia; desde > ate passa a meia-noite
+ *   semana    7 digitos 0/1 a comecar ao domingo, como MyUser.week
+ *   condicao  I<n><0|1> ou R<n><0|1> (nivel de outra entrada ou rele)
+ *   acoes     separadas por '+': P<rele>:<ms> impulso, X<rele> como REX,
+ *             S<posicoes> SMS para as posicoes 1..6 da lista de feedback,
+ *             M evento MQTT, B som
+ *
+ * '*' ou campo vazio aceita tudo. A compilacao guarda por entrada e flanco
+ * a mascara das regras candidatas, a avaliacao so percorre essas.
+ *
+ * O modulo nao depende de ESP-IDF nem de FreeRTOS.
+ */
+
+#define INPUT_RULES_MAX 16
+#define INPUT_RULES_INPUTS 2
+#define INPUT_RULES_SMS_SLOTS 6
+
+/* as ultimas INPUT_RULES_INPUTS posicoes ficam para o REX, assim um ME S X
+   nunca deixa a tabela sem lugar */
+#define INPUT_RULES_USER_MAX (INPUT_RULES_MAX - INPUT_RULES_INPUTS)
+
+#define INPUT_RULE_EDGE_RISE 0x01
+#define INPUT_RULE_EDGE_FALL 0x02
+
+#define INPUT_RULE_COND_NONE 0
+#define INPUT_RULE_COND_INPUT 1
+#define INPUT_RULE_COND_RELAY 2
+
+#define INPUT_RULE_ACTION_PULSE 0x01
+#define INPUT_RULE_ACTION_REX 0x02
+#define INPUT_RULE_ACTION_SMS 0x04
+#define INPUT_RULE_ACTION_MQTT 0x08
+#define INPUT_RULE_ACTION_SOUND 0x10
+
+typedef struct
+{
+  uint8_t input;
+  uint8_t edges;
+  uint16_t from_min;
+  uint16_t to_min;
+  uint8_t week;
+  uint8_t cond_type;
+  uint8_t cond_index;
+  uint8_t cond_level;
+  uint8_t actions;
+  uint8_t pulse_relay;
+  uint8_t rex_relay;
+  uint8_t sms_slots;
+  uint32_t pulse_ms;
+
+} input_rule;
+
+typedef struct
+{
+  input_rule rules[INPUT_RULES_MAX];
+  uint8_t count;
+  uint16_t index[INPUT_RULES_INPUTS][2];
+
+} input_rules;
+
+/* estado do sistema no momento do evento */
+typedef struct
+{
+  uint8_t input;
+  uint8_t level;
+  uint16_t minute;
+  uint8_t wday;
+  uint8_t inputs;
+  uint8_t relays;
+
+} input_rules_event;
+
+/* numero de regras ou -1 se o texto tem erros; em erro rules fica igual */
+int input_Rules_Compile(input_rules *rules, const char *text);
+
+/* regras guardadas (no maximo INPUT_RULES_USER_MAX) mais as do REX no fim,
+   rex como NVS_INPUT_REX_VALUE: 1 = entrada 1, 2 = entrada 2, 3 = ambas */
+int input_Rules_Compile_Rex(input_rules *rules, const char *text,
+                            uint8_t rex);
+
+/* chave do texto do SMS (return_Json_SMS_Data) do flanco que disparou */
+const char *input_Rules_SMS_Message(uint8_t input, uint8_t level);
+
+/* mascara das regras que se aplicam ao evento */
+uint16_t input_Rules_Match(const input_rules *rules,
+                           const input_rules_event *event);
+
+#endif
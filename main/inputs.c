@@ -19,8 +19,24 @@
 #include <stdlib.h>
 #include <string.h>
 // #include "rele.c"
+#include "EG91.h"
 #include "core.h"
+#include "esp_log.h"
+#include "input_rules.h"
+#include "rele.h"
 #include "rf.h"
+#include <time.h>
+
+/* tabela compilada; so muda em reload_Input_Rules */
+static input_rules input_Rules;
+static SemaphoreHandle_t input_Rules_Mutex;
+static StaticSemaphore_t input_Rules_Mutex_Buffer;
+static char input_Rules_Phones[INPUT_RULES_SMS_SLOTS][30];
+static MyUser input_Rex_User;
+
+static const char *input_Rules_Phone_Keys[INPUT_RULES_SMS_SLOTS] = {
+    NVS_FB_CONF_P1, NVS_FB_CONF_P2, NVS_FB_CONF_P3,
+    NVS_FB_CONF_P4, NVS_FB_CONF_P5, NVS_FB_CONF_P6};
 
 
 
@@ -104,6 +120,210 @@ char *readInputs(uint8_t BLE_SMS_Indication, uint8_t inputNumber, char cmd,
   }
   return "ERROR READ INPUTS";
 }
-int read_Input1() { return !gpio_get_level(GPIO_INPUT_IO_0); }
+int read_Input1() { return get_Input_Level(INPUT1_NUMBER); }
+
+int read_Input2() { return get_Input_Level(INPUT2_NUMBER); }
+
+/*
+ * Regras guardadas mais as do REX (NVS_INPUT_REX_VALUE), que continua a ser
+ * configurado com ME S X. As chaves NVS_AL_CONF_* nao entram: do alarme so
+ * resta NVS_AL_CONF_AL, que hoje liga o leitor Wiegand (WI S C), e as
+ * restantes ja nao sao lidas nem escritas por nenhum comando.
+ */
+static int compile_Input_Rules(const char *text, input_rules *rules) {
+  uint8_t rex =
+      get_INT8_Data_From_Storage(NVS_INPUT_REX_VALUE, nvs_System_handle);
+
+  if (strlen(text) > INPUT_RULES_TEXT_MAX) {
+    return -1;
+  }
+
+  return input_Rules_Compile_Rex(rules, text, rex);
+}
+
+static void install_Input_Rules(const input_rules *rules) {
+  xSemaphoreTake(input_Rules_Mutex, portMAX_DELAY);
+  memcpy(&input_Rules, rules, sizeof(input_rules));
+  xSemaphoreGive(input_Rules_Mutex);
+}
+
+uint8_t reload_Input_Rules() {
+  input_rules rules;
+  char text[INPUT_RULES_TEXT_MAX + 1] = {};
+  size_t required_size = sizeof(text);
+
+  for (uint8_t i = 0; i < INPUT_RULES_SMS_SLOTS; i++) {
+    char phone[200] = {};
+
+    get_Data_STR_Feedback_From_Storage((char *)input_Rules_Phone_Keys[i],
+                                       phone);
+    snprintf(input_Rules_Phones[i], sizeof(input_Rules_Phones[i]), "%s",
+             phone);
+  }
+
+  if (nvs_get_str(nvs_System_handle, NVS_INPUT_RULES, text, &required_size) !=
+      ESP_OK) {
+    text[0] = 0;
+  }
+
+  if (compile_Input_Rules(text, &rules) < 0) {
+    ESP_LOGE("INPUT_RULES", "regras guardadas invalidas, so REX");
+    compile_Input_Rules("", &rules);
+  }
+
+  install_Input_Rules(&rules);
+  return rules.count;
+}
+
+static void run_Input_Rule(const input_rule *rule, const input_event *event) {
+  if (rule->actions & INPUT_RULE_ACTION_PULSE) {
+    pulse_Relay(rule->pulse_relay, rule->pulse_ms);
+  }
+
+  if (rule->actions & INPUT_RULE_ACTION_REX) {
+    parse_ReleData(REX_INDICATION, rule->rex_relay, 'S', 'R', "REX", NULL,
+                   &input_Rex_User, NULL, NULL, NULL, NULL, NULL);
+  }
+
+  if (rule->actions & INPUT_RULE_ACTION_SMS) {
+    /* o texto depende do flanco que disparou a regra */
+    const char *message = input_Rules_SMS_Message(event->input, event->level);
+    data_EG91_Send_SMS sms_Data;
+
+    for (uint8_t i = 0; i < INPUT_RULES_SMS_SLOTS; i++) {
+      if (!((rule->sms_slots >> i) & 1) || input_Rules_Phones[i][0] == 0) {
+        continue;
+      }
+
+      memset(&sms_Data, 0, sizeof(sms_Data));
+      sprintf(sms_Data.phoneNumber, "%s", input_Rules_Phones[i]);
+      sprintf(sms_Data.payload, "%s", return_Json_SMS_Data((char *)message));
+      xQueueSendToBack(queue_EG91_SendSMS, (void *)&sms_Data,
+                       pdMS_TO_TICKS(100));
+    }
+  }
+
+  if (rule->actions & INPUT_RULE_ACTION_MQTT) {
+    mqtt_information mqttInfo;
+
+    memset(&mqttInfo, 0, sizeof(mqttInfo));
+    sprintf(mqttInfo.data, "& I%d %d", event->input, event->level);
+    send_UDP_queue(&mqttInfo);
+  }
+
+  if (rule->actions & INPUT_RULE_ACTION_SOUND) {
+    send_Type_Call_queue(PLAY_RECORD_SOUND_STATE);
+  }
+}
+
+static void input_Rules_Subscriber(const input_event *event, void *ctx) {
+  input_rule matched[INPUT_RULES_MAX];
+  uint8_t count = 0;
+  struct tm timeinfo;
+  time_t now = time(NULL);
+
+  localtime_r(&now, &timeinfo);
+
+  input_rules_event rules_event = {
+      .input = event->input,
+      .level = event->level,
+      .minute = timeinfo.tm_hour * 60 + timeinfo.tm_min,
+      .wday = timeinfo.tm_wday,
+      .inputs = get_Input_Level(INPUT1_NUMBER) |
+                get_Input_Level(INPUT2_NUMBER) << 1,
+      .relays = gpio_get_level(GPIO_OUTPUT_IO_0) |
+                gpio_get_level(GPIO_OUTPUT_IO_1) << 1,
+  };
+
+  xSemaphoreTake(input_Rules_Mutex, portMAX_DELAY);
+  uint16_t mask = input_Rules_Match(&input_Rules, &rules_event);
+
+  for (uint8_t i = 0; mask != 0; i++, mask >>= 1) {
+    if (mask & 1) {
+      matched[count++] = input_Rules.rules[i];
+    }
+  }
+  xSemaphoreGive(input_Rules_Mutex);
+
+  for (uint8_t i = 0; i < count; i++) {
+    run_Input_Rule(&matched[i], event);
+  }
+}
+
+void init_Input_Rules() {
+  memset(&input_Rex_User, 0, sizeof(input_Rex_User));
+  sprintf(input_Rex_User.firstName, "%s", "S/N");
+  sprintf(input_Rex_User.start.date, "%s", "220101");
+  sprintf(input_Rex_User.start.hour, "%s", "0000");
+  sprintf(input_Rex_User.end.days, "%c", '*');
+  sprintf(input_Rex_User.end.hour, "%s", "2359");
+  sprintf(input_Rex_User.key, "%s", "REX");
+  sprintf(input_Rex_User.week, "%s", "1111111");
+  input_Rex_User.permition = '1';
+  input_Rex_User.relayPermition = '0';
+  input_Rex_User.ble_security = '0';
+  input_Rex_User.erase_User_After_Date = '0';
+  input_Rex_User.wiegand_code[0] = ':';
+  input_Rex_User.wiegand_code[1] = 0;
+  input_Rex_User.wiegand_rele_permition = ':';
+  input_Rex_User.rf_serial[0] = ':';
+  input_Rex_User.rf1_relay = ':';
+  input_Rex_User.rf2_relay = ':';
+
+  input_Rules_Mutex = xSemaphoreCreateMutexStatic(&input_Rules_Mutex_Buffer);
+  reload_Input_Rules();
+  subscribe_Input_Events(input_Rules_Subscriber, NULL);
+}
+
+/**
+ * @brief Configuration of the input rules (input_rules.h)
+ *
+ * @param BLE_SMS_Indication Indicates the type of the received command
+ * @param cmd Command received
+ * @param param Parameter received
+ * @param payload Rules text (SET)
+ * @return char* String with the response
+ */
+char *parse_Input_Rules(uint8_t BLE_SMS_Indication, char cmd, char param,
+                        char *payload) {
+  char *rsp = NULL;
+  input_rules rules;
+
+  if (param != INPUT_RULES_PARAMETER) {
+    return return_ERROR_Codes(&rsp, return_Json_SMS_Data("ERROR_PARAMETER"));
+  }
+
+  if (cmd == SET_CMD) {
+    if (payload == NULL || compile_Input_Rules(payload, &rules) < 0) {
+      return return_ERROR_Codes(&rsp, return_Json_SMS_Data("ERROR_INPUT_DATA"));
+    }
 
-int read_Input2() { return !gpio_get_level(GPIO_INPUT_IO_1); }
+    if (save_STR_Data_In_Storage(NVS_INPUT_RULES, payload,
+                                 nvs_System_handle) != ESP_OK) {
+      return return_ERROR_Codes(&rsp, return_Json_SMS_Data("ERROR_SET"));
+    }
+
+    install_Input_Rules(&rules);
+    asprintf(&rsp, "%s %c %c %d", INPUT_RULES_ELEMENT, cmd, param, rules.count);
+    return rsp;
+  } else if (cmd == GET_CMD) {
+    char text[INPUT_RULES_TEXT_MAX + 1] = {};
+    size_t required_size = sizeof(text);
+
+    if (nvs_get_str(nvs_System_handle, NVS_INPUT_RULES, text,
+                    &required_size) != ESP_OK) {
+      text[0] = 0;
+    }
+
+    asprintf(&rsp, "%s %c %c %s", INPUT_RULES_ELEMENT, cmd, param, text);
+    return rsp;
+  } else if (cmd == RESET_CMD) {
+    nvs_erase_key(nvs_System_handle, NVS_INPUT_RULES);
+
+    asprintf(&rsp, "%s %c %c %d", INPUT_RULES_ELEMENT, cmd, param,
+             reload_Input_Rules());
+    return rsp;
+  }
+
+  return return_ERROR_Codes(&rsp, return_Json_SMS_Data("ERROR_CMD"));
+}
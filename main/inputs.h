@@ -23,4 +23,12 @@ int read_Input1();
 int read_Input2();
 char *readInputs(uint8_t BLE_SMS_Indication, uint8_t inputNumber, char cmd, char param, char *phPassword, char *payload);
 
+/* texto das regras guardado em NVS_INPUT_RULES (formato em input_rules.h), no
+   maximo INPUT_RULES_MAX - 2 regras, as outras duas sao do REX */
+#define INPUT_RULES_TEXT_MAX 720
+
+void init_Input_Rules();
+uint8_t reload_Input_Rules();
+char *parse_Input_Rules(uint8_t BLE_SMS_Indication, char cmd, char param, char *payload);
+
 #endif
\ No newline at end of file
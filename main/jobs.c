@@ -20,145 +20,264 @@
 #include "freertos/semphr.h"
 #include "jobs.h"
 
-// STATIC FUNCTION DECLARATIONS
-struct cron_job_node *_cron_job_list_insert(struct cron_job_node *next_node, struct cron_job_node *new_node);
 // STATIC STRUCTS
 static struct
 {
-  int next_id;
-  struct cron_job_node *first;
+  cron_job pool[CRON_JOB_MAX];
+  uint8_t used[CRON_JOB_MAX];
+  cron_job *heap[CRON_JOB_MAX];
+  int count;
   SemaphoreHandle_t semaphore;
-  int init;
+  StaticSemaphore_t semaphore_buffer;
 
-} linked_link_state = {
-    .next_id = 0,
-    .first = NULL,
-    .semaphore = NULL,
-    .init = 0
+} heap_state = {
+    .count = 0,
+    .semaphore = NULL
     };
 
+/* chamada uma vez no initSystem, antes de qualquer tarefa usar a lista */
 void cron_job_list_init()
 {
-  if (linked_link_state.init == 0) {
-    linked_link_state.semaphore = xSemaphoreCreateMutex();
-    linked_link_state.init=1;
+  if (heap_state.semaphore == NULL)
+  {
+    heap_state.semaphore = xSemaphoreCreateMutexStatic(&heap_state.semaphore_buffer);
+  }
+}
+
+static int _cron_job_before(cron_job *a, cron_job *b)
+{
+  if (a->next_execution != b->next_execution)
+  {
+    return a->next_execution < b->next_execution;
   }
+  return a->id < b->id;
 }
 
-struct cron_job_node *cron_job_list_first()
+static void _cron_job_heap_set(int index, cron_job *job)
 {
-  return linked_link_state.first;
+  heap_state.heap[index] = job;
+  job->heap_index = index;
 }
 
-/* RECURSIVE BUT STACK EXHAUSTION? */
-struct cron_job_node *_cron_job_list_insert(struct cron_job_node *next_node, struct cron_job_node *new_node)
+static void _cron_job_sift_up(int index)
 {
-  if (next_node == NULL || new_node->job->next_execution < next_node->job->next_execution)
+  cron_job *job = heap_state.heap[index];
+
+  while (index > 0)
   {
-    new_node->next = next_node;
-    return new_node;
+    int parent = (index - 1) / 2;
+    if (!_cron_job_before(job, heap_state.heap[parent]))
+    {
+      break;
+    }
+    _cron_job_heap_set(index, heap_state.heap[parent]);
+    index = parent;
+  }
+  _cron_job_heap_set(index, job);
+}
+
+static void _cron_job_sift_down(int index)
+{
+  cron_job *job = heap_state.heap[index];
+
+  while (1)
+  {
+    int child = 2 * index + 1;
+    if (child >= heap_state.count)
+    {
+      break;
+    }
+    if (child + 1 < heap_state.count && _cron_job_before(heap_state.heap[child + 1], heap_state.heap[child]))
+    {
+      child++;
+    }
+    if (!_cron_job_before(heap_state.heap[child], job))
+    {
+      break;
+    }
+    _cron_job_heap_set(index, heap_state.heap[child]);
+    index = child;
+  }
+  _cron_job_heap_set(index, job);
+}
+
+/* MUST BE CALLED WITH THE SEMAPHORE TAKEN */
+static void _cron_job_heap_update(cron_job *job)
+{
+  int index = job->heap_index;
+
+  if (index > 0 && _cron_job_before(job, heap_state.heap[(index - 1) / 2]))
+  {
+    _cron_job_sift_up(index);
   }
   else
   {
-    next_node->next = _cron_job_list_insert(next_node->next, new_node);
+    _cron_job_sift_down(index);
   }
-  return next_node;
 }
 
-int cron_job_list_insert(cron_job *job)
+/* MUST BE CALLED WITH THE SEMAPHORE TAKEN */
+static void _cron_job_heap_remove(cron_job *job)
+{
+  int index = job->heap_index;
+  cron_job *last = heap_state.heap[--heap_state.count];
+
+  job->heap_index = -1;
+  if (last != job)
+  {
+    _cron_job_heap_set(index, last);
+    _cron_job_heap_update(last);
+  }
+}
+
+cron_job *cron_job_list_alloc()
+{
+  cron_job *job = NULL;
+
+  xSemaphoreTake(heap_state.semaphore, portMAX_DELAY);
+  for (int i = 0; i < CRON_JOB_MAX; i++)
+  {
+    if (!heap_state.used[i])
+    {
+      heap_state.used[i] = 1;
+      job = &heap_state.pool[i];
+      memset(job, 0, sizeof(cron_job));
+      job->id = i;
+      job->heap_index = -1;
+      break;
+    }
+  }
+  xSemaphoreGive(heap_state.semaphore);
+  return job;
+}
+
+int cron_job_list_free(cron_job *job)
 {
-  if (linked_link_state.semaphore == NULL)
-    cron_job_list_init();
-  if (job == NULL)
+  if (job == NULL || job->id < 0 || job->id >= CRON_JOB_MAX)
   {
     return -1;
   }
-  struct cron_job_node *new_node = calloc(sizeof(struct cron_job_node),1);
-  if (new_node == NULL)
+  xSemaphoreTake(heap_state.semaphore, portMAX_DELAY);
+  if (job->heap_index >= 0)
+  {
+    _cron_job_heap_remove(job);
+  }
+  heap_state.used[job->id] = 0;
+  xSemaphoreGive(heap_state.semaphore);
+  return 0;
+}
+
+cron_job *cron_job_list_first()
+{
+  return heap_state.count > 0 ? heap_state.heap[0] : NULL;
+}
+
+int cron_job_list_insert(cron_job *job)
+{
+  if (job == NULL || job->id < 0 || job->id >= CRON_JOB_MAX)
   {
     return -1;
   }
-  new_node->job = job;
-  if (xSemaphoreTake(linked_link_state.semaphore, (TickType_t)10) == pdTRUE)
+  xSemaphoreTake(heap_state.semaphore, portMAX_DELAY);
+  if (job->heap_index >= 0)
   {
-    linked_link_state.first = _cron_job_list_insert(linked_link_state.first, new_node);
-    xSemaphoreGive(linked_link_state.semaphore);
+    _cron_job_heap_update(job);
   }
   else
   {
-    free(new_node);
-    return -1;
+    _cron_job_heap_set(heap_state.count++, job);
+    _cron_job_sift_up(job->heap_index);
   }
-  if (new_node->job->id == -1) // NOT INITIALIZED ON -1
-    new_node->job->id = linked_link_state.next_id++;
-  return new_node->job->id;
+  xSemaphoreGive(heap_state.semaphore);
+  return job->id;
 }
 
 int cron_job_list_remove(int id)
 {
   int ret = -1;
-  struct cron_job_node *node = linked_link_state.first, *prev_node = NULL;
-  if (xSemaphoreTake(linked_link_state.semaphore, (TickType_t)10) == pdTRUE) 
+
+  if (id < 0 || id >= CRON_JOB_MAX)
   {
-    do
-    {
-      if (node->job->id == id)
-      {
-        if (node == linked_link_state.first)
-        {
-          linked_link_state.first = node->next;
-        }
-        else
-        {
-          prev_node->next = node->next;
-        }
-        //free(node->job->data);
-        free(node);
-        node = NULL;
-
-        ret = 0;
-        break;
-      }
-      else
-      {
-        prev_node = node;
-        node = node->next;
-      }
-
-    } while (node->next);
-    xSemaphoreGive(linked_link_state.semaphore);
+    return -1;
   }
-  else
+  xSemaphoreTake(heap_state.semaphore, portMAX_DELAY);
+  if (heap_state.used[id] && heap_state.pool[id].heap_index >= 0)
   {
-    ret = -1;
+    _cron_job_heap_remove(&heap_state.pool[id]);
+    ret = 0;
   }
+  xSemaphoreGive(heap_state.semaphore);
   return ret;
 }
 
-int cron_job_node_count()
+int cron_job_list_take_due(time_t now, cron_job *due, time_t *next_execution)
 {
-  int cnt = 0;
-  struct cron_job_node *node = cron_job_list_first();
-  if (node == NULL)
+  int ret = 0;
+  cron_job *job;
+
+  xSemaphoreTake(heap_state.semaphore, portMAX_DELAY);
+  job = cron_job_list_first();
+  if (job != NULL && now >= job->next_execution)
   {
-    cnt = 0;
+    job->next_execution = cron_next(&(job->expression), now);
+    if (job->next_execution == (time_t)-1)
+    {
+      _cron_job_heap_remove(job);
+    }
+    else
+    {
+      _cron_job_sift_down(0);
+    }
+    *due = *job;
+    ret = 1;
+    job = cron_job_list_first();
   }
-  else
+  *next_execution = job != NULL ? job->next_execution : (time_t)-1;
+  xSemaphoreGive(heap_state.semaphore);
+  return ret;
+}
+
+uint64_t cron_job_list_next_execution_of(const char *data)
+{
+  uint64_t next_execution = UINT64_MAX;
+
+  xSemaphoreTake(heap_state.semaphore, portMAX_DELAY);
+  for (int i = 0; i < heap_state.count; i++)
   {
-    do
+    cron_job *job = heap_state.heap[i];
+    if (!strcmp(job->data, data) && (uint64_t)job->next_execution < next_execution)
     {
-      cnt++;
-      node = node->next;
-    } while (node);
+      next_execution = job->next_execution;
+    }
+  }
+  xSemaphoreGive(heap_state.semaphore);
+  return next_execution;
+}
+
+void cron_job_list_foreach(void (*fn)(cron_job *, void *), void *ctx)
+{
+  xSemaphoreTake(heap_state.semaphore, portMAX_DELAY);
+  for (int i = 0; i < heap_state.count; i++)
+  {
+    fn(heap_state.heap[i], ctx);
   }
-  return cnt;
+  xSemaphoreGive(heap_state.semaphore);
 }
 
+int cron_job_node_count()
+{
+  return heap_state.count;
+}
 
-int cron_job_list_reset_id(){
-  if (cron_job_node_count()==0) {
-    linked_link_state.next_id=0;
-    return 0;
-    }
-  return -1;
-}
\ No newline at end of file
+int cron_job_list_clear()
+{
+  xSemaphoreTake(heap_state.semaphore, portMAX_DELAY);
+  for (int i = 0; i < heap_state.count; i++)
+  {
+    heap_state.heap[i]->heap_index = -1;
+  }
+  heap_state.count = 0;
+  memset(heap_state.used, 0, sizeof(heap_state.used));
+  xSemaphoreGive(heap_state.semaphore);
+  return 0;
+}
@@ -19,49 +19,89 @@
 
 #ifndef _ESP_CRON_JOBS_LINKED_LIST
 #define _ESP_CRON_JOBS_LINKED_LIST
+#include <stdint.h>
 #include <time.h>
 #include "cron.h"
 
-struct cron_job_node {
-  struct cron_job_node * next;
-  cron_job * job;
-};
+/*
+*  The jobs live in a static pool of CRON_JOB_MAX slots (job->id is the slot) and the
+*  scheduled ones are kept in an array backed min-heap ordered by next_execution, so
+*  creating, firing and rescheduling a job never touches the heap allocator.
+*/
 
 /*
-*  SUMMARY: Returns the first element in the linkedlist. 
+*  SUMMARY: Takes a free slot from the job pool. 
 *
-*  PARAMS: Time input (timestamp) 
+*  PARAMS: NONE
 *
-*  RETURNS:  hour 
+*  RETURNS:  zeroed job with its id set, NULL if the pool is full 
 */
-
-struct cron_job_node * cron_job_list_first();
+cron_job * cron_job_list_alloc();
 /*
-*  SUMMARY: Adds a job to the list in execution order. 
+*  SUMMARY: Removes the job from the heap and gives its slot back to the pool. 
 *
 *  PARAMS: job
 *
+*  RETURNS:  0 on success, -1 on error 
+*/
+int cron_job_list_free(cron_job * job);
+/*
+*  SUMMARY: Returns the job with the earliest next_execution. 
+*
+*  PARAMS: NONE
+*
+*  RETURNS:  job or NULL if nothing is scheduled 
+*/
+cron_job * cron_job_list_first();
+/*
+*  SUMMARY: Adds a job to the heap, or moves it if it is already there (O(log N)). 
+*
+*  PARAMS: job with next_execution already set
+*
 *  RETURNS:  id or -1 on error 
 */
 int cron_job_list_insert(cron_job * job);
 /*
-*  SUMMARY: Removes a node from the list. 
-*  Note that for a new node the id must be -1 and this method will give you a new id.
-*  Ids start at zero and grow from there, so job->id must be set to -1.
+*  SUMMARY: Removes a job from the heap, the slot stays allocated (O(log N)).
 *
-*  PARAMS: id for the node
+*  PARAMS: id for the job
 *
 *  RETURNS: 0 on success, -1 on not found
 */
 int cron_job_list_remove(int id);
-
-
 /*
-*  SUMMARY:Counts elements on list o(N). 
+*  SUMMARY: If the earliest job is due, reschedules it to its next execution after now
+*  and copies it to due (the copy is what must be run, the slot may change meanwhile).
+*  Jobs whose expression has no next execution are removed from the heap.
+*
+*  PARAMS: current time, copy of the due job, next execution of the earliest job (-1 if none)
+*
+*  RETURNS: 1 if a job is due, 0 otherwise
+*/
+int cron_job_list_take_due(time_t now, cron_job * due, time_t * next_execution);
+/*
+*  SUMMARY: Earliest next_execution of the scheduled jobs with the given data.
+*
+*  PARAMS: data to match
+*
+*  RETURNS: next_execution or UINT64_MAX if no job matches
+*/
+uint64_t cron_job_list_next_execution_of(const char * data);
+/*
+*  SUMMARY: Calls fn for every scheduled job with the semaphore taken, fn must not
+*  call back into this module.
+*
+*  PARAMS: function to call, context passed to it
+*
+*  RETURNS: NONE
+*/
+void cron_job_list_foreach(void (* fn)(cron_job *, void *), void * ctx);
+/*
+*  SUMMARY: Counts the scheduled jobs O(1). 
 *
 *  PARAMS: NONE
 *
-*  RETURNS: number of nodes on list
+*  RETURNS: number of jobs on the heap
 */
 int cron_job_node_count();
 /*
@@ -73,13 +113,12 @@ int cron_job_node_count();
 */
 void cron_job_list_init();
 /*
-*  SUMMARY: If the node count is zero then make id 0 to start over.
+*  SUMMARY: Empties the heap and gives every slot back to the pool.
 *
 *  PARAMS: NONE
 *
-*  RETURNS: 0 on success, -1 on no action
+*  RETURNS: 0 on success
 */
+int cron_job_list_clear();
 
-int cron_job_list_reset_id();
-
-#endif 
\ No newline at end of file
+#endif
@@ -0,0 +1,145 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "log_lzss.h"
+
+typedef struct
+{
+  uint8_t *out;
+  size_t size;
+  size_t len;
+  uint8_t mask;
+  uint8_t overflow;
+
+} log_upload_bits;
+
+typedef struct
+{
+  const uint8_t *in;
+  size_t len;
+  size_t pos;
+  uint8_t mask;
+  uint8_t underflow;
+
+} log_upload_bit_reader;
+
+static void put_Bits(log_upload_bits *bits, uint16_t value, uint8_t count) {
+  while (count--) {
+    if (bits->mask == 0) {
+      if (bits->len >= bits->size) {
+        bits->overflow = 1;
+        return;
+      }
+      bits->out[bits->len++] = 0;
+      bits->mask = 0x80;
+    }
+
+    if ((value >> count) & 1) {
+      bits->out[bits->len - 1] |= bits->mask;
+    }
+    bits->mask >>= 1;
+  }
+}
+
+size_t log_Upload_Compress(const uint8_t *in, size_t in_len, uint8_t *out,
+                           size_t out_size) {
+  const size_t window = 1 << LOG_UPLOAD_WINDOW_BITS;
+  const size_t max_match =
+      LOG_UPLOAD_MIN_MATCH + (1 << LOG_UPLOAD_LENGTH_BITS) - 1;
+  log_upload_bits bits = {out, out_size, 0, 0, 0};
+  size_t pos = 0;
+
+  while (pos < in_len && !bits.overflow) {
+    size_t start = pos > window ? pos - window : 0;
+    size_t limit = in_len - pos < max_match ? in_len - pos : max_match;
+    size_t best_len = 0;
+    size_t best_dist = 0;
+
+    /* a mais proxima primeiro, pode sobrepor-se a posicao atual */
+    for (size_t cand = pos; cand-- > start && best_len < limit;) {
+      size_t len = 0;
+
+      while (len < limit && in[cand + len] == in[pos + len]) {
+        len++;
+      }
+
+      if (len > best_len) {
+        best_len = len;
+        best_dist = pos - cand;
+      }
+    }
+
+    if (best_len >= LOG_UPLOAD_MIN_MATCH) {
+      put_Bits(&bits, 0, 1);
+      put_Bits(&bits, best_dist - 1, LOG_UPLOAD_WINDOW_BITS);
+      put_Bits(&bits, best_len - LOG_UPLOAD_MIN_MATCH, LOG_UPLOAD_LENGTH_BITS);
+      pos += best_len;
+    } else {
+      put_Bits(&bits, 1, 1);
+      put_Bits(&bits, in[pos], 8);
+      pos++;
+    }
+  }
+
+  return bits.overflow ? 0 : bits.len;
+}
+
+static uint16_t get_Bits(log_upload_bit_reader *bits, uint8_t count) {
+  uint16_t value = 0;
+
+  while (count--) {
+    if (bits->mask == 0) {
+      if (bits->pos >= bits->len) {
+        bits->underflow = 1;
+        return 0;
+      }
+      bits->pos++;
+      bits->mask = 0x80;
+    }
+
+    value = value << 1 | ((bits->in[bits->pos - 1] & bits->mask) != 0);
+    bits->mask >>= 1;
+  }
+
+  return value;
+}
+
+size_t log_Upload_Decompress(const uint8_t *in, size_t in_len, uint8_t *out,
+                             size_t raw_len) {
+  log_upload_bit_reader bits = {in, in_len, 0, 0, 0};
+  size_t pos = 0;
+
+  while (pos < raw_len) {
+    if (get_Bits(&bits, 1)) {
+      uint8_t literal = get_Bits(&bits, 8);
+
+      if (bits.underflow) {
+        return 0;
+      }
+      out[pos++] = literal;
+    } else {
+      size_t dist = get_Bits(&bits, LOG_UPLOAD_WINDOW_BITS) + 1;
+      size_t len =
+          get_Bits(&bits, LOG_UPLOAD_LENGTH_BITS) + LOG_UPLOAD_MIN_MATCH;
+
+      if (bits.underflow || dist > pos || len > raw_len - pos) {
+        return 0;
+      }
+
+      /* byte a byte: a copia pode sobrepor-se ao que esta a escrever */
+      while (len--) {
+        out[pos] = out[pos - dist];
+        pos++;
+      }
+    }
+  }
+
+  return pos;
+}
@@ -0,0 +1,40 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _LOG_LZSS_H_
+#define _LOG_LZSS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * LZSS dos blocos do log_upload.c, em fluxo de bits (MSB primeiro), com
+ * janela de 2^LOG_UPLOAD_WINDOW_BITS bytes reiniciada em cada bloco:
+ *   1 + 8 bits               literal
+ *   0 + W bits + L bits      copia de (distancia - 1, comprimento -
+ *                            LOG_UPLOAD_MIN_MATCH)
+ * e termina ao fim de raw_len bytes. Sem dependencias do ESP-IDF; o
+ * descompressor serve o host_test e as ferramentas do portal.
+ */
+
+#define LOG_UPLOAD_WINDOW_BITS 9
+#define LOG_UPLOAD_LENGTH_BITS 5
+#define LOG_UPLOAD_MIN_MATCH 2
+
+/* bytes escritos em out, 0 se nao couber */
+size_t log_Upload_Compress(const uint8_t *in, size_t in_len, uint8_t *out,
+                           size_t out_size);
+
+/* repoe exatamente raw_len bytes; 0 se o fluxo acabar antes, tiver uma
+   distancia antes do inicio ou passar de raw_len */
+size_t log_Upload_Decompress(const uint8_t *in, size_t in_len, uint8_t *out,
+                             size_t raw_len);
+
+#endif
@@ -0,0 +1,435 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "log_query.h"
+#include "ble_spp_server_demo.h"
+#include "core.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+  uint8_t BLE_SMS_Indication;
+  uint8_t gattsIF;
+  uint16_t connID;
+  uint16_t handle_table;
+  uint8_t month_Export;
+  log_query_filter filter;
+
+} log_query_job;
+
+static log_query_job log_Query_Job;
+static volatile uint8_t log_Query_Running = 0;
+static volatile uint8_t log_Query_Cancel_Flag = 0;
+
+static uint8_t parse_Field(char **cursor, char *field, size_t size) {
+  char *end = strchr(*cursor, '.');
+  size_t len = end != NULL ? (size_t)(end - *cursor) : strlen(*cursor);
+
+  if (len >= size) {
+    return 0;
+  }
+
+  memcpy(field, *cursor, len);
+  field[len] = 0;
+  *cursor += len + (end != NULL);
+
+  return 1;
+}
+
+static uint8_t field_Is_Any(char *field) {
+  return field[0] == 0 || !strcmp(field, "*");
+}
+
+uint8_t log_Query_Parse(char *payload, log_query_filter *filter) {
+  char field[24];
+  char *cursor = payload;
+
+  memset(filter, 0, sizeof(log_query_filter));
+  filter->source = LOG_QUERY_ANY;
+  filter->result = LOG_QUERY_ANY;
+
+  if (payload[0] != 'Q') {
+    return 0;
+  }
+
+  cursor += payload[1] == '.' ? 2 : 1;
+
+  if (!parse_Field(&cursor, field, sizeof(field))) {
+    return 0;
+  }
+  filter->from_epoch = field_Is_Any(field) ? 0 : strtoul(field, NULL, 10);
+
+  if (!parse_Field(&cursor, field, sizeof(field))) {
+    return 0;
+  }
+  filter->to_epoch = field_Is_Any(field) ? 0 : strtoul(field, NULL, 10);
+
+  if (filter->to_epoch != 0 && filter->to_epoch < filter->from_epoch) {
+    return 0;
+  }
+
+  if (!parse_Field(&cursor, field, sizeof(field))) {
+    return 0;
+  }
+
+  if (!field_Is_Any(field)) {
+    filter->has_cred = 1;
+    filter->cred_hash = sdCard_Log_Credential_Hash(field);
+    phone_Canonicalize_E164(field, filter->cred_e164);
+  }
+
+  if (!parse_Field(&cursor, field, sizeof(field))) {
+    return 0;
+  }
+
+  if (!field_Is_Any(field)) {
+    filter->source = atoi(field);
+  }
+
+  if (!parse_Field(&cursor, field, sizeof(field))) {
+    return 0;
+  }
+
+  if (!field_Is_Any(field)) {
+    filter->result = atoi(field) ? LOG_QUERY_RESULT_ERROR : LOG_QUERY_RESULT_OK;
+  }
+
+  return 1;
+}
+
+uint8_t log_Query_Match(const sdCard_Log_Record *record,
+                        const log_query_filter *filter) {
+  char credential[sizeof(record->credential) + 1];
+  char e164[PHONE_E164_SIZE];
+
+  if (filter->from_epoch != 0 && record->epoch < filter->from_epoch) {
+    return 0;
+  }
+
+  if (filter->to_epoch != 0 && record->epoch > filter->to_epoch) {
+    return 0;
+  }
+
+  if (filter->source != LOG_QUERY_ANY && record->source != filter->source) {
+    return 0;
+  }
+
+  if (filter->result == LOG_QUERY_RESULT_OK && record->result != 0) {
+    return 0;
+  }
+
+  if (filter->result == LOG_QUERY_RESULT_ERROR && record->result == 0) {
+    return 0;
+  }
+
+  if (filter->has_cred && record->cred_hash != filter->cred_hash) {
+    /* o mesmo telefone pode ter sido registado noutro formato */
+    if (filter->cred_e164[0] == 0) {
+      return 0;
+    }
+
+    memset(credential, 0, sizeof(credential));
+    memcpy(credential, record->credential, sizeof(record->credential));
+
+    if (!phone_Canonicalize_E164(credential, e164) ||
+        strcmp(e164, filter->cred_e164)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static uint8_t log_Query_Send(log_query_job *job, char *batch, size_t len) {
+  if (len == 0) {
+    return 1;
+  }
+
+  batch[len] = 0;
+
+  if (job->BLE_SMS_Indication == BLE_INDICATION) {
+    if (esp_ble_gatts_send_indicate(job->gattsIF, job->connID,
+                                    job->handle_table, len, (uint8_t *)batch,
+                                    false) != ESP_OK) {
+      return 0;
+    }
+    vTaskDelay(pdMS_TO_TICKS(50));
+    return 1;
+  }
+
+  return send_UDP_Send(batch, "");
+}
+
+/* primeiro registo do segmento com epoch >= from; so serve para segmentos
+   sem unordered, em que os epochs crescem com a ordem de escrita */
+uint32_t log_Query_Lower_Bound(uint8_t month, uint32_t count,
+                               uint32_t from) {
+  sdCard_Log_Record record;
+  uint32_t lo = 0;
+  uint32_t hi = count;
+
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+
+    if (!sdCard_Take()) {
+      return count;
+    }
+
+    if (sdCard_Read_Log_Records(month, mid, &record, 1) != 1) {
+      sdCard_Give();
+      return count;
+    }
+    sdCard_Give();
+
+    if (record.epoch < from) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+/* so os segmentos cujo indice intersecta o intervalo, por ordem
+   cronologica; devolve quantos ficaram em order */
+uint8_t log_Query_Plan(const log_query_filter *filter,
+                       sdCard_Log_Segment_Header *segments, uint8_t *order) {
+  uint8_t n_segments = 0;
+
+  for (uint8_t month = 1; month <= 12; month++) {
+    sdCard_Log_Segment_Header *header = &segments[n_segments];
+    uint8_t i = n_segments;
+
+    if (!get_SDCard_Log_Segment(month, header) || header->count == 0) {
+      continue;
+    }
+
+    if ((filter->month != 0 && month != filter->month) ||
+        (filter->from_epoch != 0 && header->max_epoch < filter->from_epoch) ||
+        (filter->to_epoch != 0 && header->min_epoch > filter->to_epoch)) {
+      continue;
+    }
+
+    while (i > 0 &&
+           segments[order[i - 1]].first_epoch > header->first_epoch) {
+      order[i] = order[i - 1];
+      i--;
+    }
+    order[i] = n_segments++;
+  }
+
+  return n_segments;
+}
+
+/* exportacao do mes: primeiro o MM.csv do firmware anterior, se ainda
+   existir, sem a sua linha de cabecalho */
+static uint8_t log_Query_Send_Legacy(log_query_job *job, char *batch,
+                                     size_t batch_Size, size_t *batch_Len) {
+  uint8_t month = job->filter.month;
+  uint32_t size = get_SDCard_Legacy_Log_Size(month);
+  uint32_t offset = 0;
+  uint8_t skip_Header = 1;
+  size_t n = 0;
+
+  while (offset < size) {
+    if (log_Query_Cancel_Flag || !sdCard_Take()) {
+      return 0;
+    }
+    n = sdCard_Read_Legacy_Log(month, offset, batch + *batch_Len,
+                               batch_Size - *batch_Len);
+    sdCard_Give();
+
+    if (n == 0) {
+      break;
+    }
+    offset += n;
+
+    if (skip_Header) {
+      char *eol = memchr(batch + *batch_Len, '\n', n);
+
+      if (eol == NULL) {
+        continue;
+      }
+
+      skip_Header = 0;
+      n -= eol + 1 - (batch + *batch_Len);
+      memmove(batch + *batch_Len, eol + 1, n);
+    }
+
+    *batch_Len += n;
+
+    if (*batch_Len == batch_Size) {
+      if (!log_Query_Send(job, batch, *batch_Len)) {
+        return 0;
+      }
+      *batch_Len = 0;
+    }
+  }
+
+  return 1;
+}
+
+void task_Log_Query(void *pvParameter) {
+  log_query_job *job = &log_Query_Job;
+  log_query_filter *filter = &job->filter;
+  sdCard_Log_Segment_Header segments[12];
+  uint8_t order[12];
+  uint8_t n_segments = 0;
+  sdCard_Log_Record records[LOG_QUERY_READ_RECORDS];
+  char line[300];
+  char *batch = NULL;
+  size_t batch_Size = LOG_QUERY_MQTT_BATCH;
+  size_t batch_Len = 0;
+  size_t line_Len = 0;
+  uint32_t matched = 0;
+  uint8_t send_Error = 0;
+  int64_t start_time = esp_timer_get_time();
+
+  if (job->BLE_SMS_Indication == BLE_INDICATION) {
+    batch_Size = get_BLE_MTU_Size() - 3;
+  }
+
+  if (batch_Size > LOG_QUERY_BATCH_MAX) {
+    batch_Size = LOG_QUERY_BATCH_MAX;
+  }
+
+  batch = malloc(batch_Size + 1);
+
+  if (batch == NULL) {
+    log_Query_Running = 0;
+    vTaskDelete(NULL);
+  }
+
+  n_segments = log_Query_Plan(filter, segments, order);
+
+  batch_Len = sdCard_Render_Log_Header(batch, batch_Size + 1);
+
+  if (job->month_Export) {
+    send_Error = !log_Query_Send_Legacy(job, batch, batch_Size, &batch_Len);
+  }
+
+  for (uint8_t s = 0; s < n_segments && !send_Error; s++) {
+    sdCard_Log_Segment_Header *header = &segments[order[s]];
+    uint32_t index = 0;
+    uint16_t n = 0;
+    uint8_t done = 0;
+
+    /* com o relogio acertado para tras o segmento e lido todo, o
+       log_Query_Match filtra o intervalo */
+    if (!header->unordered && filter->from_epoch != 0 &&
+        header->first_epoch < filter->from_epoch) {
+      index = log_Query_Lower_Bound(header->month, header->count,
+                                    filter->from_epoch);
+    }
+
+    while (!done && !send_Error && index < header->count) {
+      if (log_Query_Cancel_Flag || !sdCard_Take()) {
+        send_Error = 1;
+        break;
+      }
+      n = sdCard_Read_Log_Records(header->month, index, records,
+                                  LOG_QUERY_READ_RECORDS);
+      sdCard_Give();
+
+      if (n == 0) {
+        break;
+      }
+      index += n;
+
+      for (uint16_t k = 0; k < n && !send_Error; k++) {
+        if (!header->unordered && filter->to_epoch != 0 &&
+            records[k].epoch > filter->to_epoch) {
+          done = 1;
+          break;
+        }
+
+        if (!log_Query_Match(&records[k], filter)) {
+          continue;
+        }
+
+        line_Len = sdCard_Render_Log_Record(&records[k], line, sizeof(line));
+
+        if (batch_Len + line_Len > batch_Size) {
+          send_Error = !log_Query_Send(job, batch, batch_Len);
+          batch_Len = 0;
+        }
+
+        if (line_Len > batch_Size) {
+          line_Len = batch_Size;
+        }
+
+        memcpy(batch + batch_Len, line, line_Len);
+        batch_Len += line_Len;
+        matched++;
+      }
+    }
+  }
+
+  // como no ficheiro CSV antigo, o ultimo bloco segue sem o '\n' final
+  if (!send_Error && batch_Len > 0) {
+    if (batch[batch_Len - 1] == '\n') {
+      batch_Len--;
+    }
+    send_Error = !log_Query_Send(job, batch, batch_Len);
+  }
+
+  if (!job->month_Export) {
+    snprintf(batch, batch_Size + 1, "ME G Q %s %lu",
+             log_Query_Cancel_Flag ? "CANCEL" : (send_Error ? "ERROR" : "END"),
+             (unsigned long)matched);
+    log_Query_Send(job, batch, strlen(batch));
+  }
+
+  ESP_LOGI("log_query", "%lu records in %lld ms", (unsigned long)matched,
+           (long long)((esp_timer_get_time() - start_time) / 1000));
+
+  free(batch);
+  log_Query_Running = 0;
+  vTaskDelete(NULL);
+}
+
+uint8_t log_Query_Submit(uint8_t BLE_SMS_Indication, uint8_t gattsIF,
+                         uint16_t connID, uint16_t handle_table,
+                         const log_query_filter *filter, uint8_t month_Export) {
+  if (log_Query_Running) {
+    return 0;
+  }
+
+  if (BLE_SMS_Indication != BLE_INDICATION &&
+      BLE_SMS_Indication != UDP_INDICATION) {
+    return 0;
+  }
+
+  log_Query_Running = 1;
+  log_Query_Cancel_Flag = 0;
+
+  log_Query_Job.BLE_SMS_Indication = BLE_SMS_Indication;
+  log_Query_Job.gattsIF = gattsIF;
+  log_Query_Job.connID = connID;
+  log_Query_Job.handle_table = handle_table;
+  log_Query_Job.month_Export = month_Export;
+  log_Query_Job.filter = *filter;
+
+  if (xTaskCreate(task_Log_Query, "task_Log_Query", 5 * 1024, NULL, 4, NULL) !=
+      pdPASS) {
+    log_Query_Running = 0;
+    return 0;
+  }
+
+  return 1;
+}
+
+void log_Query_Cancel() { log_Query_Cancel_Flag = 1; }
+
+uint8_t log_Query_Is_Running() { return log_Query_Running; }
@@ -0,0 +1,70 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _LOG_QUERY_H_
+#define _LOG_QUERY_H_
+
+#include <stdint.h>
+
+#include "sdCard.h"
+
+/*
+ * Consultas aos logs binarios (sdCard.c) feitas no equipamento. O pedido
+ * chega ao dispatch_LogFiles como
+ *
+ *   Q.<desde>.<ate>.<credencial>.<origem>.<resultado>
+ *
+ * com as datas em epoch, a origem em SDCARD_LOG_SOURCE_* e o resultado
+ * 0 (sem erro) ou 1 (com erro); '*' ou campo vazio aceita tudo. "C" cancela
+ * a consulta em curso. As linhas CSV que correspondem sao enviadas em
+ * blocos do tamanho do MTU (BLE) ou de LOG_QUERY_MQTT_BATCH (MQTT) e a
+ * consulta termina com "ME G Q END <n>".
+ */
+
+#define LOG_QUERY_ANY 0xFF
+#define LOG_QUERY_RESULT_OK 0
+#define LOG_QUERY_RESULT_ERROR 1
+
+#define LOG_QUERY_MQTT_BATCH 180
+#define LOG_QUERY_BATCH_MAX 512
+#define LOG_QUERY_READ_RECORDS 8
+
+typedef struct
+{
+  uint32_t from_epoch;
+  uint32_t to_epoch;
+  uint32_t cred_hash;
+  char cred_e164[PHONE_E164_SIZE];
+  uint8_t has_cred;
+  uint8_t source;
+  uint8_t result;
+  uint8_t month;
+
+} log_query_filter;
+
+uint8_t log_Query_Parse(char *payload, log_query_filter *filter);
+
+uint8_t log_Query_Match(const sdCard_Log_Record *record,
+                        const log_query_filter *filter);
+
+uint8_t log_Query_Plan(const log_query_filter *filter,
+                       sdCard_Log_Segment_Header *segments, uint8_t *order);
+
+uint32_t log_Query_Lower_Bound(uint8_t month, uint32_t count, uint32_t from);
+
+uint8_t log_Query_Submit(uint8_t BLE_SMS_Indication, uint8_t gattsIF,
+                         uint16_t connID, uint16_t handle_table,
+                         const log_query_filter *filter, uint8_t month_Export);
+
+void log_Query_Cancel();
+
+uint8_t log_Query_Is_Running();
+
+#endif
@@ -0,0 +1,48 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _LOG_RECORD_H_
+#define _LOG_RECORD_H_
+
+#include <stdint.h>
+
+/* registo dos segmentos /sdcard/MM.bin (sdCard.c), sem dependencias do
+   ESP-IDF para o log_upload e o host_test */
+
+#define SDCARD_LOG_SOURCE_NONE 0
+#define SDCARD_LOG_SOURCE_BLE 1
+#define SDCARD_LOG_SOURCE_SMS 2
+#define SDCARD_LOG_SOURCE_CALL 3
+#define SDCARD_LOG_SOURCE_WEB 4
+#define SDCARD_LOG_SOURCE_RF 5
+#define SDCARD_LOG_SOURCE_REX1 6
+#define SDCARD_LOG_SOURCE_REX2 7
+#define SDCARD_LOG_SOURCE_READER1 8
+#define SDCARD_LOG_SOURCE_READER2 9
+
+/* registo binario de tamanho fixo; result e uma mascara dos erros de
+   log_Error_Keys (sdCard.c) e cred_hash o FNV-1a do credencial completo */
+typedef struct __attribute__((packed))
+{
+  uint32_t epoch;
+  uint32_t cred_hash;
+  uint8_t source;
+  uint8_t relay;
+  uint8_t state;
+  uint8_t name_kind;
+  uint16_t result;
+  uint8_t month;
+  uint8_t reserved;
+  char credential[24];
+  char name[24];
+
+} sdCard_Log_Record;
+
+#endif
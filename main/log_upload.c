@@ -0,0 +1,479 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "log_upload.h"
+#include "core.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* to_epoch == 0: sem trabalho pendente; no automatico from_epoch e o
+   inicio do proximo */
+typedef struct
+{
+  uint32_t from_epoch;
+  uint32_t to_epoch;
+  uint32_t cursor_epoch;
+  uint32_t cursor_seq;
+
+} log_upload_job;
+
+#define LOG_UPLOAD_AUTO 0
+#define LOG_UPLOAD_MANUAL 1
+
+static const char *log_Upload_Keys[2][4] = {
+    {NVS_NETWORK_LOG_UPLOAD_FROM, NVS_NETWORK_LOG_UPLOAD_TO,
+     NVS_NETWORK_LOG_UPLOAD_EPOCH, NVS_NETWORK_LOG_UPLOAD_SEQ},
+    {NVS_NETWORK_LOG_MANUAL_FROM, NVS_NETWORK_LOG_MANUAL_TO,
+     NVS_NETWORK_LOG_MANUAL_EPOCH, NVS_NETWORK_LOG_MANUAL_SEQ},
+};
+
+static log_upload_job log_Upload_Jobs[2];
+static log_upload_stats log_Upload_Stats;
+static SemaphoreHandle_t log_Upload_Mutex;
+static TaskHandle_t log_Upload_Task;
+static volatile uint8_t log_Upload_Running = 0;
+static uint16_t log_Upload_Pending = 0;
+
+static void log_Upload_Save(uint8_t kind, log_upload_job *job) {
+  nvs_set_u32(nvs_System_handle, log_Upload_Keys[kind][0], job->from_epoch);
+  nvs_set_u32(nvs_System_handle, log_Upload_Keys[kind][1], job->to_epoch);
+  nvs_set_u32(nvs_System_handle, log_Upload_Keys[kind][2], job->cursor_epoch);
+  nvs_set_u32(nvs_System_handle, log_Upload_Keys[kind][3], job->cursor_seq);
+}
+
+static void log_Upload_Load(uint8_t kind, log_upload_job *job) {
+  memset(job, 0, sizeof(log_upload_job));
+
+  nvs_get_u32(nvs_System_handle, log_Upload_Keys[kind][0], &job->from_epoch);
+  nvs_get_u32(nvs_System_handle, log_Upload_Keys[kind][1], &job->to_epoch);
+  nvs_get_u32(nvs_System_handle, log_Upload_Keys[kind][2], &job->cursor_epoch);
+  nvs_get_u32(nvs_System_handle, log_Upload_Keys[kind][3], &job->cursor_seq);
+}
+
+/* envia os registos e, depois da confirmacao, avanca o cursor do trabalho
+   para (end_epoch, end_seq) */
+static uint8_t log_Upload_Chunk(uint8_t kind, log_upload_job *job,
+                                const char *imei, sdCard_Log_Record *records,
+                                uint16_t n, uint32_t end_epoch,
+                                uint32_t end_seq, uint8_t *chunk) {
+  log_upload_chunk_header *header = (log_upload_chunk_header *)chunk;
+  char url[200];
+  size_t raw_len = n * sizeof(sdCard_Log_Record);
+  size_t len = 0;
+  uint16_t http_Status = 0;
+  int64_t start_time = 0;
+
+  header->magic = LOG_UPLOAD_MAGIC;
+  header->version = LOG_UPLOAD_VERSION;
+  header->window_bits = LOG_UPLOAD_WINDOW_BITS;
+  header->length_bits = LOG_UPLOAD_LENGTH_BITS;
+  header->record_size = sizeof(sdCard_Log_Record);
+  header->cursor_epoch = job->cursor_epoch;
+  header->cursor_seq = job->cursor_seq;
+  header->count = n;
+  header->raw_len = raw_len;
+
+  len = log_Upload_Compress((uint8_t *)records, raw_len,
+                            chunk + sizeof(log_upload_chunk_header),
+                            LOG_UPLOAD_CHUNK_MAX -
+                                sizeof(log_upload_chunk_header));
+
+  if (len == 0) {
+    return 0;
+  }
+  len += sizeof(log_upload_chunk_header);
+
+  snprintf(url, sizeof(url), "%s?imei=%s&from=%lu&to=%lu&epoch=%lu&seq=%lu",
+           LOG_UPLOAD_URL, imei, (unsigned long)job->from_epoch,
+           (unsigned long)job->to_epoch, (unsigned long)job->cursor_epoch,
+           (unsigned long)job->cursor_seq);
+
+  for (uint8_t attempt = 0; attempt < LOG_UPLOAD_RETRIES; attempt++) {
+    start_time = esp_timer_get_time();
+
+    if (EG91_HTTP_Post(url, chunk, len, &http_Status) && http_Status >= 200 &&
+        http_Status < 300) {
+      uint32_t upload_ms = (esp_timer_get_time() - start_time) / 1000;
+
+      job->cursor_epoch = end_epoch;
+      job->cursor_seq = end_seq;
+
+      xSemaphoreTake(log_Upload_Mutex, portMAX_DELAY);
+      log_Upload_Stats.upload_ms += upload_ms;
+      log_Upload_Stats.records += n;
+      log_Upload_Stats.chunks++;
+      log_Upload_Stats.raw_bytes += raw_len;
+      log_Upload_Stats.compressed_bytes += len;
+      log_Upload_Jobs[kind].cursor_epoch = end_epoch;
+      log_Upload_Jobs[kind].cursor_seq = end_seq;
+      nvs_set_u32(nvs_System_handle, log_Upload_Keys[kind][2], end_epoch);
+      nvs_set_u32(nvs_System_handle, log_Upload_Keys[kind][3], end_seq);
+      xSemaphoreGive(log_Upload_Mutex);
+      return 1;
+    }
+
+    ESP_LOGW("log_upload", "cursor %lu.%lu http %d",
+             (unsigned long)job->cursor_epoch, (unsigned long)job->cursor_seq,
+             http_Status);
+    vTaskDelay(pdMS_TO_TICKS(LOG_UPLOAD_RETRY_MS));
+  }
+
+  xSemaphoreTake(log_Upload_Mutex, portMAX_DELAY);
+  log_Upload_Stats.failures++;
+  xSemaphoreGive(log_Upload_Mutex);
+
+  return 0;
+}
+
+static uint8_t log_Upload_Run(uint8_t kind, log_upload_job *job) {
+  log_query_filter filter;
+  sdCard_Log_Segment_Header segments[12];
+  uint8_t order[12];
+  uint8_t n_segments = 0;
+  sdCard_Log_Record records[LOG_QUERY_READ_RECORDS];
+  sdCard_Log_Record *raw = NULL;
+  uint8_t *chunk = NULL;
+  char imei[20] = {};
+  size_t required_size = sizeof(imei);
+  /* cursor onde a tentativa anterior ficou e cursor do ultimo registo
+     posto em raw */
+  uint32_t resume_epoch = job->cursor_epoch;
+  uint32_t resume_seq = job->cursor_seq;
+  uint32_t resume_seen = 0;
+  uint32_t last_epoch = job->cursor_epoch;
+  uint32_t last_seq = job->cursor_seq;
+  uint16_t n_raw = 0;
+  uint8_t error = 0;
+
+  memset(&filter, 0, sizeof(filter));
+  filter.from_epoch = job->from_epoch;
+  filter.to_epoch = job->to_epoch;
+  filter.source = LOG_QUERY_ANY;
+  filter.result = LOG_QUERY_ANY;
+
+  if (resume_epoch > filter.from_epoch) {
+    filter.from_epoch = resume_epoch;
+  }
+
+  if (nvs_get_str(nvs_System_handle, NVS_KEY_EG91_IMEI, imei,
+                  &required_size) != ESP_OK) {
+    return 0;
+  }
+
+  raw = malloc(LOG_UPLOAD_CHUNK_RAW);
+  chunk = malloc(LOG_UPLOAD_CHUNK_MAX);
+
+  if (raw == NULL || chunk == NULL) {
+    free(raw);
+    free(chunk);
+    return 0;
+  }
+
+  sdCard_Flush_LOGS();
+  n_segments = log_Query_Plan(&filter, segments, order);
+
+  for (uint8_t s = 0; s < n_segments && !error; s++) {
+    sdCard_Log_Segment_Header *header = &segments[order[s]];
+    uint32_t index = 0;
+    uint16_t n = 0;
+    uint8_t done = 0;
+
+    if (!header->unordered && filter.from_epoch != 0 &&
+        header->first_epoch < filter.from_epoch) {
+      index = log_Query_Lower_Bound(header->month, header->count,
+                                    filter.from_epoch);
+    }
+
+    while (!done && !error && index < header->count) {
+      if (!sdCard_Take()) {
+        error = 1;
+        break;
+      }
+      n = sdCard_Read_Log_Records(header->month, index, records,
+                                  LOG_QUERY_READ_RECORDS);
+      sdCard_Give();
+
+      if (n == 0) {
+        break;
+      }
+      index += n;
+
+      for (uint16_t k = 0; k < n && !error; k++) {
+        if (!header->unordered && records[k].epoch > filter.to_epoch) {
+          done = 1;
+          break;
+        }
+
+        if (!log_Query_Match(&records[k], &filter)) {
+          continue;
+        }
+
+        // os primeiros cursor_seq registos com o epoch do cursor ja foram
+        if (records[k].epoch == resume_epoch &&
+            resume_seen++ < resume_seq) {
+          continue;
+        }
+
+        if (records[k].epoch == last_epoch) {
+          last_seq++;
+        } else {
+          last_epoch = records[k].epoch;
+          last_seq = 1;
+        }
+
+        raw[n_raw++] = records[k];
+
+        if (n_raw == LOG_UPLOAD_CHUNK_RECORDS) {
+          error = !log_Upload_Chunk(kind, job, imei, raw, n_raw, last_epoch,
+                                    last_seq, chunk);
+          n_raw = 0;
+        }
+      }
+    }
+  }
+
+  if (!error && n_raw > 0) {
+    error = !log_Upload_Chunk(kind, job, imei, raw, n_raw, last_epoch,
+                              last_seq, chunk);
+  }
+
+  free(raw);
+  free(chunk);
+
+  return !error;
+}
+
+static void log_Upload_Report() {
+  char status[LOG_UPLOAD_STATUS_MAX];
+
+  log_Upload_Status(status, sizeof(status));
+  ESP_LOGI("log_upload", "%s", status);
+}
+
+void task_Log_Upload(void *pvParameter) {
+  log_upload_job job;
+  uint8_t kind = LOG_UPLOAD_AUTO;
+  time_t now;
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_UPLOAD_PERIOD_MS));
+
+    time(&now);
+
+    if (now < LOG_UPLOAD_MIN_EPOCH || !get_SDCard_Mounted()) {
+      continue;
+    }
+
+    xSemaphoreTake(log_Upload_Mutex, portMAX_DELAY);
+
+    if (log_Upload_Jobs[LOG_UPLOAD_MANUAL].to_epoch != 0) {
+      kind = LOG_UPLOAD_MANUAL;
+    } else {
+      log_upload_job *auto_Job = &log_Upload_Jobs[LOG_UPLOAD_AUTO];
+
+      kind = LOG_UPLOAD_AUTO;
+
+      if (auto_Job->to_epoch == 0) {
+        if (UDP_logs_label != 1) {
+          xSemaphoreGive(log_Upload_Mutex);
+          continue;
+        }
+
+        if (auto_Job->from_epoch == 0) {
+          // primeiro envio automatico: o historico so com "U.<desde>.<ate>"
+          auto_Job->from_epoch = now;
+          log_Upload_Save(LOG_UPLOAD_AUTO, auto_Job);
+        }
+
+        if (now - LOG_UPLOAD_SETTLE_S <= auto_Job->from_epoch) {
+          xSemaphoreGive(log_Upload_Mutex);
+          continue;
+        }
+
+        auto_Job->to_epoch = now - LOG_UPLOAD_SETTLE_S;
+        auto_Job->cursor_epoch = 0;
+        auto_Job->cursor_seq = 0;
+        log_Upload_Save(LOG_UPLOAD_AUTO, auto_Job);
+      }
+    }
+
+    job = log_Upload_Jobs[kind];
+    log_Upload_Running = 1;
+    log_Upload_Pending = 0;
+    xSemaphoreGive(log_Upload_Mutex);
+
+    if (log_Upload_Run(kind, &job)) {
+      if (kind == LOG_UPLOAD_AUTO) {
+        job.from_epoch = job.to_epoch + 1;
+      } else {
+        job.from_epoch = 0;
+      }
+      job.to_epoch = 0;
+      job.cursor_epoch = 0;
+      job.cursor_seq = 0;
+
+      // o outro trabalho pode estar pendente
+      xTaskNotifyGive(log_Upload_Task);
+    }
+
+    xSemaphoreTake(log_Upload_Mutex, portMAX_DELAY);
+    log_Upload_Jobs[kind] = job;
+    log_Upload_Save(kind, &job);
+    log_Upload_Running = 0;
+    xSemaphoreGive(log_Upload_Mutex);
+
+    log_Upload_Report();
+  }
+}
+
+void init_Log_Upload() {
+  log_Upload_Mutex = xSemaphoreCreateMutex();
+  log_Upload_Load(LOG_UPLOAD_AUTO, &log_Upload_Jobs[LOG_UPLOAD_AUTO]);
+  log_Upload_Load(LOG_UPLOAD_MANUAL, &log_Upload_Jobs[LOG_UPLOAD_MANUAL]);
+
+  xTaskCreate(task_Log_Upload, "task_Log_Upload", 8 * 1024, NULL, 4,
+              &log_Upload_Task);
+}
+
+/* trabalho manual; nao toca no cursor do automatico */
+uint8_t log_Upload_Submit(uint32_t from_epoch, uint32_t to_epoch) {
+  log_upload_job *manual = &log_Upload_Jobs[LOG_UPLOAD_MANUAL];
+  time_t now;
+
+  if (log_Upload_Task == NULL) {
+    return 0;
+  }
+
+  if (to_epoch == 0) {
+    time(&now);
+    to_epoch = now - LOG_UPLOAD_SETTLE_S;
+  }
+
+  if (to_epoch < from_epoch) {
+    return 0;
+  }
+
+  xSemaphoreTake(log_Upload_Mutex, portMAX_DELAY);
+
+  if (manual->to_epoch != 0) {
+    xSemaphoreGive(log_Upload_Mutex);
+    return 0;
+  }
+
+  manual->from_epoch = from_epoch;
+  manual->to_epoch = to_epoch;
+  manual->cursor_epoch = 0;
+  manual->cursor_seq = 0;
+  log_Upload_Save(LOG_UPLOAD_MANUAL, manual);
+  xSemaphoreGive(log_Upload_Mutex);
+
+  xTaskNotifyGive(log_Upload_Task);
+
+  return 1;
+}
+
+/* chamado pelo task_SDCard_Log_Writer por cada registo guardado */
+void log_Upload_Notify_Record() {
+  if (log_Upload_Task == NULL) {
+    return;
+  }
+
+  xSemaphoreTake(log_Upload_Mutex, portMAX_DELAY);
+  if (++log_Upload_Pending < LOG_UPLOAD_CHUNK_RECORDS) {
+    xSemaphoreGive(log_Upload_Mutex);
+    return;
+  }
+  log_Upload_Pending = 0;
+  xSemaphoreGive(log_Upload_Mutex);
+
+  xTaskNotifyGive(log_Upload_Task);
+}
+
+static const char *log_Upload_State(const log_upload_job *jobs,
+                                    uint8_t running, uint8_t kind) {
+  if (jobs[kind].to_epoch == 0) {
+    return "IDLE";
+  }
+
+  // o manual corre sempre primeiro
+  if (running &&
+      (kind == LOG_UPLOAD_MANUAL || jobs[LOG_UPLOAD_MANUAL].to_epoch == 0)) {
+    return "RUN";
+  }
+
+  return "PEND";
+}
+
+size_t log_Upload_Status(char *out, size_t out_size) {
+  log_upload_stats snapshot;
+  log_upload_job jobs[2];
+  log_upload_stats *stats = &snapshot;
+  log_upload_job *auto_Job = &jobs[LOG_UPLOAD_AUTO];
+  log_upload_job *manual = &jobs[LOG_UPLOAD_MANUAL];
+  uint8_t running = 0;
+  uint32_t ratio = 0;
+  uint32_t throughput = 0;
+  int len = 0;
+
+  if (log_Upload_Mutex == NULL) {
+    return 0;
+  }
+
+  xSemaphoreTake(log_Upload_Mutex, portMAX_DELAY);
+  snapshot = log_Upload_Stats;
+  memcpy(jobs, log_Upload_Jobs, sizeof(jobs));
+  running = log_Upload_Running;
+  xSemaphoreGive(log_Upload_Mutex);
+
+  // ratio em centesimas (250 = 2.5:1), debito em bytes/s enviados
+  if (stats->compressed_bytes > 0) {
+    ratio = (uint64_t)stats->raw_bytes * 100 / stats->compressed_bytes;
+  }
+
+  if (stats->upload_ms > 0) {
+    throughput = (uint64_t)stats->compressed_bytes * 1000 / stats->upload_ms;
+  }
+
+  // "A:" automatico e "M:" manual, estado.desde.ate.epoch.seq
+  len = snprintf(
+      out, out_size,
+      "ME G U A:%s.%lu.%lu.%lu.%lu M:%s.%lu.%lu.%lu.%lu %lu %lu %lu %lu %lu",
+      log_Upload_State(jobs, running, LOG_UPLOAD_AUTO),
+      (unsigned long)auto_Job->from_epoch,
+      (unsigned long)auto_Job->to_epoch, (unsigned long)auto_Job->cursor_epoch,
+      (unsigned long)auto_Job->cursor_seq,
+      log_Upload_State(jobs, running, LOG_UPLOAD_MANUAL),
+      (unsigned long)manual->from_epoch, (unsigned long)manual->to_epoch,
+      (unsigned long)manual->cursor_epoch, (unsigned long)manual->cursor_seq,
+      (unsigned long)stats->records, (unsigned long)stats->raw_bytes,
+      (unsigned long)stats->compressed_bytes, (unsigned long)ratio,
+      (unsigned long)throughput);
+
+  if (len < 0) {
+    return 0;
+  }
+
+  return (size_t)len < out_size ? (size_t)len : out_size - 1;
+}
+
+void get_Log_Upload_Stats(log_upload_stats *stats) {
+  if (log_Upload_Mutex == NULL) {
+    memset(stats, 0, sizeof(log_upload_stats));
+    return;
+  }
+
+  xSemaphoreTake(log_Upload_Mutex, portMAX_DELAY);
+  *stats = log_Upload_Stats;
+  xSemaphoreGive(log_Upload_Mutex);
+}
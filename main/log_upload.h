@@ -0,0 +1,104 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _LOG_UPLOAD_H_
+#define _LOG_UPLOAD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "log_lzss.h"
+#include "log_query.h"
+
+/*
+ * Envio em bloco dos logs binarios (sdCard.c) para o portal pelo cliente
+ * HTTP(S) do modem, em vez de uma publicacao MQTT por evento. Cada pedido
+ * POST leva ate LOG_UPLOAD_CHUNK_RECORDS registos:
+ *
+ *   [log_upload_chunk_header][registos comprimidos]
+ *
+ * A compressao e o LZSS do log_lzss.c, reiniciado em cada bloco.
+ *
+ * O trabalho (desde, ate, cursor) fica no NVS. O cursor e o epoch do
+ * ultimo registo confirmado pelo servidor e quantos registos com esse
+ * epoch ja foram enviados; um corte a meio retoma no registo seguinte,
+ * mesmo que entretanto tenham entrado registos atrasados. Em segmentos
+ * com o relogio acertado para tras (unordered) os registos mais antigos
+ * que o cursor sao dados como enviados.
+ *
+ * Ha dois trabalhos independentes: o automatico, que com o envio de logs
+ * ativo (UDP_logs_label) comeca onde o anterior acabou, e o pedido a mao,
+ * que corre primeiro e nao mexe no cursor do automatico. No
+ * dispatch_LogFiles:
+ *
+ *   U.<desde>.<ate>   novo trabalho manual (ate vazio ou '*' = agora),
+ *                     recusado com outro manual pendente
+ *   U                 estado e estatisticas
+ */
+
+#define LOG_UPLOAD_URL "https://api.mconnect.motorline.pt/m200/logs"
+
+#define LOG_UPLOAD_MAGIC 0x4C5A4C4D
+#define LOG_UPLOAD_VERSION 2
+
+#define LOG_UPLOAD_CHUNK_RECORDS 32
+#define LOG_UPLOAD_CHUNK_RAW                                                   \
+  (LOG_UPLOAD_CHUNK_RECORDS * sizeof(sdCard_Log_Record))
+/* pior caso: todos literais, 9 bits por byte */
+#define LOG_UPLOAD_CHUNK_MAX                                                   \
+  (sizeof(log_upload_chunk_header) + LOG_UPLOAD_CHUNK_RAW +                    \
+   LOG_UPLOAD_CHUNK_RAW / 8 + 1)
+
+#define LOG_UPLOAD_PERIOD_MS (5 * 60 * 1000)
+#define LOG_UPLOAD_RETRY_MS 5000
+#define LOG_UPLOAD_RETRIES 3
+/* segundos de margem para os registos ainda na fila do sdCard */
+#define LOG_UPLOAD_SETTLE_S 5
+/* sem hora valida nao ha trabalho automatico (2023-01-01) */
+#define LOG_UPLOAD_MIN_EPOCH 1672531200
+
+#define LOG_UPLOAD_STATUS_MAX 200
+
+typedef struct __attribute__((packed))
+{
+  uint32_t magic;
+  uint8_t version;
+  uint8_t window_bits;
+  uint8_t length_bits;
+  uint8_t record_size;
+  uint32_t cursor_epoch;
+  uint32_t cursor_seq;
+  uint16_t count;
+  uint16_t raw_len;
+
+} log_upload_chunk_header;
+
+typedef struct
+{
+  uint32_t records;
+  uint32_t chunks;
+  uint32_t raw_bytes;
+  uint32_t compressed_bytes;
+  uint32_t upload_ms;
+  uint32_t failures;
+
+} log_upload_stats;
+
+void init_Log_Upload();
+
+uint8_t log_Upload_Submit(uint32_t from_epoch, uint32_t to_epoch);
+
+void log_Upload_Notify_Record();
+
+size_t log_Upload_Status(char *out, size_t out_size);
+
+void get_Log_Upload_Stats(log_upload_stats *stats);
+
+#endif
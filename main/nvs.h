@@ -32,6 +32,7 @@
 #define NVS_RF_CODES_OWNER_NAMESPACE        "RF_O_NAMESPACE"
 
 #define NVS_WIEGAND_ANTIPASSBACK_NAMESPACE  "W_AP_NAMESPACE"
+#define NVS_PHONE_INDEX_NAMESPACE           "PH_NAMESPACE"
 
 
 
@@ -82,6 +83,8 @@
 #define NVS_AL_CHANGE_INPUT_STATE_FEEDBACK  "NVS_AL_I_S_FB"
 
 #define NVS_ROUTINES_ID                     "NVS_RT_ID"
+#define NVS_ROUTINES_BLOB                   "NVS_RT_BLOB"
+#define NVS_ROUTINES_BLOB_PAGE              "NVS_RT_BP%02u"
 #define NVS_ROUTINES_RANGE_T0               "NVS_RT_RG_T0"
 #define NVS_ROUTINES_RANGE_T1               "NVS_RT_RG_T1"
 #define NVS_KEY_ROUTINE1_LABEL              "NVS_RT_1_LB"
@@ -105,6 +108,7 @@
 #define NVS_KEY_DATE_PERIODIC_SMS           "NVS_D_P_SMS"
 
 #define NVS_KEY_OWN_NUMBER                  "NVS_OWN_NUMBER"
+#define NVS_KEY_DEFAULT_COUNTRY             "NVS_DEF_COUNTRY"
 
 #define NVS_KEY_SDCARD_RESET                "NVS_SD_RESET"
 
@@ -137,17 +141,38 @@
 #define NVS_KEY_LABEL_EASTER                "NVS_LB_EAS" 
 #define NVS_KEY_LABEL_CORPUS_CHRISTI        "NVS_LB_C_CH" 
 #define NVS_KEY_LABEL_EASTER_MONDAY         "NVS_LB_E_MN" 
+#define NVS_HOLIDAYS_BLOB                   "NVS_MH_BLOB"
 
 #define NVS_KEY_OLD_YEAR                    "NVS_OLD_YEAR"
 
 #define NVS_KEY_RELAY1_LAST_VALUE           "NVS_R1_L_V"
 #define NVS_KEY_RELAY2_LAST_VALUE           "NVS_R2_L_V"
+#define NVS_KEY_RELAY_INTERLOCK             "NVS_R_INTLK"
+
+/* chaves do diario de estado (particao journal), antes nas chaves NVS
+   NVS_KEY_RELAYx_LAST_VALUE, NVS_KEY_ROUTINEx_LABEL e NVS_KEY_ROUTINEx_TIME_ON */
+#define STATE_JOURNAL_PARTITION             "journal"
+#define STATE_KEY_RELAY1_LAST_VALUE         0
+#define STATE_KEY_RELAY2_LAST_VALUE         1
+#define STATE_KEY_ROUTINE1_LABEL            2
+#define STATE_KEY_ROUTINE2_LABEL            3
+#define STATE_KEY_ROUTINE1_TIME_ON          4
+#define STATE_KEY_ROUTINE2_TIME_ON          5
+#define STATE_KEY_COUNT                     6
 
 #define NVS_ROUTINES_HOLIDAYS_RANGE_T1      "NVS_RT_R_H_T1"
 #define NVS_ROUTINES_HOLIDAYS_RANGE_T2      "NVS_RT_R_H_T2"
 
 #define NVS_NETWORK_PORTAL_REGISTER         "NVS_NT_P_REG"
 #define NVS_NETWORK_LABEL_SEND_LOGS         "NVS_NT_S_LOG"
+#define NVS_NETWORK_LOG_UPLOAD_FROM         "NVS_NT_LU_F"
+#define NVS_NETWORK_LOG_UPLOAD_TO           "NVS_NT_LU_T"
+#define NVS_NETWORK_LOG_UPLOAD_EPOCH        "NVS_NT_LU_E"
+#define NVS_NETWORK_LOG_UPLOAD_SEQ          "NVS_NT_LU_S"
+#define NVS_NETWORK_LOG_MANUAL_FROM         "NVS_NT_LM_F"
+#define NVS_NETWORK_LOG_MANUAL_TO           "NVS_NT_LM_T"
+#define NVS_NETWORK_LOG_MANUAL_EPOCH        "NVS_NT_LM_E"
+#define NVS_NETWORK_LOG_MANUAL_SEQ          "NVS_NT_LM_S"
 
 #define NVS_NETWORK_LOCAL_CHANGED           "NVS_NT_L_C"
 
@@ -179,6 +204,8 @@
 
 #define NVS_INPUT_REX_VALUE                   "NVS_I_R_VAL"
 
+#define NVS_INPUT_RULES                       "NVS_I_RULES"
+
 
 
 
@@ -0,0 +1,114 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "phone_e164.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Regras de normalizacao para E.164:
+ *  - espacos, '-', '.', '(' e ')' sao ignorados
+ *  - "+CC..." e "00CC..." ja sao internacionais
+ *  - sem prefixo, se comecar pelo indicativo por defeito e tiver mais 8
+ *    digitos e tratado como internacional (CLIP sem '+')
+ *  - senao e nacional: perde um '0' de tronco e leva o indicativo por defeito
+ * Chaves de wiegand ('$') e RF ('&') ou numeros com menos de 6 ou mais de 15 digitos
+ * nao sao numeros de telefone e devolvem 0.
+ */
+uint8_t phone_Normalize_E164(const char *phoneNumber, const char *countryCode, char *e164) {
+  char digits[24] = {};
+  char country[8] = {};
+  char *national = digits;
+  uint8_t n_digits = 0;
+  uint8_t n_country = 0;
+  uint8_t international = 0;
+
+  for (size_t i = 0; phoneNumber[i] != 0; i++) {
+    if (phoneNumber[i] >= '0' && phoneNumber[i] <= '9') {
+      if (n_digits == sizeof(digits) - 1) {
+        return 0;
+      }
+      digits[n_digits++] = phoneNumber[i];
+    } else if (phoneNumber[i] == '+' && i == 0) {
+      international = 1;
+    } else if (phoneNumber[i] != ' ' && phoneNumber[i] != '-' &&
+               phoneNumber[i] != '.' && phoneNumber[i] != '(' &&
+               phoneNumber[i] != ')') {
+      return 0;
+    }
+  }
+
+  for (const char *c = countryCode; *c != 0; c++) {
+    if (*c >= '0' && *c <= '9') {
+      if (n_country == sizeof(country) - 1) {
+        return 0;
+      }
+      country[n_country++] = *c;
+    }
+  }
+
+  if (!international && digits[0] == '0' && digits[1] == '0') {
+    international = 1;
+    national = digits + 2;
+  } else if (!international && n_country > 0 &&
+             !strncmp(digits, country, n_country) &&
+             n_digits > n_country + 8) {
+    international = 1;
+  }
+
+  if (international) {
+    if (strlen(national) > PHONE_E164_SIZE - 2) {
+      return 0;
+    }
+
+    sprintf(e164, "+%s", national);
+  } else {
+    if (n_country == 0) {
+      return 0;
+    }
+
+    if (digits[0] == '0') {
+      national = digits + 1;
+    }
+
+    if (strlen(national) + n_country > PHONE_E164_SIZE - 2) {
+      return 0;
+    }
+
+    sprintf(e164, "+%s%s", country, national);
+  }
+
+  if (strlen(e164) < 7) {
+    return 0;
+  }
+
+  return 1;
+}
+
+/* dois digitos por octeto, o primeiro no nibble alto, completado com 0xF */
+uint8_t phone_E164_To_BCD(const char *e164, uint8_t *bcd) {
+  uint8_t n = 0;
+
+  memset(bcd, 0xFF, PHONE_BCD_SIZE);
+
+  for (size_t i = (e164[0] == '+'); e164[i] != 0; i++, n++) {
+    if (e164[i] < '0' || e164[i] > '9' || n == PHONE_BCD_SIZE * 2) {
+      return 0;
+    }
+
+    if (n % 2) {
+      bcd[n / 2] = (bcd[n / 2] & 0xF0) | (e164[i] - '0');
+    } else {
+      bcd[n / 2] = ((e164[i] - '0') << 4) | 0x0F;
+    }
+  }
+
+  return n > 0;
+}
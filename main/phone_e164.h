@@ -0,0 +1,28 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _PHONE_E164_H_
+#define _PHONE_E164_H_
+
+#include <stdint.h>
+
+/* numero canonico E.164 ("+" e ate 15 digitos) e a sua forma BCD */
+#define PHONE_E164_SIZE 17
+#define PHONE_BCD_SIZE 8
+
+/*
+ * Normaliza um numero para E.164 usando o indicativo por defeito dado
+ * (ex.: "351" ou "1-868", o '-' e ignorado). Nao depende do NVS, o
+ * indicativo guardado e passado pelo phone_Canonicalize_E164 do core.
+ */
+uint8_t phone_Normalize_E164(const char *phoneNumber, const char *countryCode, char *e164);
+uint8_t phone_E164_To_BCD(const char *e164, uint8_t *bcd);
+
+#endif
@@ -0,0 +1,264 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "relay_engine.h"
+#include <string.h>
+
+static void push_Event(relay_engine *engine, uint8_t channel, uint8_t type,
+                       uint8_t level) {
+  relay_engine_event *event = NULL;
+
+  if (engine->event_count == RELAY_ENGINE_EVENTS) {
+    engine->events_lost++;
+    return;
+  }
+
+  event = &engine->events[(engine->event_first + engine->event_count) %
+                          RELAY_ENGINE_EVENTS];
+  event->channel = channel;
+  event->type = type;
+  event->level = level;
+  engine->event_count++;
+}
+
+static void set_Output(relay_channel *channel, uint8_t level) {
+  channel->level = level;
+  channel->engine->output(channel->index, level, channel->engine->ctx);
+}
+
+/* escrita diferida: so o ultimo valor de uma rajada de mudancas chega a NVS */
+static void persist_Level(relay_channel *channel, uint8_t level) {
+  channel->persist_level = level;
+
+  if (level == channel->persisted) {
+    timer_Wheel_Cancel(&channel->engine->wheel, &channel->persist_timer);
+  } else {
+    timer_Wheel_Add(&channel->engine->wheel, &channel->persist_timer,
+                    channel->engine->persist_delay);
+  }
+}
+
+static void stop_Pulse(relay_channel *channel) {
+  timer_Wheel_Cancel(&channel->engine->wheel, &channel->pulse_timer);
+  channel->pulsing = 0;
+  channel->train_left = 0;
+}
+
+static void release_Interlock(relay_channel *channel) {
+  relay_channel *other = NULL;
+
+  if (channel->interlock == RELAY_ENGINE_NONE) {
+    return;
+  }
+
+  other = &channel->engine->channels[channel->interlock];
+
+  if (other->level || other->pulsing) {
+    stop_Pulse(other);
+    set_Output(other, 0);
+    persist_Level(other, 0);
+    push_Event(channel->engine, other->index, RELAY_EVENT_INTERLOCK, 0);
+  }
+}
+
+static void pulse_Expired(timer_wheel_timer *timer, void *ctx) {
+  relay_channel *channel = (relay_channel *)ctx;
+
+  if (channel->level) {
+    set_Output(channel, 0);
+    channel->train_left--;
+
+    if (channel->train_left > 0) {
+      timer_Wheel_Add(&channel->engine->wheel, timer, channel->off_ticks);
+      return;
+    }
+
+    channel->pulsing = 0;
+    push_Event(channel->engine, channel->index, RELAY_EVENT_PULSE_END, 0);
+  } else {
+    release_Interlock(channel);
+    set_Output(channel, 1);
+    timer_Wheel_Add(&channel->engine->wheel, timer, channel->on_ticks);
+  }
+}
+
+static void schedule_Expired(timer_wheel_timer *timer, void *ctx) {
+  relay_channel *channel = (relay_channel *)ctx;
+
+  relay_Engine_Set(channel->engine, channel->index, channel->schedule_level);
+  push_Event(channel->engine, channel->index, RELAY_EVENT_SCHEDULED,
+             channel->schedule_level);
+}
+
+static void persist_Expired(timer_wheel_timer *timer, void *ctx) {
+  relay_channel *channel = (relay_channel *)ctx;
+
+  channel->persisted = channel->persist_level;
+  push_Event(channel->engine, channel->index, RELAY_EVENT_PERSIST,
+             channel->persisted);
+}
+
+void relay_Engine_Init(relay_engine *engine, uint32_t now,
+                       uint32_t persist_delay, relay_engine_output output,
+                       void *ctx) {
+  memset(engine, 0, sizeof(relay_engine));
+  timer_Wheel_Init(&engine->wheel, now);
+  engine->persist_delay = persist_delay;
+  engine->output = output;
+  engine->ctx = ctx;
+
+  for (uint8_t i = 0; i < RELAY_ENGINE_CHANNELS; i++) {
+    relay_channel *channel = &engine->channels[i];
+
+    channel->engine = engine;
+    channel->index = i;
+    channel->interlock = RELAY_ENGINE_NONE;
+    timer_Wheel_Timer_Init(&channel->pulse_timer, pulse_Expired, channel);
+    timer_Wheel_Timer_Init(&channel->schedule_timer, schedule_Expired, channel);
+    timer_Wheel_Timer_Init(&channel->persist_timer, persist_Expired, channel);
+  }
+}
+
+void relay_Engine_Restore(relay_engine *engine, uint8_t channel, uint8_t level,
+                          uint8_t persisted) {
+  if (channel < RELAY_ENGINE_CHANNELS) {
+    engine->channels[channel].level = level;
+    engine->channels[channel].persisted = persisted;
+    engine->channels[channel].persist_level = persisted;
+  }
+}
+
+void relay_Engine_Interlock(relay_engine *engine, uint8_t channel,
+                            uint8_t other) {
+  if (channel >= RELAY_ENGINE_CHANNELS) {
+    return;
+  }
+
+  if (engine->channels[channel].interlock != RELAY_ENGINE_NONE) {
+    engine->channels[engine->channels[channel].interlock].interlock =
+        RELAY_ENGINE_NONE;
+  }
+  engine->channels[channel].interlock = RELAY_ENGINE_NONE;
+
+  if (other < RELAY_ENGINE_CHANNELS && other != channel) {
+    relay_Engine_Interlock(engine, other, RELAY_ENGINE_NONE);
+    engine->channels[channel].interlock = other;
+    engine->channels[other].interlock = channel;
+  }
+}
+
+void relay_Engine_Set(relay_engine *engine, uint8_t channel, uint8_t level) {
+  if (channel >= RELAY_ENGINE_CHANNELS) {
+    return;
+  }
+
+  stop_Pulse(&engine->channels[channel]);
+
+  if (level) {
+    release_Interlock(&engine->channels[channel]);
+  }
+
+  set_Output(&engine->channels[channel], level);
+  persist_Level(&engine->channels[channel], level);
+}
+
+void relay_Engine_Persist(relay_engine *engine, uint8_t channel,
+                          uint8_t level) {
+  if (channel >= RELAY_ENGINE_CHANNELS) {
+    return;
+  }
+
+  persist_Level(&engine->channels[channel], level);
+}
+
+void relay_Engine_Pulse(relay_engine *engine, uint8_t channel,
+                        uint32_t on_ticks) {
+  relay_Engine_Train(engine, channel, 1, on_ticks, 0);
+}
+
+void relay_Engine_Train(relay_engine *engine, uint8_t channel, uint16_t count,
+                        uint32_t on_ticks, uint32_t off_ticks) {
+  relay_channel *ch = NULL;
+
+  if (channel >= RELAY_ENGINE_CHANNELS || count == 0) {
+    return;
+  }
+
+  ch = &engine->channels[channel];
+
+  ch->train_left = count;
+  ch->on_ticks = on_ticks;
+  ch->off_ticks = off_ticks;
+
+  /* redisparo: com o rele ligado o tempo volta a contar do inicio, na fase
+     desligada de um trem so o numero de impulsos e reposto */
+  if (ch->pulsing) {
+    if (ch->level) {
+      timer_Wheel_Add(&engine->wheel, &ch->pulse_timer, on_ticks);
+    }
+    push_Event(engine, channel, RELAY_EVENT_PULSE_RENEWED, ch->level);
+    return;
+  }
+
+  release_Interlock(ch);
+  set_Output(ch, 1);
+  ch->pulsing = 1;
+  timer_Wheel_Add(&engine->wheel, &ch->pulse_timer, on_ticks);
+  push_Event(engine, channel, RELAY_EVENT_PULSE_START, 1);
+
+  /* um rele em impulso arranca sempre desligado */
+  persist_Level(ch, 0);
+}
+
+void relay_Engine_Schedule(relay_engine *engine, uint8_t channel,
+                           uint8_t level, uint32_t delay) {
+  if (channel < RELAY_ENGINE_CHANNELS) {
+    engine->channels[channel].schedule_level = level;
+    timer_Wheel_Add(&engine->wheel, &engine->channels[channel].schedule_timer,
+                    delay);
+  }
+}
+
+void relay_Engine_Cancel_Schedule(relay_engine *engine, uint8_t channel) {
+  if (channel < RELAY_ENGINE_CHANNELS) {
+    timer_Wheel_Cancel(&engine->wheel,
+                       &engine->channels[channel].schedule_timer);
+  }
+}
+
+uint8_t relay_Engine_Level(const relay_engine *engine, uint8_t channel) {
+  return channel < RELAY_ENGINE_CHANNELS ? engine->channels[channel].level : 0;
+}
+
+uint8_t relay_Engine_Is_Pulsing(const relay_engine *engine, uint8_t channel) {
+  return channel < RELAY_ENGINE_CHANNELS ? engine->channels[channel].pulsing
+                                         : 0;
+}
+
+void relay_Engine_Advance(relay_engine *engine, uint32_t now) {
+  timer_Wheel_Advance(&engine->wheel, now);
+}
+
+uint32_t relay_Engine_Next(const relay_engine *engine) {
+  return timer_Wheel_Next(&engine->wheel);
+}
+
+uint8_t relay_Engine_Pop_Event(relay_engine *engine,
+                               relay_engine_event *event) {
+  if (engine->event_count == 0) {
+    return 0;
+  }
+
+  *event = engine->events[engine->event_first];
+  engine->event_first = (engine->event_first + 1) % RELAY_ENGINE_EVENTS;
+  engine->event_count--;
+
+  return 1;
+}
@@ -0,0 +1,134 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _RELAY_ENGINE_H_
+#define _RELAY_ENGINE_H_
+
+#include <stdint.h>
+
+#include "timer_wheel.h"
+
+/*
+ * Motor dos reles sobre uma roda de temporizadores (timer_wheel.h). Cada
+ * canal (R1, R2 e reles de placas de expansao) tem um temporizador de
+ * impulso, um de acao agendada e um de escrita da ultima posicao:
+ *
+ *  - impulso: liga e desliga passado o tempo, um novo impulso com o rele
+ *    ainda ligado volta a contar o tempo todo (RELAY_EVENT_PULSE_RENEWED);
+ *  - trem de impulsos: N impulsos com tempos de ligado e desligado;
+ *  - encravamento: dois canais nunca ligados ao mesmo tempo, ligar um
+ *    desliga o outro (RELAY_EVENT_INTERLOCK);
+ *  - acao agendada: liga ou desliga daqui a N ticks;
+ *  - a posicao a guardar em NVS so e pedida (RELAY_EVENT_PERSIST) depois de
+ *    persist_delay ticks sem mudancas e se for diferente da ja guardada.
+ *
+ * A saida fisica e escrita pelo callback output dentro das chamadas. Os
+ * eventos ficam numa fila para quem usa o motor os tratar fora do trinco
+ * (avisos BLE, UDP e SMS). Antes de cada chamada o motor tem de ser levado
+ * ao tick atual com relay_Engine_Advance, os tempos contam a partir dai.
+ *
+ * O modulo nao depende de NVS nem de FreeRTOS.
+ */
+
+#define RELAY_ENGINE_CHANNELS 4
+#define RELAY_ENGINE_EVENTS 16
+#define RELAY_ENGINE_NONE 0xFF
+
+#define RELAY_EVENT_PULSE_START 0
+#define RELAY_EVENT_PULSE_RENEWED 1
+#define RELAY_EVENT_PULSE_END 2
+#define RELAY_EVENT_SCHEDULED 3
+#define RELAY_EVENT_INTERLOCK 4
+#define RELAY_EVENT_PERSIST 5
+
+typedef void (*relay_engine_output)(uint8_t channel, uint8_t level, void *ctx);
+
+typedef struct
+{
+  uint8_t channel;
+  uint8_t type;
+  uint8_t level;
+
+} relay_engine_event;
+
+typedef struct relay_engine relay_engine;
+
+typedef struct
+{
+  relay_engine *engine;
+  uint8_t index;
+  uint8_t level;
+  uint8_t pulsing;
+  uint8_t interlock;
+  uint8_t schedule_level;
+  uint8_t persist_level;
+  uint8_t persisted;
+  uint16_t train_left;
+  uint32_t on_ticks;
+  uint32_t off_ticks;
+  timer_wheel_timer pulse_timer;
+  timer_wheel_timer schedule_timer;
+  timer_wheel_timer persist_timer;
+
+} relay_channel;
+
+struct relay_engine
+{
+  timer_wheel wheel;
+  relay_channel channels[RELAY_ENGINE_CHANNELS];
+  uint32_t persist_delay;
+  relay_engine_output output;
+  void *ctx;
+  relay_engine_event events[RELAY_ENGINE_EVENTS];
+  uint8_t event_first;
+  uint8_t event_count;
+  uint16_t events_lost;
+};
+
+void relay_Engine_Init(relay_engine *engine, uint32_t now,
+                       uint32_t persist_delay, relay_engine_output output,
+                       void *ctx);
+
+/* estado lido no arranque, nao escreve a saida */
+void relay_Engine_Restore(relay_engine *engine, uint8_t channel, uint8_t level,
+                          uint8_t persisted);
+
+void relay_Engine_Interlock(relay_engine *engine, uint8_t channel,
+                            uint8_t other);
+
+void relay_Engine_Set(relay_engine *engine, uint8_t channel, uint8_t level);
+
+/* pede a escrita de um valor sem mexer na saida (mudanca de modo) */
+void relay_Engine_Persist(relay_engine *engine, uint8_t channel,
+                          uint8_t level);
+
+void relay_Engine_Pulse(relay_engine *engine, uint8_t channel,
+                        uint32_t on_ticks);
+
+void relay_Engine_Train(relay_engine *engine, uint8_t channel, uint16_t count,
+                        uint32_t on_ticks, uint32_t off_ticks);
+
+void relay_Engine_Schedule(relay_engine *engine, uint8_t channel,
+                           uint8_t level, uint32_t delay);
+
+void relay_Engine_Cancel_Schedule(relay_engine *engine, uint8_t channel);
+
+uint8_t relay_Engine_Level(const relay_engine *engine, uint8_t channel);
+
+uint8_t relay_Engine_Is_Pulsing(const relay_engine *engine, uint8_t channel);
+
+void relay_Engine_Advance(relay_engine *engine, uint32_t now);
+
+/* ticks ate ao proximo temporizador ou TIMER_WHEEL_NONE */
+uint32_t relay_Engine_Next(const relay_engine *engine);
+
+uint8_t relay_Engine_Pop_Event(relay_engine *engine, relay_engine_event *event);
+
+#endif
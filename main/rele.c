@@ -18,6 +18,7 @@
 #include "erro_list.h"
 #include "esp_gatts_api.h"
 
+#include "relay_engine.h"
 #include "routines.h"
 #include "sdCard.h"
 #include "stdlib.h"
@@ -25,8 +26,10 @@
 char sdCard_log_relay[100];
 char file_RSP[100] = {};
 
-TaskHandle_t rele1_Bistate_Task_Handle;
-TaskHandle_t rele2_Bistate_Task_Handle;
+TaskHandle_t relay_Engine_Task_Handle;
+
+/* o ultimo valor so vai para a flash quando o rele fica parado este tempo */
+#define RELAY_PERSIST_DELAY_MS 5000
 
 uint8_t rele1_Mode_Label;
 int rele1_Bistate_Time;
@@ -36,346 +39,233 @@ int rele2_Bistate_Time;
 extern SemaphoreHandle_t rdySem_Control_IncomingCALL;
 uint8_t rele1_Restriction;
 
-void task_BiState_Send_RelayState2(void *pvParameter) {
-  queue_BLE_Parameters2 =
-      xQueueCreate(1, sizeof(/* rsp */ data_BLE_Send_RelayState));
-  // //////printf("\nenter task_BiState_Send_RelayState2\n");
-  data_BLE_Send_RelayState
-      cpy_message; //= (data_BLE_Send_RelayState *)pvParameter;
-  char teste[200];
-  data_BLE_Send_RelayState cpy_cpy_message;
-
-  // rdySem_Control_Send_RelayState2 = xSemaphoreCreateBinary();
-  for (;;) {
-    // ////printf("\nenter task_BiState_Send_RelayState2\n");
-    memset(&cpy_message, 0, sizeof(cpy_message));
-    memset(&cpy_cpy_message, 0, sizeof(cpy_cpy_message));
-    if (xQueueReceive(queue_BLE_Parameters2, /* &teste */ &(cpy_cpy_message),
-                      portMAX_DELAY)) {
-      // //printf("\nsemaphore give 111\n");
-      cpy_message = cpy_cpy_message;
-      label_MonoStableRelay2 = 1;
-
-      save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, 0,
-                                nvs_System_handle);
-      if (cpy_message.relaynumber == RELE2_NUMBER) {
-        if (cpy_message.BLE_SMS_INDICATION != SMS_INDICATION) {
-          gpio_set_level(GPIO_OUTPUT_IO_1, 1);
-          sprintf(cpy_message.payload, "%s %c %c %d", RELE2_ELEMENT, SET_CMD,
-                  RELE_PARAMETER, getRele2());
-          // ////printf("\nfeedback relay2- %s - %d\n", cpy_message.payload,
-          // cpy_message.BLE_SMS_INDICATION);
-          if (label_MonoStableRelay2 == 1) {
-            BLE_Broadcast_Notify(cpy_message.payload);
-          }
-
-          if (cpy_message.BLE_SMS_INDICATION == UDP_INDICATION) {
-            sprintf(cpy_message.mqttInfo_ble.data, "%s", cpy_message.payload);
-            send_UDP_queue(&cpy_message.mqttInfo_ble);
-          }
-
-          vTaskDelay(pdMS_TO_TICKS((rele2_Bistate_Time * 1000)));
-
-          unsigned int q_size = uxQueueMessagesWaiting(queue_BLE_Parameters2);
+/* R1 e R2 sao os canais 0 e 1 do motor, os restantes ficam para placas de
+   expansao */
+static relay_engine relay_Engine;
+static SemaphoreHandle_t relay_Engine_Mutex = NULL;
+static StaticSemaphore_t relay_Engine_Mutex_Buffer;
 
-          // //printf("\n\nqueue rele 2- %d\n\n", q_size);
+/* ultimo pedido de impulso de cada rele, para os avisos no fim do impulso;
+   relaynumber a 0 quando o impulso nao tem a quem responder (rotinas) */
+static data_BLE_Send_RelayState relay_Pulse_Message[2];
 
-          if (q_size < 1) {
-            if (label_MonoStableRelay2 == 1) {
-              gpio_set_level(GPIO_OUTPUT_IO_1, 0);
-            }
-
-            memset(cpy_message.payload, 0, sizeof(cpy_message.payload));
-            sprintf(cpy_message.payload, "%s %c %c %d", RELE2_ELEMENT, SET_CMD,
-                    RELE_PARAMETER, getRele2());
-
-            // //printf("\nfeedback relay22- %s\n", cpy_message.payload);
+static const gpio_num_t relay_Outputs[] = {GPIO_OUTPUT_IO_0, GPIO_OUTPUT_IO_1};
+static const uint8_t relay_Last_Value_Keys[] = {STATE_KEY_RELAY1_LAST_VALUE,
+                                                STATE_KEY_RELAY2_LAST_VALUE};
 
-            if (cpy_message.BLE_SMS_INDICATION == UDP_INDICATION) {
-              sprintf(cpy_message.mqttInfo_ble.data, "%s", cpy_message.payload);
-              send_UDP_queue(&cpy_message.mqttInfo_ble);
-            }
+static void relay_Engine_Output(uint8_t channel, uint8_t level, void *ctx) {
+  if (channel < sizeof(relay_Outputs) / sizeof(relay_Outputs[0])) {
+    gpio_set_level(relay_Outputs[channel], level);
+  }
+}
 
-            BLE_Broadcast_Notify(cpy_message.payload);
-            label_MonoStableRelay2 = 0;
-          }
-        } else if (cpy_message.BLE_SMS_INDICATION == SMS_INDICATION) {
-          label_MonoStableRelay2 = 1;
+static void take_Relay_Engine() {
+  xSemaphoreTake(relay_Engine_Mutex, portMAX_DELAY);
+  relay_Engine_Advance(&relay_Engine, xTaskGetTickCount());
+}
 
-          if (!getRele2()) {
+static void release_Relay_Engine() {
+  label_MonoStableRelay1 = relay_Engine_Is_Pulsing(&relay_Engine, 0);
+  label_MonoStableRelay2 = relay_Engine_Is_Pulsing(&relay_Engine, 1);
+  xSemaphoreGive(relay_Engine_Mutex);
+}
 
-            if (label_MonoStableRelay2 == 1) {
-              gpio_set_level(GPIO_OUTPUT_IO_1, 1);
-              BLE_Broadcast_Notify("R2 G R 1");
-            }
+/* fora da tarefa do motor: acorda-a para tratar os eventos e recalcular a
+   espera ate ao proximo temporizador */
+static void give_Relay_Engine() {
+  release_Relay_Engine();
+  xTaskNotifyGive(relay_Engine_Task_Handle);
+}
 
-            if (cpy_message.EG91_data.labelIncomingCall != 1 &&
-                cpy_message.EG91_data.labelRsp == 1 &&
-                label_MonoStableRelay2 == 1) {
-              if (getRele2()) {
+static void send_Relay_State_SMS(data_BLE_Send_RelayState *message,
+                                 uint8_t releNumber, uint8_t level) {
+  if (message->EG91_data.labelIncomingCall == 1 ||
+      message->EG91_data.labelRsp != 1) {
+    return;
+  }
 
-                sprintf(cpy_message.EG91_data.payload,
-                        return_Json_SMS_Data("RELAY_ON"), RELE2_NUMBER, "<03>");
-                xQueueSendToBack(queue_EG91_SendSMS,
-                                 (void *)&cpy_message.EG91_data,
-                                 pdMS_TO_TICKS(1000));
-              } else {
-                sprintf(cpy_message.EG91_data.payload,
-                        return_Json_SMS_Data("RELAY_OFF"), RELE2_NUMBER,
-                        "<04>");
-                xQueueSendToBack(queue_EG91_SendSMS,
-                                 (void *)&cpy_message.EG91_data,
-                                 pdMS_TO_TICKS(1000));
-              }
-            }
-          }
+  if (level) {
+    sprintf(message->EG91_data.payload, return_Json_SMS_Data("RELAY_ON"),
+            releNumber, releNumber == RELE1_NUMBER ? "<01>" : "<03>");
+  } else {
+    sprintf(message->EG91_data.payload, return_Json_SMS_Data("RELAY_OFF"),
+            releNumber, releNumber == RELE1_NUMBER ? "<02>" : "<04>");
+  }
 
-          vTaskDelay(pdMS_TO_TICKS(rele2_Bistate_Time * 1000));
+  xQueueSendToBack(queue_EG91_SendSMS, (void *)&message->EG91_data,
+                   pdMS_TO_TICKS(1000));
+}
 
-          unsigned int q_size = uxQueueMessagesWaiting(queue_BLE_Parameters2);
+static void relay_Engine_Feedback(const relay_engine_event *event,
+                                  data_BLE_Send_RelayState *message) {
+  uint8_t releNumber = event->channel + 1;
+  char feedBackRelay[50] = {};
 
-          // ////printf("\n\nqueue rele - %d\n\n", q_size);
+  if (event->channel >= sizeof(relay_Outputs) / sizeof(relay_Outputs[0])) {
+    return;
+  }
 
-          if (q_size < 1) {
-            if (label_MonoStableRelay2 == 1) {
-              gpio_set_level(GPIO_OUTPUT_IO_1, 0);
-            }
+  sprintf(feedBackRelay, "%s %c %c %d",
+          releNumber == RELE1_NUMBER ? RELE1_ELEMENT : RELE2_ELEMENT, SET_CMD,
+          RELE_PARAMETER, event->level);
 
-            // //printf("\nfeedback relay2222- %s\n", cpy_message.payload);
+  if (event->type == RELAY_EVENT_PERSIST) {
+    save_State_In_Journal(relay_Last_Value_Keys[event->channel], event->level);
+    return;
+  }
 
-            BLE_Broadcast_Notify(cpy_message.payload);
+  if (event->type == RELAY_EVENT_INTERLOCK ||
+      event->type == RELAY_EVENT_SCHEDULED) {
+    BLE_Broadcast_Notify(feedBackRelay);
+    return;
+  }
 
-            if (cpy_message.EG91_data.labelIncomingCall != 1 &&
-                cpy_message.EG91_data.labelRsp == 1 &&
-                label_MonoStableRelay2 == 1) {
-              if (getRele2()) {
-                // vTaskDelay(pdMS_TO_TICKS(1000));
-                sprintf(cpy_message.EG91_data.payload,
-                        return_Json_SMS_Data("RELAY_ON"), RELE2_NUMBER, "<03>");
-                xQueueSendToBack(queue_EG91_SendSMS,
-                                 (void *)&cpy_message.EG91_data,
-                                 pdMS_TO_TICKS(1000));
-              } else {
-                sprintf(cpy_message.EG91_data.payload,
-                        return_Json_SMS_Data("RELAY_OFF"), RELE2_NUMBER,
-                        "<04>");
-                xQueueSendToBack(queue_EG91_SendSMS,
-                                 (void *)&cpy_message.EG91_data,
-                                 pdMS_TO_TICKS(1000));
-              }
-            }
+  if (message->relaynumber == 0) {
+    return;
+  }
 
-            if (label_MonoStableRelay2 == 1) {
-              gpio_set_level(GPIO_OUTPUT_IO_1, 0);
-              BLE_Broadcast_Notify("R2 G R 0");
-            }
-            label_MonoStableRelay2 = 0;
-          } else {
-            sprintf(cpy_message.EG91_data.payload,
-                    return_Json_SMS_Data("PULSE_TIME_WAS_RENEWED"),
-                    RELE2_NUMBER);
-            xQueueSendToBack(queue_EG91_SendSMS, (void *)&cpy_message.EG91_data,
-                             pdMS_TO_TICKS(1000));
-          }
-        } else {
-          sprintf(cpy_message.payload, "%s %c %c %s", RELE2_ELEMENT, SET_CMD,
-                  RELE_PARAMETER, ERROR_SET);
-        }
-      }
+  if (message->BLE_SMS_INDICATION != SMS_INDICATION) {
+    sprintf(message->payload, "%s", feedBackRelay);
+    BLE_Broadcast_Notify(message->payload);
 
-      // vTaskDelay(pdMS_TO_TICKS((500)));
+    if (message->BLE_SMS_INDICATION == UDP_INDICATION) {
+      sprintf(message->mqttInfo_ble.data, "%s", message->payload);
+      send_UDP_queue(&message->mqttInfo_ble);
     }
+  } else if (event->type == RELAY_EVENT_PULSE_RENEWED) {
+    /* o SMS RENEWED_RELAY_PULSE_TIME ja saiu em setReles, numa chamada o
+       rele 1 so liberta o envio de comandos AT */
+    if (releNumber == RELE1_NUMBER &&
+        message->EG91_data.labelIncomingCall == 1) {
+      give_rdySem_Control_Send_AT_Command();
+    }
+  } else {
+    BLE_Broadcast_Notify(releNumber == RELE1_NUMBER
+                             ? (event->level ? "R1 G R 1" : "R1 G R 0")
+                             : (event->level ? "R2 G R 1" : "R2 G R 0"));
+    send_Relay_State_SMS(message, releNumber, event->level);
   }
 }
 
-void task_BiState_Send_RelayState1(void *pvParameter) {
-
-  label_MonoStableRelay1 = 0;
-  // rdySem_RelayMonoInicial = xSemaphoreCreateBinary();
-  // xSemaphoreGive(rdySem_RelayMonoInicial);
-  //  xSemaphoreGive(rdySem_RelayMonoInicial);
-  rdySem_RelayMonoInicial = xSemaphoreCreateBinary();
-  rdySem_RelayMonoStart = xSemaphoreCreateBinary();
-  // ////printf("sem 11");
-  xSemaphoreGive(rdySem_RelayMonoStart);
-  // printf("sem 22\n");
-  uint8_t timeout = 0;
-
-  queue_BLE_Parameters1 = xQueueCreate(1, sizeof(data_BLE_Send_RelayState));
-
-  data_BLE_Send_RelayState
-      cpy_message; //= (data_BLE_Send_RelayState *)pvParameter;
-  data_BLE_Send_RelayState cpy_cpy_message;
+/* uma so tarefa para todos os reles: dorme ate ao proximo temporizador da
+   roda ou ate um pedido novo, e trata os avisos fora do trinco */
+void task_Relay_Engine(void *pvParameter) {
+  data_BLE_Send_RelayState message;
+  relay_engine_event event;
+  uint32_t wait = TIMER_WHEEL_NONE;
 
   for (;;) {
-    memset(&cpy_message, 0, sizeof(cpy_message));
-    memset(&cpy_cpy_message, 0, sizeof(cpy_cpy_message));
-
-    if (xQueueReceive(queue_BLE_Parameters1, &(cpy_cpy_message),
-                      portMAX_DELAY)) {
-      cpy_message = cpy_cpy_message;
-
-      label_MonoStableRelay1 = 1;
-      printf("\nfeedback relay hohoho\n");
-      save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, 0,
-                                nvs_System_handle);
-
-      if (cpy_message.relaynumber == RELE1_NUMBER) {
-        if (cpy_message.BLE_SMS_INDICATION != SMS_INDICATION) {
-          if (label_MonoStableRelay1 == 1) {
-            gpio_set_level(GPIO_OUTPUT_IO_0, 1);
-          }
-
-          sprintf(cpy_message.payload, "%s %c %c %d", RELE1_ELEMENT, SET_CMD,
-                  RELE_PARAMETER, getRele1());
-
-          // printf("\nfeedback relay 11- %s\n", cpy_message.payload);
+    ulTaskNotifyTake(pdTRUE,
+                     wait == TIMER_WHEEL_NONE ? portMAX_DELAY : (TickType_t)wait);
 
-          BLE_Broadcast_Notify(cpy_message.payload);
+    take_Relay_Engine();
 
-          // char UDP_message[1024] = {};
-
-          // sprintf(UDP_message, "%s", cpy_message.payload);
-
-          if (cpy_message.BLE_SMS_INDICATION == UDP_INDICATION) {
-
-            sprintf(cpy_message.mqttInfo_ble.data, "%s", cpy_message.payload);
-            // printf("\nfeedback relay6565 22- %s - %s\n",
-            // cpy_message.mqttInfo_ble.data, cpy_message.mqttInfo_ble.topic);
-            send_UDP_queue(&(cpy_message.mqttInfo_ble));
-          }
-
-          // xQueueSendToBack(UDP_Send_queue, (void *)&UDP_message,
-          // pdMS_TO_TICKS(1000));
-
-          // ////printf("\nfeedback relay 22- %s\n", cpy_message.payload);
-
-          vTaskDelay(pdMS_TO_TICKS((rele1_Bistate_Time * 1000)));
-
-          unsigned int q_size = uxQueueMessagesWaiting(queue_BLE_Parameters1);
-
-          // //printf("\n\nqueue rele 2 - %d\n\n", q_size);
-
-          if (q_size < 1) {
-            if (label_MonoStableRelay1 == 1) {
-              gpio_set_level(GPIO_OUTPUT_IO_0, 0);
-            }
+    while (relay_Engine_Pop_Event(&relay_Engine, &event)) {
+      if (event.channel < sizeof(relay_Pulse_Message) /
+                              sizeof(relay_Pulse_Message[0])) {
+        message = relay_Pulse_Message[event.channel];
+      } else {
+        memset(&message, 0, sizeof(message));
+      }
 
-            memset(cpy_message.payload, 0, sizeof(cpy_message.payload));
-            sprintf(cpy_message.payload, "%s %c %c %d", RELE1_ELEMENT, SET_CMD,
-                    RELE_PARAMETER, getRele1());
-            // //printf("\nfeedback relay33- %s\n", cpy_message.payload);
+      release_Relay_Engine();
+      relay_Engine_Feedback(&event, &message);
+      take_Relay_Engine();
+    }
 
-            BLE_Broadcast_Notify(cpy_message.payload);
+    wait = relay_Engine_Next(&relay_Engine);
+    release_Relay_Engine();
+  }
+}
 
-            // sprintf(UDP_message, "%s", cpy_message.payload);
+void init_Relay_Engine() {
+  rdySem_RelayMonoInicial = xSemaphoreCreateBinary();
+  relay_Engine_Mutex = xSemaphoreCreateMutexStatic(&relay_Engine_Mutex_Buffer);
+
+  relay_Engine_Init(&relay_Engine, xTaskGetTickCount(),
+                    pdMS_TO_TICKS(RELAY_PERSIST_DELAY_MS), relay_Engine_Output,
+                    NULL);
+
+  /* get_NVS_Parameters ja repos as saidas a partir destas chaves */
+  for (uint8_t i = 0; i < sizeof(relay_Outputs) / sizeof(relay_Outputs[0]);
+       i++) {
+    relay_Engine_Restore(
+        &relay_Engine, i, gpio_get_level(relay_Outputs[i]),
+        get_INT8_State_From_Journal(relay_Last_Value_Keys[i]));
+  }
 
-            if (cpy_message.BLE_SMS_INDICATION == UDP_INDICATION) {
-              sprintf(cpy_message.mqttInfo_ble.data, "%s", cpy_message.payload);
-              send_UDP_queue(&cpy_message.mqttInfo_ble);
-            }
-            // xQueueSendToBack(UDP_Send_queue, (void *)&UDP_message,
-            // pdMS_TO_TICKS(1000));
+  if (get_INT8_Data_From_Storage(NVS_KEY_RELAY_INTERLOCK, nvs_System_handle) ==
+      1) {
+    relay_Engine_Interlock(&relay_Engine, 0, 1);
+  }
 
-            label_MonoStableRelay1 = 0;
-          }
-        } else if (cpy_message.BLE_SMS_INDICATION == SMS_INDICATION) {
-          if (cpy_message.EG91_data.labelIncomingCall == 1) {
-            // vTaskDelay(pdMS_TO_TICKS(500));
-            //  giveSem_CtrIncomingCall();
-          }
+  xTaskCreate(task_Relay_Engine, "task_Relay_Engine", 2 * 2048 + 1024, NULL,
+              15, &relay_Engine_Task_Handle);
+}
 
-          if (!getRele1()) {
-            if (label_MonoStableRelay1 == 1) {
+static void pulse_Relay_Message(data_BLE_Send_RelayState *message) {
+  uint8_t channel = message->relaynumber - 1;
+  int time = message->relaynumber == RELE1_NUMBER ? rele1_Bistate_Time
+                                                  : rele2_Bistate_Time;
 
-              gpio_set_level(GPIO_OUTPUT_IO_0, 1);
-              BLE_Broadcast_Notify("R1 G R 1");
-            }
+  if (channel >= sizeof(relay_Pulse_Message) / sizeof(relay_Pulse_Message[0])) {
+    return;
+  }
 
-            if (cpy_message.EG91_data.labelIncomingCall != 1 &&
-                cpy_message.EG91_data.labelRsp == 1) {
-              if (getRele1()) {
+  take_Relay_Engine();
+  relay_Pulse_Message[channel] = *message;
+  relay_Engine_Pulse(&relay_Engine, channel, pdMS_TO_TICKS(time * 1000));
+  give_Relay_Engine();
+}
 
-                sprintf(cpy_message.EG91_data.payload,
-                        return_Json_SMS_Data("RELAY_ON"), RELE1_NUMBER, "<01>");
-                xQueueSendToBack(queue_EG91_SendSMS,
-                                 (void *)&cpy_message.EG91_data,
-                                 pdMS_TO_TICKS(1000));
-                // send_UDP_queue("R1 G R 1");
-              } else {
+void pulse_Relay(uint8_t releNumber, uint32_t time_ms) {
+  train_Relay(releNumber, 1, time_ms, 0);
+}
 
-                sprintf(cpy_message.EG91_data.payload,
-                        return_Json_SMS_Data("RELAY_OFF"), RELE1_NUMBER),
-                    "<02>";
-                xQueueSendToBack(queue_EG91_SendSMS,
-                                 (void *)&cpy_message.EG91_data,
-                                 pdMS_TO_TICKS(1000));
-                // send_UDP_queue("R1 G R 0");
-              }
-            }
-          }
+void train_Relay(uint8_t releNumber, uint16_t count, uint32_t on_ms,
+                 uint32_t off_ms) {
+  take_Relay_Engine();
 
-          vTaskDelay(pdMS_TO_TICKS(rele1_Bistate_Time * 1000));
+  if (releNumber >= 1 && releNumber <= sizeof(relay_Pulse_Message) /
+                                           sizeof(relay_Pulse_Message[0])) {
+    relay_Pulse_Message[releNumber - 1].relaynumber = 0;
+  }
 
-          unsigned int q_size = uxQueueMessagesWaiting(queue_BLE_Parameters1);
+  relay_Engine_Train(&relay_Engine, releNumber - 1, count,
+                     pdMS_TO_TICKS(on_ms), pdMS_TO_TICKS(off_ms));
+  give_Relay_Engine();
+}
 
-          // ////printf("\n\nqueue rele - %d\n\n", q_size);
+void set_Relay_Level(uint8_t releNumber, uint8_t level) {
+  take_Relay_Engine();
+  relay_Engine_Set(&relay_Engine, releNumber - 1, level);
+  give_Relay_Engine();
+}
 
-          if (q_size < 1) {
-            if (label_MonoStableRelay1 == 1) {
-              gpio_set_level(GPIO_OUTPUT_IO_0, 0);
-            }
+void save_Relay_Last_Value(uint8_t releNumber, uint8_t level) {
+  take_Relay_Engine();
+  relay_Engine_Persist(&relay_Engine, releNumber - 1, level);
+  give_Relay_Engine();
+}
 
-            BLE_Broadcast_Notify("R1 G R 0");
-            // ////printf("\n\n before PULSE_TIME_WAS_RENEWED11\n\n");
-            if (cpy_message.EG91_data.labelIncomingCall != 1 &&
-                cpy_message.EG91_data.labelRsp == 1) {
-
-              // ////printf("\n\n before PULSE_TIME_WAS_RENEWED22\n\n");
-              if (getRele1()) {
-                // vTaskDelay(pdMS_TO_TICKS(1000));
-                // send_UDP_queue("R1 G R 1");
-                sprintf(cpy_message.EG91_data.payload,
-                        return_Json_SMS_Data("RELAY_ON"), RELE1_NUMBER, "<01>");
-                xQueueSendToBack(queue_EG91_SendSMS,
-                                 (void *)&cpy_message.EG91_data,
-                                 pdMS_TO_TICKS(1000));
-              } else {
-                // send_UDP_queue("R1 G R 0");
-                sprintf(cpy_message.EG91_data.payload,
-                        return_Json_SMS_Data("RELAY_OFF"), RELE1_NUMBER,
-                        "<02>");
-                xQueueSendToBack(queue_EG91_SendSMS,
-                                 (void *)&cpy_message.EG91_data,
-                                 pdMS_TO_TICKS(1000));
-              }
-            }
-          } else {
-            // ////printf("\n\n before PULSE_TIME_WAS_RENEWED33\n\n");
-            sprintf(cpy_message.EG91_data.payload,
-                    return_Json_SMS_Data("PULSE_TIME_WAS_RENEWED"),
-                    RELE1_NUMBER);
+void schedule_Relay(uint8_t releNumber, uint8_t level, uint32_t delay_ms) {
+  take_Relay_Engine();
+  relay_Engine_Schedule(&relay_Engine, releNumber - 1, level,
+                        pdMS_TO_TICKS(delay_ms));
+  give_Relay_Engine();
+}
 
-            if (cpy_message.EG91_data.labelIncomingCall == 1) {
-              // ////printf("\n\n before PULSE_TIME_WAS_RENEWED44\n\n");
-              give_rdySem_Control_Send_AT_Command();
-              //    xSemaphoreGive(rdySem_Control_Send_AT_Command);
-            } else {
-              // ////printf("\n\n before PULSE_TIME_WAS_RENEWED55\n\n");
-              xQueueSendToBack(queue_EG91_SendSMS,
-                               (void *)&cpy_message.EG91_data,
-                               pdMS_TO_TICKS(1000));
-            }
-          }
-        }
-      }
+void set_Relay_Interlock(uint8_t enable) {
+  take_Relay_Engine();
+  relay_Engine_Interlock(&relay_Engine, 0, enable ? 1 : RELAY_ENGINE_NONE);
+  give_Relay_Engine();
+}
 
-    } else if (cpy_message.relaynumber == RELE2_NUMBER) {
-      sprintf(cpy_message.payload, "%s %c %c %s", RELE1_ELEMENT, SET_CMD,
-              RELE_PARAMETER, ERROR_SET);
-    }
-  }
-  // vTaskDelay(pdMS_TO_TICKS(1000));
+static void toggle_Relay(uint8_t releNumber) {
+  take_Relay_Engine();
+  relay_Engine_Set(&relay_Engine, releNumber - 1,
+                   !relay_Engine_Level(&relay_Engine, releNumber - 1));
+  give_Relay_Engine();
 }
 
 char *configuration_Relay_Parameter(char *payload, uint8_t BLE_SMS,
@@ -386,6 +276,7 @@ char *configuration_Relay_Parameter(char *payload, uint8_t BLE_SMS,
   char relayMODE_1[2] = {};
   char relayMODE_2[2] = {};
   char relayRestriction_1[2] = {};
+  char relayInterlock[2] = {};
   uint8_t aux_ERROR = 0;
   uint8_t dot_Counter = 0;
   uint8_t aux_DotCounter = 0;
@@ -571,7 +462,37 @@ char *configuration_Relay_Parameter(char *payload, uint8_t BLE_SMS,
     aux_DotCounter++;
   }
 
-  if ((dot_Counter + aux_DotCounter) == 5) {
+  index_Found = -1;
+  strIndex = 0;
+
+  index_Found = strpos(payload, "I=");
+
+  if (index_Found != -1) {
+    for (size_t i = index_Found + 2; i < strlen(payload); i++) {
+      if (payload[i] == ';' || strIndex > 2) {
+        break;
+      }
+
+      if (strIndex == 1) {
+        return return_Json_SMS_Data("ERROR_INPUT_DATA");
+      }
+
+      relayInterlock[strIndex++] = payload[i];
+    }
+
+    if ((relayInterlock[0] == '1' || relayInterlock[0] == '0') &&
+        strlen(relayInterlock) == 1) {
+      found_Count |= 32;
+      index_Found = -1;
+      strIndex = 0;
+    } else {
+      return return_Json_SMS_Data("ERROR_INPUT_DATA");
+    }
+  } else {
+    aux_DotCounter++;
+  }
+
+  if ((dot_Counter + aux_DotCounter) == 6) {
     if (found_Count == 0) {
       return_Json_SMS_Data("ERROR_INPUT_DATA");
     }
@@ -603,8 +524,7 @@ char *configuration_Relay_Parameter(char *payload, uint8_t BLE_SMS,
     if (((found_Count & 4) >> 2) == 1) {
       // resetRele1();
       rele1_Mode_Label = atoi(relayMODE_1);
-      save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, 0,
-                                nvs_System_handle);
+      save_Relay_Last_Value(RELE1_NUMBER, 0);
       // ////printf("\n\n rele1_Mode_Label asas - %d\n\n", rele1_Mode_Label);
       save_INT8_Data_In_Storage(NVS_RELAY1_MODE, rele1_Mode_Label,
                                 nvs_System_handle);
@@ -613,8 +533,7 @@ char *configuration_Relay_Parameter(char *payload, uint8_t BLE_SMS,
     if (((found_Count & 2) >> 1) == 1) {
       // resetRele2();
       rele2_Mode_Label = atoi(relayMODE_2);
-      save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, 0,
-                                nvs_System_handle);
+      save_Relay_Last_Value(RELE2_NUMBER, 0);
       // ////printf("\n\n rele2_Mode_Label asas - %d\n\n", rele2_Mode_Label);
       save_INT8_Data_In_Storage(NVS_RELAY2_MODE, rele2_Mode_Label,
                                 nvs_System_handle);
@@ -629,6 +548,13 @@ char *configuration_Relay_Parameter(char *payload, uint8_t BLE_SMS,
                                 nvs_System_handle);
     }
 
+    /* R1 e R2 nunca ligados ao mesmo tempo */
+    if (found_Count & 32) {
+      set_Relay_Interlock(atoi(relayInterlock));
+      save_INT8_Data_In_Storage(NVS_KEY_RELAY_INTERLOCK, atoi(relayInterlock),
+                                nvs_System_handle);
+    }
+
     if (BLE_SMS == BLE_INDICATION || BLE_SMS == UDP_INDICATION) {
       memset(file_RSP, 0, sizeof(file_RSP));
 
@@ -717,14 +643,10 @@ char *parse_ReleData(uint8_t BLE_SMS_Indication, uint8_t releNumber, char cmd,
 
           if (user_validateData->permition == '2') {
             label_Routine1_ON = 0;
-            save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, 0,
-                                      nvs_System_handle);
-            save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_TIME_ON, 0,
-                                      nvs_System_handle);
+            save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, 0);
+            save_State_In_Journal(STATE_KEY_ROUTINE1_TIME_ON, 0);
 
             resetRele1();
-            save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, 0,
-                                      nvs_System_handle);
             BLE_Broadcast_Notify("R1 S R 0");
 
             sdCard_Logs_struct logs_struct;
@@ -827,15 +749,11 @@ char *parse_ReleData(uint8_t BLE_SMS_Indication, uint8_t releNumber, char cmd,
 
           if (user_validateData->permition == '2') {
             label_Routine2_ON = 0;
-            save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, 0,
-                                      nvs_System_handle);
-            save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_TIME_ON, 0,
-                                      nvs_System_handle);
+            save_State_In_Journal(STATE_KEY_ROUTINE2_LABEL, 0);
+            save_State_In_Journal(STATE_KEY_ROUTINE2_TIME_ON, 0);
 
             resetRele2();
             BLE_Broadcast_Notify("R2 S R 0");
-            save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, 0,
-                                      nvs_System_handle);
             sdCard_Logs_struct logs_struct;
             memset(&logs_struct, 0, sizeof(logs_struct));
 
@@ -1497,8 +1415,7 @@ char *parse_ReleData(uint8_t BLE_SMS_Indication, uint8_t releNumber, char cmd,
         if (user_validateData->permition == '1' ||
             user_validateData->permition == '2') {
           if (releNumber == RELE1_NUMBER) {
-            save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, 0,
-                                      nvs_System_handle);
+            save_Relay_Last_Value(RELE1_NUMBER, 0);
             // resetRele1();
             rele1_Mode_Label = BIESTABLE_MODE_INDEX;
 
@@ -1528,8 +1445,7 @@ char *parse_ReleData(uint8_t BLE_SMS_Indication, uint8_t releNumber, char cmd,
                   &rsp, return_Json_SMS_Data("ERROR_INPUT_DATA"));
             }
           } else if (releNumber == RELE2_NUMBER) {
-            save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, 0,
-                                      nvs_System_handle);
+            save_Relay_Last_Value(RELE2_NUMBER, 0);
             // resetRele2();
             rele2_Mode_Label = BIESTABLE_MODE_INDEX;
 
@@ -2419,8 +2335,7 @@ char *parse_ReleData(uint8_t BLE_SMS_Indication, uint8_t releNumber, char cmd,
           if (BLE_SMS_Indication == BLE_INDICATION ||
               BLE_SMS_Indication == UDP_INDICATION) {
             if (releNumber == RELE1_NUMBER) {
-              save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, 0,
-                                        nvs_System_handle);
+              save_Relay_Last_Value(RELE1_NUMBER, 0);
               // resetRele1();
               rele1_Mode_Label = MONOESTABLE_MODE_INDEX;
 
@@ -2432,8 +2347,7 @@ char *parse_ReleData(uint8_t BLE_SMS_Indication, uint8_t releNumber, char cmd,
                        rele1_Mode_Label);
               return rsp;
             } else if (releNumber == RELE2_NUMBER) {
-              save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, 0,
-                                        nvs_System_handle);
+              save_Relay_Last_Value(RELE2_NUMBER, 0);
               // resetRele2();
               rele2_Mode_Label = MONOESTABLE_MODE_INDEX;
 
@@ -2451,8 +2365,7 @@ char *parse_ReleData(uint8_t BLE_SMS_Indication, uint8_t releNumber, char cmd,
             }
           } else if (BLE_SMS_Indication == SMS_INDICATION) {
             if (releNumber == RELE1_NUMBER) {
-              save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, 0,
-                                        nvs_System_handle);
+              save_Relay_Last_Value(RELE1_NUMBER, 0);
               // resetRele1();
               rele1_Mode_Label = MONOESTABLE_MODE_INDEX;
 
@@ -2469,8 +2382,7 @@ char *parse_ReleData(uint8_t BLE_SMS_Indication, uint8_t releNumber, char cmd,
                        RELE1_NUMBER);
               return rsp;
             } else if (releNumber == RELE2_NUMBER) {
-              save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, 0,
-                                        nvs_System_handle);
+              save_Relay_Last_Value(RELE2_NUMBER, 0);
               // resetRele2();
               rele2_Mode_Label = MONOESTABLE_MODE_INDEX;
 
@@ -2723,8 +2635,7 @@ uint8_t setReles(int releNumber, uint8_t BLE_SMS_Indication, uint8_t gattsIF,
           // sprintf(message.mqttInfo_ble.data,"%s",feedBackRelay);
 
           printf("\n\n\n rele in bistate1\n\n\n");
-          xQueueSendToBack(queue_BLE_Parameters1, (void *)&message,
-                           pdMS_TO_TICKS(1000));
+          pulse_Relay_Message(&message);
 
           return 1;
         } else {
@@ -2754,9 +2665,7 @@ uint8_t setReles(int releNumber, uint8_t BLE_SMS_Indication, uint8_t gattsIF,
           sprintf(message.payload, "%s", feedBackRelay);
           sprintf(message.mqttInfo_ble.data, "%s", feedBackRelay);
 
-          xQueueSendToBack(queue_BLE_Parameters1, (void *)&message,
-                           pdMS_TO_TICKS(1000));
-          xTaskAbortDelay(rele1_Bistate_Task_Handle);
+          pulse_Relay_Message(&message);
 
           return 1;
         }
@@ -2769,8 +2678,7 @@ uint8_t setReles(int releNumber, uint8_t BLE_SMS_Indication, uint8_t gattsIF,
           message.BLE_SMS_INDICATION = (uint8_t)SMS_INDICATION;
           message.EG91_data = *data_SMS;
 
-          xQueueSendToBack(queue_BLE_Parameters1, (void *)&message,
-                           pdMS_TO_TICKS(100));
+          pulse_Relay_Message(&message);
           // printf("\n label after cpy call2\n");
         } else {
 
@@ -2781,10 +2689,8 @@ uint8_t setReles(int releNumber, uint8_t BLE_SMS_Indication, uint8_t gattsIF,
             sprintf(message.EG91_data.payload,
                     return_Json_SMS_Data("RENEWED_RELAY_PULSE_TIME"),
                     RELE1_NUMBER);
-            xTaskAbortDelay(rele1_Bistate_Task_Handle);
             // sprintf(feedBackRelay, "%s",message.EG91_data.payload);
-            xQueueSendToBack(queue_BLE_Parameters1, (void *)&message,
-                             pdMS_TO_TICKS(1000));
+            pulse_Relay_Message(&message);
 
             if (message.EG91_data.labelRsp == 1) {
               xQueueSendToBack(queue_EG91_SendSMS, (void *)&message.EG91_data,
@@ -2795,8 +2701,7 @@ uint8_t setReles(int releNumber, uint8_t BLE_SMS_Indication, uint8_t gattsIF,
             message.BLE_SMS_INDICATION = (uint8_t)SMS_INDICATION;
             message.EG91_data = *data_SMS;
 
-            xQueueSendToBack(queue_BLE_Parameters1, (void *)&message,
-                             pdMS_TO_TICKS(1000));
+            pulse_Relay_Message(&message);
           }
         }
 
@@ -2861,8 +2766,7 @@ uint8_t setReles(int releNumber, uint8_t BLE_SMS_Indication, uint8_t gattsIF,
 
           // ////printf("\n\n\n rele in bistate1\n\n\n");
 
-          xQueueSendToBack(queue_BLE_Parameters2, (void *)&message,
-                           (TickType_t)0);
+          pulse_Relay_Message(&message);
 
           return 1;
         } else {
@@ -2892,9 +2796,7 @@ uint8_t setReles(int releNumber, uint8_t BLE_SMS_Indication, uint8_t gattsIF,
           sprintf(message.payload, "%s", feedBackRelay);
           sprintf(message.mqttInfo_ble.data, "%s", feedBackRelay);
 
-          xQueueSendToBack(queue_BLE_Parameters2, (void *)&message,
-                           pdMS_TO_TICKS(1000));
-          xTaskAbortDelay(rele2_Bistate_Task_Handle);
+          pulse_Relay_Message(&message);
 
           /*  if (gpio_get_level(GPIO_OUTPUT_IO_0))
            {
@@ -2920,10 +2822,7 @@ uint8_t setReles(int releNumber, uint8_t BLE_SMS_Indication, uint8_t gattsIF,
           // ////printf("\n label cpy rsp sms %d - %d - %s\n",
           // message.EG91_data.labelRsp, message.EG91_data.labelRsp,
           // message.EG91_data.phoneNumber);
-          char txt111[] = "qwerty";
-          xQueueSendToBack(queue_BLE_Parameters2,
-                           /* (void *)&txt111 */ (void *)&message,
-                           pdMS_TO_TICKS(100));
+          pulse_Relay_Message(&message);
           // ////printf("\n label after cpy call2\n");
           // ////printf("\nafter send queue 1\n");
         } else {
@@ -2935,11 +2834,8 @@ uint8_t setReles(int releNumber, uint8_t BLE_SMS_Indication, uint8_t gattsIF,
             sprintf(message.EG91_data.payload,
                     return_Json_SMS_Data("RENEWED_RELAY_PULSE_TIME"),
                     RELE2_NUMBER);
-            xTaskAbortDelay(rele2_Bistate_Task_Handle);
 
-            xQueueSendToBack(queue_BLE_Parameters2,
-                             /* (void *)&txt111 */ (void *)&message,
-                             pdMS_TO_TICKS(100));
+            pulse_Relay_Message(&message);
 
             if (message.EG91_data.labelRsp == 1) {
               xQueueSendToBack(queue_EG91_SendSMS, (void *)&message.EG91_data,
@@ -2950,9 +2846,7 @@ uint8_t setReles(int releNumber, uint8_t BLE_SMS_Indication, uint8_t gattsIF,
             message.BLE_SMS_INDICATION = (uint8_t)SMS_INDICATION;
             message.EG91_data = *data_SMS;
 
-            xQueueSendToBack(queue_BLE_Parameters2,
-                             /* (void *)&txt111 */ (void *)&message,
-                             pdMS_TO_TICKS(100));
+            pulse_Relay_Message(&message);
           }
         }
 
@@ -2978,39 +2872,13 @@ uint8_t setReles(int releNumber, uint8_t BLE_SMS_Indication, uint8_t gattsIF,
   }
   return 0;
 }
-void setRele1() {
-  int level = getRele1();
-  // ////printf("\nsetRele1\n");
-  gpio_set_level(GPIO_OUTPUT_IO_0, !level);
-  save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, !level,
-                            nvs_System_handle);
-}
-
-void setRele2() {
-  int level = getRele2();
-  gpio_set_level(GPIO_OUTPUT_IO_1, !level);
-  save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, !level,
-                            nvs_System_handle);
-}
+void setRele1() { toggle_Relay(RELE1_NUMBER); }
 
-void resetRele1() {
-  if (label_MonoStableRelay1 == 1) {
-    label_MonoStableRelay1 = 0;
-    xTaskAbortDelay(rele1_Bistate_Task_Handle);
-  }
+void setRele2() { toggle_Relay(RELE2_NUMBER); }
 
-  gpio_set_level(GPIO_OUTPUT_IO_0, 0);
-  save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, 0, nvs_System_handle);
-}
+void resetRele1() { set_Relay_Level(RELE1_NUMBER, 0); }
 
-void resetRele2() {
-  if (label_MonoStableRelay2 == 1) {
-    label_MonoStableRelay2 = 0;
-    xTaskAbortDelay(rele2_Bistate_Task_Handle);
-  }
-  gpio_set_level(GPIO_OUTPUT_IO_1, 0);
-  save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, 0, nvs_System_handle);
-}
+void resetRele2() { set_Relay_Level(RELE2_NUMBER, 0); }
 
 uint8_t getRele1() { return gpio_get_level(GPIO_OUTPUT_IO_0); }
 
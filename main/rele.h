@@ -22,8 +22,7 @@
 #define NVS_R2_TIME   "NVS_R2_TIME"
 #define NVS_R1_RESTR  "NVS_R1_RESTR"
 
-extern TaskHandle_t rele1_Bistate_Task_Handle;
-extern TaskHandle_t rele2_Bistate_Task_Handle;
+extern TaskHandle_t relay_Engine_Task_Handle;
 
 extern uint8_t rele1_Mode_Label;
 extern int rele1_Bistate_Time;
@@ -31,8 +30,6 @@ extern uint8_t rele2_Mode_Label;
 extern int rele2_Bistate_Time;
 
 
-extern QueueHandle_t queue_BLE_Parameters1;
-extern QueueHandle_t queue_BLE_Parameters2;
 extern QueueHandle_t receive_mqtt_queue;
 
 extern SemaphoreHandle_t rdySem_RelayMonoInicial;
@@ -60,6 +57,26 @@ extern uint8_t rele1_Restriction;
 
 void giveMonoSt_semaphore();
 
+/* motor dos reles (relay_engine.h): uma tarefa para impulsos, trens,
+   encravamento e acoes agendadas, tempos em ms */
+void init_Relay_Engine();
+
+void task_Relay_Engine(void *pvParameter);
+
+void set_Relay_Level(uint8_t releNumber, uint8_t level);
+
+void pulse_Relay(uint8_t releNumber, uint32_t time_ms);
+
+void train_Relay(uint8_t releNumber, uint16_t count, uint32_t on_ms,
+                 uint32_t off_ms);
+
+void schedule_Relay(uint8_t releNumber, uint8_t level, uint32_t delay_ms);
+
+void set_Relay_Interlock(uint8_t enable);
+
+/* o valor so e escrito na flash quando o rele fica parado */
+void save_Relay_Last_Value(uint8_t releNumber, uint8_t level);
+
 void setRele1();
 
 void toogleRele1();
@@ -81,9 +98,6 @@ char* parse_ReleData(uint8_t BLE_SMS_Indication,uint8_t releNumber, char cmd,cha
 
 char* configuration_Relay_Parameter(char* payload,uint8_t BLE_SMS, mqtt_information *mqttInfo);
 
-void task_BiState_Send_RelayState1(void *pvParameter);
-void task_BiState_Send_RelayState2(void *pvParameter);
-
 char *getUserApp_id(char *topic);
 
 #endif
\ No newline at end of file
@@ -41,7 +41,9 @@ char rf_save_userNumber[50] = {};
 char rf_save_userButton = 0;
 
 static const char *TAG = "FreeRTOS Timer";
-TimerHandle_t rf_autoSave_xTimer;
+
+/* fim dos modos de gravacao automatica / leitura (timer_service.h) */
+static timer_service_timer autoadd_RF_Timer;
 
 uint8_t BLE_SMS_Indication_rf_autoSave = 0;
 uint8_t gattsIF_autoSave = 0;
@@ -442,13 +444,8 @@ void taskMipot_rf(void *pvParameter) {
   label_roll_auth = 1;
 
   ESP_LOGI(TAG, "parseRF_data: creating timer");
-  xTimer_autoadd_rf = xTimerCreate(
-      "Timer_auto_save",      // Nome do timer
-      TIMER_AUTO_SAVE_PERIOD, // Período do timer (em ticks)
-      pdFALSE,   // pdTRUE para reiniciar automaticamente (auto-reload)
-      (void *)2, // ID do timer
-      vTimer_autoSaveRF_callback // Função de callback
-  );
+  register_Timer(&autoadd_RF_Timer, "rf_autoadd", TIMER_SERVICE_NO_GROUP,
+                 vTimer_autoSaveRF_callback, NULL);
 
   // sprintf(rf_save_userNumber, "%s", "+3514321");
   //  Inicia o timer
@@ -490,13 +487,13 @@ void taskMipot_rf(void *pvParameter) {
             rf_relayMode(y, x);
           } else if (rf_mode == RF_AUTOSAVE_MODE) {
 
-            if (xTimer_autoadd_rf != NULL) {
-              if (xTimerIsTimerActive(xTimer_autoadd_rf) == pdFALSE) {
+            if (autoadd_RF_Timer.service != NULL) {
+              if (!is_Timer_Active(&autoadd_RF_Timer)) {
                 rf_mode = RF_RELAY_MODE;
               } else {
                 char auto_rsp[250] = {};
-                if (xTimerChangePeriod(xTimer_autoadd_rf,
-                                       TIMER_AUTO_SAVE_PERIOD, 0) == pdPASS) {
+                if (start_Timer(&autoadd_RF_Timer, TIMER_AUTO_SAVE_PERIOD,
+                                0)) {
 
                   printf("\n\n é START AUTOSAVE %c\n\n", x);
                   memset(outputData_rf, 0, sizeof(outputData_rf));
@@ -1020,14 +1017,10 @@ uint8_t add_default_RF_user(char *serial, char button, uint8_t relay) {
 
   return ESP_OK;
 }
-void vTimer_autoSaveRF_callback(TimerHandle_t xTimer_auto) {
+void vTimer_autoSaveRF_callback(timer_service_timer *timer, void *ctx) {
   // Fun o de callback do timer
 
-  ESP_LOGI(TAG, "vTimer_autoSave_callback: timer deleted");
-
-  // Salvar dados do Wiegand automaticamente
-  xTimerStop(xTimer_auto, 10);
-  ESP_LOGI(TAG, "vTimer_autoSave_callback: timer deleted successfully");
+  ESP_LOGI(TAG, "vTimer_autoSave_callback: timer expired");
   rf_mode = RF_RELAY_MODE;
   ESP_LOGI(TAG, "vTimer_autoSave_callback: rf_mode set to RF_RELAY_MODE");
 }
@@ -1051,12 +1044,11 @@ char *parseRF_data(uint8_t BLE_SMS_Indication, uint8_t gattsIF, uint16_t connID,
 
       // Iniciar o timer
       ESP_LOGI(TAG, "parseRF_data: starting timer");
-      if (xTimerStart(xTimer_autoadd_rf, 0) != pdPASS) {
+      if (!start_Timer(&autoadd_RF_Timer, TIMER_AUTO_SAVE_PERIOD, 0)) {
         ESP_LOGE(TAG, "parseRF_data: error starting timer");
 
         asprintf(&rsp, "RF S S %s", "ERROR");
       } else {
-        xTimerChangePeriod(xTimer_autoadd_rf, TIMER_AUTO_SAVE_PERIOD, 0);
         ESP_LOGI(TAG, "parseRF_data: timer started");
         asprintf(&rsp, "RF S S %s", "OK");
 
@@ -1087,12 +1079,11 @@ char *parseRF_data(uint8_t BLE_SMS_Indication, uint8_t gattsIF, uint16_t connID,
   } else if (cmd == GET_CMD) {
     if (param == RF_GET_PARAMETER) {
       rf_mode = RF_GET_RF_MODE;
-      if (xTimerStart(xTimer_autoadd_rf, 0) != pdPASS) {
+      if (!start_Timer(&autoadd_RF_Timer, TIMER_AUTO_SAVE_PERIOD, 0)) {
         ESP_LOGE(TAG, "parseRF_data: error starting timer");
 
         asprintf(&rsp, "RF G F %s", "ERROR");
       } else {
-        xTimerChangePeriod(xTimer_autoadd_rf, TIMER_AUTO_SAVE_PERIOD, 0);
         ESP_LOGI(TAG, "parseRF_data: timer started");
         BLE_SMS_Indication_rf_autoSave = BLE_SMS_Indication;
         gattsIF_autoSave = gattsIF;
@@ -1108,7 +1099,7 @@ char *parseRF_data(uint8_t BLE_SMS_Indication, uint8_t gattsIF, uint16_t connID,
   } else if (cmd == RESET_CMD) {
     if (param == RF_SAVE_AUTO_PARAMETER) {
 
-      xTimerStop(xTimer_autoadd_rf, 10);
+      stop_Timer(&autoadd_RF_Timer);
       rf_mode = RF_RELAY_MODE;
       asprintf(&rsp, "RF R S %s", "OK");
       return rsp;
@@ -14,12 +14,13 @@
 #include "cmd_list.h"
 #include "core.h"
 #include "erro_list.h"
+#include "timer_service.h"
 #include "stdio.h"
 #include <stdint.h>
 #include <stdio.h>
 
 
-#define TIMER_AUTO_SAVE_PERIOD pdMS_TO_TICKS(20000) // 1000 ms (1 segundo)
+#define TIMER_AUTO_SAVE_PERIOD 20000 // ms
 //#include "rele.c"
 
 #define RF1_USER_POSITION 1
@@ -51,7 +52,6 @@
 #define DUTY_CYCLE_US                                                          \
   500000 // Ciclo de trabalho em microssegundos (50% de duty cycle neste caso)
 
-TimerHandle_t xTimer_autoadd_rf;
 /* #define RF_RELAY_MODE 1
 #define RF_AUTOSAVE_MODE 2 */
 /**
@@ -132,7 +132,7 @@ uint8_t add_RF_auto(char rf_button, char *rf_serial, uint8_t relay,
  */
 char *parseRF_data(uint8_t BLE_SMS_Indication,uint8_t gattsIF, uint16_t connID, uint16_t handle_table,char cmd, char param, char *payload,MyUser *user_validateData, mqtt_information *mqttInfo);
 
-void vTimer_autoSaveRF_callback(TimerHandle_t xTimer_auto);
+void vTimer_autoSaveRF_callback(timer_service_timer *timer, void *ctx);
 void rf_relayMode(uint64_t serial, char button);
 
 uint8_t add_default_RF_user(char *serial, char button, uint8_t relay);
@@ -0,0 +1,190 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "routine_blob.h"
+#include "crc32.h"
+#include <string.h>
+
+#define ROUTINE_BLOB_CRC_START offsetof(routine_blob, version)
+
+void routine_Blob_Init(routine_blob *blob) {
+  memset(blob, 0, offsetof(routine_blob, records));
+  blob->magic = ROUTINE_BLOB_MAGIC;
+  blob->version = ROUTINE_BLOB_VERSION;
+  blob->next_id = 1;
+  blob->record_size = sizeof(routine_blob_record);
+}
+
+size_t routine_Blob_Header_Size(void) {
+  return offsetof(routine_blob, records);
+}
+
+uint16_t routine_Blob_Pages(const routine_blob *blob) {
+  return (blob->count + ROUTINE_BLOB_PAGE_RECORDS - 1) /
+         ROUTINE_BLOB_PAGE_RECORDS;
+}
+
+uint16_t routine_Blob_Page_Of(uint16_t index) {
+  return index / ROUTINE_BLOB_PAGE_RECORDS;
+}
+
+routine_blob_record *routine_Blob_Page(routine_blob *blob, uint16_t page) {
+  return &blob->records[page * ROUTINE_BLOB_PAGE_RECORDS];
+}
+
+/* bytes usados da pagina, 0 depois da ultima */
+size_t routine_Blob_Page_Size(const routine_blob *blob, uint16_t page) {
+  uint16_t first = page * ROUTINE_BLOB_PAGE_RECORDS;
+
+  if (page >= ROUTINE_BLOB_PAGES || first >= blob->count) {
+    return 0;
+  }
+
+  if (blob->count - first > ROUTINE_BLOB_PAGE_RECORDS) {
+    return ROUTINE_BLOB_PAGE_RECORDS * sizeof(routine_blob_record);
+  }
+
+  return (blob->count - first) * sizeof(routine_blob_record);
+}
+
+/* recalcula o CRC das paginas a partir de first_page e o do cabecalho */
+void routine_Blob_Seal(routine_blob *blob, uint16_t first_page) {
+  for (uint16_t page = first_page; page < ROUTINE_BLOB_PAGES; page++) {
+    blob->page_crc[page] =
+        page < routine_Blob_Pages(blob)
+            ? crc32((uint8_t *)routine_Blob_Page(blob, page),
+                    routine_Blob_Page_Size(blob, page))
+            : 0;
+  }
+
+  blob->crc = crc32((uint8_t *)blob + ROUTINE_BLOB_CRC_START,
+                    routine_Blob_Header_Size() - ROUTINE_BLOB_CRC_START);
+}
+
+/* so o cabecalho, as paginas vem depois com routine_Blob_Page_Is_Valid */
+uint8_t routine_Blob_Is_Valid(const routine_blob *blob, size_t size) {
+  if (size != routine_Blob_Header_Size() ||
+      blob->magic != ROUTINE_BLOB_MAGIC ||
+      blob->version != ROUTINE_BLOB_VERSION ||
+      blob->record_size != sizeof(routine_blob_record) ||
+      blob->count > ROUTINE_BLOB_MAX) {
+    return 0;
+  }
+
+  return blob->crc == crc32((uint8_t *)blob + ROUTINE_BLOB_CRC_START,
+                            size - ROUTINE_BLOB_CRC_START);
+}
+
+uint8_t routine_Blob_Page_Is_Valid(const routine_blob *blob, uint16_t page,
+                                   size_t size) {
+  if (page >= routine_Blob_Pages(blob) ||
+      size != routine_Blob_Page_Size(blob, page)) {
+    return 0;
+  }
+
+  return blob->page_crc[page] ==
+         crc32((uint8_t *)&blob->records[page * ROUTINE_BLOB_PAGE_RECORDS],
+               size);
+}
+
+/*
+ * "<expressao cron>;<acao>", o formato guardado em RT_NAMESPACE. Aceita um
+ * ';' no fim, que algumas apps mandam.
+ */
+uint8_t routine_Blob_Split(const char *payload, char *schedule, char *data) {
+  const char *sep = strchr(payload, ';');
+  const char *end = NULL;
+
+  if (sep == NULL) {
+    return 0;
+  }
+
+  end = strchr(sep + 1, ';');
+  if (end == NULL) {
+    end = sep + 1 + strlen(sep + 1);
+  } else if (end[1] != 0) {
+    return 0;
+  }
+
+  if (sep - payload >= ROUTINE_BLOB_SCHEDULE_SIZE ||
+      end - (sep + 1) >= ROUTINE_BLOB_DATA_SIZE) {
+    return 0;
+  }
+
+  memcpy(schedule, payload, sep - payload);
+  schedule[sep - payload] = 0;
+  memcpy(data, sep + 1, end - (sep + 1));
+  data[end - (sep + 1)] = 0;
+
+  return 1;
+}
+
+int routine_Blob_Insert(routine_blob *blob, uint16_t id, const char *payload) {
+  char schedule[ROUTINE_BLOB_SCHEDULE_SIZE];
+  const char *error = NULL;
+  routine_blob_record *record = NULL;
+
+  if (blob->count >= ROUTINE_BLOB_MAX) {
+    return -1;
+  }
+
+  record = &blob->records[blob->count];
+  memset(record, 0, sizeof(routine_blob_record));
+
+  if (!routine_Blob_Split(payload, schedule, record->data)) {
+    return -1;
+  }
+
+  cron_parse_expr(schedule, &record->expression, &error);
+
+  if (error != NULL) {
+    return -1;
+  }
+
+  record->id = id;
+  blob->count++;
+
+  if (id >= blob->next_id) {
+    blob->next_id = id == UINT16_MAX ? 1 : id + 1;
+  }
+
+  return id;
+}
+
+static uint8_t id_In_Use(const routine_blob *blob, uint16_t id) {
+  for (uint16_t i = 0; i < blob->count; i++) {
+    if (blob->records[i].id == id) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+int routine_Blob_Add(routine_blob *blob, const char *payload) {
+  uint16_t id = blob->next_id;
+
+  if (blob->count >= ROUTINE_BLOB_MAX) {
+    return -1;
+  }
+
+  /* depois de dar a volta aos IDs salta os que ainda existem */
+  while (id == 0 || id_In_Use(blob, id)) {
+    id = id == UINT16_MAX ? 1 : id + 1;
+  }
+
+  if (routine_Blob_Insert(blob, id, payload) < 0) {
+    return -1;
+  }
+
+  blob->next_id = id == UINT16_MAX ? 1 : id + 1;
+
+  return id;
+}
@@ -0,0 +1,90 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _ROUTINE_BLOB_H_
+#define _ROUTINE_BLOB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ccronexpr.h"
+
+/*
+ * Rotinas compiladas em blobs NVS, lidas de uma vez no arranque. Um
+ * cabecalho e paginas de ROUTINE_BLOB_PAGE_RECORDS registos:
+ *
+ *   cabecalho: [MAGIC][CRC32][VERSAO][N][PROXIMO ID][TAMANHO REGISTO]
+ *              [CRC32 PAGINA x ROUTINE_BLOB_PAGES]
+ *   pagina P:  [REGISTOS P * ROUTINE_BLOB_PAGE_RECORDS ..]
+ *
+ * Cada registo guarda o ID (a chave do texto original em RT_NAMESPACE, que
+ * continua a servir o RT G R), a acao e a expressao cron ja analisada. Os
+ * IDs novos comecam em 1, o 0 so aparece em rotinas migradas do firmware
+ * anterior. O CRC32 do cabecalho cobre da VERSAO ao ultimo CRC de pagina,
+ * assim uma rotina nova so reescreve a ultima pagina e o cabecalho. O
+ * modulo nao depende de NVS nem de FreeRTOS.
+ */
+
+#define ROUTINE_BLOB_MAGIC 0x42545452
+#define ROUTINE_BLOB_VERSION 2
+#define ROUTINE_BLOB_MAX 300
+#define ROUTINE_BLOB_PAGE_RECORDS 16
+#define ROUTINE_BLOB_PAGES                                                     \
+  ((ROUTINE_BLOB_MAX + ROUTINE_BLOB_PAGE_RECORDS - 1) / ROUTINE_BLOB_PAGE_RECORDS)
+#define ROUTINE_BLOB_DATA_SIZE 4
+#define ROUTINE_BLOB_SCHEDULE_SIZE 100
+
+typedef struct
+{
+  uint16_t id;
+  char data[ROUTINE_BLOB_DATA_SIZE];
+  cron_expr expression;
+
+} routine_blob_record;
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t crc;
+  uint16_t version;
+  uint16_t count;
+  uint16_t next_id;
+  uint16_t record_size;
+  uint32_t page_crc[ROUTINE_BLOB_PAGES];
+  routine_blob_record records[ROUTINE_BLOB_MAX];
+
+} routine_blob;
+
+void routine_Blob_Init(routine_blob *blob);
+
+size_t routine_Blob_Header_Size(void);
+
+uint16_t routine_Blob_Pages(const routine_blob *blob);
+
+uint16_t routine_Blob_Page_Of(uint16_t index);
+
+routine_blob_record *routine_Blob_Page(routine_blob *blob, uint16_t page);
+
+size_t routine_Blob_Page_Size(const routine_blob *blob, uint16_t page);
+
+void routine_Blob_Seal(routine_blob *blob, uint16_t first_page);
+
+uint8_t routine_Blob_Is_Valid(const routine_blob *blob, size_t size);
+
+uint8_t routine_Blob_Page_Is_Valid(const routine_blob *blob, uint16_t page,
+                                   size_t size);
+
+uint8_t routine_Blob_Split(const char *payload, char *schedule, char *data);
+
+int routine_Blob_Insert(routine_blob *blob, uint16_t id, const char *payload);
+
+int routine_Blob_Add(routine_blob *blob, const char *payload);
+
+#endif
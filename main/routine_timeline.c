@@ -0,0 +1,197 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "routine_timeline.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint16_t day_Index(uint8_t mday, uint8_t mon) {
+  return mon * 31 + mday - 1;
+}
+
+void routine_Calendar_Set_Day(uint8_t *days, uint8_t mday, uint8_t mon) {
+  if (mday >= 1 && mday <= 31 && mon < 12) {
+    days[day_Index(mday, mon) / 8] |= 1 << (day_Index(mday, mon) % 8);
+  }
+}
+
+uint8_t routine_Calendar_Get_Day(const uint8_t *days, uint8_t mday,
+                                 uint8_t mon) {
+  if (mday < 1 || mday > 31 || mon >= 12) {
+    return 0;
+  }
+
+  return (days[day_Index(mday, mon) / 8] >> (day_Index(mday, mon) % 8)) & 1;
+}
+
+/* chave "DDMM" usada na namespace dos dias de excecao */
+uint8_t routine_Calendar_Parse_Day(const char *key, uint8_t *days) {
+  if (strlen(key) != 4) {
+    return 0;
+  }
+
+  for (uint8_t i = 0; i < 4; i++) {
+    if (key[i] < '0' || key[i] > '9') {
+      return 0;
+    }
+  }
+
+  routine_Calendar_Set_Day(days, (key[0] - '0') * 10 + key[1] - '0',
+                           (key[2] - '0') * 10 + key[3] - '0');
+
+  return 1;
+}
+
+static uint8_t is_Calendar_Holiday(const routine_calendar *calendar,
+                                   const struct tm *day) {
+  holiday_year other;
+
+  if (calendar->holidays.year == day->tm_year + 1900) {
+    return holiday_Is_Holiday(&calendar->holidays, day);
+  }
+
+  if (calendar->holiday_pack == NULL) {
+    return 0;
+  }
+
+  holiday_Compile_Year(&other, calendar->holiday_pack, calendar->holiday_mask,
+                       day->tm_year + 1900);
+
+  return holiday_Is_Holiday(&other, day);
+}
+
+uint8_t routine_Calendar_Is_Active(const routine_calendar *calendar,
+                                   const struct tm *day) {
+  uint32_t date =
+      (day->tm_year - 100) * 10000 + day->tm_mon * 100 + day->tm_mday;
+
+  if (routine_Calendar_Get_Day(calendar->exception_days, day->tm_mday,
+                               day->tm_mon) ||
+      is_Calendar_Holiday(calendar, day)) {
+    return 0;
+  }
+
+  if (calendar->has_range &&
+      (date < calendar->range_from || date > calendar->range_to)) {
+    return 0;
+  }
+
+  if (calendar->has_holidays && date >= calendar->holidays_from &&
+      date <= calendar->holidays_to) {
+    return 0;
+  }
+
+  return 1;
+}
+
+void routine_Timeline_Begin(routine_timeline *timeline,
+                            const routine_calendar *calendar, time_t now) {
+  struct tm day;
+
+  localtime_r(&now, &day);
+
+  timeline->count = 0;
+  timeline->overflow = 0;
+  timeline->active = routine_Calendar_Is_Active(calendar, &day);
+  timeline->date =
+      (day.tm_year - 100) * 10000 + day.tm_mon * 100 + day.tm_mday;
+
+  day.tm_hour = 0;
+  day.tm_min = 0;
+  day.tm_sec = 0;
+  day.tm_isdst = -1;
+  timeline->day_start = mktime(&day);
+
+  /* o dia seguinte por mktime, os dias da mudanca de hora tem 23 ou 25h */
+  day.tm_mday++;
+  day.tm_isdst = -1;
+  timeline->day_end = mktime(&day);
+}
+
+void routine_Timeline_Add_Rule(routine_timeline *timeline, cron_expr *expression,
+                               const char *data) {
+  time_t next = cron_next(expression, timeline->day_start - 1);
+
+  if (!timeline->active) {
+    return;
+  }
+
+  while (next != (time_t)-1 && next < timeline->day_end) {
+    if (timeline->count == ROUTINE_TIMELINE_MAX) {
+      timeline->overflow = 1;
+      return;
+    }
+
+    routine_timeline_entry *entry = &timeline->entries[timeline->count++];
+    entry->second = next - timeline->day_start;
+    memset(entry->data, 0, sizeof(entry->data));
+    strncpy(entry->data, data, sizeof(entry->data) - 1);
+
+    next = cron_next(expression, next);
+  }
+}
+
+static int compare_Entry(const void *a, const void *b) {
+  const routine_timeline_entry *x = a;
+  const routine_timeline_entry *y = b;
+
+  if (x->second != y->second) {
+    return x->second < y->second ? -1 : 1;
+  }
+
+  return strcmp(x->data, y->data);
+}
+
+void routine_Timeline_End(routine_timeline *timeline) {
+  qsort(timeline->entries, timeline->count, sizeof(routine_timeline_entry),
+        compare_Entry);
+}
+
+uint8_t routine_Timeline_Is_Today(const routine_timeline *timeline,
+                                  time_t now) {
+  return now >= timeline->day_start && now < timeline->day_end;
+}
+
+uint8_t routine_Timeline_Lookup(const routine_timeline *timeline, time_t now,
+                                const char *data) {
+  uint32_t second = 0;
+  uint16_t lo = 0;
+  uint16_t hi = timeline->count;
+
+  if (!timeline->active || !routine_Timeline_Is_Today(timeline, now)) {
+    return 0;
+  }
+
+  /* as transicoes que nao couberam na lista so dependem do dia estar ativo */
+  if (timeline->overflow) {
+    return 1;
+  }
+
+  second = now - timeline->day_start;
+
+  /* primeira transicao com second >= second - ROUTINE_TIMELINE_SLACK_S */
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+
+    if (timeline->entries[mid].second + ROUTINE_TIMELINE_SLACK_S < second) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  for (; lo < timeline->count && timeline->entries[lo].second <= second; lo++) {
+    if (!strcmp(timeline->entries[lo].data, data)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _ROUTINE_TIMELINE_H_
+#define _ROUTINE_TIMELINE_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include "ccronexpr.h"
+#include "holiday_calendar.h"
+
+/*
+ * Linha do tempo diaria das rotinas. Uma vez por dia (e sempre que a
+ * configuracao muda) as rotinas agendadas sao cruzadas com o intervalo das
+ * rotinas, o intervalo de ferias, os dias de excecao e os feriados,
+ * ficando em RAM a lista ordenada das transicoes dos reles desse dia. Quando
+ * uma rotina dispara basta procurar a transicao na lista.
+ *
+ * O modulo nao depende de NVS nem de FreeRTOS, a configuracao chega em
+ * routine_calendar, por isso pode ser compilado no PC para simular um ano
+ * de rotinas dia a dia.
+ *
+ * As datas seguem o formato ja guardado em NVS: intervalos em AAMMDD e dias
+ * de excecao em DDMM, sempre com o mes de 0 a 11 (tm_mon). Os feriados
+ * chegam ja compilados para o ano corrente (holiday_calendar.h).
+ */
+
+#define ROUTINE_TIMELINE_MAX 256
+#define ROUTINE_TIMELINE_DATA_SIZE 4
+/* atraso maximo aceite entre a transicao e o disparo da rotina */
+#define ROUTINE_TIMELINE_SLACK_S 60
+#define ROUTINE_TIMELINE_DAY_BYTES ((12 * 31 + 7) / 8)
+
+typedef struct
+{
+  uint32_t range_from;
+  uint32_t range_to;
+  uint32_t holidays_from;
+  uint32_t holidays_to;
+  uint8_t has_range;
+  uint8_t has_holidays;
+  uint8_t exception_days[ROUTINE_TIMELINE_DAY_BYTES];
+  /* para dias fora de holidays.year as regras sao compiladas na hora */
+  const holiday_pack *holiday_pack;
+  uint32_t holiday_mask;
+  holiday_year holidays;
+
+} routine_calendar;
+
+typedef struct
+{
+  uint32_t second;
+  char data[ROUTINE_TIMELINE_DATA_SIZE];
+
+} routine_timeline_entry;
+
+typedef struct
+{
+  time_t day_start;
+  time_t day_end;
+  uint32_t date;
+  uint8_t active;
+  uint8_t overflow;
+  uint16_t count;
+  routine_timeline_entry entries[ROUTINE_TIMELINE_MAX];
+
+} routine_timeline;
+
+void routine_Calendar_Set_Day(uint8_t *days, uint8_t mday, uint8_t mon);
+
+uint8_t routine_Calendar_Get_Day(const uint8_t *days, uint8_t mday, uint8_t mon);
+
+uint8_t routine_Calendar_Parse_Day(const char *key, uint8_t *days);
+
+uint8_t routine_Calendar_Is_Active(const routine_calendar *calendar,
+                                   const struct tm *day);
+
+void routine_Timeline_Begin(routine_timeline *timeline,
+                            const routine_calendar *calendar, time_t now);
+
+void routine_Timeline_Add_Rule(routine_timeline *timeline, cron_expr *expression,
+                               const char *data);
+
+void routine_Timeline_End(routine_timeline *timeline);
+
+uint8_t routine_Timeline_Is_Today(const routine_timeline *timeline, time_t now);
+
+uint8_t routine_Timeline_Lookup(const routine_timeline *timeline, time_t now,
+                                const char *data);
+
+#endif
@@ -26,25 +26,24 @@
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
 #include "users.h"
+#include "routine_timeline.h"
+#include "routine_blob.h"
+#include "holiday_calendar.h"
 
 uint8_t label_Cron_Init = 0;
-TaskHandle_t task_Routine_BiState_RelayState1;
-TaskHandle_t task_Routine_BiState_RelayState2;
 allUsers_parameters_Message Routines_message;
 SemaphoreHandle_t rdySem_Send_Routines;
-SemaphoreHandle_t rdySem_Routine_BiState_Send_RelayState1;
-SemaphoreHandle_t rdySem_Routine_BiState_Send_RelayState2;
 
 uint8_t label_Routine1_ON;
 uint8_t label_Routine2_ON;
-uint8_t routines_ID;
+uint16_t routines_ID;
 
 struct list_node *routine_list;
 
 char file_contents_routines[200];
 char file_contents[200];
 
-char *parse_RoutineData(uint8_t BLE_SMS_Indication, uint8_t gattsIF, uint16_t connID, uint16_t handle_table, char cmd, char param, char *payload)
+static char *parse_RoutineData_Command(uint8_t BLE_SMS_Indication, uint8_t gattsIF, uint16_t connID, uint16_t handle_table, char cmd, char param, char *payload)
 {
 
     char *rsp = NULL;
@@ -81,7 +80,7 @@ char *parse_RoutineData(uint8_t BLE_SMS_Indication, uint8_t gattsIF, uint16_t co
         else if (param == ROUTINE_HOLIDAYS_MOBILE_DAYS)
         {
             label_BLE_UDP_send = 0;
-            asprintf(&rsp, "%s", set_holidaysDays(atoi(payload)));
+            asprintf(&rsp, "%s", set_holidaysDays(payload));
             return rsp;
         }
         else if (param == ROUTINES_HOLIDAYS_RANGE_PARAMETER)
@@ -145,6 +144,10 @@ char *parse_RoutineData(uint8_t BLE_SMS_Indication, uint8_t gattsIF, uint16_t co
             asprintf(&rsp, "%s %c %c %s", ROUTINE_ELEMENT, cmd, param, get_ExeptionDay());
             return rsp;
         }
+        else if (param == ROUTINE_PREVIEW_PARAMETER)
+        {
+            return get_Routines_Preview(payload);
+        }
         else if (param == ROUTINE_HOLIDAYS_MOBILE_DAYS)
         {
             /*memset(&rsp, 0, sizeof(rsp));*/
@@ -197,176 +200,160 @@ char *parse_RoutineData(uint8_t BLE_SMS_Indication, uint8_t gattsIF, uint16_t co
     return return_ERROR_Codes(&rsp, return_Json_SMS_Data("ERROR_INPUT_DATA"));
 }
 
-char *set_holidaysDays(uint8_t holidaysDays)
+char *parse_RoutineData(uint8_t BLE_SMS_Indication, uint8_t gattsIF, uint16_t connID, uint16_t handle_table, char cmd, char param, char *payload)
 {
-    // ////printf("\n\n holidaysDays . %d\n\n", holidaysDays);
-    if (holidaysDays & CARNIVAL_HOLYDAY_DAY)
-    {
-        // ////printf("\n\n set carnaval \n\n");
-        set_carnival();
-    }
+    char *rsp = parse_RoutineData_Command(BLE_SMS_Indication, gattsIF, connID, handle_table, cmd, param, payload);
 
-    if (holidaysDays & EASTER_FRIDAY_HOLYDAY_DAY)
+    // qualquer alteracao as rotinas, intervalos ou feriados recompila o dia
+    if (cmd == SET_CMD || cmd == RESET_CMD)
     {
-        // ////printf("\n\n set sexta santa \n\n");
-        set_easter_friday();
+        refresh_Routine_Timeline();
     }
 
-    if (holidaysDays & EASTER_HOLYDAY_DAY)
-    {
-        // ////printf("\n\n set pascoa \n\n");
-        set_easter_day();
-    }
+    return rsp;
+}
 
-    if (holidaysDays & CORPUS_CHRISTI_HOLYDAY_DAY)
+#if ROUTINE_BLOB_MAX > CRON_JOB_MAX
+#error "ROUTINE_BLOB_MAX maior que o pool do cron"
+#endif
+
+// 0 se o cabecalho ou alguma pagina nao existe ou nao passa no CRC
+static uint8_t load_Routine_Blob(routine_blob *blob)
+{
+    size_t size = routine_Blob_Header_Size();
+    char key[NVS_KEY_NAME_MAX_SIZE];
+
+    if (nvs_get_blob(nvs_Routines_handle, NVS_ROUTINES_BLOB, blob, &size) != ESP_OK || !routine_Blob_Is_Valid(blob, size))
     {
-        // ////printf("\n\n set corpo de cristo \n\n");
-        set_corpusChristi();
+        return 0;
     }
 
-    if (holidaysDays & EASTER_MONDAY_HOLYDAY_DAY)
+    for (uint16_t page = 0; page < routine_Blob_Pages(blob); page++)
     {
-        // ////printf("\n\n set corpo de cristo \n\n");
-        set_easter_monday();
+        size = routine_Blob_Page_Size(blob, page);
+        snprintf(key, sizeof(key), NVS_ROUTINES_BLOB_PAGE, page);
+
+        if (nvs_get_blob(nvs_Routines_handle, key, routine_Blob_Page(blob, page), &size) != ESP_OK ||
+            !routine_Blob_Page_Is_Valid(blob, page, size))
+        {
+            return 0;
+        }
     }
 
-    return "RT S H OK";
+    return 1;
 }
 
-char *reset_holidaysDays()
+// escreve as paginas a partir de first_page e so depois o cabecalho; um corte a meio deixa o CRC
+// errado e o proximo arranque volta a compilar as chaves de texto
+static uint8_t save_Routine_Blob(routine_blob *blob, uint16_t first_page)
 {
-    if (nvs_erase_all(nvs_Mobile_Holydays_handle) == ESP_OK)
-    {
-        nvs_erase_key(nvs_System_handle, NVS_KEY_LABEL_CARNIVAL);
-        nvs_erase_key(nvs_System_handle, NVS_KEY_LABEL_EASTER_FRIDAY);
-        nvs_erase_key(nvs_System_handle, NVS_KEY_LABEL_EASTER);
-        nvs_erase_key(nvs_System_handle, NVS_KEY_LABEL_CORPUS_CHRISTI);
-        nvs_erase_key(nvs_System_handle, NVS_KEY_LABEL_EASTER_MONDAY);
-        // ////printf("\nreset reset_holidaysDays\n");
-        return "OK";
+    char key[NVS_KEY_NAME_MAX_SIZE];
+
+    routine_Blob_Seal(blob, first_page);
+
+    for (uint16_t page = first_page; page < routine_Blob_Pages(blob); page++)
+    {
+        snprintf(key, sizeof(key), NVS_ROUTINES_BLOB_PAGE, page);
+
+        if (nvs_set_blob(nvs_Routines_handle, key, routine_Blob_Page(blob, page), routine_Blob_Page_Size(blob, page)) != ESP_OK)
+        {
+            return 0;
+        }
     }
-    else
+
+    if (nvs_set_blob(nvs_Routines_handle, NVS_ROUTINES_BLOB, blob, routine_Blob_Header_Size()) != ESP_OK)
     {
-        // ////printf("\nxep days ERROR\n");
-        return "ERROR";
+        return 0;
     }
+
+    return nvs_commit(nvs_Routines_handle) == ESP_OK;
 }
 
-char *get_holidaysDays()
+// rotinas so em texto (firmware anterior ou blob corrompido): compila-as uma vez, as chaves mantem-se
+static void migrate_Routine_Blob(routine_blob *blob)
 {
+    nvs_iterator_t it = nvs_entry_find("keys", NVS_ROUTINES_NAMESPACE, NVS_TYPE_STR);
+    char value[200];
 
-    uint8_t get_holidays = 0;
+    routine_Blob_Init(blob);
 
-    if (get_INT8_Data_From_Storage(NVS_KEY_LABEL_CARNIVAL, nvs_System_handle) == 1)
+    while (it != NULL)
     {
-        get_holidays = get_holidays + pow(2, 0);
-    }
+        nvs_entry_info_t info;
+        size_t required_size = sizeof(value);
 
-    if (get_INT8_Data_From_Storage(NVS_KEY_LABEL_EASTER_FRIDAY, nvs_System_handle) == 1)
-    {
-        get_holidays = get_holidays + pow(2, 1);
+        nvs_entry_info(it, &info);
+        it = nvs_entry_next(it);
+
+        // as rejeitadas ficam com a chave de texto, o RT G R continua a mostra-las
+        if (nvs_get_str(nvs_Routines_handle, info.key, value, &required_size) == ESP_OK &&
+            routine_Blob_Insert(blob, atoi(info.key), value) < 0)
+        {
+            ESP_LOGW("ROUTINES", "rotina %s nao migrada: %s", info.key, value);
+        }
     }
 
-    if (get_INT8_Data_From_Storage(NVS_KEY_LABEL_EASTER, nvs_System_handle) == 1)
+    save_Routine_Blob(blob, 0);
+}
+
+char *setRoutine(char *payload)
+{
+    char schedule[ROUTINE_BLOB_SCHEDULE_SIZE];
+    char data[ROUTINE_BLOB_DATA_SIZE];
+    char nvs_key[12];
+    int id;
+
+    if (!routine_Blob_Split(payload, schedule, data))
     {
-        get_holidays = get_holidays + pow(2, 2);
+        return ERROR_INPUT_DATA;
     }
 
-    if (get_INT8_Data_From_Storage(NVS_KEY_LABEL_CORPUS_CHRISTI, nvs_System_handle) == 1)
+    routine_blob *blob = (routine_blob *)malloc(sizeof(routine_blob));
+
+    if (blob == NULL)
     {
-        get_holidays = get_holidays + pow(2, 3);
+        return return_Json_SMS_Data("ERROR_SET");
     }
 
-    if (get_INT8_Data_From_Storage(NVS_KEY_LABEL_EASTER_MONDAY, nvs_System_handle) == 1)
+    if (!load_Routine_Blob(blob))
     {
-        get_holidays = get_holidays + pow(2, 4);
+        migrate_Routine_Blob(blob);
     }
 
-    sprintf(file_contents, "%d", get_holidays);
-    return file_contents;
-}
-
-char *setRoutine(char *payload)
-{
-    // ESP_ERROR_CHECK(heap_trace_start(HEAP_TRACE_LEAKS));
-    char *cron_Expression = (char *)malloc(strlen(payload));
-    char *cron_data = (char *)malloc(3);
-    memset(cron_Expression, 0, strlen(payload));
-    memset(cron_data, 0, 3);
-    uint8_t dot_Counter = 0;
-    uint8_t strIndex = 0;
-    routines_ID = 0;
-    char *nvs_key;
+    id = routine_Blob_Add(blob, payload);
 
-    for (int i = 0; i < strlen(payload); i++)
+    if (id < 0)
     {
-        if (payload[i] == ';')
-        {
-            dot_Counter++;
-            strIndex = 0;
-        }
-        else
-        {
-            if (dot_Counter == 0)
-            {
-                memcpy(cron_Expression + strIndex, payload + i, 1);
-                // cron_Expression[strIndex] = payload[i];
-                strIndex++;
-            }
-            else if (dot_Counter == 1)
-            {
-                memcpy(cron_data + strIndex, payload + i, 1);
-
-                // cron_data+strIndex = payload[i];
-                strIndex++;
-            }
-            else
-            {
-                return ERROR_INPUT_DATA;
-            }
-        }
+        free(blob);
+        return return_Json_SMS_Data("ERROR_SET");
     }
 
-    // ////printf("\nset routine payload - %s\n", payload);
-    // ////printf("\nset routine cron_Expression - %s, %d\n", cron_Expression, strlen(cron_Expression));
-    // ////printf("\nset routine cron_data - %s\n", cron_data);
-
-    routines_ID = get_INT8_Data_From_Storage(NVS_ROUTINES_ID, nvs_System_handle);
-    // ////printf("\nset routine routines_ID11 - %d\n", routines_ID);
+    // primeiro fica guardada (texto, ultima pagina e cabecalho), so depois entra no cron
+    snprintf(nvs_key, sizeof(nvs_key), "%d", id);
+    runtime_Status.nvs_write_counter++;
 
-    if (routines_ID == 255)
+    if (nvs_set_str(nvs_Routines_handle, nvs_key, payload) != ESP_OK ||
+        !save_Routine_Blob(blob, routine_Blob_Page_Of(blob->count - 1)))
     {
-        routines_ID = 0;
+        nvs_erase_key(nvs_Routines_handle, nvs_key);
+        nvs_commit(nvs_Routines_handle);
+        free(blob);
+        return return_Json_SMS_Data("ERROR_SET");
     }
-    else
+
+    if (cron_job_create_compiled(&blob->records[blob->count - 1].expression, test_cron_job_sample_callback, (void *)data) == NULL)
     {
-        routines_ID++;
+        // o pool do cron tem lugar para ROUTINE_BLOB_MAX, so falha sem memoria: desfaz a gravacao
+        nvs_erase_key(nvs_Routines_handle, nvs_key);
+        blob->count--;
+        save_Routine_Blob(blob, routine_Blob_Page_Of(blob->count));
+        free(blob);
+        return return_Json_SMS_Data("ERROR_SET");
     }
 
-    // ////printf("\nset routine routines_ID11 - %d\n", routines_ID);
-    //   routine_list->data = &cron_data;
-    // ////printf("\nset routine routines_ID1222 - %d\n", routines_ID);
-
-    // routine_list = list_insert_beginning(routine_list, cron_Expression, cron_data);
-    //   memcpy(routine_list->data,&cron_data,sizeof(cron_data));
-    /* //////printf("\nroutine_list->data - %s\n", routine_list->data);*/
-    // ////printf("\n cron_Expression %s - %s\n", cron_Expression, cron_data);
+    routines_ID = id;
+    free(blob);
 
-    cron_job_create(cron_Expression, test_cron_job_sample_callback, (void *)cron_data);
-
-    // ////printf("\nset routine 22 \n");
-    asprintf(&nvs_key, "%d", routines_ID);
-    save_STR_Data_In_Storage(nvs_key, payload, nvs_Routines_handle);
-    // ////printf("\nset routine 33 \n");
-    save_INT8_Data_In_Storage(NVS_ROUTINES_ID, routines_ID, nvs_System_handle);
-    // ////printf("\nset routine 44 \n");
-    free(nvs_key);
-    free(cron_Expression);
-    // ////printf("\nset routine 55 \n");
-    free(cron_data);
-    // ////printf("\nset routine 66 \n");
-    /*  ESP_ERROR_CHECK(heap_trace_stop());
-     heap_trace_dump(); */
     return "RT S R OK";
 }
 
@@ -392,22 +379,6 @@ char *eraseRoutines()
     // ESP_ERROR_CHECK(heap_trace_start(HEAP_TRACE_LEAKS));
     // ////printf("\nERASE 1\n");
 
-    if (task_Routine_BiState_RelayState1 != NULL)
-    {
-        // ////printf("\nERASE 31\n");
-
-        // xTaskAbortDelay(task_Routine_BiState_RelayState1);
-        // gpio_set_level(GPIO_OUTPUT_IO_0, 0);
-    }
-
-    if (task_Routine_BiState_RelayState2 != NULL)
-    {
-        // ////printf("\nERASE 32\n");
-
-        // xTaskAbortDelay(task_Routine_BiState_RelayState2);
-        // gpio_set_level(GPIO_OUTPUT_IO_1, 0);
-    }
-
     // label_MonoStableRelay1 = 0;
     // label_MonoStableRelay2 = 0;
 
@@ -424,17 +395,16 @@ char *eraseRoutines()
    routine_list->cron_expression = NULL; */
 
     routines_ID = 0;
-    save_INT8_Data_In_Storage(NVS_ROUTINES_ID, routines_ID, nvs_System_handle);
     // ////printf("\nERASE 4\n");
     if (nvs_erase_all(nvs_Routines_handle) == ESP_OK)
     {
         // ////printf("\nERASE 5\n");
         label_Routine2_ON = 0;
         label_Routine1_ON = 0;
-        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, 0, nvs_System_handle);
-        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_TIME_ON, 0, nvs_System_handle);
-        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, 0, nvs_System_handle);
-        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_TIME_ON, 0, nvs_System_handle);
+        save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, 0);
+        save_State_In_Journal(STATE_KEY_ROUTINE1_TIME_ON, 0);
+        save_State_In_Journal(STATE_KEY_ROUTINE2_LABEL, 0);
+        save_State_In_Journal(STATE_KEY_ROUTINE2_TIME_ON, 0);
         return "RT R R OK";
     }
     else
@@ -571,347 +541,560 @@ char *erase_Routine_Range()
 }
 #include "cron.h"
 #include "jobs.h"
-void test_cron_job_sample_callback(cron_job *job)
+
+static routine_timeline routine_Timeline;
+static SemaphoreHandle_t routine_Timeline_Mutex = NULL;
+static StaticSemaphore_t routine_Timeline_Mutex_Buffer;
+
+static void take_Routine_Timeline()
 {
-    //ESP_LOGI("TAG", "xPortGetFreeHeapSize  parseInputData1111: %d", xPortGetFreeHeapSize());
-    //ESP_LOGI("TAG", "esp_get_minimum_free_heap_size  : %d", esp_get_minimum_free_heap_size());
-    //ESP_LOGI("TAG", "heap_caps_get_largest_free_block: %d", heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
-    //ESP_LOGI("TAG", "free heap memory                : %d", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    if (routine_Timeline_Mutex == NULL)
+    {
+        routine_Timeline_Mutex = xSemaphoreCreateMutexStatic(&routine_Timeline_Mutex_Buffer);
+    }
+    xSemaphoreTake(routine_Timeline_Mutex, portMAX_DELAY);
+}
 
-    time_t now;
-    struct tm timeinfo;
-    char buffer[256], buffer2[256];
-    int buffer_len = 256;
-    char *cron_data;
-    char ex_Day[20] = {};
-    char date_Day[20] = {};
-    asprintf(&cron_data, "%s", (char *)job->data);
-    // cron_data = (char *)job->data;
+static void load_Routine_Calendar_Days(const char *namespace, uint8_t *days)
+{
+    nvs_iterator_t it = nvs_entry_find("keys", namespace, NVS_TYPE_U8);
 
-    time(&now);
-    /* setenv("TZ", "UTC1", 1);
-    tzset(); */
-    localtime_r(&now, &timeinfo);
-    strftime(buffer, buffer_len, "%c", &timeinfo);
-    /* setenv("TZ", "UTC1", 1);
-    tzset(); */
+    while (it != NULL)
+    {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        it = nvs_entry_next(it);
+        routine_Calendar_Parse_Day(info.key, days);
+    }
+}
 
-    sprintf(ex_Day, "%02d%02d", timeinfo.tm_mday, timeinfo.tm_mon);
-    sprintf(date_Day, "%02d%02d%02d", (timeinfo.tm_year - 100), timeinfo.tm_mon, timeinfo.tm_mday);
+// feriados por regras: pais, mascara das regras ligadas e o mapa de bits do ano
+// corrente, guardados num unico blob em MH_NAMESPACE
+typedef struct
+{
+    char country[HOLIDAY_COUNTRY_SIZE];
+    uint32_t mask;
+    holiday_year days;
 
-    localtime_r(&(job->next_execution), &timeinfo);
-    strftime(buffer2, buffer_len, "%c", &timeinfo);
+} routine_holidays;
 
-    // ////printf("\n (char *)job->data - %s\n", (char *)job->data);
+static routine_holidays routine_Holidays;
+static uint8_t routine_Holidays_Loaded = 0;
 
-    // ////printf("\n\n ex_Day - %s\n\n", ex_Day);
-    // ////printf("\n\n date_Day - %s\n\n", date_Day);
+static void save_Routine_Holidays()
+{
+    if (nvs_set_blob(nvs_Mobile_Holydays_handle, NVS_HOLIDAYS_BLOB, &routine_Holidays, sizeof(routine_Holidays)) == ESP_OK)
+    {
+        nvs_commit(nvs_Mobile_Holydays_handle);
+    }
+}
 
-    uint8_t value = 0;
-    uint8_t range_Label = 0;
-    uint8_t range_holidaysLabel = 0;
-    char range_InicialTime[7] = {};
-    char range_FinalTime[7] = {};
-    char range_holidaysInicialTime[7] = {};
-    char range_holydaysFinalTime[7] = {};
+// chamar com routine_Timeline_Mutex
+static void load_Routine_Holidays()
+{
+    static char *legacy_Keys[] = {NVS_KEY_LABEL_CARNIVAL, NVS_KEY_LABEL_EASTER_FRIDAY, NVS_KEY_LABEL_EASTER,
+                                  NVS_KEY_LABEL_CORPUS_CHRISTI, NVS_KEY_LABEL_EASTER_MONDAY};
+    size_t size = sizeof(routine_Holidays);
 
-    if (get_Routine_Range(&range_InicialTime, &range_FinalTime))
+    if (routine_Holidays_Loaded)
     {
+        return;
+    }
+    routine_Holidays_Loaded = 1;
 
-        // ////printf("\n inicial range - %s / final range - %s\n", range_InicialTime, range_FinalTime);
-        if (atoi(date_Day) >= atoi(range_InicialTime) && atoi(date_Day) <= atoi(range_FinalTime))
-        {
-            range_Label = 1;
-            // ////printf("\n\n range_Label = 1\n\n");
-        }
-        else
+    if (nvs_get_blob(nvs_Mobile_Holydays_handle, NVS_HOLIDAYS_BLOB, &routine_Holidays, &size) == ESP_OK &&
+        size == sizeof(routine_Holidays) && holiday_Find_Pack(routine_Holidays.country) != NULL)
+    {
+        return;
+    }
+
+    // firmware anterior: as flags do RT S H passam a bits das cinco primeiras regras PT
+    // e as datas DDMM do ano em que foram gravadas deixam de ser usadas
+    memset(&routine_Holidays, 0, sizeof(routine_Holidays));
+    strcpy(routine_Holidays.country, HOLIDAY_DEFAULT_COUNTRY);
+
+    for (uint8_t i = 0; i < sizeof(legacy_Keys) / sizeof(legacy_Keys[0]); i++)
+    {
+        if (get_INT8_Data_From_Storage(legacy_Keys[i], nvs_System_handle) == 1)
         {
-            // ////printf("\n\n range_Label = 0\n\n");
-            range_Label = 0;
+            routine_Holidays.mask |= 1 << i;
         }
+        nvs_erase_key(nvs_System_handle, legacy_Keys[i]);
     }
-    else
+
+    nvs_erase_all(nvs_Mobile_Holydays_handle);
+    save_Routine_Holidays();
+}
+
+static int get_Current_Year()
+{
+    time_t now;
+    struct tm today;
+
+    time(&now);
+    localtime_r(&now, &today);
+
+    return today.tm_year + 1900;
+}
+
+// chamar com routine_Timeline_Mutex, so escreve em NVS quando o ano ou a configuracao mudam
+static void compile_Routine_Holidays(int year, uint8_t force)
+{
+    load_Routine_Holidays();
+
+    if (!force && routine_Holidays.days.year == year)
     {
-        range_Label = 1;
+        return;
     }
 
-    // verifica se é dia de exceção
-    if (get_rangeHolidaysDays(&range_holidaysInicialTime, &range_holydaysFinalTime))
+    holiday_Compile_Year(&routine_Holidays.days, holiday_Find_Pack(routine_Holidays.country), routine_Holidays.mask, year);
+    save_Routine_Holidays();
+}
+
+// payload "<mascara>" ou "<mascara>;<pais>", bit N = regra N da tabela do pais
+char *set_holidaysDays(char *payload)
+{
+    char country[HOLIDAY_COUNTRY_SIZE] = {};
+    char *separator = strchr(payload, ';');
+    uint32_t mask = strtoul(payload, NULL, 10);
+
+    take_Routine_Timeline();
+    load_Routine_Holidays();
+
+    if (separator != NULL)
     {
-        if (atoi(date_Day) >= atoi(range_holidaysInicialTime) && atoi(date_Day) <= atoi(range_holydaysFinalTime))
+        strncpy(country, separator + 1, sizeof(country) - 1);
+
+        if (holiday_Find_Pack(country) == NULL)
         {
-            range_holidaysLabel = 0;
-            // ////printf("\n\n range_Label = 1\n\n");
+            xSemaphoreGive(routine_Timeline_Mutex);
+            return "RT S H ERROR";
         }
-        else
+
+        // os bits de outro pais referem-se a outras regras
+        if (strcmp(country, routine_Holidays.country))
         {
-            // ////printf("\n\n range_Label = 0\n\n");
-            range_holidaysLabel = 1;
+            strcpy(routine_Holidays.country, country);
+            routine_Holidays.mask = 0;
         }
     }
+
+    routine_Holidays.mask |= mask;
+    compile_Routine_Holidays(get_Current_Year(), 1);
+
+    xSemaphoreGive(routine_Timeline_Mutex);
+
+    return "RT S H OK";
+}
+
+char *reset_holidaysDays()
+{
+    esp_err_t err = ESP_OK;
+
+    take_Routine_Timeline();
+    load_Routine_Holidays();
+
+    routine_Holidays.mask = 0;
+    err = nvs_erase_all(nvs_Mobile_Holydays_handle);
+    compile_Routine_Holidays(get_Current_Year(), 1);
+
+    xSemaphoreGive(routine_Timeline_Mutex);
+
+    return err == ESP_OK ? "OK" : "ERROR";
+}
+
+// o pais so e indicado quando nao e o de origem, a resposta antiga era so a mascara
+char *get_holidaysDays()
+{
+    take_Routine_Timeline();
+    load_Routine_Holidays();
+
+    if (strcmp(routine_Holidays.country, HOLIDAY_DEFAULT_COUNTRY))
+    {
+        sprintf(file_contents, "%lu;%s", (unsigned long)routine_Holidays.mask, routine_Holidays.country);
+    }
     else
     {
-        range_holidaysLabel = 1;
+        sprintf(file_contents, "%lu", (unsigned long)routine_Holidays.mask);
+    }
+
+    xSemaphoreGive(routine_Timeline_Mutex);
+
+    return file_contents;
+}
+
+static void load_Routine_Calendar(routine_calendar *calendar)
+{
+    char inicialTime[7] = {};
+    char finalTime[7] = {};
+
+    memset(calendar, 0, sizeof(routine_calendar));
+
+    if (get_Routine_Range(inicialTime, finalTime))
+    {
+        calendar->has_range = 1;
+        calendar->range_from = atoi(inicialTime);
+        calendar->range_to = atoi(finalTime);
+    }
+
+    memset(inicialTime, 0, sizeof(inicialTime));
+    memset(finalTime, 0, sizeof(finalTime));
+
+    if (get_rangeHolidaysDays(inicialTime, finalTime))
+    {
+        calendar->has_holidays = 1;
+        calendar->holidays_from = atoi(inicialTime);
+        calendar->holidays_to = atoi(finalTime);
+    }
+
+    load_Routine_Calendar_Days(NVS_EXEPTION_DAYS_NAMESPACE, calendar->exception_days);
+
+    compile_Routine_Holidays(get_Current_Year(), 0);
+    calendar->holiday_pack = holiday_Find_Pack(routine_Holidays.country);
+    calendar->holiday_mask = routine_Holidays.mask;
+    calendar->holidays = routine_Holidays.days;
+}
+
+static void add_Routine_Timeline_Job(cron_job *job, void *ctx)
+{
+    routine_Timeline_Add_Rule((routine_timeline *)ctx, &job->expression, job->data);
+}
+
+// chamar com routine_Timeline_Mutex
+static void compile_Routine_Timeline(time_t now)
+{
+    routine_calendar calendar;
+
+    load_Routine_Calendar(&calendar);
+    routine_Timeline_Begin(&routine_Timeline, &calendar, now);
+    cron_job_list_foreach(add_Routine_Timeline_Job, &routine_Timeline);
+    routine_Timeline_End(&routine_Timeline);
+}
+
+void refresh_Routine_Timeline()
+{
+    time_t now;
+    time(&now);
+
+    take_Routine_Timeline();
+    compile_Routine_Timeline(now);
+    xSemaphoreGive(routine_Timeline_Mutex);
+}
+
+static uint8_t check_Routine_Timeline(const char *data)
+{
+    uint8_t ret = 0;
+    time_t now;
+    time(&now);
+
+    take_Routine_Timeline();
+    // so acontece se a compilacao da meia noite nao correu (relogio acertado, arranque)
+    if (!routine_Timeline_Is_Today(&routine_Timeline, now))
+    {
+        compile_Routine_Timeline(now);
     }
+    ret = routine_Timeline_Lookup(&routine_Timeline, now, data);
+    xSemaphoreGive(routine_Timeline_Mutex);
 
-    // verifica se é dia de exceção
+    return ret;
+}
 
-    esp_err_t err = nvs_get_u8(nvs_Exeption_Days_handle, ex_Day, &value);
-    esp_err_t err_holydays = nvs_get_u8(nvs_Mobile_Holydays_handle, ex_Day, &value);
+typedef struct
+{
+    time_t now;
+    int n;
+    int count;
+    routine_calendar calendar;
+    routine_preview_entry entries[ROUTINE_PREVIEW_MAX];
 
-    if (err != ESP_OK)
+} routine_preview;
+
+static void add_Routine_Preview_Job(cron_job *job, void *ctx)
+{
+    routine_preview *preview = (routine_preview *)ctx;
+    time_t next[ROUTINE_PREVIEW_MAX];
+    time_t from = preview->now;
+    int count = 0;
+
+    // os dias filtrados pelo calendario nao contam, pede mais disparos ate ROUTINE_PREVIEW_BATCHES vezes
+    for (int batch = 0; batch < ROUTINE_PREVIEW_BATCHES; batch++)
     {
-        if (err_holydays != ESP_OK)
+        int accepted = 0;
+
+        count = cron_next_n(&job->expression, from, preview->n, next);
+
+        for (int i = 0; i < count; i++)
         {
+            struct tm day;
+            int pos = preview->count;
+
+            localtime_r(&next[i], &day);
 
-            if (range_Label == 1 && range_holidaysLabel == 1)
+            if (!routine_Calendar_Is_Active(&preview->calendar, &day))
             {
+                continue;
+            }
+            accepted++;
 
-                sdCard_Logs_struct logs_struct;
-                memset(&logs_struct, 0, sizeof(logs_struct));
-                if (job->data[0] == '1')
+            while (pos > 0 && preview->entries[pos - 1].time > next[i])
+            {
+                if (pos < preview->n)
                 {
-                    if (job->data[1] == '0')
-                    {
-                        label_Routine1_ON = 0;
-
-                        gpio_set_level(GPIO_OUTPUT_IO_0, 0);
-                        // TODO: INSERIR NO CODIGO DO M200
-                        save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, 0, nvs_System_handle);
-                        label_Routine1_ON = 0;
-                        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, 0, nvs_System_handle);
-                        nvs_set_u64(nvs_System_handle, NVS_KEY_ROUTINE1_TIME_ON, 0);
+                    preview->entries[pos] = preview->entries[pos - 1];
+                }
+                pos--;
+            }
 
-                        BLE_Broadcast_Notify("R1 S R 0");
-                    }
-                    else if (job->data[1] == '1')
-                    {
-                        label_Routine1_ON = 1;
-                        gpio_set_level(GPIO_OUTPUT_IO_0, 1);
+            if (pos < preview->n)
+            {
+                preview->entries[pos].time = next[i];
+                memcpy(preview->entries[pos].data, job->data, sizeof(preview->entries[pos].data));
 
-                        save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, 1, nvs_System_handle);
-                        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, 1, nvs_System_handle);
+                if (preview->count < preview->n)
+                {
+                    preview->count++;
+                }
+            }
+        }
 
-                        /**********************************************************/
+        if (count < preview->n || accepted == preview->n)
+        {
+            break;
+        }
+        from = next[count - 1];
+    }
+}
 
-                        // TODO: INSERIR NO CODIGO DO M200
+char *get_Routines_Preview(char *payload)
+{
+    static routine_preview preview;
+    char *rsp = NULL;
+    char entry[32] = {};
+    char list[ROUTINE_PREVIEW_MAX * sizeof(entry)] = {};
 
-                        struct cron_job_node *jobNode = cron_job_list_first();
+    take_Routine_Timeline();
 
-                        uint64_t auxTime_routine = -1;
+    memset(&preview, 0, sizeof(preview));
+    time(&preview.now);
+    preview.n = atoi(payload);
 
-                        ////printf("\n\nROUTINE TIME 12345: %ld - %d\n\n", jobNode->job->next_execution, jobNode->job->id);
+    if (preview.n <= 0 || preview.n > ROUTINE_PREVIEW_MAX)
+    {
+        preview.n = ROUTINE_PREVIEW_MAX;
+    }
 
-                        while (jobNode != NULL)
-                        {
-                            if (!strcmp(jobNode->job->data, "10") || !strcmp(jobNode->job->data, "12"))
-                            {
-                                if (jobNode->job->next_execution < auxTime_routine)
-                                {
-                                    auxTime_routine = jobNode->job->next_execution;
-                                }
-                            }
+    load_Routine_Calendar(&preview.calendar);
+    cron_job_list_foreach(add_Routine_Preview_Job, &preview);
 
-                            ////printf("\n\nROUTINE TIME AFTER122: %ld - %d\n\n", jobNode->job->next_execution, jobNode->job->id);
+    for (int i = 0; i < preview.count; i++)
+    {
+        sprintf(entry, "%s%lld,%s", i ? ";" : "", (long long)preview.entries[i].time, preview.entries[i].data);
+        strcat(list, entry);
+    }
 
-                            ////printf("\n\nROUTINE EXPRESSION: %hhn,%hhn,%hhn\n\n", jobNode->job->expression.seconds, jobNode->job->expression.minutes, jobNode->job->expression.hours);
+    xSemaphoreGive(routine_Timeline_Mutex);
 
-                            jobNode = jobNode->next;
-                        }
+    if (preview.count == 0)
+    {
+        return return_ERROR_Codes(&rsp, "RT G N NO ROUTINES");
+    }
 
-                        ////printf("\n\nROUTINE TIME final: %lld\n\n", auxTime_routine);
-                        nvs_set_u64(nvs_System_handle, NVS_KEY_ROUTINE1_TIME_ON, auxTime_routine);
+    asprintf(&rsp, "%s %c %c %s", ROUTINE_ELEMENT, GET_CMD, ROUTINE_PREVIEW_PARAMETER, list);
+    return rsp;
+}
 
-                        free(jobNode);
+void test_cron_job_sample_callback(cron_job *job)
+{
+    //ESP_LOGI("TAG", "xPortGetFreeHeapSize  parseInputData1111: %d", xPortGetFreeHeapSize());
+    //ESP_LOGI("TAG", "esp_get_minimum_free_heap_size  : %d", esp_get_minimum_free_heap_size());
+    //ESP_LOGI("TAG", "heap_caps_get_largest_free_block: %d", heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+    //ESP_LOGI("TAG", "free heap memory                : %d", heap_caps_get_free_size(MALLOC_CAP_8BIT));
 
-                        /************************************************************/
-                        BLE_Broadcast_Notify("R1 S R 1");
-                        // ////printf("\n\nGPIO_OUTPUT_IO_0 job->data[1] == '1'\n\n");
-                    }
-                    else if (job->data[1] == '2')
-                    {
-                        if (label_MonoStableRelay1 != 1)
-                        {
-                            // TODO: INSERIR NO CODIGO DO M200
-                            xSemaphoreGive(rdySem_Routine_BiState_Send_RelayState1);
-                            save_INT8_Data_In_Storage(NVS_KEY_RELAY1_LAST_VALUE, 0, nvs_System_handle);
-                            label_Routine1_ON = 0;
-                            save_INT8_Data_In_Storage(NVS_KEY_ROUTINE1_LABEL, 0, nvs_System_handle);
-                            nvs_set_u64(nvs_System_handle, NVS_KEY_ROUTINE1_TIME_ON, 0);
-                        }
-                    }
+    if (check_Routine_Timeline(job->data))
+    {
+        sdCard_Logs_struct logs_struct;
+        memset(&logs_struct, 0, sizeof(logs_struct));
+        if (job->data[0] == '1')
+        {
+            if (job->data[1] == '0')
+            {
+                label_Routine1_ON = 0;
 
-                    if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD) || network_Activate_Flag == 1)
-                    {
+                set_Relay_Level(RELE1_NUMBER, 0);
+                // TODO: INSERIR NO CODIGO DO M200
+                label_Routine1_ON = 0;
+                save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, 0);
+                save_State_In_Journal(STATE_KEY_ROUTINE1_TIME_ON, 0);
 
-                        memset(&logs_struct, 0, sizeof(logs_struct));
+                BLE_Broadcast_Notify("R1 S R 0");
+            }
+            else if (job->data[1] == '1')
+            {
+                label_Routine1_ON = 1;
+                set_Relay_Level(RELE1_NUMBER, 1);
+                save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, 1);
 
-                        sprintf(logs_struct.type, "%s", "");
-                        sprintf(logs_struct.name, "%s", return_Json_SMS_Data("ROUTINE"));
-                        sprintf(logs_struct.phone, "%s", "");
-                        sprintf(logs_struct.relay, "%s", "R1");
+                /**********************************************************/
 
-                        if (job->data[1] == '0')
-                        {
-                            sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("OFF"));
-                            // ////printf("\n\n ROUTINES logs_struct.relay_state %s\n\n", logs_struct.relay_state);
-                        }
-                        else if (job->data[1] == '1')
-                        {
-                            sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("ON"));
-                            // ////printf("\n\n ROUTINES logs_struct.relay_state %s\n\n", logs_struct.relay_state);
-                        }
-                        else if (job->data[1] == '2')
-                        {
-                            sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("PULSE"));
-                        }
+                // TODO: INSERIR NO CODIGO DO M200
 
-                        if (get_RTC_System_Time())
-                        {
-                            sprintf(logs_struct.date, "%s", replace_Char_in_String(nowTime.strTime, ',', ';'));
-                        }
-                        else
-                        {
-                            sprintf(logs_struct.date, "%s", "0,0");
-                            sprintf(logs_struct.error, "%s", return_Json_SMS_Data("ERRO_LOGS_GET_TIME"));
-                        }
+                uint64_t auxTime_routine = cron_job_list_next_execution_of("10");
+                uint64_t auxTime_routine_pulse = cron_job_list_next_execution_of("12");
 
-                        sdCard_Write_LOGS(&logs_struct);
-                    }
+                if (auxTime_routine_pulse < auxTime_routine)
+                {
+                    auxTime_routine = auxTime_routine_pulse;
                 }
-                else if (job->data[0] == '2')
+
+                ////printf("\n\nROUTINE TIME final: %lld\n\n", auxTime_routine);
+                save_State_In_Journal(STATE_KEY_ROUTINE1_TIME_ON, auxTime_routine);
+
+                /************************************************************/
+                BLE_Broadcast_Notify("R1 S R 1");
+                // ////printf("\n\nGPIO_OUTPUT_IO_0 job->data[1] == '1'\n\n");
+            }
+            else if (job->data[1] == '2')
+            {
+                if (label_MonoStableRelay1 != 1)
                 {
-                    if (job->data[1] == '0')
-                    {
-                        label_Routine2_ON = 0;
-                        gpio_set_level(GPIO_OUTPUT_IO_1, 0);
-                        // TODO: INSERIR NO CODIGO DO M200
-                        save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, 0, nvs_System_handle);
-                        label_Routine2_ON = 0;
-                        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, 0, nvs_System_handle);
-                        nvs_set_u64(nvs_System_handle, NVS_KEY_ROUTINE2_TIME_ON, 0);
-
-                        BLE_Broadcast_Notify("R2 S R 0");
-                    }
-                    else if (job->data[1] == '1')
-                    {
-                        label_Routine2_ON = 1;
-                        gpio_set_level(GPIO_OUTPUT_IO_1, 1);
+                    // TODO: INSERIR NO CODIGO DO M200
+                    pulse_Relay(RELE1_NUMBER, rele1_Bistate_Time * 1000);
+                    label_Routine1_ON = 0;
+                    save_State_In_Journal(STATE_KEY_ROUTINE1_LABEL, 0);
+                    save_State_In_Journal(STATE_KEY_ROUTINE1_TIME_ON, 0);
+                }
+            }
 
-                        save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, 1, nvs_System_handle);
-                        save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, 1, nvs_System_handle);
+            if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD) || network_Activate_Flag == 1)
+            {
 
-                        /* ////printf("\n\nROUTINE TIME AFTER1: %d - %hhn\n\n", job->id, job->expression.minutes); */
-                        ////printf("\n\nROUTINE TIME AFTER2:\n\n");
+                memset(&logs_struct, 0, sizeof(logs_struct));
 
-                        /**********************************************************/
+                sprintf(logs_struct.type, "%s", "");
+                sprintf(logs_struct.name, "%s", return_Json_SMS_Data("ROUTINE"));
+                sprintf(logs_struct.phone, "%s", "");
+                sprintf(logs_struct.relay, "%s", "R1");
 
-                        // TODO: INSERIR NO CODIGO DO M200
+                if (job->data[1] == '0')
+                {
+                    sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("OFF"));
+                    // ////printf("\n\n ROUTINES logs_struct.relay_state %s\n\n", logs_struct.relay_state);
+                }
+                else if (job->data[1] == '1')
+                {
+                    sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("ON"));
+                    // ////printf("\n\n ROUTINES logs_struct.relay_state %s\n\n", logs_struct.relay_state);
+                }
+                else if (job->data[1] == '2')
+                {
+                    sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("PULSE"));
+                }
 
-                        // STATIC FUNCTION DECLARATIONS
-                        struct cron_job_node *jobNode = cron_job_list_first();
+                if (get_RTC_System_Time())
+                {
+                    sprintf(logs_struct.date, "%s", replace_Char_in_String(nowTime.strTime, ',', ';'));
+                }
+                else
+                {
+                    sprintf(logs_struct.date, "%s", "0,0");
+                    sprintf(logs_struct.error, "%s", return_Json_SMS_Data("ERRO_LOGS_GET_TIME"));
+                }
 
-                        uint64_t auxTime_routine = -1;
+                sdCard_Write_LOGS(&logs_struct);
+            }
+        }
+        else if (job->data[0] == '2')
+        {
+            if (job->data[1] == '0')
+            {
+                label_Routine2_ON = 0;
+                set_Relay_Level(RELE2_NUMBER, 0);
+                // TODO: INSERIR NO CODIGO DO M200
+                label_Routine2_ON = 0;
+                save_State_In_Journal(STATE_KEY_ROUTINE2_LABEL, 0);
+                save_State_In_Journal(STATE_KEY_ROUTINE2_TIME_ON, 0);
+
+                BLE_Broadcast_Notify("R2 S R 0");
+            }
+            else if (job->data[1] == '1')
+            {
+                label_Routine2_ON = 1;
+                set_Relay_Level(RELE2_NUMBER, 1);
+                save_State_In_Journal(STATE_KEY_ROUTINE2_LABEL, 1);
 
-                        ////printf("\n\nROUTINE TIME 12345: %ld - %d\n\n", jobNode->job->next_execution, jobNode->job->id);
+                /* ////printf("\n\nROUTINE TIME AFTER1: %d - %hhn\n\n", job->id, job->expression.minutes); */
+                ////printf("\n\nROUTINE TIME AFTER2:\n\n");
 
-                        while (jobNode != NULL)
-                        {
-                            if (!strcmp(jobNode->job->data, "20") || !strcmp(jobNode->job->data, "22"))
-                            {
-                                if (jobNode->job->next_execution < auxTime_routine)
-                                {
-                                    auxTime_routine = jobNode->job->next_execution;
-                                }
-                            }
+                /**********************************************************/
 
-                            ////printf("\n\nROUTINE TIME AFTER122: %ld - %d\n\n", jobNode->job->next_execution, jobNode->job->id);
+                // TODO: INSERIR NO CODIGO DO M200
 
-                            ////printf("\n\nROUTINE EXPRESSION: %hhn,%hhn,%hhn\n\n", jobNode->job->expression.seconds, jobNode->job->expression.minutes, jobNode->job->expression.hours);
+                uint64_t auxTime_routine = cron_job_list_next_execution_of("20");
+                uint64_t auxTime_routine_pulse = cron_job_list_next_execution_of("22");
 
-                            jobNode = jobNode->next;
-                        }
+                if (auxTime_routine_pulse < auxTime_routine)
+                {
+                    auxTime_routine = auxTime_routine_pulse;
+                }
 
-                        nvs_set_u64(nvs_System_handle, NVS_KEY_ROUTINE2_TIME_ON, auxTime_routine);
-                        ////printf("\n\nROUTINE TIME final: %lld\n\n", auxTime_routine);
+                save_State_In_Journal(STATE_KEY_ROUTINE2_TIME_ON, auxTime_routine);
+                ////printf("\n\nROUTINE TIME final: %lld\n\n", auxTime_routine);
 
-                        free(jobNode);
-                        /************************************************************/
+                /************************************************************/
 
-                        BLE_Broadcast_Notify("R2 S R 1");
-                        // ////printf("\n\nGPIO_OUTPUT_IO_1 job->data[1] == '1'\n\n");
-                    }
-                    else if (job->data[1] == '2')
-                    {
-                        if (label_MonoStableRelay2 != 1)
-                        { // TODO: INSERIR NO CODIGO DO M200
-                            xSemaphoreGive(rdySem_Routine_BiState_Send_RelayState2);
-                            save_INT8_Data_In_Storage(NVS_KEY_RELAY2_LAST_VALUE, 0, nvs_System_handle);
-                            label_Routine2_ON = 0;
-                            save_INT8_Data_In_Storage(NVS_KEY_ROUTINE2_LABEL, 0, nvs_System_handle);
-                            nvs_set_u64(nvs_System_handle, NVS_KEY_ROUTINE2_TIME_ON, 0);
-                        }
-                    }
+                BLE_Broadcast_Notify("R2 S R 1");
+                // ////printf("\n\nGPIO_OUTPUT_IO_1 job->data[1] == '1'\n\n");
+            }
+            else if (job->data[1] == '2')
+            {
+                if (label_MonoStableRelay2 != 1)
+                { // TODO: INSERIR NO CODIGO DO M200
+                    pulse_Relay(RELE2_NUMBER, rele2_Bistate_Time * 1000);
+                    label_Routine2_ON = 0;
+                    save_State_In_Journal(STATE_KEY_ROUTINE2_LABEL, 0);
+                    save_State_In_Journal(STATE_KEY_ROUTINE2_TIME_ON, 0);
+                }
+            }
 
-                    if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD) || network_Activate_Flag == 1)
-                    {
+            if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD) || network_Activate_Flag == 1)
+            {
 
-                        memset(&logs_struct, 0, sizeof(logs_struct));
+                memset(&logs_struct, 0, sizeof(logs_struct));
 
-                        sprintf(logs_struct.type, "%s", "");
-                        sprintf(logs_struct.name, "%s", return_Json_SMS_Data("ROUTINE"));
-                        sprintf(logs_struct.phone, "%s", "");
-                        sprintf(logs_struct.relay, "%s", "R2");
+                sprintf(logs_struct.type, "%s", "");
+                sprintf(logs_struct.name, "%s", return_Json_SMS_Data("ROUTINE"));
+                sprintf(logs_struct.phone, "%s", "");
+                sprintf(logs_struct.relay, "%s", "R2");
 
-                        if (job->data[1] == '0')
-                        {
-                            sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("OFF"));
-                            // ////printf("\n\n ROUTINES logs_struct.relay_state %s\n\n", logs_struct.relay_state);
-                        }
-                        else if (job->data[1] == '1')
-                        {
-                            sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("ON"));
-                            // ////printf("\n\n ROUTINES logs_struct.relay_state %s\n\n", logs_struct.relay_state);
-                        }
-                        else if (job->data[1] == '2')
-                        {
-                            sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("PULSE"));
-                        }
+                if (job->data[1] == '0')
+                {
+                    sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("OFF"));
+                    // ////printf("\n\n ROUTINES logs_struct.relay_state %s\n\n", logs_struct.relay_state);
+                }
+                else if (job->data[1] == '1')
+                {
+                    sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("ON"));
+                    // ////printf("\n\n ROUTINES logs_struct.relay_state %s\n\n", logs_struct.relay_state);
+                }
+                else if (job->data[1] == '2')
+                {
+                    sprintf(logs_struct.relay_state, "%s", return_Json_SMS_Data("PULSE"));
+                }
 
-                        if (get_RTC_System_Time())
-                        {
-                            sprintf(logs_struct.date, "%s", replace_Char_in_String(nowTime.strTime, ',', ';'));
-                        }
-                        else
-                        {
-                            sprintf(logs_struct.date, "%s", "0,0");
-                            sprintf(logs_struct.error, "%s", return_Json_SMS_Data("ERRO_LOGS_GET_TIME"));
-                        }
-                        sdCard_Write_LOGS(&logs_struct);
-                    }
+                if (get_RTC_System_Time())
+                {
+                    sprintf(logs_struct.date, "%s", replace_Char_in_String(nowTime.strTime, ',', ';'));
+                }
+                else
+                {
+                    sprintf(logs_struct.date, "%s", "0,0");
+                    sprintf(logs_struct.error, "%s", return_Json_SMS_Data("ERRO_LOGS_GET_TIME"));
                 }
+                sdCard_Write_LOGS(&logs_struct);
             }
         }
-        else
-        {
-            /* gpio_set_level(GPIO_OUTPUT_IO_0, 0);
-            gpio_set_level(GPIO_OUTPUT_IO_1, 0); */
-            // ////printf("\n OUT OF RANGE\n");
-        }
-    }
-    else
-    {
-        /* gpio_set_level(GPIO_OUTPUT_IO_0, 0);
-        gpio_set_level(GPIO_OUTPUT_IO_1, 0); */
-        // ////printf("\n\n IS EXEPTION DAY\n\n");
     }
 
-    // ////printf("\n\njob->data - %s\n\n", cron_data);
-
-    // ////printf("\n CALLBACK RUNNED AT TIME: %s SHOULD RUN AT: %s WITH DATA: %s \n", buffer, buffer2, (char *)job->data);
-
-    free(cron_data);
-
     //ESP_LOGI("TAG", "xPortGetFreeHeapSize  parseInputData1111: %d", xPortGetFreeHeapSize());
     //ESP_LOGI("TAG", "esp_get_minimum_free_heap_size  : %d", esp_get_minimum_free_heap_size());
     //ESP_LOGI("TAG", "heap_caps_get_largest_free_block: %d", heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
@@ -1285,107 +1468,37 @@ uint8_t get_Routine_Range(char *inicalTime, char *finalTime)
     return 1;
 }
 
-void task_Routine_BiState_Send_RelayState1(void *pvParameter)
+void initRoutines()
 {
+    routine_blob *blob = (routine_blob *)malloc(sizeof(routine_blob));
 
-    while (1)
-    {
-        xSemaphoreTake(rdySem_Routine_BiState_Send_RelayState1, portMAX_DELAY);
-        // ////printf("\n\n biestavel routine %d\n\n",rele1_Bistate_Time);
-        if (label_MonoStableRelay1 != 1)
-        {
-            label_MonoStableRelay1 = 1;
-            if (label_MonoStableRelay1 == 1)
-            {
-                gpio_set_level(GPIO_OUTPUT_IO_0, 1);
-            }
-
-            vTaskDelay(pdMS_TO_TICKS((rele1_Bistate_Time * 1000)));
-
-            if (label_MonoStableRelay1 == 1)
-            {
-                gpio_set_level(GPIO_OUTPUT_IO_0, 0);
-            }
-            label_MonoStableRelay1 = 0;
-        }
-    }
-    task_Routine_BiState_RelayState1 = NULL;
-    vTaskDelete(task_Routine_BiState_RelayState1);
-}
+    label_Cron_Init = 1;
 
-void task_Routine_BiState_Send_RelayState2(void *pvParameter)
-{
-    while (1)
+    if (blob != NULL)
     {
-        xSemaphoreTake(rdySem_Routine_BiState_Send_RelayState2, portMAX_DELAY);
-        if (label_MonoStableRelay2 != 1)
+        // cabecalho e paginas do blob, sem escritas na flash exceto na primeira migracao
+        if (!load_Routine_Blob(blob))
         {
-            label_MonoStableRelay2 = 1;
-            if (label_MonoStableRelay2 == 1)
-            {
-                gpio_set_level(GPIO_OUTPUT_IO_1, 1);
-            }
-
-            vTaskDelay(pdMS_TO_TICKS((rele2_Bistate_Time * 1000)));
-
-            if (label_MonoStableRelay2 == 1)
-            {
-                gpio_set_level(GPIO_OUTPUT_IO_1, 0);
-            }
+            migrate_Routine_Blob(blob);
         }
-        label_MonoStableRelay2 = 0;
-    }
-    task_Routine_BiState_RelayState2 = NULL;
-    vTaskDelete(task_Routine_BiState_RelayState2);
-}
-
-void initRoutines()
-{
-    // heap_trace_start(HEAP_TRACE_LEAKS);
-    // label_Routine1_ON = 0;
-    // label_Routine2_ON = 0;
-    nvs_iterator_t it;
-    it = nvs_entry_find("keys", NVS_ROUTINES_NAMESPACE, NVS_TYPE_STR);
-    char value[200];
-    label_Cron_Init = 1;
-    size_t required_size = 0;
-    routines_ID = 0;
-    save_INT8_Data_In_Storage(NVS_ROUTINES_ID, routines_ID, nvs_System_handle);
-    // ////printf("\n\n akakak 1000\n\n");
-    while (it != NULL)
-    {
-        nvs_entry_info_t info;
-        nvs_entry_info(it, &info);
-        it = nvs_entry_next(it);
-        // ////printf("ROUTINES - key '%s', type '%d' \n", info.key, info.type);
 
-        if (nvs_get_str(nvs_Routines_handle, info.key, NULL, &required_size) == ESP_OK)
+        for (uint16_t i = 0; i < blob->count; i++)
         {
-            // ////printf("\nROUTINES require size %d\n", required_size);
-            // ////printf("\n ROUTINES NAMESPACE\n");
-            if (nvs_get_str(nvs_Routines_handle, info.key, value, &required_size) == ESP_OK)
-            {
-                // ////printf("\naux get str %s\n", value);
-                setRoutine(value);
-            }
+            cron_job_create_compiled(&blob->records[i].expression, test_cron_job_sample_callback, (void *)blob->records[i].data);
         }
-        required_size = 0;
-        memset(value, 0, 200);
-        vTaskDelay(pdMS_TO_TICKS(100));
+
+        routines_ID = blob->next_id - 1;
     }
-    label_Cron_Init = 0;
 
-    it = nvs_entry_find("keys", NVS_ROUTINES_NAMESPACE, NVS_TYPE_STR);
+    label_Cron_Init = 0;
+    refresh_Routine_Timeline();
 
-    if (it != NULL)
+    if (blob != NULL && blob->count > 0)
     {
         cron_start();
     }
-    // ////printf("\n\n akakak 1001\n\n");
-    free(it);
-    // ////printf("\n\n akakak 1002\n\n");
-    // heap_trace_stop();
-    // heap_trace_dump();
+
+    free(blob);
 }
 
 char *activate_Routines(uint8_t BLE_indication, uint8_t gattsIF, uint16_t connID, uint16_t handle_table)
@@ -1518,170 +1631,6 @@ char *activate_Routines(uint8_t BLE_indication, uint8_t gattsIF, uint16_t connID
     return "NTRSP";
 }
 
-void calcularPascoa(int ano, int *dia, int *mes)
-{
-    int a = ano % 19;
-    int b = ano / 100;
-    int c = ano % 100;
-    int d = b / 4;
-    int e = b % 4;
-    int f = (b + 8) / 25;
-    int g = (b - f + 1) / 3;
-    int h = (19 * a + b - d - g + 15) % 30;
-    int i = c / 4;
-    int k = c % 4;
-    int l = (32 + 2 * e + 2 * i - h - k) % 7;
-    int m = (a + 11 * h + 22 * l) / 451;
-    int n = (h + l - 7 * m + 114) / 31;
-    int p = (h + l - 7 * m + 114) % 31;
-
-    *dia = p + 1;
-    *mes = n;
-}
-
-// Função para subtrair dias de uma data
-int subtrairDias(int date, int days)
-{
-    int diasPorMes[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-
-    int year = date / 10000;
-    int month = (date / 100) - (year * 100);
-    int day = date - ((year * 10000) + (month * 100));
-
-    // Subtrair os dias da data
-    day -= days;
-
-    while (day <= 0)
-    {
-        month--;
-
-        if (month <= 0)
-        {
-            year--;
-            month = 12;
-        }
-
-        if (month == 2 && isLeapYear(year))
-        {
-            day += 29;
-        }
-        else
-        {
-            day += diasPorMes[month - 1];
-        }
-    }
-
-    // Imprimir a nova data
-    // ////printf("\n\nData atual: %02d/%02d/%d\n", day, month, year);
-
-    int finalDate = year * 10000 + month * 100 + day;
-    // ////printf("new year %d\n", finalDate);
-
-    return finalDate;
-}
-
-uint8_t set_easter_day()
-{
-    int day = 0;
-    int month = 0;
-    char date[20] = {};
-
-    get_RTC_System_Time();
-
-    calcularPascoa(nowTime.year + 2000, &day, &month);
-
-    // date = day * 100 + month;
-    sprintf(date, "%02d%02d", day, month - 1);
-
-    // ////printf("\n\n pascoa - %s", date);
-
-    if (save_INT8_Data_In_Storage(date, 1, nvs_Mobile_Holydays_handle) != ESP_OK)
-    {
-        return 0;
-    }
-
-    if (save_INT8_Data_In_Storage(NVS_KEY_LABEL_EASTER, 1, nvs_System_handle) != ESP_OK)
-    {
-        return 0;
-    }
-
-    return 1;
-}
-
-uint8_t set_easter_monday()
-{
-    get_RTC_System_Time();
-    int day = 0;
-    int month = 0;
-    int date = 0;
-    int carnaval_Date = 0;
-
-    // ////printf("\n\n SEGUNDA DE PASCOA nowtime.year %d\n\n", nowTime.year);
-    calcularPascoa(nowTime.year + 2000, &day, &month);
-
-    date = nowTime.year * 10000 + month * 100 + day;
-    int finalDate = parseDatetoInt(date, 1);
-
-    int easter_monday_year = finalDate / 10000;
-    int easter_monday_month = (finalDate / 100) - (easter_monday_year * 100);
-    int easter_monday_day = finalDate - ((easter_monday_year * 10000) + (easter_monday_month * 100));
-
-    char easterMondayDate[20] = {};
-
-    sprintf(easterMondayDate, "%02d%02d", easter_monday_day, easter_monday_month - 1);
-
-    // ////printf("\n\n SEGUNDA DE PASCOA date - %s\n\n", easterMondayDate);
-
-    if (save_INT8_Data_In_Storage(easterMondayDate, 1, nvs_Mobile_Holydays_handle) != ESP_OK)
-    {
-        return 0;
-    }
-
-    if (save_INT8_Data_In_Storage(NVS_KEY_LABEL_EASTER_MONDAY, 1, nvs_System_handle) != ESP_OK)
-    {
-        return 0;
-    }
-
-    return 1;
-}
-
-uint8_t set_easter_friday()
-{
-    get_RTC_System_Time();
-    int day = 0;
-    int month = 0;
-    int date = 0;
-    int easter_friday_Date = 0;
-
-    // ////printf("\n\n carnaval nowtime.year %d\n\n", nowTime.year);
-    calcularPascoa(nowTime.year + 2000, &day, &month);
-
-    date = nowTime.year * 10000 + month * 100 + day;
-    int finalDate = subtrairDias(date, 2);
-
-    int easter_friday_year = finalDate / 10000;
-    int easter_friday_month = (finalDate / 100) - (easter_friday_year * 100);
-    int easter_friday_day = finalDate - ((easter_friday_year * 10000) + (easter_friday_month * 100));
-
-    char easter_fridayDate[20] = {};
-
-    sprintf(easter_fridayDate, "%02d%02d", easter_friday_day, easter_friday_month - 1);
-
-    // ////printf("\n\n easter_friday date - %s\n\n", easter_fridayDate);
-
-    if (save_INT8_Data_In_Storage(easter_fridayDate, 1, nvs_Mobile_Holydays_handle) != ESP_OK)
-    {
-        return 0;
-    }
-
-    if (save_INT8_Data_In_Storage(NVS_KEY_LABEL_EASTER_FRIDAY, 1, nvs_System_handle) != ESP_OK)
-    {
-        return 0;
-    }
-
-    return 1;
-}
-
 char *set_rangeHolidaysDays(char *payload)
 {
     char inicialTime[7] = {};
@@ -1800,107 +1749,3 @@ char *reset_rangeHolidaysDays()
 
     return "OK";
 }
-
-void refresh_holidaysDays()
-{
-    nvs_erase_all(nvs_Mobile_Holydays_handle);
-    if (get_INT8_Data_From_Storage(NVS_KEY_LABEL_CARNIVAL, nvs_System_handle) == 1)
-    {
-        set_carnival();
-    }
-
-    if (get_INT8_Data_From_Storage(NVS_KEY_LABEL_EASTER_FRIDAY, nvs_System_handle) == 1)
-    {
-        set_easter_friday();
-    }
-
-    if (get_INT8_Data_From_Storage(NVS_KEY_LABEL_EASTER, nvs_System_handle) == 1)
-    {
-        set_easter_day();
-    }
-
-    if (get_INT8_Data_From_Storage(NVS_KEY_LABEL_CORPUS_CHRISTI, nvs_System_handle) == 1)
-    {
-        set_corpusChristi();
-    }
-
-    if (get_INT8_Data_From_Storage(NVS_KEY_LABEL_EASTER_MONDAY, nvs_System_handle) == 1)
-    {
-        set_easter_monday();
-    }
-}
-
-uint8_t set_corpusChristi()
-{
-
-    get_RTC_System_Time();
-    int day = 0;
-    int month = 0;
-    int date = 0;
-    int carnaval_Date = 0;
-
-    // ////printf("\n\n corpo cristo nowtime.year %d\n\n", nowTime.year);
-    calcularPascoa(nowTime.year + 2000, &day, &month);
-
-    date = nowTime.year * 10000 + month * 100 + day;
-    int finalDate = parseDatetoInt(date, 60);
-
-    int corpusChristi_year = finalDate / 10000;
-    int corpusChristi_month = (finalDate / 100) - (corpusChristi_year * 100);
-    int corpusChristi_day = finalDate - ((corpusChristi_year * 10000) + (corpusChristi_month * 100));
-
-    char corpusChristiDate[20] = {};
-
-    sprintf(corpusChristiDate, "%02d%02d", corpusChristi_day, corpusChristi_month - 1);
-
-    // ////printf("\n\n corpo de cristo date - %s\n\n", corpusChristiDate);
-
-    if (save_INT8_Data_In_Storage(corpusChristiDate, 1, nvs_Mobile_Holydays_handle) != ESP_OK)
-    {
-        return 0;
-    }
-
-    if (save_INT8_Data_In_Storage(NVS_KEY_LABEL_CORPUS_CHRISTI, 1, nvs_System_handle) != ESP_OK)
-    {
-        return 0;
-    }
-
-    return 1;
-}
-
-uint8_t set_carnival()
-{
-    get_RTC_System_Time();
-    int day = 0;
-    int month = 0;
-    int date = 0;
-    int carnaval_Date = 0;
-
-    // ////printf("\n\n carnaval nowtime.year %d\n\n", nowTime.year);
-    calcularPascoa(nowTime.year + 2000, &day, &month);
-
-    date = nowTime.year * 10000 + month * 100 + day;
-    int finalDate = subtrairDias(date, 47);
-
-    int carnaval_year = finalDate / 10000;
-    int carnaval_month = (finalDate / 100) - (carnaval_year * 100);
-    int carnaval_day = finalDate - ((carnaval_year * 10000) + (carnaval_month * 100));
-
-    char carnavalDate[20] = {};
-
-    sprintf(carnavalDate, "%02d%02d", carnaval_day, carnaval_month - 1);
-
-    // ////printf("\n\n carnaval date - %s\n\n", carnavalDate);
-
-    if (save_INT8_Data_In_Storage(carnavalDate, 1, nvs_Mobile_Holydays_handle) != ESP_OK)
-    {
-        return 0;
-    }
-
-    if (save_INT8_Data_In_Storage(NVS_KEY_LABEL_CARNIVAL, 1, nvs_System_handle) != ESP_OK)
-    {
-        return 0;
-    }
-
-    return 1;
-}
@@ -29,14 +29,20 @@
 #define CORPUS_CHRISTI_HOLYDAY_DAY 8
 #define EASTER_MONDAY_HOLYDAY_DAY 16
 
-extern TaskHandle_t task_Routine_BiState_RelayState1;
-extern TaskHandle_t task_Routine_BiState_RelayState2;
+/* RT G N: proximos disparos das rotinas, ja filtrados pelo calendario */
+#define ROUTINE_PREVIEW_MAX 10
+#define ROUTINE_PREVIEW_BATCHES 4
+
+typedef struct
+{
+    time_t time;
+    char data[CRON_JOB_DATA_SIZE];
+
+} routine_preview_entry;
 
 extern allUsers_parameters_Message Routines_message;
 
 extern SemaphoreHandle_t rdySem_Send_Routines;
-extern SemaphoreHandle_t rdySem_Routine_BiState_Send_RelayState1;
-extern SemaphoreHandle_t rdySem_Routine_BiState_Send_RelayState2;
 
 static QueueHandle_t send_Routines_queue;
 
@@ -44,7 +50,7 @@ extern uint8_t label_Routine1_ON;
 extern uint8_t label_Routine2_ON;
 
 
-extern uint8_t routines_ID;
+extern uint16_t routines_ID;
 extern struct list_node *routine_list;
 
 void initRoutines();
@@ -53,6 +59,8 @@ char *setRoutine(char *payload);
 
 char *getRoutines(uint8_t gattsIF, uint16_t connID, uint16_t handle_table,uint8_t BLE_UDP_Indication);
 
+char *get_Routines_Preview(char *payload);
+
 char *eraseRoutines();
 
 char *set_ExeptionDay(char* payload);
@@ -73,7 +81,7 @@ void test_cron_job_sample_callback(cron_job *job);
 
 char *parse_RoutineData(uint8_t BLE_SMS_Indication,uint8_t gattsIF, uint16_t connID,uint16_t handle_table, char cmd, char param, char *payload);
 
-char *set_holidaysDays(uint8_t holidaysDays);
+char *set_holidaysDays(char *payload);
 char *get_holidaysDays();
 char *reset_holidaysDays();
 
@@ -81,24 +89,12 @@ char *set_rangeHolidaysDays();
 uint8_t get_rangeHolidaysDays(char *inicalTime, char *finalTime);
 char *reset_rangeHolidaysDays();
 
-void refresh_holidaysDays();
+void refresh_Routine_Timeline();
 
-void task_Routine_BiState_Send_RelayState1(void *pvParameter);
-void task_Routine_BiState_Send_RelayState2(void *pvParameter);
 void task_Send_Routines(void *pvParameter);
 
 uint8_t send_udp_routines_funtion();
 
-void calcularPascoa(int ano, int *dia, int *mes);
-
-int subtrairDias(int date, int days);
-
-uint8_t set_easter_day();
-uint8_t set_carnival();
-uint8_t set_corpusChristi();
-uint8_t set_easter_friday();
-uint8_t set_easter_monday();
-
 
 
 
@@ -9,7 +9,11 @@
 */
 
 #include "sdCard.h"
+#include "log_upload.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "esp_system.h"
+#include <time.h>
 #include "fcntl.h"
 #include <stdio.h>
 #include <sys/types.h>
@@ -26,11 +30,10 @@ esp_vfs_fat_sdmmc_mount_config_t mount_config =
     {
 
         .format_if_mount_failed = false,
-        .max_files = 1,
+        .max_files = 2,
         .allocation_unit_size = 8 * 1024};
 
 const char mount_point[] = MOUNT_POINT;
-// //ESP_LOGI("TAG", "Initializing SD card");
 
 // Use settings defined above to initialize SD card and mount FAT filesystem.
 // Note: esp_vfs_fat_sdmmc/sdspi_mount is all-in-one convenience functions.
@@ -50,215 +53,514 @@ spi_bus_config_t bus_cfg = {
     .max_transfer_sz = 4000,
 };
 
-void free_SPI_Host()
+/* registos ainda nao escritos no cartao; fica em memoria RTC para sobreviver
+   a resets por software, panic ou watchdog (perde-se so num power-on) */
+typedef struct
 {
-    esp_vfs_fat_sdcard_unmount(MOUNT_POINT, card);
-    // ////printf("\n\n unmount 222\n\n");
-    //ESP_LOGI("TAG", "Card unmounted");
+    uint32_t magic;
+    uint16_t count;
+    uint16_t reserved;
+    sdCard_Log_Record records[SDCARD_LOG_TAIL_RECORDS];
+
+} sdCard_Log_Tail;
+
+static RTC_NOINIT_ATTR sdCard_Log_Tail log_Tail;
+
+/* copia em RAM dos cabecalhos dos 12 segmentos, lida ao montar o cartao */
+static sdCard_Log_Segment_Header log_Segments[12];
+
+/* tamanho dos MM.csv do firmware anterior, exportados antes dos registos
+   binarios do mes ate o segmento passar para o ano seguinte */
+static uint32_t log_Legacy_Size[12];
+
+static QueueHandle_t sdCard_Log_queue;
+static SemaphoreHandle_t sdCard_Tail_Mutex;
+static uint8_t sdCard_Mounted = 0;
+static uint32_t sdCard_Log_Dropped = 0;
+static TickType_t sdCard_Tail_Since = 0;
+
+static const char *log_Error_Keys[] = {
+    "ERRO_LOGS_GET_TIME",
+    "ERROR_LOGS_USER_NOT_PERMITION",
+    "ERROR_LOGS_NOT_HAVE_PERMITION_THIS_RELAY",
+    "ERROR_LOGS_IS_RUNNING_ROUTINE_ON_RELAY",
+    "ERROR_LOGS_USER_NOT_FOUND",
+    "ERROR_LOGS_PASSWORD_WRONG",
+    "LOGS_ONLY_PERMISSION_TO_CALL",
+    "ERROR_LOGS_RESET",
+};
 
-    // deinitialize the bus after all devices are removed
-    spi_bus_free(host.slot);
-}
+static const char *log_Source_Names[] = {
+    "", "BLE", "SMS", "CALL", "WEB", "RF", "REX 1", "REX 2", "READER 1", "READER 2",
+};
+
+static const char *log_State_Keys[] = {"", "ON", "OFF", "PULSE", "NOT_CHANGE"};
 
-void mount_SD_CARD()
+static const char *log_Name_Keys[] = {"", "NO_NAME", "ROUTINE", "LOGS_DISABLE_ROUTINE"};
+
+uint32_t sdCard_Log_Credential_Hash(const char *str)
 {
-    esp_err_t ret;
+    uint32_t hash = 2166136261u;
 
-    ret = spi_bus_initialize(host.slot, &bus_cfg, SPI_DMA_CHAN);
+    while (*str)
+    {
+        hash = (hash ^ (uint8_t)*str++) * 16777619u;
+    }
 
-    sdspi_device_config_t slot_config = SDSPI_DEVICE_CONFIG_DEFAULT();
-    slot_config.gpio_cs = PIN_NUM_CS;
-    slot_config.host_id = host.slot;
+    return hash;
+}
 
-    //ESP_LOGI("TAG", "Mounting filesystem");
-    ret = esp_vfs_fat_sdspi_mount(mount_point, &host, &slot_config, &mount_config, &card);
+static void log_Segment_Path(char *fileName, uint8_t month)
+{
+    sprintf(fileName, MOUNT_POINT "/%02d.bin", month);
+}
 
-    if (ret != ESP_OK)
+static void log_Legacy_Path(char *fileName, uint8_t month)
+{
+    sprintf(fileName, MOUNT_POINT "/%02d.csv", month);
+}
+
+static uint8_t log_Segment_Valid(sdCard_Log_Segment_Header *header, uint8_t month)
+{
+    return header->magic == SDCARD_LOG_SEGMENT_MAGIC && header->version == SDCARD_LOG_VERSION &&
+           header->record_size == sizeof(sdCard_Log_Record) && header->month == month;
+}
+
+static void log_Segment_Epochs(sdCard_Log_Segment_Header *header, uint32_t epoch)
+{
+    if (epoch == 0)
     {
-        if (ret == ESP_FAIL)
-        {
-            //ESP_LOGE("TAG", "Failed to mount filesystem. ""If you want the card to be formatted, set the EXAMPLE_FORMAT_IF_MOUNT_FAILED menuconfig option.");
-        }
-        else
-        {
-            //ESP_LOGE("TAG", "Failed to initialize the card (%s). ""Make sure SD card lines have pull-up resistors in place.",esp_err_to_name(ret));
-        }
         return;
     }
-    //ESP_LOGI("TAG", "Files System mounted12");
 
-    // Card has been initialized, print its properties
-    sdmmc_card_print_info(stdout, card);
-    //ESP_LOGI("TAG", "Opening file %s", "/sdcard/m4g.csv");
-    char *fileName;
+    if (header->last_epoch != 0 && epoch < header->last_epoch)
+    {
+        header->unordered = 1;
+    }
 
-    uint8_t lastMonth = get_NVS_Last_Month();
-    //////printf("\nLAST MONTH %d\n", lastMonth);
-    FILE *f;
+    if (header->first_epoch == 0)
+    {
+        header->first_epoch = epoch;
+    }
 
-    if (get_RTC_System_Time())
+    if (header->max_epoch == 0)
     {
+        header->min_epoch = epoch;
+        header->max_epoch = epoch;
+    }
 
-        // lastMonth = 5;
-        asprintf(&fileName, "/sdcard/%02d.csv", nowTime.month);
-        //////printf("\nfileName sdcard %s\n", fileName);
+    if (epoch < header->min_epoch)
+    {
+        header->min_epoch = epoch;
+    }
 
-        if (lastMonth == nowTime.month)
-        {
+    if (epoch > header->max_epoch)
+    {
+        header->max_epoch = epoch;
+    }
 
-            f = fopen(fileName, "a");
-            long int file_Len = 0;
+    header->last_epoch = epoch;
+}
 
-            fseek(f, 0, SEEK_END);
+/* le o cabecalho e corrige o count pelo tamanho do ficheiro, caso tenha
+   havido um reset entre a escrita dos registos e a do cabecalho */
+static uint8_t log_Segment_Load(FILE *f, uint8_t month, sdCard_Log_Segment_Header *header)
+{
+    long int file_Len = 0;
+    uint32_t count = 0;
+    sdCard_Log_Record record;
 
-            file_Len = ftell(f);
+    memset(header, 0, sizeof(sdCard_Log_Segment_Header));
 
-            //////printf("\nFILE LEN = %s - %ld\n", fileName, file_Len);
+    fseek(f, 0, SEEK_SET);
 
-            if (file_Len < 10)
-            {
-                fclose(f);
-                f = fopen(fileName, "w");
-                fprintf(f, "%s%c%s%c%s%c%s%c%s%c%s%c%s%c%s\n", return_Json_SMS_Data("NAME"), ';', return_Json_SMS_Data("PHONE_NUMBER"), ';', return_Json_SMS_Data("RELAY"), ';', return_Json_SMS_Data("RELAY_STATE"), ';', return_Json_SMS_Data("DATE"), ';', return_Json_SMS_Data("TIME"), ';', return_Json_SMS_Data("TYPE"), ';', return_Json_SMS_Data("ERROR"));
-            }
+    if (fread(header, sizeof(sdCard_Log_Segment_Header), 1, f) != 1 || !log_Segment_Valid(header, month))
+    {
+        memset(header, 0, sizeof(sdCard_Log_Segment_Header));
+        return 0;
+    }
 
-            //////printf("\nsdcard21 \n");
+    fseek(f, 0, SEEK_END);
+    file_Len = ftell(f);
+    count = (file_Len - sizeof(sdCard_Log_Segment_Header)) / sizeof(sdCard_Log_Record);
 
-            //////printf("\nsdcard22 \n");
-            fclose(f);
-        }
-        else
+    if (count > header->count)
+    {
+        // os registos recuperados entram no min/max como se fossem escritos agora
+        fseek(f, sizeof(sdCard_Log_Segment_Header) + header->count * sizeof(sdCard_Log_Record), SEEK_SET);
+
+        while (header->count < count && fread(&record, sizeof(record), 1, f) == 1)
         {
-            lastMonth = nowTime.month;
-            save_NVS_Last_Month(lastMonth);
-            f = fopen(fileName, "w");
-            fprintf(f, "%s%c%s%c%s%c%s%c%s%c%s%c%s%c%s\n", return_Json_SMS_Data("NAME"), ';', return_Json_SMS_Data("PHONE_NUMBER"), ';', return_Json_SMS_Data("RELAY"), ';', return_Json_SMS_Data("RELAY_STATE"), ';', return_Json_SMS_Data("DATE"), ';', return_Json_SMS_Data("TIME"), ';', return_Json_SMS_Data("TYPE"), ';', return_Json_SMS_Data("ERROR"));
+            log_Segment_Epochs(header, record.epoch);
+            header->count++;
+        }
 
-            fclose(f);
-            //////printf("\nsdcard32 \n");
+        header->count = count;
+    }
+
+    return 1;
+}
+
+static void log_Segments_Load_All()
+{
+    char fileName[20];
+    FILE *f = NULL;
+
+    for (uint8_t month = 1; month <= 12; month++)
+    {
+        log_Segment_Path(fileName, month);
+        f = fopen(fileName, "rb");
+
+        if (f == NULL)
+        {
+            memset(&log_Segments[month - 1], 0, sizeof(sdCard_Log_Segment_Header));
+            continue;
         }
+
+        log_Segment_Load(f, month, &log_Segments[month - 1]);
+        fclose(f);
     }
 
-    free(fileName);
+    for (uint8_t month = 1; month <= 12; month++)
+    {
+        struct stat st;
 
-    //ESP_LOGI("TAG", "xPortGetFreeHeapSize            : %d", xPortGetFreeHeapSize());
-    //ESP_LOGI("TAG", "esp_get_minimum_free_heap_size  : %d", esp_get_minimum_free_heap_size());
-    //ESP_LOGI("TAG", "heap_caps_get_largest_free_block: %d", heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
-    //ESP_LOGI("TAG", "free heap memory                : %d", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+        log_Legacy_Path(fileName, month);
+        log_Legacy_Size[month - 1] = stat(fileName, &st) == 0 ? st.st_size : 0;
+    }
 }
 
-void init_SDCard()
+static uint8_t sdCard_Mount()
 {
-
-    //ESP_LOGI("TAG", "xPortGetFreeHeapSize1212            : %d", xPortGetFreeHeapSize());
-    //ESP_LOGI("TAG", "esp_get_minimum_free_heap_size  : %d", esp_get_minimum_free_heap_size());
-    //ESP_LOGI("TAG", "heap_caps_get_largest_free_block: %d", heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
-    //ESP_LOGI("TAG", "free heap memory                : %d", heap_caps_get_free_size(MALLOC_CAP_8BIT));
     esp_err_t ret;
 
-    // Options for mounting the filesystem.
-    // If format_if_mount_failed is set to true, SD card will be partitioned and
-    // formatted in case when mounting fails.
-    // ////printf("\n\ntask_Send_LOG_File 11\n\n");
+    if (sdCard_Mounted)
+    {
+        return 1;
+    }
+
     ret = spi_bus_initialize(host.slot, &bus_cfg, SPI_DMA_CHAN);
 
-    // spi_bus_free()
-    if (ret != ESP_OK)
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE)
     {
-        //ESP_LOGE("TAG", "Failed to initialize bus.");
-        return;
+        return 0;
     }
 
     // This initializes the slot without card detect (CD) and write protect (WP) signals.
-    // Modify slot_config.gpio_cd and slot_config.gpio_wp if your board has these signals.
+    // O CD e lido por GPIO em task_SDCard_Log_Writer
     sdspi_device_config_t slot_config = SDSPI_DEVICE_CONFIG_DEFAULT();
     slot_config.gpio_cs = PIN_NUM_CS;
     slot_config.host_id = host.slot;
 
-    //ESP_LOGI("TAG", "Mounting filesystem");
     ret = esp_vfs_fat_sdspi_mount(mount_point, &host, &slot_config, &mount_config, &card);
-    // ////printf("\n\ntask_Send_LOG_File 12\n\n");
+
     if (ret != ESP_OK)
     {
-        if (ret == ESP_FAIL)
+        ESP_LOGE("sdcard", "mount failed (%s)", esp_err_to_name(ret));
+        spi_bus_free(host.slot);
+        return 0;
+    }
+
+    sdCard_Mounted = 1;
+    log_Segments_Load_All();
+
+    return 1;
+}
+
+static void sdCard_Unmount()
+{
+    if (!sdCard_Mounted)
+    {
+        return;
+    }
+
+    esp_vfs_fat_sdcard_unmount(mount_point, card);
+
+    // deinitialize the bus after all devices are removed
+    spi_bus_free(host.slot);
+    sdCard_Mounted = 0;
+    memset(log_Segments, 0, sizeof(log_Segments));
+    memset(log_Legacy_Size, 0, sizeof(log_Legacy_Size));
+}
+
+static uint8_t log_Same_Year(uint32_t epoch1, uint32_t epoch2)
+{
+    time_t t1 = epoch1;
+    time_t t2 = epoch2;
+    struct tm tm1;
+    struct tm tm2;
+
+    localtime_r(&t1, &tm1);
+    localtime_r(&t2, &tm2);
+
+    return tm1.tm_year == tm2.tm_year;
+}
+
+/* ao criar o segmento do mes, o MM.csv antigo so fica se for do mesmo ano */
+static void log_Legacy_Expire(uint8_t month, uint32_t epoch)
+{
+    char fileName[20];
+    struct stat st;
+
+    log_Legacy_Path(fileName, month);
+
+    if (log_Legacy_Size[month - 1] == 0 || stat(fileName, &st) != 0)
+    {
+        log_Legacy_Size[month - 1] = 0;
+        return;
+    }
+
+    if (epoch != 0 && !log_Same_Year(st.st_mtime, epoch))
+    {
+        remove(fileName);
+        log_Legacy_Size[month - 1] = 0;
+    }
+}
+
+/* escreve os registos [first, first + n) no segmento do mes; primeiro os
+   registos, depois o cabecalho. Em written fica quantos registos ja estao no
+   cartao, mesmo que o cabecalho falhe (o count e corrigido no proximo load) */
+static uint8_t log_Segment_Append(uint8_t month, sdCard_Log_Record *records, uint16_t n, uint16_t *written)
+{
+    char fileName[20];
+    FILE *f = NULL;
+    sdCard_Log_Segment_Header header;
+    uint8_t valid = 0;
+
+    *written = 0;
+    log_Segment_Path(fileName, month);
+
+    f = fopen(fileName, "r+b");
+
+    if (f != NULL)
+    {
+        valid = log_Segment_Load(f, month, &header);
+
+        // segmento do ano anterior: e reescrito
+        if (valid && header.count > 0 && records[0].epoch != 0 && header.last_epoch != 0 &&
+            !log_Same_Year(header.last_epoch, records[0].epoch))
         {
-            //ESP_LOGE("TAG", "Failed to mount filesystem. ""If you want the card to be formatted, set the EXAMPLE_FORMAT_IF_MOUNT_FAILED menuconfig option.");
+            valid = 0;
         }
-        else
+
+        if (!valid)
+        {
+            fclose(f);
+            f = NULL;
+        }
+    }
+
+    if (f == NULL)
+    {
+        log_Legacy_Expire(month, records[0].epoch);
+        f = fopen(fileName, "w+b");
+
+        if (f == NULL)
         {
-            //ESP_LOGE("TAG", "Failed to initialize the card (%s).""Make sure SD card lines have pull-up resistors in place.",esp_err_to_name(ret));
+            return 0;
         }
-        return;
+
+        memset(&header, 0, sizeof(header));
+        header.magic = SDCARD_LOG_SEGMENT_MAGIC;
+        header.version = SDCARD_LOG_VERSION;
+        header.record_size = sizeof(sdCard_Log_Record);
+        header.month = month;
     }
-    //ESP_LOGI("TAG", "Files System mounted12");
 
-    // Card has been initialized, print its properties
-    sdmmc_card_print_info(stdout, card);
-    //ESP_LOGI("TAG", "Opening file %s", "/sdcard/m4g.csv");
-    char *fileName;
+    fseek(f, sizeof(header) + header.count * sizeof(sdCard_Log_Record), SEEK_SET);
 
-    uint8_t lastMonth = get_NVS_Last_Month();
-    //////printf("\nLAST MONTH %d\n", lastMonth);
-    FILE *f;
+    *written = fwrite(records, sizeof(sdCard_Log_Record), n, f);
 
-    if (get_RTC_System_Time())
+    if (fflush(f) != 0)
     {
+        // nada garante que os registos chegaram ao cartao
+        *written = 0;
+    }
 
-        // lastMonth = 5;
-        asprintf(&fileName, "/sdcard/%02d.csv", nowTime.month);
-        //////printf("\nfileName sdcard %s\n", fileName);
+    if (*written != n)
+    {
+        fclose(f);
+        return 0;
+    }
 
-        if (lastMonth == nowTime.month)
-        {
+    for (uint16_t i = 0; i < n; i++)
+    {
+        log_Segment_Epochs(&header, records[i].epoch);
+    }
+    header.count += n;
 
-            f = fopen(fileName, "a");
-            long int file_Len = 0;
+    fseek(f, 0, SEEK_SET);
 
-            fseek(f, 0, SEEK_END);
+    if (fwrite(&header, sizeof(header), 1, f) != 1 || fflush(f) != 0 || fsync(fileno(f)) != 0)
+    {
+        fclose(f);
+        return 0;
+    }
 
-            file_Len = ftell(f);
+    fclose(f);
 
-            //////printf("\nFILE LEN = %s - %ld\n", fileName, file_Len);
+    log_Segments[month - 1] = header;
 
-            if (file_Len < 10)
-            {
-                fclose(f);
-                f = fopen(fileName, "w");
-                fprintf(f, "%s%c%s%c%s%c%s%c%s%c%s%c%s%c%s\n", return_Json_SMS_Data("NAME"), ';', return_Json_SMS_Data("PHONE_NUMBER"), ';', return_Json_SMS_Data("RELAY"), ';', return_Json_SMS_Data("RELAY_STATE"), ';', return_Json_SMS_Data("DATE"), ';', return_Json_SMS_Data("TIME"), ';', return_Json_SMS_Data("TYPE"), ';', return_Json_SMS_Data("ERROR"));
-            }
+    return 1;
+}
 
-            //////printf("\nsdcard21 \n");
+/* escreve o buffer no cartao, agrupado por mes; tem de ser chamada com
+   rdySem_Control_SD_Card_Write e sdCard_Tail_Mutex obtidos */
+static uint8_t sdCard_Flush_Tail()
+{
+    uint16_t first = 0;
+    uint16_t last = 0;
+    uint16_t written = 0;
 
-            //////printf("\nsdcard22 \n");
-            fclose(f);
+    if (log_Tail.count == 0)
+    {
+        return 1;
+    }
+
+    if (!sdCard_Mounted)
+    {
+        return 0;
+    }
+
+    while (first < log_Tail.count)
+    {
+        last = first + 1;
+
+        while (last < log_Tail.count && log_Tail.records[last].month == log_Tail.records[first].month)
+        {
+            last++;
         }
-        else
+
+        if (!log_Segment_Append(log_Tail.records[first].month, &log_Tail.records[first], last - first, &written))
         {
-            lastMonth = nowTime.month;
-            save_NVS_Last_Month(lastMonth);
-            f = fopen(fileName, "w");
-            fprintf(f, "%s%c%s%c%s%c%s%c%s%c%s%c%s%c%s\n", return_Json_SMS_Data("NAME"), ';', return_Json_SMS_Data("PHONE_NUMBER"), ';', return_Json_SMS_Data("RELAY"), ';', return_Json_SMS_Data("RELAY_STATE"), ';', return_Json_SMS_Data("DATE"), ';', return_Json_SMS_Data("TIME"), ';', return_Json_SMS_Data("TYPE"), ';', return_Json_SMS_Data("ERROR"));
+            // o cartao pode ter sido retirado entre a leitura do CD e a escrita;
+            // os registos que ja foram escritos saem do buffer para nao serem
+            // escritos outra vez na proxima tentativa
+            first += written;
+            memmove(log_Tail.records, &log_Tail.records[first], (log_Tail.count - first) * sizeof(sdCard_Log_Record));
+            log_Tail.count -= first;
+            sdCard_Unmount();
+            return 0;
+        }
 
-            fclose(f);
-            //////printf("\nsdcard32 \n");
+        first = last;
+    }
+
+    log_Tail.count = 0;
+
+    return 1;
+}
+
+static void sdCard_Append_Tail(sdCard_Log_Record *record)
+{
+    xSemaphoreTake(sdCard_Tail_Mutex, portMAX_DELAY);
+
+    if (log_Tail.count == 0)
+    {
+        sdCard_Tail_Since = xTaskGetTickCount();
+    }
+
+    if (log_Tail.count == SDCARD_LOG_TAIL_RECORDS)
+    {
+        // sem cartao, descarta o registo mais antigo
+        memmove(log_Tail.records, &log_Tail.records[1], (SDCARD_LOG_TAIL_RECORDS - 1) * sizeof(sdCard_Log_Record));
+        log_Tail.count--;
+        sdCard_Log_Dropped++;
+        ESP_LOGW("sdcard", "log tail full, %lu records dropped", (unsigned long)sdCard_Log_Dropped);
+    }
+
+    log_Tail.records[log_Tail.count++] = *record;
+
+    xSemaphoreGive(sdCard_Tail_Mutex);
+}
+
+static void sdCard_Service(uint8_t force_Flush)
+{
+    uint8_t card_Present = !gpio_get_level(GPIO_INPUT_IO_CD_SDCARD);
+
+    if (xSemaphoreTake(rdySem_Control_SD_Card_Write, 0) != pdTRUE)
+    {
+        // o cartao esta a ser lido (exportacao de logs ou formatacao)
+        return;
+    }
+
+    if (!card_Present)
+    {
+        sdCard_Unmount();
+    }
+    else if (!sdCard_Mounted)
+    {
+        sdCard_Mount();
+    }
+
+    xSemaphoreTake(sdCard_Tail_Mutex, portMAX_DELAY);
+
+    if (sdCard_Mounted && log_Tail.count > 0 &&
+        (force_Flush || log_Tail.count >= SDCARD_LOG_FLUSH_WATERMARK ||
+         xTaskGetTickCount() - sdCard_Tail_Since >= pdMS_TO_TICKS(SDCARD_LOG_FLUSH_MS)))
+    {
+        sdCard_Flush_Tail();
+    }
+
+    xSemaphoreGive(sdCard_Tail_Mutex);
+    xSemaphoreGive(rdySem_Control_SD_Card_Write);
+}
+
+void task_SDCard_Log_Writer(void *pvParameter)
+{
+    sdCard_Log_Record record;
+    mqtt_information mqttLogs_info;
+
+    for (;;)
+    {
+        if (xQueueReceive(sdCard_Log_queue, &record, pdMS_TO_TICKS(SDCARD_LOG_POLL_MS)) == pdTRUE)
+        {
+            // sem hora valida nao ha segmento do mes, fica apenas o envio UDP
+            if (record.month >= 1 && record.month <= 12)
+            {
+                sdCard_Append_Tail(&record);
+            }
+
+            if (UDP_logs_label == 1)
+            {
+                // com cartao os registos seguem em bloco pelo log_upload.c
+                if (sdCard_Mounted && record.month >= 1 && record.month <= 12)
+                {
+                    log_Upload_Notify_Record();
+                }
+                else
+                {
+                    memset(&mqttLogs_info, 0, sizeof(mqttLogs_info));
+                    strcpy(mqttLogs_info.data, "# ");
+                    sdCard_Render_Log_Record(&record, mqttLogs_info.data + 2, sizeof(mqttLogs_info.data) - 2);
+                    send_UDP_queue(&mqttLogs_info);
+                }
+            }
         }
+
+        sdCard_Service(0);
     }
+}
 
-    free(fileName);
+void init_SDCard()
+{
+    sdCard_Tail_Mutex = xSemaphoreCreateMutex();
+    sdCard_Log_queue = xQueueCreate(SDCARD_LOG_QUEUE_SIZE, sizeof(sdCard_Log_Record));
 
-    //ESP_LOGI("TAG", "xPortGetFreeHeapSize            : %d", xPortGetFreeHeapSize());
-    //ESP_LOGI("TAG", "esp_get_minimum_free_heap_size  : %d", esp_get_minimum_free_heap_size());
-    //ESP_LOGI("TAG", "heap_caps_get_largest_free_block: %d", heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
-    //ESP_LOGI("TAG", "free heap memory                : %d", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    if (esp_reset_reason() == ESP_RST_POWERON || log_Tail.magic != SDCARD_LOG_TAIL_MAGIC ||
+        log_Tail.count > SDCARD_LOG_TAIL_RECORDS)
+    {
+        memset(&log_Tail, 0, sizeof(log_Tail));
+        log_Tail.magic = SDCARD_LOG_TAIL_MAGIC;
+    }
+    else if (log_Tail.count > 0)
+    {
+        ESP_LOGI("sdcard", "recovered %d log records", log_Tail.count);
+    }
 
-    /* //////printf("\n\n unmount 111\n\n");
-    esp_vfs_fat_sdcard_unmount(mount_point, card);
-    //////printf("\n\n unmount 222\n\n");
-    //ESP_LOGI("TAG", "Card unmounted");
+    sdCard_Tail_Since = xTaskGetTickCount();
 
-    // deinitialize the bus after all devices are removed
-    spi_bus_free(host.slot);
-    //////printf("\n\n unmount 333\n\n"); */
+    xTaskCreate(task_SDCard_Log_Writer, "task_SDCard_Log_Writer", 5 * 1024, NULL, 4, NULL);
 }
 
 void init_rdySem_Control_SD_Card_Write()
@@ -267,186 +569,317 @@ void init_rdySem_Control_SD_Card_Write()
     xSemaphoreGive(rdySem_Control_SD_Card_Write);
 }
 
-void sdCard_Write_LOGS(sdCard_Logs_struct *logs_Struct)
+/* acesso exclusivo ao cartao montado para leitura direta; o buffer de logs e
+   escrito antes. Devolve 0 (sem o semaforo) se nao houver cartao */
+uint8_t sdCard_Take()
 {
-    //////printf("\n\n sdcard 11\n\n");
+    if (xSemaphoreTake(rdySem_Control_SD_Card_Write, pdMS_TO_TICKS(10000)) != pdTRUE)
+    {
+        return 0;
+    }
+
+    if (gpio_get_level(GPIO_INPUT_IO_CD_SDCARD) || !sdCard_Mount())
+    {
+        xSemaphoreGive(rdySem_Control_SD_Card_Write);
+        return 0;
+    }
 
-    //////printf("\n\n sdcard 22\n\n");
-    xSemaphoreTake(rdySem_Control_SD_Card_Write, pdMS_TO_TICKS(10000));
+    xSemaphoreTake(sdCard_Tail_Mutex, portMAX_DELAY);
+    sdCard_Flush_Tail();
+    xSemaphoreGive(sdCard_Tail_Mutex);
 
-    char *data_to_save;
+    return 1;
+}
 
-    ////printf("\n\n data to save111 %s\n\n", logs_Struct->name);
-    ////printf("\n\n data to save222 %s\n\n", logs_Struct->phone);
+void sdCard_Give()
+{
+    xSemaphoreGive(rdySem_Control_SD_Card_Write);
+}
 
-    if (!strcmp(logs_Struct->name, "S/N") || strlen(logs_Struct->name) == 0)
+void sdCard_Flush_LOGS()
+{
+    sdCard_Service(1);
+}
+
+uint32_t get_SDCard_Log_Dropped()
+{
+    return sdCard_Log_Dropped;
+}
+
+uint8_t get_SDCard_Mounted()
+{
+    return sdCard_Mounted;
+}
+
+/* indice do segmento em RAM, sem acesso ao cartao; 0 se nao existir */
+uint8_t get_SDCard_Log_Segment(uint8_t month, sdCard_Log_Segment_Header *header)
+{
+    if (month < 1 || month > 12 || !sdCard_Mounted || log_Segments[month - 1].magic != SDCARD_LOG_SEGMENT_MAGIC)
     {
-        memset(logs_Struct->name, 0, sizeof(logs_Struct->name));
-        sprintf(logs_Struct->name, "%s", return_Json_SMS_Data("NO_NAME"));
+        return 0;
     }
 
-    if (!strcmp(logs_Struct->type, "WEB"))
+    *header = log_Segments[month - 1];
+
+    return 1;
+}
+
+/* registos do mes ainda no buffer, que entram no segmento no proximo flush */
+uint16_t get_SDCard_Log_Pending(uint8_t month)
+{
+    uint16_t pending = 0;
+
+    xSemaphoreTake(sdCard_Tail_Mutex, portMAX_DELAY);
+
+    for (uint16_t i = 0; i < log_Tail.count; i++)
     {
-        asprintf(&data_to_save, "%s;%s;%s;%s;%s;%s;%s", "", logs_Struct->phone, logs_Struct->relay, logs_Struct->relay_state, logs_Struct->date, logs_Struct->type, logs_Struct->error);
+        pending += log_Tail.records[i].month == month;
     }
-    else
+
+    xSemaphoreGive(sdCard_Tail_Mutex);
+
+    return pending;
+}
+
+uint32_t get_SDCard_Legacy_Log_Size(uint8_t month)
+{
+    if (month < 1 || month > 12 || !sdCard_Mounted)
     {
-        asprintf(&data_to_save, "%s;%s;%s;%s;%s;%s;%s", logs_Struct->name, logs_Struct->phone, logs_Struct->relay, logs_Struct->relay_state, logs_Struct->date, logs_Struct->type, logs_Struct->error);
+        return 0;
     }
 
-    printf("\n\n data to save %s\n\n", data_to_save);
+    return log_Legacy_Size[month - 1];
+}
 
-    UDP_logs_label = get_INT8_Data_From_Storage(NVS_NETWORK_LABEL_SEND_LOGS, nvs_System_handle);
-    ////printf("\n\n data to save %s\n\n", data_to_save);
+/* le o MM.csv antigo a partir de offset; usar com sdCard_Take */
+size_t sdCard_Read_Legacy_Log(uint8_t month, uint32_t offset, char *out, size_t n)
+{
+    char fileName[20];
+    FILE *f = NULL;
+    size_t count = 0;
 
-    if (UDP_logs_label == 1)
+    if (month < 1 || month > 12 || offset >= log_Legacy_Size[month - 1])
     {
-        //char *UDP_log;
-        ////printf("\n\n data to save5555 %s\n\n", logs_Struct->phone);
-        memset(&logs_Struct->mqttLogs_info,0,sizeof(logs_Struct->mqttLogs_info));
-        sprintf(logs_Struct->mqttLogs_info.data, "# %s", data_to_save);
-        ////printf("\n\n data to save 44 %d\n\n", UDP_logs_label);
-        vTaskDelay(pdMS_TO_TICKS(100));
-        //send_UDP_Send(UDP_log);
-        send_UDP_queue(&logs_Struct->mqttLogs_info);
-        //free(UDP_log);
+        return 0;
     }
-    else
+
+    log_Legacy_Path(fileName, month);
+    f = fopen(fileName, "rb");
+
+    if (f == NULL)
     {
-        if (UDP_logs_label == 255)
-        {
-            save_INT8_Data_In_Storage(NVS_NETWORK_LABEL_SEND_LOGS, 0, nvs_System_handle);
-            UDP_logs_label = 0;
-        }
+        return 0;
     }
-    ////printf("\n\n data to save 7567 %s\n\n", data_to_save);
-    if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD))
+
+    fseek(f, offset, SEEK_SET);
+    count = fread(out, 1, n, f);
+    fclose(f);
+
+    return count;
+}
+
+/* le ate n registos do segmento a partir de index; usar com sdCard_Take */
+uint16_t sdCard_Read_Log_Records(uint8_t month, uint32_t index, sdCard_Log_Record *records, uint16_t n)
+{
+    char fileName[20];
+    FILE *f = NULL;
+    size_t count = 0;
+
+    if (month < 1 || month > 12 || index >= log_Segments[month - 1].count)
     {
+        return 0;
+    }
 
-        init_SDCard();
-        ////printf("\n\n sdcard 22\n\n");
+    if (n > log_Segments[month - 1].count - index)
+    {
+        n = log_Segments[month - 1].count - index;
+    }
 
-        //ESP_LOGI("TAG", "xPortGetFreeHeapSize sd write1            : %d", xPortGetFreeHeapSize());
-        //ESP_LOGI("TAG", "esp_get_minimum_free_heap_size  : %d", esp_get_minimum_free_heap_size());
-        //ESP_LOGI("TAG", "heap_caps_get_largest_free_block: %d", heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
-        //ESP_LOGI("TAG", "free heap memory                : %d", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    log_Segment_Path(fileName, month);
+    f = fopen(fileName, "rb");
 
-        FILE *f = NULL;
+    if (f == NULL)
+    {
+        return 0;
+    }
 
-        ////printf("\ndata to save sdcard %s\n", data_to_save);
+    fseek(f, sizeof(sdCard_Log_Segment_Header) + index * sizeof(sdCard_Log_Record), SEEK_SET);
+    count = fread(records, sizeof(sdCard_Log_Record), n, f);
+    fclose(f);
 
-        uint8_t lastMonth = get_NVS_Last_Month();
-        //////printf("\nLAST MONTH %d\n", lastMonth);
+    return count;
+}
 
-        if (lastMonth >= 0 && lastMonth <= 12)
-        {
-            /* code */
+size_t sdCard_Render_Log_Header(char *out, size_t out_size)
+{
+    int len = snprintf(out, out_size, "%s;%s;%s;%s;%s;%s;%s;%s\n", return_Json_SMS_Data("NAME"), return_Json_SMS_Data("PHONE_NUMBER"), return_Json_SMS_Data("RELAY"), return_Json_SMS_Data("RELAY_STATE"), return_Json_SMS_Data("DATE"), return_Json_SMS_Data("TIME"), return_Json_SMS_Data("TYPE"), return_Json_SMS_Data("ERROR"));
 
-            if (get_RTC_System_Time())
-            {
-                char *fileName;
-                // lastMonth = 5;
-                asprintf(&fileName, "/sdcard/%02d.csv", nowTime.month);
-                //////printf("\nfileName sdcard %s\n", fileName);
-                if (lastMonth == nowTime.month)
-                {
-                    f = fopen(fileName, "a");
-                    //////printf("\nsdcard21 \n");
+    return len < out_size ? len : out_size - 1;
+}
 
-                    //////printf("\nsdcard22 \n");
-                }
-                else
-                {
-                    lastMonth = nowTime.month;
-                    save_NVS_Last_Month(lastMonth);
-                    f = fopen(fileName, "w");
-                    fprintf(f, "%s%c%s%c%s%c%s%c%s%c%s%c%s%c%s\n", return_Json_SMS_Data("NAME"), ';', return_Json_SMS_Data("PHONE_NUMBER"), ';', return_Json_SMS_Data("RELAY"), ';', return_Json_SMS_Data("RELAY_STATE"), ';', return_Json_SMS_Data("DATE"), ';', return_Json_SMS_Data("TIME"), ';', return_Json_SMS_Data("TYPE"), ';', return_Json_SMS_Data("ERROR"));
-                    //////printf("\nsdcard31 \n");
+/* linha CSV no formato antigo (nome;telefone;rele;estado;data;hora;tipo;erro),
+   traduzida no momento da exportacao */
+size_t sdCard_Render_Log_Record(const sdCard_Log_Record *record, char *out, size_t out_size)
+{
+    char name[sizeof(record->name) + 1];
+    char credential[sizeof(record->credential) + 1];
+    char relay[6] = {};
+    char date[40];
+    char error[120] = {};
+    size_t len = 0;
+    time_t t = record->epoch;
+    struct tm timeinfo;
+
+    memset(name, 0, sizeof(name));
+    memset(credential, 0, sizeof(credential));
+    memcpy(credential, record->credential, sizeof(record->credential));
+
+    if (record->source == SDCARD_LOG_SOURCE_WEB)
+    {
+        // nos acessos WEB o nome nao e registado
+    }
+    else if (record->name_kind > SDCARD_LOG_NAME_USER && record->name_kind < sizeof(log_Name_Keys) / sizeof(log_Name_Keys[0]))
+    {
+        snprintf(name, sizeof(name), "%s", return_Json_SMS_Data((char *)log_Name_Keys[record->name_kind]));
+    }
+    else
+    {
+        memcpy(name, record->name, sizeof(record->name));
+    }
 
-                    //////printf("\nsdcard32 \n");
-                }
-                free(fileName);
-            }
-            else
+    if (record->relay == SDCARD_LOG_RELAY_UNKNOWN)
+    {
+        strcpy(relay, "R?");
+    }
+    else if (record->relay > 0)
+    {
+        sprintf(relay, "R%d", record->relay);
+    }
+
+    if (record->epoch == 0)
+    {
+        strcpy(date, "0;0");
+    }
+    else
+    {
+        localtime_r(&t, &timeinfo);
+        sprintf(date, "%04d/%02d/%02d;%02d:%02d:%02d", timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday, timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+    }
+
+    for (uint8_t i = 0; i < sizeof(log_Error_Keys) / sizeof(log_Error_Keys[0]); i++)
+    {
+        if (record->result & (1 << i))
+        {
+            len += snprintf(error + len, sizeof(error) - len, "%s%s", len ? "/" : "", return_Json_SMS_Data((char *)log_Error_Keys[i]));
+
+            if (len >= sizeof(error))
             {
-                // asprintf(&sdCard_Date, "%s", "ERRO GET TIME");
+                break;
             }
         }
+    }
 
-        if (f == NULL)
-        {
+    len = snprintf(out, out_size, "%s;%s;%s;%s;%s;%s;%s\n", name, credential, relay,
+                    record->state > 0 && record->state < sizeof(log_State_Keys) / sizeof(log_State_Keys[0]) ? return_Json_SMS_Data((char *)log_State_Keys[record->state]) : "",
+                    date,
+                    record->source == SDCARD_LOG_SOURCE_CALL ? return_Json_SMS_Data("CALL") : (record->source < sizeof(log_Source_Names) / sizeof(log_Source_Names[0]) ? log_Source_Names[record->source] : ""),
+                    error);
 
-            //ESP_LOGE("TAG", "Failed to open file for writing");
-        }
-        else
-        {
-            //ESP_LOGI("TAG", "Opening file %s", "/sdcard/m4g.txt");
+    // linha cortada se nao couber no buffer
+    return len < out_size ? len : out_size - 1;
+}
 
-            fprintf(f, "%s\n", data_to_save);
+static uint8_t log_Lookup(const char *value, const char **keys, uint8_t n_keys, uint8_t translated)
+{
+    for (uint8_t i = 1; i < n_keys; i++)
+    {
+        if (!strcmp(value, keys[i]) || (translated && !strcmp(value, return_Json_SMS_Data((char *)keys[i]))))
+        {
+            return i;
+        }
+    }
 
-            //ESP_LOGI("TAG", "File written");
+    return 0;
+}
 
-            fclose(f);
-            //////printf("\nsdcard1 \n");
+/* converte o registo de texto dos chamadores no registo binario e entrega-o
+   a task_SDCard_Log_Writer; nunca bloqueia quem decide o acesso. Se a fila
+   estiver cheia o registo e descartado */
+void sdCard_Write_LOGS(sdCard_Logs_struct *logs_Struct)
+{
+    sdCard_Log_Record record;
+    time_t now;
+    struct tm timeinfo;
 
-            //////printf("\nsdcard3 \n");
+    if (sdCard_Log_queue == NULL)
+    {
+        return;
+    }
 
-            // !!!!!!!!  APAGAR ISTO  !!!!!!!!
-            // nowTime.month = lastMonth;
+    memset(&record, 0, sizeof(record));
 
-            //////printf("\n\n unmount 111\n\n");
-            esp_vfs_fat_sdcard_unmount(mount_point, card);
-            //////printf("\n\n unmount 222\n\n");
-        }
+    if (strncmp(logs_Struct->date, "0;0", 3))
+    {
+        time(&now);
+        localtime_r(&now, &timeinfo);
+        record.epoch = now;
+        record.month = timeinfo.tm_mon + 1;
+    }
 
-        //ESP_LOGI("TAG", "Card unmounted");
+    record.source = log_Lookup(logs_Struct->type, log_Source_Names, sizeof(log_Source_Names) / sizeof(log_Source_Names[0]), 0);
 
-        // deinitialize the bus after all devices are removed
-        spi_bus_free(host.slot);
+    if (record.source == SDCARD_LOG_SOURCE_NONE && !strcmp(logs_Struct->type, return_Json_SMS_Data("CALL")))
+    {
+        record.source = SDCARD_LOG_SOURCE_CALL;
+    }
 
-        //////printf("\n\n unmount 333\n\n");
+    if (logs_Struct->relay[0] == 'R' && logs_Struct->relay[1] >= '1' && logs_Struct->relay[1] <= '9')
+    {
+        record.relay = logs_Struct->relay[1] - '0';
+    }
+    else if (logs_Struct->relay[0] != 0)
+    {
+        record.relay = SDCARD_LOG_RELAY_UNKNOWN;
     }
-    
-    free(data_to_save);
-    xSemaphoreGive(rdySem_Control_SD_Card_Write);
-    //ESP_LOGI("TAG", "xPortGetFreeHeapSize sd write2           : %d", xPortGetFreeHeapSize());
-    //ESP_LOGI("TAG", "esp_get_minimum_free_heap_size  : %d", esp_get_minimum_free_heap_size());
-    //ESP_LOGI("TAG", "heap_caps_get_largest_free_block: %d", heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
-    //ESP_LOGI("TAG", "free heap memory                : %d", heap_caps_get_free_size(MALLOC_CAP_8BIT));
-    //////printf("\n\n sdcard 33\n\n");
-}
 
-esp_err_t format_sdcard()
-{
-    esp_err_t ret = spi_bus_initialize(host.slot, &bus_cfg, SPI_DMA_CHAN);
+    record.state = log_Lookup(logs_Struct->relay_state, log_State_Keys, sizeof(log_State_Keys) / sizeof(log_State_Keys[0]), 1);
 
-    // spi_bus_free()
-    if (ret != ESP_OK)
+    if (!strcmp(logs_Struct->name, "S/N") || strlen(logs_Struct->name) == 0)
     {
-        //ESP_LOGE("TAG", "Failed to initialize bus.");
-        return ESP_FAIL;
+        record.name_kind = SDCARD_LOG_NAME_NO_NAME;
+    }
+    else
+    {
+        record.name_kind = log_Lookup(logs_Struct->name, log_Name_Keys, sizeof(log_Name_Keys) / sizeof(log_Name_Keys[0]), 1);
     }
 
-    // This initializes the slot without card detect (CD) and write protect (WP) signals.
-    // Modify slot_config.gpio_cd and slot_config.gpio_wp if your board has these signals.
-    sdspi_device_config_t slot_config = SDSPI_DEVICE_CONFIG_DEFAULT();
-    slot_config.gpio_cs = PIN_NUM_CS;
-    slot_config.host_id = host.slot;
-
-    //ESP_LOGI("TAG", "Mounting filesystem");
-    ret = esp_vfs_fat_sdspi_mount(mount_point, &host, &slot_config, &mount_config, &card);
+    if (record.name_kind == SDCARD_LOG_NAME_USER)
+    {
+        strncpy(record.name, logs_Struct->name, sizeof(record.name));
+    }
 
-    if (ret != ESP_OK)
+    for (uint8_t i = 0; i < sizeof(log_Error_Keys) / sizeof(log_Error_Keys[0]); i++)
     {
-        if (ret == ESP_FAIL)
-        {
-            //ESP_LOGE("TAG", "Failed to mount filesystem. ""If you want the card to be formatted, set the EXAMPLE_FORMAT_IF_MOUNT_FAILED menuconfig option.");
-        }
-        else
+        if (logs_Struct->error[0] != 0 && strstr(logs_Struct->error, return_Json_SMS_Data((char *)log_Error_Keys[i])) != NULL)
         {
-            //ESP_LOGE("TAG", "Failed to initialize the card (%s). ""Make sure SD card lines have pull-up resistors in place.",esp_err_to_name(ret));
+            record.result |= 1 << i;
         }
-        return 0;
+    }
+
+    strncpy(record.credential, logs_Struct->phone, sizeof(record.credential));
+    record.cred_hash = sdCard_Log_Credential_Hash(logs_Struct->phone);
+
+    if (xQueueSendToBack(sdCard_Log_queue, &record, 0) != pdTRUE)
+    {
+        sdCard_Log_Dropped++;
+    }
+}
+
+esp_err_t format_sdcard()
+{
+    if (!sdCard_Take())
+    {
+        return ESP_FAIL;
     }
 
     char drv[3] = {'0', ':', 0};
@@ -462,6 +895,7 @@ esp_err_t format_sdcard()
     if (workbuf == NULL)
     {
         //////printf("\n\nSDCARD 1.1\n\n");
+        sdCard_Give();
         return ESP_ERR_NO_MEM;
     }
     //////printf("\n\nSDCARD 2\n\n");
@@ -484,14 +918,9 @@ esp_err_t format_sdcard()
 
     //ESP_LOGI("sdcard", "Successfully formatted the SD card");
 
-    //////printf("\n\n unmount 111\n\n");
-    esp_vfs_fat_sdcard_unmount(mount_point, card);
-    //////printf("\n\n unmount 222\n\n");
-    //ESP_LOGI("TAG", "Card unmounted");
-
-    // deinitialize the bus after all devices are removed
-    spi_bus_free(host.slot);
-    //////printf("\n\n unmount 333\n\n");
+    // volta a montar no proximo ciclo do writer, os segmentos sao recriados
+    sdCard_Unmount();
+    sdCard_Give();
 
     return err;
 }
@@ -27,6 +27,7 @@
 #include "driver/sdmmc_types.h"
 
 #include "core.h"
+#include "log_record.h"
 
 #define SPI_DMA_CHAN SPI_DMA_CH_AUTO
 
@@ -45,6 +46,30 @@
 #define SDCARD_WRITE_BACKUP_OPERATION 2
 #define SDCARD_READ_BACKUP_OPERATION 3
 
+/* escrita de logs: os registos acumulam num buffer em RAM RTC e sao escritos
+   no cartao em blocos, ao atingir o limite ou apos SDCARD_LOG_FLUSH_MS */
+#define SDCARD_LOG_QUEUE_SIZE 16
+#define SDCARD_LOG_TAIL_RECORDS 64
+#define SDCARD_LOG_FLUSH_WATERMARK 48
+#define SDCARD_LOG_FLUSH_MS 10000
+#define SDCARD_LOG_POLL_MS 1000
+#define SDCARD_LOG_TAIL_MAGIC 0x4C4F4755
+#define SDCARD_LOG_SEGMENT_MAGIC 0x4C32304D
+#define SDCARD_LOG_VERSION 1
+
+#define SDCARD_LOG_STATE_NONE 0
+#define SDCARD_LOG_STATE_ON 1
+#define SDCARD_LOG_STATE_OFF 2
+#define SDCARD_LOG_STATE_PULSE 3
+#define SDCARD_LOG_STATE_NOT_CHANGE 4
+
+#define SDCARD_LOG_NAME_USER 0
+#define SDCARD_LOG_NAME_NO_NAME 1
+#define SDCARD_LOG_NAME_ROUTINE 2
+#define SDCARD_LOG_NAME_DISABLE_ROUTINE 3
+
+#define SDCARD_LOG_RELAY_UNKNOWN 0xFF
+
 //sdmmc_card_t *card;
 //sdmmc_host_t host;
 //sdspi_device_config_t slot_config;
@@ -77,16 +102,48 @@ typedef struct SD_CARD_LOGS_STRUCT
 
 } sdCard_Logs_struct;
 
+/* cabecalho de cada segmento /sdcard/MM.bin, seguido dos registos.
+   first/last_epoch sao do primeiro e do ultimo registo escrito; como o
+   relogio pode andar para tras (ME S C, NTP), min/max_epoch limitam o
+   intervalo e unordered indica que os epochs nao estao por ordem */
+typedef struct __attribute__((packed))
+{
+  uint32_t magic;
+  uint8_t version;
+  uint8_t record_size;
+  uint8_t month;
+  uint8_t reserved;
+  uint32_t count;
+  uint32_t first_epoch;
+  uint32_t last_epoch;
+  uint32_t min_epoch;
+  uint32_t max_epoch;
+  uint8_t unordered;
+  uint8_t pad[35];
+
+} sdCard_Log_Segment_Header;
+
 char *hexToAscii(char hex[]);
 void init_SDCard();
+void task_SDCard_Log_Writer(void *pvParameter);
 void sdCard_Write_LOGS(sdCard_Logs_struct *logs_Struct);
+void sdCard_Flush_LOGS();
+uint32_t get_SDCard_Log_Dropped();
+uint8_t get_SDCard_Mounted();
+uint8_t sdCard_Take();
+void sdCard_Give();
+uint8_t get_SDCard_Log_Segment(uint8_t month, sdCard_Log_Segment_Header *header);
+uint16_t sdCard_Read_Log_Records(uint8_t month, uint32_t index, sdCard_Log_Record *records, uint16_t n);
+uint16_t get_SDCard_Log_Pending(uint8_t month);
+uint32_t get_SDCard_Legacy_Log_Size(uint8_t month);
+size_t sdCard_Read_Legacy_Log(uint8_t month, uint32_t offset, char *out, size_t n);
+uint32_t sdCard_Log_Credential_Hash(const char *str);
+size_t sdCard_Render_Log_Header(char *out, size_t out_size);
+size_t sdCard_Render_Log_Record(const sdCard_Log_Record *record, char *out, size_t out_size);
 void read_BackupFile();
 void hex_to_string(char *msg, size_t msg_sz, char *hex, size_t hex_sz);
-void mount_SD_CARD();
 esp_err_t format_sdcard();
 
-void free_SPI_Host();
-
 
 
 #endif
\ No newline at end of file
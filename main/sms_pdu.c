@@ -0,0 +1,300 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "sms_pdu.h"
+#include <string.h>
+
+#define SMS_PDU_TPDU_MAX 176
+#define SMS_PDU_MAX_DIGITS 20
+
+#define SMS_PDU_GSM7_SINGLE 160
+#define SMS_PDU_GSM7_MULTI 153
+#define SMS_PDU_UCS2_SINGLE 70
+#define SMS_PDU_UCS2_MULTI 67
+
+/* UDH de concatenacao: 6 octetos, ocupa 7 septetos em GSM-7 */
+#define SMS_PDU_UDH_LEN 6
+#define SMS_PDU_UDH_SEPTETS 7
+
+#define GSM7_ESC 0x1B
+
+static const char sms_hex_lut[] = "0123456789ABCDEF";
+
+/* alfabeto GSM 03.38 por defeito, indice = septeto */
+static const uint16_t gsm7_default[128] = {
+    0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC, 0x00F2,
+    0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5, 0x0394, 0x005F,
+    0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8, 0x03A3, 0x0398, 0x039E,
+    0xFFFF, 0x00C6, 0x00E6, 0x00DF, 0x00C9, 0x0020, 0x0021, 0x0022, 0x0023,
+    0x00A4, 0x0025, 0x0026, 0x0027, 0x0028, 0x0029, 0x002A, 0x002B, 0x002C,
+    0x002D, 0x002E, 0x002F, 0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035,
+    0x0036, 0x0037, 0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E,
+    0x003F, 0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+    0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050,
+    0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059,
+    0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7, 0x00BF, 0x0061, 0x0062,
+    0x0063, 0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B,
+    0x006C, 0x006D, 0x006E, 0x006F, 0x0070, 0x0071, 0x0072, 0x0073, 0x0074,
+    0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1,
+    0x00FC, 0x00E0};
+
+/* tabela de extensao, enviada como ESC + septeto */
+static const uint16_t gsm7_ext[][2] = {
+    {0x000C, 0x0A}, {0x005E, 0x14}, {0x007B, 0x28}, {0x007D, 0x29},
+    {0x005C, 0x2F}, {0x005B, 0x3C}, {0x007E, 0x3D}, {0x005D, 0x3E},
+    {0x007C, 0x40}, {0x20AC, 0x65}};
+
+static uint32_t utf8_next(const char *text, size_t len, size_t *i) {
+  const uint8_t *s = (const uint8_t *)text;
+  uint32_t cp = s[*i];
+  uint8_t extra = 0;
+
+  if (cp >= 0xF0) {
+    cp &= 0x07;
+    extra = 3;
+  } else if (cp >= 0xE0) {
+    cp &= 0x0F;
+    extra = 2;
+  } else if (cp >= 0xC0) {
+    cp &= 0x1F;
+    extra = 1;
+  } else if (cp >= 0x80) {
+    (*i)++;
+    return 0xFFFD;
+  }
+
+  (*i)++;
+
+  while (extra--) {
+    if (*i >= len || (s[*i] & 0xC0) != 0x80) {
+      return 0xFFFD;
+    }
+    cp = (cp << 6) | (s[(*i)++] & 0x3F);
+  }
+
+  return cp;
+}
+
+static uint8_t gsm7_encode(uint32_t cp, uint8_t *septets) {
+  if (cp < 0x80 && gsm7_default[cp] == cp) {
+    septets[0] = cp;
+    return 1;
+  }
+
+  for (uint8_t i = 0; i < 128; i++) {
+    if (gsm7_default[i] == cp) {
+      septets[0] = i;
+      return 1;
+    }
+  }
+
+  for (uint8_t i = 0; i < sizeof(gsm7_ext) / sizeof(gsm7_ext[0]); i++) {
+    if (gsm7_ext[i][0] == cp) {
+      septets[0] = GSM7_ESC;
+      septets[1] = gsm7_ext[i][1];
+      return 2;
+    }
+  }
+
+  return 0;
+}
+
+static uint8_t unit_cost(uint8_t dcs, uint32_t cp) {
+  uint8_t septets[2];
+
+  if (dcs == SMS_PDU_DCS_UCS2) {
+    return cp >= 0x10000 ? 2 : 1;
+  }
+
+  return gsm7_encode(cp, septets);
+}
+
+static void put_septet(uint8_t *ud, uint16_t index, uint8_t value) {
+  uint16_t bit = index * 7;
+  uint8_t shift = bit % 8;
+
+  ud[bit / 8] |= (uint8_t)(value << shift);
+
+  if (shift > 1) {
+    ud[bit / 8 + 1] |= value >> (8 - shift);
+  }
+}
+
+uint8_t sms_PDU_Prepare(const char *text, sms_pdu_message *msg) {
+  size_t len = strlen(text);
+  size_t i = 0;
+  size_t start = 0;
+  uint16_t total = 0;
+  uint16_t used = 0;
+  uint16_t limit = 0;
+  uint8_t cost = 0;
+  uint8_t septets[2];
+
+  memset(msg, 0, sizeof(sms_pdu_message));
+  msg->text = text;
+  msg->dcs = SMS_PDU_DCS_GSM7;
+
+  while (i < len) {
+    if (!gsm7_encode(utf8_next(text, len, &i), septets)) {
+      msg->dcs = SMS_PDU_DCS_UCS2;
+      break;
+    }
+  }
+
+  i = 0;
+  while (i < len) {
+    total += unit_cost(msg->dcs, utf8_next(text, len, &i));
+  }
+
+  if (msg->dcs == SMS_PDU_DCS_GSM7) {
+    limit = total <= SMS_PDU_GSM7_SINGLE ? SMS_PDU_GSM7_SINGLE
+                                         : SMS_PDU_GSM7_MULTI;
+  } else {
+    limit = total <= SMS_PDU_UCS2_SINGLE ? SMS_PDU_UCS2_SINGLE
+                                         : SMS_PDU_UCS2_MULTI;
+  }
+
+  /* nunca parte um caracter (ESC + septeto ou par surrogate) entre
+     segmentos */
+  msg->segments = 1;
+  i = 0;
+  while (i < len) {
+    start = i;
+    cost = unit_cost(msg->dcs, utf8_next(text, len, &i));
+
+    if (used + cost > limit) {
+      if (msg->segments == SMS_PDU_MAX_SEGMENTS) {
+        msg->truncated = 1;
+        i = start;
+        break;
+      }
+
+      msg->seg_start[msg->segments++] = start;
+      used = 0;
+    }
+    used += cost;
+  }
+
+  msg->seg_start[msg->segments] = i;
+
+  return msg->segments;
+}
+
+size_t sms_PDU_Build(const sms_pdu_message *msg, const char *phNumber,
+                     uint8_t ref, uint8_t segment, char *out_hex,
+                     size_t out_size, uint8_t *tpdu_len) {
+  uint8_t tpdu[SMS_PDU_TPDU_MAX];
+  uint8_t digits[SMS_PDU_MAX_DIGITS];
+  uint8_t septets[2];
+  uint8_t n_digits = 0;
+  uint8_t concat = msg->segments > 1;
+  uint16_t count = 0;
+  size_t n = 0;
+  size_t ud = 0;
+  size_t udl = 0;
+  size_t i = 0;
+  size_t end = 0;
+  uint32_t cp = 0;
+
+  if (segment >= msg->segments) {
+    return 0;
+  }
+
+  for (size_t k = 0; phNumber[k] != 0 && n_digits < SMS_PDU_MAX_DIGITS; k++) {
+    if (phNumber[k] >= '0' && phNumber[k] <= '9') {
+      digits[n_digits++] = phNumber[k] - '0';
+    }
+  }
+
+  if (n_digits == 0) {
+    return 0;
+  }
+
+  memset(tpdu, 0, sizeof(tpdu));
+
+  /* SMS-SUBMIT com validade relativa, UDHI quando ha concatenacao */
+  tpdu[n++] = 0x11 | (concat ? 0x40 : 0x00);
+  tpdu[n++] = 0x00;
+
+  tpdu[n++] = n_digits;
+  tpdu[n++] = phNumber[0] == '+' ? 0x91 : 0x81;
+
+  for (uint8_t k = 0; k < n_digits; k += 2) {
+    tpdu[n++] = digits[k] | ((k + 1 < n_digits ? digits[k + 1] : 0x0F) << 4);
+  }
+
+  tpdu[n++] = 0x00;
+  tpdu[n++] = msg->dcs;
+  tpdu[n++] = 0xA7;
+
+  udl = n++;
+  ud = n;
+
+  if (concat) {
+    tpdu[n++] = 0x05;
+    tpdu[n++] = 0x00;
+    tpdu[n++] = 0x03;
+    tpdu[n++] = ref;
+    tpdu[n++] = msg->segments;
+    tpdu[n++] = segment + 1;
+  }
+
+  i = msg->seg_start[segment];
+  end = msg->seg_start[segment + 1];
+
+  if (msg->dcs == SMS_PDU_DCS_UCS2) {
+    while (i < end) {
+      cp = utf8_next(msg->text, end, &i);
+
+      if (cp >= 0x10000) {
+        cp -= 0x10000;
+        tpdu[n++] = 0xD8 | ((cp >> 18) & 0x03);
+        tpdu[n++] = (cp >> 10) & 0xFF;
+        cp = 0xDC00 | (cp & 0x3FF);
+      }
+
+      tpdu[n++] = cp >> 8;
+      tpdu[n++] = cp & 0xFF;
+    }
+
+    tpdu[udl] = n - ud;
+  } else {
+    count = concat ? SMS_PDU_UDH_SEPTETS : 0;
+
+    while (i < end) {
+      uint8_t k = gsm7_encode(utf8_next(msg->text, end, &i), septets);
+
+      for (uint8_t j = 0; j < k; j++) {
+        put_septet(tpdu + ud, count++, septets[j]);
+      }
+    }
+
+    tpdu[udl] = count;
+    n = ud + (count * 7 + 7) / 8;
+  }
+
+  if (out_size < 2 + n * 2 + 1) {
+    return 0;
+  }
+
+  /* SMSC por defeito do SIM */
+  out_hex[0] = '0';
+  out_hex[1] = '0';
+
+  for (size_t k = 0; k < n; k++) {
+    out_hex[2 + 2 * k] = sms_hex_lut[tpdu[k] >> 4];
+    out_hex[3 + 2 * k] = sms_hex_lut[tpdu[k] & 0x0F];
+  }
+  out_hex[2 + 2 * n] = 0;
+
+  *tpdu_len = n;
+
+  return 2 + 2 * n;
+}
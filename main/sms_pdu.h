@@ -0,0 +1,47 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _SMS_PDU_H_
+#define _SMS_PDU_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Codificacao de SMS-SUBMIT em modo PDU (AT+CMGF=0).
+ *
+ * O texto UTF-8 e enviado em GSM-7 quando todos os caracteres existem no
+ * alfabeto por defeito (ou na tabela de extensao), senao em UCS2. Mensagens
+ * maiores que um SMS sao partidas em segmentos com UDH de concatenacao
+ * (IEI 0x00, referencia de 8 bits). Os segmentos sao guardados apenas como
+ * offsets no texto original, cada PDU e gerado quando vai ser enviado.
+ */
+
+#define SMS_PDU_MAX_SEGMENTS 8
+#define SMS_PDU_HEX_SIZE 340
+
+#define SMS_PDU_DCS_GSM7 0x00
+#define SMS_PDU_DCS_UCS2 0x08
+
+typedef struct {
+  const char *text;
+  uint8_t dcs;
+  uint8_t segments;
+  uint8_t truncated;
+  uint16_t seg_start[SMS_PDU_MAX_SEGMENTS + 1];
+} sms_pdu_message;
+
+uint8_t sms_PDU_Prepare(const char *text, sms_pdu_message *msg);
+
+size_t sms_PDU_Build(const sms_pdu_message *msg, const char *phNumber,
+                     uint8_t ref, uint8_t segment, char *out_hex,
+                     size_t out_size, uint8_t *tpdu_len);
+
+#endif
@@ -0,0 +1,261 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "state_journal.h"
+#include "crc32.h"
+#include <stddef.h>
+#include <string.h>
+
+#define STATE_JOURNAL_SLOTS                                                    \
+  (STATE_JOURNAL_SECTOR_SIZE / STATE_JOURNAL_RECORD_SIZE)
+#define STATE_JOURNAL_CHUNK 16
+
+static uint32_t header_Crc(const state_journal_header *header) {
+  return crc32((uint8_t *)header, offsetof(state_journal_header, crc));
+}
+
+static uint32_t record_Crc(const state_journal_record *record) {
+  return crc32((uint8_t *)record, offsetof(state_journal_record, crc));
+}
+
+static uint8_t is_Erased(const void *data, uint32_t size) {
+  const uint8_t *bytes = (const uint8_t *)data;
+
+  for (uint32_t i = 0; i < size; i++) {
+    if (bytes[i] != 0xFF) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static uint32_t sector_Base(uint8_t sector) {
+  return (uint32_t)sector * STATE_JOURNAL_SECTOR_SIZE;
+}
+
+static uint8_t read_Header(state_journal *journal, uint8_t sector,
+                           state_journal_header *header) {
+  if (journal->flash.read(journal->flash.ctx, sector_Base(sector),
+                          header, sizeof(state_journal_header)) != 0) {
+    return 0;
+  }
+
+  return header->magic == STATE_JOURNAL_MAGIC &&
+         header->crc == header_Crc(header);
+}
+
+/* o registo vai para journal->offset do setor ativo */
+static int append_Record(state_journal *journal, uint8_t key, uint64_t value) {
+  state_journal_record record;
+
+  memset(&record, 0xFF, sizeof(record));
+  record.value = value;
+  record.key = key;
+  record.crc = record_Crc(&record);
+
+  if (journal->flash.write(journal->flash.ctx,
+                           sector_Base(journal->sector) +
+                               journal->offset,
+                           &record, sizeof(record)) != 0) {
+    return -1;
+  }
+
+  journal->offset += STATE_JOURNAL_RECORD_SIZE;
+  journal->writes++;
+  return 0;
+}
+
+static void replay_Sector(state_journal *journal) {
+  state_journal_record records[STATE_JOURNAL_CHUNK];
+
+  journal->offset = STATE_JOURNAL_RECORD_SIZE;
+
+  for (uint32_t slot = 1; slot < STATE_JOURNAL_SLOTS;
+       slot += STATE_JOURNAL_CHUNK) {
+    uint32_t count = STATE_JOURNAL_SLOTS - slot < STATE_JOURNAL_CHUNK
+                         ? STATE_JOURNAL_SLOTS - slot
+                         : STATE_JOURNAL_CHUNK;
+
+    if (journal->flash.read(journal->flash.ctx,
+                            sector_Base(journal->sector) +
+                                slot * STATE_JOURNAL_RECORD_SIZE,
+                            records, count * STATE_JOURNAL_RECORD_SIZE) != 0) {
+      return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+      if (is_Erased(&records[i], sizeof(state_journal_record))) {
+        return;
+      }
+
+      /* um registo cortado a meio ocupa o lugar mas nao conta */
+      journal->offset = (slot + i + 1) * STATE_JOURNAL_RECORD_SIZE;
+
+      if (records[i].key < STATE_JOURNAL_KEYS &&
+          records[i].crc == record_Crc(&records[i])) {
+        journal->values[records[i].key] = records[i].value;
+        journal->present |= 1UL << records[i].key;
+      }
+    }
+  }
+}
+
+/* apaga o setor seguinte, copia a fotografia e fecha com o cabecalho */
+static int start_Sector(state_journal *journal, uint8_t sector,
+                        uint32_t sequence) {
+  state_journal_header header;
+  uint8_t previous = journal->sector;
+  uint32_t previous_offset = journal->offset;
+
+  if (journal->flash.erase(journal->flash.ctx, sector_Base(sector),
+                           STATE_JOURNAL_SECTOR_SIZE) != 0) {
+    return -1;
+  }
+
+  journal->erases++;
+  journal->sector = sector;
+  journal->offset = STATE_JOURNAL_RECORD_SIZE;
+
+  for (uint8_t key = 0; key < STATE_JOURNAL_KEYS; key++) {
+    if (((journal->present >> key) & 1) &&
+        append_Record(journal, key, journal->values[key]) != 0) {
+      journal->sector = previous;
+      journal->offset = previous_offset;
+      return -1;
+    }
+  }
+
+  memset(&header, 0xFF, sizeof(header));
+  header.magic = STATE_JOURNAL_MAGIC;
+  header.sequence = sequence;
+  header.crc = header_Crc(&header);
+
+  if (journal->flash.write(journal->flash.ctx, sector_Base(sector),
+                           &header, sizeof(header)) != 0) {
+    journal->sector = previous;
+    journal->offset = previous_offset;
+    return -1;
+  }
+
+  journal->writes++;
+  journal->sequence = sequence;
+  return 0;
+}
+
+int state_Journal_Open(state_journal *journal,
+                       const state_journal_flash *flash) {
+  state_journal_header header;
+  uint8_t found = 0;
+
+  memset(journal, 0, sizeof(state_journal));
+  journal->flash = *flash;
+  journal->sectors = flash->size / STATE_JOURNAL_SECTOR_SIZE;
+
+  if (journal->sectors < 2) {
+    return -1;
+  }
+
+  for (uint8_t sector = 0; sector < journal->sectors; sector++) {
+    if (read_Header(journal, sector, &header) &&
+        (!found || (int32_t)(header.sequence - journal->sequence) > 0)) {
+      found = 1;
+      journal->sector = sector;
+      journal->sequence = header.sequence;
+    }
+  }
+
+  if (!found) {
+    return start_Sector(journal, 0, 1) == 0 ? 1 : -1;
+  }
+
+  replay_Sector(journal);
+  return 0;
+}
+
+uint8_t state_Journal_Get(const state_journal *journal, uint8_t key,
+                          uint64_t *value) {
+  if (key >= STATE_JOURNAL_KEYS || !((journal->present >> key) & 1)) {
+    return 0;
+  }
+
+  *value = journal->values[key];
+  return 1;
+}
+
+int state_Journal_Compact(state_journal *journal) {
+  return start_Sector(journal, (journal->sector + 1) % journal->sectors,
+                      journal->sequence + 1);
+}
+
+int state_Journal_Set(state_journal *journal, uint8_t key, uint64_t value) {
+  uint64_t previous = 0;
+  uint32_t present = journal->present;
+
+  if (key >= STATE_JOURNAL_KEYS) {
+    return -1;
+  }
+
+  if (((journal->present >> key) & 1) && journal->values[key] == value) {
+    return 0;
+  }
+
+  if (journal->offset < STATE_JOURNAL_SECTOR_SIZE) {
+    if (append_Record(journal, key, value) != 0) {
+      return -1;
+    }
+  } else {
+    /* a fotografia ja leva o valor novo, em erro volta o que a flash tem */
+    previous = journal->values[key];
+    journal->values[key] = value;
+    journal->present |= 1UL << key;
+
+    if (state_Journal_Compact(journal) != 0) {
+      journal->values[key] = previous;
+      journal->present = present;
+      return -1;
+    }
+  }
+
+  journal->values[key] = value;
+  journal->present |= 1UL << key;
+  return 0;
+}
+
+int state_Journal_Clear(state_journal *journal) {
+  uint64_t values[STATE_JOURNAL_KEYS];
+  uint32_t present = journal->present;
+
+  memcpy(values, journal->values, sizeof(values));
+  memset(journal->values, 0, sizeof(journal->values));
+  journal->present = 0;
+
+  /* o setor vazio tem a maior sequencia, um corte a seguir ja nao repoe
+     nada */
+  if (state_Journal_Compact(journal) != 0) {
+    memcpy(journal->values, values, sizeof(values));
+    journal->present = present;
+    return -1;
+  }
+
+  for (uint8_t sector = 0; sector < journal->sectors; sector++) {
+    if (sector == journal->sector) {
+      continue;
+    }
+
+    if (journal->flash.erase(journal->flash.ctx, sector_Base(sector),
+                             STATE_JOURNAL_SECTOR_SIZE) != 0) {
+      return -1;
+    }
+    journal->erases++;
+  }
+
+  return 0;
+}
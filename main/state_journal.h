@@ -0,0 +1,100 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _STATE_JOURNAL_H_
+#define _STATE_JOURNAL_H_
+
+#include <stdint.h>
+
+/*
+ * Diario do estado dos reles e das rotinas numa regiao de flash propria.
+ * Cada mudanca e um registo fixo de 16 bytes acrescentado ao setor ativo:
+ *
+ *   setor: [CABECALHO 16][REGISTO 16] x 255
+ *   cabecalho: [MAGIC][SEQUENCIA][CRC32][0xFFFFFFFF]
+ *   registo:   [VALOR 8][CHAVE 1][0xFF x 3][CRC32]
+ *
+ * Quando o setor enche, o seguinte e apagado, recebe uma fotografia de
+ * todas as chaves e so depois o cabecalho com a sequencia seguinte. Um
+ * corte de energia a meio deixa sempre o setor anterior valido. No
+ * arranque ganha o setor com o cabecalho valido de maior sequencia e os
+ * registos sao repostos por ordem, os que tem CRC errado sao ignorados.
+ *
+ * Um valor igual ao guardado nao e escrito e um valor so fica em memoria
+ * depois de chegar a flash. O modulo nao depende de
+ * ESP-IDF nem de FreeRTOS, a flash e acedida pelas funcoes em
+ * state_journal_flash (0 = sucesso, como esp_err_t).
+ */
+
+#define STATE_JOURNAL_MAGIC 0x4C4E524A
+#define STATE_JOURNAL_SECTOR_SIZE 4096
+#define STATE_JOURNAL_RECORD_SIZE 16
+#define STATE_JOURNAL_KEYS 16
+
+typedef struct
+{
+  int (*read)(void *ctx, uint32_t offset, void *data, uint32_t size);
+  int (*write)(void *ctx, uint32_t offset, const void *data, uint32_t size);
+  int (*erase)(void *ctx, uint32_t offset, uint32_t size);
+  void *ctx;
+  uint32_t size;
+
+} state_journal_flash;
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t sequence;
+  uint32_t crc;
+  uint32_t reserved;
+
+} state_journal_header;
+
+typedef struct
+{
+  uint64_t value;
+  uint8_t key;
+  uint8_t reserved[3];
+  uint32_t crc;
+
+} state_journal_record;
+
+typedef struct
+{
+  state_journal_flash flash;
+  uint8_t sectors;
+  uint8_t sector;
+  uint32_t sequence;
+  uint32_t offset;
+  uint32_t present;
+  uint64_t values[STATE_JOURNAL_KEYS];
+  uint32_t writes;
+  uint32_t erases;
+
+} state_journal;
+
+/* 1 se a regiao estava vazia ou invalida e foi formatada, 0 se foi
+   reposta, -1 em erro */
+int state_Journal_Open(state_journal *journal,
+                       const state_journal_flash *flash);
+
+uint8_t state_Journal_Get(const state_journal *journal, uint8_t key,
+                          uint64_t *value);
+
+int state_Journal_Set(state_journal *journal, uint8_t key, uint64_t value);
+
+/* passa a fotografia das chaves para o setor seguinte */
+int state_Journal_Compact(state_journal *journal);
+
+/* reposicao de fabrica: esquece todas as chaves. Primeiro fica valido um
+   setor novo sem registos, depois os outros sao apagados */
+int state_Journal_Clear(state_journal *journal);
+
+#endif
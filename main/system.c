@@ -24,6 +24,7 @@
 
 #include "inputs.h"
 #include "jobs.h"
+#include "log_query.h"
 #include "pcf85063.h"
 #include "rele.h"
 #include "rf.h"
@@ -41,7 +42,6 @@
 uint32_t translate_File_CRC32 = 0;
 uint8_t label_Translate_File_CRC32 = 0;
 uint8_t label_Semaphore_Reset_System;
-uint8_t sendLOG_User_Label;
 char SYSTEM_NAME[30];
 uint8_t label_SoundFile_Open;
 uint8_t feedback_Sound_Index = 0;
@@ -55,15 +55,6 @@ extern QueueHandle_t Type_Call_queue;
 SemaphoreHandle_t rdySem_Send_LOGS_Files;
 SemaphoreHandle_t rdySem_Reset_System;
 
-typedef struct {
-  uint8_t gattsIF;
-  uint16_t connID;
-  uint16_t handle_table;
-  char payload[200];
-  char usr_perm;
-
-} sendLOGS_parameters_Message;
-
 char file_contents[310];
 
 char *MyUser_change_USER_To_ADMIN(uint8_t BLE_SMS_INDICATION, char *payload,
@@ -379,9 +370,6 @@ char *set_System_Clock(char *payload) {
   routine_list = (list_node *)malloc(sizeof(list_node));
   memset(&routine_list, 0, sizeof(routine_list));
 */
-  routines_ID = 0;
-  save_INT8_Data_In_Storage(NVS_ROUTINES_ID, routines_ID, nvs_System_handle);
-
   /* cron_stop();
   cron_job_clear_all();
 */
@@ -418,7 +406,7 @@ uint8_t start_Download_Sound_File() {
 
 char *parse_Start_Download_File(char *payload) {
 
-  timer_pause(TIMER_GROUP_1, TIMER_0);
+  suspend_Timer_Group(TIMER_SERVICE_GROUP_MODEM);
   // ////printf("\nsms\n");
   vTaskSuspend(xHandle_Timer_VerSystem);
   // disableAlarm();
@@ -572,6 +560,9 @@ uint8_t system_Reset() {
   nvs_erase_all(nvs_wiegand_codes_users_handle);
   nvs_erase_all(nvs_wiegand_codes_admin_handle);
   nvs_erase_all(nvs_wiegand_codes_owner_handle);
+  nvs_erase_all(nvs_Phone_Index_handle);
+  /* ultima posicao dos reles e estado das rotinas */
+  clear_State_Journal();
   save_INT8_Data_In_Storage(NVS_KEY_OWNER_LABEL, 0, nvs_System_handle);
 
   uint8_t owner_Label1 =
@@ -598,6 +589,7 @@ uint8_t system_Reset() {
   }
 
 gpio_set_level(GPIO_OUTPUT_ACT, 0);
+  snapshot_Runtime_Status();
  vTaskDelay(pdMS_TO_TICKS(1500));
   esp_restart();
   // ////printf("\n\nlabel_ResetSystem == 4\n\n");
@@ -909,6 +901,7 @@ char *parse_SystemData(uint8_t BLE_SMS_Indication, char cmd, char param,
          
           if (atoi(payload) >= 0 && atoi(payload) <= 3) {
             nvs_set_u8(nvs_System_handle, NVS_INPUT_REX_VALUE, atoi(payload));
+            reload_Input_Rules();
             asprintf(&rsp, "ME S X %d",atoi(payload));
             return rsp;
           } else {
@@ -922,6 +915,20 @@ char *parse_SystemData(uint8_t BLE_SMS_Indication, char cmd, char param,
         return return_ERROR_Codes(&rsp,
                                   return_Json_SMS_Data("ONLY_BLE_FUNCTION"));
       }
+    } else if (param == COUNTRY_CODE_PARAMETER) {
+      if (user_validateData->permition == '2') {
+        if (set_Default_Country_Code(payload)) {
+          asprintf(&rsp, "%s %c %c %s", ADMIN_ELEMENT, cmd, param,
+                   get_Default_Country_Code());
+          return rsp;
+        }
+
+        return return_ERROR_Codes(&rsp,
+                                  return_Json_SMS_Data("ERROR_INPUT_DATA"));
+      } else {
+        return return_ERROR_Codes(
+            &rsp, return_Json_SMS_Data("ERROR_USER_NOT_PERMITION"));
+      }
     } else if (param == SMS_CALL_VERIFICATION_PARAMETER) {
       if (user_validateData->permition == '2') {
         // //printf("\n\n sms verify444 %d\n\n", atoi(payload));
@@ -1068,14 +1075,12 @@ char *parse_SystemData(uint8_t BLE_SMS_Indication, char cmd, char param,
         uint8_t InitNetworkCount = 0;
 
         if (user_validateData->permition == '2') {
-          save_INT8_Data_In_Storage(NVS_QMT_LARGE_DATA_TIMER_LABEL, 1,
-                                    nvs_System_handle);
+          runtime_Status.qmt_large_data = 1;
           nvs_erase_key(nvs_System_handle, NVS_NETWORK_LOCAL_CHANGED);
           // save_INT8_Data_In_Storage(NVS_NETWORK_LOCAL_CHANGED, 3,
           // nvs_System_handle);
           asprintf(&rsp, "ME S W %s", activateUDP_network());
-          save_INT8_Data_In_Storage(NVS_QMT_LARGE_DATA_TIMER_LABEL, 0,
-                                    nvs_System_handle);
+          runtime_Status.qmt_large_data = 0;
           return rsp;
         } else {
           return return_ERROR_Codes(
@@ -1144,6 +1149,17 @@ char *parse_SystemData(uint8_t BLE_SMS_Indication, char cmd, char param,
                                   return_Json_SMS_Data("ONLY_BLE_FUNCTION"));
       } 
     }
+    else if (param == COUNTRY_CODE_PARAMETER) {
+      if (user_validateData->permition == '2' ||
+          user_validateData->permition == '1') {
+        asprintf(&rsp, "%s %c %c %s", ADMIN_ELEMENT, cmd, param,
+                 get_Default_Country_Code());
+        return rsp;
+      } else {
+        return return_ERROR_Codes(
+            &rsp, return_Json_SMS_Data("ERROR_USER_NOT_PERMITION"));
+      }
+    }
     else if (param == GET_IMEI_PARAMETER) {
       char imei[20] = {};
       size_t required_size = 0;
@@ -1538,7 +1554,6 @@ char *parse_SystemData(uint8_t BLE_SMS_Indication, char cmd, char param,
         if (!gpio_get_level(GPIO_INPUT_IO_CD_SDCARD)) {
           // ////printf("\n\nSDCARD 0\n\n");
           if (format_sdcard() == ESP_OK) {
-            nvs_set_u8(nvs_System_handle, NVS_LAST_MONTH, 0);
             if (BLE_SMS_Indication == BLE_INDICATION ||
                 BLE_SMS_Indication == UDP_INDICATION) {
               label_BLE_UDP_send = 0;
@@ -2502,192 +2517,49 @@ char *MyUser_add_Admin(uint8_t BLE_SMS_INDICATION, char *payload,
 }
 
 char *get_LogFiles_profiles() {
-  init_SDCard();
-  char fileName[50];
-  long int file_Len = 0;
+  sdCard_Log_Segment_Header header;
+  uint32_t count = 0;
+  uint32_t size = 0;
   int append = 0;
-  FILE *f;
-  // lastMonth = 5;
-  memset(file_contents, 0, 200);
-  memset(fileName, 0, 20);
-  for (int i = 1; i <= 12; i++) {
 
-    sprintf(fileName, "/sdcard/%02d.csv", i);
-    // ////printf("\nFILE NAME %s\n", fileName);
-    if (!access(fileName, F_OK)) {
-      f = fopen(fileName, "r");
+  /* tamanhos a partir do indice dos segmentos em RAM, sem acesso ao cartao;
+     conta tambem os registos ainda no buffer e o MM.csv antigo */
+  memset(file_contents, 0, 200);
 
-      fseek(f, 0, SEEK_END);
+  for (int i = 1; i <= 12; i++) {
+    size = get_SDCard_Legacy_Log_Size(i);
+    count = get_SDCard_Log_Segment(i, &header) ? header.count : 0;
 
-      file_Len = ftell(f);
-      append += sprintf(file_contents + append, "%d-%ld ", i, file_Len);
-      // ////printf("\n%s\n", file_contents);
-      fclose(f);
-    } else {
-      // ////printf("\nThe File %s\t not Found\n", fileName);
-      append += sprintf(file_contents + append, "%d-0 ", i);
-      // ////printf("\n%s\n", file_contents);
+    if (get_SDCard_Mounted()) {
+      count += get_SDCard_Log_Pending(i);
     }
-  }
 
-  // ////printf("\n\n unmount 111\n\n");
-  free_SPI_Host();
-  // esp_vfs_fat_sdcard_unmount(MOUNT_POINT, card);
-  // // ////printf("\n\n unmount 222\n\n");
-  // //ESP_LOGI("TAG", "Card unmounted");
+    if (count > 0) {
+      size += sizeof(header) + count * sizeof(sdCard_Log_Record);
+    }
 
-  // // deinitialize the bus after all devices are removed
-  // spi_bus_free(host.slot);
-  // ////printf("\n\n unmount 333\n\n");
+    append += sprintf(file_contents + append, "%d-%lu ", i, (unsigned long)size);
+  }
 
   return file_contents;
 }
 
 char *send_LogFile(uint8_t gattsIF, uint16_t connID, uint16_t handle_table,
                    char userPermition, char *payload) {
+  log_query_filter filter;
 
-  sendLOGS_parameters_Message message = {
-      .gattsIF = gattsIF,
-      .connID = connID,
-      .handle_table = handle_table,
-      .usr_perm = userPermition,
-  };
-  sprintf(message.payload, "%s", payload);
-
-  // ////printf("queue created\n");
-  // ////printf("MyUser_ReadAllUsers CONN ID %d\n", message.connID);
-  // ////printf("MyUser_ReadAllUsers GATTSIF %d\n", message.gattsIF);
-  // ////printf("MyUser_ReadAllUsers %d\n", message.handle_table);
-
-  if (sendLOG_User_Label == 0) {
-    sendLOG_User_Label = 1;
-    readAllUser_ConnID = message.connID;
-    xTaskCreate(task_Send_LOG_File, "task_Send_LOG_File", 4000,
-                (void *)&message, NULL, NULL);
-    vTaskDelay(pdMS_TO_TICKS((100)));
-  } else {
+  /* exportacao do mes inteiro, feita pelo motor de consultas (log_query.c) */
+  memset(&filter, 0, sizeof(filter));
+  filter.month = atoi(payload);
+  filter.source = LOG_QUERY_ANY;
+  filter.result = LOG_QUERY_ANY;
+
+  if (!log_Query_Submit(BLE_INDICATION, gattsIF, connID, handle_table, &filter,
+                        1)) {
     return "READ ALL USERS NOT POSSIBLE";
   }
 
+  readAllUser_ConnID = connID;
+
   return "USER ALL OK";
 }
-
-void task_Send_LOG_File(void *pvParameter) {
-
-  // heap_trace_start(HEAP_TRACE_LEAKS);
-  sendLOGS_parameters_Message *message =
-      (sendLOGS_parameters_Message *)pvParameter;
-
-  // ////printf("\n\ntask_Send_LOG_File 00 - %s\n\n", message->payload);
-
-  sendLOGS_parameters_Message cpy_message = {
-      .connID = message->connID,
-      .gattsIF = message->gattsIF,
-      .handle_table = message->handle_table,
-      .usr_perm = message->usr_perm,
-  };
-  // ////printf("\n\ntask_Send_LOG_File 001\n\n");
-  sprintf(cpy_message.payload, "%s", message->payload);
-  char fileLOGS_content[182];
-  // ////printf("\n\ntask_Send_LOG_File 01\n\n");
-  init_SDCard();
-  // ////printf("\n\ntask_Send_LOG_File 21\n\n");
-
-  // ////printf("\n\ntask_Send_LOG_File 1\n\n");
-
-  // ////printf("\n\ntask_Send_LOG_File 2 - %s\n\n", message->payload);
-  if (strlen(cpy_message.payload) > 2) {
-    // ////printf("\n\n unmount 111\n\n");
-    free_SPI_Host();
-    // esp_vfs_fat_sdcard_unmount(MOUNT_POINT, card);
-    // // ////printf("\n\n unmount 222\n\n");
-    // //ESP_LOGI("TAG", "Card unmounted");
-
-    // // deinitialize the bus after all devices are removed
-    // spi_bus_free(host.slot);
-    // ////printf("\n\n unmount 333\n\n");
-    sendLOG_User_Label = 0;
-    vTaskDelete(NULL);
-  } else {
-    // ////printf("\n\ntask_Send_LOG_File 3\n\n");
-    FILE *ptr;
-
-    if (atoi(cpy_message.payload) > 0 && atoi(cpy_message.payload) <= 12) {
-      char *fileName;
-      char ch;
-
-      asprintf(&fileName, "/sdcard/%02d.csv", atoi(cpy_message.payload));
-      ptr = fopen(fileName, "r");
-      // ////printf("\n\ntask_Send_LOG_File 4\n\n");
-      if (NULL == ptr) {
-        free_SPI_Host();
-        // ////printf("\n\n unmount 111\n\n");
-        // esp_vfs_fat_sdcard_unmount(MOUNT_POINT, card);
-        // // ////printf("\n\n unmount 222\n\n");
-        // //ESP_LOGI("TAG", "Card unmounted");
-
-        // // deinitialize the bus after all devices are removed
-        // spi_bus_free(host.slot);
-        // ////printf("\n\n unmount 333\n\n");
-        // ////printf("file can't be opened \n");
-        sendLOG_User_Label = 0;
-        free(fileName);
-        vTaskDelete(NULL);
-      } else {
-        // ////printf("\nOPEN FILE: %s\n", fileName);
-      }
-
-      // ////printf("\n\ntask_Send_LOG_File 5\n\n");
-
-      while (!feof(ptr)) {
-        // ////printf("\n\ntask_Send_LOG_File 6\n\n");
-        memset(fileLOGS_content, 0, sizeof(fileLOGS_content));
-        for (int i = 0; i < 180; i++) {
-          ch = fgetc(ptr);
-          fileLOGS_content[i] = ch;
-
-          if (feof(ptr)) {
-            break;
-          }
-        }
-
-        if (strlen(fileLOGS_content) < 180) {
-          fileLOGS_content[strlen(fileLOGS_content) - 1] = 0;
-        }
-
-        // ////printf("\nLOGS SEND DATA:\n%s\n", fileLOGS_content);
-
-        if (esp_ble_gatts_send_indicate(
-                cpy_message.gattsIF, cpy_message.connID,
-                cpy_message.handle_table, strlen(fileLOGS_content),
-                (uint8_t *)fileLOGS_content, false) != ESP_OK) {
-          // free(fileName);
-          break;
-        }
-
-        // xSemaphoreTake(rdySem_Send_LOGS_Files, portMAX_DELAY);
-        vTaskDelay(pdMS_TO_TICKS(50));
-        // take_LOG_Files_Semph();
-
-        // ////printf("\nlog: %#X\n", ch);
-      }
-      // free(pvParameter);
-      fclose(ptr);
-      free(fileName);
-    }
-    sendLOG_User_Label = 0;
-
-    // ////printf("\n\n unmount 111\n\n");
-    // esp_vfs_fat_sdcard_unmount(MOUNT_POINT, card);
-    // ////printf("\n\n unmount 222\n\n");
-    free_SPI_Host();
-    // ESP_LOGI("TAG", "Card unmounted");
-
-    // deinitialize the bus after all devices are removed
-    // spi_bus_free(host.slot);
-    // ////printf("\n\n unmount 333\n\n");
-    // heap_trace_stop();
-    // heap_trace_dump();
-    vTaskDelete(NULL);
-  }
-}
\ No newline at end of file
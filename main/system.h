@@ -80,8 +80,6 @@ uint8_t get_Feedback_SMS();
 
 char *UDP_activate_desativate_logs(uint8_t log_action);
 
-void task_Send_LOG_File(void *pvParameter);
-
 void give_rdySem_Reset_System();
 
 uint8_t changeInputTranslators(char *payload);
@@ -20,14 +20,13 @@
 
 #include "AT_CMD_List.h"
 #include "core.h"
-#include "driver/timer.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
+#include "health_monitor.h"
 #include "system.h"
 
-uint8_t NetworkFail_Counter = 0;
 uint8_t label_timerVerifySystem;
 
 SemaphoreHandle_t rdySem_Timer_Input2_feedback_Timeout;
@@ -44,14 +43,176 @@ const esp_timer_create_args_t periodic_timer_args = {
     /* name is optional, but may help identify the timer when debugging */
     .name = "periodic"};
 
-uint32_t TIMER_BASE_CLK_CALC() {
-  timer_config_t config;
-  timer_get_config(TIMER_GROUP_0, TIMER_0, &config);
-  uint64_t timer_freq = APB_CLK_FREQ;
-  if (config.divider > 0) {
-    timer_freq /= (config.divider + 1);
+/* todos os temporizadores de ms numa so tarefa (timer_service.h): dorme ate
+   ao proximo disparo ou ate alguem armar/parar um temporizador. Os
+   callbacks correm nesta tarefa com o trinco (recursivo) tomado, por isso
+   devem ser curtos; podem armar e parar temporizadores */
+static timer_service timer_Service;
+static SemaphoreHandle_t timer_Service_Mutex = NULL;
+static StaticSemaphore_t timer_Service_Mutex_Buffer;
+static TaskHandle_t timer_Service_Task_Handle = NULL;
+
+static timer_service_timer health_Monitor_Timer;
+static timer_service_timer timer_Stats_Timer;
+
+/* monitor de saude (health_monitor.h): a cada tick do temporizador
+   "health_monitor" le o estado so da RAM, publica quando aparece um alarme
+   novo e, se a recuperacao estiver ligada, executa no maximo uma acao */
+static health_metrics health_Metrics;
+static health_recovery health_Recovery;
+static uint8_t health_Breaches;
+static uint8_t health_Network_Ok = 1;
+static uint8_t health_Recovery_Enabled;
+static SemaphoreHandle_t health_Mutex = NULL;
+static StaticSemaphore_t health_Mutex_Buffer;
+
+static const health_thresholds health_Thresholds = {
+    HEALTH_HEAP_FREE_MIN, HEALTH_HEAP_BLOCK_MIN, HEALTH_STACK_FREE_MIN};
+
+/* a ordem e o indice "@n" da pilha no relatorio */
+static TaskHandle_t *const health_Tasks[] = {
+    &handle_SMS_TASK,          &handle_SEND_SMS_TASK,
+    &handle_UDP_TASK,          &relay_Engine_Task_Handle,
+    &timer_Service_Task_Handle, &xHandle_Timer_VerSystem};
+
+static uint32_t timer_Service_Now() {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void take_Timer_Service() {
+  xSemaphoreTakeRecursive(timer_Service_Mutex, portMAX_DELAY);
+}
+
+/* acorda a tarefa para recalcular a espera, exceto dentro dos callbacks */
+static void give_Timer_Service() {
+  xSemaphoreGiveRecursive(timer_Service_Mutex);
+
+  if (timer_Service_Task_Handle != NULL &&
+      xTaskGetCurrentTaskHandle() != timer_Service_Task_Handle) {
+    xTaskNotifyGive(timer_Service_Task_Handle);
+  }
+}
+
+void task_Timer_Service(void *pvParameter) {
+  uint32_t wait = TIMER_WHEEL_NONE;
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, wait == TIMER_WHEEL_NONE
+                                 ? portMAX_DELAY
+                                 : pdMS_TO_TICKS(wait) + 1);
+
+    xSemaphoreTakeRecursive(timer_Service_Mutex, portMAX_DELAY);
+    timer_Service_Advance(&timer_Service, timer_Service_Now());
+    wait = timer_Service_Next(&timer_Service, timer_Service_Now());
+    xSemaphoreGiveRecursive(timer_Service_Mutex);
+  }
+}
+
+void init_Timer_Service() {
+  timer_Service_Mutex =
+      xSemaphoreCreateRecursiveMutexStatic(&timer_Service_Mutex_Buffer);
+  timer_Service_Init(&timer_Service, timer_Service_Now());
+
+  xTaskCreate(task_Timer_Service, "task_Timer_Service", 4096, NULL, 22,
+              &timer_Service_Task_Handle);
+}
+
+void register_Timer(timer_service_timer *timer, const char *name,
+                    uint8_t group, timer_service_callback callback, void *ctx) {
+  take_Timer_Service();
+  timer_Service_Register(&timer_Service, timer, name, group, callback, ctx);
+  give_Timer_Service();
+}
+
+/* 0 se o temporizador ainda nao foi registado */
+uint8_t start_Timer(timer_service_timer *timer, uint32_t delay_ms,
+                    uint32_t period_ms) {
+  if (timer->service == NULL) {
+    return 0;
   }
-  return (uint32_t)timer_freq;
+
+  take_Timer_Service();
+  timer_Service_Start(&timer_Service, timer, delay_ms, period_ms,
+                      timer_Service_Now());
+  give_Timer_Service();
+  return 1;
+}
+
+void stop_Timer(timer_service_timer *timer) {
+  if (timer->service == NULL) {
+    return;
+  }
+
+  take_Timer_Service();
+  timer_Service_Stop(&timer_Service, timer);
+  give_Timer_Service();
+}
+
+uint8_t is_Timer_Active(timer_service_timer *timer) {
+  uint8_t active = 0;
+
+  if (timer->service == NULL) {
+    return 0;
+  }
+
+  take_Timer_Service();
+  active = timer_Service_Is_Active(timer);
+  xSemaphoreGiveRecursive(timer_Service_Mutex);
+  return active;
+}
+
+/* substitui o timer_pause/timer_start do grupo de hardware a volta das
+   operacoes do modem: o tempo que falta fica guardado */
+void suspend_Timer_Group(uint8_t group) {
+  if (timer_Service_Mutex == NULL) {
+    return;
+  }
+
+  take_Timer_Service();
+  timer_Service_Suspend_Group(&timer_Service, group, timer_Service_Now());
+  give_Timer_Service();
+}
+
+void resume_Timer_Group(uint8_t group) {
+  if (timer_Service_Mutex == NULL) {
+    return;
+  }
+
+  take_Timer_Service();
+  timer_Service_Resume_Group(&timer_Service, group, timer_Service_Now());
+  give_Timer_Service();
+}
+
+void log_Timer_Service_Stats() {
+  take_Timer_Service();
+
+  ESP_LOGI("TIMERS", "wakeups %lu", (unsigned long)timer_Service.wakeups);
+
+  for (timer_service_timer *timer = timer_Service.timers; timer != NULL;
+       timer = timer->next_registered) {
+    ESP_LOGI("TIMERS",
+             "%-20s fires %lu missed %lu late avg %lu max %lu ms jitter max "
+             "%lu ms%s",
+             timer->name, (unsigned long)timer->fires,
+             (unsigned long)timer->missed,
+             (unsigned long)(timer->fires ? timer->late_sum / timer->fires
+                                          : 0),
+             (unsigned long)timer->late_max, (unsigned long)timer->jitter_max,
+             timer->suspended ? " (suspenso)" : "");
+  }
+
+  xSemaphoreGiveRecursive(timer_Service_Mutex);
+}
+
+static void health_Monitor_Timer_Callback(timer_service_timer *timer,
+                                          void *ctx) {
+  if (xHandle_Timer_VerSystem != NULL) {
+    xTaskNotifyGive(xHandle_Timer_VerSystem);
+  }
+}
+
+static void timer_Stats_Callback(timer_service_timer *timer, void *ctx) {
+  log_Timer_Service_Stats();
 }
 
 void initTimers() {
@@ -59,32 +220,27 @@ void initTimers() {
   vSemaphoreCreateBinary(semaphore_ACT);
   vSemaphoreCreateBinary(rdySem_Timer_Input2_feedback_Timeout);
   xSemaphoreTake(rdySem_Timer_Input2_feedback_Timeout, 0);
-  s_timer_queue = xQueueCreate(2, sizeof(example_timer_event_t));
-  alarm_I1_Timeout_queue = xQueueCreate(2, sizeof(example_timer_event_t));
-
-  example_tg_timer_init(TIMER_GROUP_1, TIMER_0, true, 5);
-  s_timer_queue = xQueueCreate(2, sizeof(example_timer_event_t));
-
-  // example_tg_timer_init(TIMER_GROUP_0, TIMER_0, false, 10);
-  // timer_pause(TIMER_GROUP_0, TIMER_0);
 
-  // example_tg_timer_init(TIMER_GROUP_1, TIMER_1, true, 2);
-  // xTaskCreate(&task_VerifySystem, "task_VerifySystem", 4 * 2048, NULL, 2
-  // /*32*/, &xHandle_Timer_VerSystem);
-  
+  health_Mutex = xSemaphoreCreateMutexStatic(&health_Mutex_Buffer);
+  health_Recovery_Init(&health_Recovery);
+  xTaskCreate(task_Health_Monitor, "task_Health_Monitor", 4 * 2048 + 2048,
+              NULL, 5, &xHandle_Timer_VerSystem);
 
-  // example_tg_timer_init(TIMER_GROUP_0, TIMER_0, false, 10000);
-  // timer_pause(TIMER_GROUP_0, TIMER_0);
-  //  xTaskCreate(timer0_main_ctrl, "timer0_main_ctrl", 2048, NULL, 3, NULL);
+  register_Timer(&health_Monitor_Timer, "health_monitor",
+                 TIMER_SERVICE_GROUP_MODEM, health_Monitor_Timer_Callback,
+                 NULL);
+  start_Timer(&health_Monitor_Timer, 5000, 5000);
 
-  // ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
-  // ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, 100000000));
+  register_Timer(&timer_Stats_Timer, "timer_stats", TIMER_SERVICE_NO_GROUP,
+                 timer_Stats_Callback, NULL);
+  start_Timer(&timer_Stats_Timer, TIMER_STATS_PERIOD_MS,
+              TIMER_STATS_PERIOD_MS);
 }
 
 void updateSystemTimer(int seconds) {
   // seconds = seconds / 2;
   if (label_ResetSystem == 1) {
-    timer_set_alarm_value(TIMER_GROUP_1, TIMER_0, seconds * TIMER_SCALE);
+    start_Timer(&health_Monitor_Timer, seconds * 1000, seconds * 1000);
   }
 }
 
@@ -104,143 +260,6 @@ void timer0_main_ctrl() {
   }
 }
 
-void interrupt_timer_group0_isr(void *para) {
-  toggle04 ^= 0x01;
-  // TIMERG0.hw_timer[0].update.tn_update = 1;
-  TIMERG0.int_clr_timers.t0_int_clr = 1;
-
-  xSemaphoreGiveFromISR(semaphore_ACT, NULL);
-
-  // TIMERG0.hw_timer[0].config.tn_alarm_en = 1;
-}
-
-void example_tg_timer_deinit(int group, int timer) {
-  ESP_ERROR_CHECK(timer_isr_callback_remove(group, timer));
-  ESP_ERROR_CHECK(timer_deinit(group, timer));
-}
-
-static void init_tg0_timer0() {
-  int timer_group = TIMER_GROUP_0;
-  int timer_idx = TIMER_0;
-
-  // Configure timer
-  timer_config_t config;
-  config.alarm_en = 1;
-  config.auto_reload = 1;
-  config.counter_dir = TIMER_COUNT_UP;
-  config.divider = TIMER_DIVIDER;
-  config.intr_type = TIMER_INTR_SEL;
-  config.counter_en = TIMER_PAUSE;
-  config.clk_src = TIMER_SRC_CLK_APB;
-
-  timer_init(timer_group, timer_idx, &config);
-
-  timer_pause(timer_group, timer_idx);
-
-  update_ACT_TimerVAlue(RSSI_NOT_DETECT);
-  timer_enable_intr(timer_group, timer_idx);
-  timer_isr_register(timer_group, timer_idx, interrupt_timer_group0_isr,
-                     (void *)timer_idx, ESP_INTR_FLAG_LOWMED, NULL);
-  // timer_pause(TIMER_GROUP_0, TIMER_0);
-  timer_start(TIMER_GROUP_0, TIMER_0);
-}
-
-static bool IRAM_ATTR timer_group_I1_Timeout_isr_callback(void *args) {
-  BaseType_t high_task_awoken = pdFALSE;
-  example_timer_info_t *info = (example_timer_info_t *)args;
-  //////printf("\n\n timer_group_I1_Timeout_isr_callback 1\n\n");
-  uint64_t timer_counter_value =
-      timer_group_get_counter_value_in_isr(info->timer_group, info->timer_idx);
-  //////printf("\n\n timer_group_I1_Timeout_isr_callback 2\n\n");
-
-  /* Prepare basic event data that will be then sent back to task */
-  example_timer_event_t evt = {.info.timer_group = info->timer_group,
-                               .info.timer_idx = info->timer_idx,
-                               .info.auto_reload = info->auto_reload,
-                               .info.alarm_interval = info->alarm_interval,
-                               .timer_counter_value = timer_counter_value};
-
-  if (!info->auto_reload) {
-    timer_counter_value += info->alarm_interval * TIMER_SCALE;
-    timer_group_set_alarm_value_in_isr(info->timer_group, info->timer_idx,
-                                       timer_counter_value);
-  }
-
-  /* Now just send the event data back to the main program task */
-  //////printf("\n\n timeout I1 %lld\n\n",timer_counter_value);
-  xQueueSendFromISR(alarm_I1_Timeout_queue, &evt, &high_task_awoken);
-  return high_task_awoken ==
-         pdTRUE; // return whether we need to yield at the end of ISR
-}
-
-static bool IRAM_ATTR
-timer_group_I2_Normal_Feedback_Timeout_isr_callback(void *args) {
-  BaseType_t high_task_awoken = pdFALSE;
-  example_timer_info_t *info = (example_timer_info_t *)args;
-  //////printf("\n\n timer_group_I1_Timeout_isr_callback 1\n\n");
-  uint64_t timer_counter_value =
-      timer_group_get_counter_value_in_isr(info->timer_group, info->timer_idx);
-  //////printf("\n\n timer_group_I1_Timeout_isr_callback 2\n\n");
-
-  /* Prepare basic event data that will be then sent back to task */
-  example_timer_event_t evt = {.info.timer_group = info->timer_group,
-                               .info.timer_idx = info->timer_idx,
-                               .info.auto_reload = info->auto_reload,
-                               .info.alarm_interval = info->alarm_interval,
-                               .timer_counter_value = timer_counter_value};
-
-  if (!info->auto_reload) {
-    timer_counter_value += info->alarm_interval * TIMER_SCALE;
-    timer_group_set_alarm_value_in_isr(info->timer_group, info->timer_idx,
-                                       timer_counter_value);
-  }
-
-  /* Now just send the event data back to the main program task */
-  //////printf("\n\n timeout I1 %lld\n\n",timer_counter_value);
-  xSemaphoreGive(rdySem_Timer_Input2_feedback_Timeout);
-  return high_task_awoken ==
-         pdTRUE; // return whether we need to yield at the end of ISR
-}
-
-void init_I1_Timeout_timer0() {
-  int group = TIMER_GROUP_0;
-  int timer = TIMER_0;
-
-  /* Select and initialize basic parameters of the timer */
-  timer_config_t config = {
-      .divider = TIMER_DIVIDER,
-      .counter_dir = TIMER_COUNT_UP,
-      .counter_en = TIMER_PAUSE,
-      .alarm_en = TIMER_ALARM_EN,
-      .auto_reload = 1,
-  }; // default clock source is APB
-  //////printf("\n\n timer_init I1 1\n\n");
-  timer_init(group, timer, &config);
-  //////printf("\n\n timer_init I1 2\n\n");
-  timer_set_counter_value(group, timer, 0);
-  //////printf("\n\n timer_init I1 3\n\n");
-
-  /* Configure the alarm value and the interrupt on alarm. */
-  timer_set_alarm_value(group, timer, 2 * TIMER_SCALE);
-  //////printf("\n\n timer_init I1 4\n\n");
-  timer_enable_intr(group, timer);
-  //////printf("\n\n timer_init I1 5\n\n");
-
-  example_timer_info_t *timer_info = calloc(1, sizeof(example_timer_info_t));
-  timer_info->timer_group = group;
-  timer_info->timer_idx = timer;
-  timer_info->auto_reload = true;
-  timer_info->alarm_interval = 2;
-  timer_isr_callback_add(group, timer, timer_group_I1_Timeout_isr_callback,
-                         timer_info, 0);
-
-  //////printf("\n\n timer_init I1 6\n\n");
-  //  timer_pause(TIMER_GROUP_0, TIMER_0);
-  timer_start(group, timer);
-
-  //////printf("\n\n timer_init I1 7\n\n");
-}
-
 void update_ACT_TimerVAlue(double seconds) {
   seconds = seconds * 1000;
   // seconds = 2000;
@@ -260,146 +279,6 @@ void update_ACT_TimerVAlue(double seconds) {
   // TIMER_SCALE);
 }
 
-static bool IRAM_ATTR timer_group_isr_callback(void *args) {
-  BaseType_t high_task_awoken = pdFALSE;
-  example_timer_info_t *info = (example_timer_info_t *)args;
-
-  uint64_t timer_counter_value =
-      timer_group_get_counter_value_in_isr(info->timer_group, info->timer_idx);
-
-  /* Prepare basic event data that will be then sent back to task */
-  example_timer_event_t evt = {.info.timer_group = info->timer_group,
-                               .info.timer_idx = info->timer_idx,
-                               .info.auto_reload = info->auto_reload,
-                               .info.alarm_interval = info->alarm_interval,
-                               .timer_counter_value = timer_counter_value};
-
-  if (!info->auto_reload) {
-    timer_counter_value += info->alarm_interval * TIMER_SCALE;
-    timer_group_set_alarm_value_in_isr(info->timer_group, info->timer_idx,
-                                       timer_counter_value);
-  }
-
-  /* Now just send the event data back to the main program task */
-  xQueueSendFromISR(s_timer_queue, &evt, &high_task_awoken);
-
-  return high_task_awoken ==
-         pdTRUE; // return whether we need to yield at the end of ISR
-}
-
-static bool IRAM_ATTR
-timer_group_Reset_System_OR_Password_isr_callback(void *args) {
-  BaseType_t high_task_awoken = pdFALSE;
-  example_timer_info_t *info = (example_timer_info_t *)args;
-
-  uint64_t timer_counter_value =
-      timer_group_get_counter_value_in_isr(info->timer_group, info->timer_idx);
-
-  /* Prepare basic event data that will be then sent back to task */
-  example_timer_event_t evt = {.info.timer_group = info->timer_group,
-                               .info.timer_idx = info->timer_idx,
-                               .info.auto_reload = info->auto_reload,
-                               .info.alarm_interval = info->alarm_interval,
-                               .timer_counter_value = timer_counter_value};
-
-  if (!info->auto_reload) {
-    timer_counter_value += info->alarm_interval * TIMER_SCALE;
-    timer_group_set_alarm_value_in_isr(info->timer_group, info->timer_idx,
-                                       timer_counter_value);
-  }
-
-  /* Now just send the event data back to the main program task */
-  //xTaskCreate(&task_Reset_Password_System_Timeout,
-             // "task_Reset_Password_System_Timeout", 8000, NULL, 20,
-              //&xHandle_Timer_Reset_PSW_SYS);
-
-  return high_task_awoken ==
-         pdTRUE; // return whether we need to yield at the end of ISR
-}
-
-/*
- * A simple helper function to print the raw timer counter value
- * and the counter value converted to seconds
- */
-static void inline print_timer_counter(uint64_t counter_value) {
-  //////printf("Counter: 0x%08x%08x\r\n", (uint32_t)(counter_value >>
-  ///32),(uint32_t)(counter_value));
-
-  //////printf("Time   : %.8f s\r\n", (double)counter_value / TIMER_SCALE);
-}
-
-/**
- * @brief Initialize selected timer of timer group
- *
- * @param group Timer Group number, index from 0
- * @param timer timer ID, index from 0
- * @param auto_reload whether auto-reload on alarm event
- * @param timer_interval_sec interval of alarm
- */
-void example_tg_timer_init(int group, int timer, bool auto_reload,
-                           int timer_interval_sec) {
-  /* uint32_t clk_src_hz = 0;
- esp_clk_tree_src_get_freq_hz((soc_module_clk_t)TIMER_SRC_CLK_DEFAULT,
- ESP_CLK_TREE_SRC_FREQ_PRECISION_CACHED, &clk_src_hz); */
-
-  timer_config_t config = {
-      .divider = TIMER_DIVIDER,
-      .counter_dir = TIMER_COUNT_UP,
-      .counter_en = TIMER_PAUSE,
-      .alarm_en = TIMER_ALARM_EN,
-      .auto_reload = auto_reload,
-      .clk_src = TIMER_SRC_CLK_APB,
-  }; // default clock source is APB
-  timer_init(group, timer, &config);
-
-  /* Timer's counter will initially start from value below.
-     Also, if auto_reload is set, this value will be automatically reload on
-     alarm */
-  timer_set_counter_value(group, timer, 0);
-
-  /* Configure the alarm value and the interrupt on alarm. */
-  /* timer_set_alarm_value(group, timer, timer_interval_sec * TIMER_SCALE);
-  timer_enable_intr(group, timer); */
-
-  example_timer_info_t *timer_info = calloc(1, sizeof(example_timer_info_t));
-  timer_info->timer_group = group;
-  timer_info->timer_idx = timer;
-  timer_info->auto_reload = auto_reload;
-  timer_info->alarm_interval = timer_interval_sec;
-
-  if (group == TIMER_GROUP_0) {
-    if (timer == TIMER_0) {
-      timer_set_alarm_value(group, timer, timer_interval_sec * TIMER_SCALE);
-      timer_enable_intr(group, timer);
-      timer_isr_callback_add(group, timer,
-                             timer_group_Reset_System_OR_Password_isr_callback,
-                             timer_info, 0);
-      timer_start(group, timer);
-    } else if (timer == TIMER_1) {
-      timer_set_alarm_value(group, timer, timer_interval_sec * TIMER_SCALE);
-      timer_enable_intr(group, timer);
-      timer_isr_callback_add(
-          group, timer, timer_group_I2_Normal_Feedback_Timeout_isr_callback,
-          timer_info, 0);
-      timer_start(group, timer);
-    }
-  } else if (group == TIMER_GROUP_1) {
-    if (timer == TIMER_0) {
-      timer_set_alarm_value(group, timer, timer_interval_sec * TIMER_SCALE);
-      timer_enable_intr(group, timer);
-      timer_isr_callback_add(group, timer, timer_group_isr_callback, timer_info,
-                             0);
-      timer_start(group, timer);
-    } else if (timer == TIMER_1) {
-      timer_set_alarm_value(group, timer, timer_interval_sec * TIMER_SCALE);
-      timer_enable_intr(group, timer);
-      timer_isr_callback_add(group, timer, timer_group_I1_Timeout_isr_callback,
-                             timer_info, 0);
-      timer_start(group, timer);
-    }
-  }
-}
-
 void periodic_timer_callback(void *arg) {
   // uint8_t ACK = 0;
 
@@ -430,8 +309,6 @@ void task_Reset_Password_System_Timeout(void *pvParameter) {
     label_ResetSystem = 1;
     printf("\n\nlabel_ResetSystem == 012345\n\n");
     // ////printf("\n\nlabel_ResetSystem == asdfg\n\n");
-    example_tg_timer_deinit(TIMER_GROUP_0, TIMER_0);
-    // ////printf("\n\nlabel_ResetSystem == 54321\n\n");
 
     if (gpio_get_level(GPIO_INPUT_IO_SIMPRE)) {
       if (gpio_get_level(GPIO_INPUT_IO_EG91_STATUS)) {
@@ -440,8 +317,7 @@ void task_Reset_Password_System_Timeout(void *pvParameter) {
       }
     }
 
-    xTaskCreate(&task_VerifySystem, "task_VerifySystem", 4 * 2048 + 2048, NULL,
-                /* 5 */ 31, &xHandle_Timer_VerSystem);
+    health_Recovery_Enabled = 1;
     update_ACT_TimerVAlue(3);
     label_Reset_Password_OR_System = 2;
     label_initSystem_CALL = 1;
@@ -449,14 +325,11 @@ void task_Reset_Password_System_Timeout(void *pvParameter) {
     printf("\n\nlabel_ResetSystem == 1\n\n");
     // label_ResetSystem = 2;
 
-    example_tg_timer_deinit(TIMER_GROUP_0, TIMER_0);
-
     if (gpio_get_level(GPIO_INPUT_IO_SIMPRE)) {
       EG91_send_AT_Command(AT_CSQ, "CSQ", 1000);
     }
 
-    xTaskCreate(&task_VerifySystem, "task_VerifySystem", 4 * 2048 + 2048, NULL,
-                /* 5  */ 31, &xHandle_Timer_VerSystem);
+    health_Recovery_Enabled = 1;
     update_ACT_TimerVAlue(3);
     label_Reset_Password_OR_System = 2;
     label_initSystem_CALL = 1;
@@ -497,276 +370,215 @@ void task_Reset_Password_System_Timeout(void *pvParameter) {
 }
 
 
-void task_VerifySystem(void *pvParameter) {
-  example_timer_event_t evt;
-  while (1) {
+static void sample_Health_Metrics(health_metrics *metrics) {
+  metrics->uptime_s = esp_timer_get_time() / 1000000;
+  metrics->heap_free = esp_get_free_heap_size();
+  metrics->heap_min = esp_get_minimum_free_heap_size();
+  metrics->heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
 
-    xQueueReceive(s_timer_queue, &evt, portMAX_DELAY);
-    // take_rdySem_Control_SMS_UDP();
-
-    printf("Task  State   Prio    Stack    Num\n");
-
-    if (get_INT8_Data_From_Storage(NVS_QMT_LARGE_DATA_TIMER_LABEL,
-                                   nvs_System_handle) != 1) {
-      /* code */
-
-      if (gpio_get_level(GPIO_INPUT_IO_SIMPRE)) {
-        if (!gpio_get_level(GPIO_INPUT_IO_EG91_STATUS)) {
-          gpio_set_level(GPIO_OUTPUT_ACT, 1);
-          uint8_t pwrFD = 0;
-          uint8_t pwrFD_count = 0;
-
-          while (pwrFD != 1) {
-            if (pwrFD_count == 3 || pwrFD == 1) {
-              break;
-            }
-            pwrFD_count++;
-
-            pwrFD = EG91_PowerOn();
-          }
-          uint8_t InitNetworkCount = 0;
-
-          // TODO: TROCAR ESTE IF e retirar o delay
-          vTaskDelay(pdMS_TO_TICKS(750));
-
-          //////printf("\n\nSIMPRE INIT NETWORK\n\n");
-          while (InitNetworkCount < 3) {
-
-            if (!EG91_initNetwork()) {
-              // update_ACT_TimerVAlue((double)RSSI_NOT_DETECT);
-              InitNetworkCount++;
-              EG91_send_AT_Command("AT+CSDH=1", "OK", 1000);
-
-              EG91_send_AT_Command("AT+QCFG=\"urc/ri/other\",\"off\"", "OK",
-                                   1000);
-            } else {
-              break;
-            }
-          }
-        } else {
-          if (check_IF_System_Have_SIM_and_PIN() == 2) {
-
-            // send_UDP_Package("char* data",strlen("char* data"));
-
-            label_timerVerifySystem = 1;
-            //////printf("\n------- EVENT TIME --------\n");
-            print_timer_counter(evt.timer_counter_value);
-
-            /* Print the timer values as visible by this task */
-            // ////printf("-------- TASK TIME --------\n");
-            uint64_t task_counter_value;
-            timer_get_counter_value(evt.info.timer_group, evt.info.timer_idx,
-                                    &task_counter_value);
-            print_timer_counter(task_counter_value);
-            ESP_LOGI("TAG", "xPortGetFreeHeapSize            : %d",
-                     xPortGetFreeHeapSize());
-            ESP_LOGI("TAG", "esp_get_minimum_free_heap_size  : %d",
-                     esp_get_minimum_free_heap_size());
-            ESP_LOGI("TAG", "heap_caps_get_largest_free_block: %zu",
-                     heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
-            ESP_LOGI("TAG", "free heap memory                : %zu",
-                     heap_caps_get_free_size(MALLOC_CAP_8BIT));
-            // TODO: DESCOMENTAR LINHA A BAIXO
-            verify_System();
-          } else {
-            // ////printf("-------- TASK TIME 000111--------\n");
-            RSSI_LED_TOOGLE = RSSI_NOT_DETECT;
-
-            gpio_set_level(GPIO_OUTPUT_ACT, 1);
-            update_ACT_TimerVAlue((double)RSSI_NOT_DETECT);
-          }
-        }
-      } else {
-
-        if (check_IF_System_Have_SIM_and_PIN() == 2) {
-
-          label_timerVerifySystem = 1;
-          //////printf("\n------- EVENT TIME --------\n");
-          print_timer_counter(evt.timer_counter_value);
-
-          /* Print the timer values as visible by this task */
-          //////printf("-------- TASK TIME --------\n");
-          uint64_t task_counter_value;
-          timer_get_counter_value(evt.info.timer_group, evt.info.timer_idx,
-                                  &task_counter_value);
-          print_timer_counter(task_counter_value);
-          // ESP_LOGI("TAG", "xPortGetFreeHeapSize            : %d",
-          // xPortGetFreeHeapSize()); ESP_LOGI("TAG",
-          // "esp_get_minimum_free_heap_size  : %d",
-          // esp_get_minimum_free_heap_size()); ESP_LOGI("TAG",
-          // "heap_caps_get_largest_free_block: %d",
-          // heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
-          // ESP_LOGI("TAG", "free heap memory                : %d",
-          // heap_caps_get_free_size(MALLOC_CAP_8BIT));
-          //  TODO: DESCOMENTAR LINHA A BAIXO
-          //  verify_System();
-        } else {
-          RSSI_LED_TOOGLE = RSSI_NOT_DETECT;
-
-          gpio_set_level(GPIO_OUTPUT_ACT, 1);
-          update_ACT_TimerVAlue((double)RSSI_NOT_DETECT);
-        }
-      }
+  metrics->tasks = sizeof(health_Tasks) / sizeof(health_Tasks[0]);
 
-      ESP_LOGI("TAG", "xPortGetFreeHeapSize            : %d",
-               xPortGetFreeHeapSize());
-      ESP_LOGI("TAG", "esp_get_minimum_free_heap_size  : %d",
-               esp_get_minimum_free_heap_size());
-      ESP_LOGI("TAG", "heap_caps_get_largest_free_block: %zu",
-               heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
-      ESP_LOGI("TAG", "free heap memory                : %zu",
-               heap_caps_get_free_size(MALLOC_CAP_8BIT));
-      //}
-
-      //////printf("\n\ntask_VerifySystem\n\n");
-      label_timerVerifySystem = 0;
-      // give_rdySem_Control_SMS_UDP();
-      //   timer_start(TIMER_GROUP_1, TIMER_0);
-    }
+  for (uint8_t i = 0; i < metrics->tasks; i++) {
+    UBaseType_t free_stack = *health_Tasks[i] != NULL
+                                 ? uxTaskGetStackHighWaterMark(*health_Tasks[i])
+                                 : UINT16_MAX;
+
+    metrics->stack_free[i] = free_stack > UINT16_MAX ? UINT16_MAX : free_stack;
   }
+
+  metrics->queues = get_EG91_Queue_Levels(
+      metrics->queue_depth, metrics->queue_space, HEALTH_QUEUES_MAX);
+
+  metrics->sim_present = gpio_get_level(GPIO_INPUT_IO_SIMPRE);
+  metrics->modem_on = gpio_get_level(GPIO_INPUT_IO_EG91_STATUS);
+  metrics->sim_ready = SIM_CARD_PIN_status;
+  metrics->network_ok = health_Network_Ok;
+  metrics->rssi = RSSI_VALUE;
+  metrics->qmtstat = get_Runtime_QMTSTAT();
+  metrics->mqtt_connected = mqtt_connectLabel;
+  metrics->busy = runtime_Status.qmt_large_data == 1;
+  metrics->nvs_writes = get_NVS_Write_Counter();
+  metrics->journal_writes_hour = get_State_Journal_Writes_Per_Hour();
 }
 
+/* lotes de SMS lidos, SMS tratados, duplicados e maior backlog */
+static void append_SMS_Batch_Stats(char *report, size_t size, int used) {
+  sms_batch_stats sms;
 
-uint8_t qmtstat_verifyCounter = 0;
+  if (used < 0 || (size_t)used >= size) {
+    return;
+  }
 
-uint8_t verify_System() {
-  uint8_t ACK = 0;
-  uint8_t verifyCount = 0;
-  uint8_t qmtstatValue =
-      get_INT8_Data_From_Storage(NVS_QMTSTAT_LABEL, nvs_System_handle);
-  //////printf("\n\n\n\n verify_System - %d\n\n\n\n", qmtstat_verifyCounter);
+  get_SMS_Batch_Stats(&sms);
+  snprintf(report + used, size - used, ".%lu.%lu.%lu.%u",
+           (unsigned long)sms.batches, (unsigned long)sms.processed,
+           (unsigned long)sms.duplicates, sms.max_backlog);
+}
 
-  if (qmtstat_verifyCounter == 3) {
-    /* code */
+/* amostra propria, pode ser pedida antes de o monitor arrancar */
+void get_Health_Report(char *report, size_t size) {
+  health_metrics metrics;
+  health_state state;
+  int used;
 
-    switch (qmtstatValue) {
+  sample_Health_Metrics(&metrics);
 
-    case 0:
-      qmtstat_verifyCounter = 0;
-      break;
+  /* a tarefa de recuperacao muda o estado com o mutex; antes do init o
+     mutex ainda nao existe e so ha o estado inicial */
+  if (health_Mutex != NULL) {
+    xSemaphoreTake(health_Mutex, portMAX_DELAY);
+    state = health_Recovery.state;
+    xSemaphoreGive(health_Mutex);
+  } else {
+    state = health_Recovery.state;
+  }
 
-    case 1:
+  used = health_Format(&metrics, health_Check(&metrics, &health_Thresholds),
+                       state, report, size);
+  append_SMS_Batch_Stats(report, size, used);
+}
 
-      if (init_UDP_socket() == 2) {
-        mqtt_openLabel = 1;
-        mqtt_connectLabel = 1;
-        register_UDP_Device();
-        save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 0, nvs_System_handle);
-        qmtstat_verifyCounter = 0;
-      } else {
-        mqtt_openLabel = 0;
-        mqtt_connectLabel = 0;
-        save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 1, nvs_System_handle);
-        qmtstat_verifyCounter = 0;
-      }
-      break;
-
-    case 2:
-
-      EG91_Power_Reset();
-      EG91_initNetwork();
-      qmtstat_verifyCounter = 0;
-      /* save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 0, nvs_System_handle);
-      qmtstat_verifyCounter = 0; */
-      break;
-
-    case 6:
-
-      if (init_UDP_socket() == 2) {
-        mqtt_openLabel = 1;
-        mqtt_connectLabel = 1;
-        register_UDP_Device();
-        save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 0, nvs_System_handle);
-        qmtstat_verifyCounter = 0;
-      } else {
-        mqtt_openLabel = 0;
-        mqtt_connectLabel = 0;
-        save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 6, nvs_System_handle);
-        qmtstat_verifyCounter = 0;
-      }
-      break;
-
-    case 4:
-
-      if (reopen_and_connection()) {
-        mqtt_openLabel = 1;
-        mqtt_connectLabel = 1;
-        register_UDP_Device();
-        save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 0, nvs_System_handle);
-        qmtstat_verifyCounter = 0;
-      } else {
-        mqtt_openLabel = 0;
-        mqtt_connectLabel = 0;
-        save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 4, nvs_System_handle);
-        qmtstat_verifyCounter = 0;
-      }
-      break;
-    case 8:
-
-      if (init_UDP_socket() == 2) {
-        mqtt_openLabel = 1;
-        mqtt_connectLabel = 1;
-        register_UDP_Device();
-        save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 0, nvs_System_handle);
-        qmtstat_verifyCounter = 0;
-      } else {
-        mqtt_openLabel = 0;
-        mqtt_connectLabel = 0;
-        save_INT8_Data_In_Storage(NVS_QMTSTAT_LABEL, 8, nvs_System_handle);
-        qmtstat_verifyCounter = 0;
-      }
+static void show_No_SIM() {
+  RSSI_LED_TOOGLE = RSSI_NOT_DETECT;
 
-      break;
+  gpio_set_level(GPIO_OUTPUT_ACT, 1);
+  update_ACT_TimerVAlue((double)RSSI_NOT_DETECT);
+}
 
-    default:
-      qmtstat_verifyCounter = 0;
-      break;
-    }
-  } else {
-    qmtstat_verifyCounter++;
+static uint8_t open_MQTT(uint8_t reopen) {
+  if (reopen ? reopen_and_connection() : init_UDP_socket() == 2) {
+    mqtt_openLabel = 1;
+    mqtt_connectLabel = 1;
+    register_UDP_Device();
+    set_Runtime_QMTSTAT(0);
+    return 1;
   }
 
-  while (verifyCount < 3) {
-    ACK = check_NetworkState();
-    // ////printf("\n\n ACK check_NetworkState - %d\n\n",ACK);
+  mqtt_openLabel = 0;
+  mqtt_connectLabel = 0;
+  return 0;
+}
 
-    if (ACK != 2 || ACK != 3) {
-      break;
+/* 1 se a acao correu bem */
+static uint8_t run_Health_Action(health_action action) {
+  uint8_t ack = 0;
+
+  switch (action) {
+  case HEALTH_ACTION_NO_SIM:
+    show_No_SIM();
+    return 1;
+
+  case HEALTH_ACTION_MODEM_POWER_ON:
+    gpio_set_level(GPIO_OUTPUT_ACT, 1);
+    return EG91_PowerOn() == 1;
+
+  case HEALTH_ACTION_MODEM_INIT_NETWORK:
+    if (EG91_initNetwork()) {
+      return 1;
     }
 
-    verifyCount++;
-    vTaskDelay(pdMS_TO_TICKS(1000));
-  }
+    EG91_send_AT_Command("AT+CSDH=1", "OK", 1000);
+    EG91_send_AT_Command("AT+QCFG=\"urc/ri/other\",\"off\"", "OK", 1000);
+    return 0;
 
-  // ACK = check_NetworkState();
-  //////printf("\n\ncheck_NetworkState - %d\n\n", ACK);
-  //////printf("\n\n network check = %d\n\n", ACK);
-  if (ACK == 2 || ACK == 3) {
-
-    // ////printf("\n\n ACK check_NetworkState fail - %d\n\n",ACK);
-    if (NetworkFail_Counter == 3) {
-      NetworkFail_Counter = 0;
-      EG91_Power_Reset();
-      EG91_initNetwork();
-    } else {
-      NetworkFail_Counter++;
-      update_ACT_TimerVAlue((double)RSSI_VERY_WEAK_LED_TIME);
-      // updateSystemTimer(SYSTEM_TIMER_URGENT_STATE);
+  case HEALTH_ACTION_MODEM_RESET:
+    EG91_Power_Reset();
+    EG91_initNetwork();
+    return 1;
+
+  case HEALTH_ACTION_PROBE_SIM:
+    if (!EG91_Check_IF_Have_PIN()) {
+      show_No_SIM();
+      return 0;
+    }
+    return 1;
+
+  case HEALTH_ACTION_PROBE_NETWORK:
+    ack = check_NetworkState();
+    health_Network_Ok = ack != 2 && ack != 3;
+
+    if (health_Network_Ok && get_Runtime_QMTSTAT() != 0) {
+      RSSI_LED_TOOGLE = MQTT_NOT_CONECT_LED_TIME;
+      updateSystemTimer(SYSTEM_TIMER_ALARM_STATE);
     }
-  } else if (qmtstatValue != 0) {
-    RSSI_LED_TOOGLE = MQTT_NOT_CONECT_LED_TIME;
-    // update_ACT_TimerVAlue((double)RSSI_EXCELLENT_LED_TIME);
-    updateSystemTimer(SYSTEM_TIMER_ALARM_STATE);
+    return health_Network_Ok;
+
+  case HEALTH_ACTION_SIGNAL_WEAK:
+    update_ACT_TimerVAlue((double)RSSI_VERY_WEAK_LED_TIME);
+    return 1;
+
+  case HEALTH_ACTION_MQTT_OPEN:
+    return open_MQTT(0);
+
+  case HEALTH_ACTION_MQTT_REOPEN:
+    return open_MQTT(1);
+
+  default:
+    return 1;
   }
+}
 
-  // ESP_LOGI("TAG", "xPortGetFreeHeapSize            : %d",
-  // xPortGetFreeHeapSize()); ESP_LOGI("TAG", "esp_get_minimum_free_heap_size  :
-  // %d", esp_get_minimum_free_heap_size()); ESP_LOGI("TAG",
-  // "heap_caps_get_largest_free_block: %d",
-  // heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT)); ESP_LOGI("TAG",
-  // "free heap memory                : %d",
-  // heap_caps_get_free_size(MALLOC_CAP_8BIT));
-  return 1;
+static void publish_Health_Metrics(uint8_t breaches) {
+  char report[HEALTH_REPORT_MAX];
+  char *line = NULL;
+  int used;
+
+  xSemaphoreTake(health_Mutex, portMAX_DELAY);
+  used = health_Format(&health_Metrics, breaches, health_Recovery.state,
+                       report, sizeof(report));
+  xSemaphoreGive(health_Mutex);
+
+  append_SMS_Batch_Stats(report, sizeof(report), used);
+
+  asprintf(&line, "ME G Z %s", report);
+
+  if (line == NULL) {
+    return;
+  }
+
+  ESP_LOGW("HEALTH", "%s", line);
+
+  if (mqtt_connectLabel == 1) {
+    send_UDP_Send(line, "");
+  }
+
+  free(line);
+}
+
+void task_Health_Monitor(void *pvParameter) {
+  uint8_t breaches = 0;
+  uint8_t new_breaches = 0;
+  health_action action = HEALTH_ACTION_NONE;
+
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    tick_Runtime_Status_Snapshot();
+
+    xSemaphoreTake(health_Mutex, portMAX_DELAY);
+    sample_Health_Metrics(&health_Metrics);
+    breaches = health_Check(&health_Metrics, &health_Thresholds);
+    new_breaches = breaches & ~health_Breaches;
+    health_Breaches = breaches;
+    action = health_Recovery_Enabled
+                 ? health_Recovery_Step(&health_Recovery, &health_Metrics)
+                 : HEALTH_ACTION_NONE;
+    xSemaphoreGive(health_Mutex);
+
+    if (new_breaches) {
+      publish_Health_Metrics(breaches);
+    }
+
+    if (action != HEALTH_ACTION_NONE) {
+      label_timerVerifySystem = 1;
+      uint8_t ok = run_Health_Action(action);
+      label_timerVerifySystem = 0;
+
+      xSemaphoreTake(health_Mutex, portMAX_DELAY);
+      health_Recovery_Result(&health_Recovery, action, ok);
+      xSemaphoreGive(health_Mutex);
+    }
+  }
 }
 
 void List_Backup_File_Contacts() {
@@ -0,0 +1,199 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "timer_service.h"
+#include <string.h>
+
+static uint8_t in_Suspended_Group(const timer_service *service,
+                                  const timer_service_timer *timer) {
+  return timer->group < TIMER_SERVICE_GROUPS &&
+         ((service->suspended_groups >> timer->group) & 1);
+}
+
+/* a roda conta a partir do ultimo tick processado, que pode estar atras da
+   hora real se o servico esteve parado */
+static void arm_Timer(timer_service *service, timer_service_timer *timer,
+                      uint32_t delay, uint32_t now) {
+  uint32_t lag = now - service->wheel.now;
+
+  if ((int32_t)lag < 0) {
+    lag = 0;
+  }
+
+  timer_Wheel_Add(&service->wheel, &timer->wheel,
+                  delay > TIMER_WHEEL_MAX_DELAY - lag ? TIMER_WHEEL_MAX_DELAY
+                                                      : delay + lag);
+}
+
+static void timer_Service_Fire(timer_wheel_timer *wheel_timer, void *ctx) {
+  timer_service_timer *timer = (timer_service_timer *)wheel_timer;
+  timer_service *service = timer->service;
+  /* durante o callback da roda, wheel.now e a hora devida */
+  uint32_t due = service->wheel.now;
+  uint32_t late = service->now - due;
+
+  if ((int32_t)late < 0) {
+    late = 0;
+  }
+
+  if (timer->measuring && timer->period > 0) {
+    uint32_t interval = service->now - timer->last_fire;
+    uint32_t jitter =
+        interval > timer->period ? interval - timer->period
+                                 : timer->period - interval;
+
+    if (jitter > timer->jitter_max) {
+      timer->jitter_max = jitter;
+    }
+  }
+
+  timer->fires++;
+  timer->measuring = 1;
+  timer->last_fire = service->now;
+  timer->late_sum += late;
+  if (late > timer->late_max) {
+    timer->late_max = late;
+  }
+
+  /* os periodicos voltam a contar da hora devida, sem deriva */
+  if (timer->period > 0) {
+    uint32_t skipped = late / timer->period;
+
+    timer->missed += skipped;
+    timer_Wheel_Add(&service->wheel, &timer->wheel,
+                    (skipped + 1) * timer->period);
+  }
+
+  timer->callback(timer, timer->ctx);
+}
+
+void timer_Service_Init(timer_service *service, uint32_t now) {
+  memset(service, 0, sizeof(timer_service));
+  timer_Wheel_Init(&service->wheel, now);
+  service->now = now;
+}
+
+void timer_Service_Register(timer_service *service, timer_service_timer *timer,
+                            const char *name, uint8_t group,
+                            timer_service_callback callback, void *ctx) {
+  memset(timer, 0, sizeof(timer_service_timer));
+  timer_Wheel_Timer_Init(&timer->wheel, timer_Service_Fire, NULL);
+  timer->name = name;
+  timer->group = group;
+  timer->callback = callback;
+  timer->ctx = ctx;
+  timer->service = service;
+  timer->next_registered = service->timers;
+  service->timers = timer;
+}
+
+timer_service_timer *timer_Service_Find(timer_service *service,
+                                        const char *name) {
+  for (timer_service_timer *timer = service->timers; timer != NULL;
+       timer = timer->next_registered) {
+    if (timer->name != NULL && !strcmp(timer->name, name)) {
+      return timer;
+    }
+  }
+
+  return NULL;
+}
+
+void timer_Service_Start(timer_service *service, timer_service_timer *timer,
+                         uint32_t delay, uint32_t period, uint32_t now) {
+  timer_Wheel_Cancel(&service->wheel, &timer->wheel);
+  timer->period = period;
+  timer->measuring = 0;
+
+  if (in_Suspended_Group(service, timer)) {
+    timer->suspended = 1;
+    timer->remaining = delay;
+    return;
+  }
+
+  timer->suspended = 0;
+  arm_Timer(service, timer, delay, now);
+}
+
+void timer_Service_Stop(timer_service *service, timer_service_timer *timer) {
+  timer_Wheel_Cancel(&service->wheel, &timer->wheel);
+  timer->suspended = 0;
+  timer->period = 0;
+}
+
+uint8_t timer_Service_Is_Active(const timer_service_timer *timer) {
+  return timer->suspended || timer_Wheel_Is_Pending(&timer->wheel);
+}
+
+void timer_Service_Suspend_Group(timer_service *service, uint8_t group,
+                                 uint32_t now) {
+  if (group >= TIMER_SERVICE_GROUPS ||
+      ((service->suspended_groups >> group) & 1)) {
+    return;
+  }
+
+  service->suspended_groups |= 1 << group;
+
+  for (timer_service_timer *timer = service->timers; timer != NULL;
+       timer = timer->next_registered) {
+    if (timer->group != group || !timer_Wheel_Is_Pending(&timer->wheel)) {
+      continue;
+    }
+
+    uint32_t remaining = timer->wheel.expires - now;
+
+    timer->remaining = (int32_t)remaining > 0 ? remaining : 0;
+    timer->suspended = 1;
+    timer_Wheel_Cancel(&service->wheel, &timer->wheel);
+  }
+}
+
+void timer_Service_Resume_Group(timer_service *service, uint8_t group,
+                                uint32_t now) {
+  if (group >= TIMER_SERVICE_GROUPS ||
+      !((service->suspended_groups >> group) & 1)) {
+    return;
+  }
+
+  service->suspended_groups &= ~(1 << group);
+
+  for (timer_service_timer *timer = service->timers; timer != NULL;
+       timer = timer->next_registered) {
+    if (timer->group != group || !timer->suspended) {
+      continue;
+    }
+
+    timer->suspended = 0;
+    /* o intervalo em que esteve suspenso nao conta como jitter */
+    timer->measuring = 0;
+    arm_Timer(service, timer, timer->remaining, now);
+  }
+}
+
+void timer_Service_Advance(timer_service *service, uint32_t now) {
+  service->now = now;
+  service->wakeups++;
+  timer_Wheel_Advance(&service->wheel, now);
+}
+
+uint32_t timer_Service_Next(const timer_service *service, uint32_t now) {
+  uint32_t next = timer_Wheel_Next(&service->wheel);
+  uint32_t lag = now - service->wheel.now;
+
+  if (next == TIMER_WHEEL_NONE) {
+    return next;
+  }
+
+  if ((int32_t)lag <= 0) {
+    return next;
+  }
+
+  return next > lag ? next - lag : 0;
+}
@@ -0,0 +1,106 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _TIMER_SERVICE_H_
+#define _TIMER_SERVICE_H_
+
+#include "timer_wheel.h"
+#include <stdint.h>
+
+/*
+ * Servico de temporizadores com nome sobre a roda hierarquica
+ * (timer_wheel.h). Cada temporizador pode pertencer a um grupo; suspender
+ * o grupo guarda o tempo que falta a cada um e retoma-lo volta a arma-los,
+ * como o timer_pause/timer_start dos temporizadores de hardware. Os
+ * periodicos voltam a ser armados a partir da hora em que deviam ter
+ * disparado, por isso nao acumulam deriva; se o atraso passar um periodo
+ * os disparos perdidos sao contados e nao repetidos.
+ *
+ * Para cada temporizador fica o numero de disparos, o atraso (hora real
+ * do disparo menos a hora devida) medio e maximo e, nos periodicos, o
+ * jitter maximo entre disparos seguidos.
+ *
+ * As funcoes recebem a hora atual na unidade do chamador (no equipamento
+ * ms); os atrasos vem na mesma unidade. Sem trincos e sem FreeRTOS, como a
+ * roda.
+ */
+
+#define TIMER_SERVICE_NO_GROUP 0xFF
+#define TIMER_SERVICE_GROUPS 8
+
+typedef struct timer_service_timer timer_service_timer;
+
+typedef void (*timer_service_callback)(timer_service_timer *timer, void *ctx);
+
+struct timer_service_timer
+{
+  /* primeiro campo, o callback da roda converte o ponteiro */
+  timer_wheel_timer wheel;
+  const char *name;
+  uint8_t group;
+  uint8_t suspended;
+  /* ha um disparo anterior para medir o jitter */
+  uint8_t measuring;
+  uint32_t period;
+  uint32_t remaining;
+  timer_service_callback callback;
+  void *ctx;
+  struct timer_service *service;
+  timer_service_timer *next_registered;
+
+  uint32_t fires;
+  uint32_t missed;
+  uint32_t last_fire;
+  uint32_t late_max;
+  uint64_t late_sum;
+  uint32_t jitter_max;
+};
+
+typedef struct timer_service
+{
+  timer_wheel wheel;
+  /* hora real passada ao ultimo timer_Service_Advance */
+  uint32_t now;
+  uint8_t suspended_groups;
+  uint32_t wakeups;
+  timer_service_timer *timers;
+
+} timer_service;
+
+void timer_Service_Init(timer_service *service, uint32_t now);
+
+void timer_Service_Register(timer_service *service, timer_service_timer *timer,
+                            const char *name, uint8_t group,
+                            timer_service_callback callback, void *ctx);
+
+timer_service_timer *timer_Service_Find(timer_service *service,
+                                        const char *name);
+
+/* period 0 = uma vez; volta a armar se ja estava armado */
+void timer_Service_Start(timer_service *service, timer_service_timer *timer,
+                         uint32_t delay, uint32_t period, uint32_t now);
+
+void timer_Service_Stop(timer_service *service, timer_service_timer *timer);
+
+/* armado ou suspenso a espera do grupo */
+uint8_t timer_Service_Is_Active(const timer_service_timer *timer);
+
+void timer_Service_Suspend_Group(timer_service *service, uint8_t group,
+                                 uint32_t now);
+
+void timer_Service_Resume_Group(timer_service *service, uint8_t group,
+                                uint32_t now);
+
+void timer_Service_Advance(timer_service *service, uint32_t now);
+
+/* tempo ate ao proximo disparo a contar de now ou TIMER_WHEEL_NONE */
+uint32_t timer_Service_Next(const timer_service *service, uint32_t now);
+
+#endif
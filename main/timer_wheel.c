@@ -0,0 +1,233 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#include "timer_wheel.h"
+#include <string.h>
+
+_Static_assert(TIMER_WHEEL_L0_SIZE % 64 == 0 && TIMER_WHEEL_LN_SIZE == 64,
+               "os niveis tem de alinhar com as palavras do mapa");
+
+static uint16_t wheel_Slot(uint32_t expires, uint32_t base, uint8_t *level) {
+  uint32_t delay = expires - base;
+  uint8_t shift = TIMER_WHEEL_L0_BITS;
+
+  if (delay < TIMER_WHEEL_L0_SIZE) {
+    *level = 0;
+    return expires & (TIMER_WHEEL_L0_SIZE - 1);
+  }
+
+  for (uint8_t i = 1; i < TIMER_WHEEL_LEVELS - 1; i++) {
+    if (delay < (1UL << (shift + TIMER_WHEEL_LN_BITS))) {
+      break;
+    }
+    shift += TIMER_WHEEL_LN_BITS;
+  }
+
+  *level = 1 + (shift - TIMER_WHEEL_L0_BITS) / TIMER_WHEEL_LN_BITS;
+  return TIMER_WHEEL_L0_SIZE + (*level - 1) * TIMER_WHEEL_LN_SIZE +
+         ((expires >> shift) & (TIMER_WHEEL_LN_SIZE - 1));
+}
+
+static void wheel_Insert(timer_wheel *wheel, timer_wheel_timer *timer,
+                         uint32_t base) {
+  timer_wheel_timer **slot = NULL;
+
+  timer->slot = wheel_Slot(timer->expires, base, &timer->level);
+  slot = &wheel->slots[timer->slot];
+
+  timer->next = *slot;
+  if (timer->next != NULL) {
+    timer->next->pprev = &timer->next;
+  }
+  *slot = timer;
+  timer->pprev = slot;
+  wheel->occupied[timer->slot / 64] |= 1ULL << (timer->slot % 64);
+  wheel->pending[timer->level]++;
+}
+
+static void wheel_Unlink(timer_wheel *wheel, timer_wheel_timer *timer) {
+  *timer->pprev = timer->next;
+  if (timer->next != NULL) {
+    timer->next->pprev = timer->pprev;
+  }
+  if (wheel->slots[timer->slot] == NULL) {
+    wheel->occupied[timer->slot / 64] &= ~(1ULL << (timer->slot % 64));
+  }
+  timer->next = NULL;
+  timer->pprev = NULL;
+  wheel->pending[timer->level]--;
+}
+
+/* primeira ranhura ocupada a partir de from, dando a volta ao nivel */
+static int16_t wheel_First(const uint64_t *map, uint16_t size, uint16_t from) {
+  uint16_t words = size / 64;
+  uint16_t word = from / 64;
+  uint64_t bits = map[word] & (~0ULL << (from % 64));
+
+  for (uint16_t i = 0; i <= words; i++) {
+    if (bits != 0) {
+      return word * 64 + __builtin_ctzll(bits);
+    }
+    word = (word + 1) % words;
+    bits = map[word];
+  }
+
+  return -1;
+}
+
+/* desce a ranhura do nivel que corresponde ao tick t, relativa a t */
+static void wheel_Cascade(timer_wheel *wheel, uint8_t level, uint32_t t) {
+  uint8_t shift = TIMER_WHEEL_L0_BITS + (level - 1) * TIMER_WHEEL_LN_BITS;
+  timer_wheel_timer **slot =
+      &wheel->slots[TIMER_WHEEL_L0_SIZE + (level - 1) * TIMER_WHEEL_LN_SIZE +
+                    ((t >> shift) & (TIMER_WHEEL_LN_SIZE - 1))];
+  timer_wheel_timer *timer = NULL;
+
+  while ((timer = *slot) != NULL) {
+    wheel_Unlink(wheel, timer);
+    wheel_Insert(wheel, timer, t);
+  }
+}
+
+static uint16_t wheel_Pending(const timer_wheel *wheel) {
+  uint16_t count = 0;
+
+  for (uint8_t i = 0; i < TIMER_WHEEL_LEVELS; i++) {
+    count += wheel->pending[i];
+  }
+
+  return count;
+}
+
+void timer_Wheel_Init(timer_wheel *wheel, uint32_t now) {
+  memset(wheel, 0, sizeof(timer_wheel));
+  wheel->now = now;
+}
+
+void timer_Wheel_Timer_Init(timer_wheel_timer *timer,
+                            timer_wheel_callback callback, void *ctx) {
+  memset(timer, 0, sizeof(timer_wheel_timer));
+  timer->callback = callback;
+  timer->ctx = ctx;
+}
+
+void timer_Wheel_Add(timer_wheel *wheel, timer_wheel_timer *timer,
+                     uint32_t delay) {
+  if (timer->pprev != NULL) {
+    wheel_Unlink(wheel, timer);
+  }
+
+  if (delay == 0) {
+    delay = 1;
+  } else if (delay > TIMER_WHEEL_MAX_DELAY) {
+    delay = TIMER_WHEEL_MAX_DELAY;
+  }
+
+  timer->expires = wheel->now + delay;
+  wheel_Insert(wheel, timer, wheel->now);
+}
+
+void timer_Wheel_Cancel(timer_wheel *wheel, timer_wheel_timer *timer) {
+  if (timer->pprev != NULL) {
+    wheel_Unlink(wheel, timer);
+  }
+}
+
+uint8_t timer_Wheel_Is_Pending(const timer_wheel_timer *timer) {
+  return timer->pprev != NULL;
+}
+
+uint32_t timer_Wheel_Remaining(const timer_wheel *wheel,
+                               const timer_wheel_timer *timer) {
+  return timer->pprev != NULL ? timer->expires - wheel->now : 0;
+}
+
+void timer_Wheel_Advance(timer_wheel *wheel, uint32_t now) {
+  while ((int32_t)(now - wheel->now) > 0) {
+    uint32_t t = wheel->now + 1;
+
+    if (wheel_Pending(wheel) == 0) {
+      wheel->now = now;
+      return;
+    }
+
+    /* nivel 0 vazio: nada dispara antes da proxima volta */
+    if (wheel->pending[0] == 0) {
+      t = (wheel->now | (TIMER_WHEEL_L0_SIZE - 1)) + 1;
+
+      if ((int32_t)(now - t) < 0) {
+        wheel->now = now;
+        return;
+      }
+    }
+
+    wheel->now = t;
+
+    if ((t & (TIMER_WHEEL_L0_SIZE - 1)) == 0) {
+      uint8_t level = 1;
+
+      while (level < TIMER_WHEEL_LEVELS - 1 &&
+             (t & ((1UL << (TIMER_WHEEL_L0_BITS +
+                            level * TIMER_WHEEL_LN_BITS)) -
+                   1)) == 0) {
+        level++;
+      }
+
+      /* do nivel mais alto para o mais baixo */
+      for (; level >= 1; level--) {
+        wheel_Cascade(wheel, level, t);
+      }
+    }
+
+    timer_wheel_timer **slot = &wheel->slots[t & (TIMER_WHEEL_L0_SIZE - 1)];
+    timer_wheel_timer *timer = NULL;
+
+    /* um de cada vez, o callback pode cancelar outro da mesma ranhura */
+    while ((timer = *slot) != NULL) {
+      wheel_Unlink(wheel, timer);
+      timer->callback(timer, timer->ctx);
+    }
+  }
+}
+
+uint32_t timer_Wheel_Next(const timer_wheel *wheel) {
+  uint32_t next = TIMER_WHEEL_NONE;
+  uint8_t shift = TIMER_WHEEL_L0_BITS;
+  int16_t slot = -1;
+
+  /* no nivel 0 cada ranhura tem um so tick de disparo */
+  if (wheel->pending[0] > 0) {
+    slot = wheel_First(wheel->occupied, TIMER_WHEEL_L0_SIZE,
+                       (wheel->now + 1) & (TIMER_WHEEL_L0_SIZE - 1));
+    next = (slot - wheel->now) & (TIMER_WHEEL_L0_SIZE - 1);
+  }
+
+  /* acima a ranhura seguinte a atual e a mais proxima, a propria ranhura
+     atual so tem temporizadores de daqui a uma volta inteira */
+  for (uint8_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+    uint16_t base = TIMER_WHEEL_L0_SIZE + (level - 1) * TIMER_WHEEL_LN_SIZE;
+
+    if (wheel->pending[level] > 0) {
+      slot = wheel_First(&wheel->occupied[base / 64], TIMER_WHEEL_LN_SIZE,
+                         ((wheel->now >> shift) + 1) &
+                             (TIMER_WHEEL_LN_SIZE - 1));
+
+      for (const timer_wheel_timer *timer = wheel->slots[base + slot];
+           timer != NULL; timer = timer->next) {
+        if (timer->expires - wheel->now < next) {
+          next = timer->expires - wheel->now;
+        }
+      }
+    }
+    shift += TIMER_WHEEL_LN_BITS;
+  }
+
+  return next;
+}
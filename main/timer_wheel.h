@@ -0,0 +1,102 @@
+/*
+  __  __  ____ _______ ____  _____  _      _____ _   _ ______
+ |  \/  |/ __ \__   __/ __ \|  __ \| |    |_   _| \ | |  ____|
+ | \  / | |  | | | | | |  | | |__) | |      | | |  \| | |__
+ | |\/| | |  | | | | | |  | |  _  /| |      | | | . ` |  __|
+ | |  | | |__| | | | | |__| | | \ \| |____ _| |_| |\  | |____
+ |_|  |_|\____/  |_|  \____/|_|  \_\______|_____|_| \_|______|
+
+*/
+
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include <stdint.h>
+
+/*
+ * Roda de temporizadores hierarquica. O nivel 0 tem uma ranhura por tick
+ * (256 ticks), cada nivel seguinte cobre 64 ranhuras do anterior, assim
+ * armar, cancelar e disparar um temporizador custa O(1) seja qual for o
+ * numero de temporizadores pendentes. Quando o nivel 0 da a volta os
+ * temporizadores da ranhura seguinte do nivel 1 descem de nivel, e o mesmo
+ * entre os niveis acima.
+ *
+ * Os temporizadores sao da estrutura de quem os usa (sem malloc), o tick e
+ * o do chamador (no equipamento o tick do FreeRTOS). O modulo nao depende
+ * de FreeRTOS e nao tem trincos, quem a usa garante um so acesso de cada
+ * vez. Os callbacks correm dentro de timer_Wheel_Advance e podem voltar a
+ * armar o proprio temporizador ou outros.
+ *
+ * Um mapa de bits marca as ranhuras ocupadas, assim timer_Wheel_Next
+ * procura a primeira ranhura ocupada de cada nivel em vez de percorrer as
+ * ranhuras todas.
+ */
+
+#define TIMER_WHEEL_L0_BITS 8
+#define TIMER_WHEEL_LN_BITS 6
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_L0_SIZE (1 << TIMER_WHEEL_L0_BITS)
+#define TIMER_WHEEL_LN_SIZE (1 << TIMER_WHEEL_LN_BITS)
+#define TIMER_WHEEL_SLOTS                                                      \
+  (TIMER_WHEEL_L0_SIZE + (TIMER_WHEEL_LEVELS - 1) * TIMER_WHEEL_LN_SIZE)
+/* cada nivel comeca numa palavra do mapa de ranhuras ocupadas */
+#define TIMER_WHEEL_MAP_WORDS (TIMER_WHEEL_SLOTS / 64)
+
+/* 2^26 ticks, cerca de 18h com o tick de 1ms */
+#define TIMER_WHEEL_MAX_DELAY                                                  \
+  ((1UL << (TIMER_WHEEL_L0_BITS +                                              \
+            (TIMER_WHEEL_LEVELS - 1) * TIMER_WHEEL_LN_BITS)) -                 \
+   1)
+
+/* timer_Wheel_Next sem temporizadores pendentes */
+#define TIMER_WHEEL_NONE UINT32_MAX
+
+typedef struct timer_wheel_timer timer_wheel_timer;
+
+typedef void (*timer_wheel_callback)(timer_wheel_timer *timer, void *ctx);
+
+struct timer_wheel_timer
+{
+  timer_wheel_timer *next;
+  /* NULL quando nao esta armado */
+  timer_wheel_timer **pprev;
+  uint32_t expires;
+  uint16_t slot;
+  uint8_t level;
+  timer_wheel_callback callback;
+  void *ctx;
+};
+
+typedef struct
+{
+  /* ultimo tick ja processado */
+  uint32_t now;
+  uint16_t pending[TIMER_WHEEL_LEVELS];
+  uint64_t occupied[TIMER_WHEEL_MAP_WORDS];
+  timer_wheel_timer *slots[TIMER_WHEEL_SLOTS];
+
+} timer_wheel;
+
+void timer_Wheel_Init(timer_wheel *wheel, uint32_t now);
+
+void timer_Wheel_Timer_Init(timer_wheel_timer *timer,
+                            timer_wheel_callback callback, void *ctx);
+
+/* volta a armar se ja estava armado, delay de 0 conta como 1 tick */
+void timer_Wheel_Add(timer_wheel *wheel, timer_wheel_timer *timer,
+                     uint32_t delay);
+
+void timer_Wheel_Cancel(timer_wheel *wheel, timer_wheel_timer *timer);
+
+uint8_t timer_Wheel_Is_Pending(const timer_wheel_timer *timer);
+
+/* ticks que faltam ao temporizador, 0 se nao esta armado */
+uint32_t timer_Wheel_Remaining(const timer_wheel *wheel,
+                               const timer_wheel_timer *timer);
+
+void timer_Wheel_Advance(timer_wheel *wheel, uint32_t now);
+
+/* ticks ate ao proximo disparo ou TIMER_WHEEL_NONE */
+uint32_t timer_Wheel_Next(const timer_wheel *wheel);
+
+#endif
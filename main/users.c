@@ -2625,6 +2625,7 @@ uint16_t MyUser_Add(MyUser *user) {
 
       if (save_STR_Data_In_Storage(aux_phNumber, &buffer, nvs_Users_handle) ==
           ESP_OK) {
+        save_Phone_Index(user->phone, aux_phNumber, nvs_Users_handle);
         // ////printf("\n ADD USERS NAMESPACE1\n");
         UsersCountNumbers++;
         nvs_get_u32(nvs_System_handle, NVS_KEY_GUEST_COUNTER,
@@ -2643,6 +2644,7 @@ uint16_t MyUser_Add(MyUser *user) {
       // ////printf("\n ADD ADMIN NAMESPACE\n");
       if (save_STR_Data_In_Storage(aux_phNumber, &buffer, nvs_Admin_handle) ==
           ESP_OK) {
+        save_Phone_Index(user->phone, aux_phNumber, nvs_Admin_handle);
         // ////printf("\n ADD ADMIN NAMESPACE1\n");
         UsersCountNumbers++;
         save_User_Counter_In_Storage(UsersCountNumbers);
@@ -2656,6 +2658,7 @@ uint16_t MyUser_Add(MyUser *user) {
       // ////printf("\n ADD OWNER NAMESPACE %s\n", aux_phNumber);
       if (save_STR_Data_In_Storage(aux_phNumber, &buffer, nvs_Owner_handle) ==
           ESP_OK) {
+        save_Phone_Index(user->phone, aux_phNumber, nvs_Owner_handle);
         // ////printf("\n ADD OWNER NAMESPACE1 %s\n", aux_phNumber);
         UsersCountNumbers++;
         save_User_Counter_In_Storage(UsersCountNumbers);
@@ -2770,6 +2773,10 @@ uint8_t Myuser_deleteUser(MyUser *user) {
 
   ESP_LOGD("TAG", "Deleting user with phone number: %s", aux_phNumber);
 
+  if (strlen(user->phone) > 0) {
+    erase_Phone_Index(user->phone);
+  }
+
   /* if (strlen(user->phone) < 1 && user->wiegand_code[0] != ':') {
 
     sprintf(aux_phNumber, "$%s", user->wiegand_code);
@@ -3082,6 +3089,113 @@ uint8_t MyUser_Search_User_AUX_Call(char *phoneNumber,
   return ACK;
 }
 
+/* indice em RAM do numero recebido numa chamada (E.164 em BCD) para a chave
+   NVS e o namespace do utilizador */
+typedef struct {
+  uint8_t caller[PHONE_BCD_SIZE];
+  char key[MYUSER_PHONE_SIZE];
+  nvs_handle_t handle;
+  uint32_t last_use;
+} caller_index_entry;
+
+static caller_index_entry caller_Index[CALLER_INDEX_SIZE];
+static uint32_t caller_Index_Use = 0;
+
+static void caller_Index_Insert(uint8_t *bcd, char *key, nvs_handle_t handle) {
+  uint8_t slot = 0;
+
+  if (strlen(key) >= MYUSER_PHONE_SIZE) {
+    return;
+  }
+
+  for (uint8_t i = 1; i < CALLER_INDEX_SIZE; i++) {
+    if (caller_Index[i].last_use < caller_Index[slot].last_use) {
+      slot = i;
+    }
+  }
+
+  memcpy(caller_Index[slot].caller, bcd, PHONE_BCD_SIZE);
+  sprintf(caller_Index[slot].key, "%s", key);
+  caller_Index[slot].handle = handle;
+  caller_Index[slot].last_use = ++caller_Index_Use;
+}
+
+static uint8_t caller_Read_User(char *key, nvs_handle_t handle,
+                                char *file_contents_Users) {
+  char auxfileContents[200] = {};
+  size_t required_size = sizeof(auxfileContents);
+
+  if (nvs_get_str(handle, key, auxfileContents, &required_size) != ESP_OK) {
+    return 0;
+  }
+
+  sprintf(file_contents_Users, "%s", auxfileContents);
+  return 1;
+}
+
+/* procura o utilizador de uma chamada: indice em RAM, depois o indice E.164
+   em NVS e so por fim as normalizacoes antigas, que passam a ficar indexadas */
+uint8_t MyUser_Search_Caller(char *phoneNumber, char *file_contents_Users) {
+  char auxPhone[50] = {};
+  char e164[PHONE_E164_SIZE] = {};
+  uint8_t bcd[PHONE_BCD_SIZE];
+  uint8_t canonical = 0;
+  nvs_handle_t handle = 0;
+  esp_err_t ACK = ESP_FAIL;
+
+  canonical = phone_Canonicalize_E164(phoneNumber, e164) &&
+              phone_E164_To_BCD(e164, bcd);
+
+  if (canonical) {
+    for (uint8_t i = 0; i < CALLER_INDEX_SIZE; i++) {
+      if (caller_Index[i].last_use == 0 ||
+          memcmp(caller_Index[i].caller, bcd, PHONE_BCD_SIZE)) {
+        continue;
+      }
+
+      if (caller_Read_User(caller_Index[i].key, caller_Index[i].handle,
+                           file_contents_Users)) {
+        caller_Index[i].last_use = ++caller_Index_Use;
+        return ESP_OK;
+      }
+
+      /* utilizador apagado ou mudou de namespace */
+      caller_Index[i].last_use = 0;
+      break;
+    }
+
+    if (get_Phone_Index(phoneNumber, auxPhone, &handle)) {
+      if (caller_Read_User(auxPhone, handle, file_contents_Users)) {
+        caller_Index_Insert(bcd, auxPhone, handle);
+        return ESP_OK;
+      }
+
+      erase_Phone_Index(phoneNumber);
+    }
+  }
+
+  sprintf(auxPhone, "%s", check_IF_haveCountryCode(phoneNumber, 0));
+  ACK = get_Data_Users_Handle_From_Storage(auxPhone, file_contents_Users,
+                                           &handle);
+
+  if (ACK != ESP_OK && phoneNumber[0] != '+') {
+    sprintf(auxPhone, "%s", check_IF_haveCountryCode_AUX_Call(phoneNumber));
+    ACK = get_Data_Users_Handle_From_Storage(auxPhone, file_contents_Users,
+                                             &handle);
+  }
+
+  if (ACK != ESP_OK) {
+    return ESP_FAIL;
+  }
+
+  if (canonical) {
+    save_Phone_Index(phoneNumber, auxPhone, handle);
+    caller_Index_Insert(bcd, auxPhone, handle);
+  }
+
+  return ESP_OK;
+}
+
 char *MyUser_add_Owner(char *payload, char *SMS_phoneNumber,
                        uint8_t BLE_SMS_Indication) {
   MyUser user_validateData; //= malloc(sizeof(MyUser));
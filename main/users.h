@@ -32,6 +32,8 @@
 /******************************************************************************/
 #define MYUSER_PHONE_SIZE ((uint8_t)(20))
 
+#define CALLER_INDEX_SIZE 8
+
 extern SemaphoreHandle_t rdySem;
 
 #define SUN 1
@@ -130,6 +132,7 @@ uint16_t MyUser_Add(MyUser *user);
 uint32_t MyUser_List_AllUsers();
 uint8_t MyUser_Search_User(char *phoneNumber, char *file_contents);
 uint8_t MyUser_Search_User_AUX_Call(char *phoneNumber, char *file_contents);
+uint8_t MyUser_Search_Caller(char *phoneNumber, char *file_contents);
 void parse_ValidateData_User(char *file_contents, MyUser *user_validateData);
 uint8_t validate_DataUser(MyUser *user_validateData, char *password);
 uint8_t Myuser_deleteUser(MyUser *user);
@@ -60,6 +60,10 @@
 static const char *TAG = "wiegand";
 char rsp_pointer[200] = {};
 
+/* fim dos modos de gravacao automatica / leitura (timer_service.h) */
+static timer_service_timer autoadd_Wiegand1_Timer;
+static timer_service_timer autoadd_Wiegand2_Timer;
+
 #define CHECK(x)                                                               \
   do {                                                                         \
     esp_err_t __;                                                              \
@@ -335,20 +339,13 @@ void wiegand2_task(void *arg) {
       &reader2, 40, 39, true, CONFIG_EXAMPLE_BUF_SIZE, reader_callback2,
       WIEGAND_MSB_FIRST, WIEGAND_LSB_FIRST));
 
-  xTimer_autoadd_wiegand2 =
-      xTimerCreate("xTimer_autoadd2_wiegand", // Nome do timer
-                   pdMS_TO_TICKS(10000),      // Período em milissegundos
-                   false,                     // Modo de repetição automática
-                   3,                         // ID do timer (0 neste exemplo)
-                   timer_autoAdd2_Callback    // Função de callback
-      );
+  register_Timer(&autoadd_Wiegand2_Timer, "wiegand2_autoadd",
+                 TIMER_SERVICE_NO_GROUP, timer_autoAdd2_Callback, NULL);
 
   uint8_t keypadCode[7];
   keypadCount = 0;
   uint8_t keyPadIndex = 0;
 
-  xTimerStop(xTimer_autoadd_wiegand2, 0);
-
   data_packet_t p;
   while (1) {
     // ESP_LOGI("TAG", "Waiting for Wiegand data...");
@@ -396,7 +393,7 @@ void wiegand2_task(void *arg) {
     if (wiegandResult == 160 && keypadCount == 0) {
       keypadCount = 1;
       wiegandMode2 = WIEGAND_KEYPAD_MODE_LABEL;
-      xTimerChangePeriod(xTimer_autoadd_wiegand2, pdMS_TO_TICKS(10000), 0);
+      start_Timer(&autoadd_Wiegand2_Timer, 10000, 0);
       // printf("\nwiegand keypadCount 55- %d\n", keypadCount);
       memset(keypadCode, 0, sizeof(keypadCode));
     } else if (wiegandResult == 176 && keypadCount == 1) {
@@ -427,7 +424,7 @@ void wiegand2_task(void *arg) {
         }
       } else {
         // printf("\nwiegand xTimerStop- %lld\n", wiegandResult);
-        xTimerStop(xTimer_autoadd_wiegand2, 0);
+        stop_Timer(&autoadd_Wiegand2_Timer);
         memset(keypadCode, 0, sizeof(keypadCode));
         keyPadIndex = 0;
         keypadCount = 0;
@@ -731,20 +728,13 @@ void wiegand1_task(void *arg) {
                                        CONFIG_EXAMPLE_BUF_SIZE, reader_callback,
                                        WIEGAND_MSB_FIRST, WIEGAND_LSB_FIRST));
 
-  xTimer_autoadd_wiegand1 =
-      xTimerCreate("xTimer_autoadd_wiegand1", // Nome do timer
-                   pdMS_TO_TICKS(10000),      // Período em milissegundos
-                   false,                     // Modo de repetição automática
-                   1,                         // ID do timer (0 neste exemplo)
-                   timer_autoAdd_Callback     // Função de callback
-      );
+  register_Timer(&autoadd_Wiegand1_Timer, "wiegand1_autoadd",
+                 TIMER_SERVICE_NO_GROUP, timer_autoAdd_Callback, NULL);
 
   uint8_t keypadCode[7];
   keypadCount = 0;
   uint8_t keyPadIndex = 0;
 
-  xTimerStop(xTimer_autoadd_wiegand1, 0);
-
   data_packet_t p;
   while (1) {
     // ESP_LOGI("TAG", "Waiting for Wiegand data...");
@@ -793,7 +783,7 @@ void wiegand1_task(void *arg) {
 
       keypadCount = 1;
       wiegandMode = WIEGAND_KEYPAD_MODE_LABEL;
-      xTimerChangePeriod(xTimer_autoadd_wiegand1, pdMS_TO_TICKS(10000), 0);
+      start_Timer(&autoadd_Wiegand1_Timer, 10000, 0);
       // printf("\nwiegand keypadCount 55- %d\n", keypadCount);
       memset(keypadCode, 0, sizeof(keypadCode));
 
@@ -826,7 +816,7 @@ void wiegand1_task(void *arg) {
         }
       } else {
         // printf("\nwiegand xTimerStop- %lld\n", wiegandResult);
-        xTimerStop(xTimer_autoadd_wiegand1, 0);
+        stop_Timer(&autoadd_Wiegand1_Timer);
         memset(keypadCode, 0, sizeof(keypadCode));
         keyPadIndex = 0;
         keypadCount = 0;
@@ -836,7 +826,7 @@ void wiegand1_task(void *arg) {
       uint8_t addDefault_user_result = add_defaultUser_wiegand(wiegandResult);
 
       if (addDefault_user_result == 1) {
-        if (xTimerIsTimerActive(xTimer_autoadd_wiegand1) == pdFALSE) {
+        if (!is_Timer_Active(&autoadd_Wiegand1_Timer)) {
           gattsIF_wiegand_autoSave = 0;
           connID_wiegand_autoSave = 0;
           handle_table_wiegand_autoSave = 0;
@@ -844,9 +834,8 @@ void wiegand1_task(void *arg) {
           wiegandMode = WIEGAND_NORMAL_MODE_LABEL;
           // TODO: ENVIAR ERRO QUE NÃO IRA GRAVAR MAIS
         } else {
-          if (xTimerChangePeriod(xTimer_autoadd_wiegand1, pdMS_TO_TICKS(10000),
-                                 0) != pdPASS) {
-            xTimerStop(xTimer_autoadd_wiegand1, 0);
+          if (!start_Timer(&autoadd_Wiegand1_Timer, 10000, 0)) {
+            stop_Timer(&autoadd_Wiegand1_Timer);
 
             wiegandMode = WIEGAND_NORMAL_MODE_LABEL;
             gattsIF_wiegand_autoSave = 0;
@@ -885,10 +874,7 @@ void wiegand1_task(void *arg) {
       handle_table_wiegand_autoSave = 0;
       BLE_SMS_Indication_wiegand_autoSave = 0;
 
-      if (xTimerChangePeriod(xTimer_autoadd_wiegand1, pdMS_TO_TICKS(10000),
-                             0) == pdPASS) {
-        xTimerStop(xTimer_autoadd_wiegand1, 0);
-      }
+      stop_Timer(&autoadd_Wiegand1_Timer);
 
       send_UDP_Send(wiegandNumber, "");
 
@@ -1018,9 +1004,7 @@ uint8_t wiegand_parse_getData(uint64_t wiegand_data, char *keypadValue,
   return 0;
 }
 
-void timer_autoAdd_Callback(TimerHandle_t xTimer) {
-  xTimerStopFromISR(xTimer, NULL);
-
+void timer_autoAdd_Callback(timer_service_timer *timer, void *ctx) {
   wiegandMode = WIEGAND_NORMAL_MODE_LABEL;
   gattsIF_wiegand_autoSave = 0;
   connID_wiegand_autoSave = 0;
@@ -1033,9 +1017,7 @@ void timer_autoAdd_Callback(TimerHandle_t xTimer) {
   // printf("\n\n parou gravação\n\n");
 }
 
-void timer_autoAdd2_Callback(TimerHandle_t xTimer) {
-  xTimerStopFromISR(xTimer, NULL);
-
+void timer_autoAdd2_Callback(timer_service_timer *timer, void *ctx) {
   wiegandMode = WIEGAND_NORMAL_MODE_LABEL;
   gattsIF_wiegand_autoSave = 0;
   connID_wiegand_autoSave = 0;
@@ -1134,9 +1116,9 @@ char *parseWiegand_data(uint8_t BLE_SMS_Indication, uint8_t gattsIF,
     if (param == WIEGAND_START_AUTO_SAVE_PARAMETER) {
       char *rsp;
 
-      if (xTimer_autoadd_wiegand1 != NULL) {
-        if (xTimerIsTimerActive(xTimer_autoadd_wiegand1) == pdFALSE) {
-          if (xTimerStart(xTimer_autoadd_wiegand1, 0) == pdPASS) {
+      if (autoadd_Wiegand1_Timer.service != NULL) {
+        if (!is_Timer_Active(&autoadd_Wiegand1_Timer)) {
+          if (start_Timer(&autoadd_Wiegand1_Timer, 10000, 0)) {
             wiegandMode = WIEGAND_AUTO_SAVE_MODE_LABEL;
             // //printf("\n\n wiegand mode payload - %s\n\n", payload);
             parse_ValidateData_User(payload, &user_auto_controlAcess);
@@ -1147,7 +1129,7 @@ char *parseWiegand_data(uint8_t BLE_SMS_Indication, uint8_t gattsIF,
             // xTimerDelete(xTimer_autoadd_wiegand1, 0);
           }
         } else {
-          xTimerChangePeriod(xTimer_autoadd_wiegand1, pdMS_TO_TICKS(15000), 0);
+          start_Timer(&autoadd_Wiegand1_Timer, 15000, 0);
           // Inicie o timer
 
           // Após terminar de usar o timer, exclua-o
@@ -1224,11 +1206,11 @@ char *parseWiegand_data(uint8_t BLE_SMS_Indication, uint8_t gattsIF,
     }
   } else if (cmd == GET_CMD) {
     if (param == WIEGANG_NUMBER_PARAMETER) {
-      if (xTimer_autoadd_wiegand1 != NULL) {
+      if (autoadd_Wiegand1_Timer.service != NULL) {
         // //printf("\n\n gw1\n\n");
-        if (xTimerIsTimerActive(xTimer_autoadd_wiegand1) == pdFALSE) {
+        if (!is_Timer_Active(&autoadd_Wiegand1_Timer)) {
           // //printf("\n\n gw2\n\n");
-          if (xTimerStart(xTimer_autoadd_wiegand1, 0) == pdPASS) {
+          if (start_Timer(&autoadd_Wiegand1_Timer, 10000, 0)) {
             // //printf("\n\n gw3\n\n");
             wiegandMode = WIEGAND_READ_MODE_LABEL;
           } else {
@@ -1238,7 +1220,7 @@ char *parseWiegand_data(uint8_t BLE_SMS_Indication, uint8_t gattsIF,
           }
         } else {
           // //printf("\n\n gw5\n\n");
-          xTimerChangePeriod(xTimer_autoadd_wiegand1, pdMS_TO_TICKS(15000), 0);
+          start_Timer(&autoadd_Wiegand1_Timer, 15000, 0);
           // Inicie o timer
 
           // Após terminar de usar o timer, exclua-o
@@ -1271,9 +1253,8 @@ char *parseWiegand_data(uint8_t BLE_SMS_Indication, uint8_t gattsIF,
       return rsp;
     } else if (param == WIEGAND_START_AUTO_SAVE_PARAMETER) {
       char *rsp;
-      if (xTimerChangePeriod(xTimer_autoadd_wiegand1, pdMS_TO_TICKS(10000),
-                             0) == pdPASS) {
-        xTimerStop(xTimer_autoadd_wiegand1, 0);
+      if (autoadd_Wiegand1_Timer.service != NULL) {
+        stop_Timer(&autoadd_Wiegand1_Timer);
         asprintf(&rsp, "%s", "WI R S OK");
       } else {
         asprintf(&rsp, "%s", "WI R S ERROR");
@@ -77,8 +77,6 @@ uint16_t connID_wiegand_autoSave;
 uint16_t handle_table_wiegand_autoSave;
 
 typedef struct wiegand_reader wiegand_reader_t;
-TimerHandle_t xTimer_autoadd_wiegand1;
-TimerHandle_t xTimer_autoadd_wiegand2;
 
 typedef void (*wiegand_callback_t)(wiegand_reader_t *reader);
 
@@ -190,8 +188,8 @@ void wiegand2_action(uint64_t wiegandResult);
 void wiegand1_action(uint64_t wiegandResult);
 char *parseWiegand_data(uint8_t BLE_SMS_Indication,uint8_t gattsIF, uint16_t connID, uint16_t handle_table,char cmd, char param, char *phPassword, char *payload,
                         MyUser *user_validateData, mqtt_information *mqttInfo);
-void timer_autoAdd_Callback(TimerHandle_t xTimer);
-void timer_autoAdd2_Callback(TimerHandle_t xTimer);
+void timer_autoAdd_Callback(timer_service_timer *timer, void *ctx);
+void timer_autoAdd2_Callback(timer_service_timer *timer, void *ctx);
 
 uint8_t activate_wiegand(uint8_t mode);
 uint8_t deactivate_wiegand();